@@ -1,5 +1,9 @@
+#include <kernel/core/job_system.h>
 #include <kernel/cpu/ap_startup.h>
+#include <kernel/cpu/apic_ipi.h>
 #include <kernel/cpu/apic_timer.h>
+#include <kernel/cpu/fpu.h>
+#include <kernel/cpu/tlb_shootdown.h>
 
 static uint32_t kernel_cr3_cached = 0u;
 static ApplicationProcessorLocalContext_t ap_local_context = {0};
@@ -31,6 +35,23 @@ static void ap_startup_record_online_event(uint8_t apic_id, uint32_t logical_slo
     application_processor_bootstrap_mark_booted(logical_slot);
 }
 
+/* Same bits boot.S sets on the BSP: clear CR0.EM, set CR0.MP, set CR4.OSFXSR and
+   CR4.OSXMMEXCPT. An AP resets with SSE disabled, and every job it runs for the
+   engine is compiled -msse2, so without this the first one would #UD. */
+static void ap_startup_enable_sse(void)
+{
+    uint32_t cr0 = 0u;
+    uint32_t cr4 = 0u;
+
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 = (cr0 & ~0x4u) | 0x2u;
+    __asm__ volatile("mov %0, %%cr0" ::"r"(cr0) : "memory");
+
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= 0x600u;
+    __asm__ volatile("mov %0, %%cr4" ::"r"(cr4) : "memory");
+}
+
 uint32_t application_processor_startup_get_kernel_cr3(void)
 {
     if (!kernel_cr3_cached)
@@ -62,15 +83,34 @@ void application_processor_startup_initialize_cpu(uint8_t apic_id, uint32_t logi
     ap_local_context.initialized = 1u;
 
     paging_load_cr3(application_processor_startup_get_kernel_cr3());
+    paging_initialize_page_attribute_table_secondary();
+    /* Before anything past the kernel image and this CPU's stack is touched: the
+       directory may already hold 4 MiB entries, which read as garbage page
+       tables until CR4.PSE is set. */
+    paging_initialize_page_size_extensions_secondary();
+
+    /* The trampoline GDT only carries flat selectors and no IDT at all, so the
+       first IPI (a TLB shootdown, a job wake-up) would triple-fault this CPU. */
+    global_descriptor_table_load_secondary(&global_descriptor_table);
+    interrupt_descriptor_table_load(&interrupt_descriptor_table);
+    ap_startup_enable_sse();
+    interrupt_fpu_initialize_secondary();
+
     apic_initialize_on_cpu(advanced_pic_timer_backend_get_local_apic_virtual_base());
+    advanced_pic_ipi_enable_local_apic();
+
+    /* From here on this CPU answers shootdowns; before, it got none to answer. */
+    tlb_shootdown_activate_cpu();
 
     (void) stack_top;
 
+    cpu_topology_bind_hardware_apic_id(apic_id, logical_slot);
     ap_startup_record_online_event(apic_id, logical_slot);
 
     uint32_t domain = cpu_topology_get_slot_domain(logical_slot);
 
     kernel_heap_initialize_ap_domain(logical_slot);
+    kernel_job_system_register_worker(logical_slot, apic_id);
 
     if (ap_serial_port)
     {
@@ -102,8 +142,5 @@ uint8_t application_processor_startup_is_initialized(void) { return ap_local_con
 void application_processor_startup_main_loop(void)
 {
     asmutils_enable_interrupts();
-    while (1)
-    {
-        asmutils_halt();
-    }
+    kernel_job_system_worker_loop();
 }
@@ -6,6 +6,7 @@
 */
 
 #include <kernel/cpu/apic_ipi.h>
+#include <kernel/cpu/tlb_shootdown.h>
 
 #define LAPIC_ICR_LOW_OFFSET  0x300u
 #define LAPIC_ICR_HIGH_OFFSET 0x310u
@@ -32,34 +33,12 @@
 #define LAPIC_ICR_DEST_SHORT_ALL_INCL  (2u << 18)
 #define LAPIC_ICR_DEST_SHORT_ALL_EXCL  (3u << 18)
 
-/* Upper bound on the TLB-shootdown ACK spin so a missing or unresponsive target
-   CPU (a wedged AP, or a stale online count) can never hang the kernel. */
-#define APIC_IPI_TLB_SHOOTDOWN_SPIN_LIMIT 1000000u
-
 static uint32_t apic_ipi_lapic_base = 0u;
 static uint32_t apic_ipi_init_attempt_count = 0u;
 static uint32_t apic_ipi_sipi_attempt_count = 0u;
 static uint32_t apic_ipi_startup_sequence_attempt_count = 0u;
 static uint32_t apic_ipi_startup_sequence_success_count = 0u;
 
-static volatile uint32_t apic_ipi_tlb_shootdown_addr = 0u;
-static volatile uint32_t apic_ipi_tlb_shootdown_pending = 0u;
-static uint32_t apic_ipi_tlb_shootdown_timeout_count = 0u;
-
-static void apic_ipi_tlb_shootdown_handler(const InterruptFrame_t *frame)
-{
-    (void) frame;
-    if (apic_ipi_tlb_shootdown_addr == 0xFFFFFFFFu)
-    {
-        paging_flush_tlb();
-    }
-    else
-    {
-        paging_invlpg(apic_ipi_tlb_shootdown_addr);
-    }
-    __sync_fetch_and_sub(&apic_ipi_tlb_shootdown_pending, 1u);
-}
-
 void advanced_pic_ipi_initialize(uint32_t lapic_virtual_base)
 {
     if (!lapic_virtual_base)
@@ -70,7 +49,7 @@ void advanced_pic_ipi_initialize(uint32_t lapic_virtual_base)
 
     apic_ipi_lapic_base = lapic_virtual_base;
 
-    interrupt_service_routine_register_handler(0x40u, apic_ipi_tlb_shootdown_handler);
+    tlb_shootdown_initialize();
 }
 
 uint8_t advanced_pic_ipi_is_ready(void) { return apic_ipi_lapic_base != 0u; }
@@ -165,40 +144,13 @@ uint8_t advanced_pic_ipi_send_fixed(uint8_t apic_id, uint8_t vector, uint8_t sho
     return advanced_pic_ipi_wait_delivery();
 }
 
-void advanced_pic_ipi_broadcast_tlb_shootdown(uint32_t virt_addr)
-{
-    uint32_t cpu_count = cpu_topology_get_online_cpu_count();
+void advanced_pic_ipi_broadcast_tlb_shootdown(uint32_t virt_addr) { tlb_shootdown_page(virt_addr); }
 
-    if (cpu_count <= 1u)
-    {
-        paging_invlpg(virt_addr);
-        return;
-    }
-
-    apic_ipi_tlb_shootdown_addr = virt_addr;
-    apic_ipi_tlb_shootdown_pending = cpu_count - 1u;
-
-    advanced_pic_ipi_send_fixed(0u, 0x40u, 3u);
-
-    uint32_t spin_guard = 0u;
-    while (apic_ipi_tlb_shootdown_pending > 0u)
-    {
-        __asm__ volatile("pause");
-
-        if (++spin_guard >= APIC_IPI_TLB_SHOOTDOWN_SPIN_LIMIT)
-        {
-            /* A target never acknowledged (unresponsive or phantom CPU). Stop
-               waiting so a shootdown can never hang the kernel; the local TLB
-               is still invalidated below. */
-            apic_ipi_tlb_shootdown_pending = 0u;
-            ++apic_ipi_tlb_shootdown_timeout_count;
-            break;
-        }
-    }
-
-    paging_invlpg(virt_addr);
+uint32_t advanced_pic_ipi_get_tlb_shootdown_timeout_count(void)
+{
+    TlbShootdownStatistics_t statistics;
+    tlb_shootdown_get_statistics(&statistics);
+    return statistics.timeouts;
 }
 
-uint32_t advanced_pic_ipi_get_tlb_shootdown_timeout_count(void) { return apic_ipi_tlb_shootdown_timeout_count; }
-
-void advanced_pic_ipi_broadcast_tlb_flush(void) { advanced_pic_ipi_broadcast_tlb_shootdown(0xFFFFFFFFu); }
+void advanced_pic_ipi_broadcast_tlb_flush(void) { tlb_shootdown_all(); }
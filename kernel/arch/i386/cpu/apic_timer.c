@@ -1,7 +1,8 @@
 #include <kernel/cpu/apic_timer.h>
 
-#define APIC_CPUID_LEAF_FEATURES 0x00000001u
-#define APIC_CPUID_EDX_BIT_APIC  (1u << 9u)
+#define APIC_CPUID_LEAF_FEATURES        0x00000001u
+#define APIC_CPUID_EDX_BIT_APIC         (1u << 9u)
+#define APIC_CPUID_ECX_BIT_TSC_DEADLINE (1u << 24u)
 
 #define IA32_APIC_BASE_MSR                0x0000001Bu
 #define IA32_APIC_BASE_BSP_BIT            (1ull << 8u)
@@ -9,8 +10,13 @@
 #define IA32_APIC_BASE_ENABLE_BIT         (1ull << 11u)
 #define IA32_APIC_BASE_PHYSICAL_BASE_MASK 0xFFFFF000ull
 
+#define IA32_TSC_DEADLINE_MSR 0x000006E0u
+
 #define APIC_TIMER_MMIO_VIRTUAL_BASE 0xFFB00000u
 
+/* LVT timer mode, bits 18:17: 00b one-shot, 01b periodic, 10b TSC-deadline. */
+#define APIC_TIMER_LVT_MODE_TSC_DEADLINE (2u << 17u)
+
 static const char *advanced_pic_timer_backend_state_name = "apic-probe-only";
 static uint32_t advanced_pic_timer_local_apic_physical_base = 0u;
 static uint8_t advanced_pic_timer_local_apic_is_bootstrap_processor = 0u;
@@ -18,6 +24,8 @@ static uint8_t advanced_pic_timer_local_apic_mmio_mapped = 0u;
 static uint32_t advanced_pic_timer_local_apic_version_register = 0u;
 static uint32_t advanced_pic_timer_local_apic_calibrated_frequency_hz = 0u;
 static uint8_t advanced_pic_timer_local_apic_periodic_mode_enabled = 0u;
+static uint8_t advanced_pic_timer_tsc_deadline_supported = 0u;
+static uint64_t advanced_pic_timer_timestamp_counter_frequency_hz = 0u;
 
 static uint8_t advanced_pic_timer_backend_map_local_apic_mmio(void)
 {
@@ -70,8 +78,11 @@ uint8_t advanced_pic_timer_backend_initialize(uint32_t target_frequency_hz)
     advanced_pic_timer_local_apic_version_register = 0u;
     advanced_pic_timer_local_apic_calibrated_frequency_hz = 0u;
     advanced_pic_timer_local_apic_periodic_mode_enabled = 0u;
+    advanced_pic_timer_tsc_deadline_supported = 0u;
+    advanced_pic_timer_timestamp_counter_frequency_hz = 0u;
 
     asmutils_cpuid(APIC_CPUID_LEAF_FEATURES, 0u, &eax, &ebx, &ecx, &edx);
+    advanced_pic_timer_tsc_deadline_supported = (uint8_t) ((ecx & APIC_CPUID_ECX_BIT_TSC_DEADLINE) != 0u);
     if ((edx & APIC_CPUID_EDX_BIT_APIC) == 0u)
     {
         advanced_pic_timer_backend_state_name = "apic-probe-no-local-apic";
@@ -142,6 +153,8 @@ uint8_t advanced_pic_timer_backend_calibrate_with_pit(void)
     uint32_t local_apic_current_count;
     uint32_t local_apic_elapsed_counts;
     uint64_t local_apic_frequency_hz_u64;
+    uint64_t timestamp_start;
+    uint64_t timestamp_end;
 
     if (!advanced_pic_timer_local_apic_mmio_mapped && !apic_is_x2apic_active())
         return 0u;
@@ -162,12 +175,14 @@ uint8_t advanced_pic_timer_backend_calibrate_with_pit(void)
     apic_write(LAPIC_REG_TIMER_DIV, 0x3u);
     apic_write(LAPIC_REG_LVT_TIMER, (1u << 16u) | 0xFEu);
     apic_write(LAPIC_REG_TIMER_INIT, 0xFFFFFFFFu);
+    timestamp_start = asmutils_read_timestamp_counter();
 
     end_tick = start_tick + 8u;
     while (interrupt_request_get_tick_count() < end_tick)
         asmutils_no_operation();
 
     local_apic_current_count = apic_read(LAPIC_REG_TIMER_CUR);
+    timestamp_end = asmutils_read_timestamp_counter();
     local_apic_elapsed_counts = 0xFFFFFFFFu - local_apic_current_count;
 
     apic_write(LAPIC_REG_TIMER_INIT, 0u);
@@ -186,6 +201,12 @@ uint8_t advanced_pic_timer_backend_calibrate_with_pit(void)
         local_apic_frequency_hz_u64 = 0xFFFFFFFFull;
 
     advanced_pic_timer_local_apic_calibrated_frequency_hz = (uint32_t) local_apic_frequency_hz_u64;
+
+    /* The same eight PIT periods time the TSC: deadlines are written in TSC cycles,
+       and the fallback converts them to LAPIC counts with the ratio of the two. */
+    advanced_pic_timer_timestamp_counter_frequency_hz =
+        ((timestamp_end - timestamp_start) * (uint64_t) pit_frequency_hz) / (uint64_t) 8u;
+
     advanced_pic_timer_backend_state_name = apic_is_x2apic_active() ? "x2apic-calibrated" : "xapic-calibrated";
     return 1u;
 }
@@ -342,3 +363,85 @@ uint32_t advanced_pic_timer_backend_read_current_count(void)
         return 0u;
     return apic_read(LAPIC_REG_TIMER_CUR);
 }
+
+uint64_t advanced_pic_timer_backend_get_timestamp_counter_frequency_hz(void)
+{
+    return advanced_pic_timer_timestamp_counter_frequency_hz;
+}
+
+uint8_t advanced_pic_timer_backend_is_tsc_deadline_supported(void) { return advanced_pic_timer_tsc_deadline_supported; }
+
+/**
+ * @brief Puts the calling CPU's local timer in deadline mode on @p vector.
+ *
+ * TSC-deadline when CPUID has it: the deadline is then an absolute TSC value and
+ * there is nothing to convert or to drift. Otherwise one-shot mode with the usual
+ * divider, and arm_deadline() turns each deadline into a count. Nothing is armed.
+ *
+ * @return 1 in TSC-deadline mode, 0 in one-shot mode or when the timer is unavailable.
+ */
+uint8_t advanced_pic_timer_backend_enter_deadline_mode(uint8_t vector)
+{
+    if (!advanced_pic_timer_local_apic_mmio_mapped && !apic_is_x2apic_active())
+        return 0u;
+
+    apic_write(LAPIC_REG_TIMER_INIT, 0u);
+    advanced_pic_timer_local_apic_periodic_mode_enabled = 0u;
+
+    if (advanced_pic_timer_tsc_deadline_supported)
+    {
+        apic_write(LAPIC_REG_LVT_TIMER, APIC_TIMER_LVT_MODE_TSC_DEADLINE | vector);
+        /* The SDM asks for a fence between the LVT write, an MMIO store, and the
+           first deadline write, an MSR write that does not wait for it. */
+        __asm__ volatile("mfence" ::: "memory");
+        advanced_pic_timer_backend_state_name =
+            apic_is_x2apic_active() ? "x2apic-tsc-deadline" : "xapic-tsc-deadline";
+        return 1u;
+    }
+
+    apic_write(LAPIC_REG_TIMER_DIV, 0x3u);
+    apic_write(LAPIC_REG_LVT_TIMER, vector);
+    advanced_pic_timer_backend_state_name =
+        apic_is_x2apic_active() ? "x2apic-oneshot-deadline" : "xapic-oneshot-deadline";
+    return 0u;
+}
+
+/**
+ * @brief Fires the timer entered by enter_deadline_mode() at TSC @p deadline.
+ *
+ * A deadline already past fires at once. In one-shot mode the delay is clamped to
+ * what 32 bits of count hold; the interrupt then comes early and whoever armed it
+ * arms again, which costs one interrupt and no accuracy.
+ *
+ * @param deadline TSC value to fire at; 0 disarms.
+ */
+void advanced_pic_timer_backend_arm_deadline(uint64_t deadline)
+{
+    if (advanced_pic_timer_tsc_deadline_supported)
+    {
+        asmutils_write_model_specific_register(IA32_TSC_DEADLINE_MSR, deadline);
+        return;
+    }
+
+    if (deadline == 0u || advanced_pic_timer_timestamp_counter_frequency_hz == 0u)
+    {
+        apic_write(LAPIC_REG_TIMER_INIT, 0u);
+        return;
+    }
+
+    const uint64_t now = asmutils_read_timestamp_counter();
+    uint64_t delta = deadline > now ? deadline - now : 0u;
+
+    /* A second of TSC at most, so the product below cannot overflow 64 bits. */
+    if (delta > advanced_pic_timer_timestamp_counter_frequency_hz)
+        delta = advanced_pic_timer_timestamp_counter_frequency_hz;
+
+    uint64_t count = (delta * (uint64_t) advanced_pic_timer_local_apic_calibrated_frequency_hz) /
+                     advanced_pic_timer_timestamp_counter_frequency_hz;
+    if (count == 0u)
+        count = 1u;
+    if (count > 0xFFFFFFFFu)
+        count = 0xFFFFFFFFu;
+
+    apic_write(LAPIC_REG_TIMER_INIT, (uint32_t) count);
+}
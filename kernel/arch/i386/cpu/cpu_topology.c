@@ -1,9 +1,12 @@
+#include <kernel/cpu/apic.h>
 #include <kernel/cpu/cpu_topology.h>
 
 #define CPU_TOPOLOGY_CPUID_LEAF_FEATURES 0x00000001u
 #define CPU_TOPOLOGY_CPUID_EDX_APIC_BIT  (1u << 9u)
 #define CPU_TOPOLOGY_MAX_LOGICAL_CPUS    CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC
 #define CPU_TOPOLOGY_INVALID_APIC_ID     0xFFFFFFFFu
+#define CPU_TOPOLOGY_HARDWARE_APIC_IDS   256u
+#define CPU_TOPOLOGY_UNBOUND_SLOT        0xFFu
 
 static uint8_t cpu_topology_initialized = 0u;
 static uint8_t cpu_topology_forced_slot_enabled = 0u;
@@ -17,6 +20,14 @@ static uint32_t cpu_topology_online_cpu_count = 0u;
 static uint32_t cpu_topology_slot_domain[CPU_TOPOLOGY_MAX_LOGICAL_CPUS];
 static const char *cpu_topology_source_name = "topology-uninitialized";
 
+/* Slots the APs were started at, keyed by the ID their own LAPIC reports. Kept
+   apart from the discovery tables on purpose: the topology smokes reset and
+   re-run discovery on the BSP while the APs are already running, and an AP
+   must not find its slot renumbered under it. */
+static uint8_t cpu_topology_hardware_lookup_enabled = 0u;
+static uint32_t cpu_topology_boot_apic_id = CPU_TOPOLOGY_INVALID_APIC_ID;
+static uint8_t cpu_topology_hardware_slot_by_apic_id[CPU_TOPOLOGY_HARDWARE_APIC_IDS];
+
 static void cpu_topology_reset_discovery(void)
 {
     cpu_topology_discovered_cpu_count = 0u;
@@ -68,6 +79,7 @@ static void cpu_topology_detect_from_cpuid(void)
 
     cpu_topology_local_apic_id = (ebx >> 24u) & 0xFFu;
     cpu_topology_apic_id_valid = 1u;
+    cpu_topology_boot_apic_id = cpu_topology_local_apic_id;
     cpu_topology_source_name = "topology-cpuid-apic-id";
     (void) cpu_topology_register_apic_id_internal(cpu_topology_local_apic_id);
 }
@@ -87,8 +99,31 @@ void cpu_topology_initialize(void)
     cpu_topology_mark_runtime_cpu_online();
 }
 
+static uint32_t cpu_topology_read_hardware_apic_id(void)
+{
+    const uint32_t id_register = apic_read(LAPIC_REG_ID);
+
+    if (apic_is_x2apic_active())
+        return id_register;
+
+    return id_register >> 24u;
+}
+
 uint32_t cpu_topology_get_logical_slot(void)
 {
+    /* Only once an AP is running does the answer depend on who is asking. The
+       BSP keeps the software path below, so the runtime-ID and forced-slot
+       hooks the smokes rely on still steer it; an AP always answers with the
+       slot it was started at, whatever the BSP is simulating meanwhile. */
+    if (cpu_topology_hardware_lookup_enabled)
+    {
+        const uint32_t hardware_apic_id = cpu_topology_read_hardware_apic_id();
+
+        if (hardware_apic_id != cpu_topology_boot_apic_id && hardware_apic_id < CPU_TOPOLOGY_HARDWARE_APIC_IDS &&
+            cpu_topology_hardware_slot_by_apic_id[hardware_apic_id] != CPU_TOPOLOGY_UNBOUND_SLOT)
+            return cpu_topology_hardware_slot_by_apic_id[hardware_apic_id];
+    }
+
     if (cpu_topology_forced_slot_enabled)
         return cpu_topology_forced_slot;
 
@@ -104,6 +139,21 @@ uint32_t cpu_topology_register_discovered_apic_id(uint32_t apic_id)
     return cpu_topology_register_apic_id_internal(apic_id & 0xFFu);
 }
 
+void cpu_topology_bind_hardware_apic_id(uint32_t apic_id, uint32_t slot)
+{
+    if (apic_id >= CPU_TOPOLOGY_HARDWARE_APIC_IDS || slot >= CPU_TOPOLOGY_MAX_LOGICAL_CPUS)
+        return;
+
+    if (!cpu_topology_hardware_lookup_enabled)
+    {
+        for (uint32_t i = 0u; i < CPU_TOPOLOGY_HARDWARE_APIC_IDS; ++i)
+            cpu_topology_hardware_slot_by_apic_id[i] = CPU_TOPOLOGY_UNBOUND_SLOT;
+    }
+
+    cpu_topology_hardware_slot_by_apic_id[apic_id] = (uint8_t) slot;
+    __atomic_store_n(&cpu_topology_hardware_lookup_enabled, 1u, __ATOMIC_RELEASE);
+}
+
 uint32_t cpu_topology_get_local_apic_id(void) { return cpu_topology_local_apic_id; }
 
 void cpu_topology_set_runtime_local_apic_id(uint32_t apic_id)
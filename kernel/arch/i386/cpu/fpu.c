@@ -0,0 +1,346 @@
+/*
+** EPITECH PROJECT, 2026
+** LplKernel
+** File description:
+** fpu — per-CPU, nesting-aware FPU/SSE state handling for the interrupt path
+*/
+
+#include <kernel/cpu/fpu.h>
+#include <kernel/diag/telemetry.h>
+
+#include <string.h>
+
+#define INTERRUPT_FPU_DEVICE_NOT_AVAILABLE_VECTOR 7u
+#define INTERRUPT_FPU_CR0_TS                      (1u << 3u)
+#define INTERRUPT_FPU_CR4_OSXSAVE                 (1u << 18u)
+#define INTERRUPT_FPU_CPUID_ECX_XSAVE             (1u << 26u)
+#define INTERRUPT_FPU_CPUID_XSAVE_LEAF            0x0Du
+#define INTERRUPT_FPU_CPUID_XSAVEOPT_BIT          (1u << 0u)
+#define INTERRUPT_FPU_RESET_FCW                   0x037Fu
+#define INTERRUPT_FPU_RESET_MXCSR                 0x1F80u
+
+/* XCR0 = x87 | SSE. Only what the kernel and the engine actually use: asking
+   for AVX state too would grow every save past the area for registers nobody
+   compiled for. */
+#define INTERRUPT_FPU_XCR0_MASK 0x3u
+
+typedef struct {
+    uint8_t areas[INTERRUPT_FPU_MAX_NESTING][INTERRUPT_FPU_AREA_SIZE] __attribute__((aligned(64)));
+    uint32_t depth;
+    uint32_t saved_mask;      /* bit n: level n saved the interrupted state */
+    uint32_t restore_ts_mask; /* bit n: CR0.TS was set when level n was entered */
+    uint32_t trap_mask;       /* bit n: level n is the #NM of the lazy path itself */
+    uint64_t entry_timestamp[INTERRUPT_FPU_MAX_NESTING];
+    uint32_t interrupts;
+    uint64_t cycles;
+    uint32_t lazy_skipped;
+    uint32_t lazy_saves;
+    uint32_t eager_saves;
+    uint32_t nesting_overflows;
+    uint32_t max_depth;
+} InterruptFpuCpu_t;
+
+static InterruptFpuCpu_t interrupt_fpu_cpus[CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC];
+static bool interrupt_fpu_lazy = false;
+static bool interrupt_fpu_xsaveopt = false;
+
+////////////////////////////////////////////////////////////
+// Private helpers
+////////////////////////////////////////////////////////////
+
+static inline uint32_t interrupt_fpu_read_cr0(void)
+{
+    uint32_t cr0;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    return cr0;
+}
+
+static inline void interrupt_fpu_set_task_switched(uint32_t cr0)
+{
+    __asm__ volatile("mov %0, %%cr0" ::"r"(cr0 | INTERRUPT_FPU_CR0_TS) : "memory");
+}
+
+static inline void interrupt_fpu_clear_task_switched(void) { __asm__ volatile("clts" ::: "memory"); }
+
+static inline void interrupt_fpu_save(uint8_t *area)
+{
+    if (interrupt_fpu_xsaveopt)
+        __asm__ volatile("xsaveopt (%0)" ::"r"(area), "a"(INTERRUPT_FPU_XCR0_MASK), "d"(0u) : "memory");
+    else
+        __asm__ volatile("fxsave (%0)" ::"r"(area) : "memory");
+}
+
+static inline void interrupt_fpu_restore(const uint8_t *area)
+{
+    if (interrupt_fpu_xsaveopt)
+        __asm__ volatile("xrstor (%0)" ::"r"(area), "a"(INTERRUPT_FPU_XCR0_MASK), "d"(0u) : "memory");
+    else
+        __asm__ volatile("fxrstor (%0)" ::"r"(area) : "memory");
+}
+
+static void interrupt_fpu_enable_xsave(void)
+{
+    uint32_t cr4;
+
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    __asm__ volatile("mov %0, %%cr4" ::"r"(cr4 | INTERRUPT_FPU_CR4_OSXSAVE) : "memory");
+    __asm__ volatile("xsetbv" ::"c"(0u), "a"(INTERRUPT_FPU_XCR0_MASK), "d"(0u) : "memory");
+}
+
+static InterruptFpuCpu_t *interrupt_fpu_current_cpu(void)
+{
+    const uint32_t slot = cpu_topology_get_logical_slot();
+
+    return &interrupt_fpu_cpus[(slot < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC) ? slot : 0u];
+}
+
+/* Runs as the handler of the #NM raised by a handler that touched FPU/SSE while
+   its level had CR0.TS armed. The registers still hold the state of the code that
+   was interrupted, so they are saved into the faulting level's area; TS then stays
+   clear for the rest of that handler and the instruction is retried. */
+static void interrupt_fpu_device_not_available(const InterruptFrame_t *frame)
+{
+    (void) frame;
+
+    InterruptFpuCpu_t *cpu = interrupt_fpu_current_cpu();
+    const uint32_t depth = cpu->depth;
+
+    interrupt_fpu_clear_task_switched();
+
+    if (depth < 1u || depth > INTERRUPT_FPU_MAX_NESTING)
+        return;
+
+    /* This #NM is itself level depth-1; it must not re-arm TS on its way out,
+       and it is bookkeeping, not a handler that got away without a save. */
+    cpu->restore_ts_mask &= ~(1u << (depth - 1u));
+    cpu->trap_mask |= (1u << (depth - 1u));
+
+    if (depth < 2u)
+        return;
+
+    const uint32_t owner = depth - 2u;
+    if ((cpu->saved_mask & (1u << owner)) != 0u)
+        return;
+
+    interrupt_fpu_save(cpu->areas[owner]);
+    cpu->saved_mask |= (1u << owner);
+    ++cpu->lazy_saves;
+}
+
+////////////////////////////////////////////////////////////
+// Public API
+////////////////////////////////////////////////////////////
+
+void interrupt_fpu_initialize(void)
+{
+    uint32_t eax = 0u;
+    uint32_t ebx = 0u;
+    uint32_t ecx = 0u;
+    uint32_t edx = 0u;
+
+    asmutils_cpuid(0u, 0u, &eax, &ebx, &ecx, &edx);
+    const uint32_t max_leaf = eax;
+
+    asmutils_cpuid(1u, 0u, &eax, &ebx, &ecx, &edx);
+    if ((ecx & INTERRUPT_FPU_CPUID_ECX_XSAVE) != 0u && max_leaf >= INTERRUPT_FPU_CPUID_XSAVE_LEAF)
+    {
+        asmutils_cpuid(INTERRUPT_FPU_CPUID_XSAVE_LEAF, 1u, &eax, &ebx, &ecx, &edx);
+        if ((eax & INTERRUPT_FPU_CPUID_XSAVEOPT_BIT) != 0u)
+        {
+            interrupt_fpu_enable_xsave();
+            interrupt_fpu_xsaveopt = true;
+        }
+    }
+
+    interrupt_service_routine_register_handler(INTERRUPT_FPU_DEVICE_NOT_AVAILABLE_VECTOR,
+                                               interrupt_fpu_device_not_available);
+    interrupt_fpu_lazy = true;
+}
+
+void interrupt_fpu_initialize_secondary(void)
+{
+    if (interrupt_fpu_xsaveopt)
+        interrupt_fpu_enable_xsave();
+}
+
+void *interrupt_fpu_enter(void)
+{
+    InterruptFpuCpu_t *cpu = interrupt_fpu_current_cpu();
+    const uint32_t depth = ++cpu->depth;
+
+    if (depth > cpu->max_depth)
+        cpu->max_depth = depth;
+
+    if (depth > INTERRUPT_FPU_MAX_NESTING)
+    {
+        ++cpu->nesting_overflows;
+        return cpu;
+    }
+
+    const uint32_t level = depth - 1u;
+    const uint32_t bit = 1u << level;
+    const uint32_t cr0 = interrupt_fpu_read_cr0();
+
+    cpu->entry_timestamp[level] = asmutils_read_timestamp_counter();
+    cpu->saved_mask &= ~bit;
+
+    if ((cr0 & INTERRUPT_FPU_CR0_TS) != 0u)
+        cpu->restore_ts_mask |= bit;
+    else
+        cpu->restore_ts_mask &= ~bit;
+
+    if (interrupt_fpu_lazy)
+    {
+        /* Already set means an outer handler never touched the state: the
+           registers still belong to the code below it, and stay armed. */
+        if ((cr0 & INTERRUPT_FPU_CR0_TS) == 0u)
+            interrupt_fpu_set_task_switched(cr0);
+        return cpu;
+    }
+
+    if ((cr0 & INTERRUPT_FPU_CR0_TS) != 0u)
+        interrupt_fpu_clear_task_switched();
+    interrupt_fpu_save(cpu->areas[level]);
+    cpu->saved_mask |= bit;
+    ++cpu->eager_saves;
+    return cpu;
+}
+
+void interrupt_fpu_leave(void *context)
+{
+    InterruptFpuCpu_t *cpu = (InterruptFpuCpu_t *) context;
+    const uint32_t depth = cpu->depth;
+
+    if (depth > INTERRUPT_FPU_MAX_NESTING)
+    {
+        --cpu->depth;
+        return;
+    }
+
+    const uint32_t level = depth - 1u;
+    const uint32_t bit = 1u << level;
+    const bool saved = (cpu->saved_mask & bit) != 0u;
+    uint32_t cr0 = interrupt_fpu_read_cr0();
+
+    if (saved)
+    {
+        if ((cr0 & INTERRUPT_FPU_CR0_TS) != 0u)
+        {
+            interrupt_fpu_clear_task_switched();
+            cr0 &= ~INTERRUPT_FPU_CR0_TS;
+        }
+        interrupt_fpu_restore(cpu->areas[level]);
+        cpu->saved_mask &= ~bit;
+    }
+    else if ((cpu->trap_mask & bit) == 0u)
+    {
+        ++cpu->lazy_skipped;
+    }
+    cpu->trap_mask &= ~bit;
+
+    const bool want_task_switched = (cpu->restore_ts_mask & bit) != 0u;
+    if (want_task_switched && (cr0 & INTERRUPT_FPU_CR0_TS) == 0u)
+        interrupt_fpu_set_task_switched(cr0);
+    else if (!want_task_switched && (cr0 & INTERRUPT_FPU_CR0_TS) != 0u)
+        interrupt_fpu_clear_task_switched();
+
+    cpu->cycles += asmutils_read_timestamp_counter() - cpu->entry_timestamp[level];
+    ++cpu->interrupts;
+    --cpu->depth;
+}
+
+uint32_t interrupt_fpu_get_depth(void) { return interrupt_fpu_current_cpu()->depth; }
+
+void interrupt_fpu_initialize_area(void *area)
+{
+    uint8_t *bytes = (uint8_t *) area;
+
+    memset(bytes, 0, INTERRUPT_FPU_AREA_SIZE);
+
+    /* FXSAVE layout, which XSAVE keeps for its legacy region: FCW at 0, MXCSR at
+       24. An all-zero XSAVE header marks every component as in its init state,
+       so XRSTOR takes only MXCSR from the area. */
+    *(uint16_t *) (bytes + 0u) = INTERRUPT_FPU_RESET_FCW;
+    *(uint32_t *) (bytes + 24u) = INTERRUPT_FPU_RESET_MXCSR;
+}
+
+bool interrupt_fpu_switch_state(void *save_area, const void *load_area)
+{
+    InterruptFpuCpu_t *cpu = interrupt_fpu_current_cpu();
+
+    if (cpu->depth != 1u)
+        return false;
+
+    if ((cpu->saved_mask & 1u) != 0u)
+    {
+        /* The handler touched FPU/SSE: the interrupted state is in the area. */
+        memcpy(save_area, cpu->areas[0], INTERRUPT_FPU_AREA_SIZE);
+    }
+    else
+    {
+        /* Still in the registers. TS may be armed for the lazy path; leave
+           puts it back the way the level wants it. */
+        interrupt_fpu_clear_task_switched();
+        interrupt_fpu_save((uint8_t *) save_area);
+    }
+
+    /* The level now reads as saved, so its exit loads the incoming state. */
+    memcpy(cpu->areas[0], load_area, INTERRUPT_FPU_AREA_SIZE);
+    cpu->saved_mask |= 1u;
+    return true;
+}
+
+void interrupt_fpu_set_lazy(bool lazy) { interrupt_fpu_lazy = lazy; }
+
+bool interrupt_fpu_is_lazy(void) { return interrupt_fpu_lazy; }
+
+bool interrupt_fpu_uses_xsaveopt(void) { return interrupt_fpu_xsaveopt; }
+
+void interrupt_fpu_get_statistics(InterruptFpuStatistics_t *out)
+{
+    if (!out)
+        return;
+
+    *out = (InterruptFpuStatistics_t) {0};
+    for (uint32_t slot = 0u; slot < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++slot)
+    {
+        const InterruptFpuCpu_t *cpu = &interrupt_fpu_cpus[slot];
+
+        if (cpu->interrupts == 0u && cpu->nesting_overflows == 0u)
+            continue;
+
+        ++out->cpus;
+        out->interrupts += cpu->interrupts;
+        out->cycles += cpu->cycles;
+        out->lazy_skipped += cpu->lazy_skipped;
+        out->lazy_saves += cpu->lazy_saves;
+        out->eager_saves += cpu->eager_saves;
+        out->nesting_overflows += cpu->nesting_overflows;
+        if (cpu->max_depth > out->max_depth)
+            out->max_depth = cpu->max_depth;
+    }
+}
+
+void interrupt_fpu_report(Serial_t *serial_port)
+{
+    InterruptFpuStatistics_t statistics;
+
+    interrupt_fpu_get_statistics(&statistics);
+
+    const uint32_t average = (statistics.interrupts != 0u)
+                                 ? (uint32_t) (statistics.cycles / (uint64_t) statistics.interrupts)
+                                 : 0u;
+
+    kernel_telemetry_begin_record(serial_port, "irq_fpu");
+    kernel_telemetry_write_text("mode", interrupt_fpu_lazy ? "lazy" : "eager");
+    kernel_telemetry_write_text("save", interrupt_fpu_xsaveopt ? "xsaveopt" : "fxsave");
+    kernel_telemetry_write_unsigned("cpus", statistics.cpus);
+    kernel_telemetry_write_unsigned("interrupts", statistics.interrupts);
+    kernel_telemetry_write_unsigned("avg_cycles", average);
+    kernel_telemetry_write_unsigned("lazy_skipped", statistics.lazy_skipped);
+    kernel_telemetry_write_unsigned("lazy_saves", statistics.lazy_saves);
+    kernel_telemetry_write_unsigned("eager_saves", statistics.eager_saves);
+    kernel_telemetry_write_unsigned("nesting_overflows", statistics.nesting_overflows);
+    kernel_telemetry_write_unsigned("max_depth", statistics.max_depth);
+    kernel_telemetry_end_record();
+}
@@ -88,3 +88,16 @@ void global_descriptor_table_load(GlobalDescriptorTable_t *gdt)
     const uint16_t tss_selector = (uint16_t) offsetof(GlobalDescriptorTable_t, task_state_segment);
     task_state_segment_load(tss_selector);
 }
+
+void global_descriptor_table_load_secondary(GlobalDescriptorTable_t *gdt)
+{
+    if (!gdt)
+        return;
+
+    GlobalDescriptorTablePointer_t gdtr;
+    gdtr.limit = sizeof(GlobalDescriptorTable_t) - 1;
+    gdtr.base = (uint32_t) gdt;
+
+    gdt_load(&gdtr);
+    gdt_flush();
+}
@@ -2,6 +2,8 @@
 
 #define IDT_EXCEPTION_VECTOR_COUNT 32u
 #define IDT_IRQ_VECTOR_COUNT       16u
+#define IDT_DEVICE_VECTOR_BASE     0x50u
+#define IDT_DEVICE_VECTOR_COUNT    32u
 #define IDT_TOTAL_VECTOR_COUNT     256u
 
 ////////////////////////////////////////////////////////////
@@ -66,6 +68,13 @@ static const interrupt_service_routine_function_t idt_irq_stubs[IDT_IRQ_VECTOR_C
     isr32, isr33, isr34, isr35, isr36, isr37, isr38, isr39, isr40, isr41, isr42, isr43, isr44, isr45, isr46, isr47,
 };
 
+/* Vectors 0x50-0x6F: no fixed owner, allocated to devices at run time (interrupt_vector.c). */
+static const interrupt_service_routine_function_t idt_device_stubs[IDT_DEVICE_VECTOR_COUNT] = {
+    isr80,  isr81,  isr82,  isr83,  isr84,  isr85,  isr86,  isr87,  isr88,  isr89,  isr90,  isr91,  isr92,  isr93,
+    isr94,  isr95,  isr96,  isr97,  isr98,  isr99,  isr100, isr101, isr102, isr103, isr104, isr105, isr106, isr107,
+    isr108, isr109, isr110, isr111,
+};
+
 static void interrupt_descriptor_table_clear(InterruptDescriptorTable_t *idt)
 {
     for (size_t i = 0; i < IDT_TOTAL_VECTOR_COUNT; ++i)
@@ -99,6 +108,21 @@ void interrupt_descriptor_table_initialize(InterruptDescriptorTable_t *idt)
     interrupt_descriptor_table_encode_flat_entry(&idt->entries[0x40u], (void *) isr64, GDT_KERNEL_CODE_SELECTOR,
                                                  IDT_KERNEL_INTERRUPT_GATE);
 
+    interrupt_descriptor_table_encode_flat_entry(&idt->entries[0x41u], (void *) isr65, GDT_KERNEL_CODE_SELECTOR,
+                                                 IDT_KERNEL_INTERRUPT_GATE);
+
+    interrupt_descriptor_table_encode_flat_entry(&idt->entries[0x42u], (void *) isr66, GDT_KERNEL_CODE_SELECTOR,
+                                                 IDT_KERNEL_INTERRUPT_GATE);
+
+    interrupt_descriptor_table_encode_flat_entry(&idt->entries[0x43u], (void *) isr67, GDT_KERNEL_CODE_SELECTOR,
+                                                 IDT_KERNEL_INTERRUPT_GATE);
+
+    interrupt_descriptor_table_encode_flat_entry(&idt->entries[0x44u], (void *) isr68, GDT_KERNEL_CODE_SELECTOR,
+                                                 IDT_KERNEL_INTERRUPT_GATE);
+
+    interrupt_descriptor_table_install_vector_range(idt, IDT_DEVICE_VECTOR_BASE, idt_device_stubs,
+                                                    IDT_DEVICE_VECTOR_COUNT);
+
     interrupt_descriptor_table_encode_flat_entry(&idt->entries[0x80u], (void *) isr128, GDT_KERNEL_CODE_SELECTOR,
                                                  IDT_USER_INTERRUPT_GATE);
 }
@@ -0,0 +1,488 @@
+/**
+ * @file interrupt_affinity.c
+ * @brief IRQ balancer: per-vector rates, dedicated real-time cores, retargeting.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#include <kernel/cpu/interrupt_affinity.h>
+
+#include <kernel/core/lock.h>
+#include <kernel/core/timer.h>
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/cpu/interrupt_vector.h>
+#include <kernel/cpu/ioapic.h>
+#include <kernel/cpu/irq.h>
+#include <kernel/cpu/isr.h>
+#include <kernel/cpu/msi.h>
+#include <kernel/diag/telemetry.h>
+#include <kernel/lib/asmutils.h>
+
+#include <stddef.h>
+
+/* The PIT's line: when the IOAPIC carries it, it is the tick itself, not a load on it. */
+#define INTERRUPT_AFFINITY_TICK_LINE 0u
+
+#define INTERRUPT_AFFINITY_NO_CPU 0xFFFFFFFFu
+
+typedef struct {
+    bool used;
+    InterruptAffinitySource_t source;
+    uint32_t last_count;
+    bool sampled;                     /* last_count holds a real sample */
+} InterruptAffinityEntry_t;
+
+static InterruptAffinityEntry_t interrupt_affinity_entries[INTERRUPT_AFFINITY_MAX_SOURCES];
+static KernelTicketLock_t interrupt_affinity_lock;
+static KernelTimer_t interrupt_affinity_timer;
+static bool interrupt_affinity_periodic = false;
+static uint32_t interrupt_affinity_tick_cpu = 0u;
+static uint64_t interrupt_affinity_last_pass = 0u;
+
+static uint32_t interrupt_affinity_passes = 0u;
+static uint32_t interrupt_affinity_moves = 0u;
+static uint32_t interrupt_affinity_failed_moves = 0u;
+static uint32_t interrupt_affinity_spare_cpus = 0u;
+static uint32_t interrupt_affinity_dedicated_cpus = 0u;
+
+static InterruptAffinityEntry_t *interrupt_affinity_find(uint8_t vector, bool create)
+{
+    InterruptAffinityEntry_t *unused = NULL;
+
+    for (uint32_t index = 0u; index < INTERRUPT_AFFINITY_MAX_SOURCES; ++index)
+    {
+        InterruptAffinityEntry_t *const entry = &interrupt_affinity_entries[index];
+        if (entry->used && entry->source.vector == vector)
+            return entry;
+        if (!entry->used && unused == NULL)
+            unused = entry;
+    }
+
+    /* A full table is reclaimed from sources that are gone and were never given a policy. */
+    for (uint32_t index = 0u; create && unused == NULL && index < INTERRUPT_AFFINITY_MAX_SOURCES; ++index)
+    {
+        InterruptAffinityEntry_t *const entry = &interrupt_affinity_entries[index];
+        if (!entry->source.present && entry->source.policy == INTERRUPT_AFFINITY_POLICY_BALANCED)
+            unused = entry;
+    }
+    if (!create || unused == NULL)
+        return NULL;
+
+    *unused = (InterruptAffinityEntry_t) {0};
+    unused->used = true;
+    unused->source.vector = vector;
+    unused->source.line = INTERRUPT_AFFINITY_NO_LINE;
+    unused->source.cpu = INTERRUPT_AFFINITY_NO_CPU;
+    return unused;
+}
+
+static uint32_t interrupt_affinity_slot_of_apic_id(uint32_t apic_id)
+{
+    for (uint32_t slot = 0u; slot < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++slot)
+    {
+        if (cpu_topology_is_logical_slot_online(slot) && cpu_topology_get_apic_id_at_slot(slot) == apic_id)
+            return slot;
+    }
+    return INTERRUPT_AFFINITY_NO_CPU;
+}
+
+/** @brief Mark present every IOAPIC line the local APICs own and every message vector. */
+static void interrupt_affinity_scan(void)
+{
+    for (uint32_t index = 0u; index < INTERRUPT_AFFINITY_MAX_SOURCES; ++index)
+        interrupt_affinity_entries[index].source.present = false;
+
+    const uint8_t routes = input_output_advanced_programmable_interrupt_controller_get_programmed_route_count();
+    for (uint8_t route = 0u; route < routes; ++route)
+    {
+        const uint8_t line = input_output_advanced_programmable_interrupt_controller_get_programmed_route_irq(route);
+
+        /* A masked route, or one the 8259 still delivers, goes to the BSP whatever
+           its destination says. */
+        if (input_output_advanced_programmable_interrupt_controller_get_programmed_route_is_masked(route) ||
+            !interrupt_request_is_line_owner_apic(line))
+            continue;
+
+        InterruptAffinityEntry_t *const entry = interrupt_affinity_find(
+            input_output_advanced_programmable_interrupt_controller_get_programmed_route_vector(route), true);
+        if (entry == NULL)
+            continue;
+
+        entry->source.present = true;
+        entry->source.kind = INTERRUPT_AFFINITY_KIND_LINE;
+        entry->source.line = line;
+        entry->source.cpu = interrupt_affinity_slot_of_apic_id(
+            input_output_advanced_programmable_interrupt_controller_get_programmed_route_destination_apic_id(route));
+        if (line == INTERRUPT_AFFINITY_TICK_LINE)
+            entry->source.policy = INTERRUPT_AFFINITY_POLICY_TICK;
+    }
+
+    for (uint32_t vector = INTERRUPT_VECTOR_DEVICE_BASE; vector <= INTERRUPT_VECTOR_DEVICE_LAST; ++vector)
+    {
+        if (!message_signaled_interrupt_owns_vector((uint8_t) vector))
+            continue;
+
+        InterruptAffinityEntry_t *const entry = interrupt_affinity_find((uint8_t) vector, true);
+        InterruptVectorStatistics_t statistics;
+        if (entry == NULL || !interrupt_vector_get_statistics((uint8_t) vector, &statistics))
+            continue;
+
+        entry->source.present = true;
+        entry->source.kind = INTERRUPT_AFFINITY_KIND_MESSAGE;
+        entry->source.line = INTERRUPT_AFFINITY_NO_LINE;
+        entry->source.cpu = statistics.target_cpu;
+    }
+}
+
+/** @brief Fold the deliveries since the last pass into each present source's rate. */
+static void interrupt_affinity_sample(uint64_t now)
+{
+    const uint32_t elapsed_us = interrupt_affinity_last_pass != 0u && now > interrupt_affinity_last_pass
+                                    ? kernel_timer_cycles_to_microseconds(now - interrupt_affinity_last_pass)
+                                    : 0u;
+    interrupt_affinity_last_pass = now;
+
+    for (uint32_t index = 0u; index < INTERRUPT_AFFINITY_MAX_SOURCES; ++index)
+    {
+        InterruptAffinityEntry_t *const entry = &interrupt_affinity_entries[index];
+        if (!entry->used || !entry->source.present)
+            continue;
+
+        const uint32_t count = interrupt_service_routine_get_delivery_count(entry->source.vector);
+        if (entry->sampled && elapsed_us != 0u)
+        {
+            const uint32_t rate = (uint32_t) (((uint64_t) (count - entry->last_count) * 1000000u) / elapsed_us);
+
+            /* Half of the new sample each pass: a burst shows within two passes and
+               fades within a few. */
+            entry->source.rate_per_second = (entry->source.rate_per_second + rate) / 2u;
+        }
+        entry->source.deliveries = count;
+        entry->last_count = count;
+        entry->sampled = true;
+    }
+}
+
+static bool interrupt_affinity_retarget(InterruptAffinityEntry_t *entry, uint32_t cpu)
+{
+    bool applied;
+
+    if (entry->source.kind == INTERRUPT_AFFINITY_KIND_LINE)
+        applied = input_output_advanced_programmable_interrupt_controller_set_isa_route_destination(
+                      entry->source.line, (uint8_t) cpu_topology_get_apic_id_at_slot(cpu)) != 0u;
+    else
+        applied = message_signaled_interrupt_set_affinity(entry->source.vector, cpu);
+
+    if (!applied)
+    {
+        ++interrupt_affinity_failed_moves;
+        return false;
+    }
+
+    entry->source.cpu = cpu;
+    ++entry->source.moves;
+    ++interrupt_affinity_moves;
+    return true;
+}
+
+/** @brief The least loaded CPU of @p allowed; the lowest slot on a tie. */
+static uint32_t interrupt_affinity_least_loaded(const bool *allowed, const uint32_t *load)
+{
+    uint32_t best = INTERRUPT_AFFINITY_NO_CPU;
+    for (uint32_t slot = 0u; slot < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++slot)
+    {
+        if (allowed[slot] && (best == INTERRUPT_AFFINITY_NO_CPU || load[slot] < load[best]))
+            best = slot;
+    }
+    return best;
+}
+
+/** @brief Choose every present source's CPU and apply the ones that changed. Lock held. */
+static uint32_t interrupt_affinity_place(void)
+{
+    bool spare[CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC] = {false};
+    bool general[CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC] = {false};
+    uint32_t load[CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC] = {0u};
+    uint32_t target[INTERRUPT_AFFINITY_MAX_SOURCES];
+    uint32_t spare_count = 0u;
+
+    for (uint32_t slot = 0u; slot < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++slot)
+    {
+        spare[slot] = slot != interrupt_affinity_tick_cpu && cpu_topology_is_logical_slot_online(slot);
+        general[slot] = spare[slot];
+        spare_count += spare[slot] ? 1u : 0u;
+    }
+    interrupt_affinity_spare_cpus = spare_count;
+    interrupt_affinity_dedicated_cpus = 0u;
+
+    for (uint32_t index = 0u; index < INTERRUPT_AFFINITY_MAX_SOURCES; ++index)
+        target[index] = INTERRUPT_AFFINITY_NO_CPU;
+
+    if (spare_count == 0u)
+        return 0u;
+
+    /* Pins first: a pinned CPU other than the tick's takes nothing else while
+       another spare CPU can. */
+    uint32_t general_count = spare_count;
+    for (uint32_t index = 0u; index < INTERRUPT_AFFINITY_MAX_SOURCES; ++index)
+    {
+        const InterruptAffinityEntry_t *const entry = &interrupt_affinity_entries[index];
+        if (!entry->used || !entry->source.present)
+            continue;
+
+        if (entry->source.policy == INTERRUPT_AFFINITY_POLICY_TICK)
+            target[index] = interrupt_affinity_tick_cpu;
+        else if (entry->source.policy == INTERRUPT_AFFINITY_POLICY_PINNED &&
+                 cpu_topology_is_logical_slot_online(entry->source.pinned_cpu))
+        {
+            const uint32_t cpu = entry->source.pinned_cpu;
+            target[index] = cpu;
+            if (cpu < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC && general[cpu] && general_count > 1u)
+            {
+                general[cpu] = false;
+                --general_count;
+            }
+        }
+    }
+
+    /* Real-time sources: one core each from the top down, always leaving one
+       spare CPU to the rest. Past that they share the last core handed out, or
+       when none could be, take their chances with the rest. */
+    uint32_t next_dedicated = CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC;
+    uint32_t last_dedicated = INTERRUPT_AFFINITY_NO_CPU;
+    for (uint32_t index = 0u; index < INTERRUPT_AFFINITY_MAX_SOURCES; ++index)
+    {
+        const InterruptAffinityEntry_t *const entry = &interrupt_affinity_entries[index];
+        if (!entry->used || !entry->source.present || entry->source.policy != INTERRUPT_AFFINITY_POLICY_REAL_TIME)
+            continue;
+
+        while (next_dedicated > 0u && general_count > 1u)
+        {
+            --next_dedicated;
+            if (!general[next_dedicated])
+                continue;
+            general[next_dedicated] = false;
+            --general_count;
+            ++interrupt_affinity_dedicated_cpus;
+            last_dedicated = next_dedicated;
+            break;
+        }
+        target[index] = last_dedicated;
+    }
+
+    /* Everything else, busiest first, onto the least loaded general CPU. */
+    for (;;)
+    {
+        uint32_t busiest = INTERRUPT_AFFINITY_MAX_SOURCES;
+        for (uint32_t index = 0u; index < INTERRUPT_AFFINITY_MAX_SOURCES; ++index)
+        {
+            const InterruptAffinityEntry_t *const entry = &interrupt_affinity_entries[index];
+            if (!entry->used || !entry->source.present || target[index] != INTERRUPT_AFFINITY_NO_CPU)
+                continue;
+            if (busiest == INTERRUPT_AFFINITY_MAX_SOURCES ||
+                entry->source.rate_per_second > interrupt_affinity_entries[busiest].source.rate_per_second)
+                busiest = index;
+        }
+        if (busiest == INTERRUPT_AFFINITY_MAX_SOURCES)
+            break;
+
+        const InterruptAffinitySource_t *const source = &interrupt_affinity_entries[busiest].source;
+        const uint32_t current = source->cpu;
+        uint32_t cpu = interrupt_affinity_least_loaded(general, load);
+        if (current < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC && general[current] &&
+            load[current] <= load[cpu] + INTERRUPT_AFFINITY_HYSTERESIS_PER_SECOND)
+            cpu = current;
+
+        target[busiest] = cpu;
+        /* Plus one, so sources that are quiet for now still spread out. */
+        load[cpu] += source->rate_per_second + 1u;
+    }
+
+    uint32_t moved = 0u;
+    for (uint32_t index = 0u; index < INTERRUPT_AFFINITY_MAX_SOURCES; ++index)
+    {
+        InterruptAffinityEntry_t *const entry = &interrupt_affinity_entries[index];
+        if (!entry->used || !entry->source.present || target[index] == INTERRUPT_AFFINITY_NO_CPU ||
+            target[index] == entry->source.cpu)
+            continue;
+        if (interrupt_affinity_retarget(entry, target[index]))
+            ++moved;
+    }
+    return moved;
+}
+
+uint32_t interrupt_affinity_balance(void)
+{
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&interrupt_affinity_lock);
+    interrupt_affinity_scan();
+    interrupt_affinity_sample(asmutils_read_timestamp_counter());
+    const uint32_t moved = interrupt_affinity_place();
+    ++interrupt_affinity_passes;
+    kernel_ticket_lock_release_irqrestore(&interrupt_affinity_lock, flags);
+    return moved;
+}
+
+static void interrupt_affinity_due(KernelTimer_t *timer, void *context)
+{
+    (void) timer;
+    (void) context;
+    (void) interrupt_affinity_balance();
+}
+
+bool interrupt_affinity_initialize(void)
+{
+    if (!interrupt_affinity_periodic && kernel_timer_is_active())
+    {
+        kernel_timer_setup(&interrupt_affinity_timer, "irq_balance", interrupt_affinity_due, NULL, 0u);
+        interrupt_affinity_periodic =
+            kernel_timer_arm_microseconds(&interrupt_affinity_timer, INTERRUPT_AFFINITY_INTERVAL_MICROSECONDS,
+                                          INTERRUPT_AFFINITY_INTERVAL_MICROSECONDS);
+    }
+
+    (void) interrupt_affinity_balance();
+    return interrupt_affinity_periodic;
+}
+
+void interrupt_affinity_set_tick_cpu(uint32_t cpu_slot)
+{
+    if (cpu_slot < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC)
+        interrupt_affinity_tick_cpu = cpu_slot;
+}
+
+uint32_t interrupt_affinity_get_tick_cpu(void) { return interrupt_affinity_tick_cpu; }
+
+bool interrupt_affinity_mark_real_time(uint8_t vector)
+{
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&interrupt_affinity_lock);
+    InterruptAffinityEntry_t *const entry = interrupt_affinity_find(vector, true);
+    if (entry != NULL)
+        entry->source.policy = INTERRUPT_AFFINITY_POLICY_REAL_TIME;
+    kernel_ticket_lock_release_irqrestore(&interrupt_affinity_lock, flags);
+
+    if (entry != NULL)
+        (void) interrupt_affinity_balance();
+    return entry != NULL;
+}
+
+bool interrupt_affinity_pin(uint8_t vector, uint32_t cpu_slot)
+{
+    if (!cpu_topology_is_logical_slot_online(cpu_slot))
+        return false;
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&interrupt_affinity_lock);
+    InterruptAffinityEntry_t *const entry = interrupt_affinity_find(vector, true);
+    if (entry != NULL)
+    {
+        entry->source.policy = INTERRUPT_AFFINITY_POLICY_PINNED;
+        entry->source.pinned_cpu = cpu_slot;
+    }
+    kernel_ticket_lock_release_irqrestore(&interrupt_affinity_lock, flags);
+
+    if (entry != NULL)
+        (void) interrupt_affinity_balance();
+    return entry != NULL;
+}
+
+void interrupt_affinity_unpin(uint8_t vector)
+{
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&interrupt_affinity_lock);
+    InterruptAffinityEntry_t *const entry = interrupt_affinity_find(vector, false);
+    if (entry != NULL && entry->source.policy != INTERRUPT_AFFINITY_POLICY_TICK)
+        entry->source.policy = INTERRUPT_AFFINITY_POLICY_BALANCED;
+    kernel_ticket_lock_release_irqrestore(&interrupt_affinity_lock, flags);
+}
+
+bool interrupt_affinity_get_source(uint32_t index, InterruptAffinitySource_t *out)
+{
+    if (index >= INTERRUPT_AFFINITY_MAX_SOURCES || out == NULL || !interrupt_affinity_entries[index].used)
+        return false;
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&interrupt_affinity_lock);
+    *out = interrupt_affinity_entries[index].source;
+    kernel_ticket_lock_release_irqrestore(&interrupt_affinity_lock, flags);
+    return true;
+}
+
+void interrupt_affinity_get_statistics(InterruptAffinityStatistics_t *out)
+{
+    if (out == NULL)
+        return;
+
+    *out = (InterruptAffinityStatistics_t) {0};
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&interrupt_affinity_lock);
+    out->periodic = interrupt_affinity_periodic;
+    out->tick_cpu = interrupt_affinity_tick_cpu;
+    out->spare_cpus = interrupt_affinity_spare_cpus;
+    out->dedicated_cpus = interrupt_affinity_dedicated_cpus;
+    out->passes = interrupt_affinity_passes;
+    out->moves = interrupt_affinity_moves;
+    out->failed_moves = interrupt_affinity_failed_moves;
+
+    for (uint32_t index = 0u; index < INTERRUPT_AFFINITY_MAX_SOURCES; ++index)
+    {
+        const InterruptAffinitySource_t *const source = &interrupt_affinity_entries[index].source;
+        if (!interrupt_affinity_entries[index].used || !source->present)
+            continue;
+
+        ++out->sources;
+        out->real_time_sources += source->policy == INTERRUPT_AFFINITY_POLICY_REAL_TIME ? 1u : 0u;
+        if (source->cpu == interrupt_affinity_tick_cpu && source->policy != INTERRUPT_AFFINITY_POLICY_TICK &&
+            !(source->policy == INTERRUPT_AFFINITY_POLICY_PINNED && source->pinned_cpu == interrupt_affinity_tick_cpu))
+            ++out->on_tick_cpu;
+    }
+    kernel_ticket_lock_release_irqrestore(&interrupt_affinity_lock, flags);
+}
+
+const char *interrupt_affinity_policy_name(InterruptAffinityPolicy_t policy)
+{
+    switch (policy)
+    {
+    case INTERRUPT_AFFINITY_POLICY_REAL_TIME: return "rt";
+    case INTERRUPT_AFFINITY_POLICY_PINNED: return "pinned";
+    case INTERRUPT_AFFINITY_POLICY_TICK: return "tick";
+    case INTERRUPT_AFFINITY_POLICY_BALANCED:
+    default: return "balanced";
+    }
+}
+
+void interrupt_affinity_report(Serial_t *serial)
+{
+    InterruptAffinityStatistics_t statistics;
+
+    interrupt_affinity_get_statistics(&statistics);
+
+    kernel_telemetry_begin_record(serial, "irq_affinity");
+    kernel_telemetry_write_boolean("periodic", statistics.periodic);
+    kernel_telemetry_write_unsigned("tick_cpu", statistics.tick_cpu);
+    kernel_telemetry_write_unsigned("spare_cpus", statistics.spare_cpus);
+    kernel_telemetry_write_unsigned("dedicated_cpus", statistics.dedicated_cpus);
+    kernel_telemetry_write_unsigned("sources", statistics.sources);
+    kernel_telemetry_write_unsigned("real_time", statistics.real_time_sources);
+    kernel_telemetry_write_unsigned("on_tick_cpu", statistics.on_tick_cpu);
+    kernel_telemetry_write_unsigned("passes", statistics.passes);
+    kernel_telemetry_write_unsigned("moves", statistics.moves);
+    kernel_telemetry_write_unsigned("failed_moves", statistics.failed_moves);
+    kernel_telemetry_end_record();
+
+    for (uint32_t index = 0u; index < INTERRUPT_AFFINITY_MAX_SOURCES; ++index)
+    {
+        InterruptAffinitySource_t source;
+        if (!interrupt_affinity_get_source(index, &source) || !source.present)
+            continue;
+
+        kernel_telemetry_begin_record(serial, "irq_source");
+        kernel_telemetry_write_unsigned("vector", source.vector);
+        kernel_telemetry_write_text("kind", source.kind == INTERRUPT_AFFINITY_KIND_LINE ? "line" : "message");
+        if (source.kind == INTERRUPT_AFFINITY_KIND_LINE)
+            kernel_telemetry_write_unsigned("line", source.line);
+        kernel_telemetry_write_text("policy", interrupt_affinity_policy_name(source.policy));
+        kernel_telemetry_write_unsigned("cpu", source.cpu);
+        kernel_telemetry_write_unsigned("rate_per_s", source.rate_per_second);
+        kernel_telemetry_write_unsigned("deliveries", source.deliveries);
+        kernel_telemetry_write_unsigned("moves", source.moves);
+        kernel_telemetry_end_record();
+    }
+}
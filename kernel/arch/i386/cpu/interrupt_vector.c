@@ -0,0 +1,230 @@
+/**
+ * @file interrupt_vector.c
+ * @brief Device vector allocation and the dispatcher that accounts each delivery.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#include <kernel/cpu/interrupt_vector.h>
+
+#include <kernel/core/lock.h>
+#include <kernel/cpu/apic_timer.h>
+#include <kernel/cpu/isr.h>
+#include <kernel/diag/telemetry.h>
+#include <kernel/lib/asmutils.h>
+
+#include <stddef.h>
+
+typedef struct {
+    bool allocated;
+    const char *owner;
+    interrupt_vector_handler_t handler;
+    void *context;
+    uint32_t target_cpu;
+    volatile uint32_t deliveries;
+    volatile uint32_t unclaimed;
+    uint32_t last_cpu;
+    uint64_t handler_cycles;
+    uint32_t handler_max_cycles;
+    uint32_t latency_samples;
+    uint64_t latency_total_us;
+    uint32_t latency_max_us;
+    uint32_t latency_last_us;
+    uint32_t deliveries_per_cpu[CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC];
+} InterruptVectorEntry_t;
+
+static InterruptVectorEntry_t interrupt_vector_entries[INTERRUPT_VECTOR_DEVICE_COUNT];
+static KernelTicketLock_t interrupt_vector_lock;
+
+static InterruptVectorEntry_t *interrupt_vector_entry(uint8_t vector)
+{
+    if (vector < INTERRUPT_VECTOR_DEVICE_BASE || vector > INTERRUPT_VECTOR_DEVICE_LAST)
+        return NULL;
+    return &interrupt_vector_entries[vector - INTERRUPT_VECTOR_DEVICE_BASE];
+}
+
+/**
+ * @brief Every device vector lands here: run the owner's handler, account, EOI.
+ *
+ * A message is delivered to a local APIC and nowhere else, so the end-of-interrupt
+ * is always the local APIC's, whoever the device was. A vector that fires with no
+ * owner (a source left pointing at it after a free) is acknowledged and counted.
+ *
+ * One source targets one CPU at a time, so the counters below have one writer;
+ * only the delivery counts, which a retarget can briefly split, are atomic.
+ */
+static void interrupt_vector_dispatch(const InterruptFrame_t *frame)
+{
+    InterruptVectorEntry_t *const entry = interrupt_vector_entry((uint8_t) frame->int_no);
+    if (entry == NULL)
+        return;
+
+    const interrupt_vector_handler_t handler = entry->handler;
+    if (!entry->allocated || handler == NULL)
+    {
+        __atomic_add_fetch(&entry->unclaimed, 1u, __ATOMIC_RELAXED);
+        advanced_pic_timer_backend_signal_end_of_interrupt();
+        return;
+    }
+
+    const uint32_t cpu = cpu_topology_get_logical_slot();
+    const uint64_t start = asmutils_read_timestamp_counter();
+    handler((uint8_t) frame->int_no, entry->context);
+    const uint64_t elapsed = asmutils_read_timestamp_counter() - start;
+    const uint32_t cycles = elapsed > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t) elapsed;
+
+    __atomic_add_fetch(&entry->deliveries, 1u, __ATOMIC_RELAXED);
+    if (cpu < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC)
+        __atomic_add_fetch(&entry->deliveries_per_cpu[cpu], 1u, __ATOMIC_RELAXED);
+    entry->last_cpu = cpu;
+    entry->handler_cycles += cycles;
+    if (cycles > entry->handler_max_cycles)
+        entry->handler_max_cycles = cycles;
+
+    advanced_pic_timer_backend_signal_end_of_interrupt();
+}
+
+uint8_t interrupt_vector_allocate(uint32_t count, const char *owner, interrupt_vector_handler_t handler, void *context)
+{
+    if (handler == NULL || count == 0u || count > INTERRUPT_VECTOR_MAX_BLOCK || (count & (count - 1u)) != 0u)
+        return INTERRUPT_VECTOR_NONE;
+
+    uint8_t first = INTERRUPT_VECTOR_NONE;
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&interrupt_vector_lock);
+
+    /* The device base is a multiple of the largest block, so stepping the index by
+       count is enough to keep the vector itself aligned. */
+    for (uint32_t index = 0u; index + count <= INTERRUPT_VECTOR_DEVICE_COUNT && first == INTERRUPT_VECTOR_NONE;
+         index += count)
+    {
+        bool free = true;
+        for (uint32_t offset = 0u; offset < count && free; ++offset)
+            free = !interrupt_vector_entries[index + offset].allocated;
+        if (!free)
+            continue;
+
+        for (uint32_t offset = 0u; offset < count; ++offset)
+        {
+            InterruptVectorEntry_t *const entry = &interrupt_vector_entries[index + offset];
+
+            *entry = (InterruptVectorEntry_t) {0};
+            entry->owner = owner;
+            entry->handler = handler;
+            entry->context = context;
+            entry->allocated = true;
+            interrupt_service_routine_register_handler((uint8_t) (INTERRUPT_VECTOR_DEVICE_BASE + index + offset),
+                                                       interrupt_vector_dispatch);
+        }
+        first = (uint8_t) (INTERRUPT_VECTOR_DEVICE_BASE + index);
+    }
+
+    kernel_ticket_lock_release_irqrestore(&interrupt_vector_lock, flags);
+    return first;
+}
+
+void interrupt_vector_free(uint8_t vector, uint32_t count)
+{
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&interrupt_vector_lock);
+    for (uint32_t offset = 0u; offset < count; ++offset)
+    {
+        InterruptVectorEntry_t *const entry = interrupt_vector_entry((uint8_t) (vector + offset));
+        if (entry == NULL)
+            break;
+
+        /* The dispatcher stays registered: a message already in flight still finds
+           someone to acknowledge it. */
+        entry->allocated = false;
+        entry->handler = NULL;
+        entry->context = NULL;
+    }
+    kernel_ticket_lock_release_irqrestore(&interrupt_vector_lock, flags);
+}
+
+bool interrupt_vector_is_allocated(uint8_t vector)
+{
+    const InterruptVectorEntry_t *const entry = interrupt_vector_entry(vector);
+    return entry != NULL && entry->allocated;
+}
+
+void interrupt_vector_note_target(uint8_t vector, uint32_t cpu_slot)
+{
+    InterruptVectorEntry_t *const entry = interrupt_vector_entry(vector);
+    if (entry != NULL)
+        entry->target_cpu = cpu_slot;
+}
+
+void interrupt_vector_record_latency(uint8_t vector, uint32_t microseconds)
+{
+    InterruptVectorEntry_t *const entry = interrupt_vector_entry(vector);
+    if (entry == NULL || !entry->allocated)
+        return;
+
+    ++entry->latency_samples;
+    entry->latency_total_us += microseconds;
+    entry->latency_last_us = microseconds;
+    if (microseconds > entry->latency_max_us)
+        entry->latency_max_us = microseconds;
+}
+
+bool interrupt_vector_get_statistics(uint8_t vector, InterruptVectorStatistics_t *out)
+{
+    const InterruptVectorEntry_t *const entry = interrupt_vector_entry(vector);
+    if (entry == NULL || out == NULL)
+        return false;
+
+    *out = (InterruptVectorStatistics_t) {0};
+    out->vector = vector;
+    out->allocated = entry->allocated;
+    out->owner = entry->owner;
+    out->target_cpu = entry->target_cpu;
+    out->deliveries = entry->deliveries;
+    out->unclaimed = entry->unclaimed;
+    out->last_cpu = entry->last_cpu;
+    out->handler_average_cycles = out->deliveries != 0u ? (uint32_t) (entry->handler_cycles / out->deliveries) : 0u;
+    out->handler_max_cycles = entry->handler_max_cycles;
+    out->latency_samples = entry->latency_samples;
+    out->latency_average_us =
+        entry->latency_samples != 0u ? (uint32_t) (entry->latency_total_us / entry->latency_samples) : 0u;
+    out->latency_max_us = entry->latency_max_us;
+    out->latency_last_us = entry->latency_last_us;
+    for (uint32_t cpu = 0u; cpu < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++cpu)
+        out->deliveries_per_cpu[cpu] = entry->deliveries_per_cpu[cpu];
+    return true;
+}
+
+uint32_t interrupt_vector_get_allocated_count(void)
+{
+    uint32_t count = 0u;
+    for (uint32_t index = 0u; index < INTERRUPT_VECTOR_DEVICE_COUNT; ++index)
+        count += interrupt_vector_entries[index].allocated ? 1u : 0u;
+    return count;
+}
+
+void interrupt_vector_report(Serial_t *serial)
+{
+    for (uint32_t index = 0u; index < INTERRUPT_VECTOR_DEVICE_COUNT; ++index)
+    {
+        InterruptVectorStatistics_t statistics;
+        const uint8_t vector = (uint8_t) (INTERRUPT_VECTOR_DEVICE_BASE + index);
+
+        if (!interrupt_vector_get_statistics(vector, &statistics) || !statistics.allocated)
+            continue;
+
+        kernel_telemetry_begin_record(serial, "irq_vector");
+        kernel_telemetry_write_unsigned("vector", vector);
+        kernel_telemetry_write_text("owner", statistics.owner != NULL ? statistics.owner : "?");
+        kernel_telemetry_write_unsigned("cpu", statistics.target_cpu);
+        kernel_telemetry_write_unsigned("deliveries", statistics.deliveries);
+        kernel_telemetry_write_unsigned("unclaimed", statistics.unclaimed);
+        kernel_telemetry_write_unsigned("last_cpu", statistics.last_cpu);
+        kernel_telemetry_write_unsigned("handler_avg_cycles", statistics.handler_average_cycles);
+        kernel_telemetry_write_unsigned("handler_max_cycles", statistics.handler_max_cycles);
+        kernel_telemetry_write_unsigned("latency_samples", statistics.latency_samples);
+        kernel_telemetry_write_unsigned("latency_avg_us", statistics.latency_average_us);
+        kernel_telemetry_write_unsigned("latency_max_us", statistics.latency_max_us);
+        kernel_telemetry_write_unsigned("latency_last_us", statistics.latency_last_us);
+        kernel_telemetry_end_record();
+    }
+}
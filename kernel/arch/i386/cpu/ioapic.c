@@ -1,5 +1,7 @@
 #include <kernel/cpu/ioapic.h>
 
+#include <kernel/core/lock.h>
+
 #define IOAPIC_MMIO_BASE_VIRT 0xFFB10000u
 #define IOAPIC_MMIO_STRIDE    0x1000u
 
@@ -33,16 +35,26 @@ static inline volatile uint32_t *io_apic_register_pointer(uint32_t io_apic_virtu
     return (volatile uint32_t *) (io_apic_virtual_base + offset);
 }
 
+/* The selector and the window are one access between them. Routes were only
+   touched from the boot path until the IRQ balancer started retargeting them from
+   its timer, which may interrupt a driver programming its own line. */
+static KernelTicketLock_t io_apic_register_lock;
+
 static uint32_t io_apic_register_read(uint32_t io_apic_virtual_base, uint8_t reg_index)
 {
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&io_apic_register_lock);
     *io_apic_register_pointer(io_apic_virtual_base, IOAPIC_REGISTER_SELECTOR) = reg_index;
-    return *io_apic_register_pointer(io_apic_virtual_base, IOAPIC_REGISTER_WINDOW);
+    const uint32_t value = *io_apic_register_pointer(io_apic_virtual_base, IOAPIC_REGISTER_WINDOW);
+    kernel_ticket_lock_release_irqrestore(&io_apic_register_lock, flags);
+    return value;
 }
 
 static void io_apic_register_write(uint32_t io_apic_virtual_base, uint8_t reg_index, uint32_t value)
 {
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&io_apic_register_lock);
     *io_apic_register_pointer(io_apic_virtual_base, IOAPIC_REGISTER_SELECTOR) = reg_index;
     *io_apic_register_pointer(io_apic_virtual_base, IOAPIC_REGISTER_WINDOW) = value;
+    kernel_ticket_lock_release_irqrestore(&io_apic_register_lock, flags);
 }
 
 static uint8_t io_apic_map_unit(uint8_t index)
@@ -135,7 +147,7 @@ static uint32_t io_apic_build_redirection_low(uint8_t vector, uint16_t iso_flags
     return low;
 }
 
-static uint8_t io_apic_program_masked_isa_route(uint8_t isa_irq)
+static uint8_t io_apic_program_masked_isa_route(uint8_t isa_irq, uint16_t conforming_flags)
 {
     uint32_t global_system_interrupt = 0u;
     uint16_t iso_flags = 0u;
@@ -157,6 +169,13 @@ static uint8_t io_apic_program_masked_isa_route(uint8_t isa_irq)
     if (!io_apic_find_unit_for_gsi(global_system_interrupt, &unit_index, &gsi_relative))
         return 0u;
 
+    /* A conforming field means "whatever the bus says", and the ISA bus and the PCI
+       bus say different things: edge/high for the first, level/low for the second. */
+    if ((iso_flags & ACPI_ISO_POLARITY_MASK) == 0u)
+        iso_flags |= (uint16_t) (conforming_flags & ACPI_ISO_POLARITY_MASK);
+    if ((iso_flags & ACPI_ISO_TRIGGER_MASK) == 0u)
+        iso_flags |= (uint16_t) (conforming_flags & ACPI_ISO_TRIGGER_MASK);
+
     unit = &io_apic_units[unit_index];
     if (gsi_relative > 0x7Fu)
         return 0u;
@@ -252,8 +271,8 @@ void input_output_advanced_programmable_interrupt_controller_initialize_routing_
         return;
     }
 
-    (void) io_apic_program_masked_isa_route(0u);
-    (void) io_apic_program_masked_isa_route(1u);
+    (void) io_apic_program_masked_isa_route(0u, 0u);
+    (void) io_apic_program_masked_isa_route(1u, 0u);
 
     if (io_apic_route_count == 0u)
         io_apic_state_name = "ioapic-init-mapped-no-routes";
@@ -319,6 +338,18 @@ uint16_t input_output_advanced_programmable_interrupt_controller_get_programmed_
     return io_apic_routes[route_index].iso_flags;
 }
 
+uint8_t input_output_advanced_programmable_interrupt_controller_program_isa_route(uint8_t isa_irq,
+                                                                                   uint8_t pci_level_triggered)
+{
+    if (io_apic_mapped_count == 0u)
+        return 0u;
+    if (io_apic_find_programmed_route_index_by_irq(isa_irq) >= 0)
+        return 1u;
+
+    return io_apic_program_masked_isa_route(
+        isa_irq, pci_level_triggered ? (uint16_t) (ACPI_ISO_POLARITY_ACTIVE_LOW | ACPI_ISO_TRIGGER_LEVEL) : 0u);
+}
+
 uint8_t input_output_advanced_programmable_interrupt_controller_enable_isa_route(uint8_t isa_irq)
 {
     int32_t route_index_signed;
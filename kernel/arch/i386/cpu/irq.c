@@ -2,6 +2,7 @@
 
 #include <kernel/core/reconciler.h>
 #include <kernel/drivers/ps2_mouse.h>
+#include <kernel/memory/frame_arena.h>
 
 #define IRQ_LINE_COUNT        16u
 #define IRQ_CASCADE_LINE      2u
@@ -41,11 +42,13 @@ static uint8_t interrupt_request_timer_owner_is_apic = 0u;
 */
 static uint16_t interrupt_request_apic_owned_lines = 0u;
 
-static void interrupt_request_timer_handler(const InterruptFrame_t *frame)
+void interrupt_request_timer_tick(void)
 {
-    (void) frame;
     interrupt_request_tick_count++;
 
+    /* Only an epoch bump: each per-CPU arena clears itself on its owner's next use. */
+    kernel_frame_arena_tick();
+
     /* Drive the reconciler from the kernel's own periodic tick rather than from
        the engine's frame, for two reasons. It runs on every profile, including
        the ones that instantiate no World at all; and it does not depend on the
@@ -57,6 +60,12 @@ static void interrupt_request_timer_handler(const InterruptFrame_t *frame)
        no output — which is what makes it acceptable in interrupt context. */
     if ((interrupt_request_tick_count % KERNEL_RECONCILER_TICK_SAMPLE_PERIOD) == 0u)
         kernel_reconciler_check_periodic();
+}
+
+static void interrupt_request_timer_handler(const InterruptFrame_t *frame)
+{
+    (void) frame;
+    interrupt_request_timer_tick();
 
     if (interrupt_request_timer_owner_is_apic)
         advanced_pic_timer_backend_signal_end_of_interrupt();
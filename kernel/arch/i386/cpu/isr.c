@@ -5,7 +5,10 @@
 ** isr — Interrupt Service Routine dispatcher
 */
 
+#include <kernel/core/thread.h>
 #include <kernel/cpu/isr.h>
+#include <kernel/cpu/tlb_shootdown.h>
+#include <kernel/diag/trace.h>
 
 ////////////////////////////////////////////////////////////
 // Private helpers for panic serial output
@@ -72,12 +75,20 @@ static const char *const ISR_EXCEPTION_NAMES[32] = {
 };
 
 static isr_handler_t g_isr_table[256] = {NULL};
+static volatile uint32_t g_isr_delivery_count[256] = {0u};
 
 void interrupt_service_routine_register_handler(uint8_t interrupt_vector, isr_handler_t handler)
 {
     g_isr_table[interrupt_vector] = handler;
 }
 
+isr_handler_t interrupt_service_routine_get_handler(uint8_t interrupt_vector) { return g_isr_table[interrupt_vector]; }
+
+uint32_t interrupt_service_routine_get_delivery_count(uint8_t interrupt_vector)
+{
+    return g_isr_delivery_count[interrupt_vector];
+}
+
 static void isr_default_handler(const InterruptFrame_t *frame)
 {
     const char *name = (frame->int_no < 32) ? ISR_EXCEPTION_NAMES[frame->int_no] : "Unknown interrupt";
@@ -148,11 +159,26 @@ void interrupt_frame_set_resume_address(const InterruptFrame_t *frame, uint32_t
     ((InterruptFrame_t *) frame)->eip = resume_address;
 }
 
-void interrupt_service_routine_dispatch(InterruptFrame_t *frame)
+InterruptFrame_t *interrupt_service_routine_dispatch(InterruptFrame_t *frame)
 {
+    static KernelTraceSite_t exception_site = {"exception", 0u};
+    static KernelTraceSite_t irq_site = {"irq", 0u};
+    const uint64_t span = kernel_trace_begin();
+
+    /* A CPU woken from idle may have been skipped by a shootdown while it slept;
+       it flushes before any handler can reach a remapped page. */
+    tlb_shootdown_exit_idle();
+
+    /* Atomic: an IPI vector, or a line caught mid-retarget, lands on two CPUs at once. */
+    __atomic_add_fetch(&g_isr_delivery_count[frame->int_no & 0xFFu], 1u, __ATOMIC_RELAXED);
+
     isr_handler_t handler = g_isr_table[frame->int_no];
     if (handler)
         handler(frame);
     else
         isr_default_handler(frame);
+
+    kernel_trace_end(frame->int_no < 32u ? &exception_site : &irq_site, span, (uint16_t) frame->int_no);
+
+    return kernel_thread_interrupt_exit(frame);
 }
@@ -94,17 +94,55 @@ ISR_NOERR 47    # IRQ15 Secondary ATA / spurious
 # ---- Custom / IPI stubs ---------------------------------------------------
 
 ISR_NOERR 64    # 0x40: TLB Shootdown IPI
+ISR_NOERR 65    # 0x41: Job system wake-up IPI
+ISR_NOERR 66    # 0x42: Kernel timer deadline
+ISR_NOERR 67    # 0x43: Scheduler reschedule IPI
+ISR_NOERR 68    # 0x44: Thread yield (software `int`)
+
+# ---- Device vectors 0x50-0x6F, handed out by interrupt_vector.c -----------
+
+ISR_NOERR 80
+ISR_NOERR 81
+ISR_NOERR 82
+ISR_NOERR 83
+ISR_NOERR 84
+ISR_NOERR 85
+ISR_NOERR 86
+ISR_NOERR 87
+ISR_NOERR 88
+ISR_NOERR 89
+ISR_NOERR 90
+ISR_NOERR 91
+ISR_NOERR 92
+ISR_NOERR 93
+ISR_NOERR 94
+ISR_NOERR 95
+ISR_NOERR 96
+ISR_NOERR 97
+ISR_NOERR 98
+ISR_NOERR 99
+ISR_NOERR 100
+ISR_NOERR 101
+ISR_NOERR 102
+ISR_NOERR 103
+ISR_NOERR 104
+ISR_NOERR 105
+ISR_NOERR 106
+ISR_NOERR 107
+ISR_NOERR 108
+ISR_NOERR 109
+ISR_NOERR 110
+ISR_NOERR 111
+
 ISR_NOERR 128   # 0x80: syscall gate (DPL3)
 
-# ---- FPU / SSE state save area ---------------------------------------------
+# ---- FPU / SSE state ------------------------------------------------------
 #
-# CR4.OSFXSR is set in boot.S so FXSAVE/FXRSTOR cover all 512 bytes of FPU+SSE
-# state (x87 + MMX + XMM0-XMM7 + MXCSR). Single static buffer — one CPU for now.
-
-.section .bss
-.align 16
-isr_fpu_save_area:
-    .skip 512
+# No save area here any more: one global buffer was clobbered as soon as two
+# CPUs took interrupts at once, and nested frames overwrote each other on one
+# CPU. interrupt_fpu_enter/leave (fpu.c) keep one area per CPU and per nesting
+# level, and by default only arm CR0.TS so a handler that never touches
+# FPU/SSE costs no save at all.
 
 .section .text
 
@@ -139,14 +177,24 @@ isr_common_stub:
     movw %ax, %es
     movw %ax, %fs
     movw %ax, %gs
+    cld                         # memmove's backward path runs with DF set; IRET restores it
 
-    fxsave isr_fpu_save_area    # preserve x87/MMX/XMM0-7/MXCSR across C dispatch
+    call  interrupt_fpu_enter   # open this CPU's FPU nesting level (lazy or eager)
+    pushl %eax                  # keep its context for interrupt_fpu_leave
 
-    pushl %esp                  # pass pointer to InterruptFrame_t as argument
+    leal  4(%esp), %eax
+    pushl %eax                  # pass pointer to InterruptFrame_t as argument
     call  interrupt_service_routine_dispatch
-    addl  $4, %esp              # discard argument
 
-    fxrstor isr_fpu_save_area   # restore FPU/SSE state
+    # Dispatch returns the frame to resume: this one, or another thread's when the
+    # scheduler switched. Either way its FPU context sits just below it.
+    cmpl  %eax, (%esp)          # same frame as the argument?
+    leal  -4(%eax), %esp        # discard argument / move to the other stack
+    je    1f
+    call  kernel_thread_switch_complete
+1:
+    call  interrupt_fpu_leave   # restore FPU/SSE state if this level saved it
+    addl  $4, %esp              # discard the context
 
     popl  %eax                  # restore original data segment
     movw %ax, %ds
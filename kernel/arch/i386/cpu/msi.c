@@ -0,0 +1,609 @@
+/**
+ * @file msi.c
+ * @brief MSI and MSI-X programming: capability decode, message composition,
+ *        vector table and pending-bit array access, affinity.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#include <kernel/cpu/msi.h>
+
+#include <kernel/core/lock.h>
+#include <kernel/cpu/apic_timer.h>
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/cpu/paging.h>
+#include <kernel/cpu/pci.h>
+#include <kernel/diag/telemetry.h>
+#include <kernel/memory/vmm.h>
+
+#include <stddef.h>
+
+/* ── MSI capability ────────────────────────────────────────────────────────── */
+#define MSI_CONTROL                 0x02u  /**< 16-bit message control. */
+#define MSI_ADDRESS                 0x04u
+#define MSI_ADDRESS_HIGH            0x08u  /**< 64-bit capable only. */
+#define MSI_DATA_32                 0x08u
+#define MSI_DATA_64                 0x0Cu
+#define MSI_MASK_32                 0x0Cu  /**< Per-vector maskable only. */
+#define MSI_MASK_64                 0x10u
+#define MSI_PENDING_32              0x10u
+#define MSI_PENDING_64              0x14u
+#define MSI_CONTROL_ENABLE          0x0001u
+#define MSI_CONTROL_CAPABLE_SHIFT   1u     /**< Bits 1-3: log2 of the messages asked for. */
+#define MSI_CONTROL_ENABLED_SHIFT   4u     /**< Bits 4-6: log2 of the messages granted. */
+#define MSI_CONTROL_ENABLED_MASK    0x0070u
+#define MSI_CONTROL_64BIT           0x0080u
+#define MSI_CONTROL_MASKABLE        0x0100u
+
+/* ── MSI-X capability and table ────────────────────────────────────────────── */
+#define MSIX_CONTROL                0x02u  /**< 16-bit message control. */
+#define MSIX_TABLE                  0x04u  /**< Offset in the BAR | BAR index in bits 0-2. */
+#define MSIX_PBA                    0x08u
+#define MSIX_CONTROL_TABLE_SIZE     0x07FFu /**< Entries minus one. */
+#define MSIX_CONTROL_FUNCTION_MASK  0x4000u
+#define MSIX_CONTROL_ENABLE         0x8000u
+#define MSIX_BIR_MASK               0x7u
+#define MSIX_ENTRY_BYTES            16u
+#define MSIX_ENTRY_ADDRESS          0x0u
+#define MSIX_ENTRY_ADDRESS_HIGH     0x4u
+#define MSIX_ENTRY_DATA             0x8u
+#define MSIX_ENTRY_CONTROL          0xCu
+#define MSIX_ENTRY_CONTROL_MASKED   0x1u
+
+/* ── Message format (x86) ──────────────────────────────────────────────────── */
+/* Address: 0xFEE in bits 20-31, destination APIC id in bits 12-19, physical
+   destination mode, no redirection hint. Data: the vector, fixed delivery, edge. */
+#define MSI_MESSAGE_ADDRESS_BASE    0xFEE00000u
+#define MSI_MESSAGE_DESTINATION_SHIFT 12u
+
+struct MessageSignaledInterruptFunction {
+    bool in_use;
+    bool enabled;
+    uint8_t bus;
+    uint8_t device;
+    uint8_t function;
+    const char *owner;
+    MessageSignaledInterruptMode_t mode;
+    MessageSignaledInterruptCapabilities_t capabilities;
+    uint8_t first_vector;
+    uint32_t vector_count;   /**< Messages in use. */
+    uint32_t block;          /**< Vectors allocated: vector_count rounded up to a power of two. */
+    uint32_t cpu[MESSAGE_SIGNALED_INTERRUPT_MAX_VECTORS];
+    uint32_t table_virtual;  /**< MSI-X table, 0 until mapped. Kept across a disable. */
+    uint32_t pba_virtual;
+};
+
+static MessageSignaledInterruptFunction_t msi_functions[MESSAGE_SIGNALED_INTERRUPT_MAX_FUNCTIONS];
+static KernelTicketLock_t msi_lock;
+static uint32_t msi_enable_failures = 0u;
+static uint32_t msi_retargets = 0u;
+
+static inline uint32_t msi_mmio_read32(uint32_t address) { return *(volatile uint32_t *) address; }
+static inline void msi_mmio_write32(uint32_t address, uint32_t value) { *(volatile uint32_t *) address = value; }
+
+static uint16_t msi_config_read16(const MessageSignaledInterruptFunction_t *entry, uint8_t offset)
+{
+    return peripheral_component_interconnect_config_read_word(entry->bus, entry->device, entry->function, offset);
+}
+
+static void msi_config_write16(const MessageSignaledInterruptFunction_t *entry, uint8_t offset, uint16_t value)
+{
+    peripheral_component_interconnect_config_write_word(entry->bus, entry->device, entry->function, offset, value);
+}
+
+static uint32_t msi_config_read32(const MessageSignaledInterruptFunction_t *entry, uint8_t offset)
+{
+    return peripheral_component_interconnect_config_read_dword(entry->bus, entry->device, entry->function, offset);
+}
+
+static void msi_config_write32(const MessageSignaledInterruptFunction_t *entry, uint8_t offset, uint32_t value)
+{
+    peripheral_component_interconnect_config_write_dword(entry->bus, entry->device, entry->function, offset, value);
+}
+
+/** @brief Address word of a message for the CPU in logical slot @p cpu_slot. */
+static uint32_t msi_message_address(uint32_t cpu_slot)
+{
+    const uint32_t apic_id = cpu_topology_get_apic_id_at_slot(cpu_slot) & 0xFFu;
+    return MSI_MESSAGE_ADDRESS_BASE | (apic_id << MSI_MESSAGE_DESTINATION_SHIFT);
+}
+
+/**
+ * @brief Map part of a BAR, uncached: the MSI-X table or its pending bits.
+ *
+ * The same shape as the HDA and virtio windows. Device memory, so cache-disabled
+ * and write-through: a cached pending bit would be stale the moment it was read.
+ *
+ * @return Virtual address of @p physical, or 0.
+ */
+static uint32_t msi_map_window(uint32_t physical, uint32_t size)
+{
+    if (physical == 0u || size == 0u)
+        return 0u;
+
+    const uint32_t page_offset = physical & 0xFFFu;
+    const uint32_t page_base = physical & 0xFFFFF000u;
+    const uint32_t page_count = (page_offset + size + 0xFFFu) >> 12;
+
+    void *const virt = kernel_vmm_reserve_pages(page_count);
+    if (virt == NULL)
+        return 0u;
+
+    const PageDirectoryEntry_t pde_flags = {.present = 1u, .read_write = 1u};
+    const PageTableEntry_t pte_flags = {.present = 1u, .read_write = 1u, .cache_disable = 1u, .write_through = 1u};
+
+    const uint32_t virt_base = (uint32_t) virt;
+    for (uint32_t page = 0u; page < page_count; ++page)
+    {
+        if (!paging_map_page(virt_base + (page << 12), page_base + (page << 12), pde_flags, pte_flags))
+        {
+            for (uint32_t mapped = 0u; mapped < page; ++mapped)
+                (void) paging_unmap_page(virt_base + (mapped << 12));
+            kernel_vmm_free_pages(virt, page_count);
+            return 0u;
+        }
+    }
+    return virt_base + page_offset;
+}
+
+/**
+ * @brief Map the table and the pending-bit array, once per function.
+ *
+ * The BARs are read without probing: the device may already be running.
+ */
+static bool msi_map_msix(MessageSignaledInterruptFunction_t *entry)
+{
+    if (entry->table_virtual != 0u && entry->pba_virtual != 0u)
+        return true;
+
+    const MessageSignaledInterruptCapabilities_t *const caps = &entry->capabilities;
+    const uint64_t table_bar = peripheral_component_interconnect_read_memory_base(
+        entry->bus, entry->device, entry->function, caps->msix_table_bar);
+    const uint64_t pba_bar = peripheral_component_interconnect_read_memory_base(
+        entry->bus, entry->device, entry->function, caps->msix_pba_bar);
+
+    /* A 32-bit kernel cannot reach a window above 4 GiB, and must not truncate it. */
+    if (table_bar == 0u || pba_bar == 0u || (table_bar >> 32) != 0u || (pba_bar >> 32) != 0u)
+        return false;
+
+    const uint32_t table_bytes = (uint32_t) caps->msix_table_size * MSIX_ENTRY_BYTES;
+    const uint32_t pba_bytes = (((uint32_t) caps->msix_table_size + 63u) / 64u) * 8u;
+
+    if (entry->table_virtual == 0u)
+        entry->table_virtual = msi_map_window((uint32_t) table_bar + caps->msix_table_offset, table_bytes);
+    if (entry->pba_virtual == 0u)
+        entry->pba_virtual = msi_map_window((uint32_t) pba_bar + caps->msix_pba_offset, pba_bytes);
+    return entry->table_virtual != 0u && entry->pba_virtual != 0u;
+}
+
+static uint32_t msi_table_entry(const MessageSignaledInterruptFunction_t *entry, uint32_t index)
+{
+    return entry->table_virtual + index * MSIX_ENTRY_BYTES;
+}
+
+/** @brief Write one MSI-X entry's message, leaving it masked. */
+static void msi_msix_program_entry(const MessageSignaledInterruptFunction_t *entry, uint32_t index, uint8_t vector,
+                                   uint32_t cpu_slot)
+{
+    const uint32_t slot = msi_table_entry(entry, index);
+
+    msi_mmio_write32(slot + MSIX_ENTRY_CONTROL, MSIX_ENTRY_CONTROL_MASKED);
+    msi_mmio_write32(slot + MSIX_ENTRY_ADDRESS, msi_message_address(cpu_slot));
+    msi_mmio_write32(slot + MSIX_ENTRY_ADDRESS_HIGH, 0u);
+    msi_mmio_write32(slot + MSIX_ENTRY_DATA, vector);
+}
+
+static void msi_msix_set_entry_masked(const MessageSignaledInterruptFunction_t *entry, uint32_t index, bool masked)
+{
+    const uint32_t control = msi_table_entry(entry, index) + MSIX_ENTRY_CONTROL;
+    const uint32_t value = msi_mmio_read32(control);
+
+    msi_mmio_write32(control, masked ? (value | MSIX_ENTRY_CONTROL_MASKED) : (value & ~MSIX_ENTRY_CONTROL_MASKED));
+    /* Reading back flushes the posted write before the caller relies on it. */
+    (void) msi_mmio_read32(control);
+}
+
+static void msi_set_intx_disabled(const MessageSignaledInterruptFunction_t *entry, bool disabled)
+{
+    const uint16_t command = msi_config_read16(entry, PERIPHERAL_COMPONENT_INTERCONNECT_REGISTER_COMMAND);
+    const uint16_t bit = PERIPHERAL_COMPONENT_INTERCONNECT_COMMAND_INTERRUPT_DISABLE;
+    const uint16_t updated = disabled ? (uint16_t) (command | bit) : (uint16_t) (command & ~bit);
+    if (updated != command)
+        msi_config_write16(entry, PERIPHERAL_COMPONENT_INTERCONNECT_REGISTER_COMMAND, updated);
+}
+
+/** @brief Program and enable MSI-X; the windows are already mapped. */
+static void msi_enable_msix(MessageSignaledInterruptFunction_t *entry, uint32_t cpu_slot)
+{
+    const uint8_t capability = entry->capabilities.msix_offset;
+    uint16_t control = msi_config_read16(entry, (uint8_t) (capability + MSIX_CONTROL));
+
+    /* Enabled under the function mask: the table may be written, nothing is sent. */
+    control = (uint16_t) (control | MSIX_CONTROL_ENABLE | MSIX_CONTROL_FUNCTION_MASK);
+    msi_config_write16(entry, (uint8_t) (capability + MSIX_CONTROL), control);
+
+    for (uint32_t index = 0u; index < entry->capabilities.msix_table_size; ++index)
+        msi_msix_set_entry_masked(entry, index, true);
+    for (uint32_t index = 0u; index < entry->vector_count; ++index)
+    {
+        msi_msix_program_entry(entry, index, (uint8_t) (entry->first_vector + index), cpu_slot);
+        msi_msix_set_entry_masked(entry, index, false);
+    }
+
+    msi_set_intx_disabled(entry, true);
+    control = (uint16_t) (control & ~MSIX_CONTROL_FUNCTION_MASK);
+    msi_config_write16(entry, (uint8_t) (capability + MSIX_CONTROL), control);
+}
+
+static void msi_enable_msi(MessageSignaledInterruptFunction_t *entry, uint32_t cpu_slot)
+{
+    const MessageSignaledInterruptCapabilities_t *const caps = &entry->capabilities;
+    const uint8_t capability = caps->msi_offset;
+
+    /* Granting fewer messages than asked is allowed; the function then folds the
+       rest onto the last one. The block is a power of two, which MME requires. */
+    uint32_t granted_log2 = 0u;
+    while ((1u << granted_log2) < entry->block)
+        ++granted_log2;
+
+    uint16_t control = msi_config_read16(entry, (uint8_t) (capability + MSI_CONTROL));
+    control = (uint16_t) (control & ~(MSI_CONTROL_ENABLE | MSI_CONTROL_ENABLED_MASK));
+    msi_config_write16(entry, (uint8_t) (capability + MSI_CONTROL), control);
+
+    msi_config_write32(entry, (uint8_t) (capability + MSI_ADDRESS), msi_message_address(cpu_slot));
+    if (caps->msi_64bit)
+    {
+        msi_config_write32(entry, (uint8_t) (capability + MSI_ADDRESS_HIGH), 0u);
+        msi_config_write16(entry, (uint8_t) (capability + MSI_DATA_64), entry->first_vector);
+    }
+    else
+        msi_config_write16(entry, (uint8_t) (capability + MSI_DATA_32), entry->first_vector);
+
+    if (caps->msi_maskable)
+        msi_config_write32(entry, (uint8_t) (capability + (caps->msi_64bit ? MSI_MASK_64 : MSI_MASK_32)), 0u);
+
+    msi_set_intx_disabled(entry, true);
+    control = (uint16_t) (control | MSI_CONTROL_ENABLE | (granted_log2 << MSI_CONTROL_ENABLED_SHIFT));
+    msi_config_write16(entry, (uint8_t) (capability + MSI_CONTROL), control);
+}
+
+/** @brief The enabled function @p vector belongs to, and its message index. */
+static MessageSignaledInterruptFunction_t *msi_find_vector(uint8_t vector, uint32_t *out_index)
+{
+    for (uint32_t slot = 0u; slot < MESSAGE_SIGNALED_INTERRUPT_MAX_FUNCTIONS; ++slot)
+    {
+        MessageSignaledInterruptFunction_t *const entry = &msi_functions[slot];
+        if (!entry->enabled || vector < entry->first_vector || vector >= entry->first_vector + entry->vector_count)
+            continue;
+        *out_index = (uint32_t) (vector - entry->first_vector);
+        return entry;
+    }
+    return NULL;
+}
+
+bool message_signaled_interrupt_probe(uint8_t bus, uint8_t device, uint8_t function,
+                                      MessageSignaledInterruptCapabilities_t *out)
+{
+    if (out == NULL)
+        return false;
+    *out = (MessageSignaledInterruptCapabilities_t) {0};
+
+    out->msi_offset = peripheral_component_interconnect_find_capability(
+        bus, device, function, PERIPHERAL_COMPONENT_INTERCONNECT_CAPABILITY_MSI);
+    if (out->msi_offset != 0u)
+    {
+        const uint16_t control = peripheral_component_interconnect_config_read_word(
+            bus, device, function, (uint8_t) (out->msi_offset + MSI_CONTROL));
+        const uint32_t capable_log2 = (control >> MSI_CONTROL_CAPABLE_SHIFT) & 0x7u;
+
+        /* 6 and 7 are reserved encodings; 32 messages is the most there is. */
+        out->msi_messages = (uint8_t) (1u << (capable_log2 > 5u ? 5u : capable_log2));
+        out->msi_64bit = (control & MSI_CONTROL_64BIT) != 0u;
+        out->msi_maskable = (control & MSI_CONTROL_MASKABLE) != 0u;
+    }
+
+    out->msix_offset = peripheral_component_interconnect_find_capability(
+        bus, device, function, PERIPHERAL_COMPONENT_INTERCONNECT_CAPABILITY_MSIX);
+    if (out->msix_offset != 0u)
+    {
+        const uint16_t control = peripheral_component_interconnect_config_read_word(
+            bus, device, function, (uint8_t) (out->msix_offset + MSIX_CONTROL));
+        const uint32_t table = peripheral_component_interconnect_config_read_dword(
+            bus, device, function, (uint8_t) (out->msix_offset + MSIX_TABLE));
+        const uint32_t pba = peripheral_component_interconnect_config_read_dword(
+            bus, device, function, (uint8_t) (out->msix_offset + MSIX_PBA));
+
+        out->msix_table_size = (uint16_t) ((control & MSIX_CONTROL_TABLE_SIZE) + 1u);
+        out->msix_table_bar = (uint8_t) (table & MSIX_BIR_MASK);
+        out->msix_table_offset = table & ~MSIX_BIR_MASK;
+        out->msix_pba_bar = (uint8_t) (pba & MSIX_BIR_MASK);
+        out->msix_pba_offset = pba & ~MSIX_BIR_MASK;
+    }
+
+    return out->msi_offset != 0u || out->msix_offset != 0u;
+}
+
+MessageSignaledInterruptFunction_t *message_signaled_interrupt_enable(uint8_t bus, uint8_t device, uint8_t function,
+                                                                      const char *owner, uint32_t count,
+                                                                      interrupt_vector_handler_t handler, void *context,
+                                                                      uint32_t cpu_slot)
+{
+    MessageSignaledInterruptCapabilities_t caps;
+
+    if (handler == NULL || count == 0u || count > MESSAGE_SIGNALED_INTERRUPT_MAX_VECTORS ||
+        !advanced_pic_timer_backend_is_local_apic_mmio_mapped() || !cpu_topology_is_logical_slot_online(cpu_slot) ||
+        !message_signaled_interrupt_probe(bus, device, function, &caps))
+    {
+        ++msi_enable_failures;
+        return NULL;
+    }
+
+    bool use_msix = caps.msix_offset != 0u && count <= caps.msix_table_size;
+    const bool msi_fits = caps.msi_offset != 0u && count <= caps.msi_messages;
+    if (!use_msix && !msi_fits)
+    {
+        ++msi_enable_failures;
+        return NULL;
+    }
+
+    uint32_t block = 1u;
+    while (block < count)
+        block <<= 1u;
+
+    /* Claim a slot: the one this function had before, whose MSI-X windows are still
+       mapped, or a fresh one. */
+    uint32_t flags = kernel_ticket_lock_acquire_irqsave(&msi_lock);
+    MessageSignaledInterruptFunction_t *entry = NULL;
+    for (uint32_t slot = 0u; slot < MESSAGE_SIGNALED_INTERRUPT_MAX_FUNCTIONS && entry == NULL; ++slot)
+    {
+        MessageSignaledInterruptFunction_t *const candidate = &msi_functions[slot];
+        if (candidate->in_use && candidate->bus == bus && candidate->device == device &&
+            candidate->function == function)
+            entry = candidate;
+    }
+    for (uint32_t slot = 0u; slot < MESSAGE_SIGNALED_INTERRUPT_MAX_FUNCTIONS && entry == NULL; ++slot)
+    {
+        if (!msi_functions[slot].in_use)
+        {
+            entry = &msi_functions[slot];
+            *entry = (MessageSignaledInterruptFunction_t) {0};
+            entry->in_use = true;
+            entry->bus = bus;
+            entry->device = device;
+            entry->function = function;
+        }
+    }
+    if (entry != NULL && entry->enabled)
+        entry = NULL;
+    kernel_ticket_lock_release_irqrestore(&msi_lock, flags);
+
+    if (entry == NULL)
+    {
+        ++msi_enable_failures;
+        return NULL;
+    }
+
+    /* Mapping may allocate page tables, so it happens outside the lock. A table that
+       cannot be mapped leaves MSI, when the function has it. */
+    entry->capabilities = caps;
+    if (use_msix && !msi_map_msix(entry))
+        use_msix = false;
+
+    const uint8_t first_vector =
+        (use_msix || msi_fits) ? interrupt_vector_allocate(block, owner, handler, context) : INTERRUPT_VECTOR_NONE;
+    if (first_vector == INTERRUPT_VECTOR_NONE)
+    {
+        ++msi_enable_failures;
+        return NULL;
+    }
+
+    flags = kernel_ticket_lock_acquire_irqsave(&msi_lock);
+    entry->owner = owner;
+    entry->mode = use_msix ? MESSAGE_SIGNALED_INTERRUPT_MODE_MSIX : MESSAGE_SIGNALED_INTERRUPT_MODE_MSI;
+    entry->first_vector = first_vector;
+    entry->vector_count = count;
+    entry->block = block;
+    if (use_msix)
+        msi_enable_msix(entry, cpu_slot);
+    else
+        msi_enable_msi(entry, cpu_slot);
+
+    for (uint32_t index = 0u; index < count; ++index)
+    {
+        entry->cpu[index] = cpu_slot;
+        interrupt_vector_note_target((uint8_t) (first_vector + index), cpu_slot);
+    }
+    entry->enabled = true;
+    kernel_ticket_lock_release_irqrestore(&msi_lock, flags);
+    return entry;
+}
+
+void message_signaled_interrupt_disable(MessageSignaledInterruptFunction_t *entry)
+{
+    if (entry == NULL || !entry->enabled)
+        return;
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&msi_lock);
+
+    if (entry->mode == MESSAGE_SIGNALED_INTERRUPT_MODE_MSIX)
+    {
+        const uint8_t offset = (uint8_t) (entry->capabilities.msix_offset + MSIX_CONTROL);
+        for (uint32_t index = 0u; index < entry->vector_count; ++index)
+            msi_msix_set_entry_masked(entry, index, true);
+        msi_config_write16(entry, offset,
+                           (uint16_t) (msi_config_read16(entry, offset) & ~(MSIX_CONTROL_ENABLE |
+                                                                             MSIX_CONTROL_FUNCTION_MASK)));
+    }
+    else
+    {
+        const uint8_t offset = (uint8_t) (entry->capabilities.msi_offset + MSI_CONTROL);
+        msi_config_write16(entry, offset,
+                           (uint16_t) (msi_config_read16(entry, offset) &
+                                       ~(MSI_CONTROL_ENABLE | MSI_CONTROL_ENABLED_MASK)));
+    }
+    msi_set_intx_disabled(entry, false);
+
+    interrupt_vector_free(entry->first_vector, entry->block);
+    entry->enabled = false;
+    entry->mode = MESSAGE_SIGNALED_INTERRUPT_MODE_NONE;
+
+    kernel_ticket_lock_release_irqrestore(&msi_lock, flags);
+}
+
+MessageSignaledInterruptMode_t message_signaled_interrupt_get_mode(const MessageSignaledInterruptFunction_t *entry)
+{
+    return (entry != NULL && entry->enabled) ? entry->mode : MESSAGE_SIGNALED_INTERRUPT_MODE_NONE;
+}
+
+uint8_t message_signaled_interrupt_get_vector(const MessageSignaledInterruptFunction_t *entry, uint32_t index)
+{
+    if (entry == NULL || !entry->enabled || index >= entry->vector_count)
+        return INTERRUPT_VECTOR_NONE;
+    return (uint8_t) (entry->first_vector + index);
+}
+
+bool message_signaled_interrupt_set_affinity(uint8_t vector, uint32_t cpu_slot)
+{
+    if (!cpu_topology_is_logical_slot_online(cpu_slot))
+        return false;
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&msi_lock);
+
+    uint32_t index = 0u;
+    MessageSignaledInterruptFunction_t *const entry = msi_find_vector(vector, &index);
+    if (entry == NULL)
+    {
+        kernel_ticket_lock_release_irqrestore(&msi_lock, flags);
+        return false;
+    }
+
+    if (entry->mode == MESSAGE_SIGNALED_INTERRUPT_MODE_MSIX)
+    {
+        msi_msix_program_entry(entry, index, vector, cpu_slot);
+        msi_msix_set_entry_masked(entry, index, false);
+        entry->cpu[index] = cpu_slot;
+        interrupt_vector_note_target(vector, cpu_slot);
+    }
+    else
+    {
+        /* One dword, so the function never sees half an address. */
+        msi_config_write32(entry, (uint8_t) (entry->capabilities.msi_offset + MSI_ADDRESS),
+                           msi_message_address(cpu_slot));
+        for (uint32_t message = 0u; message < entry->vector_count; ++message)
+        {
+            entry->cpu[message] = cpu_slot;
+            interrupt_vector_note_target((uint8_t) (entry->first_vector + message), cpu_slot);
+        }
+    }
+    ++msi_retargets;
+
+    kernel_ticket_lock_release_irqrestore(&msi_lock, flags);
+    return true;
+}
+
+bool message_signaled_interrupt_set_masked(uint8_t vector, bool masked)
+{
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&msi_lock);
+
+    uint32_t index = 0u;
+    MessageSignaledInterruptFunction_t *const entry = msi_find_vector(vector, &index);
+    bool applied = false;
+
+    if (entry != NULL && entry->mode == MESSAGE_SIGNALED_INTERRUPT_MODE_MSIX)
+    {
+        msi_msix_set_entry_masked(entry, index, masked);
+        applied = true;
+    }
+    else if (entry != NULL && entry->capabilities.msi_maskable)
+    {
+        const uint8_t offset =
+            (uint8_t) (entry->capabilities.msi_offset + (entry->capabilities.msi_64bit ? MSI_MASK_64 : MSI_MASK_32));
+        const uint32_t bits = msi_config_read32(entry, offset);
+        msi_config_write32(entry, offset, masked ? (bits | (1u << index)) : (bits & ~(1u << index)));
+        applied = true;
+    }
+
+    kernel_ticket_lock_release_irqrestore(&msi_lock, flags);
+    return applied;
+}
+
+bool message_signaled_interrupt_is_pending(uint8_t vector)
+{
+    uint32_t index = 0u;
+    const MessageSignaledInterruptFunction_t *const entry = msi_find_vector(vector, &index);
+    if (entry == NULL)
+        return false;
+
+    if (entry->mode == MESSAGE_SIGNALED_INTERRUPT_MODE_MSIX)
+        return (msi_mmio_read32(entry->pba_virtual + (index / 32u) * 4u) & (1u << (index % 32u))) != 0u;
+    if (entry->capabilities.msi_maskable)
+    {
+        const uint8_t offset = (uint8_t) (entry->capabilities.msi_offset +
+                                          (entry->capabilities.msi_64bit ? MSI_PENDING_64 : MSI_PENDING_32));
+        return (msi_config_read32(entry, offset) & (1u << index)) != 0u;
+    }
+    return false;
+}
+
+bool message_signaled_interrupt_owns_vector(uint8_t vector)
+{
+    uint32_t index = 0u;
+    return msi_find_vector(vector, &index) != NULL;
+}
+
+void message_signaled_interrupt_get_statistics(MessageSignaledInterruptStatistics_t *out)
+{
+    if (out == NULL)
+        return;
+
+    *out = (MessageSignaledInterruptStatistics_t) {0};
+    for (uint32_t slot = 0u; slot < MESSAGE_SIGNALED_INTERRUPT_MAX_FUNCTIONS; ++slot)
+    {
+        const MessageSignaledInterruptFunction_t *const entry = &msi_functions[slot];
+        if (!entry->enabled)
+            continue;
+        ++out->functions;
+        out->msix_functions += entry->mode == MESSAGE_SIGNALED_INTERRUPT_MODE_MSIX ? 1u : 0u;
+        out->vectors += entry->vector_count;
+    }
+    out->enable_failures = msi_enable_failures;
+    out->retargets = msi_retargets;
+}
+
+void message_signaled_interrupt_report(Serial_t *serial)
+{
+    MessageSignaledInterruptStatistics_t statistics;
+
+    message_signaled_interrupt_get_statistics(&statistics);
+
+    kernel_telemetry_begin_record(serial, "msi");
+    kernel_telemetry_write_unsigned("functions", statistics.functions);
+    kernel_telemetry_write_unsigned("msix_functions", statistics.msix_functions);
+    kernel_telemetry_write_unsigned("vectors", statistics.vectors);
+    kernel_telemetry_write_unsigned("enable_failures", statistics.enable_failures);
+    kernel_telemetry_write_unsigned("retargets", statistics.retargets);
+    kernel_telemetry_end_record();
+
+    for (uint32_t slot = 0u; slot < MESSAGE_SIGNALED_INTERRUPT_MAX_FUNCTIONS; ++slot)
+    {
+        const MessageSignaledInterruptFunction_t *const entry = &msi_functions[slot];
+        if (!entry->enabled)
+            continue;
+
+        kernel_telemetry_begin_record(serial, "msi_function");
+        kernel_telemetry_write_text("owner", entry->owner != NULL ? entry->owner : "?");
+        kernel_telemetry_write_unsigned("bus", entry->bus);
+        kernel_telemetry_write_unsigned("device", entry->device);
+        kernel_telemetry_write_unsigned("function", entry->function);
+        kernel_telemetry_write_text("mode", entry->mode == MESSAGE_SIGNALED_INTERRUPT_MODE_MSIX ? "msix" : "msi");
+        kernel_telemetry_write_unsigned("first_vector", entry->first_vector);
+        kernel_telemetry_write_unsigned("vectors", entry->vector_count);
+        kernel_telemetry_write_unsigned("table_size", entry->mode == MESSAGE_SIGNALED_INTERRUPT_MODE_MSIX
+                                                          ? entry->capabilities.msix_table_size
+                                                          : entry->capabilities.msi_messages);
+        kernel_telemetry_write_unsigned("pending", message_signaled_interrupt_is_pending(entry->first_vector));
+        kernel_telemetry_end_record();
+    }
+}
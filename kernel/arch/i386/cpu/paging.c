@@ -8,18 +8,33 @@
  *          operations on the active page directory.
  */
 
-#include <kernel/cpu/apic_ipi.h>
 #include <kernel/cpu/paging.h>
+#include <kernel/cpu/tlb_shootdown.h>
+#include <kernel/lib/asmutils.h>
 
 ////////////////////////////////////////////////////////////
 // Private State
 ////////////////////////////////////////////////////////////
 
+#define PAGING_CPUID_EDX_PSE 0x00000008u
+#define PAGING_CPUID_EDX_PGE 0x00002000u
+#define PAGING_CPUID_EDX_PAT 0x00010000u
+#define PAGING_IA32_PAT_MSR  0x277u
+#define PAGING_CR4_PSE       0x00000010u
+#define PAGING_CR4_PGE       0x00000080u
+
+/* PA0–PA3 keep their reset values (WB, WT, UC-, UC); PA4 becomes WC and PA5–PA7
+   repeat the upper half of the reset layout. A PTE selects PA(PAT*4+PCD*2+PWT). */
+#define PAGING_PAT_VALUE 0x0007040100070406ull
+
 extern PageDirectory_t boot_page_directory;
 
 PageDirectory_t *current_page_directory = NULL;
 static bool page_table_runtime_owned[1024] = {0};
 static uint32_t page_table_runtime_owned_count = 0u;
+static bool paging_page_attribute_table_programmed = false;
+static uint32_t paging_extension_cr4_bits = 0u;
+static uint32_t paging_large_page_count = 0u;
 
 #if !defined(LPL_KERNEL_REAL_TIME_MODE)
 /*
@@ -192,6 +207,102 @@ static void paging_clear_pte(PageTableEntry_t *pte)
     pte->page_frame_base = 0;
 }
 
+/**
+ * @brief Resolve the PTE backing a virtual address, or NULL when unmapped.
+ */
+static PageTableEntry_t *paging_find_present_pte(uint32_t virt_addr)
+{
+    PageDirectoryEntry_t *pde = &current_page_directory->entries[PAGE_DIRECTORY_INDEX(virt_addr)];
+    if (!pde->present || pde->page_size)
+        return NULL;
+
+    PageTableEntry_t *pte = &paging_get_page_table(pde)->entries[PAGE_TABLE_INDEX(virt_addr)];
+    return pte->present ? pte : NULL;
+}
+
+/**
+ * @brief Resolve the PDE of a present 4 MiB mapping, or NULL when @p virt_addr
+ *        is unmapped or sits behind a page table.
+ */
+static PageDirectoryEntry_t *paging_find_large_pde(uint32_t virt_addr)
+{
+    PageDirectoryEntry_t *pde = &current_page_directory->entries[PAGE_DIRECTORY_INDEX(virt_addr)];
+    return (pde->present && pde->page_size) ? pde : NULL;
+}
+
+static inline uint32_t paging_read_cr4(void)
+{
+    uint32_t cr4;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    return cr4;
+}
+
+static inline void paging_write_cr4(uint32_t cr4) { __asm__ volatile("mov %0, %%cr4" ::"r"(cr4) : "memory"); }
+
+static inline uint32_t paging_save_and_disable_interrupts(void)
+{
+    uint32_t flags;
+    __asm__ volatile("pushfl; popl %0; cli" : "=r"(flags)::"memory");
+    return flags;
+}
+
+static inline void paging_restore_interrupts(uint32_t flags)
+{
+    if (flags & 0x200u)
+        __asm__ volatile("sti" ::: "memory");
+}
+
+static inline void paging_write_back_and_invalidate_caches(void) { __asm__ volatile("wbinvd" ::: "memory"); }
+
+/**
+ * @brief Load PAGING_PAT_VALUE into this CPU's IA32_PAT.
+ *
+ * @details The SDM's sequence, minus disabling the caches: nothing maps PA4
+ *          before this runs, so no line can be cached under the type it changes.
+ */
+static void paging_program_page_attribute_table(void)
+{
+    const uint32_t flags = paging_save_and_disable_interrupts();
+
+    paging_write_back_and_invalidate_caches();
+    asmutils_write_model_specific_register(PAGING_IA32_PAT_MSR, PAGING_PAT_VALUE);
+    paging_flush_tlb();
+
+    paging_restore_interrupts(flags);
+}
+
+/**
+ * @brief Set PWT/PCD/PAT on a 4 MiB directory entry for @p type.
+ *
+ * @details The PS=1 layout moves the PAT selector from bit 7 (now PS) to bit 12,
+ *          the low bit of the frame field; bits 13–21 stay zero because the
+ *          frame is 4 MiB aligned.
+ */
+static void paging_encode_large_page_memory_type(PageDirectoryEntry_t *pde, PagingMemoryType_t type)
+{
+    PageTableEntry_t encoded = {0};
+
+    (void) paging_encode_memory_type(&encoded, type);
+    pde->write_through = encoded.write_through;
+    pde->cache_disable = encoded.cache_disable;
+    pde->page_table_base = (pde->page_table_base & ~1u) | encoded.page_attribute_table;
+}
+
+static void paging_clear_pde(PageDirectoryEntry_t *pde)
+{
+    pde->present = 0;
+    pde->read_write = 0;
+    pde->user_supervisor = 0;
+    pde->write_through = 0;
+    pde->cache_disable = 0;
+    pde->accessed = 0;
+    pde->reserved_zero = 0;
+    pde->page_size = 0;
+    pde->ignored = 0;
+    pde->available = 0;
+    pde->page_table_base = 0;
+}
+
 /**
  * @brief Check whether a page table has any present entries.
  */
@@ -232,6 +343,10 @@ bool paging_map_page(uint32_t virt_addr, uint32_t phys_addr, PageDirectoryEntry_
 
     PageDirectoryEntry_t *pde = &current_page_directory->entries[pd_index];
 
+    /* A 4 MiB mapping already owns the whole directory slot. */
+    if (pde->present && pde->page_size)
+        return false;
+
     if (!pde->present)
     {
         if (!paging_create_page_table(pde, pde_flags))
@@ -262,7 +377,7 @@ bool paging_unmap_page(uint32_t virt_addr)
     uint32_t pt_index = PAGE_TABLE_INDEX(virt_addr);
 
     PageDirectoryEntry_t *pde = &current_page_directory->entries[pd_index];
-    if (!pde->present)
+    if (!pde->present || pde->page_size)
         return false;
 
     PageTable_t *page_table = paging_get_page_table(pde);
@@ -271,31 +386,25 @@ bool paging_unmap_page(uint32_t virt_addr)
     if (!pte->present)
         return false;
 
+    /* The emptied page table is freed only once no other CPU can still walk it
+       through a stale entry: inside the caller's batch if one is open. */
+    tlb_shootdown_begin();
     paging_clear_pte(pte);
 
     if (page_table_runtime_owned[pd_index] && paging_is_page_table_empty(page_table))
     {
         uint32_t page_table_phys = PAGE_FRAME_ADDR(pde);
 
-        pde->present = 0;
-        pde->read_write = 0;
-        pde->user_supervisor = 0;
-        pde->write_through = 0;
-        pde->cache_disable = 0;
-        pde->accessed = 0;
-        pde->reserved_zero = 0;
-        pde->page_size = 0;
-        pde->ignored = 0;
-        pde->available = 0;
-        pde->page_table_base = 0;
+        paging_clear_pde(pde);
 
         page_table_runtime_owned[pd_index] = false;
         if (page_table_runtime_owned_count > 0u)
             --page_table_runtime_owned_count;
-        physical_memory_manager_page_frame_free(page_table_phys);
+        tlb_shootdown_defer_frame_free(page_table_phys, 0u);
     }
 
-    advanced_pic_ipi_broadcast_tlb_shootdown(virt_addr);
+    tlb_shootdown_page(virt_addr);
+    tlb_shootdown_end();
     return true;
 }
 
@@ -312,6 +421,12 @@ bool paging_get_physical_address(uint32_t virt_addr, uint32_t *phys_addr)
     if (!pde->present)
         return false;
 
+    if (pde->page_size)
+    {
+        *phys_addr = (PAGE_FRAME_ADDR(pde) & PAGING_LARGE_PAGE_MASK) | (virt_addr & ~PAGING_LARGE_PAGE_MASK);
+        return true;
+    }
+
     PageTable_t *page_table = paging_get_page_table(pde);
     PageTableEntry_t *pte = &page_table->entries[pt_index];
 
@@ -339,7 +454,7 @@ bool paging_set_page_read_only(uint32_t virt_addr)
     uint32_t pt_index = PAGE_TABLE_INDEX(virt_addr);
 
     PageDirectoryEntry_t *pde = &current_page_directory->entries[pd_index];
-    if (!pde->present)
+    if (!pde->present || pde->page_size)
         return false;
 
     /* Only the page table entry is cleared, never the directory entry: the
@@ -371,6 +486,12 @@ bool paging_page_is_read_only(uint32_t virt_addr, bool *is_read_only)
     if (!pde->present)
         return false;
 
+    if (pde->page_size)
+    {
+        *is_read_only = (pde->read_write == 0);
+        return true;
+    }
+
     PageTable_t *page_table = paging_get_page_table(pde);
     PageTableEntry_t *pte = &page_table->entries[pt_index];
 
@@ -381,4 +502,171 @@ bool paging_page_is_read_only(uint32_t virt_addr, bool *is_read_only)
     return true;
 }
 
+bool paging_initialize_page_attribute_table(void)
+{
+    uint32_t edx = 0u;
+
+    asmutils_cpuid(1u, 0u, NULL, NULL, NULL, &edx);
+    if ((edx & PAGING_CPUID_EDX_PAT) == 0u)
+        return false;
+
+    paging_program_page_attribute_table();
+    paging_page_attribute_table_programmed = true;
+    return true;
+}
+
+void paging_initialize_page_attribute_table_secondary(void)
+{
+    if (paging_page_attribute_table_programmed)
+        paging_program_page_attribute_table();
+}
+
+bool paging_page_attribute_table_available(void) { return paging_page_attribute_table_programmed; }
+
+PagingMemoryType_t paging_encode_memory_type(PageTableEntry_t *pte_flags, PagingMemoryType_t type)
+{
+    if (type == PAGING_MEMORY_TYPE_WRITE_COMBINING && !paging_page_attribute_table_programmed)
+        type = PAGING_MEMORY_TYPE_WRITE_THROUGH;
+
+    pte_flags->page_attribute_table = (type == PAGING_MEMORY_TYPE_WRITE_COMBINING);
+    pte_flags->cache_disable = (type == PAGING_MEMORY_TYPE_UNCACHED);
+    pte_flags->write_through = (type == PAGING_MEMORY_TYPE_WRITE_THROUGH || type == PAGING_MEMORY_TYPE_UNCACHED);
+    return type;
+}
+
+bool paging_set_page_memory_type(uint32_t virt_addr, PagingMemoryType_t type)
+{
+    if (!current_page_directory)
+        return false;
+
+    virt_addr = PAGE_ALIGN_DOWN(virt_addr);
+
+    PageDirectoryEntry_t *large_pde = paging_find_large_pde(virt_addr);
+    if (large_pde)
+    {
+        paging_encode_large_page_memory_type(large_pde, type);
+        paging_invlpg(virt_addr);
+        return true;
+    }
+
+    PageTableEntry_t *pte = paging_find_present_pte(virt_addr);
+    if (!pte)
+        return false;
+
+    (void) paging_encode_memory_type(pte, type);
+    paging_invlpg(virt_addr);
+    return true;
+}
+
+void paging_commit_memory_type_change(void)
+{
+    paging_write_back_and_invalidate_caches();
+    tlb_shootdown_all();
+}
+
 uint32_t paging_get_runtime_owned_page_table_count(void) { return page_table_runtime_owned_count; }
+
+bool paging_initialize_page_size_extensions(void)
+{
+    uint32_t edx = 0u;
+
+    asmutils_cpuid(1u, 0u, NULL, NULL, NULL, &edx);
+    paging_extension_cr4_bits = 0u;
+    if (edx & PAGING_CPUID_EDX_PSE)
+        paging_extension_cr4_bits |= PAGING_CR4_PSE;
+    if (edx & PAGING_CPUID_EDX_PGE)
+        paging_extension_cr4_bits |= PAGING_CR4_PGE;
+
+    paging_initialize_page_size_extensions_secondary();
+    return (paging_extension_cr4_bits & PAGING_CR4_PSE) != 0u;
+}
+
+void paging_initialize_page_size_extensions_secondary(void)
+{
+    if (paging_extension_cr4_bits == 0u)
+        return;
+
+    /* Setting PGE flushes every TLB entry, globals included, so no stale
+       translation survives the switch. */
+    paging_write_cr4(paging_read_cr4() | paging_extension_cr4_bits);
+}
+
+bool paging_large_pages_available(void) { return (paging_extension_cr4_bits & PAGING_CR4_PSE) != 0u; }
+
+bool paging_global_pages_available(void) { return (paging_extension_cr4_bits & PAGING_CR4_PGE) != 0u; }
+
+bool paging_map_large_page(uint32_t virt_addr, uint32_t phys_addr, PageDirectoryEntry_t pde_flags,
+                           PagingMemoryType_t type)
+{
+    if (!current_page_directory || !paging_large_pages_available())
+        return false;
+    if ((virt_addr | phys_addr) & ~PAGING_LARGE_PAGE_MASK)
+        return false;
+
+    /* Never replace a page table: its 4 KiB mappings would silently vanish. */
+    PageDirectoryEntry_t *pde = &current_page_directory->entries[PAGE_DIRECTORY_INDEX(virt_addr)];
+    if (pde->present)
+        return false;
+
+    pde->read_write = pde_flags.read_write;
+    pde->user_supervisor = pde_flags.user_supervisor;
+    pde->accessed = 0;
+    pde->reserved_zero = 0;
+    pde->page_size = 1;
+    pde->ignored = 0;
+    pde->available = 0;
+    pde->page_table_base = phys_addr >> 12;
+    paging_encode_large_page_memory_type(pde, type);
+    pde->present = 1;
+
+    ++paging_large_page_count;
+    paging_invlpg(virt_addr);
+    return true;
+}
+
+bool paging_unmap_large_page(uint32_t virt_addr)
+{
+    if (!current_page_directory)
+        return false;
+
+    virt_addr &= PAGING_LARGE_PAGE_MASK;
+
+    PageDirectoryEntry_t *pde = paging_find_large_pde(virt_addr);
+    if (!pde)
+        return false;
+
+    paging_clear_pde(pde);
+    if (paging_large_page_count > 0u)
+        --paging_large_page_count;
+
+    tlb_shootdown_page(virt_addr);
+    return true;
+}
+
+bool paging_is_large_page(uint32_t virt_addr)
+{
+    return current_page_directory && paging_find_large_pde(virt_addr) != NULL;
+}
+
+uint32_t paging_get_large_page_count(void) { return paging_large_page_count; }
+
+uint32_t paging_mark_range_global(uint32_t start_addr, uint32_t end_addr)
+{
+    uint32_t marked = 0u;
+
+    if (!current_page_directory || !paging_global_pages_available())
+        return 0u;
+
+    for (uint32_t virt_addr = PAGE_ALIGN_DOWN(start_addr); virt_addr < end_addr; virt_addr += PAGE_SIZE)
+    {
+        PageTableEntry_t *pte = paging_find_present_pte(virt_addr);
+        if (!pte)
+            continue;
+
+        pte->global = 1;
+        paging_invlpg(virt_addr);
+        ++marked;
+    }
+
+    return marked;
+}
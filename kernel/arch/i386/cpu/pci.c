@@ -6,6 +6,7 @@
 */
 
 #include <kernel/cpu/pci.h>
+#include <kernel/core/lock.h>
 #include <kernel/lib/asmutils.h>
 
 #include <stddef.h>
@@ -29,14 +30,41 @@ static uint32_t peripheral_component_interconnect_build_address(uint8_t bus, uin
                        (((uint32_t) function & 0x07u) << 8u) | ((uint32_t) offset & 0xFCu));
 }
 
-uint32_t peripheral_component_interconnect_config_read_dword(uint8_t bus, uint8_t device, uint8_t function,
-                                                             uint8_t offset)
+/*
+** The address and data accesses are two separate port operations, and the word
+** and byte writes are a read-modify-write of the whole dword: anything else
+** touching config space in between (another CPU, or an interrupt handler such
+** as the IRQ balancer retargeting an MSI) would aim the data access at its own
+** register. Every sequence holds this lock with interrupts off.
+*/
+static KernelTicketLock_t peripheral_component_interconnect_config_lock;
+
+static uint32_t peripheral_component_interconnect_config_read_dword_locked(uint8_t bus, uint8_t device,
+                                                                           uint8_t function, uint8_t offset)
 {
     asmutils_output_dword(PERIPHERAL_COMPONENT_INTERCONNECT_CONFIG_ADDRESS_PORT,
                           peripheral_component_interconnect_build_address(bus, device, function, offset));
     return asmutils_input_dword(PERIPHERAL_COMPONENT_INTERCONNECT_CONFIG_DATA_PORT);
 }
 
+static void peripheral_component_interconnect_config_write_dword_locked(uint8_t bus, uint8_t device, uint8_t function,
+                                                                        uint8_t offset, uint32_t value)
+{
+    asmutils_output_dword(PERIPHERAL_COMPONENT_INTERCONNECT_CONFIG_ADDRESS_PORT,
+                          peripheral_component_interconnect_build_address(bus, device, function, offset));
+    asmutils_output_dword(PERIPHERAL_COMPONENT_INTERCONNECT_CONFIG_DATA_PORT, value);
+}
+
+uint32_t peripheral_component_interconnect_config_read_dword(uint8_t bus, uint8_t device, uint8_t function,
+                                                             uint8_t offset)
+{
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&peripheral_component_interconnect_config_lock);
+    uint32_t dword = peripheral_component_interconnect_config_read_dword_locked(bus, device, function, offset);
+
+    kernel_ticket_lock_release_irqrestore(&peripheral_component_interconnect_config_lock, flags);
+    return dword;
+}
+
 uint16_t peripheral_component_interconnect_config_read_word(uint8_t bus, uint8_t device, uint8_t function,
                                                             uint8_t offset)
 {
@@ -56,29 +84,34 @@ uint8_t peripheral_component_interconnect_config_read_byte(uint8_t bus, uint8_t
 void peripheral_component_interconnect_config_write_dword(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset,
                                                           uint32_t value)
 {
-    asmutils_output_dword(PERIPHERAL_COMPONENT_INTERCONNECT_CONFIG_ADDRESS_PORT,
-                          peripheral_component_interconnect_build_address(bus, device, function, offset));
-    asmutils_output_dword(PERIPHERAL_COMPONENT_INTERCONNECT_CONFIG_DATA_PORT, value);
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&peripheral_component_interconnect_config_lock);
+
+    peripheral_component_interconnect_config_write_dword_locked(bus, device, function, offset, value);
+    kernel_ticket_lock_release_irqrestore(&peripheral_component_interconnect_config_lock, flags);
 }
 
 void peripheral_component_interconnect_config_write_word(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset,
                                                          uint16_t value)
 {
-    uint32_t dword = peripheral_component_interconnect_config_read_dword(bus, device, function, offset);
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&peripheral_component_interconnect_config_lock);
+    uint32_t dword = peripheral_component_interconnect_config_read_dword_locked(bus, device, function, offset);
     uint32_t shift = (offset & 2u) * 8u;
 
     dword = (dword & ~(0xFFFFu << shift)) | ((uint32_t) value << shift);
-    peripheral_component_interconnect_config_write_dword(bus, device, function, offset, dword);
+    peripheral_component_interconnect_config_write_dword_locked(bus, device, function, offset, dword);
+    kernel_ticket_lock_release_irqrestore(&peripheral_component_interconnect_config_lock, flags);
 }
 
 void peripheral_component_interconnect_config_write_byte(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset,
                                                          uint8_t value)
 {
-    uint32_t dword = peripheral_component_interconnect_config_read_dword(bus, device, function, offset);
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&peripheral_component_interconnect_config_lock);
+    uint32_t dword = peripheral_component_interconnect_config_read_dword_locked(bus, device, function, offset);
     uint32_t shift = (offset & 3u) * 8u;
 
     dword = (dword & ~(0xFFu << shift)) | ((uint32_t) value << shift);
-    peripheral_component_interconnect_config_write_dword(bus, device, function, offset, dword);
+    peripheral_component_interconnect_config_write_dword_locked(bus, device, function, offset, dword);
+    kernel_ticket_lock_release_irqrestore(&peripheral_component_interconnect_config_lock, flags);
 }
 
 static PeripheralComponentInterconnectDevice_t
@@ -176,10 +209,13 @@ uint8_t peripheral_component_interconnect_read_base_address_register(
     out_bar->base = 0u;
     out_bar->size = 0u;
 
-    /* Probe the size: write all-ones, read back the writable bits, then restore. */
-    peripheral_component_interconnect_config_write_dword(bus, device, function, offset, 0xFFFFFFFFu);
-    uint32_t probe = peripheral_component_interconnect_config_read_dword(bus, device, function, offset);
-    peripheral_component_interconnect_config_write_dword(bus, device, function, offset, original);
+    /* Probe the size: write all-ones, read back the writable bits, then restore.
+       Held as one sequence so nobody reads the BAR while it holds the mask. */
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&peripheral_component_interconnect_config_lock);
+    peripheral_component_interconnect_config_write_dword_locked(bus, device, function, offset, 0xFFFFFFFFu);
+    uint32_t probe = peripheral_component_interconnect_config_read_dword_locked(bus, device, function, offset);
+    peripheral_component_interconnect_config_write_dword_locked(bus, device, function, offset, original);
+    kernel_ticket_lock_release_irqrestore(&peripheral_component_interconnect_config_lock, flags);
 
     if (out_bar->is_io)
     {
@@ -221,3 +257,47 @@ const PeripheralComponentInterconnectDevice_t *peripheral_component_interconnect
     }
     return NULL;
 }
+
+/* Capability pointers are dword aligned and at least 0x40: at most 48 fit in the
+   header-less part of the 256-byte config space. */
+#define PERIPHERAL_COMPONENT_INTERCONNECT_CAPABILITY_WALK_LIMIT 48u
+
+uint8_t peripheral_component_interconnect_find_capability(uint8_t bus, uint8_t device, uint8_t function,
+                                                          uint8_t capability_id)
+{
+    const uint16_t status = peripheral_component_interconnect_config_read_word(
+        bus, device, function, PERIPHERAL_COMPONENT_INTERCONNECT_REGISTER_STATUS);
+    if ((status & PERIPHERAL_COMPONENT_INTERCONNECT_STATUS_CAPABILITIES_LIST) == 0u)
+        return 0u;
+
+    uint8_t pointer = peripheral_component_interconnect_config_read_byte(
+        bus, device, function, PERIPHERAL_COMPONENT_INTERCONNECT_REGISTER_CAPABILITIES);
+    for (uint32_t guard = 0u; guard < PERIPHERAL_COMPONENT_INTERCONNECT_CAPABILITY_WALK_LIMIT; ++guard)
+    {
+        pointer &= 0xFCu;
+        if (pointer == 0u)
+            break;
+        if (peripheral_component_interconnect_config_read_byte(bus, device, function, pointer) == capability_id)
+            return pointer;
+        pointer = peripheral_component_interconnect_config_read_byte(bus, device, function, (uint8_t) (pointer + 1u));
+    }
+    return 0u;
+}
+
+uint64_t peripheral_component_interconnect_read_memory_base(uint8_t bus, uint8_t device, uint8_t function,
+                                                            uint8_t index)
+{
+    if (index >= PERIPHERAL_COMPONENT_INTERCONNECT_BASE_ADDRESS_REGISTER_COUNT)
+        return 0u;
+
+    const uint8_t offset = (uint8_t) (PERIPHERAL_COMPONENT_INTERCONNECT_REGISTER_BASE_ADDRESS_0 + (index * 4u));
+    const uint32_t low = peripheral_component_interconnect_config_read_dword(bus, device, function, offset);
+    if ((low & 0x1u) != 0u)
+        return 0u;
+
+    uint32_t high = 0u;
+    if (((low >> 1u) & 0x3u) == 0x2u && index < (PERIPHERAL_COMPONENT_INTERCONNECT_BASE_ADDRESS_REGISTER_COUNT - 1u))
+        high = peripheral_component_interconnect_config_read_dword(bus, device, function, (uint8_t) (offset + 4u));
+
+    return ((uint64_t) high << 32u) | (uint64_t) (low & 0xFFFFFFF0u);
+}
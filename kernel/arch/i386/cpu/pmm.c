@@ -11,14 +11,22 @@
  *          is identical for both kernel modes.  The compile-time flag
  *          LPL_KERNEL_REAL_TIME_MODE selects the backing data structure:
  *            - Realtime / client:  intrusive Free-List LIFO stack, O(1).
- *            - Server:             Buddy Allocator with split/merge support.
+ *            - Server:             Buddy Allocator with split/merge support,
+ *                                  behind per-CPU caches for single pages.
+ *
+ *          One ticket lock guards the free lists. On the server build a
+ *          CPU takes single pages from its own cache, under a lock only it
+ *          and a remote drain contend for, and visits the buddy lists once
+ *          per PHYSICAL_MEMORY_MANAGER_CACHE_BATCH pages.
  */
 
 #include <kernel/boot/multiboot_info.h>
 #include <kernel/config.h>
+#include <kernel/core/lock.h>
 #include <kernel/cpu/numa_policy.h>
 #include <kernel/cpu/paging.h>
 #include <kernel/cpu/pmm.h>
+#include <kernel/diag/trace.h>
 #include <stdbool.h>
 #include <stddef.h>
 
@@ -80,6 +88,10 @@ static uint32_t free_page_count_watermark_low = 0xFFFFFFFFu;
 /** @brief Track whether watermarks have been seeded after first population. */
 static bool watermarks_seeded = false;
 
+/** @brief Guards the free lists and everything above; all-zero is unlocked. */
+static KernelTicketLock_t pmm_lock;
+static KernelLockStatistics_t pmm_lock_statistics;
+
 static uint32_t pmm_local_hits = 0;
 static uint32_t pmm_remote_hits = 0;
 static uint32_t pmm_cross_node_fallbacks = 0;
@@ -180,6 +192,14 @@ static uint32_t freelist_pop(void)
 /** @brief Free-list heads for each buddy order (order 0 = 4 KB). */
 static uint32_t buddy_free_list_heads[NUMA_POLICY_MAX_NODES][PMM_BUDDY_MAX_ORDER + 1u] = {0};
 
+/**
+ * @brief Blocks on each free list, kept next to the heads under pmm_lock.
+ * @details The lists are chained through the free pages themselves, so walking
+ *          one without the lock follows pointers a concurrent pop hands out and
+ *          overwrites. Readers take these words instead, with no lock at all.
+ */
+static uint32_t buddy_free_block_counts[NUMA_POLICY_MAX_NODES][PMM_BUDDY_MAX_ORDER + 1u] = {0};
+
 /** @brief Free-state marker for page indices (1 = free block base, 0 = otherwise). */
 static uint8_t buddy_page_is_free[PMM_MAX_PAGE_COUNT] = {0};
 
@@ -223,6 +243,8 @@ static void buddy_list_push(uint8_t order, uint32_t phys_addr)
 
     *page_virt = buddy_free_list_heads[node_id][order];
     buddy_free_list_heads[node_id][order] = phys_addr;
+    __atomic_store_n(&buddy_free_block_counts[node_id][order], buddy_free_block_counts[node_id][order] + 1u,
+                     __ATOMIC_RELAXED);
     buddy_page_is_free[page_index] = 1u;
     buddy_page_order[page_index] = order;
 
@@ -253,6 +275,8 @@ static uint32_t buddy_list_pop_from_node(uint32_t target_node, uint8_t order)
     uint32_t page_index = buddy_phys_to_page_index(phys_addr);
 
     buddy_free_list_heads[target_node][order] = *page_virt;
+    __atomic_store_n(&buddy_free_block_counts[target_node][order], buddy_free_block_counts[target_node][order] - 1u,
+                     __ATOMIC_RELAXED);
     buddy_page_is_free[page_index] = 0u;
 
 #    ifdef LPL_KERNEL_DEBUG_POISON
@@ -301,6 +325,8 @@ static bool buddy_list_remove_exact(uint32_t target_node, uint8_t order, uint32_
             else
                 buddy_free_list_heads[target_node][order] = next_phys;
 
+            __atomic_store_n(&buddy_free_block_counts[target_node][order],
+                             buddy_free_block_counts[target_node][order] - 1u, __ATOMIC_RELAXED);
             buddy_page_is_free[page_index] = 0u;
             return true;
         }
@@ -363,16 +389,7 @@ static uint32_t buddy_debug_get_free_block_count(uint8_t order)
 
     uint32_t count = 0u;
     for (uint32_t node_id = 0; node_id < numa_policy_get_node_count(); ++node_id)
-    {
-        uint32_t current_phys = buddy_free_list_heads[node_id][order];
-
-        while (current_phys)
-        {
-            uint32_t *current_virt = (uint32_t *) pmm_phys_to_virt(current_phys);
-            current_phys = *current_virt;
-            ++count;
-        }
-    }
+        count += __atomic_load_n(&buddy_free_block_counts[node_id][order], __ATOMIC_RELAXED);
 
     return count;
 }
@@ -438,17 +455,19 @@ static void buddy_insert_order(uint32_t phys_addr, uint8_t requested_order)
 }
 
 /**
- * @brief Remove a page from the Buddy Allocator.
- * @details Allocation path with downward splitting.
+ * @brief Remove a block from the Buddy Allocator.
+ * @details Allocation path with downward splitting, trying @p local_node
+ *          first and the other nodes in turn.
  * @return Physical address, or 0 if empty.
  */
-static uint32_t buddy_remove_order(uint8_t requested_order)
+static uint32_t buddy_remove_order_from(uint32_t local_node, uint8_t requested_order)
 {
     if (!buddy_is_valid_order(requested_order))
         return 0;
 
-    uint32_t local_node = numa_policy_get_local_node();
     uint32_t node_count = numa_policy_get_node_count();
+    if (local_node >= node_count)
+        local_node = 0;
     uint32_t target_node = local_node;
     uint8_t order = requested_order;
 
@@ -500,16 +519,22 @@ static uint32_t buddy_remove_order(uint8_t requested_order)
     return block_phys;
 }
 
-static void buddy_insert(uint32_t phys_addr) { buddy_insert_order(phys_addr, 0u); }
+static uint32_t buddy_remove_order(uint8_t requested_order)
+{
+    return buddy_remove_order_from(numa_policy_get_local_node(), requested_order);
+}
 
-static uint32_t buddy_remove(void) { return buddy_remove_order(0u); }
+static void buddy_insert(uint32_t phys_addr) { buddy_insert_order(phys_addr, 0u); }
 
 static void buddy_reset_state(void)
 {
     for (uint32_t node_id = 0; node_id < NUMA_POLICY_MAX_NODES; ++node_id)
     {
         for (uint32_t order = 0u; order <= PMM_BUDDY_MAX_ORDER; ++order)
+        {
             buddy_free_list_heads[node_id][order] = 0;
+            buddy_free_block_counts[node_id][order] = 0u;
+        }
     }
 
     for (uint32_t page_index = 0u; page_index < PMM_MAX_PAGE_COUNT; ++page_index)
@@ -524,6 +549,178 @@ static void buddy_reset_state(void)
     buddy_double_free_count = 0u;
 }
 
+////////////////////////////////////////////////////////////
+// Per-CPU Page Caches
+////////////////////////////////////////////////////////////
+
+#    define PMM_CACHE_SLOT_COUNT CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC
+
+/**
+ * @brief Hot single pages of one logical CPU.
+ * @details Only its owner allocates or frees through it; the lock is there for
+ *          physical_memory_manager_drain_cpu_caches() running elsewhere, so it
+ *          is all but uncontended. Cached pages are neither free nor allocated
+ *          in the buddy's maps: buddy_page_allocated reads 0, which is what
+ *          catches a second free of one.
+ */
+typedef struct {
+    KernelTicketLock_t lock;
+    uint32_t head;  /**< Intrusive LIFO through the direct map (physical, 0 = empty). */
+    uint32_t count; /**< Pages on the list. */
+    uint32_t allocations;
+    uint32_t frees;
+    uint32_t refills;
+    uint32_t drains;
+} PmmPageCache_t;
+
+static PmmPageCache_t pmm_page_caches[PMM_CACHE_SLOT_COUNT];
+
+static void pmm_cache_push(PmmPageCache_t *cache, uint32_t phys_addr)
+{
+    uint32_t *page_virt = (uint32_t *) pmm_phys_to_virt(phys_addr);
+
+    *page_virt = cache->head;
+    cache->head = phys_addr;
+    ++cache->count;
+    buddy_page_allocated[buddy_phys_to_page_index(phys_addr)] = 0u;
+
+#    ifdef LPL_KERNEL_DEBUG_POISON
+    /* Refilled pages may come from a split block that was never poisoned. */
+    uint8_t *poison_ptr = (uint8_t *) (page_virt + 1);
+    for (uint32_t i = 0; i < PAGE_SIZE - sizeof(uint32_t); ++i)
+        poison_ptr[i] = 0xAA;
+#    endif
+}
+
+static uint32_t pmm_cache_pop(PmmPageCache_t *cache)
+{
+    const uint32_t phys_addr = cache->head;
+    if (!phys_addr)
+        return 0;
+
+    uint32_t *page_virt = (uint32_t *) pmm_phys_to_virt(phys_addr);
+    cache->head = *page_virt;
+    --cache->count;
+    buddy_page_allocated[buddy_phys_to_page_index(phys_addr)] = 1u;
+
+#    ifdef LPL_KERNEL_DEBUG_POISON
+    const uint8_t *poison_ptr = (const uint8_t *) (page_virt + 1);
+    for (uint32_t i = 0; i < PAGE_SIZE - sizeof(uint32_t); ++i)
+    {
+        if (poison_ptr[i] != 0xAA)
+        {
+            __atomic_fetch_add(&pmm_uaf_anomalies, 1u, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+#    endif
+
+    return phys_addr;
+}
+
+/**
+ * @brief Take up to one batch from the buddy lists, the slot's node first.
+ * @note Called with the cache lock held; takes pmm_lock once for the batch.
+ */
+static void pmm_cache_refill(PmmPageCache_t *cache, uint32_t slot)
+{
+    const uint32_t node = numa_policy_get_node_for_slot(slot);
+
+    kernel_ticket_lock_acquire(&pmm_lock);
+    for (uint32_t taken = 0u; taken < PHYSICAL_MEMORY_MANAGER_CACHE_BATCH; ++taken)
+    {
+        const uint32_t phys_addr = buddy_remove_order_from(node, 0u);
+        if (!phys_addr)
+            break;
+        pmm_cache_push(cache, phys_addr);
+    }
+    kernel_ticket_lock_release(&pmm_lock);
+
+    ++cache->refills;
+}
+
+/**
+ * @brief Return up to @p page_count cached pages to the buddy lists.
+ * @note Called with the cache lock held; takes pmm_lock once for the batch.
+ */
+static void pmm_cache_drain(PmmPageCache_t *cache, uint32_t page_count)
+{
+    if (cache->count == 0u)
+        return;
+
+    kernel_ticket_lock_acquire(&pmm_lock);
+    for (uint32_t i = 0u; i < page_count && cache->count != 0u; ++i)
+        buddy_insert(pmm_cache_pop(cache));
+    kernel_ticket_lock_release(&pmm_lock);
+
+    ++cache->drains;
+}
+
+static uint32_t pmm_locked_remove_order(uint8_t order)
+{
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&pmm_lock);
+    const uint32_t phys_addr = buddy_remove_order(order);
+    kernel_ticket_lock_release_irqrestore(&pmm_lock, flags);
+    return phys_addr;
+}
+
+static void pmm_locked_insert_order(uint32_t phys_addr, uint8_t order)
+{
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&pmm_lock);
+    buddy_insert_order(phys_addr, order);
+    kernel_ticket_lock_release_irqrestore(&pmm_lock, flags);
+}
+
+static uint32_t pmm_cache_allocate(void)
+{
+    const uint32_t slot = cpu_topology_get_logical_slot();
+    if (slot >= PMM_CACHE_SLOT_COUNT)
+        return pmm_locked_remove_order(0u);
+
+    PmmPageCache_t *cache = &pmm_page_caches[slot];
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&cache->lock);
+
+    if (cache->count == 0u)
+        pmm_cache_refill(cache, slot);
+    uint32_t phys_addr = pmm_cache_pop(cache);
+    if (phys_addr)
+        ++cache->allocations;
+
+    kernel_ticket_lock_release_irqrestore(&cache->lock, flags);
+
+    /* The buddy is dry, but other CPUs may still hold pages. */
+    if (!phys_addr)
+    {
+        physical_memory_manager_drain_cpu_caches();
+        phys_addr = pmm_locked_remove_order(0u);
+    }
+    return phys_addr;
+}
+
+static void pmm_cache_free(uint32_t phys_addr)
+{
+    const uint32_t slot = cpu_topology_get_logical_slot();
+
+    /* Boot population and anything the buddy would reject go straight to it,
+       so its checks and counters see them. */
+    if (buddy_population_in_progress || slot >= PMM_CACHE_SLOT_COUNT || !buddy_is_valid_phys(phys_addr) ||
+        !buddy_page_allocated[buddy_phys_to_page_index(phys_addr)])
+    {
+        pmm_locked_insert_order(phys_addr, 0u);
+        return;
+    }
+
+    PmmPageCache_t *cache = &pmm_page_caches[slot];
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&cache->lock);
+
+    pmm_cache_push(cache, phys_addr);
+    ++cache->frees;
+    if (cache->count > PHYSICAL_MEMORY_MANAGER_CACHE_HIGH_WATERMARK)
+        pmm_cache_drain(cache, PHYSICAL_MEMORY_MANAGER_CACHE_BATCH);
+
+    kernel_ticket_lock_release_irqrestore(&cache->lock, flags);
+}
+
 #endif /* LPL_KERNEL_REAL_TIME_MODE */
 
 ////////////////////////////////////////////////////////////
@@ -661,9 +858,11 @@ static bool pmm_next_mmap_entry(const uint8_t *mmap_base, uint32_t mmap_length,
 void physical_memory_manager_page_frame_free(uint32_t phys_addr)
 {
 #ifdef LPL_KERNEL_REAL_TIME_MODE
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&pmm_lock);
     freelist_push(phys_addr);
+    kernel_ticket_lock_release_irqrestore(&pmm_lock, flags);
 #else
-    buddy_insert(phys_addr);
+    pmm_cache_free(phys_addr);
 #endif
 }
 
@@ -672,18 +871,27 @@ void physical_memory_manager_page_frame_free_order(uint32_t phys_addr, uint8_t o
 #ifdef LPL_KERNEL_REAL_TIME_MODE
     if (order != 0u)
         return;
-    freelist_push(phys_addr);
+    physical_memory_manager_page_frame_free(phys_addr);
 #else
-    buddy_insert_order(phys_addr, order);
+    if (order == 0u)
+        pmm_cache_free(phys_addr);
+    else
+        pmm_locked_insert_order(phys_addr, order);
 #endif
 }
 
 uint32_t physical_memory_manager_page_frame_allocate(void)
 {
 #ifdef LPL_KERNEL_REAL_TIME_MODE
-    return freelist_pop();
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&pmm_lock);
+    const uint32_t frame = freelist_pop();
+    kernel_ticket_lock_release_irqrestore(&pmm_lock, flags);
+    return frame;
 #else
-    return buddy_remove();
+    KERNEL_TRACE_BEGIN(buddy_span, "pmm.buddy");
+    const uint32_t frame = pmm_cache_allocate();
+    KERNEL_TRACE_END(buddy_span);
+    return frame;
 #endif
 }
 
@@ -692,13 +900,75 @@ uint32_t physical_memory_manager_page_frame_allocate_order(uint8_t order)
 #ifdef LPL_KERNEL_REAL_TIME_MODE
     if (order != 0u)
         return 0;
-    return freelist_pop();
+    return physical_memory_manager_page_frame_allocate();
+#else
+    if (order == 0u)
+        return physical_memory_manager_page_frame_allocate();
+
+    KERNEL_TRACE_BEGIN(buddy_span, "pmm.buddy");
+    uint32_t frame = pmm_locked_remove_order(order);
+    if (!frame)
+    {
+        /* A cached page may be all that keeps its buddy from merging. */
+        physical_memory_manager_drain_cpu_caches();
+        frame = pmm_locked_remove_order(order);
+    }
+    buddy_span.argument = order;
+    KERNEL_TRACE_END(buddy_span);
+    return frame;
+#endif
+}
+
+uint32_t physical_memory_manager_get_free_page_count(void)
+{
+#ifdef LPL_KERNEL_REAL_TIME_MODE
+    return free_page_count;
 #else
-    return buddy_remove_order(order);
+    uint32_t cached_pages = 0u;
+    for (uint32_t slot = 0u; slot < PMM_CACHE_SLOT_COUNT; ++slot)
+        cached_pages += pmm_page_caches[slot].count;
+    return free_page_count + cached_pages;
 #endif
 }
 
-uint32_t physical_memory_manager_get_free_page_count(void) { return free_page_count; }
+void physical_memory_manager_get_cache_statistics(PhysicalMemoryManagerCacheStatistics_t *out)
+{
+    if (!out)
+        return;
+
+    out->allocations = 0u;
+    out->frees = 0u;
+    out->refills = 0u;
+    out->drains = 0u;
+    out->cached_pages = 0u;
+#ifndef LPL_KERNEL_REAL_TIME_MODE
+    for (uint32_t slot = 0u; slot < PMM_CACHE_SLOT_COUNT; ++slot)
+    {
+        const PmmPageCache_t *cache = &pmm_page_caches[slot];
+        out->allocations += cache->allocations;
+        out->frees += cache->frees;
+        out->refills += cache->refills;
+        out->drains += cache->drains;
+        out->cached_pages += cache->count;
+    }
+#endif
+    out->local_pages = pmm_local_hits;
+    out->remote_pages = pmm_remote_hits;
+    out->fallbacks = pmm_cross_node_fallbacks;
+}
+
+void physical_memory_manager_drain_cpu_caches(void)
+{
+#ifndef LPL_KERNEL_REAL_TIME_MODE
+    for (uint32_t slot = 0u; slot < PMM_CACHE_SLOT_COUNT; ++slot)
+    {
+        PmmPageCache_t *cache = &pmm_page_caches[slot];
+        const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&cache->lock);
+        pmm_cache_drain(cache, cache->count);
+        kernel_ticket_lock_release_irqrestore(&cache->lock, flags);
+    }
+#endif
+}
 
 const char *physical_memory_manager_get_strategy_name(void) { return pmm_strategy_name; }
 
@@ -806,6 +1076,9 @@ void physical_memory_manager_initialize(void)
     if (!pmm_get_multiboot_mmap(&mmap_base, &mmap_length))
         return;
 
+    kernel_ticket_lock_initialize(&pmm_lock, &pmm_lock_statistics);
+    kernel_lock_statistics_register(&pmm_lock_statistics, "pmm");
+
     free_page_count = 0u;
     free_page_count_watermark_high = 0u;
     free_page_count_watermark_low = 0xFFFFFFFFu;
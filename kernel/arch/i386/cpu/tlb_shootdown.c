@@ -0,0 +1,594 @@
+/**
+ * @file tlb_shootdown.c
+ * @brief Batched TLB invalidation across CPUs.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#include <kernel/cpu/tlb_shootdown.h>
+
+#include <kernel/core/lock.h>
+#include <kernel/core/thread.h>
+#include <kernel/cpu/apic_ipi.h>
+#include <kernel/cpu/pmm.h>
+#include <kernel/diag/telemetry.h>
+#include <kernel/lib/asmutils.h>
+
+/* Upper bound on the acknowledgement spin, so a wedged AP cannot hang the CPU
+   that unmapped. What the missing CPUs did not confirm is flushed on their side
+   at their next interrupt instead, and the frames the batch deferred are held
+   until they have. */
+#define TLB_SHOOTDOWN_SPIN_LIMIT 1000000u
+
+/* CPUs are numbered in the order they activate, not by topology slot: the BSP's
+   slot can be steered by the smokes, and a shootdown that mistook itself for
+   another CPU would wait on its own acknowledgement. */
+#define TLB_SHOOTDOWN_MAX_CPUS     CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC
+#define TLB_SHOOTDOWN_APIC_IDS     256u
+#define TLB_SHOOTDOWN_UNREGISTERED TLB_SHOOTDOWN_MAX_CPUS
+
+#define TLB_SHOOTDOWN_STATE_IDLE  1u
+#define TLB_SHOOTDOWN_STATE_STALE 2u
+
+/**
+ * @struct TlbShootdownQueue_t
+ * @brief What the calling CPU unmapped since its outermost batch opened.
+ *
+ * Only its own CPU touches a queue, with interrupts off around each edit.
+ */
+typedef struct TlbShootdownQueue {
+    uint32_t depth;
+    uint32_t pages;
+    uint32_t count;
+    bool full_flush;
+    uint32_t addresses[TLB_SHOOTDOWN_FULL_FLUSH_THRESHOLD];
+    uint32_t deferred_head; /* physical address; each block holds {next, order} */
+    uint32_t deferred_count;
+} TlbShootdownQueue_t;
+
+/**
+ * @struct TlbShootdownRequest_t
+ * @brief The batch in flight. Written under the lock, read by the targets
+ *        between seeing their pending bit and clearing it.
+ */
+typedef struct TlbShootdownRequest {
+    volatile uint32_t pending_mask;
+    bool full_flush;
+    uint32_t count;
+    uint32_t addresses[TLB_SHOOTDOWN_FULL_FLUSH_THRESHOLD];
+} TlbShootdownRequest_t;
+
+/* One spare queue past the last CPU, for whoever runs before registering. */
+static TlbShootdownQueue_t tlb_shootdown_queues[TLB_SHOOTDOWN_MAX_CPUS + 1u];
+static TlbShootdownRequest_t tlb_shootdown_request;
+static TlbShootdownStatistics_t tlb_shootdown_statistics;
+static KernelLockStatistics_t tlb_shootdown_lock_statistics;
+static KernelTicketLock_t tlb_shootdown_lock;
+
+static uint8_t tlb_shootdown_index_by_apic_id[TLB_SHOOTDOWN_APIC_IDS]; /* index + 1, 0 = unknown */
+static uint8_t tlb_shootdown_apic_ids[TLB_SHOOTDOWN_MAX_CPUS];
+static uint32_t tlb_shootdown_cpu_count = 0u;
+static volatile uint32_t tlb_shootdown_active_mask = 0u;
+
+/* Per CPU: idle and/or stale. A CPU's bit in the attention mask is set whenever
+   its state may be non-zero, so an interrupt on a busy system tests one word. */
+static volatile uint32_t tlb_shootdown_state[TLB_SHOOTDOWN_MAX_CPUS];
+static volatile uint32_t tlb_shootdown_attention_mask = 0u;
+
+/* Deferred blocks of batches that timed out, chained like a queue's, and the
+   CPUs that still have to flush before any of them may go back to the PMM. */
+static KernelTicketLock_t tlb_shootdown_held_lock;
+static uint32_t tlb_shootdown_held_head = 0u;
+static uint32_t tlb_shootdown_held_count = 0u;
+static uint32_t tlb_shootdown_held_waiting = 0u;
+
+static inline uint32_t tlb_shootdown_save_and_disable_interrupts(void)
+{
+    uint32_t flags;
+
+    __asm__ volatile("pushfl\n\tpopl %0\n\tcli" : "=r"(flags)::"memory");
+    return flags;
+}
+
+static inline void tlb_shootdown_restore_interrupts(uint32_t flags)
+{
+    __asm__ volatile("pushl %0\n\tpopfl" ::"r"(flags) : "memory", "cc");
+}
+
+static inline uint32_t tlb_shootdown_popcount(uint32_t mask) { return (uint32_t) __builtin_popcount(mask); }
+
+/**
+ * @brief Index of the calling CPU, read from its LAPIC rather than the topology.
+ *
+ * @return TLB_SHOOTDOWN_UNREGISTERED before the CPU activated.
+ */
+static uint32_t tlb_shootdown_self(void)
+{
+    if (tlb_shootdown_active_mask == 0u)
+        return TLB_SHOOTDOWN_UNREGISTERED;
+
+    uint32_t apic_id = apic_read(LAPIC_REG_ID);
+    if (!apic_is_x2apic_active())
+        apic_id >>= 24u;
+
+    if (apic_id >= TLB_SHOOTDOWN_APIC_IDS || tlb_shootdown_index_by_apic_id[apic_id] == 0u)
+        return TLB_SHOOTDOWN_UNREGISTERED;
+    return tlb_shootdown_index_by_apic_id[apic_id] - 1u;
+}
+
+static void tlb_shootdown_invalidate(bool full_flush, const uint32_t *addresses, uint32_t count)
+{
+    if (full_flush)
+    {
+        paging_flush_tlb();
+        return;
+    }
+    for (uint32_t i = 0u; i < count; ++i)
+        paging_invlpg(addresses[i]);
+}
+
+/** @brief Run the request in flight if it names the calling CPU, then acknowledge. */
+static void tlb_shootdown_service(uint32_t self)
+{
+    if (self >= TLB_SHOOTDOWN_MAX_CPUS)
+        return;
+
+    const uint32_t bit = 1u << self;
+    if ((__atomic_load_n(&tlb_shootdown_request.pending_mask, __ATOMIC_ACQUIRE) & bit) == 0u)
+        return;
+
+    tlb_shootdown_invalidate(tlb_shootdown_request.full_flush, tlb_shootdown_request.addresses,
+                             tlb_shootdown_request.count);
+    __atomic_and_fetch(&tlb_shootdown_request.pending_mask, ~bit, __ATOMIC_RELEASE);
+}
+
+static void tlb_shootdown_interrupt_handler(const InterruptFrame_t *frame)
+{
+    (void) frame;
+    tlb_shootdown_service(tlb_shootdown_self());
+
+    /* Fixed IPIs are in service until EOI like any LAPIC interrupt; without it the
+       vector would mask its whole priority class, job wake-ups at 0x41 included. */
+    apic_send_eoi();
+}
+
+/** @brief Have @p cpu flush on its own, at its next interrupt or idle exit. */
+static void tlb_shootdown_mark_stale(uint32_t cpu)
+{
+    __atomic_or_fetch(&tlb_shootdown_state[cpu], TLB_SHOOTDOWN_STATE_STALE, __ATOMIC_SEQ_CST);
+    __atomic_or_fetch(&tlb_shootdown_attention_mask, 1u << cpu, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Leave @p cpu out of the batch if it is idle: it flushes when it wakes.
+ *
+ * @return true when the CPU was skipped.
+ */
+static bool tlb_shootdown_try_skip_idle(uint32_t cpu)
+{
+    uint32_t state = __atomic_load_n(&tlb_shootdown_state[cpu], __ATOMIC_ACQUIRE);
+
+    while ((state & TLB_SHOOTDOWN_STATE_IDLE) != 0u)
+    {
+        /* The CAS fails if the CPU woke meanwhile, and then it gets the IPI. */
+        if (__atomic_compare_exchange_n(&tlb_shootdown_state[cpu], &state, state | TLB_SHOOTDOWN_STATE_STALE, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE))
+            return true;
+    }
+    return false;
+}
+
+static inline void tlb_shootdown_count(uint32_t *counter, uint32_t amount)
+{
+    __atomic_add_fetch(counter, amount, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Send the queue of @p self as one request and wait for it. Interrupts
+ *        are off on entry.
+ *
+ * @return The CPUs that never answered, now marked stale; 0 when all did.
+ */
+static uint32_t tlb_shootdown_send(uint32_t self, const TlbShootdownQueue_t *queue)
+{
+    TlbShootdownStatistics_t *statistics = &tlb_shootdown_statistics;
+    const uint32_t self_bit = (self < TLB_SHOOTDOWN_MAX_CPUS) ? (1u << self) : 0u;
+    const uint32_t others = tlb_shootdown_active_mask & ~self_bit;
+
+    tlb_shootdown_count(&statistics->pages, queue->pages);
+    if (queue->full_flush)
+        tlb_shootdown_count(&statistics->full_flushes, 1u);
+
+    if (others == 0u || !advanced_pic_ipi_is_ready())
+    {
+        tlb_shootdown_invalidate(queue->full_flush, queue->addresses, queue->count);
+        tlb_shootdown_count(&statistics->local_batches, 1u);
+        return 0u;
+    }
+
+    /* Interrupts stay off while waiting for the lock, so whoever holds it may be
+       waiting on this CPU: answer its request from here. */
+    while (!kernel_ticket_lock_try_acquire(&tlb_shootdown_lock))
+    {
+        tlb_shootdown_service(self);
+        __asm__ volatile("pause" ::: "memory");
+    }
+
+    const uint64_t start = asmutils_read_timestamp_counter();
+    TlbShootdownRequest_t *request = &tlb_shootdown_request;
+
+    uint32_t targets = 0u;
+    for (uint32_t mask = others; mask != 0u; mask &= mask - 1u)
+    {
+        const uint32_t cpu = (uint32_t) __builtin_ctz(mask);
+        if (tlb_shootdown_try_skip_idle(cpu))
+            tlb_shootdown_count(&statistics->lazy_skips, 1u);
+        else
+            targets |= 1u << cpu;
+    }
+
+    if (targets != 0u)
+    {
+        request->full_flush = queue->full_flush;
+        request->count = queue->count;
+        for (uint32_t i = 0u; i < queue->count; ++i)
+            request->addresses[i] = queue->addresses[i];
+        __atomic_store_n(&request->pending_mask, targets, __ATOMIC_RELEASE);
+
+        /* One shorthand IPI when every other CPU is a target; one each otherwise,
+           so that the idle CPUs left out are not woken after all. */
+        if (targets == others && tlb_shootdown_popcount(targets) + 1u >= cpu_topology_get_online_cpu_count())
+        {
+            (void) advanced_pic_ipi_send_fixed(0u, (uint8_t) TLB_SHOOTDOWN_VECTOR, ADVANCED_PIC_IPI_SHORT_ALL_EXCL);
+        }
+        else
+        {
+            for (uint32_t mask = targets; mask != 0u; mask &= mask - 1u)
+            {
+                const uint32_t cpu = (uint32_t) __builtin_ctz(mask);
+                (void) advanced_pic_ipi_send_fixed(tlb_shootdown_apic_ids[cpu], (uint8_t) TLB_SHOOTDOWN_VECTOR,
+                                                   ADVANCED_PIC_IPI_SHORT_NONE);
+            }
+        }
+    }
+
+    tlb_shootdown_invalidate(queue->full_flush, queue->addresses, queue->count);
+
+    uint32_t missing = 0u;
+    uint32_t spin_guard = 0u;
+    while (__atomic_load_n(&request->pending_mask, __ATOMIC_ACQUIRE) != 0u)
+    {
+        __asm__ volatile("pause" ::: "memory");
+        if (++spin_guard >= TLB_SHOOTDOWN_SPIN_LIMIT)
+        {
+            missing = __atomic_exchange_n(&request->pending_mask, 0u, __ATOMIC_SEQ_CST);
+            for (uint32_t mask = missing; mask != 0u; mask &= mask - 1u)
+                tlb_shootdown_mark_stale((uint32_t) __builtin_ctz(mask));
+            if (missing != 0u)
+                tlb_shootdown_count(&statistics->timeouts, 1u);
+            break;
+        }
+    }
+
+    /* Against one IPI per page and per other CPU, and one wait for each. */
+    const uint32_t ipis = tlb_shootdown_popcount(targets);
+    const uint32_t naive = queue->pages * tlb_shootdown_popcount(others);
+    tlb_shootdown_count(&statistics->ipis_sent, ipis);
+    tlb_shootdown_count(&statistics->ipis_saved, (naive > ipis) ? naive - ipis : 0u);
+
+    if (targets != 0u)
+    {
+        const uint32_t cycles = (uint32_t) (asmutils_read_timestamp_counter() - start);
+        tlb_shootdown_count(&statistics->batches, 1u);
+        statistics->last_cycles = cycles;
+        if (cycles > statistics->max_cycles)
+            statistics->max_cycles = cycles;
+    }
+    else
+    {
+        tlb_shootdown_count(&statistics->local_batches, 1u);
+    }
+
+    kernel_ticket_lock_release(&tlb_shootdown_lock);
+    return missing;
+}
+
+static void tlb_shootdown_register_cpu(void)
+{
+    uint32_t apic_id = apic_read(LAPIC_REG_ID);
+    if (!apic_is_x2apic_active())
+        apic_id >>= 24u;
+    if (apic_id >= TLB_SHOOTDOWN_APIC_IDS || tlb_shootdown_index_by_apic_id[apic_id] != 0u)
+        return;
+
+    const uint32_t cpu = __atomic_fetch_add(&tlb_shootdown_cpu_count, 1u, __ATOMIC_SEQ_CST);
+    if (cpu >= TLB_SHOOTDOWN_MAX_CPUS)
+        return;
+
+    tlb_shootdown_apic_ids[cpu] = (uint8_t) apic_id;
+    tlb_shootdown_index_by_apic_id[apic_id] = (uint8_t) (cpu + 1u);
+    __atomic_or_fetch(&tlb_shootdown_active_mask, 1u << cpu, __ATOMIC_SEQ_CST);
+}
+
+void tlb_shootdown_initialize(void)
+{
+    kernel_ticket_lock_initialize(&tlb_shootdown_lock, &tlb_shootdown_lock_statistics);
+    kernel_lock_statistics_register(&tlb_shootdown_lock_statistics, "tlb_shootdown");
+    interrupt_service_routine_register_handler((uint8_t) TLB_SHOOTDOWN_VECTOR, tlb_shootdown_interrupt_handler);
+    tlb_shootdown_register_cpu();
+}
+
+void tlb_shootdown_activate_cpu(void)
+{
+    tlb_shootdown_register_cpu();
+
+    /* Nothing was sent here before the bit went up; whatever changed since this
+       CPU loaded CR3 is dropped now. */
+    paging_flush_tlb();
+}
+
+static void tlb_shootdown_queue_page(TlbShootdownQueue_t *queue, uint32_t virt_addr)
+{
+    ++queue->pages;
+    if (queue->full_flush)
+        return;
+    if (queue->count < TLB_SHOOTDOWN_FULL_FLUSH_THRESHOLD)
+        queue->addresses[queue->count++] = PAGE_ALIGN_DOWN(virt_addr);
+    else
+        queue->full_flush = true;
+}
+
+static void tlb_shootdown_free_chain(uint32_t head, uint32_t count)
+{
+    tlb_shootdown_count(&tlb_shootdown_statistics.deferred_frames, count);
+    while (count-- != 0u)
+    {
+        const uint32_t *link = (const uint32_t *) (uintptr_t) (head + KERNEL_VIRTUAL_BASE);
+        const uint32_t next = link[0];
+        const uint8_t order = (uint8_t) link[1];
+
+        physical_memory_manager_page_frame_free_order(head, order);
+        head = next;
+    }
+}
+
+/**
+ * @brief Keep a batch's deferred chain until every CPU in @p missing has
+ *        flushed. The blocks may still back a stale entry on those CPUs:
+ *        page tables emptied by paging.c among them.
+ */
+static void tlb_shootdown_hold(uint32_t head, uint32_t count, uint32_t missing)
+{
+    uint32_t tail = head;
+    for (uint32_t i = 1u; i < count; ++i)
+        tail = ((const uint32_t *) (uintptr_t) (tail + KERNEL_VIRTUAL_BASE))[0];
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&tlb_shootdown_held_lock);
+    ((uint32_t *) (uintptr_t) (tail + KERNEL_VIRTUAL_BASE))[0] = tlb_shootdown_held_head;
+    tlb_shootdown_held_head = head;
+    tlb_shootdown_held_count += count;
+    tlb_shootdown_held_waiting |= missing;
+    kernel_ticket_lock_release_irqrestore(&tlb_shootdown_held_lock, flags);
+    tlb_shootdown_count(&tlb_shootdown_statistics.held_frames, count);
+}
+
+/**
+ * @brief Free the held blocks once no CPU they wait on can still reach them.
+ *
+ * @details A CPU is done with them when its stale mark is gone (it flushed) or
+ *          when it is idle, which is what a lazy skip trusts too: it flushes on
+ *          the way out. Being marked stale again by a later batch only delays
+ *          the release.
+ */
+static void tlb_shootdown_release_held(void)
+{
+    if (__atomic_load_n(&tlb_shootdown_held_count, __ATOMIC_ACQUIRE) == 0u)
+        return;
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&tlb_shootdown_held_lock);
+    for (uint32_t mask = tlb_shootdown_held_waiting; mask != 0u; mask &= mask - 1u)
+    {
+        const uint32_t cpu = (uint32_t) __builtin_ctz(mask);
+        const uint32_t state = __atomic_load_n(&tlb_shootdown_state[cpu], __ATOMIC_ACQUIRE);
+        if ((state & TLB_SHOOTDOWN_STATE_STALE) == 0u || (state & TLB_SHOOTDOWN_STATE_IDLE) != 0u)
+            tlb_shootdown_held_waiting &= ~(1u << cpu);
+    }
+
+    uint32_t head = 0u;
+    uint32_t count = 0u;
+    if (tlb_shootdown_held_waiting == 0u)
+    {
+        head = tlb_shootdown_held_head;
+        count = tlb_shootdown_held_count;
+        tlb_shootdown_held_head = 0u;
+        tlb_shootdown_held_count = 0u;
+    }
+    kernel_ticket_lock_release_irqrestore(&tlb_shootdown_held_lock, flags);
+
+    tlb_shootdown_free_chain(head, count);
+}
+
+/**
+ * @brief Send what @p queue holds, restore @p flags, then free the deferred
+ *        blocks. The outermost batch of @p self has just closed.
+ *
+ * @details A batch that timed out never frees: its blocks are held until the
+ *          CPUs that did not answer have flushed, and released by a later close.
+ */
+static void tlb_shootdown_close(uint32_t self, TlbShootdownQueue_t *queue, uint32_t flags)
+{
+    const uint32_t missing = (queue->pages != 0u) ? tlb_shootdown_send(self, queue) : 0u;
+
+    uint32_t deferred = queue->deferred_head;
+    uint32_t deferred_count = queue->deferred_count;
+    queue->pages = 0u;
+    queue->count = 0u;
+    queue->full_flush = false;
+    queue->deferred_head = 0u;
+    queue->deferred_count = 0u;
+    tlb_shootdown_restore_interrupts(flags);
+
+    if (deferred_count != 0u && missing != 0u)
+        tlb_shootdown_hold(deferred, deferred_count, missing);
+    else if (deferred_count != 0u)
+        tlb_shootdown_free_chain(deferred, deferred_count); /* Every TLB has dropped what pointed at them. */
+
+    tlb_shootdown_release_held();
+}
+
+/* A batch is queued on the CPU that opened it, with interrupts on in between:
+   preemption stays off from begin to end, so the thread can neither migrate
+   and leave the depth raised here for good, nor let another thread's unmaps
+   join its batch. */
+void tlb_shootdown_begin(void)
+{
+    kernel_thread_preempt_disable();
+    const uint32_t flags = tlb_shootdown_save_and_disable_interrupts();
+    ++tlb_shootdown_queues[tlb_shootdown_self()].depth;
+    tlb_shootdown_restore_interrupts(flags);
+}
+
+void tlb_shootdown_end(void)
+{
+    const uint32_t flags = tlb_shootdown_save_and_disable_interrupts();
+    const uint32_t self = tlb_shootdown_self();
+    TlbShootdownQueue_t *queue = &tlb_shootdown_queues[self];
+
+    if (queue->depth == 0u)
+    {
+        /* Unbalanced: no begin took preemption off for this one. */
+        tlb_shootdown_restore_interrupts(flags);
+        return;
+    }
+    if (--queue->depth != 0u)
+        tlb_shootdown_restore_interrupts(flags);
+    else
+        tlb_shootdown_close(self, queue, flags);
+    kernel_thread_preempt_enable();
+}
+
+void tlb_shootdown_page(uint32_t virt_addr) { tlb_shootdown_range(virt_addr, 1u); }
+
+void tlb_shootdown_range(uint32_t virt_addr, uint32_t page_count)
+{
+    const uint32_t flags = tlb_shootdown_save_and_disable_interrupts();
+    const uint32_t self = tlb_shootdown_self();
+    TlbShootdownQueue_t *queue = &tlb_shootdown_queues[self];
+
+    uint32_t i = 0u;
+    for (; i < page_count && !queue->full_flush; ++i)
+        tlb_shootdown_queue_page(queue, virt_addr + i * PAGE_SIZE);
+    queue->pages += page_count - i;
+
+    if (queue->depth != 0u)
+        tlb_shootdown_restore_interrupts(flags);
+    else
+        tlb_shootdown_close(self, queue, flags);
+}
+
+void tlb_shootdown_all(void)
+{
+    const uint32_t flags = tlb_shootdown_save_and_disable_interrupts();
+    const uint32_t self = tlb_shootdown_self();
+    TlbShootdownQueue_t *queue = &tlb_shootdown_queues[self];
+
+    ++queue->pages;
+    queue->full_flush = true;
+
+    if (queue->depth != 0u)
+        tlb_shootdown_restore_interrupts(flags);
+    else
+        tlb_shootdown_close(self, queue, flags);
+}
+
+void tlb_shootdown_defer_frame_free(uint32_t phys_addr, uint8_t order)
+{
+    const uint32_t flags = tlb_shootdown_save_and_disable_interrupts();
+    TlbShootdownQueue_t *queue = &tlb_shootdown_queues[tlb_shootdown_self()];
+
+    if (queue->depth == 0u)
+    {
+        tlb_shootdown_restore_interrupts(flags);
+        physical_memory_manager_page_frame_free_order(phys_addr, order);
+        return;
+    }
+
+    uint32_t *link = (uint32_t *) (uintptr_t) (phys_addr + KERNEL_VIRTUAL_BASE);
+    link[0] = queue->deferred_head;
+    link[1] = order;
+    queue->deferred_head = phys_addr;
+    ++queue->deferred_count;
+    tlb_shootdown_restore_interrupts(flags);
+}
+
+void tlb_shootdown_enter_idle(void)
+{
+    const uint32_t self = tlb_shootdown_self();
+    if (self >= TLB_SHOOTDOWN_MAX_CPUS)
+        return;
+
+    /* Attention first: a CPU whose state is non-zero always has its bit up. */
+    __atomic_or_fetch(&tlb_shootdown_attention_mask, 1u << self, __ATOMIC_SEQ_CST);
+    const uint32_t old = __atomic_exchange_n(&tlb_shootdown_state[self], TLB_SHOOTDOWN_STATE_IDLE, __ATOMIC_SEQ_CST);
+    if ((old & TLB_SHOOTDOWN_STATE_STALE) != 0u)
+    {
+        paging_flush_tlb();
+        tlb_shootdown_count(&tlb_shootdown_statistics.lazy_flushes, 1u);
+    }
+}
+
+void tlb_shootdown_exit_idle(void)
+{
+    if (__atomic_load_n(&tlb_shootdown_attention_mask, __ATOMIC_ACQUIRE) == 0u)
+        return;
+
+    const uint32_t self = tlb_shootdown_self();
+    if (self >= TLB_SHOOTDOWN_MAX_CPUS || (tlb_shootdown_attention_mask & (1u << self)) == 0u)
+        return;
+
+    /* Attention last: a shootdown that marks this CPU stale after the exchange
+       raises it again, and the next interrupt picks that up. */
+    __atomic_and_fetch(&tlb_shootdown_attention_mask, ~(1u << self), __ATOMIC_SEQ_CST);
+    const uint32_t old = __atomic_exchange_n(&tlb_shootdown_state[self], 0u, __ATOMIC_SEQ_CST);
+    if ((old & TLB_SHOOTDOWN_STATE_STALE) != 0u)
+    {
+        paging_flush_tlb();
+        tlb_shootdown_count(&tlb_shootdown_statistics.lazy_flushes, 1u);
+    }
+}
+
+void tlb_shootdown_get_statistics(TlbShootdownStatistics_t *out)
+{
+    if (out == NULL)
+        return;
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&tlb_shootdown_lock);
+    *out = tlb_shootdown_statistics;
+    kernel_ticket_lock_release_irqrestore(&tlb_shootdown_lock, flags);
+}
+
+void tlb_shootdown_report(Serial_t *serial_port)
+{
+    TlbShootdownStatistics_t statistics;
+    tlb_shootdown_get_statistics(&statistics);
+
+    kernel_telemetry_begin_record(serial_port, "tlb_shootdown");
+    kernel_telemetry_write_unsigned("active_cpus", tlb_shootdown_popcount(tlb_shootdown_active_mask));
+    kernel_telemetry_write_unsigned("batches", statistics.batches);
+    kernel_telemetry_write_unsigned("local_batches", statistics.local_batches);
+    kernel_telemetry_write_unsigned("pages", statistics.pages);
+    kernel_telemetry_write_unsigned("full_flushes", statistics.full_flushes);
+    kernel_telemetry_write_unsigned("full_flush_threshold", TLB_SHOOTDOWN_FULL_FLUSH_THRESHOLD);
+    kernel_telemetry_write_unsigned("ipis_sent", statistics.ipis_sent);
+    kernel_telemetry_write_unsigned("ipis_saved", statistics.ipis_saved);
+    kernel_telemetry_write_unsigned("lazy_skips", statistics.lazy_skips);
+    kernel_telemetry_write_unsigned("lazy_flushes", statistics.lazy_flushes);
+    kernel_telemetry_write_unsigned("timeouts", statistics.timeouts);
+    kernel_telemetry_write_unsigned("deferred_frames", statistics.deferred_frames);
+    kernel_telemetry_write_unsigned("held_frames", statistics.held_frames);
+    kernel_telemetry_write_unsigned("last_cycles", statistics.last_cycles);
+    kernel_telemetry_write_unsigned("max_cycles", statistics.max_cycles);
+    kernel_telemetry_end_record();
+}
@@ -8,32 +8,36 @@
 
 #include <kernel/boot/multiboot_info.h>
 #include <kernel/cpu/paging.h>
+#include <kernel/cpu/tlb_shootdown.h>
 #include <kernel/drivers/framebuffer.h>
 #include <kernel/lib/asmutils.h>
 #include <kernel/memory/vmm.h>
 #include <string.h>
 
+/* Preferred home of the LFB mapping; any free VMM range will do. */
+#define FRAMEBUFFER_VIRTUAL_BASE 0xE0000000u
+
 /* Global framebuffer state */
 static framebuffer_info_t fb_info = {0};
 
-/* Static page table for framebuffer mapping (768 pages = 3MB, enough for 1024x768x32bpp) */
-/* Must be 4KB aligned */
-static PageTable_t __attribute__((aligned(4096))) framebuffer_page_table;
+static uint32_t fb_mapped_pages = 0u;
+static PagingMemoryType_t fb_memory_type = PAGING_MEMORY_TYPE_WRITE_THROUGH;
 
 /* External multiboot info - note the type is MultibootInfo_t */
 extern MultibootInfo_t *multiboot_info;
 
-/* External page directory from paging.c */
-extern PageDirectory_t *current_page_directory;
-
 /**
  * @brief Map the framebuffer memory into kernel space
  *
  * The framebuffer is typically at a high physical address (e.g., 0xFD000000)
  * which we need to map into our virtual address space.
  *
- * Since we don't have a page frame allocator yet, we use a static page table
- * allocated in .bss that we manually insert into the page directory.
+ * One page table covers 4 MiB, short of anything past roughly 1280x800x32, so
+ * the tables come from paging_map_page(), as many as the mode needs. The pages
+ * are write-combining when the PAT allows it, so the rasterizer's stores leave
+ * as full-line bursts instead of one bus write each. Wherever the virtual and
+ * physical addresses are both 4 MiB aligned and a whole 4 MiB remains, one PSE
+ * page replaces the table, so a full-screen fill costs one TLB entry per 4 MiB.
  *
  * @param phys_addr Physical address of the framebuffer
  * @param size Size of the framebuffer in bytes
@@ -41,51 +45,66 @@ extern PageDirectory_t *current_page_directory;
  */
 static uint32_t *map_framebuffer(uint32_t phys_addr, uint32_t size)
 {
-    uint32_t num_pages = (size + 0xFFF) / 0x1000;
+    const uint32_t offset = PAGE_OFFSET(phys_addr);
+    const uint32_t num_pages = (offset + size + 0xFFF) / 0x1000;
+    uint32_t virt_addr = FRAMEBUFFER_VIRTUAL_BASE;
 
-    uint32_t virt_addr = 0xE0000000;
-    uint32_t pd_index = virt_addr >> 22;
-
-    if (!current_page_directory)
-    {
-        return NULL;
-    }
-
-    for (uint32_t i = 0; i < 1024; i++)
+    /* Register the virtual range with the VMM so pinned-memory and other
+       VMM-aware allocators cannot hand out the same pages. */
+    if (!kernel_vmm_reserve_at((void *) virt_addr, num_pages))
     {
-        framebuffer_page_table.entries[i] = (PageTableEntry_t){0};
+        virt_addr = (uint32_t) (uintptr_t) kernel_vmm_reserve_pages_aligned(num_pages, ENTRIES_PER_TABLE);
+        if (virt_addr == 0u)
+            virt_addr = (uint32_t) (uintptr_t) kernel_vmm_reserve_pages(num_pages);
+        if (virt_addr == 0u)
+            return NULL;
     }
 
-    for (uint32_t i = 0; i < num_pages && i < 1024; i++)
-    {
-        uint32_t page_phys = phys_addr + (i * 0x1000);
-
-        framebuffer_page_table.entries[i].present = 1;
-        framebuffer_page_table.entries[i].read_write = 1;
-        framebuffer_page_table.entries[i].user_supervisor = 0;
-        framebuffer_page_table.entries[i].write_through = 1;
-        framebuffer_page_table.entries[i].cache_disable = 0;
-        framebuffer_page_table.entries[i].page_frame_base = page_phys >> 12;
-    }
+    PageDirectoryEntry_t pde_flags = {0};
+    pde_flags.present = 1;
+    pde_flags.read_write = 1;
 
-    uint32_t pt_phys = (uint32_t) &framebuffer_page_table - 0xC0000000;
+    PageTableEntry_t pte_flags = {0};
+    pte_flags.present = 1;
+    pte_flags.read_write = 1;
+    fb_memory_type = paging_encode_memory_type(&pte_flags, PAGING_MEMORY_TYPE_WRITE_COMBINING);
 
-    PageDirectoryEntry_t *pde = &current_page_directory->entries[pd_index];
-    pde->present = 1;
-    pde->read_write = 1;
-    pde->user_supervisor = 0;
-    pde->write_through = 1;
-    pde->cache_disable = 0;
-    pde->page_size = 0;
-    pde->page_table_base = pt_phys >> 12;
+    uint32_t i = 0;
+    while (i < num_pages)
+    {
+        const uint32_t page_virt = virt_addr + (i * 0x1000);
+        const uint32_t page_phys = PAGE_ALIGN_DOWN(phys_addr) + (i * 0x1000);
 
-    asmutils_invalidate_translation_lookaside_buffer();
+        if (((page_virt | page_phys) & ~PAGING_LARGE_PAGE_MASK) == 0u && num_pages - i >= ENTRIES_PER_TABLE &&
+            paging_map_large_page(page_virt, page_phys, pde_flags, fb_memory_type))
+        {
+            i += ENTRIES_PER_TABLE;
+            continue;
+        }
 
-    /* Register the virtual range with the VMM so pinned-memory and other
-       VMM-aware allocators cannot hand out the same pages. */
-    kernel_vmm_reserve_at((void *) virt_addr, num_pages);
+        if (!paging_map_page(page_virt, page_phys, pde_flags, pte_flags))
+        {
+            tlb_shootdown_begin();
+            for (uint32_t mapped = 0; mapped < i;)
+            {
+                const uint32_t mapped_virt = virt_addr + (mapped * 0x1000);
+                if (paging_unmap_large_page(mapped_virt))
+                {
+                    mapped += ENTRIES_PER_TABLE;
+                    continue;
+                }
+                (void) paging_unmap_page(mapped_virt);
+                mapped++;
+            }
+            tlb_shootdown_end();
+            kernel_vmm_free_pages((void *) virt_addr, num_pages);
+            return NULL;
+        }
+        i++;
+    }
 
-    return (uint32_t *) virt_addr;
+    fb_mapped_pages = num_pages;
+    return (uint32_t *) (virt_addr + offset);
 }
 
 bool framebuffer_init(void)
@@ -184,6 +203,29 @@ void framebuffer_put_pixel(uint32_t x, uint32_t y, color_t color)
     fb_info.buffer[offset] = framebuffer_color_to_pixel(color);
 }
 
+PagingMemoryType_t framebuffer_get_memory_type(void) { return fb_memory_type; }
+
+PagingMemoryType_t framebuffer_set_memory_type(PagingMemoryType_t type)
+{
+    if (!fb_info.initialized)
+        return fb_memory_type;
+
+    PageTableEntry_t encoded = {0};
+    type = paging_encode_memory_type(&encoded, type);
+    if (type == fb_memory_type)
+        return type;
+
+    const uint32_t base = PAGE_ALIGN_DOWN((uint32_t) (uintptr_t) fb_info.buffer);
+    for (uint32_t i = 0; i < fb_mapped_pages; i++)
+        (void) paging_set_page_memory_type(base + (i * 0x1000), type);
+
+    paging_commit_memory_type_change();
+    fb_memory_type = type;
+    return type;
+}
+
+uint32_t framebuffer_get_mapped_page_count(void) { return fb_mapped_pages; }
+
 color_t framebuffer_get_pixel(uint32_t x, uint32_t y)
 {
     color_t color = {0, 0, 0, 255};
@@ -20,9 +20,19 @@
  * itself with vendor identifier 0x1AF40022, all twelve verbs of the walk and the stream
  * setup are answered, the input converter is found at node 4 behind pin 3, and the
  * stream runs and delivers buffers. The delivery rate cross-checks the format word
- * independently: the cyclic buffer is 2560 bytes, which is 80 ms of 16 kHz mono
+ * independently: the cyclic buffer was then 2560 bytes, which is 80 ms of 16 kHz mono
  * 16-bit audio, and 320 ms of running produced three wraps plus a part-filled fourth.
  *
+ * PERIODS AND INTERRUPTS. The cyclic buffer is now one page cut into sixteen periods of
+ * eight milliseconds, each with its completion interrupt requested, because latency is
+ * bounded below by the period: a two-half buffer cannot hand anything over sooner than
+ * forty milliseconds after it was spoken. The handler copies each finished period into
+ * a single-producer ring together with where in the stream it ended, which is what lets
+ * a consumer measure how old a buffer is against the codec's own clock instead of a
+ * timestamp counter nobody has calibrated. @ref intel_high_definition_audio_service is
+ * the handler's body and the polling path's too, so switching between them changes who
+ * calls it and nothing else — which is what makes the two comparable at all.
+ *
  * HOW THE COMMAND PATH WAS FIXED, because the shape of the bug is worth keeping. For
  * a while only the FIRST verb was ever answered and every one after it timed out. Two
  * hypotheses were reasoned out from the code and both were wrong — acknowledging
@@ -44,10 +54,19 @@
 
 #include <kernel/drivers/hda.h>
 
+#include <kernel/core/lock.h>
+#include <kernel/cpu/apic_timer.h>
+#include <kernel/cpu/ioapic.h>
+#include <kernel/cpu/irq.h>
+#include <kernel/cpu/interrupt_affinity.h>
+#include <kernel/cpu/interrupt_vector.h>
+#include <kernel/cpu/isr.h>
+#include <kernel/cpu/msi.h>
 #include <kernel/cpu/paging.h>
 #include <kernel/cpu/pci.h>
-#include <kernel/cpu/pmm.h>
+#include <kernel/cpu/pic.h>
 #include <kernel/lib/asmutils.h>
+#include <kernel/memory/dma.h>
 #include <kernel/memory/vmm.h>
 
 #include <stddef.h>
@@ -58,6 +77,8 @@
 #define HDA_REG_MAJOR_VERSION               0x03u
 #define HDA_REG_GLOBAL_CONTROL              0x08u /**< 32-bit: bit 0 is controller reset. */
 #define HDA_REG_STATE_CHANGE_STATUS         0x0Eu /**< 16-bit: bit per codec that announced itself. */
+#define HDA_REG_INTERRUPT_CONTROL           0x20u /**< 32-bit: bit per stream, bit 31 global enable. */
+#define HDA_REG_INTERRUPT_STATUS            0x24u /**< 32-bit: bit per stream that is raising one. */
 #define HDA_REG_COMMAND_RING_BASE_LOW       0x40u
 #define HDA_REG_COMMAND_RING_BASE_HIGH      0x44u
 #define HDA_REG_COMMAND_RING_WRITE_POINTER  0x48u
@@ -100,13 +121,28 @@
 /** Entries in each ring. 256 is the size every controller implements. */
 #define HDA_RING_ENTRIES 256u
 
+/** Base alignment the CORB, the RIRB and a buffer descriptor list require. */
+#define HDA_DMA_ALIGNMENT 128u
+
 /** PCI command register bits: memory space decode and bus mastering. */
 #define HDA_PCI_COMMAND_MEMORY_SPACE (1u << 1)
 #define HDA_PCI_COMMAND_BUS_MASTER   (1u << 2)
 
+/** PCI command register bit 10: the function may not assert its INTx line. */
+#define HDA_PCI_COMMAND_INTERRUPT_DISABLE (1u << 10)
+
 /** Offset of the command register in PCI configuration space. */
 #define HDA_PCI_COMMAND_OFFSET 0x04u
 
+/** Offset of the legacy interrupt line the firmware assigned. */
+#define HDA_PCI_INTERRUPT_LINE_OFFSET 0x3Cu
+
+/** Interrupt control bit 31: nothing reaches the line without it. */
+#define HDA_INTERRUPT_GLOBAL_ENABLE (1u << 31)
+
+/** @ref IntelHighDefinitionAudioState_t::interrupt_line when no line could be taken. */
+#define HDA_NO_INTERRUPT_LINE 0xFFu
+
 /** PCI class and subclass of a High Definition Audio controller. */
 #define HDA_PCI_CLASS    0x04u
 #define HDA_PCI_SUBCLASS 0x03u
@@ -203,6 +239,9 @@
 /** Stream number the capture converter is bound to. Any non-zero value will do. */
 #define HDA_CAPTURE_STREAM_NUMBER 1u
 
+/** Stream number the playback converter is bound to; distinct from the capture one. */
+#define HDA_PLAYBACK_STREAM_NUMBER 2u
+
 /**
  * Sample format: 16 kHz, 16-bit, one channel.
  *
@@ -212,12 +251,17 @@
  */
 #define HDA_CAPTURE_FORMAT 0x0210u
 
-/** Bytes in one buffer half. Ten times 128, because the length must be a multiple. */
-#define HDA_CAPTURE_HALF_BYTES 1280u
+/** Bytes in one period: 128 samples, 8 ms. The length must be a multiple of 128. */
+#define HDA_PERIOD_BYTES (INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES * 2u)
 
-/** Halves in the cyclic buffer. Two is the minimum that lets one be read while the
- *  other fills, which is the whole reason the buffer is cyclic. */
-#define HDA_CAPTURE_HALVES 2u
+/** Periods in a cyclic buffer, which is then exactly one page of DMA memory. */
+#define HDA_PERIODS 16u
+
+/** Bytes in a cyclic buffer. */
+#define HDA_CYCLIC_BYTES (HDA_PERIODS * HDA_PERIOD_BYTES)
+
+/** Where the playback descriptor list sits in the page the capture one starts. */
+#define HDA_PLAYBACK_LIST_OFFSET_WORDS 512u
 
 /** Input stream descriptors start here; each is 0x20 bytes wide. */
 #define HDA_REG_STREAM_DESCRIPTOR_BASE 0x80u
@@ -238,6 +282,13 @@
 /** Stream control bit 1: run. */
 #define HDA_STREAM_CONTROL_RUN (1u << 1)
 
+/** Stream control bits 2-4: interrupt on completion, on FIFO error, on descriptor error. */
+#define HDA_STREAM_CONTROL_INTERRUPTS ((1u << 2) | (1u << 3) | (1u << 4))
+
+/** Stream status bits 2-4, write-one-to-clear: buffer complete, FIFO error, descriptor error. */
+#define HDA_STREAM_STATUS_BUFFER_COMPLETE (1u << 2)
+#define HDA_STREAM_STATUS_ERRORS          ((1u << 3) | (1u << 4))
+
 static IntelHighDefinitionAudioState_t hda_state;
 static volatile uint32_t *hda_command_ring = NULL;
 static volatile uint64_t *hda_response_ring = NULL;
@@ -245,7 +296,42 @@ static uint16_t hda_command_write_pointer = 0u;
 static uint16_t hda_response_read_pointer = 0u;
 static volatile uint32_t *hda_buffer_descriptor_list = NULL;
 static volatile int16_t *hda_capture_buffer = NULL;
-static uint32_t hda_capture_half_read = 0u;
+static volatile int16_t *hda_playback_buffer = NULL;
+static uint32_t hda_descriptor_list_physical = 0u;
+static uint32_t hda_playback_buffer_physical = 0u;
+
+/**
+ * @struct HdaCapturePeriod_t
+ * @brief One finished period, and where in the stream it ended.
+ */
+typedef struct {
+    int16_t samples[INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES];
+    uint32_t end_position; /**< Stream bytes up to and including this period. */
+} HdaCapturePeriod_t;
+
+/* The capture ring. The service routine is its only producer and the consumer is
+   whoever calls intel_high_definition_audio_capture_read(); the cursors are
+   free-running period counts. */
+static HdaCapturePeriod_t hda_capture_ring[INTEL_HIGH_DEFINITION_AUDIO_RING_PERIODS];
+static volatile uint32_t hda_capture_write = 0u;
+static volatile uint32_t hda_capture_read = 0u;
+static uint32_t hda_capture_period_next = 0u;
+static uint32_t hda_capture_stream_bytes = 0u;
+
+/* The playback ring, in samples. The submitter produces, the service routine
+   consumes one period at a time into whichever period the controller has finished. */
+static int16_t hda_playback_ring[INTEL_HIGH_DEFINITION_AUDIO_RING_PERIODS * INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES];
+static volatile uint32_t hda_playback_write = 0u;
+static volatile uint32_t hda_playback_read = 0u;
+static uint32_t hda_playback_period_next = 0u;
+static uint32_t hda_playback_idle_periods = 0u;
+
+/* Serialises the service routine between the handler and the polling path, and
+   against a flush. */
+static KernelTicketLock_t hda_service_lock;
+
+/* The controller's messages, when it took them instead of its line. */
+static MessageSignaledInterruptFunction_t *hda_message_function = NULL;
 
 /**
  * @brief Reads a byte from the register window.
@@ -348,39 +434,22 @@ static uint32_t hda_map_window(uint32_t phys_base_raw, uint32_t size)
  *
  * The rings are read and written by the controller's bus master, so the memory has to
  * be physically contiguous and its physical address has to be known — neither of
- * which the kernel heap promises. A page frame is both by construction.
+ * which the kernel heap promises. The DMA allocator's blocks are both by
+ * construction, come zeroed, and a page block is aligned well past the 128 bytes
+ * the CORB, the RIRB and a descriptor list each require.
  *
  * @param out_physical Receives the physical address.
  * @return The virtual address, or NULL.
  */
 static void *hda_claim_dma_page(uint32_t *out_physical)
 {
-    const uint32_t physical = physical_memory_manager_page_frame_allocate();
-    if (physical == 0u)
+    KernelDmaBuffer_t buffer;
+    if (!kernel_dma_alloc(PAGE_SIZE, HDA_DMA_ALIGNMENT, 0u, PAGING_MEMORY_TYPE_UNCACHED, &buffer))
         return NULL;
 
-    void *const virt = kernel_vmm_reserve_pages(1u);
-    if (virt == NULL)
-    {
-        physical_memory_manager_page_frame_free(physical);
-        return NULL;
-    }
-
-    const PageDirectoryEntry_t pde_flags = {.present = 1u, .read_write = 1u};
-    const PageTableEntry_t pte_flags = {.present = 1u, .read_write = 1u, .cache_disable = 1u, .write_through = 1u};
-    if (!paging_map_page((uint32_t) virt, physical, pde_flags, pte_flags))
-    {
-        kernel_vmm_free_pages(virt, 1u);
-        physical_memory_manager_page_frame_free(physical);
-        return NULL;
-    }
-
-    for (uint32_t i = 0u; i < 1024u; ++i)
-        ((volatile uint32_t *) virt)[i] = 0u;
-
     if (out_physical != NULL)
-        *out_physical = physical;
-    return virt;
+        *out_physical = buffer.physical_address;
+    return buffer.virtual_address;
 }
 
 /**
@@ -461,8 +530,9 @@ static bool hda_start_rings(void)
     hda_response_read_pointer = 0u;
 
     /* How many responses may accumulate before the controller insists on being
-       acknowledged. This is an interrupt-coalescing threshold, and a polling driver
-       takes no interrupts — so it wants the threshold OUT of the way, not at one.
+       acknowledged. This is an interrupt-coalescing threshold, and the command path
+       polls — the stream interrupts never include this ring's — so it wants the
+       threshold OUT of the way, not at one.
        Measured: at one, the controller answers the first verb and then stops fetching
        the ring entirely (CORBRP frozen one behind CORBWP with the fetch engine running
        and no error posted), because the count it is waiting to have acknowledged has
@@ -692,32 +762,71 @@ static void hda_find_capture_path(uint8_t codec)
     }
 }
 
-bool intel_high_definition_audio_start_capture(void)
+/**
+ * @brief Register offset of stream descriptor @p index; inputs first, then outputs.
+ * @param index Descriptor index.
+ * @return The offset.
+ */
+static uint32_t hda_stream(uint32_t index) { return HDA_REG_STREAM_DESCRIPTOR_BASE + index * 0x20u; }
+
+/** @return The first output stream descriptor, which the playback stream runs on. */
+static uint32_t hda_playback_stream(void) { return hda_stream(hda_state.input_streams); }
+
+/**
+ * @brief The interrupt control bits of every stream this driver has set up.
+ * @return Bit 0 for the capture stream, the first output bit for playback.
+ */
+static uint32_t hda_stream_interrupt_mask(void)
 {
-    if (!hda_state.rings_running || hda_state.capture_converter == 0u)
-        return false;
+    uint32_t mask = 0u;
+    if (hda_state.capture_running)
+        mask |= 1u;
+    if (hda_state.playback_ready)
+        mask |= 1u << hda_state.input_streams;
+    return mask;
+}
 
-    uint32_t descriptor_physical = 0u;
-    uint32_t buffer_physical = 0u;
-    hda_buffer_descriptor_list = (volatile uint32_t *) hda_claim_dma_page(&descriptor_physical);
-    hda_capture_buffer = (volatile int16_t *) hda_claim_dma_page(&buffer_physical);
-    if (hda_buffer_descriptor_list == NULL || hda_capture_buffer == NULL)
-        return false;
+/**
+ * @brief Claims the page both descriptor lists live in, once.
+ * @return true when the page is there.
+ */
+static bool hda_claim_descriptor_lists(void)
+{
+    if (hda_buffer_descriptor_list == NULL)
+        hda_buffer_descriptor_list = (volatile uint32_t *) hda_claim_dma_page(&hda_descriptor_list_physical);
+    return hda_buffer_descriptor_list != NULL;
+}
 
-    /* Two entries, each one half of the cyclic buffer. Each is four words: address
-       low, address high, length, flags — and the flag bit asks for an interrupt on
-       completion, which is harmless while nothing is listening for one and is what a
-       later handler will need. */
-    for (uint32_t half = 0u; half < HDA_CAPTURE_HALVES; ++half)
+/**
+ * @brief Cuts one page into @ref HDA_PERIODS entries, each asking for an interrupt.
+ *
+ * Each entry is four words: address low, address high, length, flags. The flag is
+ * set on every entry rather than on the last, because the interrupt is how a period
+ * is handed over — one per lap would be the two-half buffer again with a longer name.
+ *
+ * @param list            First word of the list.
+ * @param buffer_physical Physical address of the cyclic buffer.
+ */
+static void hda_fill_descriptor_list(volatile uint32_t *list, uint32_t buffer_physical)
+{
+    for (uint32_t period = 0u; period < HDA_PERIODS; ++period)
     {
-        hda_buffer_descriptor_list[half * 4u + 0u] = buffer_physical + half * HDA_CAPTURE_HALF_BYTES;
-        hda_buffer_descriptor_list[half * 4u + 1u] = 0u;
-        hda_buffer_descriptor_list[half * 4u + 2u] = HDA_CAPTURE_HALF_BYTES;
-        hda_buffer_descriptor_list[half * 4u + 3u] = 1u;
+        list[period * 4u + 0u] = buffer_physical + period * HDA_PERIOD_BYTES;
+        list[period * 4u + 1u] = 0u;
+        list[period * 4u + 2u] = HDA_PERIOD_BYTES;
+        list[period * 4u + 3u] = 1u;
     }
+}
 
-    const uint32_t stream = HDA_REG_STREAM_DESCRIPTOR_BASE;
-
+/**
+ * @brief Resets a stream descriptor and points it at its list, stopped.
+ *
+ * @param stream        Descriptor offset.
+ * @param number        Stream number the converter is bound to.
+ * @param list_physical Physical address of its descriptor list.
+ */
+static void hda_program_stream(uint32_t stream, uint32_t number, uint32_t list_physical)
+{
     /* Reset the descriptor, both edges, for the same reason the controller's own
        reset waits on both: half a reset leaves it in a state the specification does
        not describe. */
@@ -730,17 +839,37 @@ bool intel_high_definition_audio_start_capture(void)
         if ((hda_read8(stream + HDA_STREAM_CONTROL) & HDA_STREAM_CONTROL_RESET) == 0u)
             break;
 
-    hda_write32(stream + HDA_STREAM_CYCLIC_BUFFER_LENGTH, HDA_CAPTURE_HALVES * HDA_CAPTURE_HALF_BYTES);
-    hda_write16(stream + HDA_STREAM_LAST_VALID_INDEX, (uint16_t) (HDA_CAPTURE_HALVES - 1u));
+    hda_write32(stream + HDA_STREAM_CYCLIC_BUFFER_LENGTH, HDA_CYCLIC_BYTES);
+    hda_write16(stream + HDA_STREAM_LAST_VALID_INDEX, (uint16_t) (HDA_PERIODS - 1u));
     hda_write16(stream + HDA_STREAM_FORMAT, HDA_CAPTURE_FORMAT);
-    hda_write32(stream + HDA_STREAM_DESCRIPTOR_LIST_LOW, descriptor_physical);
+    hda_write32(stream + HDA_STREAM_DESCRIPTOR_LIST_LOW, list_physical);
     hda_write32(stream + HDA_STREAM_DESCRIPTOR_LIST_HIGH, 0u);
 
     /* The stream number lives in bits 23:20 of the control register, which is why it
        is written as a 32-bit access even though the low byte carries the run bit. The
-       converter is bound to the same number below; a mismatch there is a stream that
-       runs and captures nothing. */
-    hda_write32(stream + HDA_STREAM_CONTROL, (HDA_CAPTURE_STREAM_NUMBER << 20));
+       converter is bound to the same number; a mismatch there is a stream that runs
+       and moves nothing. The interrupt enables are always on here — whether anything
+       reaches the processor is decided by the controller's interrupt control, so the
+       polled and interrupt-driven paths see the same stream. */
+    hda_write32(stream + HDA_STREAM_CONTROL, (number << 20) | HDA_STREAM_CONTROL_INTERRUPTS);
+}
+
+bool intel_high_definition_audio_start_capture(void)
+{
+    if (!hda_state.rings_running || hda_state.capture_converter == 0u)
+        return false;
+
+    uint32_t buffer_physical = 0u;
+    if (!hda_claim_descriptor_lists())
+        return false;
+    hda_capture_buffer = (volatile int16_t *) hda_claim_dma_page(&buffer_physical);
+    if (hda_capture_buffer == NULL)
+        return false;
+
+    hda_fill_descriptor_list(hda_buffer_descriptor_list, buffer_physical);
+
+    const uint32_t stream = hda_stream(0u);
+    hda_program_stream(stream, HDA_CAPTURE_STREAM_NUMBER, hda_descriptor_list_physical);
 
     const uint8_t codec = 0u;
     uint32_t ignored = 0u;
@@ -757,47 +886,484 @@ bool intel_high_definition_audio_start_capture(void)
         (void) intel_high_definition_audio_command(codec, hda_state.capture_pin, HDA_VERB_SET_PIN_CONTROL,
                                                    HDA_PIN_CONTROL_INPUT_ENABLE, &ignored);
 
-    hda_write32(stream + HDA_STREAM_CONTROL, (HDA_CAPTURE_STREAM_NUMBER << 20) | HDA_STREAM_CONTROL_RUN);
+    hda_capture_write = 0u;
+    hda_capture_read = 0u;
+    hda_capture_period_next = 0u;
+    hda_capture_stream_bytes = 0u;
+
+    hda_write32(stream + HDA_STREAM_CONTROL,
+                (HDA_CAPTURE_STREAM_NUMBER << 20) | HDA_STREAM_CONTROL_INTERRUPTS | HDA_STREAM_CONTROL_RUN);
 
-    hda_capture_half_read = 0u;
     hda_state.capture_running = (hda_read8(stream + HDA_STREAM_CONTROL) & HDA_STREAM_CONTROL_RUN) != 0u;
     return hda_state.capture_running;
 }
 
-uint32_t intel_high_definition_audio_poll_capture(int16_t *out, uint32_t capacity)
+/**
+ * @brief Prepares the playback stream: its list, its buffer and its converter.
+ *
+ * The stream is set up but not started; it runs only while there is something to
+ * play, because an idle stream would cost the satellite an interrupt every period.
+ *
+ * NOTHING HERE UNMUTES ANYTHING. The converter is bound to a stream number and told
+ * the format, which is what it takes for the DMA engine to have somewhere to send
+ * samples — and the output amplifiers stay at @ref HDA_AMPLIFIER_MUTE_OUTPUT, and the
+ * output pin is never enabled. Playback exercises the whole path up to the mute and
+ * stops there, on purpose: the output guarantee is kept exactly as it was.
+ */
+static void hda_prepare_playback(void)
 {
-    if (!hda_state.capture_running || out == NULL || hda_capture_buffer == NULL)
-        return 0u;
+    if (hda_state.output_streams == 0u || hda_state.playback_converter == 0u || !hda_claim_descriptor_lists())
+        return;
 
-    const uint32_t samples_per_half = HDA_CAPTURE_HALF_BYTES / 2u;
-    if (capacity < samples_per_half)
-        return 0u;
+    hda_playback_buffer = (volatile int16_t *) hda_claim_dma_page(&hda_playback_buffer_physical);
+    if (hda_playback_buffer == NULL)
+        return;
+
+    hda_fill_descriptor_list(hda_buffer_descriptor_list + HDA_PLAYBACK_LIST_OFFSET_WORDS, hda_playback_buffer_physical);
+    hda_program_stream(hda_playback_stream(), HDA_PLAYBACK_STREAM_NUMBER,
+                       hda_descriptor_list_physical + HDA_PLAYBACK_LIST_OFFSET_WORDS * 4u);
 
-    const uint32_t position = hda_read32(HDA_REG_STREAM_DESCRIPTOR_BASE + HDA_STREAM_LINK_POSITION);
+    const uint8_t codec = 0u;
+    uint32_t ignored = 0u;
+    (void) intel_high_definition_audio_command_wide(codec, hda_state.playback_converter,
+                                                    HDA_VERB_SET_CONVERTER_FORMAT, HDA_CAPTURE_FORMAT, &ignored);
+    (void) intel_high_definition_audio_command(codec, hda_state.playback_converter, HDA_VERB_SET_STREAM_CHANNEL,
+                                               (uint8_t) (HDA_PLAYBACK_STREAM_NUMBER << 4), &ignored);
+
+    hda_playback_write = 0u;
+    hda_playback_read = 0u;
+    hda_state.playback_ready = true;
+}
+
+/**
+ * @brief Acknowledges a stream's status, counting errors.
+ * @param stream Descriptor offset.
+ */
+static void hda_acknowledge_stream(uint32_t stream)
+{
+    const uint8_t status = hda_read8(stream + HDA_STREAM_STATUS);
+    if ((status & HDA_STREAM_STATUS_ERRORS) != 0u)
+        ++hda_state.stream_errors;
+    hda_write8(stream + HDA_STREAM_STATUS, (uint8_t) (status & (HDA_STREAM_STATUS_BUFFER_COMPLETE |
+                                                                HDA_STREAM_STATUS_ERRORS)));
+}
+
+/**
+ * @brief Copies every period the controller has finished into the capture ring.
+ *
+ * A full ring drops the NEW period rather than the oldest unread one: the consumer
+ * owns the read cursor, and a producer that moved it would no longer be a single
+ * producer. The drop is counted, and the stream position still advances past it, so
+ * the age of everything after it is still measured correctly.
+ *
+ * @return Periods the controller finished since the last call.
+ */
+static uint32_t hda_collect_capture(void)
+{
+    const uint32_t position = hda_read32(hda_stream(0u) + HDA_STREAM_LINK_POSITION) % HDA_CYCLIC_BYTES;
     if (position < hda_state.capture_position)
         ++hda_state.capture_wraps;
     hda_state.capture_position = position;
 
-    /* Which half the controller is writing right now. The OTHER one is complete and
-       safe to read — which is the entire reason there are two. */
-    const uint32_t writing = position / HDA_CAPTURE_HALF_BYTES;
-    if (writing == hda_capture_half_read)
+    /* The period the controller is writing right now. Every one before it, back to
+       where the last call stopped, is complete and safe to read. */
+    const uint32_t writing = position / HDA_PERIOD_BYTES;
+    uint32_t collected = 0u;
+    while (hda_capture_period_next != writing)
+    {
+        const uint32_t period = hda_capture_period_next;
+        hda_capture_period_next = (period + 1u) % HDA_PERIODS;
+        hda_capture_stream_bytes += HDA_PERIOD_BYTES;
+        ++hda_state.capture_periods;
+        ++collected;
+
+        const uint32_t write = hda_capture_write;
+        if (write - hda_capture_read >= INTEL_HIGH_DEFINITION_AUDIO_RING_PERIODS)
+        {
+            ++hda_state.capture_overruns;
+            continue;
+        }
+
+        HdaCapturePeriod_t *const slot = &hda_capture_ring[write % INTEL_HIGH_DEFINITION_AUDIO_RING_PERIODS];
+        const volatile int16_t *const source = hda_capture_buffer + period * INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES;
+        for (uint32_t i = 0u; i < INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES; ++i)
+            slot->samples[i] = source[i];
+        slot->end_position = hda_capture_stream_bytes;
+
+        /* The slot before the cursor: a consumer that sees the new index must see the
+           samples it covers. */
+        __sync_synchronize();
+        hda_capture_write = write + 1u;
+    }
+    return collected;
+}
+
+/**
+ * @brief Fills one period of the playback buffer from the ring, silence for the rest.
+ * @param period Period index in the cyclic buffer.
+ * @return true when any queued sample went into it.
+ */
+static bool hda_fill_playback_period(uint32_t period)
+{
+    const uint32_t capacity = INTEL_HIGH_DEFINITION_AUDIO_RING_PERIODS * INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES;
+    volatile int16_t *const target = hda_playback_buffer + period * INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES;
+
+    const uint32_t read = hda_playback_read;
+    const uint32_t queued = hda_playback_write - read;
+    const uint32_t take =
+        queued < INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES ? queued : INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES;
+
+    for (uint32_t i = 0u; i < take; ++i)
+        target[i] = hda_playback_ring[(read + i) % capacity];
+    for (uint32_t i = take; i < INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES; ++i)
+        target[i] = 0;
+
+    __sync_synchronize();
+    hda_playback_read = read + take;
+    if (take != 0u)
+        ++hda_state.playback_periods;
+    return take != 0u;
+}
+
+/** @brief Stops the playback stream. Called with the service lock held. */
+static void hda_stop_playback_locked(void)
+{
+    hda_write32(hda_playback_stream() + HDA_STREAM_CONTROL,
+                (HDA_PLAYBACK_STREAM_NUMBER << 20) | HDA_STREAM_CONTROL_INTERRUPTS);
+    hda_state.playback_running = false;
+}
+
+/** @brief Primes every period and starts the playback stream. Called with the lock held. */
+static void hda_start_playback_locked(void)
+{
+    const uint32_t stream = hda_playback_stream();
+    hda_program_stream(stream, HDA_PLAYBACK_STREAM_NUMBER,
+                       hda_descriptor_list_physical + HDA_PLAYBACK_LIST_OFFSET_WORDS * 4u);
+
+    for (uint32_t period = 0u; period < HDA_PERIODS; ++period)
+        (void) hda_fill_playback_period(period);
+    hda_playback_period_next = 0u;
+    hda_playback_idle_periods = 0u;
+    hda_state.playback_position = 0u;
+
+    hda_write32(stream + HDA_STREAM_CONTROL,
+                (HDA_PLAYBACK_STREAM_NUMBER << 20) | HDA_STREAM_CONTROL_INTERRUPTS | HDA_STREAM_CONTROL_RUN);
+    hda_state.playback_running = (hda_read8(stream + HDA_STREAM_CONTROL) & HDA_STREAM_CONTROL_RUN) != 0u;
+}
+
+/**
+ * @brief Refills every period the controller has finished reading.
+ *
+ * A whole lap of silence stops the stream: by then everything queued has been
+ * played, and a running stream with nothing to say is an interrupt every period
+ * for nothing.
+ */
+static void hda_refill_playback(void)
+{
+    const uint32_t position = hda_read32(hda_playback_stream() + HDA_STREAM_LINK_POSITION) % HDA_CYCLIC_BYTES;
+    hda_state.playback_position = position;
+
+    const uint32_t reading = position / HDA_PERIOD_BYTES;
+    while (hda_playback_period_next != reading)
+    {
+        const uint32_t period = hda_playback_period_next;
+        hda_playback_period_next = (period + 1u) % HDA_PERIODS;
+        if (hda_fill_playback_period(period))
+            hda_playback_idle_periods = 0u;
+        else
+            ++hda_playback_idle_periods;
+    }
+
+    if (hda_playback_idle_periods >= HDA_PERIODS)
+        hda_stop_playback_locked();
+}
+
+uint32_t intel_high_definition_audio_service(void)
+{
+    if (!hda_state.capture_running && !hda_state.playback_ready)
         return 0u;
 
-    const uint32_t ready = hda_capture_half_read;
-    hda_capture_half_read = writing % HDA_CAPTURE_HALVES;
+    uint32_t collected = 0u;
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&hda_service_lock);
+    if (hda_state.capture_running)
+    {
+        hda_acknowledge_stream(hda_stream(0u));
+        collected = hda_collect_capture();
+    }
+    if (hda_state.playback_ready)
+    {
+        hda_acknowledge_stream(hda_playback_stream());
+        if (hda_state.playback_running)
+            hda_refill_playback();
+    }
+    kernel_ticket_lock_release_irqrestore(&hda_service_lock, flags);
+    return collected;
+}
+
+/**
+ * @brief What either interrupt path does: service the streams if they raised it.
+ * @return true when the status named one of this driver's streams.
+ */
+static bool hda_take_interrupt(void)
+{
+    const uint32_t mask = hda_stream_interrupt_mask();
+    if (mask == 0u || (hda_read32(HDA_REG_INTERRUPT_STATUS) & mask) == 0u)
+        return false;
 
-    for (uint32_t i = 0u; i < samples_per_half; ++i)
-        out[i] = hda_capture_buffer[ready * samples_per_half + i];
-    return samples_per_half;
+    ++hda_state.interrupts_taken;
+    (void) intel_high_definition_audio_service();
+    return true;
+}
+
+/**
+ * @brief The controller's interrupt on its legacy line: service and acknowledge.
+ *
+ * INTx lines may be shared, so a status naming none of this driver's streams is
+ * somebody else's interrupt and is left alone — apart from the end-of-interrupt,
+ * which belongs to the line rather than to whoever raised it.
+ */
+static void hda_interrupt_handler(const InterruptFrame_t *frame)
+{
+    (void) frame;
+
+    (void) hda_take_interrupt();
+
+    if (interrupt_request_is_line_owner_apic(hda_state.interrupt_line))
+        advanced_pic_timer_backend_signal_end_of_interrupt();
+    else
+        programmable_interrupt_controller_send_end_of_interrupt(hda_state.interrupt_line);
+}
+
+/**
+ * @brief The controller's interrupt as a message. The vector's dispatcher sends the EOI.
+ *
+ * Also the one place the delivery can be timed against the codec's own clock: a
+ * period's interrupt is raised when the capture position crosses a period boundary,
+ * so how far past the boundary the position is on entry is how long delivery took.
+ */
+static void hda_message_handler(uint8_t vector, void *context)
+{
+    (void) context;
+
+    const uint32_t position = hda_state.capture_running
+                                  ? hda_read32(hda_stream(0u) + HDA_STREAM_LINK_POSITION) % HDA_CYCLIC_BYTES
+                                  : 0u;
+
+    if (hda_take_interrupt() && hda_state.capture_running)
+    {
+        /* 32000 bytes per second of 16-bit 16 kHz mono: a byte is 31.25 microseconds. */
+        const uint32_t since_boundary = position % HDA_PERIOD_BYTES;
+        interrupt_vector_record_latency(vector, (since_boundary * 125u) / 4u);
+    }
+}
+
+/**
+ * @brief Takes the controller's interrupt: a message when it can, its legacy line otherwise.
+ *
+ * A message needs no route, is never shared and goes to a CPU of our choosing, so
+ * it is tried first. Failing that, the line is the one the firmware wrote into
+ * configuration space, which is an ISA number — so the IOAPIC route is the same
+ * ISA route the keyboard uses, resolved through the MADT's overrides, with the PCI
+ * defaults where the table says nothing. Without a local APIC, or when the IOAPIC
+ * cannot take the line, the 8259 delivers it on the same vector. A line another
+ * handler already holds leaves the driver polled.
+ *
+ * A message or an IOAPIC route can be steered, and a period's interrupt is a
+ * deadline, so either one is handed to the IRQ balancer as real-time.
+ *
+ * @param device The controller.
+ */
+static void hda_install_interrupt(const PeripheralComponentInterconnectDevice_t *device)
+{
+    hda_message_function = message_signaled_interrupt_enable(device->bus, device->device, device->function, "hda", 1u,
+                                                             hda_message_handler, NULL, 0u);
+    if (hda_message_function != NULL)
+    {
+        hda_state.interrupt_vector = message_signaled_interrupt_get_vector(hda_message_function, 0u);
+        hda_state.interrupt_msix =
+            message_signaled_interrupt_get_mode(hda_message_function) == MESSAGE_SIGNALED_INTERRUPT_MODE_MSIX;
+        (void) interrupt_affinity_mark_real_time(hda_state.interrupt_vector);
+        return;
+    }
+
+    const uint8_t line = peripheral_component_interconnect_config_read_byte(device->bus, device->device,
+                                                                            device->function,
+                                                                            HDA_PCI_INTERRUPT_LINE_OFFSET);
+    if (line == 0u || line >= 16u || line == 2u)
+        return;
+
+    const uint8_t vector =
+        (uint8_t) ((line < 8u) ? PIC_VECTOR_OFFSET_MASTER + line : PIC_VECTOR_OFFSET_SLAVE + (line - 8u));
+    const isr_handler_t holder = interrupt_service_routine_get_handler(vector);
+    if (holder != NULL && holder != hda_interrupt_handler)
+        return;
+
+    const uint16_t command = peripheral_component_interconnect_config_read_word(device->bus, device->device,
+                                                                                device->function,
+                                                                                HDA_PCI_COMMAND_OFFSET);
+    if ((command & HDA_PCI_COMMAND_INTERRUPT_DISABLE) != 0u)
+        peripheral_component_interconnect_config_write_word(device->bus, device->device, device->function,
+                                                            HDA_PCI_COMMAND_OFFSET,
+                                                            (uint16_t) (command & ~HDA_PCI_COMMAND_INTERRUPT_DISABLE));
+
+    hda_state.interrupt_line = line;
+    interrupt_service_routine_register_handler(vector, hda_interrupt_handler);
+
+    if (advanced_pic_timer_backend_is_local_apic_mmio_mapped() &&
+        input_output_advanced_programmable_interrupt_controller_program_isa_route(line, 1u) &&
+        input_output_advanced_programmable_interrupt_controller_set_isa_route_destination(line, 0u) &&
+        input_output_advanced_programmable_interrupt_controller_enable_isa_route(line))
+    {
+        programmable_interrupt_controller_set_mask(line);
+        interrupt_request_set_line_owner_is_apic(line, 1u);
+        hda_state.interrupt_routed_ioapic = true;
+        (void) interrupt_affinity_mark_real_time(vector);
+        return;
+    }
+
+    if (line >= 8u)
+        programmable_interrupt_controller_clear_mask(2u);
+    programmable_interrupt_controller_clear_mask(line);
+}
+
+bool intel_high_definition_audio_set_interrupts_enabled(bool enabled)
+{
+    if (hda_state.bar_virtual == 0u ||
+        (hda_state.interrupt_line == HDA_NO_INTERRUPT_LINE && hda_state.interrupt_vector == INTERRUPT_VECTOR_NONE))
+        enabled = false;
+
+    if (hda_state.bar_virtual != 0u)
+        hda_write32(HDA_REG_INTERRUPT_CONTROL, enabled ? (HDA_INTERRUPT_GLOBAL_ENABLE | hda_stream_interrupt_mask()) : 0u);
+    hda_state.interrupts_enabled = enabled;
+    return enabled;
+}
+
+bool intel_high_definition_audio_interrupts_enabled(void) { return hda_state.interrupts_enabled; }
+
+const volatile uint32_t *intel_high_definition_audio_capture_cursor(void)
+{
+    return hda_state.capture_running ? &hda_capture_write : NULL;
+}
+
+uint32_t intel_high_definition_audio_capture_available(void)
+{
+    return (hda_capture_write - hda_capture_read) * INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES;
+}
+
+uint32_t intel_high_definition_audio_capture_read(int16_t *out, uint32_t samples, uint32_t *out_age_microseconds)
+{
+    const uint32_t periods = samples / INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES;
+    if (!hda_state.capture_running || out == NULL || periods == 0u)
+        return 0u;
+
+    const uint32_t read = hda_capture_read;
+    if (hda_capture_write - read < periods)
+        return 0u;
+    __sync_synchronize();
+
+    for (uint32_t p = 0u; p < periods; ++p)
+    {
+        const HdaCapturePeriod_t *const slot = &hda_capture_ring[(read + p) % INTEL_HIGH_DEFINITION_AUDIO_RING_PERIODS];
+        for (uint32_t i = 0u; i < INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES; ++i)
+            out[p * INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES + i] = slot->samples[i];
+    }
+
+    /* How old the newest sample handed over is, on the codec's clock: the stream bytes
+       captured since that period ended. The position and the producer's count are read
+       under the lock so they describe the same moment. */
+    if (out_age_microseconds != NULL)
+    {
+        const uint32_t end = hda_capture_ring[(read + periods - 1u) % INTEL_HIGH_DEFINITION_AUDIO_RING_PERIODS].end_position;
+
+        const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&hda_service_lock);
+        const uint32_t position = hda_read32(hda_stream(0u) + HDA_STREAM_LINK_POSITION) % HDA_CYCLIC_BYTES;
+        const uint32_t collected = hda_capture_stream_bytes;
+        kernel_ticket_lock_release_irqrestore(&hda_service_lock, flags);
+
+        const uint32_t since_collected = (position + HDA_CYCLIC_BYTES - collected % HDA_CYCLIC_BYTES) % HDA_CYCLIC_BYTES;
+        const uint32_t age_bytes = (collected - end) + since_collected;
+        /* 32000 bytes per second of 16-bit 16 kHz mono: a byte is 31.25 microseconds. */
+        *out_age_microseconds = (uint32_t) (((uint64_t) age_bytes * 125u) / 4u);
+    }
+
+    hda_capture_read = read + periods;
+    return periods * INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES;
+}
+
+uint32_t intel_high_definition_audio_poll_capture(int16_t *out, uint32_t capacity)
+{
+    if (!hda_state.capture_running || out == NULL)
+        return 0u;
+
+    (void) intel_high_definition_audio_service();
+    return intel_high_definition_audio_capture_read(out, capacity, NULL);
+}
+
+uint32_t intel_high_definition_audio_playback_write(const int16_t *samples, uint32_t count)
+{
+    if (!hda_state.playback_ready || samples == NULL || count == 0u)
+        return 0u;
+
+    const uint32_t capacity = INTEL_HIGH_DEFINITION_AUDIO_RING_PERIODS * INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES;
+    const uint32_t write = hda_playback_write;
+    const uint32_t room = capacity - (write - hda_playback_read);
+    const uint32_t take = count < room ? count : room;
+
+    for (uint32_t i = 0u; i < take; ++i)
+        hda_playback_ring[(write + i) % capacity] = samples[i];
+    __sync_synchronize();
+    hda_playback_write = write + take;
+    hda_state.playback_refused += count - take;
+
+    if (take != 0u && !hda_state.playback_running)
+    {
+        const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&hda_service_lock);
+        if (!hda_state.playback_running)
+            hda_start_playback_locked();
+        kernel_ticket_lock_release_irqrestore(&hda_service_lock, flags);
+    }
+    return take;
+}
+
+bool intel_high_definition_audio_playback_active(void) { return hda_state.playback_running; }
+
+void intel_high_definition_audio_playback_flush(void)
+{
+    if (!hda_state.playback_ready)
+        return;
+
+    /* Under the lock, so the service routine cannot be half-way through a refill from
+       the samples being dropped. Stopping the stream is what makes the drop immediate:
+       without it, everything already copied into the cyclic buffer would still play. */
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&hda_service_lock);
+    hda_playback_read = hda_playback_write;
+    if (hda_state.playback_running)
+        hda_stop_playback_locked();
+    kernel_ticket_lock_release_irqrestore(&hda_service_lock, flags);
 }
 
 bool intel_high_definition_audio_initialize(IntelHighDefinitionAudioState_t *out)
 {
+    /* A second bring-up must not take the previous one's interrupt half-way through
+       clearing the state that interrupt would read. */
+    if (hda_state.bar_virtual != 0u)
+        hda_write32(HDA_REG_INTERRUPT_CONTROL, 0u);
+    if (hda_state.interrupt_vector != INTERRUPT_VECTOR_NONE)
+        interrupt_affinity_unpin(hda_state.interrupt_vector);
+    if (hda_state.interrupt_routed_ioapic)
+        interrupt_affinity_unpin((uint8_t) (PIC_VECTOR_OFFSET_MASTER + hda_state.interrupt_line));
+    message_signaled_interrupt_disable(hda_message_function);
+    hda_message_function = NULL;
+
     for (uint32_t i = 0u; i < sizeof(hda_state); ++i)
         ((volatile uint8_t *) &hda_state)[i] = 0u;
     hda_command_ring = NULL;
     hda_response_ring = NULL;
+    hda_buffer_descriptor_list = NULL;
+    hda_capture_buffer = NULL;
+    hda_playback_buffer = NULL;
+    hda_state.interrupt_line = HDA_NO_INTERRUPT_LINE;
+    kernel_ticket_lock_initialize(&hda_service_lock, NULL);
 
     const PeripheralComponentInterconnectDevice_t *const device =
         peripheral_component_interconnect_find_by_class(HDA_PCI_CLASS, HDA_PCI_SUBCLASS);
@@ -902,6 +1468,14 @@ bool intel_high_definition_audio_initialize(IntelHighDefinitionAudioState_t *out
                 break;
         }
         (void) intel_high_definition_audio_start_capture();
+        hda_prepare_playback();
+
+        /* Interrupt-driven by default. The polled path stays reachable through
+           intel_high_definition_audio_set_interrupts_enabled(), because it is the one
+           a machine without a usable line falls back to — and the one a measurement
+           compares against. */
+        hda_install_interrupt(device);
+        (void) intel_high_definition_audio_set_interrupts_enabled(true);
     }
 
     if (out != NULL)
@@ -0,0 +1,268 @@
+/**
+ * @file input_event.c
+ * @brief Timestamped input event ring and input-to-present latency.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#include <kernel/drivers/input_event.h>
+
+#include <kernel/core/timer.h>
+#include <kernel/diag/telemetry.h>
+#include <kernel/lib/asmutils.h>
+#include <kernel/memory/ring_buffer.h>
+
+#include <stddef.h>
+
+#define INPUT_EVENT_SCANCODE_EXTENDED 0xE0u
+#define INPUT_EVENT_SCANCODE_PAUSE    0xE1u
+#define INPUT_EVENT_PAUSE_TAIL_BYTES  5u /* E1 1D 45 E1 9D C5: one key, no break */
+#define INPUT_EVENT_BREAK_BIT         0x80u
+
+static KernelRing_t input_event_ring;
+static bool input_event_ready = false;
+static volatile bool input_event_capturing = false;
+static volatile uint32_t input_event_sequence = 0u;
+static volatile uint32_t input_event_keys = 0u;
+static volatile uint32_t input_event_pointers = 0u;
+
+/* Keyboard interrupt only: prefix state between bytes of one key. */
+static uint8_t input_event_extended_pending = 0u;
+static uint8_t input_event_pause_remaining = 0u;
+
+/* Consumer side: the engine loop drains and presents. */
+static uint32_t input_event_drained = 0u;
+static uint32_t input_event_drains = 0u;
+static uint64_t input_event_unshown_timestamp = 0u; /* newest drained, not yet presented; 0 when none */
+static uint32_t input_event_unshown_sequence = 0u;
+static uint32_t input_event_presents = 0u;
+static uint32_t input_event_tagged_presents = 0u;
+static uint32_t input_event_last_sequence = 0u;
+static uint32_t input_event_latency_last_us = 0u;
+static uint32_t input_event_latency_max_us = 0u;
+static uint32_t input_event_latency_window[KERNEL_INPUT_EVENT_LATENCY_WINDOW];
+static uint32_t input_event_latency_samples = 0u; /* every sample taken; the window holds the last ones */
+
+static void input_event_publish(KernelInputEvent_t *event)
+{
+    /* Numbered before the claim, so a refused event still leaves its gap. The
+       ring counts the refusal. */
+    event->sequence = __atomic_add_fetch(&input_event_sequence, 1u, __ATOMIC_RELAXED);
+    (void) kernel_ring_enqueue(&input_event_ring, event, (uint32_t) sizeof(*event));
+}
+
+bool kernel_input_event_initialize(void)
+{
+    if (input_event_ready)
+        return true;
+
+    /* Two producers, each an interrupt handler that may run on a different CPU
+       once the IOAPIC routes them: MPSC. A lost event costs that event, as a lost
+       scan code does. */
+    if (!kernel_ring_initialize(&input_event_ring, "input_event", (uint32_t) sizeof(KernelInputEvent_t),
+                                KERNEL_INPUT_EVENT_RING_CAPACITY, KERNEL_RING_BUFFER_MODE_MPSC,
+                                KERNEL_BACKPRESSURE_POLICY_DROP_TOLERATED))
+        return false;
+
+    input_event_ready = true;
+    return true;
+}
+
+void kernel_input_event_set_capture(bool enabled) { input_event_capturing = enabled && input_event_ready; }
+
+bool kernel_input_event_is_capturing(void) { return input_event_capturing; }
+
+void kernel_input_event_publish_scancode(uint8_t scancode, uint64_t timestamp)
+{
+    /* Controller replies (ack, resend, errors) share the port but are not keys. */
+    if (scancode == 0x00u || scancode == 0xFAu || scancode == 0xFEu || scancode == 0xFFu)
+        return;
+
+    if (input_event_pause_remaining != 0u)
+    {
+        --input_event_pause_remaining;
+        return;
+    }
+    if (scancode == INPUT_EVENT_SCANCODE_PAUSE)
+    {
+        input_event_pause_remaining = INPUT_EVENT_PAUSE_TAIL_BYTES;
+        return;
+    }
+    if (scancode == INPUT_EVENT_SCANCODE_EXTENDED)
+    {
+        input_event_extended_pending = 1u;
+        return;
+    }
+
+    const uint8_t extended = input_event_extended_pending;
+    input_event_extended_pending = 0u;
+
+    if (!input_event_capturing)
+        return;
+
+    KernelInputEvent_t event = {0};
+    event.timestamp = timestamp;
+    event.type = (scancode & INPUT_EVENT_BREAK_BIT) != 0u ? KERNEL_INPUT_EVENT_KEY_UP : KERNEL_INPUT_EVENT_KEY_DOWN;
+    event.code = (uint8_t) (scancode & (uint8_t) ~INPUT_EVENT_BREAK_BIT);
+    event.flags = extended ? KERNEL_INPUT_EVENT_FLAG_EXTENDED : 0u;
+
+    __atomic_add_fetch(&input_event_keys, 1u, __ATOMIC_RELAXED);
+    input_event_publish(&event);
+}
+
+void kernel_input_event_publish_pointer(int32_t delta_x, int32_t delta_y, uint32_t buttons, uint64_t timestamp)
+{
+    if (!input_event_capturing)
+        return;
+
+    KernelInputEvent_t event = {0};
+    event.timestamp = timestamp;
+    event.type = KERNEL_INPUT_EVENT_POINTER;
+    event.buttons = (uint8_t) (buttons & 0x07u);
+    event.delta_x = (int16_t) delta_x;
+    event.delta_y = (int16_t) delta_y;
+
+    __atomic_add_fetch(&input_event_pointers, 1u, __ATOMIC_RELAXED);
+    input_event_publish(&event);
+}
+
+uint32_t kernel_input_event_drain(KernelInputEvent_t *events, uint32_t capacity)
+{
+    if (!input_event_ready || !events || capacity == 0u)
+        return 0u;
+
+    input_event_capturing = true;
+
+    const uint32_t count =
+        kernel_ring_dequeue_batch(&input_event_ring, events, (uint32_t) sizeof(KernelInputEvent_t), capacity);
+    if (count == 0u)
+        return 0u;
+
+    input_event_drained += count;
+    ++input_event_drains;
+
+    /* Events of two producers interleave in claim order, not time order: the
+       newest is the latest stamp, wherever it sits in the batch. */
+    for (uint32_t index = 0u; index < count; ++index)
+    {
+        if (events[index].timestamp >= input_event_unshown_timestamp)
+        {
+            input_event_unshown_timestamp = events[index].timestamp;
+            input_event_unshown_sequence = events[index].sequence;
+        }
+    }
+    return count;
+}
+
+uint32_t kernel_input_event_pending_count(void)
+{
+    return input_event_ready ? kernel_ring_get_count(&input_event_ring) : 0u;
+}
+
+void kernel_input_event_note_present(void)
+{
+    ++input_event_presents;
+    if (input_event_unshown_timestamp == 0u)
+        return;
+
+    const uint64_t now = asmutils_read_timestamp_counter();
+    const uint64_t cycles = now > input_event_unshown_timestamp ? now - input_event_unshown_timestamp : 0u;
+    const uint32_t latency_us = kernel_timer_cycles_to_microseconds(cycles);
+
+    input_event_last_sequence = input_event_unshown_sequence;
+    input_event_unshown_timestamp = 0u;
+    ++input_event_tagged_presents;
+
+    input_event_latency_last_us = latency_us;
+    if (latency_us > input_event_latency_max_us)
+        input_event_latency_max_us = latency_us;
+    input_event_latency_window[input_event_latency_samples % KERNEL_INPUT_EVENT_LATENCY_WINDOW] = latency_us;
+    ++input_event_latency_samples;
+}
+
+/** @brief The @p permille-th sample of @p sorted, nearest rank. */
+static uint32_t input_event_percentile(const uint32_t *sorted, uint32_t count, uint32_t permille)
+{
+    if (count == 0u)
+        return 0u;
+
+    uint32_t rank = (count * permille + 999u) / 1000u;
+    if (rank == 0u)
+        rank = 1u;
+    return sorted[rank - 1u];
+}
+
+void kernel_input_event_get_statistics(KernelInputEventStatistics_t *out)
+{
+    static uint32_t sorted[KERNEL_INPUT_EVENT_LATENCY_WINDOW];
+
+    if (!out)
+        return;
+
+    *out = (KernelInputEventStatistics_t) {0};
+    out->ready = input_event_ready;
+    out->capturing = input_event_capturing;
+    out->dropped = input_event_ready ? kernel_ring_get_failed_enqueue_count(&input_event_ring) : 0u;
+    out->produced = input_event_sequence - out->dropped;
+    out->keys = input_event_keys;
+    out->pointers = input_event_pointers;
+    out->drained = input_event_drained;
+    out->drains = input_event_drains;
+    out->high_watermark = input_event_ready ? kernel_ring_get_high_watermark(&input_event_ring) : 0u;
+    out->presents = input_event_presents;
+    out->tagged_presents = input_event_tagged_presents;
+    out->last_sequence = input_event_last_sequence;
+    out->latency_max_us = input_event_latency_max_us;
+    out->latency_last_us = input_event_latency_last_us;
+
+    const uint32_t count = input_event_latency_samples < KERNEL_INPUT_EVENT_LATENCY_WINDOW
+                               ? input_event_latency_samples
+                               : KERNEL_INPUT_EVENT_LATENCY_WINDOW;
+
+    /* A few hundred samples, sorted on demand: insertion sort is plenty. */
+    for (uint32_t index = 0u; index < count; ++index)
+    {
+        const uint32_t value = input_event_latency_window[index];
+        uint32_t slot = index;
+
+        while (slot > 0u && sorted[slot - 1u] > value)
+        {
+            sorted[slot] = sorted[slot - 1u];
+            --slot;
+        }
+        sorted[slot] = value;
+    }
+
+    out->samples = count;
+    out->latency_p50_us = input_event_percentile(sorted, count, 500u);
+    out->latency_p90_us = input_event_percentile(sorted, count, 900u);
+    out->latency_p99_us = input_event_percentile(sorted, count, 990u);
+}
+
+void kernel_input_event_report(Serial_t *serial)
+{
+    KernelInputEventStatistics_t statistics;
+
+    kernel_input_event_get_statistics(&statistics);
+
+    kernel_telemetry_begin_record(serial, "input_latency");
+    kernel_telemetry_write_boolean("ready", statistics.ready);
+    kernel_telemetry_write_boolean("capturing", statistics.capturing);
+    kernel_telemetry_write_unsigned("produced", statistics.produced);
+    kernel_telemetry_write_unsigned("dropped", statistics.dropped);
+    kernel_telemetry_write_unsigned("keys", statistics.keys);
+    kernel_telemetry_write_unsigned("pointers", statistics.pointers);
+    kernel_telemetry_write_unsigned("drained", statistics.drained);
+    kernel_telemetry_write_unsigned("drains", statistics.drains);
+    kernel_telemetry_write_unsigned("high_watermark", statistics.high_watermark);
+    kernel_telemetry_write_unsigned("presents", statistics.presents);
+    kernel_telemetry_write_unsigned("tagged_presents", statistics.tagged_presents);
+    kernel_telemetry_write_unsigned("samples", statistics.samples);
+    kernel_telemetry_write_unsigned("p50_us", statistics.latency_p50_us);
+    kernel_telemetry_write_unsigned("p90_us", statistics.latency_p90_us);
+    kernel_telemetry_write_unsigned("p99_us", statistics.latency_p99_us);
+    kernel_telemetry_write_unsigned("max_us", statistics.latency_max_us);
+    kernel_telemetry_end_record();
+}
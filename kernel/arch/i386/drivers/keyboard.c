@@ -4,6 +4,7 @@
 #include <kernel/cpu/irq.h>
 #include <kernel/cpu/isr.h>
 #include <kernel/cpu/pic.h>
+#include <kernel/drivers/input_event.h>
 #include <kernel/drivers/ps2_keyboard.h>
 #include <kernel/lib/asmutils.h>
 
@@ -39,6 +40,7 @@ static uint32_t keyboard_scancode_drop_count = 0u; /* producer-only counter */
 
 static void keyboard_interrupt_handler(const InterruptFrame_t *frame)
 {
+    const uint64_t timestamp = asmutils_read_timestamp_counter();
     const uint8_t scan_code = asmutils_input_byte(KEYBOARD_DATA_PORT);
     const uint32_t head = keyboard_scancode_ring_head;
     const uint32_t tail = keyboard_scancode_ring_tail;
@@ -56,6 +58,9 @@ static void keyboard_interrupt_handler(const InterruptFrame_t *frame)
         keyboard_scancode_ring_head = head + 1u;
     }
 
+    /* The same byte, as a timestamped key event for whoever drains events. */
+    kernel_input_event_publish_scancode(scan_code, timestamp);
+
     if (interrupt_request_is_keyboard_owner_apic())
         advanced_pic_timer_backend_signal_end_of_interrupt();
     else
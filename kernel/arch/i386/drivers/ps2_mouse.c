@@ -4,6 +4,7 @@
 #include <kernel/cpu/irq.h>
 #include <kernel/cpu/isr.h>
 #include <kernel/cpu/pic.h>
+#include <kernel/drivers/input_event.h>
 #include <kernel/lib/asmutils.h>
 
 #include <stddef.h>
@@ -51,6 +52,15 @@ static uint32_t personal_system_2_mouse_dropped_byte_count = 0u;
 static uint32_t personal_system_2_mouse_resynchronization_count = 0u;
 static uint8_t personal_system_2_mouse_present = 0u;
 
+/*
+** The event ring wants whole reports stamped when they complete, so the handler
+** assembles a second copy of the stream. This state belongs to the handler alone
+** and nothing else reads it; the byte ring and its consumer-side assembly are
+** untouched.
+*/
+static uint8_t personal_system_2_mouse_event_bytes[3];
+static uint8_t personal_system_2_mouse_event_index = 0u;
+
 static uint8_t personal_system_2_wait_for_input_clear(void)
 {
     uint32_t budget = PERSONAL_SYSTEM_2_SPIN_BUDGET;
@@ -113,8 +123,37 @@ static uint8_t personal_system_2_mouse_send(uint8_t value)
     return response == PERSONAL_SYSTEM_2_MOUSE_ACKNOWLEDGE ? 1u : 0u;
 }
 
+static int32_t personal_system_2_mouse_decode_axis(uint8_t raw, uint8_t flags, uint8_t sign_bit, uint8_t overflow_bit)
+{
+    /* An overflowed axis carries no usable magnitude; reporting the truncated
+       byte would send the view lurching. Zero is the honest reading. */
+    if ((flags & overflow_bit) != 0u)
+        return 0;
+    return (flags & sign_bit) != 0u ? (int32_t) raw - 256 : (int32_t) raw;
+}
+
+static void personal_system_2_mouse_event_feed(uint8_t byte, uint64_t timestamp)
+{
+    /* Bit 3 of a header is always set: anything else where a header belongs is a
+       byte from a report already lost, skipped as the consumer side skips it. */
+    if (personal_system_2_mouse_event_index == 0u && (byte & 0x08u) == 0u)
+        return;
+
+    personal_system_2_mouse_event_bytes[personal_system_2_mouse_event_index++] = byte;
+    if (personal_system_2_mouse_event_index < 3u)
+        return;
+    personal_system_2_mouse_event_index = 0u;
+
+    const uint8_t flags = personal_system_2_mouse_event_bytes[0];
+    kernel_input_event_publish_pointer(
+        personal_system_2_mouse_decode_axis(personal_system_2_mouse_event_bytes[1], flags, 0x10u, 0x40u),
+        personal_system_2_mouse_decode_axis(personal_system_2_mouse_event_bytes[2], flags, 0x20u, 0x80u),
+        flags & 0x07u, timestamp);
+}
+
 static void personal_system_2_mouse_interrupt_handler(const InterruptFrame_t *frame)
 {
+    const uint64_t timestamp = asmutils_read_timestamp_counter();
     const uint8_t status = asmutils_input_byte(PERSONAL_SYSTEM_2_STATUS_PORT);
 
     (void) frame;
@@ -140,6 +179,7 @@ static void personal_system_2_mouse_interrupt_handler(const InterruptFrame_t *fr
             personal_system_2_mouse_ring[head & PERSONAL_SYSTEM_2_MOUSE_RING_MASK] = byte;
             personal_system_2_mouse_ring_head = head + 1u;
         }
+        personal_system_2_mouse_event_feed(byte, timestamp);
     }
 
     /*
@@ -172,6 +212,7 @@ uint8_t personal_system_2_mouse_initialize(void)
     uint8_t configuration = 0u;
 
     personal_system_2_mouse_present = 0u;
+    personal_system_2_mouse_event_index = 0u;
 
     if (!personal_system_2_write_command(PERSONAL_SYSTEM_2_COMMAND_ENABLE_AUXILIARY))
         return 0u;
@@ -242,17 +283,8 @@ uint8_t personal_system_2_mouse_try_pop_packet(PersonalSystem2MousePacket_t *out
 
     personal_system_2_mouse_ring_tail = personal_system_2_mouse_ring_tail + 3u;
 
-    /* An overflowed axis carries no usable magnitude; reporting the truncated
-       byte would send the view lurching. Zero is the honest reading. */
-    if ((flags & 0x40u) != 0u)
-        delta_x = 0;
-    else
-        delta_x = (flags & 0x10u) != 0u ? (int32_t) raw_x - 256 : (int32_t) raw_x;
-
-    if ((flags & 0x80u) != 0u)
-        delta_y = 0;
-    else
-        delta_y = (flags & 0x20u) != 0u ? (int32_t) raw_y - 256 : (int32_t) raw_y;
+    delta_x = personal_system_2_mouse_decode_axis(raw_x, flags, 0x10u, 0x40u);
+    delta_y = personal_system_2_mouse_decode_axis(raw_y, flags, 0x20u, 0x80u);
 
     out_packet->delta_x = delta_x;
     out_packet->delta_y = delta_y;
@@ -14,14 +14,16 @@ static inline int serial_can_read(Serial_t *serial) { return asmutils_input_byte
 
 void serial_initialize(Serial_t *serial, COM_PORT port, uint32_t speed)
 {
+    const uint32_t divisor = BASE_SERIAL_SPEED / speed;
+
     serial->port = port;
     serial->speed = speed;
     serial->initialized = 0;
 
     asmutils_output_byte(port + 1, 0x00);
     asmutils_output_byte(port + 3, 0x80);
-    asmutils_output_byte(port, (BASE_SERIAL_SPEED / speed) % 256);
-    asmutils_output_byte(port + 1, (BASE_SERIAL_SPEED / speed) % 256);
+    asmutils_output_byte(port, divisor & 0xFF);
+    asmutils_output_byte(port + 1, (divisor >> 8) & 0xFF);
     asmutils_output_byte(port + 3, 0x03);
     asmutils_output_byte(port + 2, 0xC7);
     asmutils_output_byte(port + 4, 0x0B);
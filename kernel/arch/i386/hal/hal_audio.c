@@ -7,12 +7,11 @@
  * the satellite profile claim to be listening to a quiet room, and there is no way to
  * tell those two apart from the outside.
  *
- * The ring is the same single-producer structure the keyboard uses, sized for
- * forty-millisecond buffers, and its write index is exposed so the power floor can
- * sleep on it. The producer today is @ref hardware_abstraction_layer_audio_capture_pump
- * rather than an interrupt handler, because `drivers/hda.c` polls the stream's link
- * position; when it grows a handler, the handler fills this ring instead and nothing
- * above changes.
+ * The ring lives in `drivers/hda.c`, filled period by period from the controller's
+ * interrupt handler, and its write cursor is exposed so the power floor can sleep on
+ * it. This side hands it out in forty-millisecond buffers. With stream interrupts off
+ * the same ring is filled by @ref hardware_abstraction_layer_audio_capture_pump, which
+ * is what the satellite measures the interrupt-driven path against.
  *
  * @author MasterLaplace
  * @version 0.1.0
@@ -23,21 +22,16 @@
 
 #include <kernel/drivers/hda.h>
 
-static int16_t hal_audio_ring[KERNEL_HAL_AUDIO_RING_FRAMES][KERNEL_HAL_AUDIO_FRAME_SAMPLES];
-static volatile uint32_t hal_audio_write_index = 0u;
-static volatile uint32_t hal_audio_read_index = 0u;
-static volatile uint32_t hal_audio_overruns = 0u;
 static bool hal_audio_codec_present = false;
 static const char *hal_audio_name = "absent";
 static uint32_t hal_audio_gain_permille = 1000u;
 static uint32_t hal_audio_clipped = 0u;
+static uint32_t hal_audio_latency_microseconds = 0u;
 
 bool hardware_abstraction_layer_audio_initialize(void)
 {
-    hal_audio_write_index = 0u;
-    hal_audio_read_index = 0u;
-    hal_audio_overruns = 0u;
     hal_audio_codec_present = false;
+    hal_audio_latency_microseconds = 0u;
     hal_audio_name = "absent";
 
     /* `present` means "capture works", and it is taken from the stream descriptor
@@ -66,30 +60,24 @@ bool hardware_abstraction_layer_audio_initialize(void)
 
 uint32_t hardware_abstraction_layer_audio_capture_pump(void)
 {
-    if (!hal_audio_codec_present)
+    /* With the handler producing, there is nothing to pump — and calling the service
+       routine anyway would only take its lock from under it. */
+    if (!hal_audio_codec_present || intel_high_definition_audio_interrupts_enabled())
         return 0u;
 
-    uint32_t moved = 0u;
-    for (;;)
-    {
-        const uint32_t slot = hal_audio_write_index % KERNEL_HAL_AUDIO_RING_FRAMES;
-        const uint32_t samples =
-            intel_high_definition_audio_poll_capture(hal_audio_ring[slot], KERNEL_HAL_AUDIO_FRAME_SAMPLES);
-        if (samples == 0u)
-            break;
-
-        /* Overrun is counted, not hidden. A consumer that has fallen a whole ring
-           behind is losing audio, and that only shows up as a number — the samples
-           themselves look exactly like the ones that arrived on time. */
-        if (hal_audio_write_index - hal_audio_read_index >= KERNEL_HAL_AUDIO_RING_FRAMES)
-        {
-            ++hal_audio_overruns;
-            ++hal_audio_read_index;
-        }
-        ++hal_audio_write_index;
-        ++moved;
-    }
-    return moved;
+    return intel_high_definition_audio_service();
+}
+
+bool hardware_abstraction_layer_audio_capture_interrupt_driven(void)
+{
+    return hal_audio_codec_present && intel_high_definition_audio_interrupts_enabled();
+}
+
+bool hardware_abstraction_layer_audio_set_capture_interrupt_driven(bool enabled)
+{
+    if (!hal_audio_codec_present)
+        return false;
+    return intel_high_definition_audio_set_interrupts_enabled(enabled);
 }
 
 bool hardware_abstraction_layer_audio_present(void) { return hal_audio_codec_present; }
@@ -100,27 +88,23 @@ uint32_t hardware_abstraction_layer_audio_sample_rate(void) { return hal_audio_c
 
 const volatile uint32_t *hardware_abstraction_layer_audio_capture_write_index(void)
 {
-    return hal_audio_codec_present ? &hal_audio_write_index : NULL;
+    return hal_audio_codec_present ? intel_high_definition_audio_capture_cursor() : NULL;
 }
 
 uint32_t hardware_abstraction_layer_audio_capture_take(int16_t *out, uint32_t capacity)
 {
-    if (out == NULL || capacity < KERNEL_HAL_AUDIO_FRAME_SAMPLES)
+    if (!hal_audio_codec_present || out == NULL || capacity < KERNEL_HAL_AUDIO_FRAME_SAMPLES)
         return 0u;
 
-    const uint32_t write = hal_audio_write_index;
-    const uint32_t read = hal_audio_read_index;
-    if (write == read)
-        return 0u;
-
-    const uint32_t slot = read % KERNEL_HAL_AUDIO_RING_FRAMES;
-    for (uint32_t i = 0u; i < KERNEL_HAL_AUDIO_FRAME_SAMPLES; ++i)
-        out[i] = hal_audio_ring[slot][i];
-
-    hal_audio_read_index = read + 1u;
-    return KERNEL_HAL_AUDIO_FRAME_SAMPLES;
+    uint32_t age = 0u;
+    const uint32_t samples = intel_high_definition_audio_capture_read(out, KERNEL_HAL_AUDIO_FRAME_SAMPLES, &age);
+    if (samples != 0u)
+        hal_audio_latency_microseconds = age;
+    return samples;
 }
 
+uint32_t hardware_abstraction_layer_audio_capture_latency_microseconds(void) { return hal_audio_latency_microseconds; }
+
 uint32_t hardware_abstraction_layer_audio_set_output_gain_permille(uint32_t permille)
 {
     hal_audio_gain_permille = permille > 1000u ? 1000u : permille;
@@ -164,17 +148,24 @@ uint32_t hardware_abstraction_layer_audio_clipped_samples(void) { return hal_aud
 
 bool hardware_abstraction_layer_audio_playback_submit(const int16_t *samples, uint32_t count)
 {
-    /* The limiter runs even though nothing plays yet, and that is deliberate: it means
-       there is no future commit in which the stream path exists and the ceiling has
-       not been wired to it. The submission still fails, because there is no stream. */
+    /* Every sample goes through the limiter on its way to the stream; there is no
+       other route to intel_high_definition_audio_playback_write() from here. Behind
+       it the output amplifiers are muted and stay muted — the stream runs, the
+       converter is fed, and nothing reaches a speaker. */
     static int16_t limited[KERNEL_HAL_AUDIO_FRAME_SAMPLES];
+    if (samples == NULL)
+        return false;
+
     const uint32_t take = count < KERNEL_HAL_AUDIO_FRAME_SAMPLES ? count : KERNEL_HAL_AUDIO_FRAME_SAMPLES;
     (void) hardware_abstraction_layer_audio_limit(samples, take, limited);
-    return false;
+    return take != 0u && intel_high_definition_audio_playback_write(limited, take) == take;
 }
 
-bool hardware_abstraction_layer_audio_playback_active(void) { return false; }
+bool hardware_abstraction_layer_audio_playback_active(void) { return intel_high_definition_audio_playback_active(); }
 
-void hardware_abstraction_layer_audio_playback_flush(void) {}
+void hardware_abstraction_layer_audio_playback_flush(void) { intel_high_definition_audio_playback_flush(); }
 
-uint32_t hardware_abstraction_layer_audio_capture_overruns(void) { return hal_audio_overruns; }
+uint32_t hardware_abstraction_layer_audio_capture_overruns(void)
+{
+    return intel_high_definition_audio_state()->capture_overruns;
+}
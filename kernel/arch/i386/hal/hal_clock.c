@@ -10,7 +10,16 @@
  */
 #include <kernel/hal/hal.h>
 
+#include <kernel/core/timer.h>
 #include <kernel/cpu/clock.h>
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/cpu/interrupt_affinity.h>
+#include <kernel/diag/trace.h>
+#include <kernel/power/processor_sleep.h>
+
+static KernelTimer_t hal_clock_step_timer;
+static volatile uint32_t hal_clock_steps = 0u;
+static bool hal_clock_step_scheduled = false;
 
 uint32_t hardware_abstraction_layer_clock_tick_count(void) { return clock_get_tick_count(); }
 
@@ -23,3 +32,48 @@ uint64_t hardware_abstraction_layer_clock_timestamp_counter(void)
     __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
     return ((uint64_t) high << 32) | (uint64_t) low;
 }
+
+uint64_t hardware_abstraction_layer_clock_trace_begin(void) { return kernel_trace_begin(); }
+
+void hardware_abstraction_layer_clock_trace_end(const char *name, uint64_t token)
+{
+    kernel_trace_end_named(name, token, 0u);
+}
+
+static void hal_clock_step_due(KernelTimer_t *timer, void *context)
+{
+    (void) timer;
+    (void) context;
+    ++hal_clock_steps;
+}
+
+bool hardware_abstraction_layer_clock_step_schedule(uint32_t hertz)
+{
+    if (hal_clock_step_scheduled)
+        (void) kernel_timer_cancel(&hal_clock_step_timer);
+    hal_clock_step_scheduled = false;
+
+    if (hertz == 0u || !kernel_timer_is_active())
+        return hertz == 0u;
+
+    /* Precise: a step is a frame deadline, and a granule late on a 144 Hz step is
+       a seventh of the frame. */
+    const uint64_t period = kernel_timer_microseconds_to_cycles(1000000u) / hertz;
+    kernel_timer_setup(&hal_clock_step_timer, "engine_step", hal_clock_step_due, NULL, KERNEL_TIMER_FLAG_PRECISE);
+    hal_clock_step_scheduled = kernel_timer_arm(&hal_clock_step_timer, kernel_timer_now() + period, period);
+
+    /* The step fires on the CPU that armed it, and that CPU is the one device
+       interrupts are to be kept away from. */
+    if (hal_clock_step_scheduled)
+        interrupt_affinity_set_tick_cpu(cpu_topology_get_logical_slot());
+    return hal_clock_step_scheduled;
+}
+
+uint32_t hardware_abstraction_layer_clock_step_count(void) { return hal_clock_steps; }
+
+uint32_t hardware_abstraction_layer_clock_step_wait(uint32_t seen)
+{
+    while (hal_clock_step_scheduled && hal_clock_steps == seen)
+        (void) processor_sleep_until_write(&hal_clock_steps, seen);
+    return hal_clock_steps;
+}
@@ -10,7 +10,9 @@
  */
 #include <kernel/hal/hal.h>
 
+#include <kernel/diag/trace.h>
 #include <kernel/drivers/framebuffer.h>
+#include <kernel/drivers/input_event.h>
 
 #include <stddef.h>
 
@@ -80,10 +82,33 @@ uint32_t hardware_abstraction_layer_display_read_pixel(uint32_t x, uint32_t y)
     return hardware_abstraction_layer_rgb_from_color(framebuffer_get_pixel(x, y));
 }
 
+void hardware_abstraction_layer_display_mark_damage(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    /* The software LFB is its own scanout: there is nothing to transfer. */
+    if (hardware_abstraction_layer_virtio_gpu_display_active())
+        hardware_abstraction_layer_virtio_gpu_display_mark_damage(x, y, width, height);
+}
+
 void hardware_abstraction_layer_display_present(void)
 {
+    KERNEL_TRACE_SCOPE("display.present");
+
     /* Software-LFB renders straight into scanout memory (no-op present); the
-       virtio-gpu backend issues TRANSFER_TO_HOST_2D + RESOURCE_FLUSH here. */
+       virtio-gpu backend queues TRANSFER_TO_HOST_2D + RESOURCE_FLUSH here. */
     if (hardware_abstraction_layer_virtio_gpu_display_active())
         hardware_abstraction_layer_virtio_gpu_display_present();
+
+    /* Queued (or, on the LFB, already visible): what input this frame shows. */
+    kernel_input_event_note_present();
+}
+
+bool hardware_abstraction_layer_display_get_present_statistics(
+    hardware_abstraction_layer_display_present_statistics_t *out_statistics)
+{
+    if (out_statistics == NULL)
+        return false;
+    if (hardware_abstraction_layer_virtio_gpu_display_active())
+        return hardware_abstraction_layer_virtio_gpu_display_get_statistics(out_statistics);
+    *out_statistics = (hardware_abstraction_layer_display_present_statistics_t){0};
+    return false;
 }
@@ -2,28 +2,35 @@
  * @file hal_graphics_memory.c
  * @brief Graphics-memory backend for the engine HAL.
  *
- * Implements the hardware_abstraction_layer_graphics_memory_* contract over the kernel pinned-memory
- * allocator: pinned pages are never relocated, giving the stable mappings a GPU
- * uploader needs (WDDM-GPUVA semantics). Pinned memory is "contiguous-ish" and
- * exposes no single physical base, so callers that hand pages to a GPU must walk
- * the scatter-gather list; hardware_abstraction_layer_graphics_memory_physical_address resolves one
- * page's physical address via the paging map for that walk.
+ * Implements the hardware_abstraction_layer_graphics_memory_* contract over the
+ * contiguous DMA allocator: one buddy block per buffer, never relocated, so a GPU
+ * resource's backing is a single physical run and the scatter-gather list a
+ * device is handed collapses to one entry. When no block is large enough (a
+ * fragmented buddy, or the real-time PMM, which has no orders above 0) the
+ * buffer falls back to kernel pinned memory, page by page, and callers still walk
+ * it through hardware_abstraction_layer_graphics_memory_physical_address, which
+ * resolves one page via the paging map.
  */
 #include <kernel/hal/hal.h>
 
 #include <kernel/cpu/paging.h>
+#include <kernel/memory/dma.h>
 #include <kernel/memory/pinned_memory.h>
 
 #include <stddef.h>
 
 void *hardware_abstraction_layer_graphics_memory_allocate(uint32_t size_bytes)
 {
+    KernelDmaBuffer_t buffer;
+    if (kernel_dma_alloc(size_bytes, 0u, 0u, PAGING_MEMORY_TYPE_WRITE_BACK, &buffer))
+        return buffer.virtual_address;
     return kernel_pinned_alloc(size_bytes);
 }
 
 void hardware_abstraction_layer_graphics_memory_free(void *pointer, uint32_t size_bytes)
 {
-    kernel_pinned_free(pointer, size_bytes);
+    if (!kernel_dma_free(pointer))
+        kernel_pinned_free(pointer, size_bytes);
 }
 
 bool hardware_abstraction_layer_graphics_memory_physical_address(const void *virtual_address,
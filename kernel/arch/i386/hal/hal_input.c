@@ -6,9 +6,13 @@
  * ring (ISR producer -> engine consumer). The engine drains decoded characters;
  * the kernel keeps owning scancode decoding and layout state. This generalizes
  * to additional input devices behind the same drain contract.
+ *
+ * Alongside it, the timestamped event stream (input_event.h) for callers that
+ * want key up/down and an age on every input, drained in batches.
  */
 #include <kernel/hal/hal.h>
 
+#include <kernel/drivers/input_event.h>
 #include <kernel/drivers/keyboard.h>
 #include <kernel/drivers/ps2_keyboard.h>
 #include <kernel/drivers/ps2_mouse.h>
@@ -56,3 +60,58 @@ uint32_t hardware_abstraction_layer_input_pointer_resynchronization_count(void)
 {
     return personal_system_2_mouse_get_resynchronization_count();
 }
+
+uint32_t hardware_abstraction_layer_input_drain_events(hardware_abstraction_layer_input_event_t *out_events,
+                                                       uint32_t capacity)
+{
+    KernelInputEvent_t batch[32];
+    uint32_t total = 0u;
+
+    if (out_events == NULL)
+        return 0u;
+
+    /* Through a bounded local batch, so the layout the engine sees stays the
+       HAL's own rather than the driver's. */
+    while (total < capacity)
+    {
+        const uint32_t want = capacity - total < 32u ? capacity - total : 32u;
+        const uint32_t got = kernel_input_event_drain(batch, want);
+
+        for (uint32_t index = 0u; index < got; ++index)
+        {
+            hardware_abstraction_layer_input_event_t *event = &out_events[total + index];
+
+            event->timestamp = batch[index].timestamp;
+            event->sequence = batch[index].sequence;
+            event->type = batch[index].type;
+            event->code = batch[index].code;
+            event->flags = batch[index].flags;
+            event->buttons = batch[index].buttons;
+            event->delta_x = batch[index].delta_x;
+            event->delta_y = batch[index].delta_y;
+        }
+        total += got;
+        if (got < want)
+            break;
+    }
+    return total;
+}
+
+bool hardware_abstraction_layer_input_get_latency(hardware_abstraction_layer_input_latency_t *out_latency)
+{
+    KernelInputEventStatistics_t statistics;
+
+    if (out_latency == NULL)
+        return false;
+
+    kernel_input_event_get_statistics(&statistics);
+    out_latency->samples = statistics.samples;
+    out_latency->p50_us = statistics.latency_p50_us;
+    out_latency->p90_us = statistics.latency_p90_us;
+    out_latency->p99_us = statistics.latency_p99_us;
+    out_latency->max_us = statistics.latency_max_us;
+    out_latency->last_us = statistics.latency_last_us;
+    out_latency->last_sequence = statistics.last_sequence;
+    out_latency->dropped_events = statistics.dropped;
+    return statistics.ready;
+}
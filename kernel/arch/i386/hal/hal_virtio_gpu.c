@@ -10,13 +10,30 @@
  *
  * The kernel owns this driver (thin HAL): all renderer/scene logic stays
  * engine-side; the HAL only finds the device and hands back its MMIO window.
+ *
+ * Presenting only moves what changed. Damage marked through
+ * hardware_abstraction_layer_display_mark_damage() is merged into a few
+ * rectangles, each sent as its own TRANSFER_TO_HOST_2D, and the display keeps
+ * two host resources so the engine can draw frame N+1 while frame N's commands
+ * are still queued. Completion is retired from the device interrupt; a present
+ * only waits when the resource it needs is still in flight, and that wait is
+ * what the stall counters measure.
  */
 #include <kernel/hal/hal.h>
 
+#include <kernel/core/lock.h>
+#include <kernel/core/timer.h>
+#include <kernel/cpu/interrupt_vector.h>
+#include <kernel/cpu/irq.h>
+#include <kernel/cpu/isr.h>
+#include <kernel/cpu/msi.h>
 #include <kernel/cpu/paging.h>
 #include <kernel/cpu/pci.h>
+#include <kernel/cpu/pic.h>
+#include <kernel/lib/asmutils.h>
 #include <kernel/memory/pinned_memory.h>
 #include <kernel/memory/vmm.h>
+#include <kernel/power/processor_sleep.h>
 
 #include <string.h>
 
@@ -53,10 +70,12 @@
 #define VIRTIO_PCI_COMMON_DEVICE_FEATURE        0x04u /* le32 */
 #define VIRTIO_PCI_COMMON_DRIVER_FEATURE_SELECT 0x08u /* le32 */
 #define VIRTIO_PCI_COMMON_DRIVER_FEATURE        0x0Cu /* le32 */
+#define VIRTIO_PCI_COMMON_MSIX_CONFIG           0x10u /* le16 */
 #define VIRTIO_PCI_COMMON_NUM_QUEUES            0x12u /* le16 */
 #define VIRTIO_PCI_COMMON_DEVICE_STATUS         0x14u /* u8   */
 #define VIRTIO_PCI_COMMON_QUEUE_SELECT          0x16u /* le16 */
 #define VIRTIO_PCI_COMMON_QUEUE_SIZE            0x18u /* le16 */
+#define VIRTIO_PCI_COMMON_QUEUE_MSIX_VECTOR     0x1Au /* le16 */
 #define VIRTIO_PCI_COMMON_QUEUE_ENABLE          0x1Cu /* le16 */
 #define VIRTIO_PCI_COMMON_QUEUE_NOTIFY_OFF      0x1Eu /* le16 */
 #define VIRTIO_PCI_COMMON_QUEUE_DESC            0x20u /* le64 */
@@ -610,8 +629,9 @@ static uint32_t send_nodata_command(const hardware_abstraction_layer_virtio_gpu_
 }
 
 /* Write a coalesced scatter-gather list of the framebuffer's physical pages into
- * @p entries_va. Returns the entry count, or 0 on failure. Pinned pages are
- * allocated frame-by-frame, so this typically yields one entry per page. */
+ * @p entries_va. Returns the entry count, or 0 on failure. Graphics memory is one
+ * contiguous DMA block when the buddy has one, which coalesces to a single entry;
+ * the pinned fallback is allocated frame-by-frame and yields one entry per page. */
 static uint32_t build_backing_entries(const hardware_abstraction_layer_virtio_gpu_scanout_t *scanout,
                                       uint32_t entries_va, uint32_t max_entries)
 {
@@ -653,9 +673,10 @@ static uint32_t build_backing_entries(const hardware_abstraction_layer_virtio_gp
     return count;
 }
 
-bool hardware_abstraction_layer_virtio_gpu_create_scanout(hardware_abstraction_layer_virtio_virtqueue_t *queue,
-                                                          uint32_t width, uint32_t height,
-                                                          hardware_abstraction_layer_virtio_gpu_scanout_t *out_scanout)
+/* Create host resource @p resource_id, back it and bind it to the scanout. */
+static bool create_scanout_resource(hardware_abstraction_layer_virtio_virtqueue_t *queue, uint32_t resource_id,
+                                    uint32_t width, uint32_t height,
+                                    hardware_abstraction_layer_virtio_gpu_scanout_t *out_scanout)
 {
     if (queue == (void *) 0 || out_scanout == (void *) 0 || !queue->ready || width == 0u || height == 0u)
         return false;
@@ -664,12 +685,13 @@ bool hardware_abstraction_layer_virtio_gpu_create_scanout(hardware_abstraction_l
     out_scanout->queue = queue;
     out_scanout->width = width;
     out_scanout->height = height;
-    out_scanout->resource_id = VIRTIO_GPU_SCANOUT_RESOURCE_ID;
+    out_scanout->resource_id = resource_id;
     out_scanout->scanout_id = VIRTIO_GPU_SCANOUT_ID;
     out_scanout->framebuffer_size = width * height * 4u;
 
     out_scanout->command_buffer = kernel_pinned_alloc(4096u);
-    out_scanout->framebuffer = (uint32_t *) kernel_pinned_alloc(out_scanout->framebuffer_size);
+    out_scanout->framebuffer =
+        (uint32_t *) hardware_abstraction_layer_graphics_memory_allocate(out_scanout->framebuffer_size);
     if (out_scanout->command_buffer == (void *) 0 || out_scanout->framebuffer == (void *) 0)
         goto fail;
 
@@ -749,58 +771,638 @@ bool hardware_abstraction_layer_virtio_gpu_create_scanout(hardware_abstraction_l
 
 fail:
     if (out_scanout->framebuffer != (void *) 0)
-        kernel_pinned_free(out_scanout->framebuffer, out_scanout->framebuffer_size);
+        hardware_abstraction_layer_graphics_memory_free(out_scanout->framebuffer, out_scanout->framebuffer_size);
     if (out_scanout->command_buffer != (void *) 0)
         kernel_pinned_free(out_scanout->command_buffer, 4096u);
     *out_scanout = (hardware_abstraction_layer_virtio_gpu_scanout_t){0};
     return false;
 }
 
-bool hardware_abstraction_layer_virtio_gpu_flush(hardware_abstraction_layer_virtio_gpu_scanout_t *scanout)
+bool hardware_abstraction_layer_virtio_gpu_create_scanout(hardware_abstraction_layer_virtio_virtqueue_t *queue,
+                                                          uint32_t width, uint32_t height,
+                                                          hardware_abstraction_layer_virtio_gpu_scanout_t *out_scanout)
 {
-    if (scanout == (void *) 0 || !scanout->ready)
-        return false;
+    return create_scanout_resource(queue, VIRTIO_GPU_SCANOUT_RESOURCE_ID, width, height, out_scanout);
+}
 
-    const uint32_t cmd_va = (uint32_t) scanout->command_buffer;
+/* Request sizes of the present commands (header + rect + command fields). */
+#define VIRTIO_GPU_TRANSFER_REQUEST_BYTES 56u
+#define VIRTIO_GPU_FLUSH_REQUEST_BYTES    48u
+#define VIRTIO_GPU_SCANOUT_REQUEST_BYTES  48u
 
-    /* 4. TRANSFER_TO_HOST_2D (push the whole surface to the host resource). */
-    write_command_rect(cmd_va, VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D, 0u, 0u, scanout->width, scanout->height);
-    write64(cmd_va + 40u, 0u); /* offset      */
+/* TRANSFER_TO_HOST_2D of @p rect: the offset is where the rectangle's first
+ * pixel sits in the guest backing, whose pitch is the surface width. */
+static void write_transfer_command(uint32_t cmd_va, const hardware_abstraction_layer_virtio_gpu_scanout_t *scanout,
+                                   const hardware_abstraction_layer_display_rect_t *rect)
+{
+    write_command_rect(cmd_va, VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D, rect->x, rect->y, rect->width, rect->height);
+    write64(cmd_va + 40u, (rect->y * scanout->width + rect->x) * 4u); /* offset */
     ring_write32(cmd_va + 48u, scanout->resource_id);
     ring_write32(cmd_va + 52u, 0u); /* padding     */
-    if (send_nodata_command(scanout, 56u, 0u, (void *) 0) != VIRTIO_GPU_RESP_OK_NODATA)
-        return false;
+}
 
-    /* 5. RESOURCE_FLUSH (present the transferred contents). */
-    write_command_rect(cmd_va, VIRTIO_GPU_CMD_RESOURCE_FLUSH, 0u, 0u, scanout->width, scanout->height);
+static void write_resource_flush_command(uint32_t cmd_va, const hardware_abstraction_layer_virtio_gpu_scanout_t *scanout,
+                                         const hardware_abstraction_layer_display_rect_t *rect)
+{
+    write_command_rect(cmd_va, VIRTIO_GPU_CMD_RESOURCE_FLUSH, rect->x, rect->y, rect->width, rect->height);
     ring_write32(cmd_va + 40u, scanout->resource_id);
     ring_write32(cmd_va + 44u, 0u); /* padding     */
-    return send_nodata_command(scanout, 48u, 0u, (void *) 0) == VIRTIO_GPU_RESP_OK_NODATA;
 }
 
-/* ----------------------------------------------------------------------------
- * Persistent display routing — drives hardware_abstraction_layer_display_* when a scanout is live
- * ------------------------------------------------------------------------- */
+static void write_set_scanout_command(uint32_t cmd_va, const hardware_abstraction_layer_virtio_gpu_scanout_t *scanout)
+{
+    write_command_rect(cmd_va, VIRTIO_GPU_CMD_SET_SCANOUT, 0u, 0u, scanout->width, scanout->height);
+    ring_write32(cmd_va + 40u, scanout->scanout_id);
+    ring_write32(cmd_va + 44u, scanout->resource_id);
+}
+
+static bool rect_inside(const hardware_abstraction_layer_virtio_gpu_scanout_t *scanout,
+                        const hardware_abstraction_layer_display_rect_t *rect)
+{
+    return rect->width != 0u && rect->height != 0u && rect->x < scanout->width && rect->y < scanout->height &&
+           rect->width <= scanout->width - rect->x && rect->height <= scanout->height - rect->y;
+}
+
+static hardware_abstraction_layer_display_rect_t rect_union(const hardware_abstraction_layer_display_rect_t *a,
+                                                            const hardware_abstraction_layer_display_rect_t *b)
+{
+    const uint32_t left = (a->x < b->x) ? a->x : b->x;
+    const uint32_t top = (a->y < b->y) ? a->y : b->y;
+    const uint32_t right = (a->x + a->width > b->x + b->width) ? a->x + a->width : b->x + b->width;
+    const uint32_t bottom = (a->y + a->height > b->y + b->height) ? a->y + a->height : b->y + b->height;
+    return (hardware_abstraction_layer_display_rect_t){left, top, right - left, bottom - top};
+}
+
+static hardware_abstraction_layer_display_rect_t rect_bounds(const hardware_abstraction_layer_display_rect_t *rects,
+                                                             uint32_t count)
+{
+    hardware_abstraction_layer_display_rect_t bounds = rects[0];
+    for (uint32_t i = 1u; i < count; ++i)
+        bounds = rect_union(&bounds, &rects[i]);
+    return bounds;
+}
+
+bool hardware_abstraction_layer_virtio_gpu_flush_rects(hardware_abstraction_layer_virtio_gpu_scanout_t *scanout,
+                                                       const hardware_abstraction_layer_display_rect_t *rects,
+                                                       uint32_t count)
+{
+    if (scanout == (void *) 0 || !scanout->ready || rects == (void *) 0 || count == 0u)
+        return false;
+    for (uint32_t i = 0u; i < count; ++i)
+        if (!rect_inside(scanout, &rects[i]))
+            return false;
+
+    const uint32_t cmd_va = (uint32_t) scanout->command_buffer;
+
+    /* 4. TRANSFER_TO_HOST_2D, one per damaged rectangle. */
+    for (uint32_t i = 0u; i < count; ++i)
+    {
+        write_transfer_command(cmd_va, scanout, &rects[i]);
+        if (send_nodata_command(scanout, VIRTIO_GPU_TRANSFER_REQUEST_BYTES, 0u, (void *) 0) !=
+            VIRTIO_GPU_RESP_OK_NODATA)
+            return false;
+    }
+
+    /* 5. RESOURCE_FLUSH of the area they cover (present the transferred contents). */
+    const hardware_abstraction_layer_display_rect_t bounds = rect_bounds(rects, count);
+    write_resource_flush_command(cmd_va, scanout, &bounds);
+    return send_nodata_command(scanout, VIRTIO_GPU_FLUSH_REQUEST_BYTES, 0u, (void *) 0) == VIRTIO_GPU_RESP_OK_NODATA;
+}
+
+bool hardware_abstraction_layer_virtio_gpu_flush(hardware_abstraction_layer_virtio_gpu_scanout_t *scanout)
+{
+    if (scanout == (void *) 0 || !scanout->ready)
+        return false;
+
+    const hardware_abstraction_layer_display_rect_t whole = {0u, 0u, scanout->width, scanout->height};
+    return hardware_abstraction_layer_virtio_gpu_flush_rects(scanout, &whole, 1u);
+}
 
 /* Default geometry when the device reports no preferred mode. */
 #define VIRTIO_GPU_DEFAULT_WIDTH  1024u
 #define VIRTIO_GPU_DEFAULT_HEIGHT 768u
 
+/* The second host resource of the double-buffered presenter. */
+#define VIRTIO_GPU_BACK_RESOURCE_ID 2u
+
+/* Damage kept per resource. Past this many rectangles the cheapest pair is
+ * merged, and once they cover this share of the surface a single full-surface
+ * transfer replaces them: per-command overhead beats the few bytes saved. */
+#define VIRTIO_GPU_PRESENT_BUFFERS         2u
+#define VIRTIO_GPU_DAMAGE_RECTS            8u
+#define VIRTIO_GPU_DAMAGE_COLLAPSE_PERCENT 75u
+
+/* A present is one TRANSFER per rectangle, SET_SCANOUT (the flip) and
+ * RESOURCE_FLUSH. Each command owns a 128-byte slot of its resource's command
+ * page, request first and response at +64, and two descriptors at a fixed
+ * place in the table: past the range submit_chain() uses, one block per
+ * resource, so nothing is allocated on the present path. */
+#define VIRTIO_GPU_PRESENT_MAX_COMMANDS    (VIRTIO_GPU_DAMAGE_RECTS + 2u)
+#define VIRTIO_GPU_PRESENT_SLOT_BYTES      128u
+#define VIRTIO_GPU_PRESENT_RESPONSE_OFFSET 64u
+#define VIRTIO_GPU_PRESENT_DESCRIPTOR_BASE VIRTIO_GPU_MAX_CHAIN_SEGMENTS
+#define VIRTIO_GPU_PRESENT_DESCRIPTORS     (2u * VIRTIO_GPU_PRESENT_MAX_COMMANDS)
+#define VIRTIO_GPU_PRESENT_MIN_QUEUE_SIZE                                                                              \
+    (VIRTIO_GPU_PRESENT_DESCRIPTOR_BASE + VIRTIO_GPU_PRESENT_BUFFERS * VIRTIO_GPU_PRESENT_DESCRIPTORS)
+
+/* Legacy INTx completion. Reading the ISR status byte acknowledges it. */
+#define VIRTIO_GPU_ISR_QUEUE_INTERRUPT 0x01u
+#define VIRTIO_GPU_NO_INTERRUPT_LINE   0xFFu
+
+/* MSI-X completion: table entry 0 for the control queue, nothing for config changes. */
+#define VIRTIO_GPU_MSIX_CONTROLQ_ENTRY 0u
+#define VIRTIO_MSI_NO_VECTOR           0xFFFFu
+
+/* Wake-ups a blocked present waits through before giving the frame up. */
+#define VIRTIO_GPU_WAIT_SLEEP_LIMIT 1000u
+
+#define EFLAGS_INTERRUPT_ENABLE 0x200u
+
+typedef struct {
+    hardware_abstraction_layer_display_rect_t rects[VIRTIO_GPU_DAMAGE_RECTS];
+    uint32_t count;
+} virtio_gpu_damage_t;
+
+/* One host resource of the presenter, with the damage it has not received yet
+ * and the commands of its last present. */
+typedef struct {
+    hardware_abstraction_layer_virtio_gpu_scanout_t scanout;
+    virtio_gpu_damage_t damage;
+    void *commands;
+    uint32_t commands_physical;
+    volatile uint32_t in_flight; /* commands the device has not returned yet */
+    uint32_t submitted;          /* commands of the last present            */
+    uint64_t submitted_at;       /* TSC at the doorbell of the last present */
+} virtio_gpu_present_buffer_t;
+
+static hardware_abstraction_layer_virtio_gpu_info_t g_info;
 static hardware_abstraction_layer_virtio_gpu_mapping_t g_mapping;
 static hardware_abstraction_layer_virtio_gpu_device_t g_device;
 static hardware_abstraction_layer_virtio_virtqueue_t g_controlq;
-static hardware_abstraction_layer_virtio_gpu_scanout_t g_scanout;
+static virtio_gpu_present_buffer_t g_buffers[VIRTIO_GPU_PRESENT_BUFFERS];
+static uint32_t g_buffer_count = 0u;
+static uint32_t g_next_buffer = 0u;
+static uint32_t *g_draw_surface; /* what the engine draws into */
+static bool g_frame_damaged = false;
+static uint8_t g_interrupt_line = VIRTIO_GPU_NO_INTERRUPT_LINE;
+static uint8_t g_interrupt_vector = INTERRUPT_VECTOR_NONE;
+static MessageSignaledInterruptFunction_t *g_message_function;
+static uint32_t g_isr_status_address = 0u;
+static KernelTicketLock_t g_queue_lock;
+static hardware_abstraction_layer_display_present_statistics_t g_statistics;
 static bool g_display_ready = false;
 
+/* ----------------------------------------------------------------------------
+ * Damage tracking
+ * ------------------------------------------------------------------------- */
+
+static uint32_t rect_area(const hardware_abstraction_layer_display_rect_t *rect)
+{
+    return rect->width * rect->height;
+}
+
+/* Overlapping or edge-adjacent: merging them costs no extra pixels. */
+static bool rects_touch(const hardware_abstraction_layer_display_rect_t *a,
+                        const hardware_abstraction_layer_display_rect_t *b)
+{
+    return a->x <= b->x + b->width && b->x <= a->x + a->width && a->y <= b->y + b->height &&
+           b->y <= a->y + a->height;
+}
+
+/* The rectangle whose bounding box grows least by absorbing @p rect. */
+static uint32_t damage_cheapest_merge(const virtio_gpu_damage_t *damage,
+                                      const hardware_abstraction_layer_display_rect_t *rect)
+{
+    uint32_t best = 0u;
+    uint32_t best_growth = 0xFFFFFFFFu;
+    for (uint32_t i = 0u; i < damage->count; ++i)
+    {
+        const hardware_abstraction_layer_display_rect_t merged = rect_union(&damage->rects[i], rect);
+        const uint32_t growth = rect_area(&merged) - rect_area(&damage->rects[i]);
+        if (growth < best_growth)
+        {
+            best = i;
+            best_growth = growth;
+        }
+    }
+    return best;
+}
+
+static void damage_add(virtio_gpu_damage_t *damage, hardware_abstraction_layer_display_rect_t rect,
+                       uint32_t surface_width, uint32_t surface_height)
+{
+    /* Absorb every rectangle the new one touches, then, if the list is full,
+       the one that costs least; each absorption shrinks the list, so it ends. */
+    for (;;)
+    {
+        uint32_t index = damage->count;
+        for (uint32_t i = 0u; i < damage->count; ++i)
+        {
+            if (rects_touch(&damage->rects[i], &rect))
+            {
+                index = i;
+                break;
+            }
+        }
+        if (index == damage->count && damage->count == VIRTIO_GPU_DAMAGE_RECTS)
+            index = damage_cheapest_merge(damage, &rect);
+        if (index == damage->count)
+            break;
+        rect = rect_union(&damage->rects[index], &rect);
+        damage->rects[index] = damage->rects[--damage->count];
+    }
+    damage->rects[damage->count++] = rect;
+
+    uint32_t covered = 0u;
+    for (uint32_t i = 0u; i < damage->count; ++i)
+        covered += rect_area(&damage->rects[i]);
+    if ((uint64_t) covered * 100u >= (uint64_t) surface_width * surface_height * VIRTIO_GPU_DAMAGE_COLLAPSE_PERCENT)
+    {
+        damage->rects[0] = (hardware_abstraction_layer_display_rect_t){0u, 0u, surface_width, surface_height};
+        damage->count = 1u;
+    }
+}
+
+/* Every resource has to catch up on a change, not only the next one shown. */
+static void damage_add_all(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    const uint32_t surface_width = g_buffers[0].scanout.width;
+    const uint32_t surface_height = g_buffers[0].scanout.height;
+    if (width == 0u || height == 0u || x >= surface_width || y >= surface_height)
+        return;
+    if (width > surface_width - x)
+        width = surface_width - x;
+    if (height > surface_height - y)
+        height = surface_height - y;
+
+    const hardware_abstraction_layer_display_rect_t rect = {x, y, width, height};
+    for (uint32_t i = 0u; i < g_buffer_count; ++i)
+        damage_add(&g_buffers[i].damage, rect, surface_width, surface_height);
+    g_frame_damaged = true;
+}
+
+/* ----------------------------------------------------------------------------
+ * Asynchronous submission and completion
+ * ------------------------------------------------------------------------- */
+
+static bool interrupts_enabled(void)
+{
+    uint32_t flags;
+    __asm__ volatile("pushfl\n\tpopl %0" : "=r"(flags)::"memory");
+    return (flags & EFLAGS_INTERRUPT_ENABLE) != 0u;
+}
+
+/* A resource's commands all came back: count the ones the device refused. */
+static void check_present_responses(const virtio_gpu_present_buffer_t *buffer)
+{
+    const uint32_t commands_va = (uint32_t) buffer->commands;
+    for (uint32_t i = 0u; i < buffer->submitted; ++i)
+    {
+        const uint32_t response =
+            ring_read32(commands_va + i * VIRTIO_GPU_PRESENT_SLOT_BYTES + VIRTIO_GPU_PRESENT_RESPONSE_OFFSET);
+        if (response != VIRTIO_GPU_RESP_OK_NODATA)
+            ++g_statistics.errors;
+    }
+}
+
+/* Walk the used ring and retire every finished present command. Called from
+ * the interrupt handlers and from a present waiting on a busy resource; the
+ * message handler passes its vector, and each present it retires is a
+ * doorbell-to-interrupt latency sample for it. */
+static uint32_t reap_completions(uint8_t vector)
+{
+    hardware_abstraction_layer_virtio_virtqueue_t *queue = &g_controlq;
+    uint32_t retired = 0u;
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&g_queue_lock);
+    const uint16_t used_index = ring_read16(queue->used_address + 2u);
+    while (queue->last_used_index != used_index)
+    {
+        __sync_synchronize();
+        const uint32_t element = queue->used_address + 4u + (uint32_t) (queue->last_used_index % queue->queue_size) * 8u;
+        const uint32_t head = ring_read32(element);
+        queue->last_used_index = (uint16_t) (queue->last_used_index + 1u);
+
+        if (head < VIRTIO_GPU_PRESENT_DESCRIPTOR_BASE)
+            continue;
+        const uint32_t index = (head - VIRTIO_GPU_PRESENT_DESCRIPTOR_BASE) / VIRTIO_GPU_PRESENT_DESCRIPTORS;
+        if (index >= g_buffer_count || g_buffers[index].in_flight == 0u)
+            continue;
+        if (--g_buffers[index].in_flight == 0u)
+        {
+            check_present_responses(&g_buffers[index]);
+            if (vector != INTERRUPT_VECTOR_NONE)
+                interrupt_vector_record_latency(vector, kernel_timer_cycles_to_microseconds(
+                                                            asmutils_read_timestamp_counter() -
+                                                            g_buffers[index].submitted_at));
+        }
+        ++retired;
+    }
+    kernel_ticket_lock_release_irqrestore(&g_queue_lock, flags);
+    return retired;
+}
+
+static void virtio_gpu_interrupt_handler(const InterruptFrame_t *frame)
+{
+    (void) frame;
+
+    /* The read is the acknowledgement: it clears the status and drops INTx. */
+    const uint8_t status = mmio_read8(g_isr_status_address);
+    if ((status & VIRTIO_GPU_ISR_QUEUE_INTERRUPT) != 0u && reap_completions(INTERRUPT_VECTOR_NONE) != 0u)
+        ++g_statistics.completion_interrupts;
+
+    if (interrupt_request_is_line_owner_apic(g_interrupt_line))
+        advanced_pic_timer_backend_signal_end_of_interrupt();
+    else
+        programmable_interrupt_controller_send_end_of_interrupt(g_interrupt_line);
+}
+
+/* The control queue's MSI-X message. Nothing to acknowledge at the device: a
+ * message is not a level, and the vector's dispatcher sends the EOI. */
+static void virtio_gpu_message_handler(uint8_t vector, void *context)
+{
+    (void) context;
+
+    if (reap_completions(vector) != 0u)
+        ++g_statistics.completion_interrupts;
+}
+
+/* Point the control queue at MSI-X entry 0. The device answers a vector it
+ * cannot use by reading back NO_VECTOR, and then it would raise nothing at
+ * all, so that read decides whether messages stay on. */
+static bool install_completion_message(void)
+{
+    g_message_function = message_signaled_interrupt_enable(g_info.bus, g_info.device, g_info.function, "virtio-gpu",
+                                                           1u, virtio_gpu_message_handler, (void *) 0, 0u);
+    if (g_message_function == (void *) 0)
+        return false;
+
+    const uint32_t common = g_device.common_cfg_address;
+    uint16_t granted = VIRTIO_MSI_NO_VECTOR;
+    if (message_signaled_interrupt_get_mode(g_message_function) == MESSAGE_SIGNALED_INTERRUPT_MODE_MSIX)
+    {
+        const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&g_queue_lock);
+        mmio_write16(common + VIRTIO_PCI_COMMON_MSIX_CONFIG, VIRTIO_MSI_NO_VECTOR);
+        mmio_write16(common + VIRTIO_PCI_COMMON_QUEUE_SELECT, g_controlq.queue_index);
+        mmio_write16(common + VIRTIO_PCI_COMMON_QUEUE_MSIX_VECTOR, VIRTIO_GPU_MSIX_CONTROLQ_ENTRY);
+        granted = mmio_read16(common + VIRTIO_PCI_COMMON_QUEUE_MSIX_VECTOR);
+        kernel_ticket_lock_release_irqrestore(&g_queue_lock, flags);
+    }
+
+    if (granted != VIRTIO_GPU_MSIX_CONTROLQ_ENTRY)
+    {
+        message_signaled_interrupt_disable(g_message_function);
+        g_message_function = (void *) 0;
+        return false;
+    }
+
+    g_interrupt_vector = message_signaled_interrupt_get_vector(g_message_function, 0u);
+    return true;
+}
+
+/* Take the control queue's MSI-X message when the function has one; otherwise
+ * the function's legacy interrupt line if it is a free 8259 line. A line the
+ * IOAPIC alone can deliver, or one another driver holds, leaves the presenter
+ * polling. */
+static void install_completion_interrupt(void)
+{
+    if (install_completion_message())
+        return;
+    if (!g_mapping.isr.present)
+        return;
+
+    const uint8_t line =
+        peripheral_component_interconnect_config_read_byte(g_info.bus, g_info.device, g_info.function,
+                                                           PERIPHERAL_COMPONENT_INTERCONNECT_REGISTER_INTERRUPT_LINE);
+    if (line == 0u || line >= 16u || line == 2u)
+        return;
+    const uint8_t vector =
+        (uint8_t) ((line < 8u) ? PIC_VECTOR_OFFSET_MASTER + line : PIC_VECTOR_OFFSET_SLAVE + (line - 8u));
+    if (interrupt_service_routine_get_handler(vector) != (void *) 0)
+        return;
+
+    const uint16_t command = peripheral_component_interconnect_config_read_word(
+        g_info.bus, g_info.device, g_info.function, PERIPHERAL_COMPONENT_INTERCONNECT_REGISTER_COMMAND);
+    const uint16_t disable = PERIPHERAL_COMPONENT_INTERCONNECT_COMMAND_INTERRUPT_DISABLE;
+    if ((command & disable) != 0u)
+        peripheral_component_interconnect_config_write_word(g_info.bus, g_info.device, g_info.function,
+                                                            PERIPHERAL_COMPONENT_INTERCONNECT_REGISTER_COMMAND,
+                                                            (uint16_t) (command & ~disable));
+
+    /* Bring-up completed its commands by polling and left the status raised. */
+    g_isr_status_address = g_mapping.mmio_virtual_base + g_mapping.isr.offset;
+    (void) mmio_read8(g_isr_status_address);
+
+    g_interrupt_line = line;
+    interrupt_service_routine_register_handler(vector, virtio_gpu_interrupt_handler);
+    if (line >= 8u)
+        programmable_interrupt_controller_clear_mask(2u);
+    programmable_interrupt_controller_clear_mask(line);
+}
+
+/* Block until @p buffer's previous present has been retired. Sleeps when the
+ * interrupt can end the sleep and polls the used ring otherwise; either way
+ * the ring is reaped on every wake, so a lost interrupt costs one timer tick
+ * rather than the frame. */
+static bool wait_for_buffer(virtio_gpu_present_buffer_t *buffer)
+{
+    const bool can_sleep =
+        (g_interrupt_line != VIRTIO_GPU_NO_INTERRUPT_LINE || g_interrupt_vector != INTERRUPT_VECTOR_NONE) &&
+        interrupts_enabled();
+    const uint32_t limit = can_sleep ? VIRTIO_GPU_WAIT_SLEEP_LIMIT : VIRTIO_GPU_POLL_LIMIT;
+
+    for (uint32_t attempt = 0u; buffer->in_flight != 0u; ++attempt)
+    {
+        if (attempt >= limit)
+            return false;
+        if (can_sleep)
+            (void) processor_sleep_until_write(&buffer->in_flight, buffer->in_flight);
+        (void) reap_completions(INTERRUPT_VECTOR_NONE);
+    }
+    return true;
+}
+
+/* Publish @p count prepared commands of buffer @p index and ring the doorbell
+ * without waiting. */
+static void submit_present(uint32_t index, const uint32_t *request_lengths, uint32_t count)
+{
+    virtio_gpu_present_buffer_t *buffer = &g_buffers[index];
+    hardware_abstraction_layer_virtio_virtqueue_t *queue = buffer->scanout.queue;
+    const uint16_t base = (uint16_t) (VIRTIO_GPU_PRESENT_DESCRIPTOR_BASE + index * VIRTIO_GPU_PRESENT_DESCRIPTORS);
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&g_queue_lock);
+    buffer->in_flight = count;
+    buffer->submitted = count;
+
+    const uint16_t avail_idx = ring_read16(queue->avail_address + 2u);
+    for (uint32_t i = 0u; i < count; ++i)
+    {
+        const uint16_t head = (uint16_t) (base + 2u * i);
+        const uint32_t slot_physical = buffer->commands_physical + i * VIRTIO_GPU_PRESENT_SLOT_BYTES;
+        write_descriptor(queue, head, slot_physical, request_lengths[i], VIRTQ_DESC_F_NEXT, (uint16_t) (head + 1u));
+        write_descriptor(queue, (uint16_t) (head + 1u), slot_physical + VIRTIO_GPU_PRESENT_RESPONSE_OFFSET,
+                         VIRTIO_GPU_CTRL_HDR_BYTES, VIRTQ_DESC_F_WRITE, 0u);
+        ring_write16(queue->avail_address + 4u + (uint32_t) ((avail_idx + i) % queue->queue_size) * 2u, head);
+    }
+    __sync_synchronize();
+    ring_write16(queue->avail_address + 2u, (uint16_t) (avail_idx + count));
+    __sync_synchronize();
+    buffer->submitted_at = asmutils_read_timestamp_counter();
+    mmio_write16(queue->notify_address, queue->queue_index);
+
+    kernel_ticket_lock_release_irqrestore(&g_queue_lock, flags);
+}
+
+/* Copy @p buffer's pending damage from the draw surface into its backing. */
+static void copy_damage(virtio_gpu_present_buffer_t *buffer)
+{
+    const uint32_t pitch = buffer->scanout.width;
+    for (uint32_t i = 0u; i < buffer->damage.count; ++i)
+    {
+        const hardware_abstraction_layer_display_rect_t *rect = &buffer->damage.rects[i];
+        for (uint32_t row = rect->y; row < rect->y + rect->height; ++row)
+            memcpy(&buffer->scanout.framebuffer[row * pitch + rect->x], &g_draw_surface[row * pitch + rect->x],
+                   rect->width * 4u);
+    }
+}
+
+static uint32_t damage_bytes(const virtio_gpu_damage_t *damage)
+{
+    uint32_t bytes = 0u;
+    for (uint32_t i = 0u; i < damage->count; ++i)
+        bytes += rect_area(&damage->rects[i]) * 4u;
+    return bytes;
+}
+
+static void account_present(uint32_t rects, uint32_t bytes, uint64_t stall)
+{
+    const uint32_t stall_cycles = (stall > 0xFFFFFFFFull) ? 0xFFFFFFFFu : (uint32_t) stall;
+    ++g_statistics.presents;
+    g_statistics.rects_last = rects;
+    g_statistics.bytes_last = bytes;
+    g_statistics.bytes_total += bytes;
+    g_statistics.stall_cycles_last = stall_cycles;
+    g_statistics.stall_cycles_total += stall;
+    if (stall_cycles > g_statistics.stall_cycles_max)
+        g_statistics.stall_cycles_max = stall_cycles;
+    if (stall != 0u)
+        ++g_statistics.stalled_presents;
+}
+
+/* Single resource: the surface is the backing, so transfer and wait. */
+static void present_synchronous(void)
+{
+    virtio_gpu_present_buffer_t *buffer = &g_buffers[0];
+    const uint32_t rects = buffer->damage.count;
+    const uint32_t bytes = damage_bytes(&buffer->damage);
+
+    const uint64_t start = asmutils_read_timestamp_counter();
+    if (!hardware_abstraction_layer_virtio_gpu_flush_rects(&buffer->scanout, buffer->damage.rects, rects))
+        ++g_statistics.errors;
+    account_present(rects, bytes, asmutils_read_timestamp_counter() - start);
+    buffer->damage.count = 0u;
+}
+
+static void present_double_buffered(void)
+{
+    const uint32_t index = g_next_buffer;
+    virtio_gpu_present_buffer_t *buffer = &g_buffers[index];
+
+    uint64_t stall = 0u;
+    if (buffer->in_flight != 0u)
+    {
+        const uint64_t start = asmutils_read_timestamp_counter();
+        const bool idle = wait_for_buffer(buffer);
+        stall = asmutils_read_timestamp_counter() - start;
+        if (!idle)
+        {
+            /* Still the device's: keep the damage and try again next frame. */
+            ++g_statistics.errors;
+            account_present(0u, 0u, stall);
+            return;
+        }
+    }
+
+    copy_damage(buffer);
+
+    const uint32_t commands_va = (uint32_t) buffer->commands;
+    uint32_t request_lengths[VIRTIO_GPU_PRESENT_MAX_COMMANDS];
+    uint32_t count = 0u;
+    for (uint32_t i = 0u; i < buffer->damage.count; ++i)
+    {
+        write_transfer_command(commands_va + count * VIRTIO_GPU_PRESENT_SLOT_BYTES, &buffer->scanout,
+                               &buffer->damage.rects[i]);
+        request_lengths[count++] = VIRTIO_GPU_TRANSFER_REQUEST_BYTES;
+    }
+    write_set_scanout_command(commands_va + count * VIRTIO_GPU_PRESENT_SLOT_BYTES, &buffer->scanout);
+    request_lengths[count++] = VIRTIO_GPU_SCANOUT_REQUEST_BYTES;
+    const hardware_abstraction_layer_display_rect_t bounds = rect_bounds(buffer->damage.rects, buffer->damage.count);
+    write_resource_flush_command(commands_va + count * VIRTIO_GPU_PRESENT_SLOT_BYTES, &buffer->scanout, &bounds);
+    request_lengths[count++] = VIRTIO_GPU_FLUSH_REQUEST_BYTES;
+
+    for (uint32_t i = 0u; i < count; ++i)
+        ring_write32(commands_va + i * VIRTIO_GPU_PRESENT_SLOT_BYTES + VIRTIO_GPU_PRESENT_RESPONSE_OFFSET, 0u);
+
+    account_present(buffer->damage.count, damage_bytes(&buffer->damage), stall);
+    buffer->damage.count = 0u;
+    submit_present(index, request_lengths, count);
+    g_next_buffer = (index + 1u) % g_buffer_count;
+}
+
+/* ----------------------------------------------------------------------------
+ * Persistent display routing — drives hardware_abstraction_layer_display_* when a scanout is live
+ * ------------------------------------------------------------------------- */
+
+/* Add the second resource, a separate draw surface and the command pages.
+ * Anything missing leaves the presenter synchronous on resource 1. */
+static bool setup_double_buffering(uint32_t width, uint32_t height)
+{
+    if (g_controlq.queue_size < VIRTIO_GPU_PRESENT_MIN_QUEUE_SIZE)
+        return false;
+
+    const uint32_t surface_size = width * height * 4u;
+    uint32_t *draw_surface = (uint32_t *) kernel_pinned_alloc(surface_size);
+    if (draw_surface == (void *) 0)
+        return false;
+
+    for (uint32_t i = 0u; i < VIRTIO_GPU_PRESENT_BUFFERS; ++i)
+    {
+        g_buffers[i].commands = kernel_pinned_alloc(4096u);
+        if (g_buffers[i].commands == (void *) 0 ||
+            !hardware_abstraction_layer_graphics_memory_physical_address(g_buffers[i].commands,
+                                                                         &g_buffers[i].commands_physical))
+            goto fail;
+        memset(g_buffers[i].commands, 0, 4096u);
+    }
+
+    if (!create_scanout_resource(&g_controlq, VIRTIO_GPU_BACK_RESOURCE_ID, width, height, &g_buffers[1].scanout))
+        goto fail;
+
+    /* The draw surface picks up what resource 1 shows now: both start black. */
+    memset(draw_surface, 0, surface_size);
+    g_draw_surface = draw_surface;
+    g_buffer_count = VIRTIO_GPU_PRESENT_BUFFERS;
+    return true;
+
+fail:
+    for (uint32_t i = 0u; i < VIRTIO_GPU_PRESENT_BUFFERS; ++i)
+    {
+        if (g_buffers[i].commands != (void *) 0)
+            kernel_pinned_free(g_buffers[i].commands, 4096u);
+        g_buffers[i].commands = (void *) 0;
+    }
+    kernel_pinned_free(draw_surface, surface_size);
+    return false;
+}
+
 bool hardware_abstraction_layer_virtio_gpu_display_init(void)
 {
     if (g_display_ready)
         return true;
 
-    hardware_abstraction_layer_virtio_gpu_info_t info;
-    if (!hardware_abstraction_layer_virtio_gpu_probe(&info))
+    if (!hardware_abstraction_layer_virtio_gpu_probe(&g_info))
         return false;
-    if (!hardware_abstraction_layer_virtio_gpu_map(&info, &g_mapping))
+    if (!hardware_abstraction_layer_virtio_gpu_map(&g_info, &g_mapping))
         return false;
     if (!hardware_abstraction_layer_virtio_gpu_bringup(&g_mapping, &g_device))
         return false;
@@ -820,9 +1422,24 @@ bool hardware_abstraction_layer_virtio_gpu_display_init(void)
         height = display.height;
     }
 
-    if (!hardware_abstraction_layer_virtio_gpu_create_scanout(&g_controlq, width, height, &g_scanout))
+    if (!hardware_abstraction_layer_virtio_gpu_create_scanout(&g_controlq, width, height, &g_buffers[0].scanout))
         return false;
 
+    kernel_ticket_lock_initialize(&g_queue_lock, (void *) 0);
+    g_statistics = (hardware_abstraction_layer_display_present_statistics_t){0};
+    g_next_buffer = 0u;
+    g_frame_damaged = false;
+
+    /* Everything above completed synchronously; from here on only the
+       presenter submits, so the used ring is its own. */
+    if (setup_double_buffering(width, height))
+        install_completion_interrupt();
+    else
+    {
+        g_draw_surface = g_buffers[0].scanout.framebuffer;
+        g_buffer_count = 1u;
+    }
+
     g_display_ready = true;
     return true;
 }
@@ -835,11 +1452,11 @@ bool hardware_abstraction_layer_virtio_gpu_display_query(
     if (out_descriptor == (void *) 0 || !g_display_ready)
         return false;
 
-    out_descriptor->buffer = g_scanout.framebuffer;
+    out_descriptor->buffer = g_draw_surface;
     out_descriptor->physical_address = 0u; /* scatter-gather backed; no single base */
-    out_descriptor->width = g_scanout.width;
-    out_descriptor->height = g_scanout.height;
-    out_descriptor->pitch = g_scanout.width * 4u;
+    out_descriptor->width = g_buffers[0].scanout.width;
+    out_descriptor->height = g_buffers[0].scanout.height;
+    out_descriptor->pitch = g_buffers[0].scanout.width * 4u;
     out_descriptor->bits_per_pixel = 32u;
     return true;
 }
@@ -849,20 +1466,51 @@ void hardware_abstraction_layer_virtio_gpu_display_clear(uint32_t color_rgb)
     if (!g_display_ready)
         return;
     /* BGRX surface: a packed 0x00RRGGBB value maps directly. */
-    const uint32_t pixels = g_scanout.width * g_scanout.height;
+    const uint32_t pixels = g_buffers[0].scanout.width * g_buffers[0].scanout.height;
     for (uint32_t i = 0u; i < pixels; ++i)
-        g_scanout.framebuffer[i] = color_rgb;
+        g_draw_surface[i] = color_rgb;
+    damage_add_all(0u, 0u, g_buffers[0].scanout.width, g_buffers[0].scanout.height);
 }
 
 uint32_t hardware_abstraction_layer_virtio_gpu_display_read_pixel(uint32_t x, uint32_t y)
 {
-    if (!g_display_ready || x >= g_scanout.width || y >= g_scanout.height)
+    if (!g_display_ready || x >= g_buffers[0].scanout.width || y >= g_buffers[0].scanout.height)
         return 0u;
-    return g_scanout.framebuffer[y * g_scanout.width + x] & 0x00FFFFFFu;
+    return g_draw_surface[y * g_buffers[0].scanout.width + x] & 0x00FFFFFFu;
 }
 
-void hardware_abstraction_layer_virtio_gpu_display_present(void)
+void hardware_abstraction_layer_virtio_gpu_display_mark_damage(uint32_t x, uint32_t y, uint32_t width,
+                                                               uint32_t height)
 {
     if (g_display_ready)
-        (void) hardware_abstraction_layer_virtio_gpu_flush(&g_scanout);
+        damage_add_all(x, y, width, height);
+}
+
+void hardware_abstraction_layer_virtio_gpu_display_present(void)
+{
+    if (!g_display_ready)
+        return;
+
+    /* Nobody said what changed: assume everything did, as present always has. */
+    if (!g_frame_damaged)
+        damage_add_all(0u, 0u, g_buffers[0].scanout.width, g_buffers[0].scanout.height);
+    g_frame_damaged = false;
+
+    if (g_buffer_count == VIRTIO_GPU_PRESENT_BUFFERS)
+        present_double_buffered();
+    else
+        present_synchronous();
+}
+
+bool hardware_abstraction_layer_virtio_gpu_display_get_statistics(
+    hardware_abstraction_layer_display_present_statistics_t *out_statistics)
+{
+    if (out_statistics == (void *) 0 || !g_display_ready)
+        return false;
+
+    *out_statistics = g_statistics;
+    out_statistics->buffer_count = (uint8_t) g_buffer_count;
+    out_statistics->interrupt_line = g_interrupt_line;
+    out_statistics->interrupt_vector = g_interrupt_vector;
+    return true;
 }
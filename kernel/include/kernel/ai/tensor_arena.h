@@ -50,6 +50,27 @@ bool kernel_tensor_arena_initialize(size_t bytes);
  */
 void kernel_tensor_arena_release(void);
 
+/**
+ * @brief Scratch memory next to the region.
+ *
+ * The region and this scratch share one TLSF instance, "tensor_arena", over pages
+ * of their own, so a model's side buffers neither come from nor fragment the kernel
+ * heap. At most a few tens of KiB; everything is gone after the release.
+ *
+ * @param bytes Buffer size.
+ * @return The buffer, or NULL when the region is not claimed or the scratch is full.
+ */
+void *kernel_tensor_arena_allocate(size_t bytes);
+
+/**
+ * @brief Returns a buffer from kernel_tensor_arena_allocate().
+ *
+ * Anything else, the region itself included, is ignored.
+ *
+ * @param pointer The buffer.
+ */
+void kernel_tensor_arena_free(void *pointer);
+
 /**
  * @brief Base of the region.
  * @return The pointer, or NULL when it has not been claimed.
@@ -0,0 +1,148 @@
+/**
+ * @file job_system.h
+ * @brief Work-stealing job runtime over the application processors.
+ *
+ * Until now the APs came up, reported in, and halted for the rest of the boot:
+ * every system the engine schedules ran on the BSP, however many cores the
+ * machine had. This gives them something to do.
+ *
+ * Each logical slot owns a Chase-Lev deque. The CPU that submits pushes onto its
+ * own deque and pops from its bottom; every other CPU steals from the top. The
+ * owner's path takes no lock and, while the deque is not nearly empty, no
+ * locked instruction either, which is what lets a wave of small jobs cost less
+ * than running them in place.
+ *
+ * An idle worker does not spin. It sleeps on a per-slot doorbell word through
+ * processor_sleep_until_write(): with MONITOR/MWAIT the submitter's write to the
+ * doorbell is itself the wake-up; without the pair the worker is in HLT and the
+ * submitter follows the write with an IPI on @ref KERNEL_JOB_SYSTEM_WAKEUP_VECTOR.
+ *
+ * The interface is C and deliberately shaped like one scheduler wave: submit a
+ * range split into grains against a group, then wait on the group. That is what
+ * the engine's SystemScheduler asks of its job system, so a kernel-side adapter
+ * is a thin loop over kernel_job_system_submit_range() and
+ * kernel_job_system_wait(). Waiting is not idle: the waiter executes jobs —
+ * its own first, then stolen ones — until the group drains, so on a machine with
+ * no AP at all every job simply runs on the caller and the result is the same.
+ *
+ * Not for interrupt context: the owner end of a deque belongs to the thread
+ * running on that CPU. Each push and pop holds kernel_thread_preempt_disable(),
+ * so no other thread switched in there, and no migration, can come in between.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#ifndef KERNEL_CORE_JOB_SYSTEM_H
+#define KERNEL_CORE_JOB_SYSTEM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Jobs one deque holds before a submit runs the job in place instead.
+ *
+ * A power of two, so the ring index is a mask. A wave larger than this is not an
+ * error: the overflow runs on the submitter, which is exactly what the deque
+ * would have done once the workers were busy anyway.
+ */
+#define KERNEL_JOB_SYSTEM_DEQUE_CAPACITY 128u
+
+/** Fixed IPI vector that ends a worker's HLT when the monitor pair is absent. */
+#define KERNEL_JOB_SYSTEM_WAKEUP_VECTOR 0x41u
+
+/**
+ * @brief Body of a job: process the half-open index range [@p begin, @p end).
+ *
+ * @param context Caller data, shared by every job of the submission.
+ * @param begin First index of this job's range.
+ * @param end One past the last index of this job's range.
+ */
+typedef void (*KernelJobFunction_t)(void *context, uint32_t begin, uint32_t end);
+
+/**
+ * @struct KernelJobGroup_t
+ * @brief Completion counter a wave of jobs is submitted against.
+ *
+ * Zero-initialise it before the first submit. It may be reused once
+ * kernel_job_system_wait() has returned.
+ */
+typedef struct {
+    volatile uint32_t pending;
+} KernelJobGroup_t;
+
+/**
+ * @brief Clears every deque and registers the wake-up IPI handler.
+ *
+ * Called on the BSP before the APs are started, so each one finds its slot
+ * ready when it registers.
+ */
+extern void kernel_job_system_initialize(void);
+
+/**
+ * @brief Declares the calling AP a worker.
+ *
+ * @param slot Logical slot the AP was started at.
+ * @param apic_id Its APIC ID, the destination of wake-up IPIs.
+ */
+extern void kernel_job_system_register_worker(uint32_t slot, uint32_t apic_id);
+
+/**
+ * @brief Runs, steals or sleeps on jobs forever. The tail of every AP.
+ */
+extern void kernel_job_system_worker_loop(void);
+
+/**
+ * @brief Queues one job on the calling CPU's deque.
+ *
+ * When the deque is full the job runs in place before this returns.
+ *
+ * @return true when the job was queued, false when it ran inline.
+ */
+extern bool kernel_job_system_submit(KernelJobGroup_t *group, KernelJobFunction_t function, void *context,
+                                     uint32_t begin, uint32_t end);
+
+/**
+ * @brief Splits [0, @p count) into jobs of @p grain indices and queues them.
+ *
+ * Sleeping workers are woken once, after the whole range is queued, rather than
+ * once per job.
+ *
+ * @return Number of jobs the range was split into.
+ */
+extern uint32_t kernel_job_system_submit_range(KernelJobGroup_t *group, KernelJobFunction_t function, void *context,
+                                               uint32_t count, uint32_t grain);
+
+/**
+ * @brief Executes jobs until every job submitted against @p group has finished.
+ */
+extern void kernel_job_system_wait(KernelJobGroup_t *group);
+
+/** Number of APs registered as workers. */
+extern uint32_t kernel_job_system_get_worker_count(void);
+
+/** Jobs executed on any CPU since initialisation. */
+extern uint32_t kernel_job_system_get_executed_count(void);
+
+/** Jobs executed by a CPU other than the one that queued them. */
+extern uint32_t kernel_job_system_get_steal_count(void);
+
+/** Jobs that found their deque full and ran on the submitter. */
+extern uint32_t kernel_job_system_get_inline_count(void);
+
+/** Wake-up IPIs sent to workers sleeping in HLT. */
+extern uint32_t kernel_job_system_get_wakeup_ipi_count(void);
+
+/** Jobs executed on @p slot; zero for an out-of-range slot. */
+extern uint32_t kernel_job_system_get_slot_executed_count(uint32_t slot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KERNEL_CORE_JOB_SYSTEM_H */
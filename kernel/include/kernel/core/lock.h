@@ -0,0 +1,172 @@
+/**
+ * @file lock.h
+ * @brief Spinning locks for a kernel that now runs code on more than one core.
+ *
+ * Until the job system put the APs to work, nothing needed mutual exclusion
+ * beyond cli/sti on the BSP, and kstd::mutex was a no-op. That stopped being
+ * true the moment a second core could run engine code. This is the set of
+ * primitives the rest of the tree is expected to reach for:
+ *
+ *  - @ref KernelTicketLock_t — FIFO spinlock, one locked XADD to take it. The
+ *    default: fair, four bytes of state, and what kstd::mutex is built on.
+ *  - @ref KernelMcsLock_t — queue lock for the paths that actually contend.
+ *    Each waiter spins on its own node instead of the shared word, so a line
+ *    does not bounce between every waiting core on each hand-over.
+ *  - the `_irqsave` variants — for data an interrupt handler also touches; the
+ *    lock is taken with IF clear and the caller's EFLAGS handed back.
+ *  - @ref KernelRwLock_t — many readers or one writer; a waiting writer stops
+ *    new readers from entering so it is not starved.
+ *
+ * None of them sleeps: there is no scheduler to sleep on. Hold them for
+ * microseconds, not frames.
+ *
+ * Every lock can carry a @ref KernelLockStatistics_t. A lock's counters are
+ * only ever written by its holder, so keeping them costs no extra locked
+ * instruction; registered counters are published by kernel_lock_report() so
+ * the hot locks show up in the boot telemetry. Locks with no counters of their
+ * own, kstd::mutex among them, fold their contention into one shared bucket.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#ifndef KERNEL_CORE_LOCK_H
+#define KERNEL_CORE_LOCK_H
+
+#include <kernel/drivers/serial.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @struct KernelLockStatistics_t
+ * @brief Contention counters of one lock.
+ *
+ * One per lock: two locks sharing a block would race on it.
+ */
+typedef struct KernelLockStatistics {
+    const char *name;
+    uint32_t acquisitions;    /**< Times the lock was taken (write side for rw). */
+    uint32_t contended;       /**< Acquisitions that found the lock held. */
+    uint32_t spins;           /**< PAUSE iterations spent waiting, summed. */
+    uint32_t max_hold_cycles; /**< Longest hold, TSC cycles. */
+    struct KernelLockStatistics *next;
+} KernelLockStatistics_t;
+
+/**
+ * @struct KernelTicketLock_t
+ * @brief FIFO spinlock. All-zero is a valid unlocked lock with no counters.
+ */
+typedef struct {
+    volatile uint16_t serving;
+    volatile uint16_t next;
+    uint32_t acquired_at;
+    KernelLockStatistics_t *statistics;
+} KernelTicketLock_t;
+
+/**
+ * @struct KernelMcsNode_t
+ * @brief A waiter's queue entry; lives on the waiter's stack for the duration
+ *        of the hold and is passed to both acquire and release.
+ */
+typedef struct KernelMcsNode {
+    struct KernelMcsNode *volatile next;
+    volatile uint32_t locked;
+} KernelMcsNode_t;
+
+/**
+ * @struct KernelMcsLock_t
+ * @brief Queue lock. All-zero is a valid unlocked lock with no counters.
+ */
+typedef struct {
+    KernelMcsNode_t *volatile tail;
+    uint32_t acquired_at;
+    KernelLockStatistics_t *statistics;
+} KernelMcsLock_t;
+
+/**
+ * @struct KernelRwLock_t
+ * @brief Reader/writer spinlock. All-zero is a valid unlocked lock.
+ *
+ * Counters track the write side only; readers do not own the lock exclusively
+ * and so cannot update them without a locked instruction.
+ */
+typedef struct {
+    volatile uint32_t state;
+    uint32_t acquired_at;
+    KernelLockStatistics_t *statistics;
+} KernelRwLock_t;
+
+/**
+ * @brief Name @p statistics and add it to the set kernel_lock_report() prints.
+ *
+ * Safe from any CPU at any time; registering the same block twice is a no-op.
+ */
+extern void kernel_lock_statistics_register(KernelLockStatistics_t *statistics, const char *name);
+
+/** Counters every lock without its own block contributes to. */
+extern const KernelLockStatistics_t *kernel_lock_get_shared_statistics(void);
+
+/**
+ * @brief Emit one `lock` telemetry record per registered lock, then one for the
+ *        shared bucket.
+ */
+extern void kernel_lock_report(Serial_t *serial_port);
+
+/* -- Ticket lock --------------------------------------------------------- */
+
+/** @param statistics May be NULL; the lock then reports into the shared bucket. */
+extern void kernel_ticket_lock_initialize(KernelTicketLock_t *lock, KernelLockStatistics_t *statistics);
+extern void kernel_ticket_lock_acquire(KernelTicketLock_t *lock);
+extern bool kernel_ticket_lock_try_acquire(KernelTicketLock_t *lock);
+extern void kernel_ticket_lock_release(KernelTicketLock_t *lock);
+extern bool kernel_ticket_lock_is_locked(const KernelTicketLock_t *lock);
+
+/**
+ * @brief Clear IF, then take the lock.
+ *
+ * @return The caller's EFLAGS, for kernel_ticket_lock_release_irqrestore().
+ */
+extern uint32_t kernel_ticket_lock_acquire_irqsave(KernelTicketLock_t *lock);
+
+/** @brief Release the lock, then put IF back as @p flags had it. */
+extern void kernel_ticket_lock_release_irqrestore(KernelTicketLock_t *lock, uint32_t flags);
+
+/* -- MCS queue lock ------------------------------------------------------ */
+
+extern void kernel_mcs_lock_initialize(KernelMcsLock_t *lock, KernelLockStatistics_t *statistics);
+extern void kernel_mcs_lock_acquire(KernelMcsLock_t *lock, KernelMcsNode_t *node);
+extern bool kernel_mcs_lock_try_acquire(KernelMcsLock_t *lock, KernelMcsNode_t *node);
+extern void kernel_mcs_lock_release(KernelMcsLock_t *lock, KernelMcsNode_t *node);
+extern uint32_t kernel_mcs_lock_acquire_irqsave(KernelMcsLock_t *lock, KernelMcsNode_t *node);
+extern void kernel_mcs_lock_release_irqrestore(KernelMcsLock_t *lock, KernelMcsNode_t *node, uint32_t flags);
+
+/* -- Reader/writer lock -------------------------------------------------- */
+
+extern void kernel_rw_lock_initialize(KernelRwLock_t *lock, KernelLockStatistics_t *statistics);
+extern void kernel_rw_lock_read_acquire(KernelRwLock_t *lock);
+extern bool kernel_rw_lock_read_try_acquire(KernelRwLock_t *lock);
+extern void kernel_rw_lock_read_release(KernelRwLock_t *lock);
+extern void kernel_rw_lock_write_acquire(KernelRwLock_t *lock);
+extern bool kernel_rw_lock_write_try_acquire(KernelRwLock_t *lock);
+extern void kernel_rw_lock_write_release(KernelRwLock_t *lock);
+
+/* -- kstd::mutex backend ------------------------------------------------- */
+
+/**
+ * @brief Identity of the caller for recursive ownership, never zero.
+ *
+ * The current kernel thread once the scheduler runs; before that, the CPU.
+ */
+extern uint32_t kernel_lock_current_owner(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KERNEL_CORE_LOCK_H */
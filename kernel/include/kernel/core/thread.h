@@ -0,0 +1,274 @@
+/**
+ * @file thread.h
+ * @brief Preemptive kernel threads: per-CPU run queues, fixed priorities and EDF.
+ *
+ * The kernel had CPUs and interrupts but no thread: the BSP ran the boot path and
+ * then the engine, each AP ran the job worker loop, and nothing could be set
+ * aside to run later on its own stack. This is that abstraction.
+ *
+ * A thread is a stack from the "kthread_stack" pool plus a control block from
+ * the "kthread" pool. It is switched exactly where an interrupt already saves
+ * everything: isr_common_stub builds an @ref InterruptFrame_t, the dispatcher
+ * asks the scheduler which frame to return through, and the stub resumes that
+ * one. A thread that gives up the CPU does so with `int` on
+ * @ref KERNEL_THREAD_YIELD_VECTOR, which builds the same frame. FPU/SSE state
+ * follows the thread through the outermost save area of the interrupt path.
+ *
+ * Whatever a CPU was running when the scheduler first saw it is adopted as its
+ * boot thread: the BSP's boot path at @ref KERNEL_THREAD_PRIORITY_DEFAULT, an
+ * AP's job worker loop at @ref KERNEL_THREAD_PRIORITY_BACKGROUND. Each CPU also
+ * gets an idle thread for when even that one is blocked.
+ *
+ * Scheduling is per CPU, in two classes:
+ *
+ *   - deadline threads (EDF): periodic, with a budget and a relative deadline.
+ *     The ready one with the earliest absolute deadline runs first, ahead of
+ *     every fixed-priority thread. They are admitted against the CPU's density
+ *     and pinned to it. Meant for the authoritative tick and the audio pumps;
+ *   - fixed-priority threads: the highest ready priority runs; equals share
+ *     the CPU in @ref KERNEL_THREAD_TIME_SLICE_MICROSECONDS slices.
+ *
+ * A CPU holding more runnable threads than another pushes one of them over and
+ * rings it with @ref KERNEL_THREAD_RESCHEDULE_VECTOR; a CPU that runs out of
+ * work rings the busiest one to ask. Only the CPU that owns a run queue ever
+ * takes a thread off it, so a thread is never resumed while its stack is still
+ * in use elsewhere.
+ *
+ * A thread can be switched out wherever it has interrupts on, and an unpinned
+ * one can resume on another CPU. Code that keys state by the CPU it runs on and
+ * expects to be its only user until it is done (the job system's owner end of a
+ * deque, a TLB shootdown batch) holds kernel_thread_preempt_disable() over it.
+ *
+ * Every thread's CPU time is accounted at each switch, as is each CPU's time in
+ * its idle thread.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#ifndef KERNEL_CORE_THREAD_H
+#define KERNEL_CORE_THREAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <kernel/cpu/isr.h>
+#include <kernel/drivers/serial.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** IPI that asks a CPU to run its scheduler: a wakeup, a pushed thread, a balance request. */
+#define KERNEL_THREAD_RESCHEDULE_VECTOR 0x43u
+
+/** Software interrupt a thread raises to give up its CPU. Never acknowledged at the LAPIC. */
+#define KERNEL_THREAD_YIELD_VECTOR 0x44u
+
+/** Fixed priorities: 0 (idle only) to 31, higher runs first. */
+#define KERNEL_THREAD_PRIORITY_LEVELS     32u
+#define KERNEL_THREAD_PRIORITY_IDLE       0u
+#define KERNEL_THREAD_PRIORITY_BACKGROUND 1u
+#define KERNEL_THREAD_PRIORITY_DEFAULT    16u
+#define KERNEL_THREAD_PRIORITY_HIGHEST    31u
+
+/** Stack of every created thread, in bytes. */
+#define KERNEL_THREAD_STACK_BYTES 16384u
+
+/** Threads that may exist at once, boot and idle threads aside. */
+#define KERNEL_THREAD_CAPACITY 32u
+
+/** Slice shared by ready threads of equal priority. */
+#define KERNEL_THREAD_TIME_SLICE_MICROSECONDS 10000u
+
+/** Least time between two balancing attempts of one CPU. */
+#define KERNEL_THREAD_BALANCE_INTERVAL_MICROSECONDS 20000u
+
+/** Density of deadline threads one CPU admits, in parts per million. */
+#define KERNEL_THREAD_DEADLINE_DENSITY_PPM 900000u
+
+/** Let the scheduler choose the CPU; the thread may migrate later. */
+#define KERNEL_THREAD_CPU_ANY 0xFFFFFFFFu
+
+typedef struct KernelThread KernelThread_t;
+
+/** @brief Body of a thread. Returning from it exits the thread. */
+typedef void (*KernelThreadEntry_t)(void *argument);
+
+/** Where a thread is. */
+typedef enum KernelThreadState {
+    KERNEL_THREAD_STATE_READY = 0u,   /**< In its CPU's run queue. */
+    KERNEL_THREAD_STATE_RUNNING = 1u, /**< Current on its CPU. */
+    KERNEL_THREAD_STATE_BLOCKED = 2u, /**< Sleeping, waiting for a period or a join. */
+    KERNEL_THREAD_STATE_EXITED = 3u,  /**< Off its CPU for good; join releases it. */
+} KernelThreadState_t;
+
+/** How a thread is scheduled. */
+typedef enum KernelThreadClass {
+    KERNEL_THREAD_CLASS_FIXED = 0u,    /**< Fixed priority, round-robin among equals. */
+    KERNEL_THREAD_CLASS_DEADLINE = 1u, /**< Periodic, earliest deadline first. */
+    KERNEL_THREAD_CLASS_IDLE = 2u,     /**< A CPU's idle thread. */
+} KernelThreadClass_t;
+
+/**
+ * @struct KernelThreadInfo_t
+ * @brief One thread's state and counters, copied out.
+ */
+typedef struct KernelThreadInfo {
+    const char *name;
+    uint32_t id;
+    uint32_t cpu;
+    KernelThreadState_t state;
+    KernelThreadClass_t thread_class;
+    uint32_t priority;
+    uint64_t cpu_cycles;          /**< Time on a CPU, TSC cycles. */
+    uint32_t switches;            /**< Times it was switched in. */
+    uint32_t preemptions;         /**< Times it was switched out while still runnable. */
+    uint32_t migrations;          /**< Times it was pushed to another CPU. */
+    uint32_t jobs;                /**< Deadline class: jobs completed. */
+    uint32_t deadline_misses;     /**< Deadline class: jobs completed after their deadline, or skipped. */
+    uint32_t budget_overruns;     /**< Deadline class: jobs that used more than their budget. */
+    uint32_t max_wake_latency_us; /**< Longest wait from being made ready to running. */
+} KernelThreadInfo_t;
+
+/**
+ * @struct KernelThreadStatistics_t
+ * @brief Every CPU's scheduler counters, summed.
+ */
+typedef struct KernelThreadStatistics {
+    bool active;
+    uint32_t cpus;                  /**< CPUs whose scheduler has run. */
+    uint32_t threads;               /**< Created threads alive (not yet released). */
+    uint32_t created;
+    uint32_t create_failures;       /**< Pool exhausted or deadline not admitted. */
+    uint32_t switches;
+    uint32_t preemptions;           /**< Switches away from a still runnable thread. */
+    uint32_t yields;                /**< Yield-vector entries. */
+    uint32_t wakeups;
+    uint32_t migrations;
+    uint32_t balance_pushes;        /**< Threads pushed to a less loaded CPU. */
+    uint32_t balance_requests;      /**< IPIs from a CPU out of work asking to be pushed one. */
+    uint32_t reschedule_ipis;
+    uint32_t stack_overflows;       /**< Stack canaries found clobbered at a switch. */
+    uint32_t switch_average_cycles; /**< Scheduler pass to the new frame's stack, averaged. */
+    uint32_t switch_max_cycles;
+    uint32_t max_wake_latency_us;
+    uint32_t deadline_threads;
+    uint32_t deadline_jobs;
+    uint32_t deadline_misses;
+    uint32_t budget_overruns;
+    uint64_t busy_cycles;           /**< Time in created threads. */
+    uint64_t boot_cycles;           /**< Time in boot threads (boot path, job workers). */
+    uint64_t idle_cycles;           /**< Time in idle threads. */
+} KernelThreadStatistics_t;
+
+/**
+ * @brief Set up the pools, the vectors and every online CPU's run queue, and adopt
+ *        the calling context as the BSP's boot thread.
+ *
+ * Once, on the BSP, after kernel_timer_initialize() and the AP bring-up.
+ *
+ * @return false without kernel timers or when the pools cannot be backed.
+ */
+bool kernel_thread_initialize(void);
+
+/** @brief true once kernel_thread_initialize() succeeded. */
+bool kernel_thread_is_active(void);
+
+/**
+ * @brief Create a fixed-priority thread, ready to run.
+ *
+ * @param priority 1 to @ref KERNEL_THREAD_PRIORITY_HIGHEST.
+ * @param cpu Logical slot to pin it to, or @ref KERNEL_THREAD_CPU_ANY.
+ * @return NULL on a bad argument or when no control block or stack is left.
+ */
+KernelThread_t *kernel_thread_create(const char *name, KernelThreadEntry_t entry, void *argument, uint32_t priority,
+                                     uint32_t cpu);
+
+/**
+ * @brief Create a deadline thread. Its first job is released when it first runs.
+ *
+ * The body runs one job, then calls kernel_thread_wait_next_period(), in a loop.
+ *
+ * @param period_us Release interval.
+ * @param runtime_us Budget of one job; overruns are counted, not throttled.
+ * @param deadline_us Relative deadline, at most @p period_us; 0 for the period.
+ * @param cpu Logical slot, or @ref KERNEL_THREAD_CPU_ANY for the least dense CPU.
+ * @return NULL when no CPU can admit runtime/deadline on top of what it holds.
+ */
+KernelThread_t *kernel_thread_create_deadline(const char *name, KernelThreadEntry_t entry, void *argument,
+                                              uint32_t period_us, uint32_t runtime_us, uint32_t deadline_us,
+                                              uint32_t cpu);
+
+/** @brief The thread running on this CPU; NULL before initialization. */
+KernelThread_t *kernel_thread_current(void);
+
+/** @brief Let the next ready thread of the same priority run. */
+void kernel_thread_yield(void);
+
+/**
+ * @brief Keep the calling thread running, on this CPU, until the matching
+ *        kernel_thread_preempt_enable(). Nests; boot contexts may use it too.
+ *
+ * Interrupts still run. A switch one of them asks for waits until the count is
+ * back to zero. The holder must not block, sleep or yield in between.
+ */
+void kernel_thread_preempt_disable(void);
+
+/** @brief Undo one kernel_thread_preempt_disable(); at zero, run a switch held back meanwhile. */
+void kernel_thread_preempt_enable(void);
+
+/** @brief Block for at least @p microseconds. */
+void kernel_thread_sleep_microseconds(uint32_t microseconds);
+
+/**
+ * @brief End the current job of a deadline thread and block until the next release.
+ *
+ * Releases that went by entirely while the job ran are skipped, and each counts
+ * as a miss.
+ *
+ * @return false when the job just ended missed its deadline.
+ */
+bool kernel_thread_wait_next_period(void);
+
+/** @brief End the calling thread. Boot and idle threads cannot exit. */
+void kernel_thread_exit(void) __attribute__((noreturn));
+
+/**
+ * @brief Wait for @p thread to exit, then give its stack and control block back.
+ *
+ * @return false for a thread that cannot be joined (NULL, boot, idle, detached).
+ */
+bool kernel_thread_join(KernelThread_t *thread);
+
+/** @brief Let @p thread release itself when it exits; it may no longer be joined. */
+void kernel_thread_detach(KernelThread_t *thread);
+
+/** @brief Copy @p thread's state and counters to @p out. */
+void kernel_thread_get_info(const KernelThread_t *thread, KernelThreadInfo_t *out);
+
+/**
+ * @brief Scheduler half of the interrupt exit, called by the dispatcher.
+ *
+ * @param frame Frame of the interrupt being left.
+ * @return The frame to resume: @p frame, or another thread's.
+ */
+InterruptFrame_t *kernel_thread_interrupt_exit(InterruptFrame_t *frame);
+
+/**
+ * @brief Called by isr_common_stub once it runs on the stack of a frame other
+ *        than the one it entered with; the previous stack is no longer in use.
+ */
+void kernel_thread_switch_complete(void);
+
+void kernel_thread_get_statistics(KernelThreadStatistics_t *out);
+
+/** @brief Emit the `sched` record and one `sched_cpu` record per CPU. */
+void kernel_thread_report(Serial_t *serial);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KERNEL_CORE_THREAD_H */
@@ -0,0 +1,214 @@
+/**
+ * @file timer.h
+ * @brief Kernel timers: many timeouts and deadlines on one local timer per CPU.
+ *
+ * Until now the kernel had three clocks and no timers: the periodic tick, a
+ * one-shot that only the tickless sleep armed, and the tick counter. Anything
+ * that wanted to run at a time of its own had to poll one of them. This is the
+ * layer in between: callers embed a @ref KernelTimer_t, arm it for an absolute
+ * TSC deadline, and its callback runs from the local timer interrupt of the CPU
+ * that armed it.
+ *
+ * Each CPU keeps two structures under one lock:
+ *
+ *   - a hierarchical timing wheel for coarse timeouts: four levels of 64 slots
+ *     over a 1 ms granule, so about four and a half hours before the last level
+ *     wraps. Insertion and removal are O(1); a timer is moved down a level when
+ *     the wheel reaches its slot, and fires on the first granule at or after its
+ *     deadline, so up to one granule late;
+ *   - a min-heap of deadlines for precise timers (KERNEL_TIMER_FLAG_PRECISE)
+ *     and for anything due within one granule. O(log n), exact to the hardware.
+ *
+ * The hardware is programmed for the earlier of the heap's top and the wheel's
+ * next occupied slot, never on a cadence: a CPU with no timer due takes no
+ * timer interrupt. On a CPU whose LAPIC has TSC-deadline mode the deadline is
+ * written as is; otherwise the LAPIC runs one-shot and the deadline becomes a
+ * count.
+ *
+ * Callbacks run in interrupt context with the queue unlocked, so one may arm or
+ * cancel timers, itself included. A periodic timer is re-armed from its previous
+ * deadline, not from when it ran, so it does not drift; periods missed entirely
+ * are skipped and counted as overruns.
+ *
+ * Every expiry is measured: how late it ran against its deadline goes into a
+ * log2 histogram, per queue kind, reported as the `timer_jitter` record.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#ifndef KERNEL_CORE_TIMER_H
+#define KERNEL_CORE_TIMER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <kernel/drivers/serial.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Local timer vector of the timer subsystem, on every CPU. */
+#define KERNEL_TIMER_VECTOR 0x42u
+
+/** Wheel geometry: levels, and slots per level (a power of two). */
+#define KERNEL_TIMER_WHEEL_LEVELS     4u
+#define KERNEL_TIMER_WHEEL_SLOT_SHIFT 6u
+#define KERNEL_TIMER_WHEEL_SLOTS      (1u << KERNEL_TIMER_WHEEL_SLOT_SHIFT)
+
+/** Wheel granule, in microseconds. */
+#define KERNEL_TIMER_WHEEL_GRANULE_MICROSECONDS 1000u
+
+/** Precise timers one CPU's heap holds; past it they fall back to the wheel. */
+#define KERNEL_TIMER_HEAP_CAPACITY 64u
+
+/** Jitter buckets: <1 us, then [2^(n-1), 2^n) us, the last one open-ended (>= 1024 us). */
+#define KERNEL_TIMER_JITTER_BUCKETS 12u
+
+/** Run on the deadline, not on the next granule: the timer goes to the heap. */
+#define KERNEL_TIMER_FLAG_PRECISE 0x01u
+
+typedef struct KernelTimer KernelTimer_t;
+
+/** @brief Expiry callback. Interrupt context, interrupts off, queue unlocked. */
+typedef void (*KernelTimerCallback_t)(KernelTimer_t *timer, void *context);
+
+/** Where a timer is. */
+typedef enum KernelTimerState {
+    KERNEL_TIMER_STATE_IDLE = 0u,    /**< Not armed. */
+    KERNEL_TIMER_STATE_WHEEL = 1u,   /**< Armed, in a wheel slot. */
+    KERNEL_TIMER_STATE_HEAP = 2u,    /**< Armed, in the heap. */
+    KERNEL_TIMER_STATE_RUNNING = 3u, /**< Its callback is running. */
+} KernelTimerState_t;
+
+/**
+ * @struct KernelTimer_t
+ * @brief One timer, embedded by its owner. Set up with kernel_timer_setup().
+ *
+ * Everything below the callback belongs to the queue the timer is armed on.
+ */
+struct KernelTimer {
+    KernelTimerCallback_t callback;
+    void *context;
+    const char *name;
+    uint32_t flags;         /**< KERNEL_TIMER_FLAG_*. */
+    uint64_t expires;       /**< Deadline, TSC cycles. */
+    uint64_t period;        /**< Re-arm interval in TSC cycles; 0 for one-shot. */
+    uint32_t fired;         /**< Expiries, since setup. */
+    uint32_t overruns;      /**< Periods skipped because the callback ran too late for them. */
+
+    volatile uint8_t state; /**< KernelTimerState_t. */
+    uint8_t cpu;            /**< Queue the timer is armed on. */
+    uint16_t slot;          /**< Wheel level * slots + slot, or heap index. */
+    KernelTimer_t *next;    /**< Wheel slot list, or the expired list. */
+    KernelTimer_t **link;   /**< The pointer that points at this timer in its slot. */
+};
+
+/**
+ * @struct KernelTimerStatistics_t
+ * @brief Counters of every CPU's queue, summed.
+ */
+typedef struct KernelTimerStatistics {
+    bool active;                  /**< The subsystem owns the local timers. */
+    bool tsc_deadline;            /**< Programmed in TSC-deadline mode rather than one-shot. */
+    uint32_t tsc_mhz;             /**< Calibrated TSC frequency. */
+    uint32_t cpus;                /**< CPUs whose local timer the subsystem has programmed. */
+    uint32_t pending_wheel;       /**< Timers in a wheel now. */
+    uint32_t pending_heap;        /**< Timers in a heap now. */
+    uint32_t armed;               /**< kernel_timer_arm() calls that queued a timer. */
+    uint32_t cancelled;           /**< Pending timers taken off by kernel_timer_cancel(). */
+    uint32_t fired_wheel;         /**< Expiries out of a wheel. */
+    uint32_t fired_heap;          /**< Expiries out of a heap. */
+    uint32_t cascaded;            /**< Timers moved down a wheel level. */
+    uint32_t heap_overflows;      /**< Precise timers sent to the wheel because the heap was full. */
+    uint32_t overruns;            /**< Periods skipped, every periodic timer. */
+    uint32_t interrupts;          /**< Local timer interrupts taken. */
+    uint32_t empty_interrupts;    /**< Of which found nothing due (early one-shot, clamp). */
+    uint32_t max_jitter_wheel_us; /**< Latest wheel expiry against its deadline. */
+    uint32_t max_jitter_heap_us;  /**< Latest heap expiry against its deadline. */
+    uint32_t jitter_wheel[KERNEL_TIMER_JITTER_BUCKETS];
+    uint32_t jitter_heap[KERNEL_TIMER_JITTER_BUCKETS];
+} KernelTimerStatistics_t;
+
+/**
+ * @brief Take over the local timer vector. Once, on the BSP, after
+ *        advanced_pic_timer_backend_calibrate_with_pit().
+ *
+ * A CPU's local timer is switched to deadline mode the first time a timer is
+ * armed on it, so the APs need no call of their own.
+ *
+ * @return false without a calibrated TSC and LAPIC; no timer can then be armed.
+ */
+bool kernel_timer_initialize(void);
+
+/** @brief true once kernel_timer_initialize() succeeded. */
+bool kernel_timer_is_active(void);
+
+/** @brief Current TSC, the clock every deadline is written against. */
+uint64_t kernel_timer_now(void);
+
+/** @brief @p microseconds in TSC cycles; 0 before initialization. */
+uint64_t kernel_timer_microseconds_to_cycles(uint32_t microseconds);
+
+/** @brief @p cycles in microseconds, saturated to 32 bits; 0 before initialization. */
+uint32_t kernel_timer_cycles_to_microseconds(uint64_t cycles);
+
+/** @brief Prepare @p timer. It must not be armed. */
+void kernel_timer_setup(KernelTimer_t *timer, const char *name, KernelTimerCallback_t callback, void *context,
+                        uint32_t flags);
+
+/**
+ * @brief Arm @p timer on the calling CPU for TSC @p expires.
+ *
+ * A timer already armed is moved, from whichever CPU it was on. A deadline in
+ * the past fires at the next interrupt.
+ *
+ * @param period Re-arm interval in TSC cycles, 0 for one-shot.
+ * @return false before initialization.
+ */
+bool kernel_timer_arm(KernelTimer_t *timer, uint64_t expires, uint64_t period);
+
+/** @brief kernel_timer_arm() @p delay_us from now, every @p period_us (0: once). */
+bool kernel_timer_arm_microseconds(KernelTimer_t *timer, uint32_t delay_us, uint32_t period_us);
+
+/**
+ * @brief Take @p timer off its queue.
+ *
+ * Does not wait for a callback running on another CPU; a periodic timer whose
+ * callback is running is not re-armed.
+ *
+ * @return true when the timer was pending and will not fire.
+ */
+bool kernel_timer_cancel(KernelTimer_t *timer);
+
+/** @brief true while @p timer is queued. */
+bool kernel_timer_is_pending(const KernelTimer_t *timer);
+
+/**
+ * @brief Run the system tick as a precise periodic timer at @p hertz on this CPU.
+ *
+ * Replaces the LAPIC periodic mode: the local timer then serves the tick and
+ * every other deadline. The PIT's line 0 is masked, as periodic mode masks it.
+ *
+ * @return false when the subsystem is not active.
+ */
+bool kernel_timer_system_tick_start(uint32_t hertz);
+
+/** @brief Stop the system tick timer; other timers keep firing. */
+void kernel_timer_system_tick_stop(void);
+
+/** @brief true while the system tick runs on a kernel timer. */
+bool kernel_timer_system_tick_running(void);
+
+void kernel_timer_get_statistics(KernelTimerStatistics_t *out);
+
+/** @brief Emit the `timer` and `timer_jitter` records. */
+void kernel_timer_report(Serial_t *serial);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KERNEL_CORE_TIMER_H */
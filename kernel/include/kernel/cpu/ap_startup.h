@@ -21,6 +21,7 @@
 
 extern void *boot_page_directory;
 extern void *boot_page_tables;
+extern GlobalDescriptorTable_t global_descriptor_table;
 extern InterruptDescriptorTable_t interrupt_descriptor_table;
 
 /**
@@ -118,8 +119,8 @@ extern uint8_t application_processor_startup_is_initialized(void);
 /**
  * @brief Main event loop for AP (after initialization).
  *
- * Placeholder for AP-specific tasks. Currently spins with HLT.
- * In a full scheduler, this would wait for work or interrupts.
+ * Hands the CPU to the job system: the AP runs, steals or sleeps on job
+ * work for the rest of the boot and never returns.
  */
 extern void application_processor_startup_main_loop(void);
 
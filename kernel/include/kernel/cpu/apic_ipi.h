@@ -95,14 +95,15 @@ extern uint8_t advanced_pic_ipi_send_fixed(uint8_t apic_id, uint8_t vector, uint
 /**
  * @brief IPI-based TLB shootdown.
  *
- * Broadcasts an IPI to all other CPUs to invalidate a specific virtual address.
+ * Invalidates a specific virtual address on every CPU; see tlb_shootdown_page(),
+ * which queues it instead while a batch is open.
  */
 extern void advanced_pic_ipi_broadcast_tlb_shootdown(uint32_t virt_addr);
 
 /**
  * @brief IPI-based TLB flush.
  *
- * Broadcasts an IPI to all other CPUs to flush their entire TLB.
+ * Flushes the entire (non-global) TLB of every CPU; see tlb_shootdown_all().
  */
 extern void advanced_pic_ipi_broadcast_tlb_flush(void);
 
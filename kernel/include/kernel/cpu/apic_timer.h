@@ -124,4 +124,33 @@ extern void advanced_pic_timer_backend_disable(void);
  */
 extern uint32_t advanced_pic_timer_backend_read_current_count(void);
 
+/**
+ * @brief Return the TSC frequency measured alongside the LAPIC calibration.
+ *
+ * Returns 0 before advanced_pic_timer_backend_calibrate_with_pit() succeeded.
+ */
+extern uint64_t advanced_pic_timer_backend_get_timestamp_counter_frequency_hz(void);
+
+/**
+ * @brief Return non-zero when CPUID reports the LAPIC TSC-deadline mode.
+ */
+extern uint8_t advanced_pic_timer_backend_is_tsc_deadline_supported(void);
+
+/**
+ * @brief Switches the calling CPU's local timer to deadline operation on @p vector.
+ *
+ * TSC-deadline mode when the CPU has it, one-shot mode otherwise; either way the
+ * timer is left disarmed until advanced_pic_timer_backend_arm_deadline().
+ *
+ * @return 1 in TSC-deadline mode, 0 in one-shot mode or when unavailable.
+ */
+extern uint8_t advanced_pic_timer_backend_enter_deadline_mode(uint8_t vector);
+
+/**
+ * @brief Arms the calling CPU's local timer for an absolute TSC deadline.
+ *
+ * @param deadline TSC value; 0 disarms. A deadline in the past fires at once.
+ */
+extern void advanced_pic_timer_backend_arm_deadline(uint64_t deadline);
+
 #endif /* KERNEL_CPU_ADVANCED_PROGRAMMABLE_INTERRUPT_CONTROLLER_TIMER_H */
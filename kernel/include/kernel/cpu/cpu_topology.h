@@ -29,6 +29,10 @@ extern void cpu_topology_initialize(void);
  *
  * If topology discovery failed, returns 0 (BSP slot). If forced slot mode is
  * enabled, returns the forced slot instead.
+ *
+ * On an AP bound with cpu_topology_bind_hardware_apic_id(), the slot comes from
+ * the ID its own LAPIC reports, so per-CPU state indexed by this value stays
+ * private to each processor.
  */
 extern uint32_t cpu_topology_get_logical_slot(void);
 
@@ -152,6 +156,18 @@ extern uint32_t cpu_topology_get_discovered_cpu_count(void);
  */
 extern const char *cpu_topology_get_source_name(void);
 
+/**
+ * @brief Bind the LAPIC ID an AP reads from its own ID register to its slot.
+ *
+ * Called once by each AP as it comes up. The first binding switches
+ * cpu_topology_get_logical_slot() to hardware lookups on CPUs other than the
+ * BSP; bindings survive cpu_topology_debug_reset_discovery().
+ *
+ * @param apic_id Hardware APIC ID of the calling AP (0-255).
+ * @param slot Logical slot the AP was started at.
+ */
+extern void cpu_topology_bind_hardware_apic_id(uint32_t apic_id, uint32_t slot);
+
 /**
  * @brief Debug function to force a logical slot assignment.
  *
@@ -0,0 +1,138 @@
+/*
+** EPITECH PROJECT, 2026
+** LplKernel
+** File description:
+** Per-CPU, nesting-aware FPU/SSE state handling for the interrupt path
+*/
+
+#ifndef KERNEL_CPU_FLOATING_POINT_UNIT_H
+#define KERNEL_CPU_FLOATING_POINT_UNIT_H
+
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/cpu/isr.h>
+#include <kernel/drivers/serial.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Interrupt frames per CPU that get their own FPU save area.
+ *
+ * Interrupt gates keep IRQs from nesting, so depth only grows through an
+ * exception raised inside a handler (a page fault, the #NM of the lazy path
+ * itself) or an NMI. Past this depth the state is left unprotected and the
+ * overflow is counted rather than hidden.
+ */
+#define INTERRUPT_FPU_MAX_NESTING 4u
+
+/**
+ * @brief Bytes per save area.
+ *
+ * FXSAVE needs 512. XSAVE with XCR0 = x87|SSE needs the same legacy region
+ * plus its 64-byte header; rounded up to the 64-byte alignment XSAVE demands.
+ */
+#define INTERRUPT_FPU_AREA_SIZE 640u
+
+/**
+ * @brief IRQ-path counters, summed over every CPU.
+ */
+typedef struct {
+    uint32_t cpus;              /**< CPUs that took at least one interrupt. */
+    uint32_t interrupts;        /**< Interrupt frames entered and left. */
+    uint64_t cycles;            /**< TSC cycles spent between entry and exit. */
+    uint32_t lazy_skipped;      /**< Frames that left without touching FPU/SSE. */
+    uint32_t lazy_saves;        /**< #NM-triggered saves on the lazy path. */
+    uint32_t eager_saves;       /**< Unconditional saves on the eager path. */
+    uint32_t nesting_overflows; /**< Frames past INTERRUPT_FPU_MAX_NESTING. */
+    uint32_t max_depth;         /**< Deepest nesting observed. */
+} InterruptFpuStatistics_t;
+
+/**
+ * @brief Probe XSAVE/XSAVEOPT, enable it when present, install the #NM handler.
+ *
+ * Called on the BSP right after the IDT is loaded. Until then the interrupt
+ * path uses eager FXSAVE, which needs nothing but the SSE bits boot.S sets.
+ */
+extern void interrupt_fpu_initialize(void);
+
+/**
+ * @brief Mirror the BSP's XSAVE configuration (CR4.OSXSAVE, XCR0) on an AP.
+ */
+extern void interrupt_fpu_initialize_secondary(void);
+
+/**
+ * @brief Entry half of the interrupt path, called by isr_common_stub.
+ *
+ * Opens one nesting level on the current CPU. In lazy mode it only sets
+ * CR0.TS; the state is saved by the #NM handler if, and only if, the handler
+ * touches FPU/SSE. In eager mode it saves unconditionally.
+ *
+ * @return Opaque per-CPU context to hand back to interrupt_fpu_leave().
+ */
+extern void *interrupt_fpu_enter(void);
+
+/**
+ * @brief Exit half of the interrupt path, called by isr_common_stub.
+ *
+ * Restores the state if this level saved it and puts CR0.TS back the way the
+ * interrupted code had it.
+ *
+ * @param context Value interrupt_fpu_enter() returned for this frame.
+ */
+extern void interrupt_fpu_leave(void *context);
+
+/**
+ * @brief Interrupt frames the current CPU is inside; 0 in thread context.
+ */
+extern uint32_t interrupt_fpu_get_depth(void);
+
+/**
+ * @brief Fill a save area with the state a fresh thread starts from.
+ *
+ * x87 and SSE in their reset state, exceptions masked. @p area is
+ * INTERRUPT_FPU_AREA_SIZE bytes, 64-byte aligned.
+ */
+extern void interrupt_fpu_initialize_area(void *area);
+
+/**
+ * @brief Hand the interrupted FPU/SSE state over to another thread.
+ *
+ * Only from the outermost interrupt frame, which is the one a thread switch
+ * replaces. The interrupted state goes to @p save_area, wherever it currently
+ * is (the registers, or this level's area if the handler already saved it), and
+ * @p load_area becomes what that frame's exit restores.
+ *
+ * @return false, with nothing moved, when not at depth 1.
+ */
+extern bool interrupt_fpu_switch_state(void *save_area, const void *load_area);
+
+/**
+ * @brief Select lazy (CR0.TS) or eager state handling for later interrupts.
+ */
+extern void interrupt_fpu_set_lazy(bool lazy);
+
+/**
+ * @brief Return true when the lazy CR0.TS path is active.
+ */
+extern bool interrupt_fpu_is_lazy(void);
+
+/**
+ * @brief Return true when saves use XSAVEOPT rather than FXSAVE.
+ */
+extern bool interrupt_fpu_uses_xsaveopt(void);
+
+/**
+ * @brief Sum the IRQ-path counters of every CPU.
+ *
+ * @param out Destination; left untouched when NULL.
+ */
+extern void interrupt_fpu_get_statistics(InterruptFpuStatistics_t *out);
+
+/**
+ * @brief Emit the `irq_fpu` telemetry record.
+ *
+ * @param serial_port Output port.
+ */
+extern void interrupt_fpu_report(Serial_t *serial_port);
+
+#endif /* KERNEL_CPU_FLOATING_POINT_UNIT_H */
@@ -137,4 +137,16 @@ extern void global_descriptor_table_initialize(GlobalDescriptorTable_t *gdt, Tas
  */
 extern void global_descriptor_table_load(GlobalDescriptorTable_t *gdt);
 
+/**
+ * @brief Load the shared GDT on an application processor
+ *
+ * @details Same as global_descriptor_table_load() minus the LTR. The single
+ *          TSS descriptor is already marked busy by the BSP, and loading a busy
+ *          TSS raises #GP, so an AP only adopts the code/data selectors. APs
+ *          never drop to ring 3, so they have no use for a TSS of their own.
+ *
+ * @param gdt Pointer to the GDT already loaded by the BSP
+ */
+extern void global_descriptor_table_load_secondary(GlobalDescriptorTable_t *gdt);
+
 #endif /* KERNEL_CPU_GLOBAL_DESCRIPTOR_TABLE_H */
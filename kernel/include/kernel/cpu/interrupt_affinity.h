@@ -0,0 +1,154 @@
+/**
+ * @file interrupt_affinity.h
+ * @brief IRQ balancer: steers device interrupts off the CPU that runs the tick.
+ *
+ * Every device interrupt used to land on the BSP: the IOAPIC routes were written
+ * with destination 0 and left there, and an MSI function targets whatever CPU its
+ * driver named. The BSP is also the CPU that runs the engine's authoritative step,
+ * so a burst of keyboard, audio or GPU completions was paid for inside the frame.
+ *
+ * A source is either an IOAPIC line the local APICs own (its redirection entry's
+ * destination is rewritten) or a message vector (message_signaled_interrupt_set_affinity()).
+ * Both are named by their IDT vector. Each balancing pass:
+ *
+ *   - samples each source's delivery count (interrupt_service_routine_get_delivery_count())
+ *     into a smoothed rate per second;
+ *   - gives each real-time source a core of its own, taken from the top of the
+ *     online slots, as long as one spare CPU is left for everything else;
+ *   - spreads the remaining sources over the spare CPUs, busiest first, onto the
+ *     least loaded one — staying put unless that saves more than
+ *     @ref INTERRUPT_AFFINITY_HYSTERESIS_PER_SECOND, so two close rates do not
+ *     trade places every pass;
+ *   - leaves the tick CPU only the tick's own line (ISA line 0) and what was
+ *     pinned there on purpose.
+ *
+ * With a single CPU online there is nowhere to steer to, and a pass moves nothing.
+ *
+ * Passes run from a kernel timer every @ref INTERRUPT_AFFINITY_INTERVAL_MICROSECONDS
+ * once interrupt_affinity_initialize() has armed it, and on demand.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#ifndef KERNEL_CPU_INTERRUPT_AFFINITY_H
+#define KERNEL_CPU_INTERRUPT_AFFINITY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <kernel/drivers/serial.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Sources the balancer tracks, present or remembered for their policy. */
+#define INTERRUPT_AFFINITY_MAX_SOURCES 16u
+
+/** Time between two periodic passes. */
+#define INTERRUPT_AFFINITY_INTERVAL_MICROSECONDS 500000u
+
+/** Load a move must save before a source leaves a CPU it may stay on, in interrupts per second. */
+#define INTERRUPT_AFFINITY_HYSTERESIS_PER_SECOND 64u
+
+/** Line of a source that is a message rather than an IOAPIC route. */
+#define INTERRUPT_AFFINITY_NO_LINE 0xFFu
+
+/** How a source is retargeted. */
+typedef enum InterruptAffinityKind {
+    INTERRUPT_AFFINITY_KIND_LINE = 0u,    /**< IOAPIC redirection entry. */
+    INTERRUPT_AFFINITY_KIND_MESSAGE = 1u, /**< MSI or MSI-X vector. */
+} InterruptAffinityKind_t;
+
+/** Where the balancer may put a source. */
+typedef enum InterruptAffinityPolicy {
+    INTERRUPT_AFFINITY_POLICY_BALANCED = 0u,  /**< Any spare CPU, by load. */
+    INTERRUPT_AFFINITY_POLICY_REAL_TIME = 1u, /**< A dedicated core when one can be spared. */
+    INTERRUPT_AFFINITY_POLICY_PINNED = 2u,    /**< The CPU it was pinned to, while online. */
+    INTERRUPT_AFFINITY_POLICY_TICK = 3u,      /**< The tick's own source: stays with the tick. */
+} InterruptAffinityPolicy_t;
+
+/**
+ * @struct InterruptAffinitySource_t
+ * @brief One source as the last pass saw it.
+ */
+typedef struct InterruptAffinitySource {
+    uint8_t vector;
+    uint8_t line;                     /**< ISA line, @ref INTERRUPT_AFFINITY_NO_LINE for a message. */
+    bool present;                     /**< Routed or enabled at the last pass. */
+    InterruptAffinityKind_t kind;
+    InterruptAffinityPolicy_t policy;
+    uint32_t cpu;                     /**< Logical slot it targets. */
+    uint32_t pinned_cpu;              /**< For @ref INTERRUPT_AFFINITY_POLICY_PINNED. */
+    uint32_t rate_per_second;         /**< Smoothed over the last passes. */
+    uint32_t deliveries;              /**< Dispatches of the vector since boot. */
+    uint32_t moves;                   /**< Retargets the balancer applied. */
+} InterruptAffinitySource_t;
+
+/**
+ * @struct InterruptAffinityStatistics_t
+ * @brief The balancer as a whole.
+ */
+typedef struct InterruptAffinityStatistics {
+    bool periodic;                    /**< The pass timer is armed. */
+    uint32_t tick_cpu;
+    uint32_t spare_cpus;              /**< Online CPUs other than the tick CPU. */
+    uint32_t dedicated_cpus;          /**< Of which reserved for real-time sources. */
+    uint32_t sources;                 /**< Present at the last pass. */
+    uint32_t real_time_sources;
+    uint32_t on_tick_cpu;             /**< Sources left on the tick CPU that did not ask to be there. */
+    uint32_t passes;
+    uint32_t moves;
+    uint32_t failed_moves;            /**< Retargets the IOAPIC or the function refused. */
+} InterruptAffinityStatistics_t;
+
+/**
+ * @brief Arm the periodic pass and run a first one.
+ * @return false when the kernel timers are not running: passes then only happen on demand.
+ */
+extern bool interrupt_affinity_initialize(void);
+
+/** @brief Name the CPU that runs the authoritative tick. The BSP until told otherwise. */
+extern void interrupt_affinity_set_tick_cpu(uint32_t cpu_slot);
+
+extern uint32_t interrupt_affinity_get_tick_cpu(void);
+
+/**
+ * @brief Ask for a dedicated core for @p vector: a line with a deadline, such as audio.
+ * @return false when the table is full.
+ */
+extern bool interrupt_affinity_mark_real_time(uint8_t vector);
+
+/**
+ * @brief Keep @p vector on @p cpu_slot, whatever the load. Applied at once.
+ * @return false for a CPU that is not online, or a full table.
+ */
+extern bool interrupt_affinity_pin(uint8_t vector, uint32_t cpu_slot);
+
+/** @brief Drop a pin or a real-time mark; the next pass balances @p vector like any other. */
+extern void interrupt_affinity_unpin(uint8_t vector);
+
+/**
+ * @brief One pass now: rescan the sources, sample the rates, retarget.
+ * @return Sources moved.
+ */
+extern uint32_t interrupt_affinity_balance(void);
+
+/** @brief Copy tracked source @p index (0 to INTERRUPT_AFFINITY_MAX_SOURCES - 1). @return false past the last one. */
+extern bool interrupt_affinity_get_source(uint32_t index, InterruptAffinitySource_t *out);
+
+extern void interrupt_affinity_get_statistics(InterruptAffinityStatistics_t *out);
+
+/** @brief Name of @p policy for the console and the reports. */
+extern const char *interrupt_affinity_policy_name(InterruptAffinityPolicy_t policy);
+
+/** @brief Emit the `irq_affinity` record and one `irq_source` record per present source. */
+extern void interrupt_affinity_report(Serial_t *serial);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KERNEL_CPU_INTERRUPT_AFFINITY_H */
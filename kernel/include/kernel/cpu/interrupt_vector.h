@@ -0,0 +1,122 @@
+/**
+ * @file interrupt_vector.h
+ * @brief IDT vectors handed out to devices at run time, and what each one delivered.
+ *
+ * Every vector in use so far was picked by hand: 0x20-0x2F for the remapped 8259
+ * lines, 0x40-0x44 for the IPIs and the kernel timer. A device whose interrupt is
+ * a message rather than a line (MSI, MSI-X) names its vector itself, so it needs
+ * one that nobody else holds. This is the one place that says which.
+ *
+ * Vectors @ref INTERRUPT_VECTOR_DEVICE_BASE to @ref INTERRUPT_VECTOR_DEVICE_LAST
+ * have stubs in the IDT and no fixed owner. A block is allocated with a handler,
+ * which this module's dispatcher calls; the dispatcher then counts the delivery,
+ * on which CPU, how long the handler took, and sends the local APIC its
+ * end-of-interrupt. The handler itself acknowledges only its device.
+ *
+ * Delivery latency is the driver's to measure, since only the driver knows when
+ * the event it is told about happened (a doorbell, a period boundary); it hands
+ * each sample to interrupt_vector_record_latency().
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#ifndef KERNEL_CPU_INTERRUPT_VECTOR_H
+#define KERNEL_CPU_INTERRUPT_VECTOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/drivers/serial.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** First and last vector the allocator hands out. */
+#define INTERRUPT_VECTOR_DEVICE_BASE  0x50u
+#define INTERRUPT_VECTOR_DEVICE_COUNT 32u
+#define INTERRUPT_VECTOR_DEVICE_LAST  (INTERRUPT_VECTOR_DEVICE_BASE + INTERRUPT_VECTOR_DEVICE_COUNT - 1u)
+
+/** Largest block one allocation takes; the base is a multiple of it. */
+#define INTERRUPT_VECTOR_MAX_BLOCK 16u
+
+/** Returned by interrupt_vector_allocate() when no block is free. Never a device vector. */
+#define INTERRUPT_VECTOR_NONE 0u
+
+/**
+ * @brief A device vector's handler. Interrupt context, on the CPU the vector targets.
+ *
+ * @param vector  The vector delivered, for a handler shared by a block.
+ * @param context What was given to interrupt_vector_allocate().
+ */
+typedef void (*interrupt_vector_handler_t)(uint8_t vector, void *context);
+
+/**
+ * @struct InterruptVectorStatistics_t
+ * @brief One device vector: who holds it and what it delivered.
+ */
+typedef struct InterruptVectorStatistics {
+    uint8_t vector;
+    bool allocated;
+    const char *owner;                /**< Name given at allocation. */
+    uint32_t target_cpu;              /**< Logical slot the source was last pointed at. */
+    uint32_t deliveries;              /**< Times the handler ran. */
+    uint32_t unclaimed;               /**< Deliveries while no handler held the vector. */
+    uint32_t last_cpu;                /**< Slot of the latest delivery. */
+    uint32_t handler_average_cycles;
+    uint32_t handler_max_cycles;
+    uint32_t latency_samples;         /**< Samples the driver recorded. */
+    uint32_t latency_average_us;
+    uint32_t latency_max_us;
+    uint32_t latency_last_us;
+    uint32_t deliveries_per_cpu[CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC];
+} InterruptVectorStatistics_t;
+
+/**
+ * @brief Take @p count consecutive free vectors, the first a multiple of @p count.
+ *
+ * The alignment is what a multi-message MSI function needs: it writes its message
+ * number into the low bits of the data word, so the block's base must have them
+ * clear. Each vector starts out targeting the BSP.
+ *
+ * @param count   1, 2, 4, 8 or 16.
+ * @param owner   Name kept for the reports; not copied.
+ * @param handler Called for every vector of the block.
+ * @return The first vector, or @ref INTERRUPT_VECTOR_NONE.
+ */
+extern uint8_t interrupt_vector_allocate(uint32_t count, const char *owner, interrupt_vector_handler_t handler,
+                                         void *context);
+
+/** @brief Give back a block from interrupt_vector_allocate(). Its counters are reset on the next allocation. */
+extern void interrupt_vector_free(uint8_t vector, uint32_t count);
+
+/** @brief Whether @p vector is a device vector currently allocated. */
+extern bool interrupt_vector_is_allocated(uint8_t vector);
+
+/**
+ * @brief Record which CPU the source of @p vector now targets.
+ *
+ * Bookkeeping only: the caller has already reprogrammed the source.
+ */
+extern void interrupt_vector_note_target(uint8_t vector, uint32_t cpu_slot);
+
+/** @brief One delivery latency sample, measured by the driver. Callable from the handler. */
+extern void interrupt_vector_record_latency(uint8_t vector, uint32_t microseconds);
+
+/** @brief Copy @p vector's counters to @p out. @return false for a vector outside the device range. */
+extern bool interrupt_vector_get_statistics(uint8_t vector, InterruptVectorStatistics_t *out);
+
+/** @brief Device vectors allocated right now. */
+extern uint32_t interrupt_vector_get_allocated_count(void);
+
+/** @brief Emit one `irq_vector` record per allocated vector. */
+extern void interrupt_vector_report(Serial_t *serial);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KERNEL_CPU_INTERRUPT_VECTOR_H */
@@ -15,7 +15,7 @@
 #include <stdint.h>
 
 #define INPUT_OUTPUT_APIC_MAX_COUNT  8u
-#define INPUT_OUTPUT_APIC_MAX_ROUTES 2u
+#define INPUT_OUTPUT_APIC_MAX_ROUTES 4u
 
 typedef struct {
     uint8_t id;
@@ -99,6 +99,19 @@ input_output_advanced_programmable_interrupt_controller_get_programmed_route_is_
 extern uint16_t
 input_output_advanced_programmable_interrupt_controller_get_programmed_route_iso_flags(uint8_t route_index);
 
+/**
+ * @brief Program a masked redirection entry for one more legacy line.
+ *
+ * For device drivers whose line the scaffold does not cover, such as a PCI
+ * function's INTx as the firmware routed it onto the ISA numbering. When the
+ * MADT leaves polarity or trigger conforming, @p pci_level_triggered selects
+ * the PCI default (level, active low) instead of the ISA one (edge, active high).
+ *
+ * @return non-zero when the route exists (already or now), zero on failure.
+ */
+extern uint8_t input_output_advanced_programmable_interrupt_controller_program_isa_route(uint8_t isa_irq,
+                                                                                          uint8_t pci_level_triggered);
+
 /**
  * @brief Unmask a previously programmed ISA route in IOAPIC redirection table.
  *
@@ -38,6 +38,14 @@ extern void interrupt_request_set_timer_frequency_hz(uint32_t frequency_hz);
  */
 extern void interrupt_request_set_realtime_clock_periodic_enabled(uint8_t enabled);
 
+/**
+ * @brief Account one system tick: the body of the IRQ0 handler, without its EOI.
+ *
+ * The timer subsystem calls it from its own interrupt when the tick runs as a
+ * kernel timer rather than on vector 32.
+ */
+extern void interrupt_request_timer_tick(void);
+
 /**
  * @brief Return IRQ0 tick count since IRQ initialization.
  */
@@ -100,6 +100,42 @@ extern void isr45(void);
 extern void isr46(void);
 extern void isr47(void);
 extern void isr64(void);
+extern void isr65(void);
+extern void isr66(void);
+extern void isr67(void);
+extern void isr68(void);
+extern void isr80(void);
+extern void isr81(void);
+extern void isr82(void);
+extern void isr83(void);
+extern void isr84(void);
+extern void isr85(void);
+extern void isr86(void);
+extern void isr87(void);
+extern void isr88(void);
+extern void isr89(void);
+extern void isr90(void);
+extern void isr91(void);
+extern void isr92(void);
+extern void isr93(void);
+extern void isr94(void);
+extern void isr95(void);
+extern void isr96(void);
+extern void isr97(void);
+extern void isr98(void);
+extern void isr99(void);
+extern void isr100(void);
+extern void isr101(void);
+extern void isr102(void);
+extern void isr103(void);
+extern void isr104(void);
+extern void isr105(void);
+extern void isr106(void);
+extern void isr107(void);
+extern void isr108(void);
+extern void isr109(void);
+extern void isr110(void);
+extern void isr111(void);
 extern void isr128(void);
 
 ////////////////////////////////////////////////////////////
@@ -117,6 +153,26 @@ extern void isr128(void);
  */
 extern void interrupt_service_routine_register_handler(uint8_t interrupt_vector, isr_handler_t handler);
 
+/**
+ * @brief Return the handler currently registered for a vector.
+ *
+ * Lets a caller that borrows a vector put the previous owner back.
+ *
+ * @param interrupt_vector Interrupt vector number (0-255).
+ * @return The handler, or NULL when the default panic handling applies.
+ */
+extern isr_handler_t interrupt_service_routine_get_handler(uint8_t interrupt_vector);
+
+/**
+ * @brief Times a vector has been dispatched since boot, on any CPU.
+ *
+ * Counted for every vector whatever its handler, so a legacy line and a message
+ * can be compared on the same footing; the IRQ balancer samples it for rates.
+ *
+ * @param interrupt_vector Interrupt vector number (0-255).
+ */
+extern uint32_t interrupt_service_routine_get_delivery_count(uint8_t interrupt_vector);
+
 /**
  * @brief Set the address execution resumes at when the handler returns.
  *
@@ -138,7 +194,9 @@ extern void interrupt_frame_set_resume_address(const InterruptFrame_t *frame, ui
  * from C code.
  *
  * @param frame Pointer to the interrupt frame on the kernel stack.
+ * @return The frame the stub resumes: @p frame, or the frame of the thread the
+ *         scheduler switched to (see kernel_thread_interrupt_exit()).
  */
-extern void interrupt_service_routine_dispatch(InterruptFrame_t *frame);
+extern InterruptFrame_t *interrupt_service_routine_dispatch(InterruptFrame_t *frame);
 
 #endif /* KERNEL_CPU_INTERRUPT_SERVICE_ROUTINE_H */
@@ -298,6 +298,132 @@ bool paging_set_page_read_only(uint32_t virt_addr);
  */
 bool paging_page_is_read_only(uint32_t virt_addr, bool *is_read_only);
 
+/**
+ * @brief Memory types a page can be mapped with.
+ *
+ * @details Write-back, write-through and uncached are the PWT/PCD encodings every
+ *          IA-32 processor has. Write-combining needs the page attribute table:
+ *          paging_initialize_page_attribute_table() reprograms entry PA4 (PAT=1,
+ *          PCD=0, PWT=0) to WC and leaves PA0–PA3 at their reset values, so no
+ *          mapping that leaves the PAT bit clear changes meaning.
+ */
+typedef enum PagingMemoryType {
+    PAGING_MEMORY_TYPE_WRITE_BACK = 0u,
+    PAGING_MEMORY_TYPE_WRITE_THROUGH = 1u,
+    PAGING_MEMORY_TYPE_UNCACHED = 2u,
+    PAGING_MEMORY_TYPE_WRITE_COMBINING = 3u,
+} PagingMemoryType_t;
+
+/**
+ * @brief Program IA32_PAT on the bootstrap processor when CPUID reports PAT.
+ *
+ * @return true when write-combining is available from now on.
+ */
+bool paging_initialize_page_attribute_table(void);
+
+/**
+ * @brief Program IA32_PAT on an application processor, as the BSP did.
+ *
+ * @details Every processor must hold the same PAT, or a page shared between
+ *          them is WC on one and WB on the other.
+ */
+void paging_initialize_page_attribute_table_secondary(void);
+
+/** @return true when IA32_PAT has been programmed with a WC entry. */
+bool paging_page_attribute_table_available(void);
+
+/**
+ * @brief Set the PWT/PCD/PAT bits of @p pte_flags for @p type.
+ *
+ * @details For paging_map_page() callers. Without PAT, write-combining degrades
+ *          to write-through, the strongest ordering that still lets reads hit.
+ *
+ * @return The type actually encoded.
+ */
+PagingMemoryType_t paging_encode_memory_type(PageTableEntry_t *pte_flags, PagingMemoryType_t type);
+
+/**
+ * @brief Change the memory type of an existing mapping.
+ *
+ * @details Invalidates the local TLB entry only. A caller retyping a range
+ *          finishes with paging_commit_memory_type_change().
+ *
+ * @return true if the page was mapped.
+ */
+bool paging_set_page_memory_type(uint32_t virt_addr, PagingMemoryType_t type);
+
+/**
+ * @brief Make retyped mappings take effect everywhere.
+ *
+ * @details Writes back and invalidates the caches, so no line cached under the
+ *          old type survives into the new one, and flushes every CPU's TLB.
+ */
+void paging_commit_memory_type_change(void);
+
+/**
+ * @brief Size and mask of a PSE large page (one page directory entry, PS=1).
+ */
+#define PAGING_LARGE_PAGE_SIZE  0x00400000u
+#define PAGING_LARGE_PAGE_MASK  0xFFC00000u
+#define PAGING_LARGE_PAGE_ORDER 10u // PMM order of one 4 MiB block
+
+/**
+ * @brief Enable CR4.PSE and CR4.PGE on the bootstrap processor, as CPUID allows.
+ *
+ * @return true when 4 MiB pages can be mapped from now on.
+ */
+bool paging_initialize_page_size_extensions(void);
+
+/**
+ * @brief Enable on an application processor the CR4 bits the BSP enabled.
+ *
+ * @details The page directory is shared, so an AP without PSE would read every
+ *          large PDE as a pointer to a page table.
+ */
+void paging_initialize_page_size_extensions_secondary(void);
+
+/** @return true when CR4.PSE is set and 4 MiB pages are usable. */
+bool paging_large_pages_available(void);
+
+/** @return true when CR4.PGE is set and global PTEs survive CR3 reloads. */
+bool paging_global_pages_available(void);
+
+/**
+ * @brief Map one 4 MiB page with a single directory entry.
+ *
+ * @param virt_addr Virtual address, 4 MiB aligned
+ * @param phys_addr Physical address, 4 MiB aligned
+ * @param pde_flags Only read_write and user_supervisor are used
+ * @param type      Memory type, encoded as in paging_encode_memory_type()
+ * @return false without PSE, on misalignment, or if the directory slot is in use
+ */
+bool paging_map_large_page(uint32_t virt_addr, uint32_t phys_addr, PageDirectoryEntry_t pde_flags,
+                           PagingMemoryType_t type);
+
+/**
+ * @brief Remove the 4 MiB mapping covering @p virt_addr and shoot it down.
+ *
+ * @return false if the address is not covered by a large page.
+ */
+bool paging_unmap_large_page(uint32_t virt_addr);
+
+/** @return true if @p virt_addr is covered by a 4 MiB mapping. */
+bool paging_is_large_page(uint32_t virt_addr);
+
+/** @return Number of 4 MiB mappings currently installed. */
+uint32_t paging_get_large_page_count(void);
+
+/**
+ * @brief Set the G bit on every present 4 KiB mapping in [start_addr, end_addr).
+ *
+ * @details Meant for kernel text: global entries are kept across CR3 reloads, so
+ *          full flushes no longer evict the kernel's own code. Only ever use it on
+ *          mappings that never change.
+ *
+ * @return Number of pages marked, 0 without PGE.
+ */
+uint32_t paging_mark_range_global(uint32_t start_addr, uint32_t end_addr);
+
 /**
  * @brief Return number of runtime-created page tables currently active.
  *
@@ -26,6 +26,17 @@
 #define PERIPHERAL_COMPONENT_INTERCONNECT_REGISTER_HEADER_TYPE    0x0Eu
 #define PERIPHERAL_COMPONENT_INTERCONNECT_REGISTER_BASE_ADDRESS_0 0x10u
 #define PERIPHERAL_COMPONENT_INTERCONNECT_REGISTER_SECONDARY_BUS  0x19u
+#define PERIPHERAL_COMPONENT_INTERCONNECT_REGISTER_CAPABILITIES    0x34u
+#define PERIPHERAL_COMPONENT_INTERCONNECT_REGISTER_INTERRUPT_LINE  0x3Cu
+
+/* Status bit 4: the function has a capability list. Command bit 10: INTx is disabled. */
+#define PERIPHERAL_COMPONENT_INTERCONNECT_STATUS_CAPABILITIES_LIST  0x0010u
+#define PERIPHERAL_COMPONENT_INTERCONNECT_COMMAND_INTERRUPT_DISABLE 0x0400u
+
+/* Capability ids. */
+#define PERIPHERAL_COMPONENT_INTERCONNECT_CAPABILITY_MSI             0x05u
+#define PERIPHERAL_COMPONENT_INTERCONNECT_CAPABILITY_VENDOR_SPECIFIC 0x09u
+#define PERIPHERAL_COMPONENT_INTERCONNECT_CAPABILITY_MSIX            0x11u
 
 /* A missing device or function reads back this vendor id. */
 #define PERIPHERAL_COMPONENT_INTERCONNECT_INVALID_VENDOR_ID 0xFFFFu
@@ -164,4 +175,26 @@ extern uint8_t peripheral_component_interconnect_read_base_address_register(
     uint8_t bus, uint8_t device, uint8_t function, uint8_t index,
     PeripheralComponentInterconnectBaseAddressRegister_t *out_bar);
 
+/**
+ * @brief Find a capability in a function's capability list.
+ *
+ * The walk is bounded, so a malformed list that loops back on itself ends.
+ *
+ * @param capability_id Capability id, e.g. PERIPHERAL_COMPONENT_INTERCONNECT_CAPABILITY_MSIX.
+ * @return Config-space offset of the first capability with that id, or 0 when none.
+ */
+extern uint8_t peripheral_component_interconnect_find_capability(uint8_t bus, uint8_t device, uint8_t function,
+                                                                 uint8_t capability_id);
+
+/**
+ * @brief Decode a memory BAR's base without probing its size.
+ *
+ * Unlike peripheral_component_interconnect_read_base_address_register() nothing is
+ * written, so it is safe while the device is in use.
+ *
+ * @return The base address, or 0 for an I/O or unimplemented BAR.
+ */
+extern uint64_t peripheral_component_interconnect_read_memory_base(uint8_t bus, uint8_t device, uint8_t function,
+                                                                   uint8_t index);
+
 #endif /* KERNEL_CPU_PERIPHERAL_COMPONENT_INTERCONNECT_H */
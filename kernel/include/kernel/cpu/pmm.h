@@ -8,7 +8,8 @@
 **   - Client / Realtime build (LPL_KERNEL_REAL_TIME_MODE):
 **       Free-List LIFO stack — O(1) deterministic alloc / free.
 **   - Server build (default):
-**       Buddy Allocator — efficient contiguous allocation (not yet implemented).
+**       Buddy Allocator — efficient contiguous allocation, fronted for single
+**       pages by per-CPU caches refilled and drained in batches.
 **
 ** Coverage at boot: physical pages from 1 MB to 16 MB (boot mapping limit).
 ** Pages beyond 16 MB are registered by physical_memory_manager_extend_mapping() once the paging
@@ -67,7 +68,7 @@ extern void physical_memory_manager_page_frame_free_order(uint32_t phys_addr, ui
 /**
  * @brief Return the current number of free pages.
  *
- * @return Number of pages currently in the free pool.
+ * @return Number of pages currently in the free pool, CPU caches included.
  */
 extern uint32_t physical_memory_manager_get_free_page_count(void);
 
@@ -138,6 +139,49 @@ extern uint32_t physical_memory_manager_get_buddy_histogram(uint32_t *out_counts
  */
 extern uint32_t physical_memory_manager_get_fragmentation_ratio(void);
 
+////////////////////////////////////////////////////////////
+// Per-CPU Page Caches (server)
+////////////////////////////////////////////////////////////
+
+/** @brief Pages moved between a CPU cache and the buddy lists at once. */
+#define PHYSICAL_MEMORY_MANAGER_CACHE_BATCH 16u
+
+/** @brief Pages a CPU cache holds before a free drains one batch back. */
+#define PHYSICAL_MEMORY_MANAGER_CACHE_HIGH_WATERMARK 64u
+
+/**
+ * @brief Order-0 traffic through the per-CPU caches, and where pages came from.
+ *
+ * @details local/remote/fallback count every page the buddy hands out, to a
+ *          cache refill or to a direct request, by whether it came from the
+ *          NUMA node of the requesting CPU. The client build has no caches and
+ *          reports only those three.
+ */
+typedef struct PhysicalMemoryManagerCacheStatistics {
+    uint32_t allocations;  /**< Order-0 pages handed out from a CPU cache. */
+    uint32_t frees;        /**< Order-0 pages returned to a CPU cache. */
+    uint32_t refills;      /**< Batches taken from the buddy lists. */
+    uint32_t drains;       /**< Batches returned on the high watermark or on demand. */
+    uint32_t cached_pages; /**< Pages in all CPU caches now. */
+    uint32_t local_pages;  /**< Pages taken from the requester's own node. */
+    uint32_t remote_pages; /**< Pages taken from another node. */
+    uint32_t fallbacks;    /**< Requests the local node could not serve. */
+} PhysicalMemoryManagerCacheStatistics_t;
+
+/**
+ * @brief Copy the per-CPU cache counters into @p out.
+ */
+extern void physical_memory_manager_get_cache_statistics(PhysicalMemoryManagerCacheStatistics_t *out);
+
+/**
+ * @brief Return every page held in a CPU cache to the buddy lists.
+ *
+ * @details Runs on its own when an allocation would otherwise fail, so cached
+ *          pages never cause an out-of-memory; callers that want cached pages
+ *          coalesced (fragmentation reports) can force it.
+ */
+extern void physical_memory_manager_drain_cpu_caches(void);
+
 /**
  * @brief Extend the free pool beyond the 16 MB boot mapping limit.
  *
@@ -0,0 +1,135 @@
+/**
+ * @file tlb_shootdown.h
+ * @brief Batched TLB invalidation across CPUs.
+ *
+ * Unmapping a page has to reach every TLB that may cache it. Sending one IPI
+ * per page and waiting for every CPU to answer makes an N-page unmap N round
+ * trips. Here the unmaps of a batch are queued on the calling CPU instead, and
+ * the batch goes out as one IPI when it closes:
+ *
+ *     tlb_shootdown_begin();
+ *     for (...)
+ *         paging_unmap_page(virt);                // queued, not sent
+ *     tlb_shootdown_defer_frame_free(phys, 0u);   // freed once no TLB reaches it
+ *     tlb_shootdown_end();                        // one IPI, one wait
+ *
+ * Past TLB_SHOOTDOWN_FULL_FLUSH_THRESHOLD addresses a batch stops listing them
+ * and targets reload CR3 instead of running invlpg for each.
+ *
+ * Only CPUs that registered with tlb_shootdown_activate_cpu() are targeted, so a
+ * CPU counted online but never started cannot stall a shootdown. A CPU idling
+ * in hlt or mwait is not interrupted at all: it is marked stale and flushes its
+ * own TLB on the way out of idle, or at its next interrupt, whichever is first.
+ *
+ * Frames freed in a batch must go through tlb_shootdown_defer_frame_free():
+ * until the batch closes another CPU may still write through a stale entry.
+ * When a batch gives up waiting on a CPU that does not answer, its frames are
+ * held until that CPU has flushed or gone idle, and freed by a later batch.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#ifndef KERNEL_CPU_TLB_SHOOTDOWN_H_
+#define KERNEL_CPU_TLB_SHOOTDOWN_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <kernel/drivers/serial.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Vector the shootdown IPI is delivered on. */
+#define TLB_SHOOTDOWN_VECTOR 0x40u
+
+/** Addresses a batch lists before it turns into a full flush. */
+#define TLB_SHOOTDOWN_FULL_FLUSH_THRESHOLD 32u
+
+/**
+ * @struct TlbShootdownStatistics_t
+ * @brief Counters since boot.
+ */
+typedef struct TlbShootdownStatistics {
+    uint32_t batches;          /**< Batches that reached other CPUs. */
+    uint32_t local_batches;    /**< Batches no other CPU had to see. */
+    uint32_t pages;            /**< Addresses invalidated, through any batch. */
+    uint32_t full_flushes;     /**< Batches sent as a CR3 reload. */
+    uint32_t ipis_sent;        /**< Shootdown IPIs actually sent. */
+    uint32_t ipis_saved;       /**< IPIs one per page and per CPU would have cost on top. */
+    uint32_t lazy_skips;       /**< Idle CPUs left to flush on wake instead. */
+    uint32_t lazy_flushes;     /**< Flushes those CPUs ran on wake. */
+    uint32_t timeouts;         /**< Batches that gave up waiting for an answer. */
+    uint32_t deferred_frames;  /**< Frames freed after their batch closed. */
+    uint32_t held_frames;      /**< Deferred frames kept past a timeout until the silent CPUs flushed. */
+    uint32_t last_cycles;      /**< Latency of the last remote batch, in TSC cycles. */
+    uint32_t max_cycles;       /**< Worst remote batch latency seen. */
+} TlbShootdownStatistics_t;
+
+/**
+ * @brief Take over the shootdown vector and register the calling CPU (BSP).
+ *
+ * @details Before this runs, and while no other CPU is active, invalidation
+ *          is local only.
+ */
+extern void tlb_shootdown_initialize(void);
+
+/**
+ * @brief Make the calling CPU a shootdown target. Each AP calls it once its
+ *        IDT and LAPIC are up.
+ */
+extern void tlb_shootdown_activate_cpu(void);
+
+/**
+ * @brief Open a batch on the calling CPU. Batches nest; the outermost sends.
+ *
+ * @details Preemption is off until the matching tlb_shootdown_end(), which keeps
+ *          the batch on this CPU: nothing in between may block.
+ */
+extern void tlb_shootdown_begin(void);
+
+/** @brief Close a batch: one IPI for everything queued, then deferred frees. */
+extern void tlb_shootdown_end(void);
+
+/**
+ * @brief Invalidate @p virt_addr everywhere: queued while a batch is open on
+ *        this CPU, sent at once otherwise.
+ */
+extern void tlb_shootdown_page(uint32_t virt_addr);
+
+/** @brief Invalidate @p page_count pages from @p virt_addr as one batch. */
+extern void tlb_shootdown_range(uint32_t virt_addr, uint32_t page_count);
+
+/** @brief Flush every TLB (non-global entries) as one batch. */
+extern void tlb_shootdown_all(void);
+
+/**
+ * @brief Free a 2^@p order page block once the open batch has been seen by
+ *        every CPU.
+ *
+ * @details Without an open batch the block is freed at once. Deferred blocks
+ *          are chained through their own first words in the direct map, so
+ *          a batch can hold any number of them.
+ */
+extern void tlb_shootdown_defer_frame_free(uint32_t phys_addr, uint8_t order);
+
+/** @brief Mark the calling CPU idle: shootdowns skip it until it wakes. */
+extern void tlb_shootdown_enter_idle(void);
+
+/** @brief Leave idle, flushing first if a shootdown skipped this CPU. */
+extern void tlb_shootdown_exit_idle(void);
+
+/** @brief Copy the counters into @p out. */
+extern void tlb_shootdown_get_statistics(TlbShootdownStatistics_t *out);
+
+/** @brief Emit one `tlb_shootdown` telemetry record. */
+extern void tlb_shootdown_report(Serial_t *serial_port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !KERNEL_CPU_TLB_SHOOTDOWN_H_ */
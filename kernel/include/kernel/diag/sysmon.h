@@ -10,7 +10,9 @@
  * of what the machine is actually doing — physical-memory / buddy-allocator
  * occupancy, the kernel heap size-classes, the frame-arena / pool / stack
  * allocators, pinned (GPU) memory, the SPSC transfer ring, and the PCI bus —
- * as animated gauges, heatmaps and flowing data particles.
+ * as animated gauges, heatmaps and flowing data particles. It drains the input
+ * event ring as the engine would and shows the input-to-present latency of its
+ * own frames.
  *
  * It samples the kernel telemetry counters each frame, animates the deltas as
  * moving particles (so you literally see data move between subsystems), draws
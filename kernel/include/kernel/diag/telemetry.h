@@ -23,6 +23,11 @@
  * can fail on them: a key repeated inside one record, and a value carrying a space or
  * an '=' — either would make the line ambiguous to its own reader.
  *
+ * The line above is the record's meaning, not necessarily its wire form. When a
+ * debug console or a second UART is present, telemetry_stream.h encodes records as
+ * binary frames and writes them from idle time; its decoder prints exactly this line
+ * back. The counters below cover both paths.
+ *
  * Scope, stated so it is not mistaken for an omission: this does NOT retrofit the
  * existing prose. Rewriting every log line would churn dozens of greps in validate.sh
  * for no measurement gained. New records go through here; the old lines stay as they
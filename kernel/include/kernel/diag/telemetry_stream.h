@@ -0,0 +1,185 @@
+/**
+ * @file telemetry_stream.h
+ * @brief Telemetry records as compact binary frames, queued per CPU and written out
+ *        when a core has nothing better to do.
+ *
+ * A text record costs its caller every byte of its line on COM1 at 9600 baud: about
+ * a millisecond per character, spent spinning on the line status register. A report
+ * of a dozen fields holds its caller for a tenth of a second, which is why nothing
+ * that runs per tick has ever been allowed to publish one.
+ *
+ * This module takes the wire off the caller's path. kernel_telemetry_begin_record()
+ * and friends keep their signatures; once a fast sink is found they stop rendering
+ * text and encode the record into the current CPU's staging buffer instead, then
+ * commit it as one frame to that CPU's ring. Nothing on that path touches a port.
+ * kernel_telemetry_stream_drain() moves whole frames from the rings to the sink and
+ * is called from idle time: the job workers before they sleep, the console's halt
+ * loop, the tickless sleep.
+ *
+ * The stream, every integer a LEB128 varint:
+ *
+ *     frame  := 0xA5 type length payload checksum
+ *     HELLO  (1) := "LPLTLM" version                     once per boot
+ *     DEFINE (2) := id name                              before the first use of id
+ *     RECORD (3) := cpu sequence domain field*
+ *     TRACE  (4) := bytes                                a piece of a trace.h export
+ *     HEAP_TRACE (5) := bytes                            a piece of a heap_trace.h export
+ *     domain, key := id, or 0 followed by length and the bytes inline
+ *     field  := key kind value
+ *     kind   := 0 unsigned varint | 1 hexadecimal varint | 2 boolean byte
+ *             | 3 text length bytes
+ *
+ * `length` counts the payload; `checksum` is the low byte of the sum of type, length
+ * and payload bytes, so a reader that joins mid-stream can resynchronise on 0xA5.
+ * Domain and key names are interned once and referred to by id afterwards; a name
+ * that does not fit the table travels inline, so nothing is ever undecodable.
+ * `telemetry-decode.py` at the repository root turns the stream back into the
+ * `[LPLTLM]` lines the text path would have printed, byte for byte.
+ *
+ * Lossless by construction: a CPU whose ring is full drains it synchronously rather
+ * than dropping the record, and counts the stall. A stall is the old cost, paid once
+ * in a while instead of on every record.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#ifndef KERNEL_DIAG_TELEMETRY_STREAM_H
+#define KERNEL_DIAG_TELEMETRY_STREAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <kernel/drivers/serial.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Port QEMU and Bochs expose as a write-only console with no line discipline. */
+#define KERNEL_TELEMETRY_STREAM_DEBUGCON_PORT 0xE9u
+
+/** Baud rate of the 16550 sink when there is no debug console. */
+#define KERNEL_TELEMETRY_STREAM_SERIAL_SPEED 115200u
+
+/** Bytes of frames each CPU may hold before its producer has to drain. */
+#define KERNEL_TELEMETRY_STREAM_RING_BYTES 2048u
+
+/** Bytes one drain call moves when the caller passes no budget of its own. */
+#define KERNEL_TELEMETRY_STREAM_DEFAULT_BUDGET 256u
+
+/** Most bytes one TRACE or HEAP_TRACE frame carries. */
+#define KERNEL_TELEMETRY_STREAM_TRACE_CHUNK_BYTES 512u
+
+/** Frame type bytes, as they appear after the sync byte. */
+#define KERNEL_TELEMETRY_STREAM_SYNC             0xA5u
+#define KERNEL_TELEMETRY_STREAM_FRAME_HELLO      0x01u
+#define KERNEL_TELEMETRY_STREAM_FRAME_DEFINE     0x02u
+#define KERNEL_TELEMETRY_STREAM_FRAME_RECORD     0x03u
+#define KERNEL_TELEMETRY_STREAM_FRAME_TRACE      0x04u
+#define KERNEL_TELEMETRY_STREAM_FRAME_HEAP_TRACE 0x05u
+#define KERNEL_TELEMETRY_STREAM_VERSION          1u
+
+/** Field kinds inside a RECORD frame. */
+typedef enum KernelTelemetryFieldKind {
+    KERNEL_TELEMETRY_FIELD_UNSIGNED = 0u,
+    KERNEL_TELEMETRY_FIELD_HEXADECIMAL = 1u,
+    KERNEL_TELEMETRY_FIELD_BOOLEAN = 2u,
+    KERNEL_TELEMETRY_FIELD_TEXT = 3u,
+} KernelTelemetryFieldKind_t;
+
+/** Where binary frames go, or that they do not. */
+typedef enum KernelTelemetrySink {
+    KERNEL_TELEMETRY_SINK_TEXT = 0u,     /**< No fast sink: records stay text on the caller's port. */
+    KERNEL_TELEMETRY_SINK_DEBUGCON = 1u, /**< Port 0xE9, one OUT per byte, never waits. */
+    KERNEL_TELEMETRY_SINK_SERIAL = 2u,   /**< COM2 16550 at 115200, fed one FIFO at a time. */
+} KernelTelemetrySink_t;
+
+/**
+ * @struct KernelTelemetryStreamStatistics_t
+ * @brief What the binary path did since boot.
+ */
+typedef struct KernelTelemetryStreamStatistics {
+    KernelTelemetrySink_t sink;
+    uint32_t records;              /**< RECORD frames committed to a ring. */
+    uint32_t names;                /**< Names interned. */
+    uint32_t inline_names;         /**< Names sent inline because the table was full or they were too long. */
+    uint32_t bytes_committed;      /**< Frame bytes producers put in the rings. */
+    uint32_t bytes_written;        /**< Bytes handed to the sink, DEFINE and HELLO frames included. */
+    uint32_t drains;               /**< Drain calls that moved at least one byte. */
+    uint32_t stalls;               /**< Records whose producer found its ring full and drained it itself. */
+    uint32_t ring_high_water;      /**< Most bytes any one ring held at once. */
+    uint32_t truncated_records;    /**< Records that lost a field to the staging buffer's size. */
+    uint32_t duplicate_keys;       /**< telemetry.h's hygiene counters, for binary records. */
+    uint32_t sanitised_characters;
+    uint32_t dropped_fields;
+} KernelTelemetryStreamStatistics_t;
+
+/**
+ * @brief Probe for a fast sink and, when one answers, switch telemetry to binary.
+ *
+ * The debug console is preferred, then COM2. With neither, records keep going to
+ * the caller's port as text, exactly as before. Defining
+ * LPL_KERNEL_TELEMETRY_TEXT_ONLY at build time skips the probe.
+ *
+ * @param serial Where the prose line announcing the choice goes.
+ * @return The sink chosen.
+ */
+KernelTelemetrySink_t kernel_telemetry_stream_initialize(Serial_t *serial);
+
+/** @return true once records are encoded rather than printed. */
+bool kernel_telemetry_stream_active(void);
+
+/**
+ * @brief Move whole frames from the per-CPU rings to the sink.
+ *
+ * Never waits: a drain that finds another core draining, or the UART's FIFO full,
+ * returns at once. Safe from any CPU, with interrupts on or off.
+ *
+ * @param budget Bytes to move at most; 0 means KERNEL_TELEMETRY_STREAM_DEFAULT_BUDGET.
+ * @return Bytes handed to the sink.
+ */
+uint32_t kernel_telemetry_stream_drain(uint32_t budget);
+
+/**
+ * @brief Drain until every ring is empty and the sink has taken the last byte.
+ *
+ * For the points where the stream must be complete — before a halt, after the boot
+ * reports — and nowhere that runs per tick.
+ */
+void kernel_telemetry_stream_flush(void);
+
+/**
+ * @brief Write @p bytes as one TRACE frame, behind every record already queued.
+ *
+ * Synchronous, like kernel_telemetry_stream_flush(): for exports, not hot paths.
+ * The frames' payloads, concatenated, are the exported document.
+ *
+ * @return false in text mode or past KERNEL_TELEMETRY_STREAM_TRACE_CHUNK_BYTES;
+ *         nothing was written and the caller keeps the bytes.
+ */
+bool kernel_telemetry_stream_write_trace(const void *bytes, uint32_t length);
+
+/** @brief kernel_telemetry_stream_write_trace() for a heap_trace.h export: one HEAP_TRACE frame. */
+bool kernel_telemetry_stream_write_heap_trace(const void *bytes, uint32_t length);
+
+/** @brief Copy out the binary path's counters. */
+void kernel_telemetry_stream_get_statistics(KernelTelemetryStreamStatistics_t *out);
+
+/*
+ * Encoder interface for telemetry.c. Each call runs on the current CPU's staging
+ * buffer; begin disables interrupts and end restores them, so a record is built
+ * and committed without an interrupt handler's record landing in the middle of it.
+ */
+void kernel_telemetry_stream_begin_record(const char *domain);
+bool kernel_telemetry_stream_open_field(const char *key, KernelTelemetryFieldKind_t kind);
+void kernel_telemetry_stream_write_varint(uint32_t value);
+void kernel_telemetry_stream_write_text(const char *text, uint32_t length);
+void kernel_telemetry_stream_end_record(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KERNEL_DIAG_TELEMETRY_STREAM_H */
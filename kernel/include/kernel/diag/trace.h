@@ -0,0 +1,199 @@
+/**
+ * @file trace.h
+ * @brief Scoped TSC spans into per-CPU rings, exported as Chrome trace JSON.
+ *
+ * The WCET counters scattered through the allocators answer "how bad can it get";
+ * none of them answers "what was the machine doing when it got bad". A span does:
+ * it is a name, a CPU, a start and a duration, and a few thousand of them laid on a
+ * timeline show which interrupt landed in which present and which refill stalled
+ * which frame.
+ *
+ * Recording costs two RDTSCs and one 16-byte store. Nothing allocates: a span site
+ * is a static object that caches its name's id after the first use, and each CPU
+ * writes only its own ring, claiming a slot with an unlocked XADD — atomic against
+ * an interrupt on the same core, which is the only other writer it can have. The
+ * ring keeps the most recent events and counts what it overwrote.
+ *
+ *     void work(void)
+ *     {
+ *         KERNEL_TRACE_SCOPE("work");        // closed when work() returns
+ *         ...
+ *         KERNEL_TRACE_BEGIN(step, "work.step");
+ *         ...
+ *         KERNEL_TRACE_END(step);
+ *     }
+ *
+ * Nearly free while off: begin reads one flag and returns 0, and end does nothing
+ * with a 0. The kernel turns recording on at boot, once the rings exist, so there
+ * is always a recent past to look at. kernel_trace_export() stops recording and
+ * writes every ring as a `trace_event` document Perfetto and chrome://tracing open
+ * as is; the console's `trace` command exports and starts a new window.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#ifndef KERNEL_DIAG_TRACE_H
+#define KERNEL_DIAG_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <kernel/drivers/serial.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Events each CPU keeps; the oldest is overwritten past this. Power of two. */
+#define KERNEL_TRACE_EVENTS_PER_CPU 2048u
+
+/** Distinct span names. A site past this records under the "overflow" name. */
+#define KERNEL_TRACE_MAX_SITES 128u
+
+/** Lines bracketing the JSON when it goes out as text, so a log can be cut. */
+#define KERNEL_TRACE_EXPORT_BEGIN_MARKER "[LPLTRACE-BEGIN]"
+#define KERNEL_TRACE_EXPORT_END_MARKER   "[LPLTRACE-END]"
+
+/**
+ * @struct KernelTraceSite_t
+ * @brief One span name. Static storage; the id is filled in on first use.
+ */
+typedef struct KernelTraceSite {
+    const char *name;
+    volatile uint16_t id;
+} KernelTraceSite_t;
+
+/**
+ * @struct KernelTraceSpan_t
+ * @brief An open span: its site and the TSC it started at, 0 while tracing is off.
+ */
+typedef struct KernelTraceSpan {
+    KernelTraceSite_t *site;
+    uint64_t start;
+    uint16_t argument;
+} KernelTraceSpan_t;
+
+/**
+ * @struct KernelTraceEvent_t
+ * @brief One closed span as the ring stores it.
+ */
+typedef struct KernelTraceEvent {
+    uint64_t start;    /**< TSC at begin. */
+    uint32_t duration; /**< TSC cycles, saturated at 2^32 - 1. */
+    uint16_t site;     /**< Site id. */
+    uint16_t argument; /**< Free for the site: the vector of an IRQ span, an order for the PMM. */
+} KernelTraceEvent_t;
+
+/**
+ * @struct KernelTraceStatistics_t
+ * @brief What the tracer recorded and lost.
+ */
+typedef struct KernelTraceStatistics {
+    uint32_t rings;       /**< CPUs with a ring. */
+    uint32_t sites;       /**< Names registered. */
+    uint32_t events;      /**< Spans recorded since the last enable. */
+    uint32_t overwritten; /**< Of those, how many a full ring dropped to make room. */
+    uint32_t exported;    /**< Events written by the last export. */
+} KernelTraceStatistics_t;
+
+/** Read by the inline begin; set by kernel_trace_enable(). */
+extern volatile bool kernel_trace_recording;
+
+/**
+ * @brief Allocate one ring per discovered CPU. Once, after the heap is up.
+ *
+ * @return false when the heap could not back a ring; recording stays off.
+ */
+bool kernel_trace_initialize(void);
+
+/** @brief Clear the rings and start recording. */
+void kernel_trace_enable(void);
+
+/** @brief Stop recording; what the rings hold stays for export. */
+void kernel_trace_disable(void);
+
+static inline uint64_t kernel_trace_read_timestamp(void)
+{
+    uint32_t low;
+    uint32_t high;
+
+    __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t) high << 32) | low;
+}
+
+/** @return The TSC, or 0 while tracing is off. */
+static inline uint64_t kernel_trace_begin(void) { return kernel_trace_recording ? kernel_trace_read_timestamp() : 0u; }
+
+/** @brief Record a span that began at @p start; nothing when @p start is 0. */
+void kernel_trace_end(KernelTraceSite_t *site, uint64_t start, uint16_t argument);
+
+/**
+ * @brief kernel_trace_end() for callers with no static site, the HAL's among them.
+ *
+ * The name's address identifies it, so it must be a string with static storage.
+ */
+void kernel_trace_end_named(const char *name, uint64_t start, uint16_t argument);
+
+static inline void kernel_trace_span_close(KernelTraceSpan_t *span)
+{
+    if (span->start != 0u)
+        kernel_trace_end(span->site, span->start, span->argument);
+}
+
+#define KERNEL_TRACE_CONCATENATE_(lhs, rhs) lhs##rhs
+#define KERNEL_TRACE_CONCATENATE(lhs, rhs)  KERNEL_TRACE_CONCATENATE_(lhs, rhs)
+
+/** Open a span named @p literal that closes with the enclosing scope. */
+#define KERNEL_TRACE_SCOPE(literal)                                                                                    \
+    static KernelTraceSite_t KERNEL_TRACE_CONCATENATE(kernel_trace_site_, __LINE__) = {literal, 0u};                   \
+    KernelTraceSpan_t KERNEL_TRACE_CONCATENATE(kernel_trace_span_, __LINE__)                                           \
+        __attribute__((cleanup(kernel_trace_span_close))) = {                                                          \
+            &KERNEL_TRACE_CONCATENATE(kernel_trace_site_, __LINE__), kernel_trace_begin(), 0u}
+
+/** Open a span held in @p span, closed by KERNEL_TRACE_END(span). */
+#define KERNEL_TRACE_BEGIN(span, literal)                                                                              \
+    static KernelTraceSite_t span##_trace_site = {literal, 0u};                                                        \
+    KernelTraceSpan_t span = {&span##_trace_site, kernel_trace_begin(), 0u}
+
+#define KERNEL_TRACE_END(span) kernel_trace_span_close(&(span))
+
+/**
+ * @brief Stop recording and write every ring as Chrome `trace_event` JSON.
+ *
+ * When telemetry is binary (telemetry_stream.h) the document goes out as TRACE
+ * frames on that stream and `telemetry-decode.py --trace FILE` writes it out.
+ * Otherwise it is written as text on @p serial between the two export markers.
+ * Timestamps are microseconds since the oldest event, converted with a TSC rate
+ * measured against the tick between enable and export.
+ *
+ * @return Events written.
+ */
+uint32_t kernel_trace_export(Serial_t *serial);
+
+void kernel_trace_get_statistics(KernelTraceStatistics_t *out);
+
+/**
+ * @brief Copy the current CPU's @p count most recent events, oldest first.
+ *
+ * @return Events copied; fewer when the ring holds fewer.
+ */
+uint32_t kernel_trace_copy_recent(KernelTraceEvent_t *out, uint32_t count);
+
+/**
+ * @brief Measured cost of one span, begin to end, in TSC cycles.
+ *
+ * Times @p iterations back-to-back spans against the same loop with tracing off,
+ * so the loop itself is not charged to the tracer. Recording is left as found.
+ */
+uint32_t kernel_trace_measure_span_cycles(uint32_t iterations);
+
+/** @brief Emit the tracer's counters as a telemetry record. */
+void kernel_trace_report(Serial_t *serial);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KERNEL_DIAG_TRACE_H */
@@ -9,6 +9,8 @@
 #ifndef KERNEL_DRIVERS_FRAMEBUFFER_H
 #define KERNEL_DRIVERS_FRAMEBUFFER_H
 
+#include <kernel/cpu/paging.h>
+
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -78,6 +80,25 @@ bool framebuffer_available(void);
  */
 const framebuffer_info_t *framebuffer_get_info(void);
 
+/**
+ * @brief Memory type the LFB is mapped with.
+ *
+ * Write-combining when the PAT is programmed, write-through otherwise.
+ */
+PagingMemoryType_t framebuffer_get_memory_type(void);
+
+/**
+ * @brief Remap the LFB with another memory type, on every CPU.
+ *
+ * For comparisons like the fill-rate smoke; the driver picks WC on its own.
+ *
+ * @return The type actually in effect (WC degrades to WT without the PAT).
+ */
+PagingMemoryType_t framebuffer_set_memory_type(PagingMemoryType_t type);
+
+/** @return Pages the LFB mapping spans; covers pitch * height. */
+uint32_t framebuffer_get_mapped_page_count(void);
+
 /**
  * @brief Clear the entire screen with a color
  *
@@ -29,6 +29,12 @@ extern "C" {
 /** Codec slots the controller can report on its serial bus. */
 #define INTEL_HIGH_DEFINITION_AUDIO_MAX_CODECS 15u
 
+/** Samples in one period, the unit the controller completes: 8 ms at 16 kHz. */
+#define INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES 128u
+
+/** Periods each of the capture and playback rings holds: 512 ms. */
+#define INTEL_HIGH_DEFINITION_AUDIO_RING_PERIODS 64u
+
 /**
  * @struct IntelHighDefinitionAudioRingProbe_t
  * @brief The eight numbers that say who is waiting on whom.
@@ -93,8 +99,22 @@ typedef struct {
      */
     uint8_t outputs_muted;
     bool capture_running;                             /**< The input stream descriptor is running. */
-    uint32_t capture_position;                        /**< Link position, in bytes, at the last poll. */
+    uint32_t capture_position;                        /**< Link position, in bytes, at the last service. */
     uint32_t capture_wraps;                           /**< Times the cyclic buffer came back round. */
+    uint32_t capture_periods;                         /**< Periods the controller completed. */
+    uint32_t capture_overruns;                        /**< Periods dropped because the ring was full. */
+    bool playback_ready;                              /**< The output stream is set up, muted. */
+    bool playback_running;                            /**< The output stream is running. */
+    uint32_t playback_position;                       /**< Output link position at the last service. */
+    uint32_t playback_periods;                        /**< Periods that carried queued samples. */
+    uint32_t playback_refused;                        /**< Samples refused because the ring was full. */
+    uint8_t interrupt_line;                           /**< Legacy line taken, 0xFF when polled or on a message. */
+    uint8_t interrupt_vector;                         /**< Message vector taken, 0 when on the line or polled. */
+    bool interrupt_msix;                              /**< The message goes through MSI-X rather than MSI. */
+    bool interrupt_routed_ioapic;                     /**< The line is delivered by the IOAPIC. */
+    bool interrupts_enabled;                          /**< Stream interrupts reach the processor. */
+    uint32_t interrupts_taken;                        /**< Interrupts that named one of the streams. */
+    uint32_t stream_errors;                           /**< FIFO or descriptor errors either stream posted. */
     bool probe_captured;                              /**< A command timed out and its registers were kept. */
     uint32_t probe_command;                           /**< The command word that got no answer. */
     IntelHighDefinitionAudioRingProbe_t probe_before; /**< Rings before it was submitted. */
@@ -153,27 +173,103 @@ bool intel_high_definition_audio_command_wide(uint8_t codec, uint8_t node, uint8
  * @brief Starts capturing into a cyclic buffer.
  *
  * Sixteen kilohertz, sixteen bits, one channel — the satellite's format, chosen there
- * rather than here and passed down so there is one statement of it.
+ * rather than here and passed down so there is one statement of it. The buffer is cut
+ * into periods of @ref INTEL_HIGH_DEFINITION_AUDIO_PERIOD_SAMPLES, each of which asks
+ * for an interrupt when it is complete.
  *
  * @return true when the stream descriptor is running.
  */
 bool intel_high_definition_audio_start_capture(void);
 
 /**
- * @brief Moves whatever the controller has captured into the caller's buffer.
+ * @brief Moves finished capture periods into the ring and refills playback.
+ *
+ * The interrupt handler's whole body, exposed so the polled path runs the same code:
+ * with stream interrupts off, whoever wants audio calls this; with them on, nobody
+ * needs to, and calling it anyway is harmless.
  *
- * Polled rather than interrupt-driven, and that is a deliberate first step: an
- * interrupt handler that pushed into the ring would be the right shape, and it would
- * also be the second thing that could be wrong while the first is still unproven.
- * What this does is read the link position, notice when a buffer half has been
- * completed, and hand that half over.
+ * @return Capture periods the controller finished since the last call.
+ */
+uint32_t intel_high_definition_audio_service(void);
+
+/**
+ * @brief Lets stream interrupts reach the processor, or stops them.
+ *
+ * @param enabled Wanted state.
+ * @return The state in force: false whenever no interrupt line could be taken.
+ */
+bool intel_high_definition_audio_set_interrupts_enabled(bool enabled);
+
+/**
+ * @brief Are stream interrupts reaching the processor?
+ * @return true when the handler is the producer.
+ */
+bool intel_high_definition_audio_interrupts_enabled(void);
+
+/**
+ * @brief The capture ring's write cursor, in periods.
+ *
+ * By address, for a monitor: with interrupts on, the handler is the only thing that
+ * writes it, so a sleep armed on it ends when audio arrives and not before.
+ *
+ * @return The address, or NULL when capture is not running.
+ */
+const volatile uint32_t *intel_high_definition_audio_capture_cursor(void);
+
+/**
+ * @brief Samples waiting in the capture ring.
+ * @return The count, a multiple of the period.
+ */
+uint32_t intel_high_definition_audio_capture_available(void);
+
+/**
+ * @brief Takes @p samples from the capture ring, all or nothing.
+ *
+ * @param out                  Receives the samples.
+ * @param samples              How many; rounded down to whole periods.
+ * @param out_age_microseconds Receives how long ago, on the codec's clock, the last
+ *                             sample handed over was captured; may be NULL.
+ * @return Samples written; 0 when fewer are waiting.
+ */
+uint32_t intel_high_definition_audio_capture_read(int16_t *out, uint32_t samples, uint32_t *out_age_microseconds);
+
+/**
+ * @brief Services the streams and takes whatever fits in the caller's buffer.
+ *
+ * The polled path in one call: what @ref intel_high_definition_audio_service moves
+ * into the ring, @ref intel_high_definition_audio_capture_read hands over. Kept for
+ * callers that have no interrupt to wait on.
  *
  * @param out      Receives samples.
  * @param capacity Room in @p out, in samples.
- * @return Samples written; 0 when the controller has not finished a half yet.
+ * @return Samples written; 0 when not enough whole periods are waiting.
  */
 uint32_t intel_high_definition_audio_poll_capture(int16_t *out, uint32_t capacity);
 
+/**
+ * @brief Queues samples on the playback stream, starting it when idle.
+ *
+ * The samples are expected to have been through the HAL's limiter already. The
+ * stream's converter is bound and fed, and its output amplifiers stay muted: this
+ * driver has no path that unmutes them.
+ *
+ * @param samples Signed samples.
+ * @param count   How many.
+ * @return Samples accepted; fewer than @p count when the ring is full.
+ */
+uint32_t intel_high_definition_audio_playback_write(const int16_t *samples, uint32_t count);
+
+/**
+ * @brief Is the playback stream running?
+ * @return true until a whole lap of silence has stopped it, or a flush.
+ */
+bool intel_high_definition_audio_playback_active(void);
+
+/**
+ * @brief Drops everything queued and stops the playback stream.
+ */
+void intel_high_definition_audio_playback_flush(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,152 @@
+/**
+ * @file input_event.h
+ * @brief One timestamped stream of input events, and how old they are when shown.
+ *
+ * The keyboard and the mouse each had a ring of raw bytes, drained into characters
+ * and deltas that carried no time. The engine could not tell a keystroke that had
+ * waited three frames from one that arrived this instant, and nothing could say how
+ * long a key press took to reach the screen.
+ *
+ * Both PS/2 interrupt handlers now also publish events into one lock-free MPSC ring
+ * ("input_event"): key down and key up with the scan code, and complete pointer
+ * reports. Each carries the TSC read on entry to the interrupt that completed it,
+ * and a sequence number, so a gap means a drop. The engine drains the ring in
+ * batches.
+ *
+ * Every present is tagged with the newest event drained since the previous one.
+ * The time from that event's interrupt to the end of the present is the
+ * input-to-present latency, kept over a sliding window and reported as
+ * percentiles (`input_latency`).
+ *
+ * The ring publishes only while capture is on, which the first drain turns on: a
+ * kernel with no consumer does not fill it and then count every later event as
+ * a drop.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#ifndef KERNEL_DRIVERS_INPUT_EVENT_H
+#define KERNEL_DRIVERS_INPUT_EVENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <kernel/drivers/serial.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Events the ring holds before it refuses one. */
+#define KERNEL_INPUT_EVENT_RING_CAPACITY 256u
+
+/** Latency samples the percentiles are taken over, most recent first. */
+#define KERNEL_INPUT_EVENT_LATENCY_WINDOW 256u
+
+/** What happened. */
+typedef enum KernelInputEventType {
+    KERNEL_INPUT_EVENT_KEY_DOWN = 1u, /**< A key went down, or repeated. */
+    KERNEL_INPUT_EVENT_KEY_UP = 2u,   /**< A key came up. */
+    KERNEL_INPUT_EVENT_POINTER = 3u,  /**< One pointer report: motion and the buttons held. */
+} KernelInputEventType_t;
+
+/** The key's scan code came after an 0xE0 prefix (arrows, right ctrl, AltGr...). */
+#define KERNEL_INPUT_EVENT_FLAG_EXTENDED 0x01u
+
+/**
+ * @struct KernelInputEvent_t
+ * @brief One event, as the interrupt handler saw it.
+ */
+typedef struct KernelInputEvent {
+    uint64_t timestamp; /**< TSC on entry to the interrupt that completed the event. */
+    uint32_t sequence;  /**< From 1, one per event produced; a gap is a drop. */
+    uint8_t type;       /**< KernelInputEventType_t. */
+    uint8_t code;       /**< Keys: set-1 make code, break bit cleared. */
+    uint8_t flags;      /**< KERNEL_INPUT_EVENT_FLAG_*. */
+    uint8_t buttons;    /**< Pointer: bit 0 left, bit 1 right, bit 2 middle. */
+    int16_t delta_x;    /**< Pointer: right is positive. */
+    int16_t delta_y;    /**< Pointer: up is positive, as the device reports it. */
+} KernelInputEvent_t;
+
+/**
+ * @struct KernelInputEventStatistics_t
+ * @brief Counters of the ring and the latency window.
+ */
+typedef struct KernelInputEventStatistics {
+    bool ready;                  /**< The ring is backed. */
+    bool capturing;              /**< Handlers publish into it. */
+    uint32_t produced;           /**< Events published. */
+    uint32_t dropped;            /**< Events refused by a full ring. */
+    uint32_t keys;               /**< Key events published. */
+    uint32_t pointers;           /**< Pointer events published. */
+    uint32_t drained;            /**< Events handed to a consumer. */
+    uint32_t drains;             /**< Drains that returned at least one event. */
+    uint32_t high_watermark;     /**< Most events waiting at once. */
+    uint32_t presents;           /**< Presents seen. */
+    uint32_t tagged_presents;    /**< Of which showed newly drained input. */
+    uint32_t last_sequence;      /**< Newest event the last tagged present showed. */
+    uint32_t samples;            /**< Latency samples in the window. */
+    uint32_t latency_p50_us;     /**< Over the window. */
+    uint32_t latency_p90_us;
+    uint32_t latency_p99_us;
+    uint32_t latency_max_us;     /**< Since boot. */
+    uint32_t latency_last_us;    /**< Of the last tagged present. */
+} KernelInputEventStatistics_t;
+
+/**
+ * @brief Back the ring with the heap and declare it to the backpressure registry.
+ *
+ * Until then the handlers publish nothing.
+ *
+ * @return false when the heap cannot back it.
+ */
+extern bool kernel_input_event_initialize(void);
+
+/** @brief Turn publishing on or off. Draining turns it on. */
+extern void kernel_input_event_set_capture(bool enabled);
+
+/** @brief true while the handlers publish into the ring. */
+extern bool kernel_input_event_is_capturing(void);
+
+/**
+ * @brief Keyboard side: one raw scan code byte. Interrupt context.
+ *
+ * Prefixes are folded into the event they announce; the pause key's sequence,
+ * which has no break code, is swallowed.
+ */
+extern void kernel_input_event_publish_scancode(uint8_t scancode, uint64_t timestamp);
+
+/** @brief Pointer side: one complete report. Interrupt context. */
+extern void kernel_input_event_publish_pointer(int32_t delta_x, int32_t delta_y, uint32_t buttons,
+                                               uint64_t timestamp);
+
+/**
+ * @brief Move up to @p capacity events, oldest first, into @p events.
+ *
+ * The newest one becomes what the next present is tagged with.
+ *
+ * @return Events moved; 0 when none are waiting.
+ */
+extern uint32_t kernel_input_event_drain(KernelInputEvent_t *events, uint32_t capacity);
+
+/** @brief Events waiting in the ring. */
+extern uint32_t kernel_input_event_pending_count(void);
+
+/**
+ * @brief Tag the frame just presented with the newest drained event, and take
+ *        one latency sample if there is one. Called at the end of every present.
+ */
+extern void kernel_input_event_note_present(void);
+
+extern void kernel_input_event_get_statistics(KernelInputEventStatistics_t *out);
+
+/** @brief Emit the `input_latency` record. */
+extern void kernel_input_event_report(Serial_t *serial);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KERNEL_DRIVERS_INPUT_EVENT_H */
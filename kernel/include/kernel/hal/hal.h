@@ -88,15 +88,62 @@ void hardware_abstraction_layer_display_clear(uint32_t color_rgb);
  */
 uint32_t hardware_abstraction_layer_display_read_pixel(uint32_t x, uint32_t y);
 
+/** @brief A surface-space rectangle, in pixels. */
+typedef struct {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+} hardware_abstraction_layer_display_rect_t;
+
+/**
+ * @brief Record that a region of the surface changed since the last present.
+ *
+ * The next present only transfers what was marked. Rectangles are clipped to
+ * the surface and merged as they arrive; a present with nothing marked sends
+ * the whole surface, so callers that never mark damage keep working unchanged.
+ * clear() marks the whole surface. The software LFB ignores it.
+ */
+void hardware_abstraction_layer_display_mark_damage(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
 /**
  * @brief Present the back buffer (atomic flip / scanout).
  *
  * The software-LFB path renders straight into scanout memory, so present is a
- * no-op today; it exists so the VirtIO-GPU backend can slot in behind the same
- * contract without touching the engine.
+ * no-op there. The virtio-gpu backend copies the damaged regions into whichever
+ * of its two GPU resources is idle, queues the transfer and the flip, and
+ * returns without waiting for the device; it only blocks when both resources
+ * are still in flight.
+ *
+ * Each present is tagged with the newest input event drained since the last
+ * one; see hardware_abstraction_layer_input_get_latency().
  */
 void hardware_abstraction_layer_display_present(void);
 
+/** @brief What presenting has cost so far (all zero on the software LFB). */
+typedef struct {
+    uint32_t presents;              /* presents issued                                  */
+    uint32_t rects_last;            /* rectangles transferred by the last present       */
+    uint32_t bytes_last;            /* pixel bytes transferred by the last present      */
+    uint64_t bytes_total;           /* pixel bytes transferred, all presents            */
+    uint32_t stall_cycles_last;     /* TSC cycles the last present waited on the device */
+    uint32_t stall_cycles_max;      /* worst such wait                                  */
+    uint64_t stall_cycles_total;    /* all such waits                                   */
+    uint32_t stalled_presents;      /* presents that found no idle resource             */
+    uint32_t completion_interrupts; /* device interrupts that retired commands          */
+    uint32_t errors;                /* commands answered with anything but OK_NODATA    */
+    uint8_t buffer_count;           /* 2 when double-buffered, 1 when synchronous       */
+    uint8_t interrupt_line;         /* legacy INTx line, 0xFF when polling or on MSI-X  */
+    uint8_t interrupt_vector;       /* MSI-X vector, 0 when on the line or polling      */
+} hardware_abstraction_layer_display_present_statistics_t;
+
+/**
+ * @brief Snapshot the present counters.
+ * @return false when no backend keeps any (software LFB).
+ */
+bool hardware_abstraction_layer_display_get_present_statistics(
+    hardware_abstraction_layer_display_present_statistics_t *out_statistics);
+
 /* ----------------------------------------------------------------------------
  * Clock (tick contract + sub-tick timestamp)
  * ------------------------------------------------------------------------- */
@@ -119,6 +166,49 @@ uint32_t hardware_abstraction_layer_clock_tick_hertz(void);
  */
 uint64_t hardware_abstraction_layer_clock_timestamp_counter(void);
 
+/**
+ * @brief Open a span on the kernel's tracer (one per engine system update).
+ * @return Token for hardware_abstraction_layer_clock_trace_end(); 0 while tracing is off.
+ */
+uint64_t hardware_abstraction_layer_clock_trace_begin(void);
+
+/**
+ * @brief Close a span opened by hardware_abstraction_layer_clock_trace_begin().
+ *
+ * @p name is keyed by address: pass a string literal (or other static storage),
+ * the same one for every frame. Spans land on the exporting CPU's timeline next
+ * to the kernel's IRQ, allocator and present spans.
+ */
+void hardware_abstraction_layer_clock_trace_end(const char *name, uint64_t token);
+
+/**
+ * @brief Pace a fixed timestep with a kernel timer at @p hertz.
+ *
+ * The timer counts steps as they fall due, re-armed from its own deadline so the
+ * cadence does not drift with the frame's work. A second call changes the rate;
+ * 0 stops it. Arm it only for a loop that paces itself with
+ * hardware_abstraction_layer_clock_step_wait(): a step nobody waits on is a
+ * precise interrupt on the tick CPU for nothing.
+ *
+ * @return false when the kernel has no deadline timer; the caller keeps its own pacing.
+ */
+bool hardware_abstraction_layer_clock_step_schedule(uint32_t hertz);
+
+/**
+ * @brief Steps fallen due since the first schedule (wraps; consumers use modular deltas).
+ * @return The step count.
+ */
+uint32_t hardware_abstraction_layer_clock_step_count(void);
+
+/**
+ * @brief Sleep until the step count moves past @p seen.
+ *
+ * Returns at once when it already has, or when no step is scheduled.
+ *
+ * @return The step count on return.
+ */
+uint32_t hardware_abstraction_layer_clock_step_wait(uint32_t seen);
+
 /* ----------------------------------------------------------------------------
  * Input (decoded-character ring drained by the engine)
  * ------------------------------------------------------------------------- */
@@ -185,6 +275,60 @@ uint32_t hardware_abstraction_layer_input_pointer_interrupt_count(void);
  */
 uint32_t hardware_abstraction_layer_input_pointer_resynchronization_count(void);
 
+/** @brief Event kinds of hardware_abstraction_layer_input_event_t. */
+#define HARDWARE_ABSTRACTION_LAYER_INPUT_EVENT_KEY_DOWN 1u
+#define HARDWARE_ABSTRACTION_LAYER_INPUT_EVENT_KEY_UP   2u
+#define HARDWARE_ABSTRACTION_LAYER_INPUT_EVENT_POINTER  3u
+
+/** @brief The key's scan code followed an 0xE0 prefix (arrows, right ctrl, AltGr). */
+#define HARDWARE_ABSTRACTION_LAYER_INPUT_EVENT_FLAG_EXTENDED 0x01u
+
+/** @brief One input event, stamped when its interrupt arrived. */
+typedef struct {
+    uint64_t timestamp; /* TSC, the clock of hardware_abstraction_layer_clock_timestamp_counter() */
+    uint32_t sequence;  /* from 1, one per event produced; a gap means events were dropped   */
+    uint8_t type;       /* HARDWARE_ABSTRACTION_LAYER_INPUT_EVENT_*                          */
+    uint8_t code;       /* keys: set-1 make code (break bit cleared)                         */
+    uint8_t flags;      /* HARDWARE_ABSTRACTION_LAYER_INPUT_EVENT_FLAG_*                     */
+    uint8_t buttons;    /* pointer: bit 0 left, bit 1 right, bit 2 middle                    */
+    int16_t delta_x;    /* pointer: rightward                                                */
+    int16_t delta_y;    /* pointer: upward, as the device reports it                         */
+} hardware_abstraction_layer_input_event_t;
+
+/**
+ * @brief Drain up to @p capacity timestamped events, oldest first, in one call.
+ *
+ * Key down/up with scan codes and whole pointer reports, from one ring both
+ * interrupt handlers feed. It fills only once something drains it, so the first
+ * call may return nothing. The newest event drained is what the next present is
+ * measured against (input-to-present latency).
+ *
+ * Independent of the character and pointer pops above: those keep their own
+ * rings, and a caller uses one interface or the other.
+ *
+ * @return Events written to @p out_events.
+ */
+uint32_t hardware_abstraction_layer_input_drain_events(hardware_abstraction_layer_input_event_t *out_events,
+                                                       uint32_t capacity);
+
+/** @brief Input-to-present latency over the recent presents that showed new input. */
+typedef struct {
+    uint32_t samples;        /* presents in the window                     */
+    uint32_t p50_us;         /* median                                     */
+    uint32_t p90_us;         /*                                            */
+    uint32_t p99_us;         /*                                            */
+    uint32_t max_us;         /* worst since boot                           */
+    uint32_t last_us;        /* of the last present that showed new input  */
+    uint32_t last_sequence;  /* newest event that present showed           */
+    uint32_t dropped_events; /* events the ring refused                    */
+} hardware_abstraction_layer_input_latency_t;
+
+/**
+ * @brief Snapshot the input-to-present latency.
+ * @return false when the event ring is not available.
+ */
+bool hardware_abstraction_layer_input_get_latency(hardware_abstraction_layer_input_latency_t *out_latency);
+
 /* ----------------------------------------------------------------------------
  * Console (diagnostic text sink)
  *
@@ -508,6 +652,16 @@ bool hardware_abstraction_layer_virtio_gpu_create_scanout(hardware_abstraction_l
  */
 bool hardware_abstraction_layer_virtio_gpu_flush(hardware_abstraction_layer_virtio_gpu_scanout_t *scanout);
 
+/**
+ * @brief Present only @p rects: one TRANSFER_TO_HOST_2D per rectangle, then a
+ *        single RESOURCE_FLUSH of their bounding box. Synchronous.
+ * @param rects Rectangles inside the surface; @p count of them, at least one.
+ * @return true when every command completed with OK_NODATA.
+ */
+bool hardware_abstraction_layer_virtio_gpu_flush_rects(hardware_abstraction_layer_virtio_gpu_scanout_t *scanout,
+                                                       const hardware_abstraction_layer_display_rect_t *rects,
+                                                       uint32_t count);
+
 /* ----------------------------------------------------------------------------
  * Persistent virtio-gpu display routing (kernel-internal)
  *
@@ -552,11 +706,24 @@ void hardware_abstraction_layer_virtio_gpu_display_clear(uint32_t color_rgb);
  */
 uint32_t hardware_abstraction_layer_virtio_gpu_display_read_pixel(uint32_t x, uint32_t y);
 
+/** @brief Add a damaged rectangle to the pending present (clipped, merged). */
+void hardware_abstraction_layer_virtio_gpu_display_mark_damage(uint32_t x, uint32_t y, uint32_t width,
+                                                               uint32_t height);
+
 /**
- * @brief Present the scanout (TRANSFER_TO_HOST_2D + RESOURCE_FLUSH).
+ * @brief Present the damaged regions of the scanout.
+ *
+ * Double-buffered: the damage is copied into the idle resource, its transfers,
+ * SET_SCANOUT and RESOURCE_FLUSH are queued without waiting, and completion is
+ * retired by the device interrupt. Falls back to a synchronous flush of a single
+ * resource when the second one or the interrupt line is unavailable.
  */
 void hardware_abstraction_layer_virtio_gpu_display_present(void);
 
+/** @brief Snapshot the presenter's counters; false when no scanout is live. */
+bool hardware_abstraction_layer_virtio_gpu_display_get_statistics(
+    hardware_abstraction_layer_display_present_statistics_t *out_statistics);
+
 #ifdef __cplusplus
 }
 #endif
@@ -24,12 +24,12 @@
  * reports a level alongside its buffer count.
  *
  * The ring is exposed by ADDRESS as well as by value, because that is what the power
- * floor will need: `processor_sleep_until_write` arms a watch on the write index and
+ * floor needs: `processor_sleep_until_write` arms a watch on the write cursor and
  * sleeps until the producer touches it, which is the difference between a node that
- * idles at a few watts and one that idles at twenty. That path waits on an interrupt
- * handler this driver does not have yet — today the producer is
- * @ref hardware_abstraction_layer_audio_capture_pump, called by the profile's loop,
- * which is why the loop sleeps to its frame deadline instead.
+ * idles at a few watts and one that idles at twenty. The producer is the controller's
+ * interrupt handler, one eight-millisecond period at a time. Where no interrupt line
+ * could be taken — or when the satellite measures what the handler is worth — the
+ * same ring is filled by @ref hardware_abstraction_layer_audio_capture_pump instead.
  *
  * @author MasterLaplace
  * @version 0.1.0
@@ -50,9 +50,6 @@ extern "C" {
 /** Samples in one capture or playback buffer: forty milliseconds at 16 kHz. */
 #define KERNEL_HAL_AUDIO_FRAME_SAMPLES 640u
 
-/** Buffers the capture ring holds before it overwrites the oldest. */
-#define KERNEL_HAL_AUDIO_RING_FRAMES 8u
-
 /**
  * @brief Hard ceiling on anything this kernel will ever play, in dBFS.
  *
@@ -106,30 +103,41 @@ const char *hardware_abstraction_layer_audio_device_name(void);
 uint32_t hardware_abstraction_layer_audio_sample_rate(void);
 
 /**
- * @brief The capture ring's write index.
+ * @brief The capture ring's write index, counted in controller periods.
  *
  * Returned as an address so a caller can arm a monitor on it. Volatile because the
- * producer is an interrupt handler — or, on real hardware, a DMA engine that does not
- * even take an interrupt to advance it.
+ * producer is an interrupt handler.
  *
  * @return The address, or NULL when there is no codec.
  */
 const volatile uint32_t *hardware_abstraction_layer_audio_capture_write_index(void);
 
 /**
- * @brief Moves whatever the controller has finished into the ring.
+ * @brief Moves whatever the controller has finished into the ring — polled path only.
  *
- * The producer side, and it has to be called: the driver underneath is POLLED, not
- * interrupt-driven, so nothing advances the write index on its own. That is why the
- * satellite loop pumps and then sleeps to its frame deadline rather than sleeping on
- * the write index — arming a monitor on an address only this thread ever writes is a
- * wait for something that cannot happen. When an interrupt handler eventually pushes
- * buffers, the monitor path becomes the right one and this becomes a no-op.
+ * A no-op while the capture is interrupt-driven: the handler is the producer, and
+ * the consumer should sleep on @ref hardware_abstraction_layer_audio_capture_write_index
+ * instead. With interrupts off this is the producer, and a loop that does not call it
+ * waits for something that cannot happen.
  *
- * @return Buffers moved into the ring.
+ * @return Controller periods moved into the ring.
  */
 uint32_t hardware_abstraction_layer_audio_capture_pump(void);
 
+/**
+ * @brief Is the capture ring filled by the interrupt handler?
+ * @return true when it is; false when polled, or with no codec.
+ */
+bool hardware_abstraction_layer_audio_capture_interrupt_driven(void);
+
+/**
+ * @brief Switches the capture between interrupt-driven and polled.
+ *
+ * @param enabled true for the interrupt handler.
+ * @return The mode in force; a machine with no usable line stays polled.
+ */
+bool hardware_abstraction_layer_audio_set_capture_interrupt_driven(bool enabled);
+
 /**
  * @brief Takes the oldest unread capture buffer.
  *
@@ -139,6 +147,17 @@ uint32_t hardware_abstraction_layer_audio_capture_pump(void);
  */
 uint32_t hardware_abstraction_layer_audio_capture_take(int16_t *out, uint32_t capacity);
 
+/**
+ * @brief How old the last buffer taken was when it was taken.
+ *
+ * From the end of its last sample to the take, on the codec's own clock — the stream
+ * bytes captured in between — so it needs no calibrated timer and means the same in
+ * both capture modes.
+ *
+ * @return Microseconds.
+ */
+uint32_t hardware_abstraction_layer_audio_capture_latency_microseconds(void);
+
 /**
  * @brief Sets the output gain, in thousandths of the ceiling.
  *
@@ -184,9 +203,12 @@ uint32_t hardware_abstraction_layer_audio_clipped_samples(void);
 /**
  * @brief Queues a buffer for playback.
  *
+ * Limited first, then queued on the codec's playback stream, whose output amplifiers
+ * stay muted. At most @ref KERNEL_HAL_AUDIO_FRAME_SAMPLES per call.
+ *
  * @param samples Signed samples.
  * @param count   How many.
- * @return true when the codec accepted it.
+ * @return true when the codec accepted all of it.
  */
 bool hardware_abstraction_layer_audio_playback_submit(const int16_t *samples, uint32_t count);
 
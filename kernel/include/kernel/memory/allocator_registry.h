@@ -0,0 +1,121 @@
+/**
+ * @file allocator_registry.h
+ * @brief Every pool, frame arena, stack and TLSF allocator instance, by name.
+ *
+ * Each of the allocator types can have any number of instances: the
+ * default one behind the original single-instance functions, the per-CPU frame
+ * arenas, and whatever a subsystem creates for its own objects. An instance
+ * registers itself when it is initialized and withdraws when it is destroyed,
+ * so the reconciler and sysmon see all of them without knowing who made them.
+ *
+ * The registry only finds an instance's counters; it never owns them. Like the
+ * backpressure registry it is not locked: instances are set up and torn down
+ * from task context, not from interrupt handlers.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#ifndef KERNEL_MEMORY_ALLOCATOR_REGISTRY_H_
+#define KERNEL_MEMORY_ALLOCATOR_REGISTRY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <kernel/drivers/serial.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Instances the registry can hold. Registration past this is refused; the instance still works. */
+#define KERNEL_ALLOCATOR_REGISTRY_MAX_ENTRIES 64u
+
+/**
+ * @brief The type behind a registered instance.
+ */
+typedef enum {
+    KERNEL_ALLOCATOR_KIND_POOL = 0,        /**< Fixed-size objects; usage counts objects. */
+    KERNEL_ALLOCATOR_KIND_FRAME_ARENA = 1, /**< Bump allocator reset as a whole; usage counts bytes. */
+    KERNEL_ALLOCATOR_KIND_STACK = 2,       /**< LIFO with markers; usage counts bytes. */
+    KERNEL_ALLOCATOR_KIND_TLSF = 3,        /**< Two-level segregated fit; usage counts bytes, headers included. */
+    KERNEL_ALLOCATOR_KIND_COUNT = 4,
+} KernelAllocatorKind_t;
+
+/**
+ * @struct KernelAllocatorUsage_t
+ * @brief One instance's occupancy and timing, in the unit of its kind.
+ */
+typedef struct KernelAllocatorUsage {
+    uint32_t capacity;            /**< Objects (pool) or bytes (arena, stack, TLSF). */
+    uint32_t used;                /**< Held now. */
+    uint32_t peak;                /**< Most ever held at once. */
+    uint32_t allocations;         /**< Successful allocations since initialization. */
+    uint32_t failures;            /**< Refused allocations. */
+    uint32_t resets;              /**< Frees (pool, TLSF), resets (arena) or rollbacks (stack). */
+    uint32_t wcet_alloc_cycles;   /**< Worst allocation seen, in TSC cycles. */
+    uint32_t wcet_release_cycles; /**< Worst free, reset or rollback seen. */
+} KernelAllocatorUsage_t;
+
+/** Reads @p instance's counters into @p out. */
+typedef void (*KernelAllocatorUsageFunction_t)(const void *instance, KernelAllocatorUsage_t *out);
+
+/**
+ * @struct KernelAllocatorEntry_t
+ * @brief A registered instance.
+ */
+typedef struct KernelAllocatorEntry {
+    const char *name;                     /**< Instance name; a telemetry field value. */
+    KernelAllocatorKind_t kind;           /**< Which type the instance is. */
+    const void *instance;                 /**< The instance; also the key for unregistering. */
+    KernelAllocatorUsageFunction_t usage; /**< Reads its counters. */
+} KernelAllocatorEntry_t;
+
+/**
+ * @brief Declare an instance. Called by the allocators' own initializers.
+ *
+ * @return false when the table is full or an argument is missing.
+ */
+extern bool kernel_allocator_registry_register(const char *name, KernelAllocatorKind_t kind, const void *instance,
+                                               KernelAllocatorUsageFunction_t usage);
+
+/** @brief Withdraw the entry registered for @p instance, if any. */
+extern void kernel_allocator_registry_unregister(const void *instance);
+
+/** @brief Number of registered instances. */
+extern uint32_t kernel_allocator_registry_get_count(void);
+
+/**
+ * @brief Access a registered instance by index.
+ *
+ * @return The entry, or NULL when @p index is out of range.
+ */
+extern const KernelAllocatorEntry_t *kernel_allocator_registry_get(uint32_t index);
+
+/** @brief Read an entry's counters. Zeroes @p out for a NULL entry. */
+extern void kernel_allocator_registry_get_usage(const KernelAllocatorEntry_t *entry, KernelAllocatorUsage_t *out);
+
+/**
+ * @brief Sum the usage of every instance of @p kind.
+ *
+ * @details Capacities, used and peak add up; the WCETs are the worst of any.
+ *
+ * @return Instances summed.
+ */
+extern uint32_t kernel_allocator_registry_sum(KernelAllocatorKind_t kind, KernelAllocatorUsage_t *out);
+
+/** @brief Refused allocations across every registered instance. */
+extern uint32_t kernel_allocator_registry_get_total_failures(void);
+
+/** @brief Short name of @p kind, for telemetry. */
+extern const char *kernel_allocator_kind_name(KernelAllocatorKind_t kind);
+
+/** @brief Emit one `allocator` telemetry record per registered instance. */
+extern void kernel_allocator_registry_report(Serial_t *serial);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !KERNEL_MEMORY_ALLOCATOR_REGISTRY_H_ */
@@ -38,7 +38,7 @@ extern "C" {
 #endif
 
 /** Bounded queues the registry can hold. Registration past this is refused, not ignored. */
-#define KERNEL_BACKPRESSURE_MAX_QUEUES 8u
+#define KERNEL_BACKPRESSURE_MAX_QUEUES 16u
 
 /**
  * @brief What is lost when a full queue refuses an item.
@@ -54,6 +54,9 @@ typedef enum {
 /** Reads a queue's own drop counter. The registry never owns the count, only finds it. */
 typedef uint32_t (*KernelBackpressureDropCountFunction_t)(void);
 
+/** The same, for a queue type with many instances: reads @p instance's counter. */
+typedef uint32_t (*KernelBackpressureInstanceDropCountFunction_t)(const void *instance);
+
 /**
  * @brief A bounded queue as declared to the registry.
  */
@@ -61,7 +64,9 @@ typedef struct {
     const char *name;                                 /**< Queue name, used as a telemetry field. */
     KernelBackpressurePolicy_t policy;                /**< What a loss costs. */
     uint32_t capacity_items;                          /**< Items the ring holds before refusing. */
-    KernelBackpressureDropCountFunction_t drop_count; /**< The queue's own counter. */
+    KernelBackpressureDropCountFunction_t drop_count; /**< The queue's own counter; NULL for an instance. */
+    KernelBackpressureInstanceDropCountFunction_t instance_drop_count; /**< An instance's counter. */
+    const void *instance;                                              /**< Argument of instance_drop_count. */
 } KernelBackpressureQueue_t;
 
 /**
@@ -83,6 +88,30 @@ void kernel_backpressure_reset(void);
 bool kernel_backpressure_register(const char *name, KernelBackpressurePolicy_t policy, uint32_t capacity_items,
                                   KernelBackpressureDropCountFunction_t drop_count);
 
+/**
+ * @brief Declare one instance of a queue type that registers itself on creation.
+ *
+ * Rings register here from kernel_ring_initialize(), so a ring cannot exist
+ * without the registry knowing what dropping on it costs.
+ *
+ * @param instance Passed back to @p drop_count; also the key for unregistering.
+ * @return As kernel_backpressure_register().
+ */
+bool kernel_backpressure_register_instance(const char *name, KernelBackpressurePolicy_t policy,
+                                           uint32_t capacity_items,
+                                           KernelBackpressureInstanceDropCountFunction_t drop_count,
+                                           const void *instance);
+
+/**
+ * @brief Withdraw the queue registered for @p instance, if any.
+ */
+void kernel_backpressure_unregister_instance(const void *instance);
+
+/**
+ * @brief Read a registered queue's drop counter, whichever way it was declared.
+ */
+uint32_t kernel_backpressure_get_queue_drop_count(const KernelBackpressureQueue_t *queue);
+
 /**
  * @brief Number of registered queues.
  *
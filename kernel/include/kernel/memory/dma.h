@@ -0,0 +1,125 @@
+/**
+ * @file dma.h
+ * @brief Physically contiguous DMA buffers carved from buddy blocks.
+ *
+ * A device that reads a ring, a descriptor list or a scanout surface wants one
+ * physical base and a length, not a scatter list: kernel_pinned_alloc() maps one
+ * frame per page and leaves the physical side wherever the freelist put it. This
+ * allocator takes one block of the buddy's order API instead. A buddy block is
+ * aligned to its own size, so alignment and a "never cross N bytes" boundary both
+ * reduce to choosing a large enough order; the pages past the request are handed
+ * back as the smaller blocks they split into.
+ *
+ * Small orders are kept in a per-order cache of blocks split once at boot, so a
+ * driver claiming a descriptor page at runtime does not walk the buddy lists, and
+ * releasing it does not merge what the next claim would split again.
+ *
+ *     KernelDmaBuffer_t ring;
+ *     if (kernel_dma_alloc(4096u, 128u, 65536u, PAGING_MEMORY_TYPE_UNCACHED, &ring))
+ *         write32(RING_BASE, ring.physical_address);
+ *     ...
+ *     kernel_dma_free(ring.virtual_address);
+ *
+ * The real-time PMM has no blocks above order 0: there, only single-page
+ * requests are served.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#ifndef KERNEL_MEMORY_DMA_H_
+#define KERNEL_MEMORY_DMA_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <kernel/cpu/paging.h>
+#include <kernel/drivers/serial.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Live buffers tracked at once; kernel_dma_free() finds its buffer here. */
+#define KERNEL_DMA_MAX_BUFFERS 64u
+
+/** Highest order kept in the block cache (order 4 = 64 KiB). */
+#define KERNEL_DMA_CACHE_MAX_ORDER 4u
+
+/** Blocks the cache holds per order, and splits at boot. */
+#define KERNEL_DMA_CACHE_DEPTH 4u
+
+/**
+ * @struct KernelDmaBuffer_t
+ * @brief One contiguous buffer: both sides of the mapping in one place.
+ */
+typedef struct KernelDmaBuffer {
+    void *virtual_address;     /**< Kernel mapping, of the requested memory type. */
+    uint32_t physical_address; /**< What the device is programmed with. */
+    uint32_t size;             /**< Bytes mapped, the request rounded to pages. */
+} KernelDmaBuffer_t;
+
+/**
+ * @struct KernelDmaStatistics_t
+ * @brief Counters since boot, and what is live now.
+ */
+typedef struct KernelDmaStatistics {
+    uint32_t allocations;      /**< Buffers handed out. */
+    uint32_t frees;            /**< Buffers returned. */
+    uint32_t failures;         /**< Requests refused: constraints, memory or registry. */
+    uint32_t cache_hits;       /**< Blocks served from the cache. */
+    uint32_t cache_misses;     /**< Blocks taken from the buddy. */
+    uint32_t cached_blocks;    /**< Blocks sitting in the cache now. */
+    uint32_t live_buffers;     /**< Buffers not yet freed. */
+    uint32_t live_pages;       /**< Pages those buffers hold. */
+    uint32_t trimmed_pages;    /**< Pages past a request given back, since boot. */
+    uint32_t largest_order;    /**< Largest block order ever taken. */
+} KernelDmaStatistics_t;
+
+/**
+ * @brief Fill the block cache. Call once the buddy holds all of memory.
+ *
+ * @return true once the allocator can be used, cache filled or not.
+ */
+extern bool kernel_dma_initialize(void);
+
+/**
+ * @brief Allocate a physically contiguous, mapped buffer.
+ *
+ * @param size      Bytes, rounded up to pages.
+ * @param alignment Physical alignment in bytes, a power of two; 0 means a page.
+ * @param boundary  Physical boundary the buffer must not cross, a power of two;
+ *                  0 means none. Must be at least @p size.
+ * @param type      Memory type of the kernel mapping.
+ * @param out       Receives the buffer; zeroed on failure.
+ * @return false when a constraint cannot be met or memory is short.
+ */
+extern bool kernel_dma_alloc(uint32_t size, uint32_t alignment, uint32_t boundary, PagingMemoryType_t type,
+                             KernelDmaBuffer_t *out);
+
+/**
+ * @brief Release a buffer by its virtual address.
+ *
+ * @return false if @p virtual_address is not the start of a live DMA buffer.
+ */
+extern bool kernel_dma_free(void *virtual_address);
+
+/**
+ * @brief Look up the buffer @p virtual_address points into.
+ *
+ * @return false if no live DMA buffer contains it.
+ */
+extern bool kernel_dma_find(const void *virtual_address, KernelDmaBuffer_t *out);
+
+/** @brief Copy the counters into @p out. */
+extern void kernel_dma_get_statistics(KernelDmaStatistics_t *out);
+
+/** @brief Emit one `dma` telemetry record, PMM fragmentation included. */
+extern void kernel_dma_report(Serial_t *serial_port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !KERNEL_MEMORY_DMA_H_ */
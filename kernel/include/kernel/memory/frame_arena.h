@@ -8,10 +8,83 @@
 #ifndef KERNEL_MEMORY_FRAME_ARENA_H_
 #define KERNEL_MEMORY_FRAME_ARENA_H_
 
+#include <kernel/memory/allocator_registry.h>
+
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+/**
+ * @struct KernelFrameArena_t
+ * @brief One bump arena over a single backing block, cleared as a whole.
+ *
+ * Allocation and clear are O(1) (clear is O(used) only with poisoning) and
+ * time themselves. An instance is not locked.
+ */
+typedef struct KernelFrameArena {
+    uint8_t *base;
+    const char *name;
+    uint32_t capacity;
+    uint32_t offset;
+    uint32_t peak;
+    uint32_t reset_count;
+    uint32_t allocations;
+    uint32_t failed_alloc_count;
+    uint32_t budget;
+    uint32_t budget_exceeded_count;
+    uint32_t wcet_alloc;
+    uint32_t wcet_reset;
+    uint32_t epoch;
+    bool owns_arena;
+} KernelFrameArena_t;
+
+/**
+ * @brief Set up @p arena with @p capacity_bytes (rounded up to 16) from the heap
+ *        and register it under @p name.
+ */
+extern bool kernel_frame_arena_init(KernelFrameArena_t *arena, const char *name, uint32_t capacity_bytes);
+
+/** @brief kernel_frame_arena_init() on an arena that itself comes from the heap. */
+extern KernelFrameArena_t *kernel_frame_arena_create(const char *name, uint32_t capacity_bytes);
+
+/** @brief Withdraw the arena from the registry and free what it allocated. */
+extern void kernel_frame_arena_destroy(KernelFrameArena_t *arena);
+
+/** @return @p size bytes aligned to @p align (8 when 0), or NULL past capacity or budget. */
+extern void *kernel_frame_arena_allocate(KernelFrameArena_t *arena, uint32_t size, uint32_t align);
+
+/** @brief Drop every allocation of @p arena at once. */
+extern void kernel_frame_arena_clear(KernelFrameArena_t *arena);
+
+/** @brief Refuse allocations that would end past @p budget_bytes; 0 disables the budget. */
+extern void kernel_frame_arena_set_budget(KernelFrameArena_t *arena, uint32_t budget_bytes);
+
+/** @brief Fill @p out with the arena's counters, in bytes. */
+extern void kernel_frame_arena_get_usage(const KernelFrameArena_t *arena, KernelAllocatorUsage_t *out);
+
+/*
+ * Per-CPU scratch arenas, one per discovered logical slot, named
+ * "frame_arena_cpuN". kernel_frame_arena_tick() runs from the timer tick and
+ * only advances an epoch; each arena clears itself on its owner's first local
+ * access after the epoch moved. Memory from kernel_frame_arena_local_alloc() is
+ * therefore valid until the calling CPU allocates locally again after the next
+ * tick, and must never be handed to another CPU.
+ */
+extern bool kernel_frame_arena_per_cpu_initialize(uint32_t capacity_bytes);
+
+extern void kernel_frame_arena_tick(void);
+
+/** @return The calling CPU's arena, cleared if a tick passed, or NULL when none exists. */
+extern KernelFrameArena_t *kernel_frame_arena_local(void);
+
+extern void *kernel_frame_arena_local_alloc(uint32_t size, uint32_t align);
+
+/*
+ * The kernel's frame arena, "kernel_frame_arena". The functions below are the
+ * original single-instance interface and forward to it.
+ */
+extern KernelFrameArena_t *kernel_frame_arena_get_default(void);
+
 extern bool kernel_frame_arena_initialize(uint32_t capacity_bytes);
 
 extern void *kernel_frame_arena_alloc(uint32_t size, uint32_t align);
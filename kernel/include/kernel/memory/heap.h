@@ -53,6 +53,16 @@ extern void *kmalloc(size_t size);
 
 extern void *kmalloc_sensitive(size_t size);
 
+/**
+ * @brief Allocate for the engine's C++ runtime.
+ *
+ * On the client profile the block comes from the engine's own TLSF instance
+ * ("engine_tlsf"), so engine objects and kernel objects do not fragment each
+ * other's pools; kfree() tells the two apart. Requests the instance cannot
+ * serve, and every request on the server profile, fall back to kmalloc().
+ */
+extern void *kmalloc_engine(size_t size);
+
 extern void kfree(void *ptr);
 
 extern const char *kernel_heap_get_strategy_name(void);
@@ -70,6 +80,10 @@ extern uint32_t kernel_heap_debug_get_double_free_count(void);
 /**
  * @brief Enter the client hot loop allocation guard scope.
  *
+ * Entering the outermost scope first tops the TLSF instances back up to their
+ * headroom, adding pools from the buddy if needed; leaving it does the same.
+ * Inside the scope no pool is ever added.
+ *
  * @note Server builds expose a no-op implementation.
  */
 extern void kernel_heap_hot_loop_enter(void);
@@ -112,6 +126,14 @@ extern uint32_t kernel_heap_get_hot_loop_violation_count(void);
  */
 extern uint32_t kernel_heap_get_hot_loop_bounded_count(void);
 
+/** @return The engine's TLSF instance, or NULL on server builds or before the heap is up. */
+extern struct KernelTlsf *kernel_heap_get_engine_tlsf(void);
+
+/** @brief TLSF pools the client heap has added since boot, and attempts the buddy refused. */
+extern uint32_t kernel_heap_get_tlsf_extension_count(void);
+
+extern uint32_t kernel_heap_get_tlsf_extension_failure_count(void);
+
 /**
  * @brief Return available free blocks in a server size class.
  *
@@ -128,6 +150,12 @@ extern uint32_t kernel_heap_get_size_class_free_count(uint32_t size_class_index)
  */
 extern uint32_t kernel_heap_get_size_class_hit_count(uint32_t size_class_index);
 
+/*
+ * Server domains are logical CPU slots, each with its own magazines. "Remote"
+ * counters describe the exchange with the shared depot: a probe is a miss in
+ * both of a slot's magazines, a hit is a probe that came back with a full
+ * magazine. Remote frees are blocks a slot freed on behalf of their owner.
+ */
 extern bool kernel_heap_set_server_active_domain(uint32_t domain_index);
 extern uint32_t kernel_heap_get_server_domain_count(void);
 extern uint32_t kernel_heap_get_server_active_domain(void);
@@ -135,6 +163,10 @@ extern uint32_t kernel_heap_get_server_domain_refill_count(uint32_t domain_index
 extern uint32_t kernel_heap_get_server_domain_first_fit_fallback_count(uint32_t domain_index);
 extern uint32_t kernel_heap_get_server_domain_remote_probe_count(uint32_t domain_index);
 extern uint32_t kernel_heap_get_server_domain_remote_hit_count(uint32_t domain_index);
+extern uint32_t kernel_heap_get_server_domain_remote_free_count(uint32_t domain_index);
+extern uint32_t kernel_heap_get_server_domain_remote_drain_count(uint32_t domain_index);
+extern uint32_t kernel_heap_get_server_depot_full_count(uint32_t size_class_index);
+extern uint32_t kernel_heap_get_server_magazine_rounds(void);
 
 extern void kernel_heap_initialize_ap_domain(uint32_t logical_slot);
 extern uint32_t kernel_heap_get_server_per_cpu_hit_count(uint32_t slot);
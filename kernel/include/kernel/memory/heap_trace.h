@@ -0,0 +1,146 @@
+/**
+ * @file heap_trace.h
+ * @brief Every kmalloc and kfree, in order, for replay off the machine.
+ *
+ * The heap's counters say how many blocks each path served and how slow the worst
+ * one was; they cannot say which sequence of requests produced that, and without
+ * the sequence a change to a size class or a headroom is tuned blind. The trace is
+ * that sequence: one fixed-size binary event per call, in the order the calls
+ * claimed their slots, with the request, the block it produced, the path that
+ * served it, the CPU, the TSC and the caller's return address.
+ *
+ * The capture keeps the FIRST events rather than the latest: a replay has to
+ * start from the same empty heap the kernel started from, so a trace missing its
+ * beginning is worthless while one missing its end is merely short. Once the
+ * buffer is full, further calls are counted as dropped and not recorded.
+ *
+ * Off, a call costs one load of a flag. On, it claims a slot with one XADD and
+ * writes 24 bytes; nothing allocates, the buffer is reserved from the VMM once.
+ *
+ * The export is a document of a fixed header followed by the events, packed and
+ * little-endian. On a binary telemetry stream it travels as HEAP_TRACE frames,
+ * which `telemetry-decode.py --heap-trace FILE` writes out; otherwise it goes to
+ * the serial port as hex lines between the two markers below. Either form is what
+ * `tools/heap-replay` reads.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#ifndef KERNEL_MEMORY_HEAP_TRACE_H
+#define KERNEL_MEMORY_HEAP_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <kernel/drivers/serial.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Events the capture holds. 24 bytes each: 384 KiB of VMM pages. */
+#define KERNEL_HEAP_TRACE_MAX_EVENTS 16384u
+
+/** Document header fields. */
+#define KERNEL_HEAP_TRACE_MAGIC   "LPLHTRC"
+#define KERNEL_HEAP_TRACE_VERSION 1u
+
+/** Lines bracketing the hex dump when it goes out as text, so a log can be cut. */
+#define KERNEL_HEAP_TRACE_EXPORT_BEGIN_MARKER "[LPLHEAPTRACE-BEGIN]"
+#define KERNEL_HEAP_TRACE_EXPORT_END_MARKER   "[LPLHEAPTRACE-END]"
+
+/** What an event records. */
+typedef enum KernelHeapTraceOperation {
+    KERNEL_HEAP_TRACE_OPERATION_ALLOC = 1u,           /**< kmalloc(). */
+    KERNEL_HEAP_TRACE_OPERATION_FREE = 2u,            /**< kfree(). */
+    KERNEL_HEAP_TRACE_OPERATION_ENGINE_ALLOC = 3u,    /**< kmalloc_engine(). */
+    KERNEL_HEAP_TRACE_OPERATION_SENSITIVE_ALLOC = 4u, /**< kmalloc_sensitive(). */
+} KernelHeapTraceOperation_t;
+
+/**
+ * @struct KernelHeapTraceEvent_t
+ * @brief One call, as the capture and the export store it.
+ *
+ * A free is recorded before its block is released: once released, another CPU
+ * may be handed the same address, and its allocation must not come first.
+ */
+typedef struct KernelHeapTraceEvent {
+    uint64_t timestamp; /**< TSC when an allocation returned, or when a free started. */
+    uint32_t id;        /**< The payload address: returned, or freed. 0 for a failed allocation. */
+    uint32_t size;      /**< Bytes requested; 0 for a free. */
+    uint32_t caller;    /**< Return address of the kmalloc/kfree call. */
+    uint8_t operation;  /**< KernelHeapTraceOperation_t. */
+    uint8_t cpu;        /**< Logical slot of the caller. */
+    uint8_t path;       /**< Heap block flags of the block served or freed: which allocator. */
+    uint8_t reserved;
+} __attribute__((packed)) KernelHeapTraceEvent_t;
+
+_Static_assert(sizeof(KernelHeapTraceEvent_t) == 24u, "heap trace events are 24 bytes on the wire");
+
+/**
+ * @struct KernelHeapTraceHeader_t
+ * @brief The export's first bytes.
+ */
+typedef struct KernelHeapTraceHeader {
+    char magic[8];        /**< KERNEL_HEAP_TRACE_MAGIC, NUL-padded. */
+    uint32_t version;     /**< KERNEL_HEAP_TRACE_VERSION. */
+    uint32_t event_size;  /**< sizeof(KernelHeapTraceEvent_t). */
+    uint32_t events;      /**< Events that follow. */
+    uint32_t dropped;     /**< Calls made after the capture filled. */
+    uint32_t real_time;   /**< 1 for the client heap (slab + TLSF), 0 for the server heap. */
+    uint32_t reserved;
+} __attribute__((packed)) KernelHeapTraceHeader_t;
+
+_Static_assert(sizeof(KernelHeapTraceHeader_t) == 32u, "heap trace header is 32 bytes on the wire");
+
+/**
+ * @struct KernelHeapTraceStatistics_t
+ * @brief What the capture holds.
+ */
+typedef struct KernelHeapTraceStatistics {
+    bool recording;
+    uint32_t capacity; /**< Events the buffer holds; 0 before initialization. */
+    uint32_t events;   /**< Events recorded. */
+    uint32_t dropped;  /**< Calls past the capacity. */
+    uint32_t exported; /**< Events written by the last export. */
+} KernelHeapTraceStatistics_t;
+
+/** Read by the heap on every call; set by kernel_heap_trace_start(). */
+extern volatile bool kernel_heap_trace_recording;
+
+/**
+ * @brief Reserve the capture buffer. Once, after the VMM is up.
+ *
+ * @return false when the VMM could not back it; recording stays off.
+ */
+bool kernel_heap_trace_initialize(void);
+
+/** @brief Empty the capture and start recording. */
+void kernel_heap_trace_start(void);
+
+/** @brief Stop recording once the calls already recording have finished; the capture stays for export. */
+void kernel_heap_trace_stop(void);
+
+/** @brief Record one call. The heap's entry points call this; nothing else should. */
+void kernel_heap_trace_record(KernelHeapTraceOperation_t operation, uint32_t size, const void *pointer, uint8_t path,
+                              const void *caller);
+
+/**
+ * @brief Stop recording and write the header and every event out.
+ *
+ * @return Events written.
+ */
+uint32_t kernel_heap_trace_export(Serial_t *serial);
+
+void kernel_heap_trace_get_statistics(KernelHeapTraceStatistics_t *out);
+
+/** @brief Emit the capture's counters as a `heap_trace` record. */
+void kernel_heap_trace_report(Serial_t *serial);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KERNEL_MEMORY_HEAP_TRACE_H */
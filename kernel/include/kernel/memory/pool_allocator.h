@@ -8,9 +8,64 @@
 #ifndef KERNEL_MEMORY_POOL_ALLOCATOR_H_
 #define KERNEL_MEMORY_POOL_ALLOCATOR_H_
 
+#include <kernel/memory/allocator_registry.h>
+
 #include <stdbool.h>
 #include <stdint.h>
 
+/**
+ * @struct KernelPool_t
+ * @brief One pool: a free list threaded through equal slots of one backing block.
+ *
+ * Allocation and free are O(1) and time themselves; the worst of each is kept.
+ * An instance is not locked: it belongs to one owner, or its owner locks it.
+ */
+typedef struct KernelPool {
+    uint8_t *base;
+    void *free_head;
+    const char *name;
+    uint32_t slot_size;
+    uint32_t object_size;
+    uint32_t capacity;
+    uint32_t free_count;
+    uint32_t peak_used;
+    uint32_t allocations;
+    uint32_t frees;
+    uint32_t failed_alloc_count;
+    uint32_t wcet_alloc;
+    uint32_t wcet_free;
+    bool owns_pool;
+} KernelPool_t;
+
+/**
+ * @brief Set up @p pool with @p object_count slots from the heap and register it
+ *        under @p name.
+ *
+ * @return false on a bad argument or when the heap cannot back the slots.
+ */
+extern bool kernel_pool_init(KernelPool_t *pool, const char *name, uint32_t object_size, uint32_t object_count);
+
+/** @brief kernel_pool_init() on a pool that itself comes from the heap. */
+extern KernelPool_t *kernel_pool_create(const char *name, uint32_t object_size, uint32_t object_count);
+
+/** @brief Withdraw the pool from the registry and free what it allocated. */
+extern void kernel_pool_destroy(KernelPool_t *pool);
+
+/** @return A free slot, or NULL when the pool is exhausted. */
+extern void *kernel_pool_allocate(KernelPool_t *pool);
+
+/** @return false if @p ptr is not a slot of @p pool currently handed out. */
+extern bool kernel_pool_release(KernelPool_t *pool, void *ptr);
+
+/** @brief Fill @p out with the pool's counters, in objects. */
+extern void kernel_pool_get_usage(const KernelPool_t *pool, KernelAllocatorUsage_t *out);
+
+/*
+ * The kernel's general-purpose pool, "kernel_pool". The functions below are
+ * the original single-instance interface and forward to it.
+ */
+extern KernelPool_t *kernel_pool_get_default(void);
+
 extern bool kernel_pool_allocator_initialize(uint32_t object_size, uint32_t object_count);
 
 extern void *kernel_pool_alloc(void);
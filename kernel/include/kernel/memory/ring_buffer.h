@@ -8,6 +8,8 @@
 #ifndef KERNEL_MEMORY_RING_BUFFER_H_
 #define KERNEL_MEMORY_RING_BUFFER_H_
 
+#include <kernel/memory/backpressure.h>
+
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -18,6 +20,138 @@ typedef enum KernelRingBufferMode {
     KERNEL_RING_BUFFER_MODE_MPMC = 3u,
 } KernelRingBufferMode_t;
 
+/**
+ * @struct KernelRingCell_t
+ * @brief Per-slot sequence number (Vyukov's bounded queue) and payload length.
+ *
+ * A slot at position p is free for the producer of p while its sequence is p,
+ * holds p's item once it reads p + 1, and is free again for p + capacity once
+ * the consumer stores p + capacity. Positions are free-running 32-bit counters.
+ */
+typedef struct KernelRingCell {
+    volatile uint32_t sequence;
+    uint32_t length;
+} KernelRingCell_t;
+
+/**
+ * @struct KernelRing_t
+ * @brief One ring instance. Producer and consumer cursors sit on their own
+ *        cache lines so the two sides do not bounce a line between them.
+ *
+ * The cursors double as the enqueue/dequeue totals, so the fast path touches
+ * no counter besides them. Which sides take a CAS follows the mode: LOCAL and
+ * SPSC claim with plain stores, MPSC shares the producer side, MPMC both.
+ */
+typedef struct KernelRing {
+    volatile uint32_t tail __attribute__((aligned(64)));
+    volatile uint32_t head __attribute__((aligned(64)));
+    KernelRingCell_t *cells __attribute__((aligned(64)));
+    uint8_t *slots;
+    const char *name;
+    uint32_t mask;
+    uint32_t slot_size;
+    KernelRingBufferMode_t mode;
+    volatile uint32_t high_watermark;
+    volatile uint32_t failed_enqueue_count;
+    volatile uint32_t failed_dequeue_count;
+    bool owns_ring;
+} KernelRing_t;
+
+/**
+ * @struct KernelRingBatch_t
+ * @brief A run of consecutive slots claimed by one reserve or acquire.
+ */
+typedef struct KernelRingBatch {
+    uint32_t position;
+    uint32_t count;
+} KernelRingBatch_t;
+
+/**
+ * @brief Set up @p ring with storage from the heap and declare it to the
+ *        backpressure registry under @p name.
+ *
+ * @param slot_count Rounded up to a power of two, at least 2.
+ * @param policy What a refused enqueue costs; see backpressure.h.
+ * @return false on a bad argument or when the heap cannot back the slots.
+ */
+extern bool kernel_ring_initialize(KernelRing_t *ring, const char *name, uint32_t slot_size, uint32_t slot_count,
+                                   KernelRingBufferMode_t mode, KernelBackpressurePolicy_t policy);
+
+/** @brief kernel_ring_initialize() on a ring that itself comes from the heap. */
+extern KernelRing_t *kernel_ring_create(const char *name, uint32_t slot_size, uint32_t slot_count,
+                                        KernelRingBufferMode_t mode, KernelBackpressurePolicy_t policy);
+
+/** @brief Withdraw the ring from the registry and free what the ring allocated. */
+extern void kernel_ring_destroy(KernelRing_t *ring);
+
+/**
+ * @brief Claim the next slot for writing in place.
+ *
+ * @param position Receives the ticket to pass to kernel_ring_commit().
+ * @return The slot, slot_size bytes, or NULL when the ring is full.
+ */
+extern void *kernel_ring_reserve(KernelRing_t *ring, uint32_t *position);
+
+/** @brief Publish a reserved slot holding @p length bytes. */
+extern void kernel_ring_commit(KernelRing_t *ring, uint32_t position, uint32_t length);
+
+/**
+ * @brief Claim the oldest published slot for reading in place.
+ *
+ * @param length Receives the committed length; may be NULL.
+ * @return The slot, or NULL when the ring is empty.
+ */
+extern const void *kernel_ring_acquire(KernelRing_t *ring, uint32_t *position, uint32_t *length);
+
+/** @brief Hand an acquired slot back to the producers. */
+extern void kernel_ring_release(KernelRing_t *ring, uint32_t position);
+
+/**
+ * @brief Claim up to @p count consecutive slots with a single cursor update.
+ *
+ * @return Slots granted, possibly fewer than asked; 0 when the ring is full.
+ */
+extern uint32_t kernel_ring_reserve_batch(KernelRing_t *ring, uint32_t count, KernelRingBatch_t *batch);
+
+/** @brief Publish every slot of @p batch, each holding @p length bytes. */
+extern void kernel_ring_commit_batch(KernelRing_t *ring, const KernelRingBatch_t *batch, uint32_t length);
+
+/** @return Slots granted, oldest first; 0 when the ring is empty. */
+extern uint32_t kernel_ring_acquire_batch(KernelRing_t *ring, uint32_t count, KernelRingBatch_t *batch);
+
+extern void kernel_ring_release_batch(KernelRing_t *ring, const KernelRingBatch_t *batch);
+
+/** @brief Slot @p index of a reserved or acquired batch. */
+extern void *kernel_ring_batch_slot(const KernelRing_t *ring, const KernelRingBatch_t *batch, uint32_t index);
+
+/** @brief Copying front ends over reserve/commit and acquire/release. */
+extern bool kernel_ring_enqueue(KernelRing_t *ring, const void *data, uint32_t size);
+extern bool kernel_ring_dequeue(KernelRing_t *ring, void *out_data, uint32_t out_size);
+
+/**
+ * @brief Copy up to @p count items of @p item_size bytes in or out through one
+ *        batch claim.
+ *
+ * @return Items transferred.
+ */
+extern uint32_t kernel_ring_enqueue_batch(KernelRing_t *ring, const void *items, uint32_t item_size,
+                                          uint32_t count);
+extern uint32_t kernel_ring_dequeue_batch(KernelRing_t *ring, void *items, uint32_t item_size, uint32_t count);
+
+extern uint32_t kernel_ring_get_capacity(const KernelRing_t *ring);
+extern uint32_t kernel_ring_get_count(const KernelRing_t *ring);
+extern uint32_t kernel_ring_get_enqueue_count(const KernelRing_t *ring);
+extern uint32_t kernel_ring_get_dequeue_count(const KernelRing_t *ring);
+extern uint32_t kernel_ring_get_failed_enqueue_count(const KernelRing_t *ring);
+extern uint32_t kernel_ring_get_failed_dequeue_count(const KernelRing_t *ring);
+extern uint32_t kernel_ring_get_high_watermark(const KernelRing_t *ring);
+
+/*
+ * The kernel's general-purpose ring, "kernel_ring". The functions below are
+ * the original single-instance interface and forward to it.
+ */
+extern KernelRing_t *kernel_ring_buffer_get_default(void);
+
 extern bool kernel_ring_buffer_initialize(uint32_t slot_size, uint32_t slot_count);
 
 extern bool kernel_ring_buffer_initialize_ex(uint32_t slot_size, uint32_t slot_count, KernelRingBufferMode_t mode);
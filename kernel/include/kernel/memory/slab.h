@@ -2,57 +2,143 @@
 ** LplKernel
 ** kernel/include/kernel/memory/slab.h
 **
-** Fixed-size slab allocator.
+** Slab caches of fixed-size objects.
 **
-** CLIENT profile: three statically-backed caches (16 B / 64 B / 256 B).
-**   All objects are vended from pages pre-allocated in the boot pool.
-**   Allocation and free are O(1) with no runtime PMM calls.
+** A cache is created for one object size, alignment and optional
+** constructor. It grows a page at a time from a reserve of pages taken
+** from the buddy once, at boot, so growth never calls the PMM and stays
+** bounded: at most KERNEL_SLAB_CACHE_MAX_PAGES pages per cache, and
+** carving a page costs at most PAGE_SIZE / stride iterations.
 **
-** SERVER profile: stub — returns NULL / no-op so heap.c falls through
-**   to the first-fit path.
+** Each logical CPU keeps a small stack of objects per cache in front of
+** the cache's shared free-list; allocation and free touch only that
+** stack, with interrupts off, until it runs empty or full, and then move
+** KERNEL_SLAB_CPU_CACHE_BATCH objects under the cache lock.
+**
+** kmalloc's client path goes through a geometric table of caches
+** ("kmalloc-16" .. "kmalloc-1024"); kernel_slab_alloc() and
+** kernel_slab_free() are that table's entry points.
 */
 
 #ifndef KERNEL_MEMORY_SLAB_H_
 #define KERNEL_MEMORY_SLAB_H_
 
+#include <kernel/drivers/serial.h>
+
 #include <stdbool.h>
 #include <stdint.h>
 
-/* Supported object sizes.  Keep in sync with the array in slab.c. */
+/* Historic fixed sizes; still size classes of the kmalloc table. */
 #define KERNEL_SLAB_SIZE_SMALL  16u
 #define KERNEL_SLAB_SIZE_MEDIUM 64u
 #define KERNEL_SLAB_SIZE_LARGE  256u
 
-/* Maximum number of pages any single cache may own (client boot pool). */
-#define KERNEL_SLAB_CACHE_MAX_PAGES 2u
+/* Maximum number of pages any single cache may own. */
+#define KERNEL_SLAB_CACHE_MAX_PAGES 8u
+
+/* Caches that can exist at once, the kmalloc classes included. */
+#define KERNEL_SLAB_MAX_CACHES 32u
+
+/* Objects a CPU keeps per cache, and how many move at a time. */
+#define KERNEL_SLAB_CPU_CACHE_DEPTH 8u
+#define KERNEL_SLAB_CPU_CACHE_BATCH 4u
+
+/* Largest request, header included, the kmalloc table serves. */
+#define KERNEL_SLAB_KMALLOC_MAX_SIZE 1024u
+
+/* Pages the slab reserves at boot, as one buddy block of this order. */
+#ifdef LPL_KERNEL_REAL_TIME_MODE
+#    define KERNEL_SLAB_RESERVE_ORDER 7u
+#else
+#    define KERNEL_SLAB_RESERVE_ORDER 5u
+#endif
+#define KERNEL_SLAB_RESERVE_PAGES (1u << KERNEL_SLAB_RESERVE_ORDER)
+
+typedef struct KernelSlabCache KernelSlabCache_t;
+
+/* Runs once on each object when its page is carved, not on every allocation:
+   objects are expected back in their constructed state. */
+typedef void (*KernelSlabConstructor_t)(void *object);
+
+typedef struct KernelSlabCacheStatistics {
+    uint32_t object_size;
+    uint32_t align;
+    uint32_t stride;
+    uint32_t pages;
+    uint32_t objects;
+    uint32_t used;
+    uint32_t cached;         /* free objects parked in per-CPU stacks */
+    uint32_t hits;           /* allocations served by the CPU's own stack */
+    uint32_t misses;         /* allocations that refilled from the shared list */
+    uint32_t grows;          /* pages carved */
+    uint32_t alloc_failures; /* allocations refused: cache at its bound or reserve empty */
+    uint32_t rejected_frees; /* foreign pointers, double frees, broken canaries */
+    uint32_t wcet_alloc_cycles;
+    uint32_t wcet_free_cycles;
+} KernelSlabCacheStatistics_t;
+
+/*
+ * Reserve the backing pages and build the kmalloc table. Called once from
+ * kernel_heap_initialize(), after the PMM owns all of memory.
+ */
+extern void kernel_slab_initialize(void);
+
+/*
+ * Create a cache of `size`-byte objects aligned to `align` (8 when 0, a
+ * power of two otherwise). `ctor` may be NULL. The cache starts empty and
+ * grows on demand; `name` must outlive it.
+ * Returns NULL when the arguments are invalid or every cache slot is taken.
+ */
+extern KernelSlabCache_t *kernel_slab_cache_create(const char *name, uint32_t size, uint32_t align,
+                                                   KernelSlabConstructor_t ctor);
 
 /*
- * Initialise all slab caches.  Called once from kernel_heap_initialize()
- * AFTER the physical pages for the boot pool have been mapped.
- *
- * backing_pages[]: array of virtual addresses (already mapped) to donate
- *                  to the slab subsystem.
- * page_count: number of entries in that array.
+ * Return the cache's pages to the reserve. Refused (false) while objects
+ * are live. The caller guarantees no CPU uses the cache concurrently.
  */
-extern void kernel_slab_initialize(void **backing_pages, uint32_t page_count);
+extern bool kernel_slab_cache_destroy(KernelSlabCache_t *cache);
 
 /*
- * Attempt to allocate an object of exactly `size` bytes from the slab.
- * Returns a pointer to the object, or NULL if no matching cache exists
- * or the cache is exhausted.
+ * Grow the cache until it holds `objects` free objects or hits its bound,
+ * so a real-time section can then allocate without carving.
+ * Returns true when the target was reached.
+ */
+extern bool kernel_slab_cache_prefill(KernelSlabCache_t *cache, uint32_t objects);
+
+extern void *kernel_slab_cache_alloc(KernelSlabCache_t *cache);
+
+/*
+ * Returns false, and changes nothing, for an object not handed out by
+ * this cache or already free.
+ */
+extern bool kernel_slab_cache_free(KernelSlabCache_t *cache, void *object);
+
+extern const char *kernel_slab_cache_get_name(const KernelSlabCache_t *cache);
+
+extern void kernel_slab_cache_get_statistics(const KernelSlabCache_t *cache, KernelSlabCacheStatistics_t *out);
+
+/*
+ * Allocate from the smallest kmalloc class of at least `size` bytes.
+ * Returns NULL above KERNEL_SLAB_KMALLOC_MAX_SIZE or when the class is
+ * exhausted; the heap then falls through to TLSF.
  */
 extern void *kernel_slab_alloc(uint32_t size);
 
 /*
- * Return an object to its cache.  ptr must have been returned by
- * kernel_slab_alloc(); passing any other pointer is a no-op (guarded by
- * the cache ownership check).
+ * Return an object to whichever cache owns its page. Any pointer outside
+ * the slab reserve is rejected in O(1).
  * Returns true when the object was accepted, false otherwise.
  */
 extern bool kernel_slab_free(void *ptr);
 
-/* Telemetry helpers (per-cache). */
+/* Telemetry helpers (per kmalloc class, by exact class size). */
 extern uint32_t kernel_slab_get_free_count(uint32_t object_size);
 extern uint32_t kernel_slab_get_used_count(uint32_t object_size);
 
+extern uint32_t kernel_slab_get_cache_count(void);
+extern uint32_t kernel_slab_get_reserve_free_pages(void);
+
+/* One `slab` record for the reserve, then one `slab_cache` record per cache. */
+extern void kernel_slab_report(Serial_t *serial);
+
 #endif /* !KERNEL_MEMORY_SLAB_H_ */
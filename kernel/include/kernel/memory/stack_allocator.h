@@ -8,10 +8,62 @@
 #ifndef KERNEL_MEMORY_STACK_ALLOCATOR_H_
 #define KERNEL_MEMORY_STACK_ALLOCATOR_H_
 
+#include <kernel/memory/allocator_registry.h>
+
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+/**
+ * @struct KernelStackAllocator_t
+ * @brief One LIFO allocator: push, take a marker, roll back to it.
+ *
+ * Push and rollback are O(1) and time themselves. An instance is not locked.
+ */
+typedef struct KernelStackAllocator {
+    uint8_t *base;
+    const char *name;
+    uint32_t capacity;
+    uint32_t offset;
+    uint32_t peak;
+    uint32_t alloc_count;
+    uint32_t rollback_count;
+    uint32_t failed_alloc_count;
+    uint32_t wcet_push;
+    uint32_t wcet_rollback;
+    bool owns_stack;
+} KernelStackAllocator_t;
+
+/**
+ * @brief Set up @p stack with @p capacity_bytes (rounded up to 16) from the heap
+ *        and register it under @p name.
+ */
+extern bool kernel_stack_allocator_init(KernelStackAllocator_t *stack, const char *name, uint32_t capacity_bytes);
+
+/** @brief kernel_stack_allocator_init() on an allocator that itself comes from the heap. */
+extern KernelStackAllocator_t *kernel_stack_allocator_create(const char *name, uint32_t capacity_bytes);
+
+/** @brief Withdraw the allocator from the registry and free what it allocated. */
+extern void kernel_stack_allocator_destroy(KernelStackAllocator_t *stack);
+
+/** @return @p size bytes aligned to @p align (8 when 0), or NULL past capacity. */
+extern void *kernel_stack_allocator_push(KernelStackAllocator_t *stack, uint32_t size, uint32_t align);
+
+/** @return The current top, for a later kernel_stack_allocator_rollback_to(). */
+extern uint32_t kernel_stack_allocator_marker(const KernelStackAllocator_t *stack);
+
+/** @brief Free everything pushed since @p marker. A marker above the top is ignored. */
+extern void kernel_stack_allocator_rollback_to(KernelStackAllocator_t *stack, uint32_t marker);
+
+/** @brief Fill @p out with the allocator's counters, in bytes. */
+extern void kernel_stack_allocator_get_usage(const KernelStackAllocator_t *stack, KernelAllocatorUsage_t *out);
+
+/*
+ * The kernel's stack allocator, "kernel_stack". The functions below are the
+ * original single-instance interface and forward to it.
+ */
+extern KernelStackAllocator_t *kernel_stack_allocator_get_default(void);
+
 extern bool kernel_stack_allocator_initialize(uint32_t capacity_bytes);
 
 extern void *kernel_stack_alloc_push(uint32_t size, uint32_t align);
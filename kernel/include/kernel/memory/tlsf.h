@@ -5,77 +5,183 @@
 ** Two-Level Segregated Fit (TLSF) deterministic allocator.
 **
 ** Provides O(1) bounded-time allocation and deallocation for use in
-** the client realtime kernel profile.  Operates on a pre-allocated
-** memory pool donated at boot time — no runtime page allocation.
+** the client realtime kernel profile. An instance manages one or more
+** pools handed to it by its owner; the allocator itself never asks the
+** PMM or the VMM for memory, so its worst case does not depend on them.
 **
-** FLI: First-Level Index  — log2 of block size, up to 16 classes.
-** SLI: Second-Level Index — subdivision within each FLI class (4 bins).
+** FLI: First-Level Index  — log2 of block size, one class per power of
+**      two from 256 bytes up to 2^31.
+** SLI: Second-Level Index — 32 linear bins within each FLI class, so a
+**      whole class fits one 32-bit bitmap word.
+**
+** Pools may be added at any time (kernel_tlsf_add_pool) and are never
+** removed; blocks do not coalesce across pools. The owner decides when
+** growing is acceptable — the heap does it outside its hot loop.
 */
 
 #ifndef KERNEL_MEMORY_TLSF_H_
 #define KERNEL_MEMORY_TLSF_H_
 
+#include <kernel/drivers/serial.h>
+#include <kernel/memory/allocator_registry.h>
+
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+/* Second-level bins per first-level class: one bit each in a uint32_t. */
+#define KERNEL_TLSF_SL_INDEX_LOG2  5u
+#define KERNEL_TLSF_SL_INDEX_COUNT (1u << KERNEL_TLSF_SL_INDEX_LOG2)
+
+/* Below 2^FL_INDEX_SHIFT bytes blocks share class 0, split linearly by 8 bytes. */
+#define KERNEL_TLSF_FL_INDEX_SHIFT 8u
+#define KERNEL_TLSF_FL_INDEX_MAX   31u
+#define KERNEL_TLSF_FL_INDEX_COUNT (KERNEL_TLSF_FL_INDEX_MAX - KERNEL_TLSF_FL_INDEX_SHIFT + 1u)
+
+/* Largest request an instance accepts; the mapping is exact up to 2^31. */
+#define KERNEL_TLSF_MAX_ALLOCATION (1u << 30)
+
+/* Bytes a block costs beyond its payload: its size word and the back link. */
+#define KERNEL_TLSF_BLOCK_OVERHEAD (2u * sizeof(void *))
+
+/* Pools one instance can hold. */
+#define KERNEL_TLSF_MAX_POOLS 8u
+
+typedef struct KernelTlsfBlock KernelTlsfBlock_t;
+
+typedef struct KernelTlsfPool {
+    uint8_t *start;
+    uint8_t *end;
+} KernelTlsfPool_t;
+
 /**
- * @brief Initialize the TLSF allocator with a pre-allocated memory pool.
+ * @struct KernelTlsf_t
+ * @brief One TLSF allocator: its free lists, its pools and its counters.
  *
- * @param buffer   Start of the memory pool (must be 8-byte aligned).
- * @param size     Total size of the memory pool in bytes.
- * @return true on success, false if pool is too small or misaligned.
+ * Allocation and free are O(1) and time themselves; the worst of each is kept
+ * per instance. An instance is not locked: it belongs to one owner, or its
+ * owner locks it.
  */
-extern bool kernel_tlsf_initialize(void *buffer, size_t size);
+typedef struct KernelTlsf {
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[KERNEL_TLSF_FL_INDEX_COUNT];
+    KernelTlsfBlock_t *free_lists[KERNEL_TLSF_FL_INDEX_COUNT][KERNEL_TLSF_SL_INDEX_COUNT];
+
+    KernelTlsfPool_t pools[KERNEL_TLSF_MAX_POOLS];
+    uint32_t pool_count;
+
+    const char *name;
+    uint32_t pool_size;      /* bytes handed to the instance, all pools */
+    uint32_t free_bytes;     /* payload bytes in free blocks */
+    uint32_t min_free_bytes; /* low watermark of free_bytes */
+    uint32_t alloc_count;
+    uint32_t free_op_count;
+    uint32_t failed_alloc_count;
+    uint32_t wcet_alloc_cycles;
+    uint32_t wcet_free_cycles;
+    bool initialized;
+    bool owns_instance;
+} KernelTlsf_t;
+
+typedef struct KernelTlsfStatistics {
+    uint32_t pools;
+    uint32_t pool_size;
+    uint32_t free_bytes;
+    uint32_t min_free_bytes;
+    uint32_t largest_free_block;
+    uint32_t free_blocks;
+    /* 1000 * (1 - largest / free): 0 when all free memory is one block. */
+    uint32_t fragmentation_permille;
+    uint32_t alloc_count;
+    uint32_t free_count;
+    uint32_t failed_alloc_count;
+    uint32_t wcet_alloc_cycles;
+    uint32_t wcet_free_cycles;
+} KernelTlsfStatistics_t;
 
 /**
- * @brief Allocate a block of at least @p size bytes.
+ * @brief Set up @p tlsf over its first pool and register it under @p name.
  *
- * Beyond the mapping's reach: refuse rather than let the fl clamp hand back
- * a block that does not fit (see TLSF_MAX_BLOCK_SIZE).
+ * @param buffer Start of the pool (aligned up to 8 bytes if needed).
+ * @param size   Size of the pool in bytes.
+ * @return false on a bad argument or a pool too small to hold one block.
+ */
+extern bool kernel_tlsf_init(KernelTlsf_t *tlsf, const char *name, void *buffer, size_t size);
+
+/** @brief kernel_tlsf_init() on an instance that itself comes from the heap. */
+extern KernelTlsf_t *kernel_tlsf_create(const char *name, void *buffer, size_t size);
+
+/**
+ * @brief Withdraw the instance from the registry. Its pools belong to the
+ *        caller and are left untouched.
+ */
+extern void kernel_tlsf_destroy(KernelTlsf_t *tlsf);
+
+/**
+ * @brief Give @p tlsf another pool. O(1); the pool's memory becomes one
+ *        free block.
  *
- * @param size  Requested allocation size (rounded up internally).
- * @return Pointer to usable memory, or NULL if no suitable block exists.
+ * @return false when the instance already holds KERNEL_TLSF_MAX_POOLS
+ *         pools or the pool is too small.
  */
-extern void *kernel_tlsf_alloc(size_t size);
+extern bool kernel_tlsf_add_pool(KernelTlsf_t *tlsf, void *buffer, size_t size);
 
 /**
- * @brief Free a previously allocated block.
+ * @brief Allocate a block of at least @p size bytes, 8-byte aligned.
  *
- * @param ptr  Pointer returned by kernel_tlsf_alloc (NULL is a no-op).
+ * @return NULL when no free block is large enough, or @p size exceeds
+ *         KERNEL_TLSF_MAX_ALLOCATION.
  */
-extern void kernel_tlsf_free(void *ptr);
+extern void *kernel_tlsf_allocate(KernelTlsf_t *tlsf, size_t size);
+
+/** @brief Free a block of @p tlsf (NULL is a no-op). */
+extern void kernel_tlsf_release(KernelTlsf_t *tlsf, void *ptr);
+
+/** @return true if @p ptr lies in one of @p tlsf's pools. */
+extern bool kernel_tlsf_contains(const KernelTlsf_t *tlsf, const void *ptr);
 
 /**
- * @brief Check if a pointer belongs to the TLSF pool.
+ * @brief Fill @p out with the instance's counters.
  *
- * @param ptr  Pointer to test.
- * @return true if ptr falls within the TLSF-managed memory region.
+ * Walks every free list to count blocks and find the largest one: a
+ * reporting call, not for a hot path.
+ */
+extern void kernel_tlsf_get_statistics(const KernelTlsf_t *tlsf, KernelTlsfStatistics_t *out);
+
+/** @brief Fill @p out with the instance's counters, in bytes, for the allocator registry. */
+extern void kernel_tlsf_get_usage(const KernelTlsf_t *tlsf, KernelAllocatorUsage_t *out);
+
+/** @brief Emit one `tlsf` telemetry record for @p tlsf. */
+extern void kernel_tlsf_report(Serial_t *serial, const KernelTlsf_t *tlsf);
+
+/*
+ * The kernel heap's instance, "kernel_tlsf". The functions below are the
+ * original single-instance interface and forward to it.
  */
+extern KernelTlsf_t *kernel_tlsf_get_default(void);
+
+extern bool kernel_tlsf_initialize(void *buffer, size_t size);
+
+extern void *kernel_tlsf_alloc(size_t size);
+
+extern void kernel_tlsf_free(void *ptr);
+
 extern bool kernel_tlsf_owns(const void *ptr);
 
-/** @brief Return true if the TLSF allocator has been initialized. */
 extern bool kernel_tlsf_is_initialized(void);
 
-/** @brief Return the total pool capacity in bytes. */
 extern uint32_t kernel_tlsf_get_pool_size(void);
 
-/** @brief Return the current number of free bytes in the pool. */
 extern uint32_t kernel_tlsf_get_free_bytes(void);
 
-/** @brief Return the total number of successful allocations. */
 extern uint32_t kernel_tlsf_get_alloc_count(void);
 
-/** @brief Return the total number of successful frees. */
 extern uint32_t kernel_tlsf_get_free_count(void);
 
-/** @brief Return the number of failed allocation attempts. */
 extern uint32_t kernel_tlsf_get_failed_alloc_count(void);
 
-/** @brief Return the peak allocation cycles (WCET) observed. */
 extern uint32_t kernel_tlsf_get_wcet_alloc_cycles(void);
 
-/** @brief Return the peak free cycles (WCET) observed. */
 extern uint32_t kernel_tlsf_get_wcet_free_cycles(void);
 
 #endif /* !KERNEL_MEMORY_TLSF_H_ */
@@ -17,6 +17,33 @@
 #define KERNEL_VMM_DYNAMIC_END   0xF0000000u
 #define KERNEL_VMM_DYNAMIC_SIZE  (KERNEL_VMM_DYNAMIC_END - KERNEL_VMM_DYNAMIC_START)
 
+/* Free extents the range allocator can describe at once. */
+#define KERNEL_VMM_EXTENT_CAPACITY 1024u
+
+/* Released ranges of 1..N pages are kept by size and handed back first. */
+#define KERNEL_VMM_SIZE_CACHE_PAGES 16u
+#define KERNEL_VMM_SIZE_CACHE_DEPTH 4u
+
+/**
+ * @struct KernelVmmStatistics_t
+ * @brief Range allocator counters since boot, and the state of free space now.
+ */
+typedef struct KernelVmmStatistics {
+    uint32_t reservations;       /**< Ranges reserved, fixed ones included. */
+    uint32_t releases;           /**< Ranges released. */
+    uint32_t failures;           /**< Reservations refused for lack of space. */
+    uint32_t cache_hits;         /**< Reservations served from a size cache. */
+    uint32_t cache_drains;       /**< Times the size caches were emptied. */
+    uint32_t cached_ranges;      /**< Ranges sitting in the size caches now. */
+    uint32_t cached_pages;       /**< Pages those ranges cover. */
+    uint32_t extents;            /**< Free extents in the index now. */
+    uint32_t free_pages;         /**< Pages those extents cover; cached ranges excluded. */
+    uint32_t largest_free_pages; /**< Largest free extent now. */
+    uint32_t extent_overflows;   /**< Releases or splits with no extent left to record them. */
+    uint32_t reserve_cycles_max; /**< Worst reservation seen, in TSC cycles. */
+    uint32_t release_cycles_max; /**< Worst release seen, in TSC cycles. */
+} KernelVmmStatistics_t;
+
 /**
  * @brief Initialize the Virtual Memory Manager.
  */
@@ -25,19 +52,45 @@ bool kernel_vmm_initialize(void);
 /**
  * @brief Allocate a contiguous range of virtual pages and map them to physical frames.
  *
+ * @details A request of 1024 pages or more, with PSE available, is reserved
+ *          4 MiB aligned and each whole 4 MiB chunk is backed by one order-10
+ *          block behind a single large PDE; the tail, and any chunk the buddy
+ *          cannot satisfy, falls back to 4 KiB pages.
+ *
  * @param page_count Number of pages to allocate.
  * @return Virtual address of the allocated range, or NULL on failure.
  */
 void *kernel_vmm_alloc_pages(uint32_t page_count);
 
+/**
+ * @brief As kernel_vmm_alloc_pages(), but always with 4 KiB pages.
+ *
+ * @param page_count Number of pages to allocate.
+ * @return Virtual address of the allocated range, or NULL on failure.
+ */
+void *kernel_vmm_alloc_small_pages(uint32_t page_count);
+
 /**
  * @brief Reserve a range of virtual pages without mapping them.
  *
+ * @details Best fit among the free extents, found through size-class bitmaps;
+ *          ranges of up to KERNEL_VMM_SIZE_CACHE_PAGES pages are served first
+ *          from those recently released at the same size.
+ *
  * @param page_count Number of pages to reserve.
  * @return Virtual address of the reserved range, or NULL on failure.
  */
 void *kernel_vmm_reserve_pages(uint32_t page_count);
 
+/**
+ * @brief Reserve a range of virtual pages whose start is aligned to @p alignment_pages.
+ *
+ * @param page_count Number of pages to reserve.
+ * @param alignment_pages Alignment in pages, a power of two.
+ * @return Virtual address of the reserved range, or NULL on failure.
+ */
+void *kernel_vmm_reserve_pages_aligned(uint32_t page_count, uint32_t alignment_pages);
+
 /**
  * @brief Reserve a FIXED range of virtual pages without mapping them.
  *
@@ -50,9 +103,24 @@ bool kernel_vmm_reserve_at(void *virt, uint32_t page_count);
 /**
  * @brief Free a range of virtual pages (and their physical frames if mapped).
  *
+ * @details Large pages are released whole: the range must cover each one it
+ *          touches from its first page, as kernel_vmm_alloc_pages() returned it.
+ *
  * @param ptr Virtual address to free.
  * @param page_count Number of pages to free.
  */
 void kernel_vmm_free_pages(void *ptr, uint32_t page_count);
 
+/**
+ * @brief Copy the range allocator counters into @p out.
+ */
+void kernel_vmm_get_statistics(KernelVmmStatistics_t *out);
+
+/**
+ * @brief Free virtual space outside the largest extent, in percent.
+ *
+ * @return 0 when free space is one extent, towards 100 as it scatters.
+ */
+uint32_t kernel_vmm_get_fragmentation_ratio(void);
+
 #endif /* !KERNEL_MEMORY_VMM_H_ */
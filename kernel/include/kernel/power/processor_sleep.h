@@ -10,7 +10,9 @@
  * Everything here is accounted, and that is not decoration. "This profile costs
  * nothing when idle" is a claim about energy, and a claim about energy that is not
  * measured is a wish. The counters below are what let the satellite profile print a
- * duty cycle instead of a promise.
+ * duty cycle instead of a promise. The accounting is kept per logical slot and every
+ * getter reports the processor that calls it, since the job system's workers idle
+ * through here as well.
  *
  * The pair also has a discipline that a wrapper cannot enforce and a caller must
  * not skip: between arming the monitor and sleeping, re-check the condition. If the
@@ -72,7 +74,9 @@ uint32_t kernel_processor_sleep_monitor_line_bytes(void);
  * The value is re-read after arming the monitor and before sleeping, which closes
  * the race the pair is famous for. Falls back to `HLT` where the pair is absent —
  * correct, just less precise: a halted core still wakes on the timer interrupt, it
- * simply cannot be woken by a device's DMA alone.
+ * simply cannot be woken by a device's DMA alone. The fallback checks with
+ * interrupts masked and unmasks them in the instruction before `HLT`, so an
+ * interrupt that makes the condition true cannot slip in between.
  *
  * @param watched  Address to watch; typically a driver's write index.
  * @param expected Value that means "nothing new yet".
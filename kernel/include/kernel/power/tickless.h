@@ -88,6 +88,22 @@ bool kernel_tickless_enabled(void);
  */
 uint32_t kernel_tickless_sleep(uint32_t microseconds);
 
+/**
+ * @brief Sleeps until @p watched stops reading @p expected, or the deadline passes.
+ *
+ * The sleep for a consumer whose producer is an interrupt handler: the handler's
+ * write ends it, and the deadline is only a watchdog against a device that has gone
+ * quiet — with the tick stopped, nothing else would ever wake the core. A write
+ * that landed before the call returns immediately and counts as a skipped sleep.
+ *
+ * @param watched      Address to watch; NULL degrades to @ref kernel_tickless_sleep.
+ * @param expected     Value that means "nothing new yet".
+ * @param microseconds Deadline; clamped to @ref KERNEL_TICKLESS_MAX_SLEEP_MICROSECONDS.
+ * @return Microseconds actually spent.
+ */
+uint32_t kernel_tickless_sleep_until_write(const volatile uint32_t *watched, uint32_t expected,
+                                           uint32_t microseconds);
+
 /**
  * @brief Periodic interrupts this profile did not take.
  *
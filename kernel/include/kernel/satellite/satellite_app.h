@@ -61,6 +61,17 @@ typedef struct {
      * a microphone appears not to work.
      */
     uint32_t capture_peak;
+    uint32_t interrupt_driven;                   /**< 1 when the interrupt-driven phase ran. */
+    uint32_t polled_duty_permille;               /**< Awake share while the loop polled. */
+    uint32_t polled_latency_microseconds;        /**< Mean age of a buffer when taken, polled. */
+    uint32_t polled_latency_max_microseconds;    /**< Oldest buffer taken, polled. */
+    uint32_t interrupt_duty_permille;            /**< Awake share while the handler produced. */
+    uint32_t interrupt_latency_microseconds;     /**< Mean age of a buffer when taken, interrupt-driven. */
+    uint32_t interrupt_latency_max_microseconds; /**< Oldest buffer taken, interrupt-driven. */
+    uint32_t capture_interrupts;                 /**< Stream interrupts the controller raised. */
+    uint32_t playback_frames;                    /**< Buffers the playback stream accepted. */
+    uint32_t playback_started;                   /**< 1 when the stream ran after the submit. */
+    uint32_t playback_flushed;                   /**< 1 when the flush stopped it. */
 } SatelliteReport_t;
 
 /**
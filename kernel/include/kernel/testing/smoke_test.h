@@ -57,7 +57,28 @@
 #ifndef KERNEL_SMOKE_TEST_ENABLE_APIC_PERIODIC_MODE
 #    define KERNEL_SMOKE_TEST_ENABLE_APIC_PERIODIC_MODE 0u
 #endif
-#define KERNEL_SMOKE_TEST_ENABLE_VMM_ALLOC_FREE 1u
+#define KERNEL_SMOKE_TEST_ENABLE_VMM_ALLOC_FREE      1u
+#define KERNEL_SMOKE_TEST_ENABLE_JOB_SYSTEM          1u
+#define KERNEL_SMOKE_TEST_ENABLE_IRQ_FPU             1u
+#define KERNEL_SMOKE_TEST_ENABLE_MEMORY_BANDWIDTH    1u
+#define KERNEL_SMOKE_TEST_ENABLE_LOCK_CONTENTION     1u
+#define KERNEL_SMOKE_TEST_ENABLE_HEAP_MAGAZINE       1u
+#define KERNEL_SMOKE_TEST_ENABLE_RING_INSTANCES      1u
+#define KERNEL_SMOKE_TEST_ENABLE_TRACE_OVERHEAD      1u
+#define KERNEL_SMOKE_TEST_ENABLE_LFB_FILL_RATE       1u
+#define KERNEL_SMOKE_TEST_ENABLE_LARGE_PAGE_WALK     1u
+#define KERNEL_SMOKE_TEST_ENABLE_DMA_CONTIGUOUS      1u
+#define KERNEL_SMOKE_TEST_ENABLE_VMM_RANGE           1u
+#define KERNEL_SMOKE_TEST_ENABLE_PMM_PAGE_CHURN      1u
+#define KERNEL_SMOKE_TEST_ENABLE_TLB_SHOOTDOWN       1u
+#define KERNEL_SMOKE_TEST_ENABLE_ALLOCATOR_INSTANCES 1u
+#define KERNEL_SMOKE_TEST_ENABLE_SLAB_CACHE          1u
+#define KERNEL_SMOKE_TEST_ENABLE_TLSF_TRACE_REPLAY   1u
+#define KERNEL_SMOKE_TEST_ENABLE_TIMER_WHEEL         1u
+#define KERNEL_SMOKE_TEST_ENABLE_THREAD_SCHEDULER    1u
+#define KERNEL_SMOKE_TEST_ENABLE_INPUT_EVENT_RING    1u
+#define KERNEL_SMOKE_TEST_ENABLE_MSI_VECTORS         1u
+#define KERNEL_SMOKE_TEST_ENABLE_INTERRUPT_AFFINITY  1u
 
 /* C7: Final Validation Campaign */
 #define KERNEL_SMOKE_TEST_ENABLE_C7_TLSF_SOAK        1u
@@ -158,4 +179,46 @@ extern void smoke_test_run_section_protection(Serial_t *serial_port);
 
 extern void smoke_test_run_reconciler(Serial_t *serial_port);
 
+extern void smoke_test_run_job_system_parallel_fold(Serial_t *serial_port);
+
+extern void smoke_test_run_irq_fpu_lazy_save(Serial_t *serial_port);
+
+extern void smoke_test_run_memory_size_class_bandwidth(Serial_t *serial_port);
+
+extern void smoke_test_run_lock_contention(Serial_t *serial_port);
+
+extern void smoke_test_run_heap_magazine_stress(Serial_t *serial_port);
+
+extern void smoke_test_run_ring_instances(Serial_t *serial_port);
+
+extern void smoke_test_run_trace_overhead(Serial_t *serial_port);
+
+extern void smoke_test_run_lfb_fill_rate(Serial_t *serial_port);
+
+extern void smoke_test_run_large_page_walk(Serial_t *serial_port);
+
+extern void smoke_test_run_dma_contiguous(Serial_t *serial_port);
+
+extern void smoke_test_run_vmm_range_allocator(Serial_t *serial_port);
+
+extern void smoke_test_run_pmm_page_churn(Serial_t *serial_port);
+
+extern void smoke_test_run_tlb_shootdown_batch(Serial_t *serial_port);
+
+extern void smoke_test_run_allocator_instances(Serial_t *serial_port);
+
+extern void smoke_test_run_slab_cache(Serial_t *serial_port);
+
+extern void smoke_test_run_tlsf_trace_replay(Serial_t *serial_port);
+
+extern void smoke_test_run_timer_wheel(Serial_t *serial_port);
+
+extern void smoke_test_run_thread_scheduler(Serial_t *serial_port);
+
+extern void smoke_test_run_input_event_ring(Serial_t *serial_port);
+
+extern void smoke_test_run_msi_vectors(Serial_t *serial_port);
+
+extern void smoke_test_run_interrupt_affinity(Serial_t *serial_port);
+
 #endif /* !KERNEL_TESTING_SMOKE_TEST_H_ */
@@ -9,12 +9,30 @@
 
 #include <kernel/ai/tensor_arena.h>
 
-#include <kernel/memory/heap.h>
+#include <kernel/cpu/paging.h>
+#include <kernel/memory/tlsf.h>
+#include <kernel/memory/vmm.h>
+
+/* Room past the region for kernel_tensor_arena_allocate(), plus the TLSF headers. */
+#define TENSOR_ARENA_SCRATCH_BYTES (64u * 1024u)
+#define TENSOR_ARENA_TLSF_SLACK    64u
+
+static KernelTlsf_t tensor_arena_tlsf;
+static void *tensor_arena_pool = NULL;
+static uint32_t tensor_arena_pool_pages = 0u;
 
 static void *tensor_arena_base = NULL;
 static size_t tensor_arena_size = 0u;
 static size_t tensor_arena_high_water = 0u;
 
+static void tensor_arena_drop_pool(void)
+{
+    kernel_tlsf_destroy(&tensor_arena_tlsf);
+    kernel_vmm_free_pages(tensor_arena_pool, tensor_arena_pool_pages);
+    tensor_arena_pool = NULL;
+    tensor_arena_pool_pages = 0u;
+}
+
 bool kernel_tensor_arena_initialize(size_t bytes)
 {
     if (bytes == 0u)
@@ -23,13 +41,37 @@ bool kernel_tensor_arena_initialize(size_t bytes)
     if (tensor_arena_base != NULL)
         return tensor_arena_size >= bytes;
 
-    /* One allocation, at boot, while the heap is still uncontended. Doing this
+    if (bytes > KERNEL_TLSF_MAX_ALLOCATION)
+        return false;
+
+    /* One allocation, at boot, while the VMM is still uncontended. Doing this
        lazily on the first inference would put the largest allocation the kernel
        ever makes in the middle of a running world, which is exactly when it is
-       least likely to be servable. */
-    void *const block = kmalloc(bytes);
+       least likely to be servable. The pages become a TLSF instance of their
+       own: the region is its first block, and the scratch behind it never
+       competes with the kernel heap. */
+    const uint32_t pool_bytes = (uint32_t) bytes + TENSOR_ARENA_SCRATCH_BYTES + TENSOR_ARENA_TLSF_SLACK;
+    const uint32_t pages = (pool_bytes + (uint32_t) PAGE_SIZE - 1u) / (uint32_t) PAGE_SIZE;
+
+    tensor_arena_pool = kernel_vmm_alloc_pages(pages);
+    if (tensor_arena_pool == NULL)
+        return false;
+    tensor_arena_pool_pages = pages;
+
+    if (!kernel_tlsf_init(&tensor_arena_tlsf, "tensor_arena", tensor_arena_pool, (size_t) pages * PAGE_SIZE))
+    {
+        kernel_vmm_free_pages(tensor_arena_pool, pages);
+        tensor_arena_pool = NULL;
+        tensor_arena_pool_pages = 0u;
+        return false;
+    }
+
+    void *const block = kernel_tlsf_allocate(&tensor_arena_tlsf, bytes);
     if (block == NULL)
+    {
+        tensor_arena_drop_pool();
         return false;
+    }
 
     tensor_arena_base = block;
     tensor_arena_size = bytes;
@@ -41,11 +83,25 @@ void kernel_tensor_arena_release(void)
 {
     if (tensor_arena_base == NULL)
         return;
-    kfree(tensor_arena_base);
+    tensor_arena_drop_pool();
     tensor_arena_base = NULL;
     tensor_arena_size = 0u;
 }
 
+void *kernel_tensor_arena_allocate(size_t bytes)
+{
+    if (tensor_arena_base == NULL)
+        return NULL;
+    return kernel_tlsf_allocate(&tensor_arena_tlsf, bytes);
+}
+
+void kernel_tensor_arena_free(void *pointer)
+{
+    if (pointer == NULL || pointer == tensor_arena_base || !kernel_tlsf_contains(&tensor_arena_tlsf, pointer))
+        return;
+    kernel_tlsf_release(&tensor_arena_tlsf, pointer);
+}
+
 void *kernel_tensor_arena_base(void) { return tensor_arena_base; }
 
 size_t kernel_tensor_arena_size(void) { return tensor_arena_size; }
@@ -5,15 +5,19 @@
 #include <kernel/cpu/apic_ipi.h>
 #include <kernel/cpu/cpu_topology.h>
 #include <kernel/cpu/helpers/pci_helper.h>
+#include <kernel/cpu/interrupt_affinity.h>
 #include <kernel/cpu/pci.h>
 #include <kernel/cpu/pmm.h>
 #include <kernel/diag/telemetry.h>
+#include <kernel/diag/telemetry_stream.h>
+#include <kernel/diag/trace.h>
 #include <kernel/drivers/framebuffer.h>
 #include <kernel/drivers/helpers/keyboard_helper.h>
 #include <kernel/drivers/keyboard.h>
 #include <kernel/drivers/ps2_keyboard.h>
 #include <kernel/drivers/tty.h>
 #include <kernel/memory/heap.h>
+#include <kernel/memory/heap_trace.h>
 
 #if defined(LPL_KERNEL_ENABLE_CONSOLE)
 
@@ -27,7 +31,7 @@
  * reports, so the three cannot disagree again.
  */
 static const char *const KERNEL_CONSOLE_COMMANDS[] = {
-    "help", "stats", "ap", "kbd", "pci", "layout", "layout us", "layout fr", "exit",
+    "help", "stats", "ap", "kbd", "pci", "layout", "layout us", "layout fr", "trace", "trace off", "heaptrace", "exit",
 };
 
 #    define KERNEL_CONSOLE_COMMAND_COUNT (sizeof(KERNEL_CONSOLE_COMMANDS) / sizeof(KERNEL_CONSOLE_COMMANDS[0]))
@@ -60,6 +64,36 @@ static const char *kernel_console_layout_name(void)
     }
 }
 
+/* One line per steered interrupt source: where it is, why, and how busy it is. */
+static void kernel_console_print_interrupt_sources(void)
+{
+    for (uint32_t index = 0u; index < INTERRUPT_AFFINITY_MAX_SOURCES; ++index)
+    {
+        InterruptAffinitySource_t source;
+        if (!interrupt_affinity_get_source(index, &source) || !source.present)
+            continue;
+
+        terminal_write_string("[irq] vector=0x");
+        terminal_write_number((long) source.vector, 16u);
+        if (source.kind == INTERRUPT_AFFINITY_KIND_LINE)
+        {
+            terminal_write_string(" line=");
+            terminal_write_number((long) source.line, 10u);
+        }
+        else
+            terminal_write_string(" msi");
+        terminal_write_string(" cpu=");
+        terminal_write_number((long) source.cpu, 10u);
+        terminal_write_string(" policy=");
+        terminal_write_string(interrupt_affinity_policy_name(source.policy));
+        terminal_write_string(" rate/s=");
+        terminal_write_number((long) source.rate_per_second, 10u);
+        terminal_write_string(" moves=");
+        terminal_write_number((long) source.moves, 10u);
+        terminal_write_string("\n");
+    }
+}
+
 static void kernel_console_execute_command(Serial_t *com1, const char *command)
 {
     if (!command || !*command)
@@ -84,7 +118,19 @@ static void kernel_console_execute_command(Serial_t *com1, const char *command)
         terminal_write_string(kernel_heap_get_strategy_name());
         terminal_write_string(", pmm free pages=");
         terminal_write_number((long) physical_memory_manager_get_free_page_count(), 10u);
+
+        InterruptAffinityStatistics_t irq;
+        interrupt_affinity_get_statistics(&irq);
+        terminal_write_string("\n[stats] irq sources=");
+        terminal_write_number((long) irq.sources, 10u);
+        terminal_write_string(", on tick cpu=");
+        terminal_write_number((long) irq.on_tick_cpu, 10u);
+        terminal_write_string(", moves=");
+        terminal_write_number((long) irq.moves, 10u);
+        terminal_write_string(", passes=");
+        terminal_write_number((long) irq.passes, 10u);
         terminal_write_string("\n");
+        interrupt_affinity_report(com1);
         return;
     }
 
@@ -104,7 +150,20 @@ static void kernel_console_execute_command(Serial_t *com1, const char *command)
         terminal_write_number((long) application_processor_trampoline_get_ack_success_count(), 10u);
         terminal_write_string(", tramp_ack_to=");
         terminal_write_number((long) application_processor_trampoline_get_ack_timeout_count(), 10u);
+
+        /* Which CPU does what: the tick's, the ones kept for real-time lines, the rest. */
+        InterruptAffinityStatistics_t irq;
+        interrupt_affinity_get_statistics(&irq);
+        terminal_write_string("\n[ap] tick_cpu=");
+        terminal_write_number((long) irq.tick_cpu, 10u);
+        terminal_write_string(", irq spare=");
+        terminal_write_number((long) irq.spare_cpus, 10u);
+        terminal_write_string(", irq dedicated=");
+        terminal_write_number((long) irq.dedicated_cpus, 10u);
+        terminal_write_string(", balancer=");
+        terminal_write_string(irq.periodic ? "periodic" : "on demand");
         terminal_write_string("\n");
+        kernel_console_print_interrupt_sources();
         return;
     }
 
@@ -154,6 +213,41 @@ static void kernel_console_execute_command(Serial_t *com1, const char *command)
         return;
     }
 
+    /* Export what the rings hold, then start a fresh window: the trace always
+       covers the time since the previous `trace`. */
+    if (kernel_string_equals(command, "trace"))
+    {
+        const uint32_t exported = kernel_trace_export(com1);
+
+        kernel_trace_enable();
+        terminal_write_string("\n[trace] exported ");
+        terminal_write_number((long) exported, 10u);
+        terminal_write_string(kernel_telemetry_stream_active() ? " span(s) to the telemetry stream\n"
+                                                               : " span(s) on serial\n");
+        return;
+    }
+
+    if (kernel_string_equals(command, "trace off"))
+    {
+        kernel_trace_disable();
+        terminal_write_string("\n[trace] recording stopped (trace exports and restarts it)\n");
+        return;
+    }
+
+    /* Same shape as `trace`: export the capture, then record afresh. A window that
+       starts mid-run frees blocks it never saw allocated; the replay skips those. */
+    if (kernel_string_equals(command, "heaptrace"))
+    {
+        const uint32_t exported = kernel_heap_trace_export(com1);
+
+        kernel_heap_trace_start();
+        terminal_write_string("\n[heaptrace] exported ");
+        terminal_write_number((long) exported, 10u);
+        terminal_write_string(kernel_telemetry_stream_active() ? " event(s) to the telemetry stream\n"
+                                                               : " event(s) on serial\n");
+        return;
+    }
+
     if (kernel_string_equals(command, "exit"))
         return;
 
@@ -180,7 +274,10 @@ void kernel_console_run_interactive_loop(Serial_t *com1)
 {
 #if !defined(LPL_KERNEL_ENABLE_CONSOLE)
     for (;;)
-        asm volatile("hlt");
+    {
+        if (kernel_telemetry_stream_drain(0u) == 0u)
+            asm volatile("hlt");
+    }
 #else
     static const uint8_t KEY_ECHAP = 27u;
     static const uint32_t KERNEL_CONSOLE_COMMAND_MAX = 63u;
@@ -257,7 +354,8 @@ void kernel_console_run_interactive_loop(Serial_t *com1)
             continue;
         }
 
-        asm volatile("hlt");
+        if (kernel_telemetry_stream_drain(0u) == 0u)
+            asm volatile("hlt");
     }
 #endif
 }
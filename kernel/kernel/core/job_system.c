@@ -0,0 +1,427 @@
+/**
+ * @file job_system.c
+ * @brief Work-stealing job runtime over the application processors.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#include <kernel/core/job_system.h>
+
+#include <kernel/core/thread.h>
+#include <kernel/cpu/apic.h>
+#include <kernel/cpu/apic_ipi.h>
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/cpu/isr.h>
+#include <kernel/diag/telemetry_stream.h>
+#include <kernel/power/processor_sleep.h>
+
+#define JOB_SYSTEM_SLOT_COUNT    CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC
+#define JOB_SYSTEM_DEQUE_MASK    (KERNEL_JOB_SYSTEM_DEQUE_CAPACITY - 1u)
+#define JOB_SYSTEM_CACHE_LINE    64u
+
+typedef struct {
+    KernelJobFunction_t function;
+    void *context;
+    KernelJobGroup_t *group;
+    uint32_t begin;
+    uint32_t end;
+    uint32_t origin_slot;
+} JobSystemJob_t;
+
+/* top is written by thieves, bottom only by the owner, the doorbell by whoever
+   wakes the owner. Each gets its own line so a steal storm does not bounce the
+   owner's bottom, and the monitor armed on the doorbell is not tripped by a
+   thief taking the top. */
+typedef struct {
+    volatile uint32_t top __attribute__((aligned(JOB_SYSTEM_CACHE_LINE)));
+    volatile uint32_t bottom __attribute__((aligned(JOB_SYSTEM_CACHE_LINE)));
+    volatile uint32_t doorbell __attribute__((aligned(JOB_SYSTEM_CACHE_LINE)));
+    volatile uint32_t sleeping;
+    uint32_t apic_id;
+    bool worker;
+    uint32_t executed;
+    uint32_t stolen;
+    JobSystemJob_t jobs[KERNEL_JOB_SYSTEM_DEQUE_CAPACITY] __attribute__((aligned(JOB_SYSTEM_CACHE_LINE)));
+} JobSystemSlot_t;
+
+static JobSystemSlot_t job_system_slots[JOB_SYSTEM_SLOT_COUNT];
+
+/* Bit n set once slot n has queued a job or registered as a worker: the only
+   deques a thief bothers to look at. */
+static volatile uint32_t job_system_participant_mask = 0u;
+static volatile uint32_t job_system_worker_mask = 0u;
+static uint32_t job_system_worker_count = 0u;
+static uint32_t job_system_inline_count = 0u;
+static uint32_t job_system_wakeup_ipi_count = 0u;
+static bool job_system_monitor_wakeup = false;
+
+static void job_system_wakeup_handler(const InterruptFrame_t *frame)
+{
+    /* Nothing to do but end the HLT: the worker re-scans the deques itself. */
+    (void) frame;
+    apic_send_eoi();
+}
+
+static uint32_t job_system_current_slot(void)
+{
+    const uint32_t slot = cpu_topology_get_logical_slot();
+
+    return (slot < JOB_SYSTEM_SLOT_COUNT) ? slot : 0u;
+}
+
+static void job_system_execute(uint32_t slot, const JobSystemJob_t *job)
+{
+    job->function(job->context, job->begin, job->end);
+
+    /* The thread may have moved off @p slot while the job ran: counted atomically,
+       since slot's own CPU may be counting too. */
+    JobSystemSlot_t *self = &job_system_slots[slot];
+    __atomic_add_fetch(&self->executed, 1u, __ATOMIC_RELAXED);
+    if (job->origin_slot != slot)
+        __atomic_add_fetch(&self->stolen, 1u, __ATOMIC_RELAXED);
+
+    __atomic_sub_fetch(&job->group->pending, 1u, __ATOMIC_RELEASE);
+}
+
+static bool job_system_push(JobSystemSlot_t *deque, const JobSystemJob_t *job)
+{
+    const uint32_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    const uint32_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+
+    if ((int32_t) (bottom - top) >= (int32_t) KERNEL_JOB_SYSTEM_DEQUE_CAPACITY)
+        return false;
+
+    deque->jobs[bottom & JOB_SYSTEM_DEQUE_MASK] = *job;
+    __atomic_store_n(&deque->bottom, bottom + 1u, __ATOMIC_RELEASE);
+    return true;
+}
+
+static bool job_system_pop(JobSystemSlot_t *deque, JobSystemJob_t *out)
+{
+    const uint32_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1u;
+
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    /* The one full fence on the owner's path. Publishing the smaller bottom and
+       then reading top must not be reordered, or the owner and a thief can both
+       take the last job: x86 only reorders a store with a later load, which is
+       precisely this pair. */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint32_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    if ((int32_t) (bottom - top) < 0)
+    {
+        __atomic_store_n(&deque->bottom, bottom + 1u, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    *out = deque->jobs[bottom & JOB_SYSTEM_DEQUE_MASK];
+    if (bottom != top)
+        return true;
+
+    /* Last job: race the thieves for it on top, like one of them. */
+    const bool won =
+        __atomic_compare_exchange_n(&deque->top, &top, top + 1u, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, bottom + 1u, __ATOMIC_RELAXED);
+    return won;
+}
+
+static bool job_system_steal(JobSystemSlot_t *deque, JobSystemJob_t *out)
+{
+    uint32_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    const uint32_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+    if ((int32_t) (bottom - top) <= 0)
+        return false;
+
+    /* The copy may be torn if the owner is refilling this cell, but the owner can
+       only reach it after top has moved past, and then the exchange below fails
+       and the copy is discarded. */
+    *out = deque->jobs[top & JOB_SYSTEM_DEQUE_MASK];
+    return __atomic_compare_exchange_n(&deque->top, &top, top + 1u, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+/*
+ * The owner end of a deque is only safe in the hands of one context at a time.
+ * With preemptive threads that is whoever runs on the CPU between reading its
+ * slot and finishing the push or pop, so both hold preemption off: a thread
+ * switched in on the same CPU mid-pop would otherwise push over a moved bottom,
+ * and one migrated mid-pop would pop another CPU's deque as its owner.
+ */
+static bool job_system_owner_pop(uint32_t *slot, JobSystemJob_t *out)
+{
+    kernel_thread_preempt_disable();
+    *slot = job_system_current_slot();
+    const bool popped = job_system_pop(&job_system_slots[*slot], out);
+    kernel_thread_preempt_enable();
+    return popped;
+}
+
+static bool job_system_try_run_one(void)
+{
+    JobSystemJob_t job;
+    uint32_t slot;
+
+    if (job_system_owner_pop(&slot, &job))
+    {
+        job_system_execute(slot, &job);
+        return true;
+    }
+
+    /* Start with the next slot rather than slot 0, so idle workers spread over
+       the victims instead of all hammering the BSP's top. */
+    const uint32_t participants = __atomic_load_n(&job_system_participant_mask, __ATOMIC_ACQUIRE);
+    for (uint32_t step = 1u; step < JOB_SYSTEM_SLOT_COUNT; ++step)
+    {
+        const uint32_t victim = (slot + step) % JOB_SYSTEM_SLOT_COUNT;
+
+        if ((participants & (1u << victim)) == 0u)
+            continue;
+        if (job_system_steal(&job_system_slots[victim], &job))
+        {
+            job_system_execute(slot, &job);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool job_system_any_queued(void)
+{
+    const uint32_t participants = __atomic_load_n(&job_system_participant_mask, __ATOMIC_ACQUIRE);
+
+    for (uint32_t slot = 0u; slot < JOB_SYSTEM_SLOT_COUNT; ++slot)
+    {
+        if ((participants & (1u << slot)) == 0u)
+            continue;
+
+        const JobSystemSlot_t *deque = &job_system_slots[slot];
+        if ((int32_t) (__atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE) -
+                       __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE)) > 0)
+            return true;
+    }
+    return false;
+}
+
+/* Rings up to @p wanted sleeping workers. A sleeping worker armed its monitor on
+   the doorbell, so the increment alone wakes it; the IPI is only for the HLT
+   fallback, where no write can end the sleep. */
+static void job_system_wake_workers(uint32_t self, uint32_t wanted)
+{
+    /* Pairs with the worker's flag-then-rescan: the jobs just pushed must be
+       visible before the flags are read, or both sides can miss each other. */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    const uint32_t workers = __atomic_load_n(&job_system_worker_mask, __ATOMIC_ACQUIRE);
+
+    for (uint32_t slot = 0u; slot < JOB_SYSTEM_SLOT_COUNT && wanted > 0u; ++slot)
+    {
+        if (slot == self || (workers & (1u << slot)) == 0u)
+            continue;
+
+        JobSystemSlot_t *worker = &job_system_slots[slot];
+        if (!__atomic_load_n(&worker->sleeping, __ATOMIC_ACQUIRE))
+            continue;
+
+        __atomic_add_fetch(&worker->doorbell, 1u, __ATOMIC_SEQ_CST);
+        if (!job_system_monitor_wakeup && advanced_pic_ipi_is_ready())
+        {
+            (void) advanced_pic_ipi_send_fixed((uint8_t) worker->apic_id, KERNEL_JOB_SYSTEM_WAKEUP_VECTOR,
+                                               ADVANCED_PIC_IPI_SHORT_NONE);
+            __atomic_add_fetch(&job_system_wakeup_ipi_count, 1u, __ATOMIC_RELAXED);
+        }
+        --wanted;
+    }
+}
+
+/** @brief Queue one job on the calling CPU's deque, or run it here when full. @p slot gets the CPU used. */
+static bool job_system_enqueue(uint32_t *slot, KernelJobGroup_t *group, KernelJobFunction_t function, void *context,
+                               uint32_t begin, uint32_t end)
+{
+    JobSystemJob_t job = {
+        .function = function,
+        .context = context,
+        .group = group,
+        .begin = begin,
+        .end = end,
+    };
+
+    __atomic_add_fetch(&group->pending, 1u, __ATOMIC_RELAXED);
+
+    kernel_thread_preempt_disable();
+    *slot = job_system_current_slot();
+    job.origin_slot = *slot;
+    if ((__atomic_load_n(&job_system_participant_mask, __ATOMIC_RELAXED) & (1u << *slot)) == 0u)
+        __atomic_or_fetch(&job_system_participant_mask, 1u << *slot, __ATOMIC_RELEASE);
+    const bool pushed = job_system_push(&job_system_slots[*slot], &job);
+    kernel_thread_preempt_enable();
+    if (pushed)
+        return true;
+
+    __atomic_add_fetch(&job_system_inline_count, 1u, __ATOMIC_RELAXED);
+    job_system_execute(*slot, &job);
+    return false;
+}
+
+void kernel_job_system_initialize(void)
+{
+    for (uint32_t slot = 0u; slot < JOB_SYSTEM_SLOT_COUNT; ++slot)
+    {
+        JobSystemSlot_t *deque = &job_system_slots[slot];
+
+        deque->top = 0u;
+        deque->bottom = 0u;
+        deque->doorbell = 0u;
+        deque->sleeping = 0u;
+        deque->apic_id = 0xFFu;
+        deque->worker = false;
+        deque->executed = 0u;
+        deque->stolen = 0u;
+    }
+
+    job_system_participant_mask = 0u;
+    job_system_worker_mask = 0u;
+    job_system_worker_count = 0u;
+    job_system_inline_count = 0u;
+    job_system_wakeup_ipi_count = 0u;
+
+    /* The probe also zeroes the sleep accounting, which is what a boot wants. */
+    kernel_processor_sleep_initialize();
+    job_system_monitor_wakeup = kernel_processor_sleep_has_monitor();
+
+    interrupt_service_routine_register_handler(KERNEL_JOB_SYSTEM_WAKEUP_VECTOR, job_system_wakeup_handler);
+}
+
+void kernel_job_system_register_worker(uint32_t slot, uint32_t apic_id)
+{
+    if (slot >= JOB_SYSTEM_SLOT_COUNT)
+        return;
+
+    JobSystemSlot_t *deque = &job_system_slots[slot];
+    if (deque->worker)
+        return;
+
+    deque->apic_id = apic_id;
+    deque->worker = true;
+    __atomic_add_fetch(&job_system_worker_count, 1u, __ATOMIC_RELAXED);
+    __atomic_or_fetch(&job_system_participant_mask, 1u << slot, __ATOMIC_RELEASE);
+    __atomic_or_fetch(&job_system_worker_mask, 1u << slot, __ATOMIC_RELEASE);
+}
+
+void kernel_job_system_worker_loop(void)
+{
+    /* An AP's boot thread, pinned: its slot does not change under it. */
+    const uint32_t slot = job_system_current_slot();
+    JobSystemSlot_t *self = &job_system_slots[slot];
+
+    for (;;)
+    {
+        if (job_system_try_run_one())
+            continue;
+
+        /* Idle time is what the telemetry drain runs on. One budget at a time, and
+           the queues are looked at again between budgets, so a job waits at most
+           one of them. */
+        if (kernel_telemetry_stream_drain(0u) != 0u)
+            continue;
+
+        /* Announce the sleep, then look once more. A submitter that queued after
+           the scan above either sees the flag and rings, or queued before the flag
+           and is caught by this second look; the doorbell value read first makes
+           a ring between here and the sleep end it immediately. */
+        const uint32_t seen = __atomic_load_n(&self->doorbell, __ATOMIC_ACQUIRE);
+        __atomic_store_n(&self->sleeping, 1u, __ATOMIC_SEQ_CST);
+
+        if (!job_system_any_queued())
+            (void) processor_sleep_until_write(&self->doorbell, seen);
+
+        __atomic_store_n(&self->sleeping, 0u, __ATOMIC_RELEASE);
+    }
+}
+
+bool kernel_job_system_submit(KernelJobGroup_t *group, KernelJobFunction_t function, void *context, uint32_t begin,
+                              uint32_t end)
+{
+    if (!group || !function)
+        return false;
+
+    uint32_t slot;
+    if (!job_system_enqueue(&slot, group, function, context, begin, end))
+        return false;
+
+    job_system_wake_workers(slot, 1u);
+    return true;
+}
+
+uint32_t kernel_job_system_submit_range(KernelJobGroup_t *group, KernelJobFunction_t function, void *context,
+                                        uint32_t count, uint32_t grain)
+{
+    if (!group || !function || count == 0u)
+        return 0u;
+
+    if (grain == 0u)
+        grain = 1u;
+
+    uint32_t slot = 0u;
+    uint32_t jobs = 0u;
+    uint32_t queued = 0u;
+    for (uint32_t begin = 0u; begin < count; begin += grain)
+    {
+        const uint32_t end = (count - begin > grain) ? begin + grain : count;
+
+        if (job_system_enqueue(&slot, group, function, context, begin, end))
+            ++queued;
+        ++jobs;
+    }
+
+    if (queued > 0u)
+        job_system_wake_workers(slot, queued);
+
+    return jobs;
+}
+
+void kernel_job_system_wait(KernelJobGroup_t *group)
+{
+    if (!group)
+        return;
+
+    while (__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE) != 0u)
+    {
+        if (!job_system_try_run_one())
+            __asm__ volatile("pause");
+    }
+}
+
+uint32_t kernel_job_system_get_worker_count(void) { return job_system_worker_count; }
+
+uint32_t kernel_job_system_get_executed_count(void)
+{
+    uint32_t total = 0u;
+
+    for (uint32_t slot = 0u; slot < JOB_SYSTEM_SLOT_COUNT; ++slot)
+        total += job_system_slots[slot].executed;
+    return total;
+}
+
+uint32_t kernel_job_system_get_steal_count(void)
+{
+    uint32_t total = 0u;
+
+    for (uint32_t slot = 0u; slot < JOB_SYSTEM_SLOT_COUNT; ++slot)
+        total += job_system_slots[slot].stolen;
+    return total;
+}
+
+uint32_t kernel_job_system_get_inline_count(void) { return job_system_inline_count; }
+
+uint32_t kernel_job_system_get_wakeup_ipi_count(void) { return job_system_wakeup_ipi_count; }
+
+uint32_t kernel_job_system_get_slot_executed_count(uint32_t slot)
+{
+    if (slot >= JOB_SYSTEM_SLOT_COUNT)
+        return 0u;
+
+    return job_system_slots[slot].executed;
+}
@@ -13,6 +13,7 @@
 #include <kernel/cpu/apic_timer.h>
 #include <kernel/cpu/clock.h>
 #include <kernel/cpu/cpu_topology.h>
+#include <kernel/cpu/fpu.h>
 #include <kernel/cpu/helpers/acpi_helper.h>
 #include <kernel/cpu/helpers/ap_startup_helper.h>
 #include <kernel/cpu/helpers/apic_timer_helper.h>
@@ -22,22 +23,30 @@
 #include <kernel/cpu/helpers/ioapic_helper.h>
 #include <kernel/cpu/helpers/pci_helper.h>
 #include <kernel/cpu/idt.h>
+#include <kernel/cpu/interrupt_affinity.h>
+#include <kernel/cpu/interrupt_vector.h>
 #include <kernel/cpu/ioapic.h>
 #include <kernel/cpu/irq.h>
+#include <kernel/cpu/msi.h>
 #include <kernel/cpu/numa_policy.h>
 #include <kernel/cpu/paging.h>
 #include <kernel/cpu/pci.h>
 #include <kernel/cpu/pic.h>
 #include <kernel/cpu/pmm.h>
+#include <kernel/cpu/tlb_shootdown.h>
 #include <kernel/drivers/framebuffer.h>
 #include <kernel/drivers/helpers/keyboard_helper.h>
+#include <kernel/drivers/input_event.h>
 #include <kernel/drivers/keyboard.h>
 #include <kernel/drivers/ps2_keyboard.h>
 #include <kernel/drivers/ps2_mouse.h>
 #include <kernel/hal/hal.h>
+#include <kernel/memory/allocator_registry.h>
 #include <kernel/memory/backpressure.h>
+#include <kernel/memory/dma.h>
 #include <kernel/memory/frame_arena.h>
 #include <kernel/memory/heap.h>
+#include <kernel/memory/heap_trace.h>
 #include <kernel/memory/helpers/core_allocators_helper.h>
 #include <kernel/memory/helpers/heap_helper.h>
 #include <kernel/memory/helpers/pmm_helper.h>
@@ -53,15 +62,23 @@
 #include <kernel/testing/smoke_test.h>
 
 #include <kernel/core/console.h>
+#include <kernel/core/job_system.h>
+#include <kernel/core/lock.h>
 #include <kernel/core/reconciler.h>
 #include <kernel/core/smp.h>
 #include <kernel/core/splash.h>
+#include <kernel/core/thread.h>
+#include <kernel/core/timer.h>
 #include <kernel/diag/sysmon.h>
 #include <kernel/diag/telemetry.h>
+#include <kernel/diag/telemetry_stream.h>
+#include <kernel/diag/trace.h>
 #include <kernel/dialogue/dialogue_channel.h>
 #include <kernel/testing/smoke_batch.h>
 #include <kernel/testing/smoke_libengine.h>
 
+#include <sys/memory_dispatch.h>
+
 /* The engine module is optional: when LplPlugin is absent, config.sh drops
    libengine from SYSTEM_HEADER_PROJECTS (so this header is never installed into
    the sysroot) and the Makefile sets LPL_PLUGIN_UNAVAILABLE. The include must
@@ -72,6 +89,7 @@
 #endif
 
 #define KERNEL_FRAME_ARENA_DEFAULT_CAPACITY_BYTES     16384u
+#define KERNEL_FRAME_ARENA_PER_CPU_CAPACITY_BYTES     4096u
 #define KERNEL_STACK_ALLOCATOR_DEFAULT_CAPACITY_BYTES 16384u
 #define KERNEL_POOL_ALLOCATOR_DEFAULT_OBJECT_SIZE     64u
 #define KERNEL_POOL_ALLOCATOR_DEFAULT_OBJECT_COUNT    128u
@@ -96,6 +114,7 @@ extern MultibootInfo_t *multiboot_info;
 GlobalDescriptorTable_t global_descriptor_table = {0};
 InterruptDescriptorTable_t interrupt_descriptor_table = {0};
 static TaskStateSegment_t task_state_segment = {0};
+static uint32_t kernel_global_text_page_count = 0u;
 Serial_t com1;
 
 static uint8_t kernel_policy_enable_apic_timer_owner(void)
@@ -123,11 +142,13 @@ static uint8_t kernel_policy_enable_ioapic_keyboard_owner(void)
  * place answers "what can drop, and does it matter" — a driver registering itself
  * would put the answer back where nobody looks. Capacities are read from the queues
  * themselves so no number is written down twice.
+ *
+ * Rings are the exception: kernel_ring_initialize() takes the policy as an argument
+ * and registers the instance itself, "kernel_ring" included, so the registry is not
+ * reset here.
  */
 static void kernel_register_bounded_queues(void)
 {
-    kernel_backpressure_reset();
-
     /* A missed scan code is a missed keystroke and nothing more. */
     kernel_backpressure_register("keyboard_scancode", KERNEL_BACKPRESSURE_POLICY_DROP_TOLERATED,
                                  keyboard_get_ring_capacity(), keyboard_get_dropped_char_count);
@@ -142,12 +163,6 @@ static void kernel_register_bounded_queues(void)
        sentence: the consumer reads what remains and cannot tell it is incomplete. */
     kernel_backpressure_register("dialogue_byte", KERNEL_BACKPRESSURE_POLICY_DROP_CORRUPTS,
                                  KERNEL_DIALOGUE_CHANNEL_CAPACITY, kernel_dialogue_channel_dropped);
-
-    /* The general-purpose ring carries whole records, so a refused enqueue loses one
-       record and leaves the others intact. Its counter is also raised on purpose by
-       the ring smoke, which is exactly why it must not be counted as corrupting. */
-    kernel_backpressure_register("kernel_ring", KERNEL_BACKPRESSURE_POLICY_DROP_TOLERATED,
-                                 kernel_ring_buffer_get_capacity(), kernel_ring_buffer_get_failed_enqueue_count);
 }
 
 /**
@@ -166,6 +181,46 @@ static void kernel_declare_reconciler_contract(void)
     kernel_reconciler_declare(&declaration);
 }
 
+/**
+ * @brief Emit what presenting has cost so far; nothing on the software LFB,
+ *        whose present is free.
+ */
+static void kernel_display_present_report(Serial_t *serial)
+{
+    hardware_abstraction_layer_display_present_statistics_t statistics;
+    if (!hardware_abstraction_layer_display_get_present_statistics(&statistics))
+        return;
+
+    kernel_telemetry_begin_record(serial, "display_present");
+    kernel_telemetry_write_unsigned("buffers", statistics.buffer_count);
+    kernel_telemetry_write_unsigned("irq_line", statistics.interrupt_line);
+    kernel_telemetry_write_unsigned("irq_vector", statistics.interrupt_vector);
+    kernel_telemetry_write_unsigned("presents", statistics.presents);
+    kernel_telemetry_write_unsigned("rects_last", statistics.rects_last);
+    kernel_telemetry_write_unsigned("bytes_last", statistics.bytes_last);
+    kernel_telemetry_write_unsigned("kib_total", (uint32_t) (statistics.bytes_total >> 10));
+    kernel_telemetry_write_unsigned("stalled", statistics.stalled_presents);
+    kernel_telemetry_write_unsigned("stall_cycles_last", statistics.stall_cycles_last);
+    kernel_telemetry_write_unsigned("stall_cycles_max", statistics.stall_cycles_max);
+    kernel_telemetry_write_unsigned("completion_irqs", statistics.completion_interrupts);
+    kernel_telemetry_write_unsigned("errors", statistics.errors);
+    kernel_telemetry_end_record();
+}
+
+/**
+ * @brief Emit which paging extensions are live and what uses them.
+ */
+static void kernel_paging_extensions_report(Serial_t *serial)
+{
+    kernel_telemetry_begin_record(serial, "paging_extensions");
+    kernel_telemetry_write_boolean("pse", paging_large_pages_available());
+    kernel_telemetry_write_boolean("pge", paging_global_pages_available());
+    kernel_telemetry_write_boolean("pat", paging_page_attribute_table_available());
+    kernel_telemetry_write_unsigned("large_pages", paging_get_large_page_count());
+    kernel_telemetry_write_unsigned("global_text_pages", kernel_global_text_page_count);
+    kernel_telemetry_end_record();
+}
+
 /**
  * @brief Main kernel initialization function, called as a constructor before main().
  *
@@ -220,6 +275,8 @@ __attribute__((constructor)) void kernel_initialize(void)
     serial_write_string(&com1, "[" KERNEL_SYSTEM_STRING "]: loading IDT into CPU...\n");
     interrupt_descriptor_table_load(&interrupt_descriptor_table);
     serial_write_string(&com1, "[" KERNEL_SYSTEM_STRING "]: IDT loaded successfully!\n");
+    interrupt_fpu_initialize();
+    libk_memory_dispatch_initialize();
     kernel_splash_update("Interrupt Descriptor Table");
 
     serial_write_string(&com1, "[" KERNEL_SYSTEM_STRING "]: initializing clock policy...\n");
@@ -229,11 +286,21 @@ __attribute__((constructor)) void kernel_initialize(void)
 
     cpu_topology_initialize();
     write_cpu_topology_info(&com1);
+
+    /* After the topology, so each record lands in the ring of the CPU that wrote
+       it; before anything reports, so no record is split across the two paths. */
+    (void) kernel_telemetry_stream_initialize(&com1);
     kernel_splash_update("CPU Topology & MP Spec");
 
     serial_write_string(&com1, "[" KERNEL_SYSTEM_STRING "]: initializing runtime paging...\n");
     paging_initialize_runtime();
     serial_write_string(&com1, "[" KERNEL_SYSTEM_STRING "]: runtime paging initialized successfully!\n");
+    serial_write_string(&com1, paging_initialize_page_attribute_table()
+                                   ? "[" KERNEL_SYSTEM_STRING "]: PAT programmed (PA4 = write-combining)\n"
+                                   : "[" KERNEL_SYSTEM_STRING "]: no PAT: write-combining maps as write-through\n");
+    serial_write_string(&com1, paging_initialize_page_size_extensions()
+                                   ? "[" KERNEL_SYSTEM_STRING "]: PSE enabled (4 MiB pages for large allocations)\n"
+                                   : "[" KERNEL_SYSTEM_STRING "]: no PSE: every mapping uses 4 KiB pages\n");
     kernel_vmm_initialize();
     serial_write_string(&com1, "[" KERNEL_SYSTEM_STRING "]: kernel VMM initialized successfully!\n");
     kernel_splash_update("Runtime Paging & VMM");
@@ -254,21 +321,41 @@ __attribute__((constructor)) void kernel_initialize(void)
     kernel_splash_update("Physical Memory Manager Pass 2");
 
     kernel_heap_initialize();
+    /* Before the first kmalloc, so a boot capture replays from an empty heap. */
+    if (kernel_heap_trace_initialize())
+    {
+#if defined(LPL_KERNEL_HEAP_TRACE)
+        kernel_heap_trace_start();
+#endif
+    }
     write_heap_info(&com1);
     kernel_splash_update("Kernel Dynamic Heap");
 
     bool frame_arena_ok = kernel_frame_arena_initialize(KERNEL_FRAME_ARENA_DEFAULT_CAPACITY_BYTES);
+    /* MADT discovery has run, so every CPU that will come up already has a slot. */
+    frame_arena_ok = kernel_frame_arena_per_cpu_initialize(KERNEL_FRAME_ARENA_PER_CPU_CAPACITY_BYTES) && frame_arena_ok;
     bool stack_allocator_ok = kernel_stack_allocator_initialize(KERNEL_STACK_ALLOCATOR_DEFAULT_CAPACITY_BYTES);
     bool pool_allocator_ok = kernel_pool_allocator_initialize(KERNEL_POOL_ALLOCATOR_DEFAULT_OBJECT_SIZE,
                                                               KERNEL_POOL_ALLOCATOR_DEFAULT_OBJECT_COUNT);
     bool pinned_ok = kernel_pinned_memory_initialize();
     write_core_allocators_info(&com1, frame_arena_ok, stack_allocator_ok, pool_allocator_ok, pinned_ok);
 
+    /* Last of the core allocators: the buddy now holds all of memory, so the DMA
+       block cache is split from what will stay free, not from boot leftovers. */
+    (void) kernel_dma_initialize();
+
     bool ring_buffer_ok = kernel_ring_buffer_initialize_ex(
         KERNEL_RING_BUFFER_DEFAULT_SLOT_SIZE, KERNEL_RING_BUFFER_DEFAULT_SLOT_COUNT, KERNEL_RING_BUFFER_MODE_SPSC);
     write_ring_buffer_info(&com1, ring_buffer_ok);
+    /* The PS/2 handlers are already installed; they publish once this backs the ring. */
+    (void) kernel_input_event_initialize();
     kernel_splash_update("Core Allocators (Slab, Pool, Ring)");
 
+    /* Recording from here on, so the console's `trace` always has the recent past
+       to show, boot included. */
+    if (kernel_trace_initialize())
+        kernel_trace_enable();
+
     write_heap_extended_info(&com1);
 
     write_pmm_buddy_info(&com1);
@@ -305,6 +392,10 @@ __attribute__((constructor)) void kernel_initialize(void)
     write_ioapic_routes_info(&com1);
     kernel_splash_update("IOAPIC Dynamic Routing & Routes");
 
+    /* Before the APs, which register as workers on their way up. Without any AP
+       the job system still runs every job on the submitter. */
+    kernel_job_system_initialize();
+
     if (advanced_pic_timer_backend_late_initialize())
     {
         advanced_pic_ipi_initialize(advanced_pic_timer_backend_get_local_apic_virtual_base());
@@ -335,9 +426,16 @@ __attribute__((constructor)) void kernel_initialize(void)
         {
             write_apic_calibration_info(&com1);
 
+            /* Deadline timers on every CPU's LAPIC. When the LAPIC also takes the
+               tick, the tick becomes one of those timers rather than periodic mode,
+               which would leave no local timer for anything else. */
+            (void) kernel_timer_initialize();
+
             if (kernel_policy_enable_apic_timer_owner())
             {
-                if (advanced_pic_timer_backend_enable_periodic_mode(interrupt_request_get_timer_frequency_hz()))
+                const uint32_t tick_hz = interrupt_request_get_timer_frequency_hz();
+
+                if (kernel_timer_system_tick_start(tick_hz) || advanced_pic_timer_backend_enable_periodic_mode(tick_hz))
                 {
                     write_apic_owner_handoff_info(&com1, 1u);
                 }
@@ -360,6 +458,9 @@ __attribute__((constructor)) void kernel_initialize(void)
     {
         write_apic_late_init_skipped_info(&com1);
     }
+
+    /* Threads need the timers for slices and sleeps, and the APs up to adopt. */
+    (void) kernel_thread_initialize();
     kernel_splash_update("Symmetric Multiprocessing & Timers");
 
 #if defined(LPL_KERNEL_ENABLE_SMOKE_TESTS)
@@ -381,9 +482,13 @@ __attribute__((constructor)) void kernel_initialize(void)
         serial_write_hex32(&com1, surface.height);
         serial_write_string(&com1, "\n");
 
-        /* Liveness: clear to a recognisable color and present through the GPU. */
+        /* Liveness: clear to a recognisable color and present through the GPU,
+           then once more with a single small damaged region, which is the
+           path every later frame that marks its damage takes. */
         hardware_abstraction_layer_display_clear(0x00102040u);
         hardware_abstraction_layer_display_present();
+        hardware_abstraction_layer_display_mark_damage(0u, 0u, 64u, 64u);
+        hardware_abstraction_layer_display_present();
     }
     else
     {
@@ -392,6 +497,12 @@ __attribute__((constructor)) void kernel_initialize(void)
 
     write_keyboard_runtime_info(&com1);
 
+    /* Last of the devices that take interrupts at boot; the ones brought up later
+       (audio) are found by the next periodic pass. The boot path runs the engine,
+       so until the step timer says otherwise its CPU is the tick CPU. */
+    interrupt_affinity_set_tick_cpu(cpu_topology_get_logical_slot());
+    (void) interrupt_affinity_initialize();
+
     if (framebuffer_init())
         serial_write_string(&com1, "[" KERNEL_SYSTEM_STRING "]: framebuffer initialized successfully!\n");
     else
@@ -409,6 +520,11 @@ void kernel_main(void)
        constants or those tables again. */
     write_section_protection_info(&com1, kernel_section_protection_apply());
 
+    /* Text never moves once protected, so its TLB entries may outlive every CR3
+       reload: the shootdown's full flushes then cost data misses only. */
+    kernel_global_text_page_count = paging_mark_range_global(kernel_section_protection_get_range_start(),
+                                                             kernel_section_protection_get_range_end());
+
     /* Declared after the protection pass, so the page count it commits to is the
        one that was actually established rather than the one that was intended. */
     kernel_register_bounded_queues();
@@ -421,12 +537,38 @@ void kernel_main(void)
     smoke_libengine_run_all(&com1);
 #endif
 
+#if defined(LPL_KERNEL_HEAP_TRACE)
+    (void) kernel_heap_trace_export(&com1);
+#endif
+
     /* After the batteries rather than before: by now the periodic tick has driven
        passes of its own, so `passes` exceeding what the smoke drove by hand is
        what shows the live check is running and not merely wired. */
     kernel_reconciler_report(&com1);
+    interrupt_fpu_report(&com1);
+    kernel_lock_report(&com1);
+    kernel_display_present_report(&com1);
+    message_signaled_interrupt_report(&com1);
+    interrupt_vector_report(&com1);
+    interrupt_affinity_report(&com1);
+    kernel_input_event_report(&com1);
+    kernel_paging_extensions_report(&com1);
+    kernel_dma_report(&com1);
+    tlb_shootdown_report(&com1);
+    kernel_timer_report(&com1);
+    kernel_thread_report(&com1);
+    kernel_allocator_registry_report(&com1);
+    kernel_slab_report(&com1);
+    kernel_tlsf_report(&com1, kernel_tlsf_get_default());
+    kernel_tlsf_report(&com1, kernel_heap_get_engine_tlsf());
+    kernel_trace_report(&com1);
+    kernel_heap_trace_report(&com1);
     kernel_telemetry_report(&com1);
 
+    /* The boot reports are the ones a checker waits for; they go out now rather
+       than whenever the first idle moment comes. */
+    kernel_telemetry_stream_flush();
+
     if (hardware_abstraction_layer_display_available())
     {
 #if defined(LPL_PLUGIN_UNAVAILABLE)
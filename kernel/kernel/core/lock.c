@@ -0,0 +1,364 @@
+/**
+ * @file lock.c
+ * @brief Ticket, MCS and reader/writer spinlocks with per-lock contention counters.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#include <kernel/core/lock.h>
+
+#include <kernel/core/thread.h>
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/diag/telemetry.h>
+
+#include <stddef.h>
+
+#define LOCK_RW_WRITER         0x80000000u
+#define LOCK_RW_WRITER_WAITING 0x40000000u
+#define LOCK_RW_READER_MASK    0x3FFFFFFFu
+
+static KernelLockStatistics_t lock_shared_statistics = {.name = "shared"};
+static KernelLockStatistics_t *volatile lock_registry_head = NULL;
+
+static inline uint32_t lock_read_timestamp_low(void)
+{
+    uint32_t low;
+
+    __asm__ volatile("rdtsc" : "=a"(low)::"edx");
+    return low;
+}
+
+static inline void lock_cpu_relax(void) { __asm__ volatile("pause" ::: "memory"); }
+
+static inline uint32_t lock_save_and_disable_interrupts(void)
+{
+    uint32_t flags;
+
+    __asm__ volatile("pushfl\n\tpopl %0\n\tcli" : "=r"(flags)::"memory");
+    return flags;
+}
+
+static inline void lock_restore_interrupts(uint32_t flags)
+{
+    __asm__ volatile("pushl %0\n\tpopfl" ::"r"(flags) : "memory", "cc");
+}
+
+/* Called by the new holder, so a lock's own block needs no atomics. The shared
+   bucket is written by whoever holds any anonymous lock, hence the locked adds,
+   and only when there is something to add: an uncontended kstd::mutex pays
+   nothing here. */
+static void lock_account_acquire(KernelLockStatistics_t *statistics, uint32_t spins)
+{
+    if (statistics)
+    {
+        ++statistics->acquisitions;
+        if (spins)
+        {
+            ++statistics->contended;
+            statistics->spins += spins;
+        }
+        return;
+    }
+
+    if (spins)
+    {
+        __atomic_fetch_add(&lock_shared_statistics.contended, 1u, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&lock_shared_statistics.spins, spins, __ATOMIC_RELAXED);
+    }
+}
+
+static void lock_account_release(KernelLockStatistics_t *statistics, uint32_t acquired_at)
+{
+    const uint32_t held = lock_read_timestamp_low() - acquired_at;
+
+    if (statistics)
+    {
+        if (held > statistics->max_hold_cycles)
+            statistics->max_hold_cycles = held;
+        return;
+    }
+
+    uint32_t seen = __atomic_load_n(&lock_shared_statistics.max_hold_cycles, __ATOMIC_RELAXED);
+    while (held > seen && !__atomic_compare_exchange_n(&lock_shared_statistics.max_hold_cycles, &seen, held, true,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+void kernel_lock_statistics_register(KernelLockStatistics_t *statistics, const char *name)
+{
+    if (!statistics)
+        return;
+
+    statistics->name = name;
+
+    for (KernelLockStatistics_t *it = lock_registry_head; it; it = it->next)
+        if (it == statistics)
+            return;
+
+    KernelLockStatistics_t *head = lock_registry_head;
+    do
+        statistics->next = head;
+    while (!__atomic_compare_exchange_n(&lock_registry_head, &head, statistics, true, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED));
+}
+
+const KernelLockStatistics_t *kernel_lock_get_shared_statistics(void) { return &lock_shared_statistics; }
+
+static void lock_report_one(Serial_t *serial_port, const KernelLockStatistics_t *statistics)
+{
+    kernel_telemetry_begin_record(serial_port, "lock");
+    kernel_telemetry_write_text("name", statistics->name ? statistics->name : "?");
+    kernel_telemetry_write_unsigned("acquisitions", statistics->acquisitions);
+    kernel_telemetry_write_unsigned("contended", statistics->contended);
+    kernel_telemetry_write_unsigned("spins", statistics->spins);
+    kernel_telemetry_write_unsigned("max_hold_cycles", statistics->max_hold_cycles);
+    kernel_telemetry_end_record();
+}
+
+void kernel_lock_report(Serial_t *serial_port)
+{
+    for (const KernelLockStatistics_t *it = lock_registry_head; it; it = it->next)
+        lock_report_one(serial_port, it);
+    lock_report_one(serial_port, &lock_shared_statistics);
+}
+
+uint32_t kernel_lock_current_owner(void)
+{
+    /* A thread can be preempted holding a recursive lock and resumed on another
+       CPU: once there are threads, the thread owns it. */
+    const KernelThread_t *thread = kernel_thread_current();
+
+    if (thread)
+        return (uint32_t) (uintptr_t) thread;
+    return cpu_topology_get_logical_slot() + 1u;
+}
+
+/* -- Ticket lock --------------------------------------------------------- */
+
+void kernel_ticket_lock_initialize(KernelTicketLock_t *lock, KernelLockStatistics_t *statistics)
+{
+    lock->serving = 0u;
+    lock->next = 0u;
+    lock->acquired_at = 0u;
+    lock->statistics = statistics;
+}
+
+void kernel_ticket_lock_acquire(KernelTicketLock_t *lock)
+{
+    const uint16_t ticket = __atomic_fetch_add(&lock->next, 1u, __ATOMIC_ACQUIRE);
+    uint32_t spins = 0u;
+
+    while (__atomic_load_n(&lock->serving, __ATOMIC_ACQUIRE) != ticket)
+    {
+        lock_cpu_relax();
+        ++spins;
+    }
+
+    lock_account_acquire(lock->statistics, spins);
+    lock->acquired_at = lock_read_timestamp_low();
+}
+
+bool kernel_ticket_lock_try_acquire(KernelTicketLock_t *lock)
+{
+    uint16_t next = __atomic_load_n(&lock->next, __ATOMIC_RELAXED);
+
+    /* serving only moves on a release, and there is no holder to release when
+       it equals next, so winning the CAS on next alone is enough. */
+    if (__atomic_load_n(&lock->serving, __ATOMIC_ACQUIRE) != next)
+        return false;
+    if (!__atomic_compare_exchange_n(&lock->next, &next, (uint16_t) (next + 1u), false, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED))
+        return false;
+
+    lock_account_acquire(lock->statistics, 0u);
+    lock->acquired_at = lock_read_timestamp_low();
+    return true;
+}
+
+void kernel_ticket_lock_release(KernelTicketLock_t *lock)
+{
+    lock_account_release(lock->statistics, lock->acquired_at);
+
+    /* Only the holder writes serving: a plain store, ordered by TSO. */
+    __atomic_store_n(&lock->serving, (uint16_t) (lock->serving + 1u), __ATOMIC_RELEASE);
+}
+
+bool kernel_ticket_lock_is_locked(const KernelTicketLock_t *lock)
+{
+    return __atomic_load_n(&lock->serving, __ATOMIC_RELAXED) != __atomic_load_n(&lock->next, __ATOMIC_RELAXED);
+}
+
+uint32_t kernel_ticket_lock_acquire_irqsave(KernelTicketLock_t *lock)
+{
+    const uint32_t flags = lock_save_and_disable_interrupts();
+
+    kernel_ticket_lock_acquire(lock);
+    return flags;
+}
+
+void kernel_ticket_lock_release_irqrestore(KernelTicketLock_t *lock, uint32_t flags)
+{
+    kernel_ticket_lock_release(lock);
+    lock_restore_interrupts(flags);
+}
+
+/* -- MCS queue lock ------------------------------------------------------ */
+
+void kernel_mcs_lock_initialize(KernelMcsLock_t *lock, KernelLockStatistics_t *statistics)
+{
+    lock->tail = NULL;
+    lock->acquired_at = 0u;
+    lock->statistics = statistics;
+}
+
+void kernel_mcs_lock_acquire(KernelMcsLock_t *lock, KernelMcsNode_t *node)
+{
+    uint32_t spins = 0u;
+
+    node->next = NULL;
+    node->locked = 1u;
+
+    KernelMcsNode_t *predecessor = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+    if (predecessor)
+    {
+        __atomic_store_n(&predecessor->next, node, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE))
+        {
+            lock_cpu_relax();
+            ++spins;
+        }
+        /* A hand-over that needed no spin still waited in the queue. */
+        if (!spins)
+            spins = 1u;
+    }
+
+    lock_account_acquire(lock->statistics, spins);
+    lock->acquired_at = lock_read_timestamp_low();
+}
+
+bool kernel_mcs_lock_try_acquire(KernelMcsLock_t *lock, KernelMcsNode_t *node)
+{
+    KernelMcsNode_t *expected = NULL;
+
+    node->next = NULL;
+    node->locked = 0u;
+    if (!__atomic_compare_exchange_n(&lock->tail, &expected, node, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return false;
+
+    lock_account_acquire(lock->statistics, 0u);
+    lock->acquired_at = lock_read_timestamp_low();
+    return true;
+}
+
+void kernel_mcs_lock_release(KernelMcsLock_t *lock, KernelMcsNode_t *node)
+{
+    lock_account_release(lock->statistics, lock->acquired_at);
+
+    KernelMcsNode_t *successor = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    if (!successor)
+    {
+        KernelMcsNode_t *expected = node;
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, NULL, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            return;
+
+        /* A waiter swapped itself in but has not linked to us yet. */
+        while (!(successor = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)))
+            lock_cpu_relax();
+    }
+
+    __atomic_store_n(&successor->locked, 0u, __ATOMIC_RELEASE);
+}
+
+uint32_t kernel_mcs_lock_acquire_irqsave(KernelMcsLock_t *lock, KernelMcsNode_t *node)
+{
+    const uint32_t flags = lock_save_and_disable_interrupts();
+
+    kernel_mcs_lock_acquire(lock, node);
+    return flags;
+}
+
+void kernel_mcs_lock_release_irqrestore(KernelMcsLock_t *lock, KernelMcsNode_t *node, uint32_t flags)
+{
+    kernel_mcs_lock_release(lock, node);
+    lock_restore_interrupts(flags);
+}
+
+/* -- Reader/writer lock -------------------------------------------------- */
+
+void kernel_rw_lock_initialize(KernelRwLock_t *lock, KernelLockStatistics_t *statistics)
+{
+    lock->state = 0u;
+    lock->acquired_at = 0u;
+    lock->statistics = statistics;
+}
+
+bool kernel_rw_lock_read_try_acquire(KernelRwLock_t *lock)
+{
+    uint32_t state = __atomic_load_n(&lock->state, __ATOMIC_RELAXED);
+
+    if (state & (LOCK_RW_WRITER | LOCK_RW_WRITER_WAITING))
+        return false;
+    return __atomic_compare_exchange_n(&lock->state, &state, state + 1u, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+void kernel_rw_lock_read_acquire(KernelRwLock_t *lock)
+{
+    while (!kernel_rw_lock_read_try_acquire(lock))
+        lock_cpu_relax();
+}
+
+void kernel_rw_lock_read_release(KernelRwLock_t *lock) { __atomic_fetch_sub(&lock->state, 1u, __ATOMIC_RELEASE); }
+
+bool kernel_rw_lock_write_try_acquire(KernelRwLock_t *lock)
+{
+    uint32_t state = __atomic_load_n(&lock->state, __ATOMIC_RELAXED);
+
+    if (state & (LOCK_RW_WRITER | LOCK_RW_READER_MASK))
+        return false;
+    if (!__atomic_compare_exchange_n(&lock->state, &state, LOCK_RW_WRITER, false, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED))
+        return false;
+
+    lock_account_acquire(lock->statistics, 0u);
+    lock->acquired_at = lock_read_timestamp_low();
+    return true;
+}
+
+void kernel_rw_lock_write_acquire(KernelRwLock_t *lock)
+{
+    uint32_t spins = 0u;
+
+    for (;;)
+    {
+        uint32_t state = __atomic_load_n(&lock->state, __ATOMIC_RELAXED);
+
+        /* Free of readers and writers: take it, dropping the waiting bit, which
+           any other waiting writer sets again on its next pass. */
+        if (!(state & (LOCK_RW_WRITER | LOCK_RW_READER_MASK)))
+        {
+            if (__atomic_compare_exchange_n(&lock->state, &state, LOCK_RW_WRITER, false, __ATOMIC_ACQUIRE,
+                                            __ATOMIC_RELAXED))
+                break;
+            continue;
+        }
+
+        if (!(state & LOCK_RW_WRITER_WAITING))
+            __atomic_fetch_or(&lock->state, LOCK_RW_WRITER_WAITING, __ATOMIC_RELAXED);
+        lock_cpu_relax();
+        ++spins;
+    }
+
+    lock_account_acquire(lock->statistics, spins);
+    lock->acquired_at = lock_read_timestamp_low();
+}
+
+void kernel_rw_lock_write_release(KernelRwLock_t *lock)
+{
+    lock_account_release(lock->statistics, lock->acquired_at);
+
+    /* An AND rather than a store: a writer queued behind us may have set the
+       waiting bit, and it must survive the release. */
+    __atomic_fetch_and(&lock->state, ~LOCK_RW_WRITER, __ATOMIC_RELEASE);
+}
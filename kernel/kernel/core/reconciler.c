@@ -1,6 +1,7 @@
 #include <kernel/core/reconciler.h>
 #include <kernel/diag/telemetry.h>
 #include <kernel/lib/asmutils.h>
+#include <kernel/memory/allocator_registry.h>
 #include <kernel/memory/backpressure.h>
 #include <kernel/memory/frame_arena.h>
 #include <kernel/memory/heap.h>
@@ -170,5 +171,7 @@ void kernel_reconciler_report(Serial_t *serial)
     kernel_telemetry_write_unsigned("queues", kernel_backpressure_get_queue_count());
     kernel_telemetry_write_unsigned("queue_drops", kernel_backpressure_get_total_drop_count());
     kernel_telemetry_write_unsigned("queue_corrupting_drops", kernel_backpressure_get_intolerant_drop_count());
+    kernel_telemetry_write_unsigned("allocators", kernel_allocator_registry_get_count());
+    kernel_telemetry_write_unsigned("allocator_failures", kernel_allocator_registry_get_total_failures());
     kernel_telemetry_end_record();
 }
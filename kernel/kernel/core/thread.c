@@ -0,0 +1,1346 @@
+/**
+ * @file thread.c
+ * @brief Kernel threads and the per-CPU fixed-priority / EDF scheduler.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#include <kernel/core/thread.h>
+
+#include <kernel/core/lock.h>
+#include <kernel/core/timer.h>
+#include <kernel/cpu/apic.h>
+#include <kernel/cpu/apic_ipi.h>
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/cpu/fpu.h>
+#include <kernel/cpu/gdt.h>
+#include <kernel/diag/telemetry.h>
+#include <kernel/lib/asmutils.h>
+#include <kernel/memory/pool_allocator.h>
+#include <kernel/power/processor_sleep.h>
+
+#include <string.h>
+
+#define THREAD_EFLAGS_INTERRUPTS 0x200u
+#define THREAD_EFLAGS_RESERVED   0x002u
+#define THREAD_STACK_CANARY      0x54485244u /* "THRD", at the low end of every created stack */
+#define THREAD_FPU_ALIGNMENT     64u
+#define THREAD_STACK_ALIGNMENT   16u
+
+#define THREAD_FLAG_PINNED   0x01u
+#define THREAD_FLAG_DETACHED 0x02u
+#define THREAD_FLAG_BOOT     0x04u
+#define THREAD_FLAG_EXITING  0x08u
+
+/** Why a blocked thread is blocked; a wakeup names the reason it answers. */
+typedef enum ThreadWaitReason {
+    THREAD_WAIT_NONE = 0u,
+    THREAD_WAIT_SLEEP = 1u,
+    THREAD_WAIT_RELEASE = 2u,
+    THREAD_WAIT_JOIN = 3u,
+} ThreadWaitReason_t;
+
+struct KernelThread {
+    InterruptFrame_t *frame; /* where it resumes; meaningful while not running */
+    KernelThread_t *next;    /* run queue link */
+    KernelThreadEntry_t entry;
+    void *argument;
+    const char *name;
+    uint32_t id;
+    volatile uint8_t state;  /* KernelThreadState_t */
+    uint8_t thread_class;    /* KernelThreadClass_t */
+    uint8_t priority;
+    uint8_t flags;           /* THREAD_FLAG_* */
+    uint8_t wait_reason;     /* ThreadWaitReason_t */
+    volatile uint32_t cpu;
+    uint8_t *stack;          /* pool slot; NULL for boot threads */
+    uint8_t *fpu_area;
+    KernelThread_t *joiner;
+
+    /* Deadline class, TSC cycles. */
+    uint64_t period;
+    uint64_t runtime;
+    uint64_t relative_deadline;
+    uint32_t density_ppm;
+    uint64_t job_release;
+    uint64_t job_deadline;
+    uint64_t job_cpu_start;
+
+    uint64_t cpu_cycles;
+    uint64_t ran_since;
+    uint64_t woken_at;
+    uint64_t max_wake_latency;
+    uint32_t switches;
+    uint32_t preemptions;
+    uint32_t migrations;
+    uint32_t jobs;
+    uint32_t deadline_misses;
+    uint32_t budget_overruns;
+
+    KernelTimer_t sleep_timer;
+    KernelTimer_t release_timer;
+    uint8_t fpu_storage[INTERRUPT_FPU_AREA_SIZE + THREAD_FPU_ALIGNMENT - 1u];
+};
+
+/**
+ * @struct ThreadRunQueue_t
+ * @brief One CPU's scheduler. Any CPU may make a thread ready on it, under the
+ *        lock; only its own CPU takes threads off it.
+ */
+typedef struct ThreadRunQueue {
+    KernelTicketLock_t lock;
+    KernelThread_t *current;
+    KernelThread_t *idle;
+
+    /* Fixed priorities: a FIFO per level, and a bit per non-empty level. */
+    KernelThread_t *fixed_head[KERNEL_THREAD_PRIORITY_LEVELS];
+    KernelThread_t *fixed_tail[KERNEL_THREAD_PRIORITY_LEVELS];
+    uint32_t ready_mask;
+
+    /* Deadline class: ready threads by absolute deadline, earliest first. */
+    KernelThread_t *deadline_head;
+    uint32_t deadline_density_ppm;
+
+    volatile uint32_t runnable; /* created threads ready or running here */
+    uint32_t preempt_disabled;  /* nesting of kernel_thread_preempt_disable() on this CPU */
+    volatile bool need_resched;
+    volatile bool balance_requested;
+    bool slice_expired;
+    bool started;
+    KernelThread_t *retired;    /* exited, switched away from in this pass */
+    uint64_t pass_started;
+    uint64_t last_balance;
+    KernelTimer_t slice_timer;
+    KernelThread_t boot;
+
+    uint32_t switches;
+    uint32_t preemptions;
+    uint32_t yields;
+    uint32_t wakeups;
+    uint32_t migrations;
+    uint32_t balance_pushes;
+    uint32_t balance_requests;
+    uint32_t reschedule_ipis;
+    uint32_t stack_overflows;
+    uint32_t deadline_jobs;
+    uint32_t deadline_misses;
+    uint32_t budget_overruns;
+    uint32_t switch_samples;
+    uint32_t switch_max_cycles;
+    uint64_t switch_cycles;
+    uint64_t max_wake_latency;
+    uint64_t busy_cycles;
+    uint64_t boot_cycles;
+    uint64_t idle_cycles;
+} ThreadRunQueue_t;
+
+static ThreadRunQueue_t thread_run_queues[CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC];
+static KernelPool_t thread_control_pool;
+static KernelPool_t thread_stack_pool;
+static KernelTicketLock_t thread_pool_lock;
+static bool thread_active = false;
+static uint32_t thread_boot_slot = 0u;
+static uint32_t thread_next_id = 1u;
+static uint32_t thread_alive = 0u;
+static uint32_t thread_deadline_alive = 0u;
+static uint32_t thread_created = 0u;
+static uint32_t thread_create_failures = 0u;
+static uint64_t thread_slice_cycles = 0u;
+static uint64_t thread_balance_cycles = 0u;
+
+static void thread_start(void);
+static void thread_idle_loop(void *argument);
+
+static inline uint32_t thread_save_and_disable_interrupts(void)
+{
+    uint32_t flags;
+
+    __asm__ volatile("pushfl\n\tpopl %0\n\tcli" : "=r"(flags)::"memory");
+    return flags;
+}
+
+static inline void thread_restore_interrupts(uint32_t flags)
+{
+    __asm__ volatile("pushl %0\n\tpopfl" ::"r"(flags) : "memory", "cc");
+}
+
+/* The one way a thread enters its own scheduler. `int` works with interrupts off,
+   which is how every caller closes the window between deciding to block and
+   being switched away. */
+static inline void thread_raise_yield(void) { __asm__ volatile("int %0" ::"i"(KERNEL_THREAD_YIELD_VECTOR) : "memory"); }
+
+static uint32_t thread_local_slot(void)
+{
+    const uint32_t slot = cpu_topology_get_logical_slot();
+
+    return slot < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC ? slot : 0u;
+}
+
+static bool thread_cpu_usable(uint32_t cpu)
+{
+    return cpu < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC && cpu_topology_is_logical_slot_online(cpu);
+}
+
+static bool thread_is_created(const KernelThread_t *thread)
+{
+    return (thread->flags & THREAD_FLAG_BOOT) == 0u && thread->thread_class != KERNEL_THREAD_CLASS_IDLE;
+}
+
+static void thread_bind_fpu_area(KernelThread_t *thread)
+{
+    const uintptr_t storage = (uintptr_t) thread->fpu_storage;
+
+    thread->fpu_area = (uint8_t *) ((storage + THREAD_FPU_ALIGNMENT - 1u) & ~(uintptr_t) (THREAD_FPU_ALIGNMENT - 1u));
+    interrupt_fpu_initialize_area(thread->fpu_area);
+}
+
+/* ── Run queue ───────────────────────────────────────────────────────────── */
+
+static void thread_queue_insert(ThreadRunQueue_t *queue, KernelThread_t *thread, bool at_head)
+{
+    thread->next = NULL;
+
+    if (thread->thread_class == KERNEL_THREAD_CLASS_DEADLINE)
+    {
+        KernelThread_t **link = &queue->deadline_head;
+
+        while (*link && (*link)->job_deadline <= thread->job_deadline)
+            link = &(*link)->next;
+        thread->next = *link;
+        *link = thread;
+        return;
+    }
+
+    const uint32_t level = thread->priority;
+    if (at_head)
+    {
+        thread->next = queue->fixed_head[level];
+        queue->fixed_head[level] = thread;
+        if (!queue->fixed_tail[level])
+            queue->fixed_tail[level] = thread;
+    }
+    else
+    {
+        if (queue->fixed_tail[level])
+            queue->fixed_tail[level]->next = thread;
+        else
+            queue->fixed_head[level] = thread;
+        queue->fixed_tail[level] = thread;
+    }
+    queue->ready_mask |= 1u << level;
+}
+
+/** @brief Take the thread that runs next: earliest deadline, else highest priority. */
+static KernelThread_t *thread_queue_pop(ThreadRunQueue_t *queue)
+{
+    KernelThread_t *thread = queue->deadline_head;
+
+    if (thread)
+    {
+        queue->deadline_head = thread->next;
+        thread->next = NULL;
+        return thread;
+    }
+
+    if (!queue->ready_mask)
+        return NULL;
+
+    const uint32_t level = 31u - (uint32_t) __builtin_clz(queue->ready_mask);
+    thread = queue->fixed_head[level];
+    queue->fixed_head[level] = thread->next;
+    if (!queue->fixed_head[level])
+    {
+        queue->fixed_tail[level] = NULL;
+        queue->ready_mask &= ~(1u << level);
+    }
+    thread->next = NULL;
+    return thread;
+}
+
+/** @brief Unlink a fixed-priority @p thread from its level; it must be queued there. */
+static void thread_queue_remove(ThreadRunQueue_t *queue, KernelThread_t *thread)
+{
+    const uint32_t level = thread->priority;
+    KernelThread_t *previous = NULL;
+
+    for (KernelThread_t *it = queue->fixed_head[level]; it; previous = it, it = it->next)
+    {
+        if (it != thread)
+            continue;
+
+        if (previous)
+            previous->next = it->next;
+        else
+            queue->fixed_head[level] = it->next;
+        if (queue->fixed_tail[level] == it)
+            queue->fixed_tail[level] = previous;
+        if (!queue->fixed_head[level])
+            queue->ready_mask &= ~(1u << level);
+        it->next = NULL;
+        return;
+    }
+}
+
+/** @brief true when @p candidate, made ready, should take the CPU from @p current. */
+static bool thread_preempts(const KernelThread_t *candidate, const KernelThread_t *current)
+{
+    if (!current || current->thread_class == KERNEL_THREAD_CLASS_IDLE)
+        return true;
+    if (candidate->thread_class == KERNEL_THREAD_CLASS_DEADLINE)
+        return current->thread_class != KERNEL_THREAD_CLASS_DEADLINE ||
+               candidate->job_deadline < current->job_deadline;
+    return current->thread_class == KERNEL_THREAD_CLASS_FIXED && candidate->priority > current->priority;
+}
+
+/**
+ * @brief Queue @p thread on @p queue, locked, as newly runnable there.
+ * @return true when the CPU should be told to reschedule.
+ */
+static bool thread_make_ready(ThreadRunQueue_t *queue, KernelThread_t *thread, uint64_t now)
+{
+    thread->state = KERNEL_THREAD_STATE_READY;
+    thread->wait_reason = THREAD_WAIT_NONE;
+    thread->woken_at = now;
+    thread_queue_insert(queue, thread, false);
+    if (thread_is_created(thread))
+        ++queue->runnable;
+
+    if (!queue->started || thread_preempts(thread, queue->current))
+    {
+        queue->need_resched = true;
+        return true;
+    }
+    return false;
+}
+
+/** @brief Get @p cpu to run its scheduler soon. */
+static void thread_kick(uint32_t cpu)
+{
+    if (cpu == thread_local_slot())
+    {
+        /* From an interrupt, its own exit runs the scheduler. From a thread, a
+           self-IPI does, as soon as interrupts are on. */
+        if (interrupt_fpu_get_depth() == 0u)
+            (void) advanced_pic_ipi_send_fixed(0u, (uint8_t) KERNEL_THREAD_RESCHEDULE_VECTOR,
+                                               ADVANCED_PIC_IPI_SHORT_SELF);
+        return;
+    }
+
+    __atomic_add_fetch(&thread_run_queues[thread_local_slot()].reschedule_ipis, 1u, __ATOMIC_RELAXED);
+    (void) advanced_pic_ipi_send_fixed((uint8_t) cpu_topology_get_apic_id_at_slot(cpu),
+                                       (uint8_t) KERNEL_THREAD_RESCHEDULE_VECTOR, ADVANCED_PIC_IPI_SHORT_NONE);
+}
+
+/** @brief Make a blocked @p thread ready, if it is blocked for @p reason. */
+static void thread_wake(KernelThread_t *thread, ThreadWaitReason_t reason)
+{
+    for (;;)
+    {
+        const uint32_t cpu = thread->cpu;
+        ThreadRunQueue_t *queue = &thread_run_queues[cpu];
+        const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&queue->lock);
+
+        /* A blocked thread does not move, but the read above may predate the
+           block: check it is still this queue's. */
+        if (thread->cpu != cpu)
+        {
+            kernel_ticket_lock_release_irqrestore(&queue->lock, flags);
+            continue;
+        }
+
+        bool kick = false;
+        if (thread->state == KERNEL_THREAD_STATE_BLOCKED && thread->wait_reason == (uint8_t) reason)
+        {
+            ++queue->wakeups;
+            kick = thread_make_ready(queue, thread, asmutils_read_timestamp_counter());
+        }
+        kernel_ticket_lock_release_irqrestore(&queue->lock, flags);
+
+        if (kick)
+            thread_kick(cpu);
+        return;
+    }
+}
+
+/**
+ * @brief Mark the calling thread blocked for @p reason and switch away.
+ *
+ * Interrupts must be off: whatever will wake the thread is armed before the
+ * call, and must not find it still running.
+ */
+static void thread_block_current(KernelThread_t *self, ThreadWaitReason_t reason)
+{
+    ThreadRunQueue_t *queue = &thread_run_queues[self->cpu];
+
+    kernel_ticket_lock_acquire(&queue->lock);
+    self->state = KERNEL_THREAD_STATE_BLOCKED;
+    self->wait_reason = (uint8_t) reason;
+    kernel_ticket_lock_release(&queue->lock);
+
+    thread_raise_yield();
+}
+
+/* ── Timers ──────────────────────────────────────────────────────────────── */
+
+static void thread_sleep_due(KernelTimer_t *timer, void *context)
+{
+    (void) timer;
+    thread_wake((KernelThread_t *) context, THREAD_WAIT_SLEEP);
+}
+
+static void thread_release_due(KernelTimer_t *timer, void *context)
+{
+    (void) timer;
+    thread_wake((KernelThread_t *) context, THREAD_WAIT_RELEASE);
+}
+
+static void thread_slice_expired(KernelTimer_t *timer, void *context)
+{
+    ThreadRunQueue_t *queue = (ThreadRunQueue_t *) context;
+
+    (void) timer;
+    queue->slice_expired = true;
+    queue->need_resched = true;
+}
+
+/** @brief A slice while @p next shares its level with a ready thread, none otherwise. */
+static void thread_update_slice(ThreadRunQueue_t *queue, const KernelThread_t *next, bool switched, uint64_t now)
+{
+    const bool shared = next->thread_class == KERNEL_THREAD_CLASS_FIXED &&
+                        (queue->ready_mask & (1u << next->priority)) != 0u;
+
+    if (!shared)
+    {
+        if (kernel_timer_is_pending(&queue->slice_timer))
+            (void) kernel_timer_cancel(&queue->slice_timer);
+        return;
+    }
+    if (switched || !kernel_timer_is_pending(&queue->slice_timer))
+        (void) kernel_timer_arm(&queue->slice_timer, now + thread_slice_cycles, 0u);
+}
+
+/* ── Control blocks and stacks ───────────────────────────────────────────── */
+
+static void thread_setup_control(KernelThread_t *thread, const char *name, KernelThreadEntry_t entry, void *argument)
+{
+    memset(thread, 0, sizeof(*thread));
+    thread->name = name;
+    thread->entry = entry;
+    thread->argument = argument;
+    thread->state = KERNEL_THREAD_STATE_READY;
+    thread_bind_fpu_area(thread);
+    kernel_timer_setup(&thread->sleep_timer, "thread_sleep", thread_sleep_due, thread, KERNEL_TIMER_FLAG_PRECISE);
+    kernel_timer_setup(&thread->release_timer, "thread_release", thread_release_due, thread,
+                       KERNEL_TIMER_FLAG_PRECISE);
+}
+
+/**
+ * @brief Lay out a first frame at the top of the stack, as if thread_start() had
+ *        been interrupted on its first instruction.
+ *
+ * A ring-0 `iret` pops no stack pointer, so the thread starts with its stack
+ * right above the frame, where a zero stands for thread_start()'s return address.
+ */
+static void thread_prepare_stack(KernelThread_t *thread)
+{
+    const uintptr_t top = ((uintptr_t) thread->stack + KERNEL_THREAD_STACK_BYTES) &
+                          ~(uintptr_t) (THREAD_STACK_ALIGNMENT - 1u);
+    uint32_t *words = (uint32_t *) top;
+
+    *--words = 0u;
+
+    InterruptFrame_t *frame = (InterruptFrame_t *) words - 1;
+    memset(frame, 0, sizeof(*frame));
+    frame->ds = GDT_KERNEL_DATA_SELECTOR;
+    frame->eip = (uint32_t) (uintptr_t) thread_start;
+    frame->cs = GDT_KERNEL_CODE_SELECTOR;
+    frame->eflags = THREAD_EFLAGS_INTERRUPTS | THREAD_EFLAGS_RESERVED;
+
+    /* isr_common_stub keeps the FPU context word just below the frame; the
+       switch fills it in with the resuming CPU's. */
+    ((uint32_t *) frame)[-1] = 0u;
+    thread->frame = frame;
+    *(uint32_t *) thread->stack = THREAD_STACK_CANARY;
+}
+
+static KernelThread_t *thread_allocate(const char *name, KernelThreadEntry_t entry, void *argument)
+{
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&thread_pool_lock);
+    KernelThread_t *thread = (KernelThread_t *) kernel_pool_allocate(&thread_control_pool);
+    uint8_t *stack = (uint8_t *) kernel_pool_allocate(&thread_stack_pool);
+
+    if (!thread || !stack)
+    {
+        if (thread)
+            (void) kernel_pool_release(&thread_control_pool, thread);
+        if (stack)
+            (void) kernel_pool_release(&thread_stack_pool, stack);
+        ++thread_create_failures;
+        kernel_ticket_lock_release_irqrestore(&thread_pool_lock, flags);
+        return NULL;
+    }
+    const uint32_t id = thread_next_id++;
+    kernel_ticket_lock_release_irqrestore(&thread_pool_lock, flags);
+
+    thread_setup_control(thread, name, entry, argument);
+    thread->id = id;
+    thread->stack = stack;
+    thread_prepare_stack(thread);
+    return thread;
+}
+
+static void thread_free(KernelThread_t *thread)
+{
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&thread_pool_lock);
+
+    if (thread->thread_class == KERNEL_THREAD_CLASS_DEADLINE)
+        --thread_deadline_alive;
+    --thread_alive;
+    (void) kernel_pool_release(&thread_stack_pool, thread->stack);
+    (void) kernel_pool_release(&thread_control_pool, thread);
+    kernel_ticket_lock_release_irqrestore(&thread_pool_lock, flags);
+}
+
+/** @brief Queue a freshly created @p thread on @p cpu. */
+static void thread_enqueue_new(KernelThread_t *thread, uint32_t cpu)
+{
+    ThreadRunQueue_t *queue = &thread_run_queues[cpu];
+
+    thread->cpu = cpu;
+
+    uint32_t flags = kernel_ticket_lock_acquire_irqsave(&thread_pool_lock);
+    ++thread_alive;
+    ++thread_created;
+    if (thread->thread_class == KERNEL_THREAD_CLASS_DEADLINE)
+        ++thread_deadline_alive;
+    kernel_ticket_lock_release_irqrestore(&thread_pool_lock, flags);
+
+    flags = kernel_ticket_lock_acquire_irqsave(&queue->lock);
+    const bool kick = thread_make_ready(queue, thread, asmutils_read_timestamp_counter());
+    kernel_ticket_lock_release_irqrestore(&queue->lock, flags);
+
+    if (kick)
+        thread_kick(cpu);
+}
+
+/**
+ * @brief Least loaded online CPU. The scan starts after the caller's, so ties
+ *        go elsewhere first.
+ */
+static uint32_t thread_least_loaded_cpu(void)
+{
+    const uint32_t self = thread_local_slot();
+    uint32_t best = self;
+    uint32_t best_load = thread_run_queues[self].runnable;
+
+    for (uint32_t step = 1u; step < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++step)
+    {
+        const uint32_t cpu = (self + step) % CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC;
+
+        if (!thread_cpu_usable(cpu))
+            continue;
+        if (thread_run_queues[cpu].runnable < best_load ||
+            (thread_run_queues[cpu].runnable == best_load && best == self))
+        {
+            best = cpu;
+            best_load = thread_run_queues[cpu].runnable;
+        }
+    }
+    return best;
+}
+
+/* ── Adoption ────────────────────────────────────────────────────────────── */
+
+/**
+ * @brief Make whatever runs on this CPU its boot thread and give the CPU an
+ *        idle thread. On its own CPU, in the context being adopted or in an
+ *        interrupt taken from it.
+ */
+static void thread_adopt(ThreadRunQueue_t *queue, uint32_t slot)
+{
+    KernelThread_t *boot = &queue->boot;
+    const bool bsp = slot == thread_boot_slot;
+
+    thread_setup_control(boot, bsp ? "boot" : "ap_worker", NULL, NULL);
+    boot->flags = THREAD_FLAG_BOOT | THREAD_FLAG_PINNED;
+    boot->thread_class = KERNEL_THREAD_CLASS_FIXED;
+    boot->priority = (uint8_t) (bsp ? KERNEL_THREAD_PRIORITY_DEFAULT : KERNEL_THREAD_PRIORITY_BACKGROUND);
+    boot->cpu = slot;
+    boot->state = KERNEL_THREAD_STATE_RUNNING;
+    boot->ran_since = asmutils_read_timestamp_counter();
+
+    KernelThread_t *idle = thread_allocate("idle", thread_idle_loop, NULL);
+    if (idle)
+    {
+        idle->thread_class = KERNEL_THREAD_CLASS_IDLE;
+        idle->priority = KERNEL_THREAD_PRIORITY_IDLE;
+        idle->flags = THREAD_FLAG_PINNED;
+        idle->cpu = slot;
+    }
+
+    kernel_timer_setup(&queue->slice_timer, "thread_slice", thread_slice_expired, queue, 0u);
+    kernel_ticket_lock_acquire(&queue->lock);
+    queue->idle = idle;
+    queue->current = boot;
+    queue->last_balance = boot->ran_since;
+    queue->started = true;
+    kernel_ticket_lock_release(&queue->lock);
+}
+
+/* ── Balancing ───────────────────────────────────────────────────────────── */
+
+/** @brief A ready fixed-priority thread that may move, lowest priority first. */
+static KernelThread_t *thread_pick_migratable(ThreadRunQueue_t *queue, const KernelThread_t *exclude)
+{
+    for (uint32_t level = 1u; level < KERNEL_THREAD_PRIORITY_LEVELS; ++level)
+    {
+        if ((queue->ready_mask & (1u << level)) == 0u)
+            continue;
+        for (KernelThread_t *it = queue->fixed_head[level]; it; it = it->next)
+            if (it != exclude && (it->flags & THREAD_FLAG_PINNED) == 0u)
+                return it;
+    }
+    return NULL;
+}
+
+/** @brief Move a ready thread from the calling CPU to @p target and ring it. */
+static void thread_push(KernelThread_t *thread, uint32_t target)
+{
+    ThreadRunQueue_t *queue = &thread_run_queues[target];
+
+    thread->cpu = target;
+    ++thread->migrations;
+
+    kernel_ticket_lock_acquire(&queue->lock);
+    const bool kick = thread_make_ready(queue, thread, asmutils_read_timestamp_counter());
+    kernel_ticket_lock_release(&queue->lock);
+
+    if (kick)
+        thread_kick(target);
+}
+
+/**
+ * @brief The balancing half of a pass, with @p queue locked.
+ *
+ * A CPU with two or more runnable threads over the least loaded one pushes its
+ * lowest-priority migratable thread there. A CPU left with nothing of its own to
+ * run asks the busiest one to do that. Either is at most once per interval,
+ * unless another CPU asked.
+ *
+ * @return A thread taken off @p queue, to hand to thread_push() once unlocked.
+ */
+static KernelThread_t *thread_balance(ThreadRunQueue_t *queue, uint32_t slot, const KernelThread_t *previous,
+                                      uint64_t now, uint32_t *target, uint32_t *requestee)
+{
+    const bool requested = queue->balance_requested;
+
+    queue->balance_requested = false;
+    *requestee = CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC;
+    if (!requested && now - queue->last_balance < thread_balance_cycles)
+        return NULL;
+    queue->last_balance = now;
+
+    uint32_t lightest = slot;
+    uint32_t busiest = slot;
+    for (uint32_t cpu = 0u; cpu < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++cpu)
+    {
+        if (cpu == slot || !thread_cpu_usable(cpu))
+            continue;
+        if (thread_run_queues[cpu].runnable < thread_run_queues[lightest].runnable)
+            lightest = cpu;
+        if (thread_run_queues[cpu].runnable > thread_run_queues[busiest].runnable)
+            busiest = cpu;
+    }
+
+    if (queue->runnable == 0u)
+    {
+        /* Nothing of our own: someone with two or more to spare is asked. */
+        if (busiest != slot && thread_run_queues[busiest].runnable >= 2u)
+        {
+            thread_run_queues[busiest].balance_requested = true;
+            ++queue->balance_requests;
+            *requestee = busiest;
+        }
+        return NULL;
+    }
+
+    if (lightest == slot || queue->runnable < thread_run_queues[lightest].runnable + 2u)
+        return NULL;
+
+    KernelThread_t *thread = thread_pick_migratable(queue, previous);
+    if (!thread)
+        return NULL;
+
+    thread_queue_remove(queue, thread);
+    --queue->runnable;
+    ++queue->migrations;
+    ++queue->balance_pushes;
+    *target = lightest;
+    return thread;
+}
+
+/* ── The switch ──────────────────────────────────────────────────────────── */
+
+static void thread_account(ThreadRunQueue_t *queue, KernelThread_t *thread, uint64_t now)
+{
+    const uint64_t ran = now - thread->ran_since;
+
+    thread->cpu_cycles += ran;
+    if (thread->thread_class == KERNEL_THREAD_CLASS_IDLE)
+        queue->idle_cycles += ran;
+    else if ((thread->flags & THREAD_FLAG_BOOT) != 0u)
+        queue->boot_cycles += ran;
+    else
+        queue->busy_cycles += ran;
+}
+
+/** @brief Choose what runs next on this CPU; @return the frame it resumes through. */
+static InterruptFrame_t *thread_schedule(ThreadRunQueue_t *queue, uint32_t slot, InterruptFrame_t *frame,
+                                         bool yielded)
+{
+    const uint64_t now = asmutils_read_timestamp_counter();
+    uint32_t target = 0u;
+    uint32_t requestee = CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC;
+
+    kernel_ticket_lock_acquire(&queue->lock);
+
+    KernelThread_t *previous = queue->current;
+    previous->frame = frame;
+    thread_account(queue, previous, now);
+
+    queue->need_resched = false;
+    if (yielded)
+        ++queue->yields;
+
+    if (previous->state == KERNEL_THREAD_STATE_RUNNING)
+    {
+        /* Still runnable. Preempted, it keeps its place at the head of its level;
+           at the end of a slice or on a yield it goes to the back. */
+        if (previous != queue->idle)
+        {
+            previous->state = KERNEL_THREAD_STATE_READY;
+            thread_queue_insert(queue, previous, !yielded && !queue->slice_expired);
+        }
+    }
+    else if (previous->state == KERNEL_THREAD_STATE_BLOCKED)
+    {
+        if (thread_is_created(previous))
+            --queue->runnable;
+        if ((previous->flags & THREAD_FLAG_EXITING) != 0u)
+            queue->retired = previous;
+    }
+    else if (thread_is_created(previous))
+    {
+        /* READY: woken between blocking and getting here. Already queued, and
+           counted by the wakeup on top of the count it ran under. */
+        --queue->runnable;
+    }
+    queue->slice_expired = false;
+
+    KernelThread_t *next = thread_queue_pop(queue);
+    if (!next)
+        next = queue->idle ? queue->idle : previous;
+
+    next->state = KERNEL_THREAD_STATE_RUNNING;
+    next->ran_since = now;
+    queue->current = next;
+
+    const bool switched = next != previous;
+    if (switched)
+    {
+        ++queue->switches;
+        ++next->switches;
+        if (previous->state == KERNEL_THREAD_STATE_READY && !yielded)
+        {
+            ++queue->preemptions;
+            ++previous->preemptions;
+        }
+        if (previous->stack && *(const uint32_t *) previous->stack != THREAD_STACK_CANARY)
+            ++queue->stack_overflows;
+
+        (void) interrupt_fpu_switch_state(previous->fpu_area, next->fpu_area);
+        ((uint32_t *) next->frame)[-1] = ((const uint32_t *) frame)[-1];
+        queue->pass_started = now;
+    }
+
+    if (next->woken_at)
+    {
+        const uint64_t latency = now - next->woken_at;
+        if (latency > next->max_wake_latency)
+            next->max_wake_latency = latency;
+        if (latency > queue->max_wake_latency)
+            queue->max_wake_latency = latency;
+        next->woken_at = 0u;
+    }
+
+    thread_update_slice(queue, next, switched, now);
+    KernelThread_t *pushed = thread_balance(queue, slot, previous, now, &target, &requestee);
+    kernel_ticket_lock_release(&queue->lock);
+
+    if (pushed)
+        thread_push(pushed, target);
+    if (requestee < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC)
+        thread_kick(requestee);
+    return next->frame;
+}
+
+InterruptFrame_t *kernel_thread_interrupt_exit(InterruptFrame_t *frame)
+{
+    if (!thread_active || cpu_topology_is_forced())
+        return frame;
+
+    const uint32_t slot = thread_local_slot();
+    ThreadRunQueue_t *queue = &thread_run_queues[slot];
+    const bool yielded = frame->int_no == KERNEL_THREAD_YIELD_VECTOR;
+
+    if (queue->started && !yielded && !queue->need_resched && !queue->balance_requested)
+        return frame;
+
+    /* Only the outermost frame of a ring-0 context is a thread's: a nested one
+       belongs to the handler below it. A thread that did not yield is switched
+       only if it had interrupts on, which is what a thread holding an irqsave
+       lock does not have. */
+    if (interrupt_fpu_get_depth() != 1u || (frame->cs & 3u) != 0u)
+        return frame;
+    if (!yielded && (frame->eflags & THREAD_EFLAGS_INTERRUPTS) == 0u)
+        return frame;
+
+    /* Held off by the running thread: need_resched stays up, and the enable that
+       brings the count back to zero asks again. */
+    if (!yielded && queue->preempt_disabled != 0u)
+        return frame;
+
+    if (!queue->started)
+    {
+        if (!thread_cpu_usable(slot))
+            return frame;
+        thread_adopt(queue, slot);
+    }
+
+    return thread_schedule(queue, slot, frame, yielded);
+}
+
+void kernel_thread_switch_complete(void)
+{
+    ThreadRunQueue_t *queue = &thread_run_queues[thread_local_slot()];
+    const uint64_t cycles = asmutils_read_timestamp_counter() - queue->pass_started;
+    const uint32_t clamped = cycles > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t) cycles;
+
+    queue->switch_cycles += clamped;
+    ++queue->switch_samples;
+    if (clamped > queue->switch_max_cycles)
+        queue->switch_max_cycles = clamped;
+
+    KernelThread_t *retired = queue->retired;
+    if (!retired)
+        return;
+    queue->retired = NULL;
+
+    /* Its stack is no longer under anyone: it can be joined, or let go. */
+    kernel_ticket_lock_acquire(&thread_pool_lock);
+    const bool detached = (retired->flags & THREAD_FLAG_DETACHED) != 0u;
+    KernelThread_t *joiner = retired->joiner;
+    retired->state = KERNEL_THREAD_STATE_EXITED;
+    kernel_ticket_lock_release(&thread_pool_lock);
+
+    if (detached)
+        thread_free(retired);
+    else if (joiner)
+        thread_wake(joiner, THREAD_WAIT_JOIN);
+}
+
+/* ── Handlers and thread bodies ──────────────────────────────────────────── */
+
+static void thread_reschedule_handler(const InterruptFrame_t *frame)
+{
+    /* The sender already set what there is to do; the exit does it. */
+    (void) frame;
+    apic_send_eoi();
+}
+
+static void thread_yield_handler(const InterruptFrame_t *frame)
+{
+    /* A software interrupt: nothing to acknowledge, and the exit switches. */
+    (void) frame;
+}
+
+static void thread_idle_loop(void *argument)
+{
+    (void) argument;
+
+    for (;;)
+        processor_sleep_until_interrupt();
+}
+
+static void thread_start(void)
+{
+    KernelThread_t *self = kernel_thread_current();
+
+    if (self->thread_class == KERNEL_THREAD_CLASS_DEADLINE)
+    {
+        /* The first job is released now, on the CPU the thread is pinned to, so
+           its release timer fires there too. */
+        const uint64_t now = asmutils_read_timestamp_counter();
+
+        self->job_release = now;
+        self->job_deadline = now + self->relative_deadline;
+        self->job_cpu_start = self->cpu_cycles;
+        (void) kernel_timer_arm(&self->release_timer, now + self->period, self->period);
+    }
+
+    self->entry(self->argument);
+    kernel_thread_exit();
+}
+
+/* ── Interface ───────────────────────────────────────────────────────────── */
+
+bool kernel_thread_initialize(void)
+{
+    if (thread_active)
+        return true;
+    if (!kernel_timer_is_active() || !advanced_pic_ipi_is_ready())
+        return false;
+
+    /* One idle thread per CPU online now comes out of the same pools. */
+    const uint32_t capacity = KERNEL_THREAD_CAPACITY + cpu_topology_get_online_cpu_count();
+    if (!kernel_pool_init(&thread_control_pool, "kthread", (uint32_t) sizeof(KernelThread_t), capacity))
+        return false;
+    if (!kernel_pool_init(&thread_stack_pool, "kthread_stack", KERNEL_THREAD_STACK_BYTES, capacity))
+    {
+        kernel_pool_destroy(&thread_control_pool);
+        return false;
+    }
+
+    thread_slice_cycles = kernel_timer_microseconds_to_cycles(KERNEL_THREAD_TIME_SLICE_MICROSECONDS);
+    thread_balance_cycles = kernel_timer_microseconds_to_cycles(KERNEL_THREAD_BALANCE_INTERVAL_MICROSECONDS);
+
+    for (uint32_t cpu = 0u; cpu < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++cpu)
+        kernel_ticket_lock_initialize(&thread_run_queues[cpu].lock, NULL);
+    kernel_ticket_lock_initialize(&thread_pool_lock, NULL);
+
+    interrupt_service_routine_register_handler(KERNEL_THREAD_RESCHEDULE_VECTOR, thread_reschedule_handler);
+    interrupt_service_routine_register_handler(KERNEL_THREAD_YIELD_VECTOR, thread_yield_handler);
+
+    const uint32_t flags = thread_save_and_disable_interrupts();
+    thread_boot_slot = thread_local_slot();
+    thread_adopt(&thread_run_queues[thread_boot_slot], thread_boot_slot);
+    thread_active = true;
+    thread_restore_interrupts(flags);
+    return true;
+}
+
+bool kernel_thread_is_active(void) { return thread_active; }
+
+KernelThread_t *kernel_thread_create(const char *name, KernelThreadEntry_t entry, void *argument, uint32_t priority,
+                                     uint32_t cpu)
+{
+    if (!thread_active || !entry || priority < KERNEL_THREAD_PRIORITY_BACKGROUND ||
+        priority > KERNEL_THREAD_PRIORITY_HIGHEST)
+        return NULL;
+    if (cpu != KERNEL_THREAD_CPU_ANY && !thread_cpu_usable(cpu))
+        return NULL;
+
+    KernelThread_t *thread = thread_allocate(name, entry, argument);
+    if (!thread)
+        return NULL;
+
+    thread->thread_class = KERNEL_THREAD_CLASS_FIXED;
+    thread->priority = (uint8_t) priority;
+    if (cpu != KERNEL_THREAD_CPU_ANY)
+        thread->flags |= THREAD_FLAG_PINNED;
+
+    thread_enqueue_new(thread, cpu == KERNEL_THREAD_CPU_ANY ? thread_least_loaded_cpu() : cpu);
+    return thread;
+}
+
+/** @brief Reserve @p density_ppm on @p cpu if it still fits. */
+static bool thread_admit(uint32_t cpu, uint32_t density_ppm)
+{
+    ThreadRunQueue_t *queue = &thread_run_queues[cpu];
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&queue->lock);
+    const bool fits = queue->deadline_density_ppm + density_ppm <= KERNEL_THREAD_DEADLINE_DENSITY_PPM;
+
+    if (fits)
+        queue->deadline_density_ppm += density_ppm;
+    kernel_ticket_lock_release_irqrestore(&queue->lock, flags);
+    return fits;
+}
+
+static void thread_unadmit(uint32_t cpu, uint32_t density_ppm)
+{
+    ThreadRunQueue_t *queue = &thread_run_queues[cpu];
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&queue->lock);
+
+    queue->deadline_density_ppm -= density_ppm;
+    kernel_ticket_lock_release_irqrestore(&queue->lock, flags);
+}
+
+KernelThread_t *kernel_thread_create_deadline(const char *name, KernelThreadEntry_t entry, void *argument,
+                                              uint32_t period_us, uint32_t runtime_us, uint32_t deadline_us,
+                                              uint32_t cpu)
+{
+    if (deadline_us == 0u)
+        deadline_us = period_us;
+    if (!thread_active || !entry || period_us == 0u || runtime_us == 0u || runtime_us > deadline_us ||
+        deadline_us > period_us)
+        return NULL;
+    if (cpu != KERNEL_THREAD_CPU_ANY && !thread_cpu_usable(cpu))
+        return NULL;
+
+    const uint32_t density_ppm = (uint32_t) (((uint64_t) runtime_us * 1000000u) / deadline_us);
+    uint32_t chosen = cpu;
+
+    if (cpu == KERNEL_THREAD_CPU_ANY)
+    {
+        /* Least dense CPU that takes it: deadline threads never move once placed. */
+        chosen = CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC;
+        for (uint32_t candidate = 0u; candidate < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++candidate)
+        {
+            if (!thread_cpu_usable(candidate))
+                continue;
+            if (chosen == CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC ||
+                thread_run_queues[candidate].deadline_density_ppm < thread_run_queues[chosen].deadline_density_ppm)
+                chosen = candidate;
+        }
+        if (chosen == CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC)
+            return NULL;
+    }
+
+    if (!thread_admit(chosen, density_ppm))
+    {
+        __atomic_add_fetch(&thread_create_failures, 1u, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    KernelThread_t *thread = thread_allocate(name, entry, argument);
+    if (!thread)
+    {
+        thread_unadmit(chosen, density_ppm);
+        return NULL;
+    }
+
+    const uint64_t now = asmutils_read_timestamp_counter();
+    thread->thread_class = KERNEL_THREAD_CLASS_DEADLINE;
+    thread->priority = KERNEL_THREAD_PRIORITY_HIGHEST;
+    thread->flags |= THREAD_FLAG_PINNED;
+    thread->period = kernel_timer_microseconds_to_cycles(period_us);
+    thread->runtime = kernel_timer_microseconds_to_cycles(runtime_us);
+    thread->relative_deadline = kernel_timer_microseconds_to_cycles(deadline_us);
+    thread->density_ppm = density_ppm;
+    thread->job_deadline = now + thread->relative_deadline;
+
+    thread_enqueue_new(thread, chosen);
+    return thread;
+}
+
+KernelThread_t *kernel_thread_current(void)
+{
+    if (!thread_active)
+        return NULL;
+
+    /* With interrupts off, so the thread cannot move between the two reads. */
+    const uint32_t flags = thread_save_and_disable_interrupts();
+    KernelThread_t *current = thread_run_queues[thread_local_slot()].current;
+    thread_restore_interrupts(flags);
+    return current;
+}
+
+void kernel_thread_yield(void)
+{
+    if (thread_active)
+        thread_raise_yield();
+}
+
+void kernel_thread_preempt_disable(void)
+{
+    /* With interrupts off, so the count lands on the CPU the thread stays on. */
+    const uint32_t flags = thread_save_and_disable_interrupts();
+    ++thread_run_queues[thread_local_slot()].preempt_disabled;
+    thread_restore_interrupts(flags);
+}
+
+void kernel_thread_preempt_enable(void)
+{
+    const uint32_t flags = thread_save_and_disable_interrupts();
+    const uint32_t slot = thread_local_slot();
+    ThreadRunQueue_t *queue = &thread_run_queues[slot];
+
+    if (queue->preempt_disabled != 0u && --queue->preempt_disabled == 0u && thread_active &&
+        (queue->need_resched || queue->balance_requested))
+        thread_kick(slot);
+    thread_restore_interrupts(flags);
+}
+
+void kernel_thread_sleep_microseconds(uint32_t microseconds)
+{
+    const uint32_t flags = thread_save_and_disable_interrupts();
+    KernelThread_t *self = thread_active ? thread_run_queues[thread_local_slot()].current : NULL;
+
+    if (!self || self->thread_class == KERNEL_THREAD_CLASS_IDLE)
+    {
+        /* No scheduler to block in: wait it out. */
+        thread_restore_interrupts(flags);
+        const uint64_t until = asmutils_read_timestamp_counter() + kernel_timer_microseconds_to_cycles(microseconds);
+        while (asmutils_read_timestamp_counter() < until)
+            __asm__ volatile("pause" ::: "memory");
+        return;
+    }
+
+    (void) kernel_timer_arm(&self->sleep_timer,
+                            asmutils_read_timestamp_counter() + kernel_timer_microseconds_to_cycles(microseconds), 0u);
+    thread_block_current(self, THREAD_WAIT_SLEEP);
+    thread_restore_interrupts(flags);
+}
+
+bool kernel_thread_wait_next_period(void)
+{
+    const uint32_t flags = thread_save_and_disable_interrupts();
+    KernelThread_t *self = thread_active ? thread_run_queues[thread_local_slot()].current : NULL;
+
+    if (!self || self->thread_class != KERNEL_THREAD_CLASS_DEADLINE)
+    {
+        thread_restore_interrupts(flags);
+        return true;
+    }
+
+    ThreadRunQueue_t *queue = &thread_run_queues[self->cpu];
+    uint64_t now = asmutils_read_timestamp_counter();
+    const bool met = now <= self->job_deadline;
+    const uint64_t used = self->cpu_cycles + (now - self->ran_since) - self->job_cpu_start;
+
+    ++self->jobs;
+    ++queue->deadline_jobs;
+    if (!met)
+    {
+        ++self->deadline_misses;
+        ++queue->deadline_misses;
+    }
+    if (used > self->runtime)
+    {
+        ++self->budget_overruns;
+        ++queue->budget_overruns;
+    }
+
+    /* Releases whose deadline went by while this job ran are lost jobs. */
+    self->job_release += self->period;
+    while (self->job_release + self->relative_deadline <= now)
+    {
+        self->job_release += self->period;
+        ++self->deadline_misses;
+        ++queue->deadline_misses;
+    }
+    self->job_deadline = self->job_release + self->relative_deadline;
+
+    if (self->job_release > now)
+        thread_block_current(self, THREAD_WAIT_RELEASE);
+
+    now = asmutils_read_timestamp_counter();
+    self->job_cpu_start = self->cpu_cycles + (now - self->ran_since);
+    thread_restore_interrupts(flags);
+    return met;
+}
+
+void kernel_thread_exit(void)
+{
+    KernelThread_t *self = kernel_thread_current();
+
+    if (self && thread_is_created(self))
+    {
+        if (self->thread_class == KERNEL_THREAD_CLASS_DEADLINE)
+        {
+            (void) kernel_timer_cancel(&self->release_timer);
+            thread_unadmit(self->cpu, self->density_ppm);
+        }
+
+        (void) thread_save_and_disable_interrupts();
+        self->flags |= THREAD_FLAG_EXITING;
+        thread_block_current(self, THREAD_WAIT_NONE);
+    }
+
+    /* Not a thread that can end: it stays, asleep. */
+    for (;;)
+        processor_sleep_until_interrupt();
+}
+
+bool kernel_thread_join(KernelThread_t *thread)
+{
+    if (!thread || !thread_is_created(thread) || (thread->flags & THREAD_FLAG_DETACHED) != 0u)
+        return false;
+
+    for (;;)
+    {
+        const uint32_t flags = thread_save_and_disable_interrupts();
+        KernelThread_t *self = thread_run_queues[thread_local_slot()].current;
+
+        kernel_ticket_lock_acquire(&thread_pool_lock);
+        if (thread->state == KERNEL_THREAD_STATE_EXITED)
+        {
+            kernel_ticket_lock_release(&thread_pool_lock);
+            thread_restore_interrupts(flags);
+            break;
+        }
+
+        /* Blocked before the pool lock drops: switch_complete, which wakes the
+           joiner under the same lock, cannot find it still running. */
+        thread->joiner = self;
+        ThreadRunQueue_t *queue = &thread_run_queues[self->cpu];
+        kernel_ticket_lock_acquire(&queue->lock);
+        self->state = KERNEL_THREAD_STATE_BLOCKED;
+        self->wait_reason = THREAD_WAIT_JOIN;
+        kernel_ticket_lock_release(&queue->lock);
+        kernel_ticket_lock_release(&thread_pool_lock);
+
+        thread_raise_yield();
+        thread_restore_interrupts(flags);
+    }
+
+    thread_free(thread);
+    return true;
+}
+
+void kernel_thread_detach(KernelThread_t *thread)
+{
+    if (!thread || !thread_is_created(thread))
+        return;
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&thread_pool_lock);
+    const bool exited = thread->state == KERNEL_THREAD_STATE_EXITED;
+
+    thread->flags |= THREAD_FLAG_DETACHED;
+    kernel_ticket_lock_release_irqrestore(&thread_pool_lock, flags);
+
+    if (exited)
+        thread_free(thread);
+}
+
+void kernel_thread_get_info(const KernelThread_t *thread, KernelThreadInfo_t *out)
+{
+    if (!out)
+        return;
+
+    *out = (KernelThreadInfo_t) {0};
+    if (!thread)
+        return;
+
+    out->name = thread->name;
+    out->id = thread->id;
+    out->cpu = thread->cpu;
+    out->state = (KernelThreadState_t) thread->state;
+    out->thread_class = (KernelThreadClass_t) thread->thread_class;
+    out->priority = thread->priority;
+    out->cpu_cycles = thread->cpu_cycles;
+    out->switches = thread->switches;
+    out->preemptions = thread->preemptions;
+    out->migrations = thread->migrations;
+    out->jobs = thread->jobs;
+    out->deadline_misses = thread->deadline_misses;
+    out->budget_overruns = thread->budget_overruns;
+    out->max_wake_latency_us = kernel_timer_cycles_to_microseconds(thread->max_wake_latency);
+}
+
+void kernel_thread_get_statistics(KernelThreadStatistics_t *out)
+{
+    if (!out)
+        return;
+
+    *out = (KernelThreadStatistics_t) {0};
+    out->active = thread_active;
+    out->threads = thread_alive;
+    out->created = thread_created;
+    out->create_failures = thread_create_failures;
+    out->deadline_threads = thread_deadline_alive;
+
+    uint64_t switch_cycles = 0u;
+    uint32_t switch_samples = 0u;
+    uint64_t max_wake_latency = 0u;
+
+    for (uint32_t cpu = 0u; cpu < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++cpu)
+    {
+        const ThreadRunQueue_t *queue = &thread_run_queues[cpu];
+
+        if (!queue->started)
+            continue;
+
+        ++out->cpus;
+        out->switches += queue->switches;
+        out->preemptions += queue->preemptions;
+        out->yields += queue->yields;
+        out->wakeups += queue->wakeups;
+        out->migrations += queue->migrations;
+        out->balance_pushes += queue->balance_pushes;
+        out->balance_requests += queue->balance_requests;
+        out->reschedule_ipis += queue->reschedule_ipis;
+        out->stack_overflows += queue->stack_overflows;
+        out->deadline_jobs += queue->deadline_jobs;
+        out->deadline_misses += queue->deadline_misses;
+        out->budget_overruns += queue->budget_overruns;
+        out->busy_cycles += queue->busy_cycles;
+        out->boot_cycles += queue->boot_cycles;
+        out->idle_cycles += queue->idle_cycles;
+        switch_cycles += queue->switch_cycles;
+        switch_samples += queue->switch_samples;
+        if (queue->switch_max_cycles > out->switch_max_cycles)
+            out->switch_max_cycles = queue->switch_max_cycles;
+        if (queue->max_wake_latency > max_wake_latency)
+            max_wake_latency = queue->max_wake_latency;
+    }
+
+    out->switch_average_cycles = switch_samples ? (uint32_t) (switch_cycles / switch_samples) : 0u;
+    out->max_wake_latency_us = kernel_timer_cycles_to_microseconds(max_wake_latency);
+}
+
+void kernel_thread_report(Serial_t *serial)
+{
+    KernelThreadStatistics_t statistics;
+
+    kernel_thread_get_statistics(&statistics);
+
+    kernel_telemetry_begin_record(serial, "sched");
+    kernel_telemetry_write_boolean("active", statistics.active);
+    kernel_telemetry_write_unsigned("cpus", statistics.cpus);
+    kernel_telemetry_write_unsigned("threads", statistics.threads);
+    kernel_telemetry_write_unsigned("created", statistics.created);
+    kernel_telemetry_write_unsigned("create_failures", statistics.create_failures);
+    kernel_telemetry_write_unsigned("switches", statistics.switches);
+    kernel_telemetry_write_unsigned("preemptions", statistics.preemptions);
+    kernel_telemetry_write_unsigned("yields", statistics.yields);
+    kernel_telemetry_write_unsigned("wakeups", statistics.wakeups);
+    kernel_telemetry_write_unsigned("migrations", statistics.migrations);
+    kernel_telemetry_write_unsigned("balance_pushes", statistics.balance_pushes);
+    kernel_telemetry_write_unsigned("balance_requests", statistics.balance_requests);
+    kernel_telemetry_write_unsigned("reschedule_ipis", statistics.reschedule_ipis);
+    kernel_telemetry_write_unsigned("switch_avg_cycles", statistics.switch_average_cycles);
+    kernel_telemetry_write_unsigned("switch_max_cycles", statistics.switch_max_cycles);
+    kernel_telemetry_write_unsigned("max_wake_latency_us", statistics.max_wake_latency_us);
+    kernel_telemetry_write_unsigned("deadline_threads", statistics.deadline_threads);
+    kernel_telemetry_write_unsigned("deadline_jobs", statistics.deadline_jobs);
+    kernel_telemetry_write_unsigned("deadline_misses", statistics.deadline_misses);
+    kernel_telemetry_write_unsigned("budget_overruns", statistics.budget_overruns);
+    kernel_telemetry_write_unsigned("stack_overflows", statistics.stack_overflows);
+    kernel_telemetry_end_record();
+
+    for (uint32_t cpu = 0u; cpu < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++cpu)
+    {
+        const ThreadRunQueue_t *queue = &thread_run_queues[cpu];
+
+        if (!queue->started)
+            continue;
+
+        const uint64_t total = queue->busy_cycles + queue->boot_cycles + queue->idle_cycles;
+
+        kernel_telemetry_begin_record(serial, "sched_cpu");
+        kernel_telemetry_write_unsigned("cpu", cpu);
+        kernel_telemetry_write_unsigned("runnable", queue->runnable);
+        kernel_telemetry_write_unsigned("switches", queue->switches);
+        kernel_telemetry_write_unsigned("migrations_out", queue->migrations);
+        kernel_telemetry_write_unsigned("deadline_density_ppm", queue->deadline_density_ppm);
+        kernel_telemetry_write_unsigned("busy_ms", kernel_timer_cycles_to_microseconds(queue->busy_cycles) / 1000u);
+        kernel_telemetry_write_unsigned("boot_ms", kernel_timer_cycles_to_microseconds(queue->boot_cycles) / 1000u);
+        kernel_telemetry_write_unsigned("idle_ms", kernel_timer_cycles_to_microseconds(queue->idle_cycles) / 1000u);
+        kernel_telemetry_write_unsigned("busy_permille",
+                                        total ? (uint32_t) ((queue->busy_cycles * 1000u) / total) : 0u);
+        kernel_telemetry_end_record();
+    }
+}
@@ -0,0 +1,743 @@
+/**
+ * @file timer.c
+ * @brief Per-CPU timing wheels and deadline heaps on the local timer.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#include <kernel/core/timer.h>
+
+#include <kernel/core/lock.h>
+#include <kernel/cpu/apic.h>
+#include <kernel/cpu/apic_timer.h>
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/cpu/irq.h>
+#include <kernel/cpu/isr.h>
+#include <kernel/cpu/pic.h>
+#include <kernel/diag/telemetry.h>
+#include <kernel/lib/asmutils.h>
+
+#define TIMER_SLOT_MASK    ((uint64_t) KERNEL_TIMER_WHEEL_SLOTS - 1u)
+#define TIMER_NO_DEADLINE  0xFFFFFFFFFFFFFFFFull
+#define TIMER_PIT_IRQ_LINE 0u
+
+/**
+ * @struct TimerQueue_t
+ * @brief One CPU's timers. Only its own CPU arms timers on it or expires them;
+ *        any CPU may cancel, hence the lock.
+ */
+typedef struct TimerQueue {
+    KernelTicketLock_t lock;
+
+    /* Wheel: slot heads, one occupancy word per level, and the last granule
+       processed. A timer at level l sits in slot (tick >> 6l) & 63. */
+    KernelTimer_t *wheel[KERNEL_TIMER_WHEEL_LEVELS][KERNEL_TIMER_WHEEL_SLOTS];
+    uint64_t occupied[KERNEL_TIMER_WHEEL_LEVELS];
+    uint64_t wheel_tick;
+    uint32_t wheel_count;
+
+    KernelTimer_t *heap[KERNEL_TIMER_HEAP_CAPACITY];
+    uint32_t heap_count;
+
+    uint64_t programmed; /* deadline the local timer holds; 0 for none */
+    bool hardware_ready;
+
+    uint32_t armed;
+    uint32_t cancelled;
+    uint32_t fired_wheel;
+    uint32_t fired_heap;
+    uint32_t cascaded;
+    uint32_t heap_overflows;
+    uint32_t overruns;
+    uint32_t interrupts;
+    uint32_t empty_interrupts;
+    uint32_t max_jitter_wheel_us;
+    uint32_t max_jitter_heap_us;
+    uint32_t jitter_wheel[KERNEL_TIMER_JITTER_BUCKETS];
+    uint32_t jitter_heap[KERNEL_TIMER_JITTER_BUCKETS];
+} TimerQueue_t;
+
+static TimerQueue_t timer_queues[CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC];
+static bool timer_active = false;
+static uint64_t timer_tsc_hz = 0u;
+static uint64_t timer_granule_cycles = 0u;
+
+static KernelTimer_t timer_system_tick;
+static bool timer_system_tick_running = false;
+
+static TimerQueue_t *timer_local_queue(void)
+{
+    uint32_t slot = cpu_topology_get_logical_slot();
+
+    return &timer_queues[slot < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC ? slot : 0u];
+}
+
+/* ── Heap ────────────────────────────────────────────────────────────────── */
+
+static void timer_heap_place(TimerQueue_t *queue, uint32_t index, KernelTimer_t *timer)
+{
+    queue->heap[index] = timer;
+    timer->slot = (uint16_t) index;
+}
+
+static void timer_heap_sift_up(TimerQueue_t *queue, uint32_t index)
+{
+    KernelTimer_t *timer = queue->heap[index];
+
+    while (index > 0u)
+    {
+        const uint32_t parent = (index - 1u) / 2u;
+        if (queue->heap[parent]->expires <= timer->expires)
+            break;
+        timer_heap_place(queue, index, queue->heap[parent]);
+        index = parent;
+    }
+    timer_heap_place(queue, index, timer);
+}
+
+static void timer_heap_sift_down(TimerQueue_t *queue, uint32_t index)
+{
+    KernelTimer_t *timer = queue->heap[index];
+
+    for (;;)
+    {
+        uint32_t child = index * 2u + 1u;
+        if (child >= queue->heap_count)
+            break;
+        if (child + 1u < queue->heap_count && queue->heap[child + 1u]->expires < queue->heap[child]->expires)
+            ++child;
+        if (timer->expires <= queue->heap[child]->expires)
+            break;
+        timer_heap_place(queue, index, queue->heap[child]);
+        index = child;
+    }
+    timer_heap_place(queue, index, timer);
+}
+
+static void timer_heap_push(TimerQueue_t *queue, KernelTimer_t *timer)
+{
+    timer_heap_place(queue, queue->heap_count++, timer);
+    timer_heap_sift_up(queue, timer->slot);
+}
+
+static void timer_heap_remove(TimerQueue_t *queue, KernelTimer_t *timer)
+{
+    const uint32_t index = timer->slot;
+    KernelTimer_t *last = queue->heap[--queue->heap_count];
+
+    if (last == timer)
+        return;
+
+    /* The last entry takes the hole and moves whichever way its deadline says. */
+    timer_heap_place(queue, index, last);
+    if (index > 0u && queue->heap[(index - 1u) / 2u]->expires > last->expires)
+        timer_heap_sift_up(queue, index);
+    else
+        timer_heap_sift_down(queue, index);
+}
+
+/* ── Wheel ───────────────────────────────────────────────────────────────── */
+
+static uint32_t timer_level_shift(uint32_t level) { return level * KERNEL_TIMER_WHEEL_SLOT_SHIFT; }
+
+/**
+ * @brief File @p timer by its granule, relative to @p now, the next granule the
+ *        wheel will process.
+ *
+ * The level is the lowest at which the timer's slot index is less than a full
+ * turn ahead of now's, so every slot is reached exactly once before it could be
+ * reused. Past the last level the timer waits in its furthest slot and is filed
+ * again when that slot cascades.
+ */
+static void timer_wheel_insert(TimerQueue_t *queue, KernelTimer_t *timer, uint64_t now)
+{
+    uint64_t tick = (timer->expires + timer_granule_cycles - 1u) / timer_granule_cycles;
+    uint32_t level = 0u;
+    uint64_t index;
+
+    if (tick < now)
+        tick = now;
+
+    for (;;)
+    {
+        index = tick >> timer_level_shift(level);
+        if (index - (now >> timer_level_shift(level)) < KERNEL_TIMER_WHEEL_SLOTS)
+            break;
+        if (level + 1u == KERNEL_TIMER_WHEEL_LEVELS)
+        {
+            index = (now >> timer_level_shift(level)) + TIMER_SLOT_MASK;
+            break;
+        }
+        ++level;
+    }
+
+    const uint32_t slot = (uint32_t) (index & TIMER_SLOT_MASK);
+    KernelTimer_t **head = &queue->wheel[level][slot];
+
+    timer->next = *head;
+    if (timer->next)
+        timer->next->link = &timer->next;
+    timer->link = head;
+    *head = timer;
+
+    timer->slot = (uint16_t) (level * KERNEL_TIMER_WHEEL_SLOTS + slot);
+    timer->state = KERNEL_TIMER_STATE_WHEEL;
+    queue->occupied[level] |= 1ull << slot;
+    ++queue->wheel_count;
+}
+
+static void timer_wheel_remove(TimerQueue_t *queue, KernelTimer_t *timer)
+{
+    const uint32_t level = timer->slot / KERNEL_TIMER_WHEEL_SLOTS;
+    const uint32_t slot = timer->slot % KERNEL_TIMER_WHEEL_SLOTS;
+
+    *timer->link = timer->next;
+    if (timer->next)
+        timer->next->link = timer->link;
+    if (!queue->wheel[level][slot])
+        queue->occupied[level] &= ~(1ull << slot);
+    --queue->wheel_count;
+}
+
+/** @brief Take a whole slot's list off the wheel. */
+static KernelTimer_t *timer_wheel_take_slot(TimerQueue_t *queue, uint32_t level, uint32_t slot)
+{
+    KernelTimer_t *list = queue->wheel[level][slot];
+
+    queue->wheel[level][slot] = NULL;
+    queue->occupied[level] &= ~(1ull << slot);
+    for (KernelTimer_t *timer = list; timer; timer = timer->next)
+        --queue->wheel_count;
+    return list;
+}
+
+/** @brief Distance from @p from to the first occupied slot at or after it, circularly; 64 when none. */
+static uint32_t timer_next_occupied(uint64_t occupied, uint32_t from)
+{
+    const uint64_t rotated = from ? (occupied >> from) | (occupied << (KERNEL_TIMER_WHEEL_SLOTS - from)) : occupied;
+    const uint32_t low = (uint32_t) rotated;
+    const uint32_t high = (uint32_t) (rotated >> 32);
+
+    if (low)
+        return (uint32_t) __builtin_ctz(low);
+    if (high)
+        return 32u + (uint32_t) __builtin_ctz(high);
+    return KERNEL_TIMER_WHEEL_SLOTS;
+}
+
+/**
+ * @brief The next granule at which the wheel has work: a level-0 slot to expire
+ *        or a higher slot to cascade. TIMER_NO_DEADLINE for an empty wheel.
+ */
+static uint64_t timer_wheel_next_tick(const TimerQueue_t *queue)
+{
+    const uint64_t now = queue->wheel_tick + 1u;
+    uint64_t best = TIMER_NO_DEADLINE;
+
+    if (queue->wheel_count == 0u)
+        return best;
+
+    for (uint32_t level = 0u; level < KERNEL_TIMER_WHEEL_LEVELS; ++level)
+    {
+        if (!queue->occupied[level])
+            continue;
+
+        const uint32_t shift = timer_level_shift(level);
+        const uint64_t index = now >> shift;
+        const uint32_t distance = timer_next_occupied(queue->occupied[level], (uint32_t) (index & TIMER_SLOT_MASK));
+        uint64_t tick = (index + distance) << shift;
+
+        /* Above level 0 a slot equal to now's own index, with now already past its
+           start, was filed a turn ahead. */
+        if (tick < now)
+            tick += (uint64_t) KERNEL_TIMER_WHEEL_SLOTS << shift;
+        if (tick < best)
+            best = tick;
+    }
+    return best;
+}
+
+/**
+ * @brief Process every granule up to @p target, cascading higher slots down and
+ *        appending due timers to @p expired. Empty granules are skipped, not walked.
+ */
+static void timer_wheel_advance(TimerQueue_t *queue, uint64_t target, KernelTimer_t ***expired)
+{
+    while (queue->wheel_tick < target)
+    {
+        const uint64_t tick = timer_wheel_next_tick(queue);
+        if (tick > target)
+        {
+            queue->wheel_tick = target;
+            return;
+        }
+
+        for (uint32_t level = KERNEL_TIMER_WHEEL_LEVELS - 1u; level > 0u; --level)
+        {
+            const uint32_t shift = timer_level_shift(level);
+            if ((tick & ((1ull << shift) - 1u)) != 0u)
+                continue;
+
+            KernelTimer_t *list = timer_wheel_take_slot(queue, level, (uint32_t) ((tick >> shift) & TIMER_SLOT_MASK));
+            while (list)
+            {
+                KernelTimer_t *timer = list;
+                list = timer->next;
+                timer_wheel_insert(queue, timer, tick);
+                ++queue->cascaded;
+            }
+        }
+
+        KernelTimer_t *due = timer_wheel_take_slot(queue, 0u, (uint32_t) (tick & TIMER_SLOT_MASK));
+        while (due)
+        {
+            KernelTimer_t *timer = due;
+            due = timer->next;
+            timer->state = KERNEL_TIMER_STATE_RUNNING;
+            timer->next = NULL;
+            **expired = timer;
+            *expired = &timer->next;
+        }
+        queue->wheel_tick = tick;
+    }
+}
+
+/* ── Queue ───────────────────────────────────────────────────────────────── */
+
+static void timer_enqueue(TimerQueue_t *queue, KernelTimer_t *timer, uint64_t now)
+{
+    const bool wants_heap = (timer->flags & KERNEL_TIMER_FLAG_PRECISE) || timer->expires < now + timer_granule_cycles;
+
+    if (wants_heap && queue->heap_count < KERNEL_TIMER_HEAP_CAPACITY)
+    {
+        timer->state = KERNEL_TIMER_STATE_HEAP;
+        timer_heap_push(queue, timer);
+        return;
+    }
+    if (wants_heap)
+        ++queue->heap_overflows;
+
+    /* An empty wheel has nothing to process between its last granule and now. */
+    if (queue->wheel_count == 0u)
+        queue->wheel_tick = now / timer_granule_cycles;
+    timer_wheel_insert(queue, timer, queue->wheel_tick + 1u);
+}
+
+/** @brief Off its queue, which the caller holds. */
+static void timer_dequeue(TimerQueue_t *queue, KernelTimer_t *timer)
+{
+    if (timer->state == KERNEL_TIMER_STATE_WHEEL)
+        timer_wheel_remove(queue, timer);
+    else if (timer->state == KERNEL_TIMER_STATE_HEAP)
+        timer_heap_remove(queue, timer);
+    timer->state = KERNEL_TIMER_STATE_IDLE;
+}
+
+/** @brief Program the local timer for the queue's earliest work. Caller holds the queue. */
+static void timer_program(TimerQueue_t *queue)
+{
+    uint64_t deadline = TIMER_NO_DEADLINE;
+
+    if (queue->heap_count)
+        deadline = queue->heap[0]->expires;
+
+    const uint64_t tick = timer_wheel_next_tick(queue);
+    if (tick != TIMER_NO_DEADLINE && tick * timer_granule_cycles < deadline)
+        deadline = tick * timer_granule_cycles;
+
+    if (deadline == TIMER_NO_DEADLINE)
+    {
+        if (queue->programmed)
+            advanced_pic_timer_backend_arm_deadline(0u);
+        queue->programmed = 0u;
+        return;
+    }
+
+    /* 0 means "disarmed" to the hardware; a deadline of 0 is long past anyway. */
+    if (deadline == 0u)
+        deadline = 1u;
+    if (deadline != queue->programmed)
+    {
+        advanced_pic_timer_backend_arm_deadline(deadline);
+        queue->programmed = deadline;
+    }
+}
+
+/* ── Expiry ──────────────────────────────────────────────────────────────── */
+
+static uint32_t timer_jitter_bucket(uint32_t microseconds)
+{
+    uint32_t bucket = 0u;
+
+    while (microseconds && bucket + 1u < KERNEL_TIMER_JITTER_BUCKETS)
+    {
+        microseconds >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+/** @brief Run one expired timer and, if it is periodic and still wanted, file it again. */
+static void timer_run(TimerQueue_t *queue, KernelTimer_t *timer, bool from_heap)
+{
+    const uint64_t started = asmutils_read_timestamp_counter();
+    const uint32_t jitter = kernel_timer_cycles_to_microseconds(started > timer->expires ? started - timer->expires
+                                                                                         : 0u);
+
+    if (from_heap)
+    {
+        ++queue->fired_heap;
+        ++queue->jitter_heap[timer_jitter_bucket(jitter)];
+        if (jitter > queue->max_jitter_heap_us)
+            queue->max_jitter_heap_us = jitter;
+    }
+    else
+    {
+        ++queue->fired_wheel;
+        ++queue->jitter_wheel[timer_jitter_bucket(jitter)];
+        if (jitter > queue->max_jitter_wheel_us)
+            queue->max_jitter_wheel_us = jitter;
+    }
+
+    ++timer->fired;
+    timer->callback(timer, timer->context);
+
+    kernel_ticket_lock_acquire(&queue->lock);
+    /* Anything but RUNNING means the callback, or another CPU, armed or cancelled
+       the timer in the meantime: that decision stands. */
+    if (timer->state == KERNEL_TIMER_STATE_RUNNING)
+    {
+        if (timer->period)
+        {
+            const uint64_t now = asmutils_read_timestamp_counter();
+
+            timer->expires += timer->period;
+            if (timer->expires <= now)
+            {
+                const uint64_t missed = (now - timer->expires) / timer->period + 1u;
+                timer->expires += missed * timer->period;
+                timer->overruns += (uint32_t) missed;
+                queue->overruns += (uint32_t) missed;
+            }
+            timer_enqueue(queue, timer, now);
+        }
+        else
+            timer->state = KERNEL_TIMER_STATE_IDLE;
+    }
+    kernel_ticket_lock_release(&queue->lock);
+}
+
+static void timer_interrupt_handler(const InterruptFrame_t *frame)
+{
+    TimerQueue_t *queue = timer_local_queue();
+    KernelTimer_t *heap_due = NULL;
+    KernelTimer_t *wheel_due = NULL;
+    KernelTimer_t **heap_tail = &heap_due;
+    KernelTimer_t **wheel_tail = &wheel_due;
+
+    (void) frame;
+
+    kernel_ticket_lock_acquire(&queue->lock);
+    ++queue->interrupts;
+    queue->programmed = 0u;
+
+    const uint64_t now = asmutils_read_timestamp_counter();
+    while (queue->heap_count && queue->heap[0]->expires <= now)
+    {
+        KernelTimer_t *timer = queue->heap[0];
+        timer_heap_remove(queue, timer);
+        timer->state = KERNEL_TIMER_STATE_RUNNING;
+        timer->next = NULL;
+        *heap_tail = timer;
+        heap_tail = &timer->next;
+    }
+    timer_wheel_advance(queue, now / timer_granule_cycles, &wheel_tail);
+
+    if (!heap_due && !wheel_due)
+        ++queue->empty_interrupts;
+    kernel_ticket_lock_release(&queue->lock);
+
+    /* Precise timers first: they are the ones whose lateness is measured in
+       microseconds. The queue is unlocked so callbacks may arm and cancel. */
+    while (heap_due)
+    {
+        KernelTimer_t *timer = heap_due;
+        heap_due = timer->next;
+        timer_run(queue, timer, true);
+    }
+    while (wheel_due)
+    {
+        KernelTimer_t *timer = wheel_due;
+        wheel_due = timer->next;
+        timer_run(queue, timer, false);
+    }
+
+    kernel_ticket_lock_acquire(&queue->lock);
+    timer_program(queue);
+    kernel_ticket_lock_release(&queue->lock);
+
+    apic_send_eoi();
+}
+
+/* ── Interface ───────────────────────────────────────────────────────────── */
+
+bool kernel_timer_initialize(void)
+{
+    if (timer_active)
+        return true;
+
+    timer_tsc_hz = advanced_pic_timer_backend_get_timestamp_counter_frequency_hz();
+    if (timer_tsc_hz == 0u || advanced_pic_timer_backend_get_calibrated_timer_frequency_hz() == 0u)
+        return false;
+
+    timer_granule_cycles = (timer_tsc_hz * KERNEL_TIMER_WHEEL_GRANULE_MICROSECONDS) / 1000000u;
+    if (timer_granule_cycles == 0u)
+        timer_granule_cycles = 1u;
+
+    for (uint32_t cpu = 0u; cpu < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++cpu)
+        kernel_ticket_lock_initialize(&timer_queues[cpu].lock, NULL);
+
+    interrupt_service_routine_register_handler(KERNEL_TIMER_VECTOR, timer_interrupt_handler);
+    timer_active = true;
+    return true;
+}
+
+bool kernel_timer_is_active(void) { return timer_active; }
+
+uint64_t kernel_timer_now(void) { return asmutils_read_timestamp_counter(); }
+
+uint64_t kernel_timer_microseconds_to_cycles(uint32_t microseconds)
+{
+    return (timer_tsc_hz * (uint64_t) microseconds) / 1000000u;
+}
+
+uint32_t kernel_timer_cycles_to_microseconds(uint64_t cycles)
+{
+    if (timer_tsc_hz == 0u)
+        return 0u;
+
+    /* Divided first when large, so the product stays in 64 bits. */
+    const uint64_t microseconds = cycles < 0xFFFFFFFFFFFull ? (cycles * 1000000u) / timer_tsc_hz
+                                                            : cycles / (timer_tsc_hz / 1000000u + 1u);
+    return microseconds > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t) microseconds;
+}
+
+void kernel_timer_setup(KernelTimer_t *timer, const char *name, KernelTimerCallback_t callback, void *context,
+                        uint32_t flags)
+{
+    if (!timer)
+        return;
+
+    timer->callback = callback;
+    timer->context = context;
+    timer->name = name;
+    timer->flags = flags;
+    timer->expires = 0u;
+    timer->period = 0u;
+    timer->fired = 0u;
+    timer->overruns = 0u;
+    timer->state = KERNEL_TIMER_STATE_IDLE;
+    timer->cpu = 0u;
+    timer->slot = 0u;
+    timer->next = NULL;
+    timer->link = NULL;
+}
+
+/**
+ * @brief Take @p timer off whichever queue holds it.
+ * @return true when it was queued, false when idle or running.
+ */
+static bool timer_detach(KernelTimer_t *timer)
+{
+    if (timer->state == KERNEL_TIMER_STATE_IDLE)
+        return false;
+
+    TimerQueue_t *queue = &timer_queues[timer->cpu];
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&queue->lock);
+    const bool queued = timer->state == KERNEL_TIMER_STATE_WHEEL || timer->state == KERNEL_TIMER_STATE_HEAP;
+
+    timer_dequeue(queue, timer);
+    kernel_ticket_lock_release_irqrestore(&queue->lock, flags);
+    return queued;
+}
+
+bool kernel_timer_arm(KernelTimer_t *timer, uint64_t expires, uint64_t period)
+{
+    if (!timer_active || !timer || !timer->callback)
+        return false;
+
+    (void) timer_detach(timer);
+
+    TimerQueue_t *queue = timer_local_queue();
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&queue->lock);
+
+    /* Each local timer becomes ours on first use, on its own CPU: the LVT is per
+       CPU and only that CPU can write it. */
+    if (!queue->hardware_ready)
+    {
+        (void) advanced_pic_timer_backend_enter_deadline_mode((uint8_t) KERNEL_TIMER_VECTOR);
+        queue->wheel_tick = asmutils_read_timestamp_counter() / timer_granule_cycles;
+        queue->hardware_ready = true;
+    }
+
+    timer->expires = expires;
+    timer->period = period;
+    timer->cpu = (uint8_t) (queue - timer_queues);
+    timer_enqueue(queue, timer, asmutils_read_timestamp_counter());
+    ++queue->armed;
+    timer_program(queue);
+
+    kernel_ticket_lock_release_irqrestore(&queue->lock, flags);
+    return true;
+}
+
+bool kernel_timer_arm_microseconds(KernelTimer_t *timer, uint32_t delay_us, uint32_t period_us)
+{
+    return kernel_timer_arm(timer, kernel_timer_now() + kernel_timer_microseconds_to_cycles(delay_us),
+                            kernel_timer_microseconds_to_cycles(period_us));
+}
+
+bool kernel_timer_cancel(KernelTimer_t *timer)
+{
+    if (!timer_active || !timer)
+        return false;
+
+    const bool cancelled = timer_detach(timer);
+    if (cancelled)
+        __atomic_add_fetch(&timer_queues[timer->cpu].cancelled, 1u, __ATOMIC_RELAXED);
+    return cancelled;
+}
+
+bool kernel_timer_is_pending(const KernelTimer_t *timer)
+{
+    return timer && (timer->state == KERNEL_TIMER_STATE_WHEEL || timer->state == KERNEL_TIMER_STATE_HEAP);
+}
+
+static void timer_system_tick_callback(KernelTimer_t *timer, void *context)
+{
+    (void) timer;
+    (void) context;
+    interrupt_request_timer_tick();
+}
+
+bool kernel_timer_system_tick_start(uint32_t hertz)
+{
+    if (!timer_active)
+        return false;
+    if (hertz == 0u)
+        hertz = 1u;
+
+    const uint64_t period = timer_tsc_hz / hertz;
+
+    kernel_timer_system_tick_stop();
+    kernel_timer_setup(&timer_system_tick, "system_tick", timer_system_tick_callback, NULL,
+                       KERNEL_TIMER_FLAG_PRECISE);
+    if (!kernel_timer_arm(&timer_system_tick, kernel_timer_now() + period, period))
+        return false;
+
+    /* Same handoff as LAPIC periodic mode: the PIT no longer counts ticks. */
+    programmable_interrupt_controller_set_mask(TIMER_PIT_IRQ_LINE);
+    interrupt_request_set_timer_owner_is_apic(1u);
+    timer_system_tick_running = true;
+    return true;
+}
+
+void kernel_timer_system_tick_stop(void)
+{
+    if (!timer_system_tick_running)
+        return;
+
+    (void) kernel_timer_cancel(&timer_system_tick);
+    timer_system_tick_running = false;
+}
+
+bool kernel_timer_system_tick_running(void) { return timer_system_tick_running; }
+
+void kernel_timer_get_statistics(KernelTimerStatistics_t *out)
+{
+    if (!out)
+        return;
+
+    *out = (KernelTimerStatistics_t) {0};
+    out->active = timer_active;
+    out->tsc_deadline = advanced_pic_timer_backend_is_tsc_deadline_supported() != 0u;
+    out->tsc_mhz = (uint32_t) (timer_tsc_hz / 1000000u);
+
+    for (uint32_t cpu = 0u; cpu < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++cpu)
+    {
+        const TimerQueue_t *queue = &timer_queues[cpu];
+        if (!queue->hardware_ready)
+            continue;
+
+        ++out->cpus;
+        out->pending_wheel += queue->wheel_count;
+        out->pending_heap += queue->heap_count;
+        out->armed += queue->armed;
+        out->cancelled += queue->cancelled;
+        out->fired_wheel += queue->fired_wheel;
+        out->fired_heap += queue->fired_heap;
+        out->cascaded += queue->cascaded;
+        out->heap_overflows += queue->heap_overflows;
+        out->overruns += queue->overruns;
+        out->interrupts += queue->interrupts;
+        out->empty_interrupts += queue->empty_interrupts;
+        if (queue->max_jitter_wheel_us > out->max_jitter_wheel_us)
+            out->max_jitter_wheel_us = queue->max_jitter_wheel_us;
+        if (queue->max_jitter_heap_us > out->max_jitter_heap_us)
+            out->max_jitter_heap_us = queue->max_jitter_heap_us;
+        for (uint32_t bucket = 0u; bucket < KERNEL_TIMER_JITTER_BUCKETS; ++bucket)
+        {
+            out->jitter_wheel[bucket] += queue->jitter_wheel[bucket];
+            out->jitter_heap[bucket] += queue->jitter_heap[bucket];
+        }
+    }
+}
+
+static void timer_report_jitter(Serial_t *serial, const char *queue, const uint32_t *buckets, uint32_t max_us)
+{
+    static const char *const keys[KERNEL_TIMER_JITTER_BUCKETS] = {
+        "lt1us",  "lt2us",   "lt4us",   "lt8us",   "lt16us",   "lt32us",
+        "lt64us", "lt128us", "lt256us", "lt512us", "lt1024us", "ge1024us",
+    };
+
+    kernel_telemetry_begin_record(serial, "timer_jitter");
+    kernel_telemetry_write_text("queue", queue);
+    for (uint32_t bucket = 0u; bucket < KERNEL_TIMER_JITTER_BUCKETS; ++bucket)
+        kernel_telemetry_write_unsigned(keys[bucket], buckets[bucket]);
+    kernel_telemetry_write_unsigned("max_us", max_us);
+    kernel_telemetry_end_record();
+}
+
+void kernel_timer_report(Serial_t *serial)
+{
+    KernelTimerStatistics_t statistics;
+
+    kernel_timer_get_statistics(&statistics);
+
+    kernel_telemetry_begin_record(serial, "timer");
+    kernel_telemetry_write_boolean("active", statistics.active);
+    kernel_telemetry_write_boolean("tsc_deadline", statistics.tsc_deadline);
+    kernel_telemetry_write_unsigned("tsc_mhz", statistics.tsc_mhz);
+    kernel_telemetry_write_unsigned("cpus", statistics.cpus);
+    kernel_telemetry_write_boolean("system_tick", timer_system_tick_running);
+    kernel_telemetry_write_unsigned("pending_wheel", statistics.pending_wheel);
+    kernel_telemetry_write_unsigned("pending_heap", statistics.pending_heap);
+    kernel_telemetry_write_unsigned("armed", statistics.armed);
+    kernel_telemetry_write_unsigned("cancelled", statistics.cancelled);
+    kernel_telemetry_write_unsigned("fired_wheel", statistics.fired_wheel);
+    kernel_telemetry_write_unsigned("fired_heap", statistics.fired_heap);
+    kernel_telemetry_write_unsigned("cascaded", statistics.cascaded);
+    kernel_telemetry_write_unsigned("heap_overflows", statistics.heap_overflows);
+    kernel_telemetry_write_unsigned("overruns", statistics.overruns);
+    kernel_telemetry_write_unsigned("interrupts", statistics.interrupts);
+    kernel_telemetry_write_unsigned("empty_interrupts", statistics.empty_interrupts);
+    kernel_telemetry_end_record();
+
+    if (!statistics.active)
+        return;
+
+    timer_report_jitter(serial, "heap", statistics.jitter_heap, statistics.max_jitter_heap_us);
+    timer_report_jitter(serial, "wheel", statistics.jitter_wheel, statistics.max_jitter_wheel_us);
+}
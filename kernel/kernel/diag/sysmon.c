@@ -8,14 +8,13 @@
 #include <kernel/cpu/clock.h>
 #include <kernel/cpu/pci.h>
 #include <kernel/cpu/pmm.h>
+#include <kernel/drivers/input_event.h>
 #include <kernel/drivers/keyboard.h>
 #include <kernel/hal/hal.h>
-#include <kernel/memory/frame_arena.h>
+#include <kernel/memory/allocator_registry.h>
 #include <kernel/memory/heap.h>
 #include <kernel/memory/pinned_memory.h>
-#include <kernel/memory/pool_allocator.h>
 #include <kernel/memory/ring_buffer.h>
-#include <kernel/memory/stack_allocator.h>
 
 /* ------------------------------------------------------------------------- */
 /* Tunables                                                                  */
@@ -25,6 +24,7 @@
 #define SYSMON_FLOW_LANES     4u
 #define SYSMON_FLOW_PARTICLES 96u
 #define SYSMON_SPIN_CAP       4000000u /* watchdog on the per-frame pacing spin */
+#define SYSMON_INPUT_BATCH    32u      /* input events drained per frame */
 
 /* ------------------------------------------------------------------------- */
 /* Surface drawing layer — renders into the HAL display buffer (virtio-gpu or */
@@ -127,6 +127,8 @@ typedef struct {
     uint32_t ring_enqueue, ring_dequeue, ring_failed;
 
     uint32_t pci_devices;
+
+    uint32_t input_p50_us, input_p99_us, input_samples;
 } sysmon_snapshot_t;
 
 static sysmon_snapshot_t g_now;
@@ -141,6 +143,7 @@ typedef struct {
 
 static sysmon_particle_t g_flow[SYSMON_FLOW_LANES][SYSMON_FLOW_PARTICLES];
 static uint32_t g_baseline_pages;
+static KernelInputEvent_t g_input_events[SYSMON_INPUT_BATCH];
 
 /* ------------------------------------------------------------------------- */
 /* Small helpers                                                             */
@@ -270,17 +273,24 @@ static void sysmon_sample(sysmon_snapshot_t *s)
     for (uint32_t c = 0u; c < SYSMON_SIZE_CLASSES; ++c)
         s->heap_size_class[c] = kernel_heap_get_size_class_free_count(c);
 
-    s->arena_used = kernel_frame_arena_is_initialized() ? kernel_frame_arena_get_used_bytes() : 0u;
-    s->arena_cap = kernel_frame_arena_is_initialized() ? kernel_frame_arena_get_capacity_bytes() : 0u;
-    s->arena_peak = kernel_frame_arena_is_initialized() ? kernel_frame_arena_get_peak_used_bytes() : 0u;
+    /* Every registered instance, not just the defaults: the per-CPU arenas and a
+       subsystem's own pools are memory the machine has committed all the same. */
+    KernelAllocatorUsage_t usage;
+
+    kernel_allocator_registry_sum(KERNEL_ALLOCATOR_KIND_FRAME_ARENA, &usage);
+    s->arena_used = usage.used;
+    s->arena_cap = usage.capacity;
+    s->arena_peak = usage.peak;
 
-    s->pool_cap = kernel_pool_allocator_is_initialized() ? kernel_pool_get_capacity() : 0u;
-    s->pool_free = kernel_pool_allocator_is_initialized() ? kernel_pool_get_free_count() : 0u;
-    s->pool_peak = kernel_pool_allocator_is_initialized() ? kernel_pool_get_peak_used_count() : 0u;
+    kernel_allocator_registry_sum(KERNEL_ALLOCATOR_KIND_POOL, &usage);
+    s->pool_cap = usage.capacity;
+    s->pool_free = usage.capacity - usage.used;
+    s->pool_peak = usage.peak;
 
-    s->stack_used = kernel_stack_allocator_is_initialized() ? kernel_stack_allocator_get_used() : 0u;
-    s->stack_cap = kernel_stack_allocator_is_initialized() ? kernel_stack_allocator_get_capacity() : 0u;
-    s->stack_peak = kernel_stack_allocator_is_initialized() ? kernel_stack_allocator_get_peak_used() : 0u;
+    kernel_allocator_registry_sum(KERNEL_ALLOCATOR_KIND_STACK, &usage);
+    s->stack_used = usage.used;
+    s->stack_cap = usage.capacity;
+    s->stack_peak = usage.peak;
 
     s->pinned_allocated = kernel_pinned_get_allocated_pages();
     s->pinned_released = kernel_pinned_get_released_pages();
@@ -293,6 +303,12 @@ static void sysmon_sample(sysmon_snapshot_t *s)
     s->ring_failed = kernel_ring_buffer_is_initialized() ? kernel_ring_buffer_get_failed_enqueue_count() : 0u;
 
     s->pci_devices = peripheral_component_interconnect_get_device_count();
+
+    KernelInputEventStatistics_t input;
+    kernel_input_event_get_statistics(&input);
+    s->input_p50_us = input.latency_p50_us;
+    s->input_p99_us = input.latency_p99_us;
+    s->input_samples = input.samples;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -481,6 +497,11 @@ static void sysmon_draw_frame(uint32_t frame)
         sm_label_value(left_x + 8u, y2 - 4u, "ARENA  B", g_now.arena_used, hud);
         sm_label_value(right_x + 8u, y2 - 4u, "RING/GPU", g_now.ring_count + live_pinned, hud);
         sm_label_value(margin, bus_y - 22u, "PCI DEV ", g_now.pci_devices, hud);
+        if (g_now.input_samples != 0u)
+        {
+            sm_label_value(right_x + 8u, bus_y - 22u, "IN P50 US", g_now.input_p50_us, hud);
+            sm_label_value(right_x + 8u + col_w / 2u, bus_y - 22u, "P99", g_now.input_p99_us, hud);
+        }
     }
 }
 
@@ -538,6 +559,11 @@ void kernel_sysmon_run(Serial_t *com1)
     uint32_t frame = 0u;
     while (!keyboard_try_pop_char(&key))
     {
+        /* Consumed like the engine consumes them, so each frame that shows new
+           input (a moving mouse) measures how long it took to show it. */
+        while (kernel_input_event_drain(g_input_events, SYSMON_INPUT_BATCH) == SYSMON_INPUT_BATCH)
+            continue;
+
         g_prev = g_now;
         sysmon_sample(&g_now);
         if (g_now.free_pages > g_baseline_pages)
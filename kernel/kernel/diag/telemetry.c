@@ -1,6 +1,7 @@
 #include <stddef.h>
 
 #include <kernel/diag/telemetry.h>
+#include <kernel/diag/telemetry_stream.h>
 
 /* Longest key the duplicate check stores. A key longer than this is compared on
    its first characters only, which can only ever report a duplicate that is not
@@ -103,11 +104,19 @@ static void telemetry_write_sanitised_text(const char *text)
     }
 }
 
+/* Once a fast sink is up, every record is encoded for it instead; the text path
+   below stays as it was for a machine without one. */
 void kernel_telemetry_begin_record(Serial_t *serial, const char *domain)
 {
     if (!serial || !domain)
         return;
 
+    if (kernel_telemetry_stream_active())
+    {
+        kernel_telemetry_stream_begin_record(domain);
+        return;
+    }
+
     telemetry_serial = serial;
     telemetry_record_is_open = true;
     telemetry_field_count = 0u;
@@ -118,6 +127,13 @@ void kernel_telemetry_begin_record(Serial_t *serial, const char *domain)
 
 void kernel_telemetry_write_unsigned(const char *key, uint32_t value)
 {
+    if (kernel_telemetry_stream_active())
+    {
+        if (kernel_telemetry_stream_open_field(key, KERNEL_TELEMETRY_FIELD_UNSIGNED))
+            kernel_telemetry_stream_write_varint(value);
+        return;
+    }
+
     if (!telemetry_open_field(key))
         return;
 
@@ -126,6 +142,13 @@ void kernel_telemetry_write_unsigned(const char *key, uint32_t value)
 
 void kernel_telemetry_write_hexadecimal(const char *key, uint32_t value)
 {
+    if (kernel_telemetry_stream_active())
+    {
+        if (kernel_telemetry_stream_open_field(key, KERNEL_TELEMETRY_FIELD_HEXADECIMAL))
+            kernel_telemetry_stream_write_varint(value);
+        return;
+    }
+
     if (!telemetry_open_field(key))
         return;
 
@@ -134,6 +157,13 @@ void kernel_telemetry_write_hexadecimal(const char *key, uint32_t value)
 
 void kernel_telemetry_write_boolean(const char *key, bool value)
 {
+    if (kernel_telemetry_stream_active())
+    {
+        if (kernel_telemetry_stream_open_field(key, KERNEL_TELEMETRY_FIELD_BOOLEAN))
+            kernel_telemetry_stream_write_varint(value ? 1u : 0u);
+        return;
+    }
+
     if (!telemetry_open_field(key))
         return;
 
@@ -142,6 +172,20 @@ void kernel_telemetry_write_boolean(const char *key, bool value)
 
 void kernel_telemetry_write_text(const char *key, const char *value)
 {
+    if (kernel_telemetry_stream_active())
+    {
+        if (!key || !kernel_telemetry_stream_open_field(key, KERNEL_TELEMETRY_FIELD_TEXT))
+            return;
+
+        const char *text = value ? value : "none";
+        uint32_t length = 0u;
+        while (text[length] != '\0')
+            ++length;
+
+        kernel_telemetry_stream_write_text(text, length);
+        return;
+    }
+
     if (!telemetry_open_field(key))
         return;
 
@@ -150,6 +194,12 @@ void kernel_telemetry_write_text(const char *key, const char *value)
 
 void kernel_telemetry_end_record(void)
 {
+    if (kernel_telemetry_stream_active())
+    {
+        kernel_telemetry_stream_end_record();
+        return;
+    }
+
     if (!telemetry_record_is_open || !telemetry_serial)
         return;
 
@@ -159,25 +209,64 @@ void kernel_telemetry_end_record(void)
     ++telemetry_record_count;
 }
 
-uint32_t kernel_telemetry_get_record_count(void) { return telemetry_record_count; }
+/* Each counter is the text path's plus the binary path's; a boot only ever feeds
+   one of them, but a reader should not have to know which. */
+uint32_t kernel_telemetry_get_record_count(void)
+{
+    KernelTelemetryStreamStatistics_t stream;
+
+    kernel_telemetry_stream_get_statistics(&stream);
+    return telemetry_record_count + stream.records;
+}
+
+uint32_t kernel_telemetry_get_duplicate_key_count(void)
+{
+    KernelTelemetryStreamStatistics_t stream;
+
+    kernel_telemetry_stream_get_statistics(&stream);
+    return telemetry_duplicate_key_count + stream.duplicate_keys;
+}
+
+uint32_t kernel_telemetry_get_sanitised_character_count(void)
+{
+    KernelTelemetryStreamStatistics_t stream;
 
-uint32_t kernel_telemetry_get_duplicate_key_count(void) { return telemetry_duplicate_key_count; }
+    kernel_telemetry_stream_get_statistics(&stream);
+    return telemetry_sanitised_character_count + stream.sanitised_characters;
+}
 
-uint32_t kernel_telemetry_get_sanitised_character_count(void) { return telemetry_sanitised_character_count; }
+uint32_t kernel_telemetry_get_dropped_field_count(void)
+{
+    KernelTelemetryStreamStatistics_t stream;
 
-uint32_t kernel_telemetry_get_dropped_field_count(void) { return telemetry_dropped_field_count; }
+    kernel_telemetry_stream_get_statistics(&stream);
+    return telemetry_dropped_field_count + stream.dropped_fields;
+}
 
 void kernel_telemetry_report(Serial_t *serial)
 {
     if (!serial)
         return;
 
-    const uint32_t records_before = telemetry_record_count;
+    KernelTelemetryStreamStatistics_t stream;
+
+    kernel_telemetry_stream_get_statistics(&stream);
+
+    const uint32_t records_before = kernel_telemetry_get_record_count();
 
     kernel_telemetry_begin_record(serial, "telemetry");
     kernel_telemetry_write_unsigned("records", records_before);
-    kernel_telemetry_write_unsigned("duplicate_keys", telemetry_duplicate_key_count);
-    kernel_telemetry_write_unsigned("sanitised_characters", telemetry_sanitised_character_count);
-    kernel_telemetry_write_unsigned("dropped_fields", telemetry_dropped_field_count);
+    kernel_telemetry_write_unsigned("duplicate_keys", kernel_telemetry_get_duplicate_key_count());
+    kernel_telemetry_write_unsigned("sanitised_characters", kernel_telemetry_get_sanitised_character_count());
+    kernel_telemetry_write_unsigned("dropped_fields", kernel_telemetry_get_dropped_field_count());
+    kernel_telemetry_write_unsigned("sink", (uint32_t) stream.sink);
+    kernel_telemetry_write_unsigned("names", stream.names);
+    kernel_telemetry_write_unsigned("inline_names", stream.inline_names);
+    kernel_telemetry_write_unsigned("bytes_committed", stream.bytes_committed);
+    kernel_telemetry_write_unsigned("bytes_written", stream.bytes_written);
+    kernel_telemetry_write_unsigned("drains", stream.drains);
+    kernel_telemetry_write_unsigned("stalls", stream.stalls);
+    kernel_telemetry_write_unsigned("ring_high_water", stream.ring_high_water);
+    kernel_telemetry_write_unsigned("truncated_records", stream.truncated_records);
     kernel_telemetry_end_record();
 }
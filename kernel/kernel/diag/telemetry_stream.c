@@ -0,0 +1,873 @@
+/**
+ * @file telemetry_stream.c
+ * @brief Binary telemetry frames, per-CPU rings and the idle-time drain.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#include <kernel/diag/telemetry_stream.h>
+
+#include <kernel/config.h>
+#include <kernel/core/lock.h>
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/diag/telemetry.h>
+#include <kernel/lib/asmutils.h>
+
+#define TELEMETRY_STREAM_CPU_COUNT     CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC
+#define TELEMETRY_STREAM_RING_MASK     (KERNEL_TELEMETRY_STREAM_RING_BYTES - 1u)
+#define TELEMETRY_STREAM_CACHE_LINE    64u
+
+/* Largest RECORD payload. Thirty-two numeric fields with interned keys need under
+   half of it; what is left is for text values. */
+#define TELEMETRY_STREAM_STAGING_BYTES 384u
+
+/* Frames waiting on the sink. Holds the largest frame with room to spare, so
+   moving one out of a ring never has to wait for the sink to take the previous. */
+#define TELEMETRY_STREAM_TRANSMIT_BYTES 1024u
+#define TELEMETRY_STREAM_TRANSMIT_MASK  (TELEMETRY_STREAM_TRANSMIT_BYTES - 1u)
+
+/* Bytes a 16550 accepts once it reports its transmitter empty. */
+#define TELEMETRY_STREAM_UART_FIFO_BYTES 16u
+
+/* Names longer than this travel inline rather than being interned. Every name the
+   tree uses today is well under it. */
+#define TELEMETRY_STREAM_NAME_BYTES 47u
+#define TELEMETRY_STREAM_MAX_NAMES  384u
+#define TELEMETRY_STREAM_HASH_SLOTS 1024u
+#define TELEMETRY_STREAM_HASH_MASK  (TELEMETRY_STREAM_HASH_SLOTS - 1u)
+
+typedef struct {
+    volatile uint32_t tail __attribute__((aligned(TELEMETRY_STREAM_CACHE_LINE)));
+    volatile uint32_t head __attribute__((aligned(TELEMETRY_STREAM_CACHE_LINE)));
+    uint8_t bytes[KERNEL_TELEMETRY_STREAM_RING_BYTES] __attribute__((aligned(TELEMETRY_STREAM_CACHE_LINE)));
+} TelemetryStreamRing_t;
+
+/* Written only by its own CPU, with interrupts off from begin to end. */
+typedef struct {
+    uint8_t payload[TELEMETRY_STREAM_STAGING_BYTES];
+    uint16_t key_ids[KERNEL_TELEMETRY_MAX_FIELDS_PER_RECORD];
+    uint32_t length;
+    uint32_t field_start;
+    uint32_t field_count;
+    uint32_t sequence;
+    uint32_t flags;
+    bool open;
+    bool truncated;
+} __attribute__((aligned(TELEMETRY_STREAM_CACHE_LINE))) TelemetryStreamStaging_t;
+
+typedef struct {
+    uint32_t hash;
+    uint8_t length;
+    uint8_t is_domain;
+    uint8_t sanitised;
+    char text[TELEMETRY_STREAM_NAME_BYTES];
+} TelemetryStreamName_t;
+
+static KernelTelemetrySink_t telemetry_stream_sink = KERNEL_TELEMETRY_SINK_TEXT;
+static Serial_t telemetry_stream_serial;
+
+static TelemetryStreamRing_t telemetry_stream_rings[TELEMETRY_STREAM_CPU_COUNT];
+static TelemetryStreamStaging_t telemetry_stream_staging[TELEMETRY_STREAM_CPU_COUNT];
+
+/* Names: entries are written under the intern lock, the count is published before
+   the hash slot, so whoever finds an id in a slot also sees a count that covers it.
+   Lookups never take the lock. */
+static TelemetryStreamName_t telemetry_stream_names[TELEMETRY_STREAM_MAX_NAMES];
+static volatile uint16_t telemetry_stream_hash_slots[TELEMETRY_STREAM_HASH_SLOTS];
+static volatile uint32_t telemetry_stream_name_count = 0u;
+static KernelTicketLock_t telemetry_stream_intern_lock;
+
+/* Everything below is owned by whoever holds the drain lock. */
+static KernelTicketLock_t telemetry_stream_drain_lock;
+static uint8_t telemetry_stream_transmit[TELEMETRY_STREAM_TRANSMIT_BYTES];
+static uint32_t telemetry_stream_transmit_head = 0u;
+static uint32_t telemetry_stream_transmit_tail = 0u;
+static uint32_t telemetry_stream_names_defined = 0u;
+static uint32_t telemetry_stream_next_ring = 0u;
+
+static volatile uint32_t telemetry_stream_records = 0u;
+static volatile uint32_t telemetry_stream_inline_names = 0u;
+static volatile uint32_t telemetry_stream_bytes_committed = 0u;
+static volatile uint32_t telemetry_stream_stalls = 0u;
+static volatile uint32_t telemetry_stream_ring_high_water = 0u;
+static volatile uint32_t telemetry_stream_truncated_records = 0u;
+static volatile uint32_t telemetry_stream_duplicate_keys = 0u;
+static volatile uint32_t telemetry_stream_sanitised_characters = 0u;
+static volatile uint32_t telemetry_stream_dropped_fields = 0u;
+static uint32_t telemetry_stream_bytes_written = 0u;
+static uint32_t telemetry_stream_drains = 0u;
+
+static inline uint32_t telemetry_stream_save_and_disable_interrupts(void)
+{
+    uint32_t flags;
+
+    __asm__ volatile("pushfl\n\tpopl %0\n\tcli" : "=r"(flags)::"memory");
+    return flags;
+}
+
+static inline void telemetry_stream_restore_interrupts(uint32_t flags)
+{
+    __asm__ volatile("pushl %0\n\tpopfl" ::"r"(flags) : "memory", "cc");
+}
+
+static inline void telemetry_stream_count(volatile uint32_t *counter, uint32_t amount)
+{
+    __atomic_add_fetch(counter, amount, __ATOMIC_RELAXED);
+}
+
+static uint32_t telemetry_stream_varint_length(uint32_t value)
+{
+    uint32_t length = 1u;
+
+    while (value >= 0x80u)
+    {
+        value >>= 7;
+        ++length;
+    }
+
+    return length;
+}
+
+static uint32_t telemetry_stream_encode_varint(uint8_t *out, uint32_t value)
+{
+    uint32_t length = 0u;
+
+    while (value >= 0x80u)
+    {
+        out[length++] = (uint8_t) (value | 0x80u);
+        value >>= 7;
+    }
+
+    out[length++] = (uint8_t) value;
+    return length;
+}
+
+static inline bool telemetry_stream_must_sanitise(char character) { return character == ' ' || character == '='; }
+
+/* -- Names --------------------------------------------------------------- */
+
+/* FNV-1a over the name, with domains and keys kept apart so `telemetry` the domain
+   and a hypothetical `telemetry` key do not share an entry with different
+   sanitisation. Returns false when the name is too long to intern. */
+static bool telemetry_stream_hash_name(const char *name, bool is_domain, uint32_t *hash, uint32_t *length)
+{
+    uint32_t value = is_domain ? 0x811C9DC5u ^ 0x9E3779B9u : 0x811C9DC5u;
+    uint32_t count = 0u;
+
+    while (name[count] != '\0')
+    {
+        if (count >= TELEMETRY_STREAM_NAME_BYTES)
+            return false;
+
+        value = (value ^ (uint8_t) name[count]) * 0x01000193u;
+        ++count;
+    }
+
+    *hash = value;
+    *length = count;
+    return true;
+}
+
+static bool telemetry_stream_name_matches(const TelemetryStreamName_t *entry, uint32_t hash, const char *name,
+                                          uint32_t length, bool is_domain)
+{
+    if (entry->hash != hash || entry->length != length || entry->is_domain != (uint8_t) is_domain)
+        return false;
+
+    for (uint32_t index = 0u; index < length; ++index)
+    {
+        if (entry->text[index] != name[index])
+            return false;
+    }
+
+    return true;
+}
+
+/* Probes the table; *slot receives the first empty slot on a miss. */
+static uint32_t telemetry_stream_find_name(uint32_t hash, const char *name, uint32_t length, bool is_domain,
+                                           uint32_t *slot)
+{
+    uint32_t index = hash & TELEMETRY_STREAM_HASH_MASK;
+
+    for (uint32_t probe = 0u; probe < TELEMETRY_STREAM_HASH_SLOTS; ++probe)
+    {
+        const uint32_t id = __atomic_load_n(&telemetry_stream_hash_slots[index], __ATOMIC_ACQUIRE);
+
+        if (id == 0u)
+        {
+            *slot = index;
+            return 0u;
+        }
+
+        if (telemetry_stream_name_matches(&telemetry_stream_names[id - 1u], hash, name, length, is_domain))
+            return id;
+
+        index = (index + 1u) & TELEMETRY_STREAM_HASH_MASK;
+    }
+
+    *slot = TELEMETRY_STREAM_HASH_SLOTS;
+    return 0u;
+}
+
+/** @return The name's id, or 0 when it has to travel inline. */
+static uint32_t telemetry_stream_intern(const char *name, bool is_domain)
+{
+    uint32_t hash = 0u;
+    uint32_t length = 0u;
+    uint32_t slot = 0u;
+
+    if (!telemetry_stream_hash_name(name, is_domain, &hash, &length))
+        return 0u;
+
+    uint32_t id = telemetry_stream_find_name(hash, name, length, is_domain, &slot);
+    if (id != 0u)
+        return id;
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&telemetry_stream_intern_lock);
+
+    /* Another core may have interned it between the probe and the lock. */
+    id = telemetry_stream_find_name(hash, name, length, is_domain, &slot);
+
+    const uint32_t count = telemetry_stream_name_count;
+    if (id == 0u && slot < TELEMETRY_STREAM_HASH_SLOTS && count < TELEMETRY_STREAM_MAX_NAMES)
+    {
+        TelemetryStreamName_t *entry = &telemetry_stream_names[count];
+
+        entry->hash = hash;
+        entry->length = (uint8_t) length;
+        entry->is_domain = (uint8_t) is_domain;
+        entry->sanitised = 0u;
+
+        for (uint32_t index = 0u; index < length; ++index)
+        {
+            entry->text[index] = name[index];
+            if (is_domain && telemetry_stream_must_sanitise(name[index]))
+                ++entry->sanitised;
+        }
+
+        id = count + 1u;
+        __atomic_store_n(&telemetry_stream_name_count, id, __ATOMIC_RELEASE);
+        __atomic_store_n(&telemetry_stream_hash_slots[slot], (uint16_t) id, __ATOMIC_RELEASE);
+    }
+
+    kernel_ticket_lock_release_irqrestore(&telemetry_stream_intern_lock, flags);
+    return id;
+}
+
+/* -- Staging ------------------------------------------------------------- */
+
+static TelemetryStreamStaging_t *telemetry_stream_current_staging(uint32_t *cpu)
+{
+    uint32_t slot = cpu_topology_get_logical_slot();
+
+    if (slot >= TELEMETRY_STREAM_CPU_COUNT)
+        slot = 0u;
+
+    *cpu = slot;
+    return &telemetry_stream_staging[slot];
+}
+
+static TelemetryStreamStaging_t *telemetry_stream_open_staging(void)
+{
+    uint32_t cpu = 0u;
+    TelemetryStreamStaging_t *staging = telemetry_stream_current_staging(&cpu);
+
+    return staging->open ? staging : NULL;
+}
+
+static inline bool telemetry_stream_staging_fits(const TelemetryStreamStaging_t *staging, uint32_t bytes)
+{
+    return staging->length + bytes <= TELEMETRY_STREAM_STAGING_BYTES;
+}
+
+static void telemetry_stream_stage_varint(TelemetryStreamStaging_t *staging, uint32_t value)
+{
+    staging->length += telemetry_stream_encode_varint(&staging->payload[staging->length], value);
+}
+
+/* Copies @p length bytes of @p text, replacing what would split a text field. The
+   caller has checked the room. */
+static void telemetry_stream_stage_text(TelemetryStreamStaging_t *staging, const char *text, uint32_t length,
+                                        bool sanitise)
+{
+    uint32_t replaced = 0u;
+
+    for (uint32_t index = 0u; index < length; ++index)
+    {
+        char character = text[index];
+
+        if (sanitise && telemetry_stream_must_sanitise(character))
+        {
+            character = '_';
+            ++replaced;
+        }
+
+        staging->payload[staging->length++] = (uint8_t) character;
+    }
+
+    if (replaced != 0u)
+        telemetry_stream_count(&telemetry_stream_sanitised_characters, replaced);
+}
+
+static uint32_t telemetry_stream_text_length(const char *text)
+{
+    uint32_t length = 0u;
+
+    while (text[length] != '\0')
+        ++length;
+
+    return length;
+}
+
+/* -- Rings --------------------------------------------------------------- */
+
+static inline uint8_t telemetry_stream_ring_byte(const TelemetryStreamRing_t *ring, uint32_t position)
+{
+    return ring->bytes[position & TELEMETRY_STREAM_RING_MASK];
+}
+
+/* Size of the frame that starts at @p position; the ring only ever holds whole
+   frames, so the header is always there to read. */
+static uint32_t telemetry_stream_ring_frame_size(const TelemetryStreamRing_t *ring, uint32_t position)
+{
+    uint32_t payload = 0u;
+    uint32_t shift = 0u;
+    uint32_t cursor = position + 2u;
+    uint8_t byte = 0u;
+
+    do
+    {
+        byte = telemetry_stream_ring_byte(ring, cursor++);
+        payload |= (uint32_t) (byte & 0x7Fu) << shift;
+        shift += 7u;
+    } while ((byte & 0x80u) != 0u && shift < 35u);
+
+    return (cursor - position) + payload + 1u;
+}
+
+static inline uint32_t telemetry_stream_transmit_free(void)
+{
+    return TELEMETRY_STREAM_TRANSMIT_BYTES - (telemetry_stream_transmit_tail - telemetry_stream_transmit_head);
+}
+
+static void telemetry_stream_transmit_append(const uint8_t *bytes, uint32_t length)
+{
+    for (uint32_t index = 0u; index < length; ++index)
+        telemetry_stream_transmit[(telemetry_stream_transmit_tail + index) & TELEMETRY_STREAM_TRANSMIT_MASK] =
+            bytes[index];
+
+    telemetry_stream_transmit_tail += length;
+}
+
+/* Frames the drain writes itself — HELLO, DEFINE and TRACE — go through here. */
+static bool telemetry_stream_transmit_frame(uint8_t type, const uint8_t *payload, uint32_t length)
+{
+    uint8_t header[2u + 5u];
+    uint32_t header_length = 0u;
+    uint8_t checksum = 0u;
+
+    header[header_length++] = KERNEL_TELEMETRY_STREAM_SYNC;
+    header[header_length++] = type;
+    header_length += telemetry_stream_encode_varint(&header[header_length], length);
+
+    if (telemetry_stream_transmit_free() < header_length + length + 1u)
+        return false;
+
+    for (uint32_t index = 1u; index < header_length; ++index)
+        checksum = (uint8_t) (checksum + header[index]);
+    for (uint32_t index = 0u; index < length; ++index)
+        checksum = (uint8_t) (checksum + payload[index]);
+
+    telemetry_stream_transmit_append(header, header_length);
+    telemetry_stream_transmit_append(payload, length);
+    telemetry_stream_transmit_append(&checksum, 1u);
+    return true;
+}
+
+static bool telemetry_stream_transmit_definitions(uint32_t named)
+{
+    while (telemetry_stream_names_defined < named)
+    {
+        const TelemetryStreamName_t *entry = &telemetry_stream_names[telemetry_stream_names_defined];
+        uint8_t payload[5u + TELEMETRY_STREAM_NAME_BYTES];
+        uint32_t length = telemetry_stream_encode_varint(payload, telemetry_stream_names_defined + 1u);
+
+        for (uint32_t index = 0u; index < entry->length; ++index)
+        {
+            const char character = entry->text[index];
+            payload[length++] =
+                (uint8_t) (entry->is_domain && telemetry_stream_must_sanitise(character) ? '_' : character);
+        }
+
+        if (!telemetry_stream_transmit_frame(KERNEL_TELEMETRY_STREAM_FRAME_DEFINE, payload, length))
+            return false;
+
+        ++telemetry_stream_names_defined;
+    }
+
+    return true;
+}
+
+/* Moves whole frames from the rings into the transmit buffer, oldest first per
+   ring and the rings in turn. Each ring's tail is read before the name count, so
+   every id its frames use is already covered by a DEFINE queued ahead of them. */
+static void telemetry_stream_fill_transmit(void)
+{
+    for (uint32_t visited = 0u; visited < TELEMETRY_STREAM_CPU_COUNT; ++visited)
+    {
+        const uint32_t cpu = (telemetry_stream_next_ring + visited) % TELEMETRY_STREAM_CPU_COUNT;
+        TelemetryStreamRing_t *ring = &telemetry_stream_rings[cpu];
+        const uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        uint32_t head = ring->head;
+
+        if (head == tail)
+            continue;
+
+        if (!telemetry_stream_transmit_definitions(__atomic_load_n(&telemetry_stream_name_count, __ATOMIC_ACQUIRE)))
+            return;
+
+        while (head != tail)
+        {
+            const uint32_t size = telemetry_stream_ring_frame_size(ring, head);
+
+            if (telemetry_stream_transmit_free() < size)
+            {
+                __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+                telemetry_stream_next_ring = cpu;
+                return;
+            }
+
+            for (uint32_t index = 0u; index < size; ++index)
+                telemetry_stream_transmit[(telemetry_stream_transmit_tail + index) & TELEMETRY_STREAM_TRANSMIT_MASK] =
+                    telemetry_stream_ring_byte(ring, head + index);
+
+            telemetry_stream_transmit_tail += size;
+            head += size;
+        }
+
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    }
+
+    telemetry_stream_next_ring = (telemetry_stream_next_ring + 1u) % TELEMETRY_STREAM_CPU_COUNT;
+}
+
+/* -- Sink ---------------------------------------------------------------- */
+
+/* Hands up to @p budget queued bytes to the sink. Without @p blocking it stops at
+   the first sign the UART is still busy rather than spinning on it. */
+static uint32_t telemetry_stream_sink_push(uint32_t budget, bool blocking)
+{
+    uint32_t written = 0u;
+
+    while (written < budget && telemetry_stream_transmit_head != telemetry_stream_transmit_tail)
+    {
+        uint32_t burst = telemetry_stream_transmit_tail - telemetry_stream_transmit_head;
+
+        if (burst > budget - written)
+            burst = budget - written;
+
+        if (telemetry_stream_sink == KERNEL_TELEMETRY_SINK_SERIAL)
+        {
+            const uint16_t port = (uint16_t) telemetry_stream_serial.port;
+
+            if ((asmutils_input_byte((uint16_t) (port + 5u)) & 0x20u) == 0u)
+            {
+                if (!blocking)
+                    break;
+                __builtin_ia32_pause();
+                continue;
+            }
+
+            if (burst > TELEMETRY_STREAM_UART_FIFO_BYTES)
+                burst = TELEMETRY_STREAM_UART_FIFO_BYTES;
+
+            for (uint32_t index = 0u; index < burst; ++index)
+                asmutils_output_byte(port, telemetry_stream_transmit[(telemetry_stream_transmit_head + index) &
+                                                                     TELEMETRY_STREAM_TRANSMIT_MASK]);
+        }
+        else
+        {
+            for (uint32_t index = 0u; index < burst; ++index)
+                asmutils_output_byte(KERNEL_TELEMETRY_STREAM_DEBUGCON_PORT,
+                                     telemetry_stream_transmit[(telemetry_stream_transmit_head + index) &
+                                                               TELEMETRY_STREAM_TRANSMIT_MASK]);
+        }
+
+        telemetry_stream_transmit_head += burst;
+        written += burst;
+    }
+
+    telemetry_stream_bytes_written += written;
+    return written;
+}
+
+static uint32_t telemetry_stream_drain_locked(uint32_t budget, bool blocking)
+{
+    uint32_t written = 0u;
+
+    while (written < budget)
+    {
+        telemetry_stream_fill_transmit();
+
+        const uint32_t pushed = telemetry_stream_sink_push(budget - written, blocking);
+        if (pushed == 0u)
+            break;
+
+        written += pushed;
+    }
+
+    if (written != 0u)
+        ++telemetry_stream_drains;
+
+    return written;
+}
+
+static bool telemetry_stream_rings_empty(void)
+{
+    for (uint32_t cpu = 0u; cpu < TELEMETRY_STREAM_CPU_COUNT; ++cpu)
+    {
+        const TelemetryStreamRing_t *ring = &telemetry_stream_rings[cpu];
+
+        if (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) != ring->head)
+            return false;
+    }
+
+    return telemetry_stream_transmit_head == telemetry_stream_transmit_tail;
+}
+
+/* Producer side. Interrupts are off, so the only other party touching this ring
+   is the drain. A ring without room for the frame is drained here and now: the
+   record is never dropped, the stall is counted instead. */
+static void telemetry_stream_ring_commit(TelemetryStreamRing_t *ring, const uint8_t *header, uint32_t header_length,
+                                         const uint8_t *payload, uint32_t payload_length, uint8_t checksum)
+{
+    const uint32_t size = header_length + payload_length + 1u;
+    const uint32_t tail = ring->tail;
+    bool stalled = false;
+
+    for (;;)
+    {
+        const uint32_t used = tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        if (KERNEL_TELEMETRY_STREAM_RING_BYTES - used >= size)
+            break;
+
+        if (!stalled)
+        {
+            stalled = true;
+            telemetry_stream_count(&telemetry_stream_stalls, 1u);
+        }
+
+        /* The drain lock is never held with interrupts on, so a holder is another
+           core making progress; waiting on it cannot deadlock this one. */
+        if (kernel_ticket_lock_try_acquire(&telemetry_stream_drain_lock))
+        {
+            (void) telemetry_stream_drain_locked(KERNEL_TELEMETRY_STREAM_RING_BYTES, true);
+            kernel_ticket_lock_release(&telemetry_stream_drain_lock);
+        }
+        else
+            __builtin_ia32_pause();
+    }
+
+    uint32_t position = tail;
+    for (uint32_t index = 0u; index < header_length; ++index)
+        ring->bytes[position++ & TELEMETRY_STREAM_RING_MASK] = header[index];
+    for (uint32_t index = 0u; index < payload_length; ++index)
+        ring->bytes[position++ & TELEMETRY_STREAM_RING_MASK] = payload[index];
+    ring->bytes[position++ & TELEMETRY_STREAM_RING_MASK] = checksum;
+
+    __atomic_store_n(&ring->tail, position, __ATOMIC_RELEASE);
+
+    const uint32_t held = position - __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t high_water = __atomic_load_n(&telemetry_stream_ring_high_water, __ATOMIC_RELAXED);
+    while (held > high_water &&
+           !__atomic_compare_exchange_n(&telemetry_stream_ring_high_water, &high_water, held, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+
+    telemetry_stream_count(&telemetry_stream_bytes_committed, size);
+}
+
+/* -- Public API ---------------------------------------------------------- */
+
+KernelTelemetrySink_t kernel_telemetry_stream_initialize(Serial_t *serial)
+{
+    kernel_ticket_lock_initialize(&telemetry_stream_intern_lock, NULL);
+    kernel_ticket_lock_initialize(&telemetry_stream_drain_lock, NULL);
+
+#if !defined(LPL_KERNEL_TELEMETRY_TEXT_ONLY)
+    /* A debug console reads back its own port number; an unclaimed port floats
+       to 0xFF. */
+    if (asmutils_input_byte(KERNEL_TELEMETRY_STREAM_DEBUGCON_PORT) == KERNEL_TELEMETRY_STREAM_DEBUGCON_PORT)
+        telemetry_stream_sink = KERNEL_TELEMETRY_SINK_DEBUGCON;
+    else
+    {
+        serial_initialize(&telemetry_stream_serial, COM2, KERNEL_TELEMETRY_STREAM_SERIAL_SPEED);
+        if (telemetry_stream_serial.initialized)
+            telemetry_stream_sink = KERNEL_TELEMETRY_SINK_SERIAL;
+    }
+
+    if (telemetry_stream_sink != KERNEL_TELEMETRY_SINK_TEXT)
+    {
+        static const uint8_t hello[] = {'L', 'P', 'L', 'T', 'L', 'M', KERNEL_TELEMETRY_STREAM_VERSION};
+
+        (void) telemetry_stream_transmit_frame(KERNEL_TELEMETRY_STREAM_FRAME_HELLO, hello, sizeof(hello));
+        (void) telemetry_stream_sink_push(TELEMETRY_STREAM_TRANSMIT_BYTES, true);
+    }
+#endif
+
+    if (serial)
+    {
+        static const char *const sink_names[] = {"text on the caller's port", "binary on debugcon 0xE9",
+                                                 "binary on COM2 at 115200"};
+
+        serial_write_string(serial, "[" KERNEL_SYSTEM_STRING "]: telemetry: ");
+        serial_write_string(serial, sink_names[telemetry_stream_sink]);
+        serial_write_string(serial, "\n");
+    }
+
+    return telemetry_stream_sink;
+}
+
+bool kernel_telemetry_stream_active(void) { return telemetry_stream_sink != KERNEL_TELEMETRY_SINK_TEXT; }
+
+uint32_t kernel_telemetry_stream_drain(uint32_t budget)
+{
+    if (telemetry_stream_sink == KERNEL_TELEMETRY_SINK_TEXT)
+        return 0u;
+
+    if (budget == 0u)
+        budget = KERNEL_TELEMETRY_STREAM_DEFAULT_BUDGET;
+
+    const uint32_t flags = telemetry_stream_save_and_disable_interrupts();
+    uint32_t written = 0u;
+
+    if (kernel_ticket_lock_try_acquire(&telemetry_stream_drain_lock))
+    {
+        written = telemetry_stream_drain_locked(budget, false);
+        kernel_ticket_lock_release(&telemetry_stream_drain_lock);
+    }
+
+    telemetry_stream_restore_interrupts(flags);
+    return written;
+}
+
+void kernel_telemetry_stream_flush(void)
+{
+    if (telemetry_stream_sink == KERNEL_TELEMETRY_SINK_TEXT)
+        return;
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&telemetry_stream_drain_lock);
+
+    while (!telemetry_stream_rings_empty())
+        (void) telemetry_stream_drain_locked(KERNEL_TELEMETRY_STREAM_RING_BYTES, true);
+
+    kernel_ticket_lock_release_irqrestore(&telemetry_stream_drain_lock, flags);
+}
+
+static bool telemetry_stream_write_export(uint8_t type, const void *bytes, uint32_t length)
+{
+    if (telemetry_stream_sink == KERNEL_TELEMETRY_SINK_TEXT || length > KERNEL_TELEMETRY_STREAM_TRACE_CHUNK_BYTES)
+        return false;
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&telemetry_stream_drain_lock);
+
+    /* Records queued before the chunk go out before it, and the transmit buffer is
+       empty afterwards, so the frame always fits. */
+    while (!telemetry_stream_rings_empty())
+        (void) telemetry_stream_drain_locked(KERNEL_TELEMETRY_STREAM_RING_BYTES, true);
+
+    (void) telemetry_stream_transmit_frame(type, (const uint8_t *) bytes, length);
+    (void) telemetry_stream_sink_push(TELEMETRY_STREAM_TRANSMIT_BYTES, true);
+
+    kernel_ticket_lock_release_irqrestore(&telemetry_stream_drain_lock, flags);
+    return true;
+}
+
+bool kernel_telemetry_stream_write_trace(const void *bytes, uint32_t length)
+{
+    return telemetry_stream_write_export(KERNEL_TELEMETRY_STREAM_FRAME_TRACE, bytes, length);
+}
+
+bool kernel_telemetry_stream_write_heap_trace(const void *bytes, uint32_t length)
+{
+    return telemetry_stream_write_export(KERNEL_TELEMETRY_STREAM_FRAME_HEAP_TRACE, bytes, length);
+}
+
+void kernel_telemetry_stream_get_statistics(KernelTelemetryStreamStatistics_t *out)
+{
+    if (!out)
+        return;
+
+    out->sink = telemetry_stream_sink;
+    out->records = telemetry_stream_records;
+    out->names = telemetry_stream_name_count;
+    out->inline_names = telemetry_stream_inline_names;
+    out->bytes_committed = telemetry_stream_bytes_committed;
+    out->bytes_written = telemetry_stream_bytes_written;
+    out->drains = telemetry_stream_drains;
+    out->stalls = telemetry_stream_stalls;
+    out->ring_high_water = telemetry_stream_ring_high_water;
+    out->truncated_records = telemetry_stream_truncated_records;
+    out->duplicate_keys = telemetry_stream_duplicate_keys;
+    out->sanitised_characters = telemetry_stream_sanitised_characters;
+    out->dropped_fields = telemetry_stream_dropped_fields;
+}
+
+void kernel_telemetry_stream_begin_record(const char *domain)
+{
+    const uint32_t flags = telemetry_stream_save_and_disable_interrupts();
+    uint32_t cpu = 0u;
+    TelemetryStreamStaging_t *staging = telemetry_stream_current_staging(&cpu);
+
+    /* A record opened over an unclosed one replaces it, as the text path does, but
+       keeps the interrupt state saved by the first begin. */
+    if (!staging->open)
+        staging->flags = flags;
+
+    staging->open = true;
+    staging->truncated = false;
+    staging->length = 0u;
+    staging->field_count = 0u;
+
+    telemetry_stream_stage_varint(staging, cpu);
+    telemetry_stream_stage_varint(staging, staging->sequence);
+
+    const uint32_t id = telemetry_stream_intern(domain, true);
+    telemetry_stream_stage_varint(staging, id);
+
+    if (id != 0u)
+    {
+        const uint32_t sanitised = telemetry_stream_names[id - 1u].sanitised;
+        if (sanitised != 0u)
+            telemetry_stream_count(&telemetry_stream_sanitised_characters, sanitised);
+        return;
+    }
+
+    uint32_t length = telemetry_stream_text_length(domain);
+    if (length > TELEMETRY_STREAM_STAGING_BYTES / 4u)
+        length = TELEMETRY_STREAM_STAGING_BYTES / 4u;
+
+    telemetry_stream_count(&telemetry_stream_inline_names, 1u);
+    telemetry_stream_stage_varint(staging, length);
+    telemetry_stream_stage_text(staging, domain, length, true);
+}
+
+bool kernel_telemetry_stream_open_field(const char *key, KernelTelemetryFieldKind_t kind)
+{
+    TelemetryStreamStaging_t *staging = telemetry_stream_open_staging();
+
+    if (!staging || !key)
+        return false;
+
+    if (staging->field_count >= KERNEL_TELEMETRY_MAX_FIELDS_PER_RECORD)
+    {
+        telemetry_stream_count(&telemetry_stream_dropped_fields, 1u);
+        return false;
+    }
+
+    const uint32_t id = telemetry_stream_intern(key, false);
+    const uint32_t key_length = id != 0u ? 0u : telemetry_stream_text_length(key);
+
+    /* Key, kind and the widest varint value; a text value checks its own room. */
+    if (!telemetry_stream_staging_fits(staging, 5u + 5u + key_length + 1u + 5u))
+    {
+        staging->truncated = true;
+        telemetry_stream_count(&telemetry_stream_dropped_fields, 1u);
+        return false;
+    }
+
+    /* Ids make the duplicate check one compare per field. An inline key has no id
+       to compare and is not checked; it only happens past the name table's limits. */
+    if (id != 0u)
+    {
+        for (uint32_t index = 0u; index < staging->field_count; ++index)
+        {
+            if (staging->key_ids[index] == id)
+            {
+                telemetry_stream_count(&telemetry_stream_duplicate_keys, 1u);
+                break;
+            }
+        }
+    }
+
+    staging->key_ids[staging->field_count++] = (uint16_t) id;
+    staging->field_start = staging->length;
+
+    telemetry_stream_stage_varint(staging, id);
+    if (id == 0u)
+    {
+        telemetry_stream_count(&telemetry_stream_inline_names, 1u);
+        telemetry_stream_stage_varint(staging, key_length);
+        telemetry_stream_stage_text(staging, key, key_length, false);
+    }
+
+    staging->payload[staging->length++] = (uint8_t) kind;
+    return true;
+}
+
+void kernel_telemetry_stream_write_varint(uint32_t value)
+{
+    TelemetryStreamStaging_t *staging = telemetry_stream_open_staging();
+
+    if (staging)
+        telemetry_stream_stage_varint(staging, value);
+}
+
+void kernel_telemetry_stream_write_text(const char *text, uint32_t length)
+{
+    TelemetryStreamStaging_t *staging = telemetry_stream_open_staging();
+
+    if (!staging)
+        return;
+
+    /* A value that does not fit takes its field with it rather than arriving cut
+       short: a shortened value would read as a different, valid one. */
+    if (!telemetry_stream_staging_fits(staging, telemetry_stream_varint_length(length) + length))
+    {
+        staging->length = staging->field_start;
+        --staging->field_count;
+        staging->truncated = true;
+        telemetry_stream_count(&telemetry_stream_dropped_fields, 1u);
+        return;
+    }
+
+    telemetry_stream_stage_varint(staging, length);
+    telemetry_stream_stage_text(staging, text, length, true);
+}
+
+void kernel_telemetry_stream_end_record(void)
+{
+    uint32_t cpu = 0u;
+    TelemetryStreamStaging_t *staging = telemetry_stream_current_staging(&cpu);
+
+    if (!staging->open)
+        return;
+
+    uint8_t header[2u + 5u];
+    uint32_t header_length = 0u;
+    uint8_t checksum = 0u;
+
+    header[header_length++] = KERNEL_TELEMETRY_STREAM_SYNC;
+    header[header_length++] = KERNEL_TELEMETRY_STREAM_FRAME_RECORD;
+    header_length += telemetry_stream_encode_varint(&header[header_length], staging->length);
+
+    for (uint32_t index = 1u; index < header_length; ++index)
+        checksum = (uint8_t) (checksum + header[index]);
+    for (uint32_t index = 0u; index < staging->length; ++index)
+        checksum = (uint8_t) (checksum + staging->payload[index]);
+
+    telemetry_stream_ring_commit(&telemetry_stream_rings[cpu], header, header_length, staging->payload,
+                                 staging->length, checksum);
+
+    if (staging->truncated)
+        telemetry_stream_count(&telemetry_stream_truncated_records, 1u);
+
+    ++staging->sequence;
+    telemetry_stream_count(&telemetry_stream_records, 1u);
+
+    staging->open = false;
+    telemetry_stream_restore_interrupts(staging->flags);
+}
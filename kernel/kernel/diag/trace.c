@@ -0,0 +1,500 @@
+/**
+ * @file trace.c
+ * @brief Span recording, site registry and Chrome trace export.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#include <kernel/diag/trace.h>
+
+#include <kernel/core/lock.h>
+#include <kernel/cpu/clock.h>
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/diag/telemetry.h>
+#include <kernel/diag/telemetry_stream.h>
+#include <kernel/memory/heap.h>
+
+#define TRACE_CPU_COUNT    CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC
+#define TRACE_EVENT_MASK   (KERNEL_TRACE_EVENTS_PER_CPU - 1u)
+#define TRACE_CACHE_LINE   64u
+
+/* Open addressing on the name's address, for the callers without a site. */
+#define TRACE_NAMED_SLOTS  256u
+#define TRACE_NAMED_MASK   (TRACE_NAMED_SLOTS - 1u)
+
+/* JSON is produced into this much at a time, then handed to the sink. */
+#define TRACE_EXPORT_CHUNK 256u
+
+typedef struct {
+    volatile uint32_t head;
+    KernelTraceEvent_t *events;
+} __attribute__((aligned(TRACE_CACHE_LINE))) TraceRing_t;
+
+volatile bool kernel_trace_recording = false;
+
+static TraceRing_t trace_rings[TRACE_CPU_COUNT];
+static uint32_t trace_ring_count = 0u;
+
+/* Id n names trace_site_names[n - 1]. Id 1 is the overflow site every name past
+   the table's end records under. */
+static const char *trace_site_names[KERNEL_TRACE_MAX_SITES];
+static volatile uint32_t trace_site_count = 0u;
+static const char *volatile trace_named_keys[TRACE_NAMED_SLOTS];
+static volatile uint16_t trace_named_ids[TRACE_NAMED_SLOTS];
+static KernelTicketLock_t trace_site_lock;
+
+static uint64_t trace_enabled_timestamp = 0u;
+static uint32_t trace_enabled_tick = 0u;
+static uint32_t trace_exported = 0u;
+
+static char trace_export_buffer[TRACE_EXPORT_CHUNK];
+static uint32_t trace_export_length = 0u;
+static Serial_t *trace_export_serial = NULL;
+
+/* -- Sites --------------------------------------------------------------- */
+
+/* Caller holds trace_site_lock. */
+static uint16_t trace_site_add(const char *name)
+{
+    if (trace_site_count >= KERNEL_TRACE_MAX_SITES)
+        return 1u;
+
+    trace_site_names[trace_site_count] = name;
+    __atomic_store_n(&trace_site_count, trace_site_count + 1u, __ATOMIC_RELEASE);
+    return (uint16_t) trace_site_count;
+}
+
+static uint16_t trace_named_lookup(const char *name)
+{
+    uint32_t index = ((uint32_t) (uintptr_t) name >> 2) & TRACE_NAMED_MASK;
+
+    for (uint32_t probe = 0u; probe < TRACE_NAMED_SLOTS; ++probe)
+    {
+        const char *key = __atomic_load_n(&trace_named_keys[index], __ATOMIC_ACQUIRE);
+
+        if (key == name)
+            return trace_named_ids[index];
+        if (key == NULL)
+            break;
+
+        index = (index + 1u) & TRACE_NAMED_MASK;
+    }
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&trace_site_lock);
+    uint16_t id = 1u;
+
+    index = ((uint32_t) (uintptr_t) name >> 2) & TRACE_NAMED_MASK;
+    for (uint32_t probe = 0u; probe < TRACE_NAMED_SLOTS; ++probe)
+    {
+        const char *key = trace_named_keys[index];
+
+        if (key == name)
+        {
+            id = trace_named_ids[index];
+            break;
+        }
+
+        if (key == NULL)
+        {
+            /* The id before the key: a reader that finds the key finds its id. */
+            id = trace_site_add(name);
+            trace_named_ids[index] = id;
+            __atomic_store_n(&trace_named_keys[index], name, __ATOMIC_RELEASE);
+            break;
+        }
+
+        index = (index + 1u) & TRACE_NAMED_MASK;
+    }
+
+    kernel_ticket_lock_release_irqrestore(&trace_site_lock, flags);
+    return id;
+}
+
+static uint16_t trace_site_id(KernelTraceSite_t *site)
+{
+    const uint16_t cached = site->id;
+
+    if (cached != 0u)
+        return cached;
+
+    /* Two cores racing on a new site both land in the named table and get the
+       same id back, so whichever write to the cache wins is right. */
+    const uint16_t id = trace_named_lookup(site->name);
+    site->id = id;
+    return id;
+}
+
+/* -- Recording ----------------------------------------------------------- */
+
+static inline uint32_t trace_save_and_disable_interrupts(void)
+{
+    uint32_t flags;
+
+    __asm__ volatile("pushfl\n\tpopl %0\n\tcli" : "=r"(flags)::"memory");
+    return flags;
+}
+
+static inline void trace_restore_interrupts(uint32_t flags)
+{
+    __asm__ volatile("pushl %0\n\tpopfl" ::"r"(flags) : "memory", "cc");
+}
+
+static void trace_record(uint16_t site, uint64_t start, uint16_t argument)
+{
+    const uint64_t end = kernel_trace_read_timestamp();
+
+    /* Interrupts off from reading the slot to the last store: a thread preempted
+       and moved in between would write another core's ring, where the unlocked
+       XADD below is no longer the only writer. */
+    const uint32_t flags = trace_save_and_disable_interrupts();
+    const uint32_t slot = cpu_topology_get_logical_slot();
+    TraceRing_t *ring = (slot < TRACE_CPU_COUNT) ? &trace_rings[slot] : NULL;
+    if (!ring || !ring->events)
+    {
+        trace_restore_interrupts(flags);
+        return;
+    }
+
+    /* Unlocked: only this core writes its ring. */
+    uint32_t index = 1u;
+    __asm__ volatile("xaddl %0, %1" : "+r"(index), "+m"(ring->head)::"memory");
+
+    const uint64_t duration = end - start;
+    KernelTraceEvent_t *event = &ring->events[index & TRACE_EVENT_MASK];
+
+    event->start = start;
+    event->duration = duration > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t) duration;
+    event->site = site;
+    event->argument = argument;
+    trace_restore_interrupts(flags);
+}
+
+void kernel_trace_end(KernelTraceSite_t *site, uint64_t start, uint16_t argument)
+{
+    if (start == 0u || !site)
+        return;
+
+    trace_record(trace_site_id(site), start, argument);
+}
+
+void kernel_trace_end_named(const char *name, uint64_t start, uint16_t argument)
+{
+    if (start == 0u || !name)
+        return;
+
+    trace_record(trace_named_lookup(name), start, argument);
+}
+
+bool kernel_trace_initialize(void)
+{
+    if (trace_ring_count != 0u)
+        return true;
+
+    kernel_ticket_lock_initialize(&trace_site_lock, NULL);
+    trace_site_names[0] = "trace.overflow";
+    trace_site_count = 1u;
+
+    uint32_t cpus = cpu_topology_get_discovered_cpu_count();
+    if (cpus == 0u)
+        cpus = 1u;
+    if (cpus > TRACE_CPU_COUNT)
+        cpus = TRACE_CPU_COUNT;
+
+    for (uint32_t slot = 0u; slot < cpus; ++slot)
+    {
+        KernelTraceEvent_t *events = (KernelTraceEvent_t *) kmalloc(KERNEL_TRACE_EVENTS_PER_CPU *
+                                                                    sizeof(KernelTraceEvent_t));
+        if (!events)
+            break;
+
+        trace_rings[slot].head = 0u;
+        trace_rings[slot].events = events;
+        ++trace_ring_count;
+    }
+
+    return trace_ring_count != 0u;
+}
+
+void kernel_trace_enable(void)
+{
+    if (trace_ring_count == 0u)
+        return;
+
+    for (uint32_t slot = 0u; slot < TRACE_CPU_COUNT; ++slot)
+        trace_rings[slot].head = 0u;
+
+    trace_enabled_timestamp = kernel_trace_read_timestamp();
+    trace_enabled_tick = clock_get_tick_count();
+    __atomic_store_n(&kernel_trace_recording, true, __ATOMIC_RELEASE);
+}
+
+void kernel_trace_disable(void) { __atomic_store_n(&kernel_trace_recording, false, __ATOMIC_RELEASE); }
+
+/* -- Export -------------------------------------------------------------- */
+
+static void trace_export_flush(void)
+{
+    if (trace_export_length == 0u)
+        return;
+
+    if (!kernel_telemetry_stream_write_trace(trace_export_buffer, trace_export_length) && trace_export_serial)
+    {
+        for (uint32_t index = 0u; index < trace_export_length; ++index)
+            serial_write_char(trace_export_serial, trace_export_buffer[index]);
+    }
+
+    trace_export_length = 0u;
+}
+
+static void trace_put_char(char character)
+{
+    if (trace_export_length == TRACE_EXPORT_CHUNK)
+        trace_export_flush();
+
+    trace_export_buffer[trace_export_length++] = character;
+}
+
+static void trace_put_string(const char *text)
+{
+    while (*text)
+        trace_put_char(*text++);
+}
+
+static void trace_put_escaped(const char *text)
+{
+    for (; *text; ++text)
+    {
+        if (*text == '"' || *text == '\\')
+            trace_put_char('\\');
+        trace_put_char(*text);
+    }
+}
+
+static void trace_put_unsigned(uint64_t value)
+{
+    char digits[20];
+    uint32_t count = 0u;
+
+    do
+    {
+        digits[count++] = (char) ('0' + (value % 10u));
+        value /= 10u;
+    } while (value != 0u);
+
+    while (count != 0u)
+        trace_put_char(digits[--count]);
+}
+
+/* Cycles as microseconds with three decimals, the unit trace_event expects. With
+   no rate measured the raw count goes out in thousands, and the header says so. */
+static void trace_put_microseconds(uint64_t cycles, uint32_t cycles_per_microsecond)
+{
+    const uint32_t divisor = cycles_per_microsecond != 0u ? cycles_per_microsecond : 1000u;
+    const uint64_t whole = cycles / divisor;
+    const uint32_t fraction = (uint32_t) (((cycles % divisor) * 1000u) / divisor);
+
+    trace_put_unsigned(whole);
+    trace_put_char('.');
+    trace_put_char((char) ('0' + fraction / 100u));
+    trace_put_char((char) ('0' + (fraction / 10u) % 10u));
+    trace_put_char((char) ('0' + fraction % 10u));
+}
+
+/* Rate over the recording window, against the tick. Needs two ticks at least;
+   a tickless idle that stopped the tick gets 0 and the kilocycle fallback. */
+static uint64_t trace_measure_timestamp_hz(void)
+{
+    const uint32_t ticks = clock_get_tick_count() - trace_enabled_tick;
+    const uint32_t tick_hz = clock_get_tick_hz();
+
+    if (ticks < 2u || tick_hz == 0u)
+        return 0u;
+
+    return ((kernel_trace_read_timestamp() - trace_enabled_timestamp) * tick_hz) / ticks;
+}
+
+static uint32_t trace_ring_retained(const TraceRing_t *ring)
+{
+    return ring->head < KERNEL_TRACE_EVENTS_PER_CPU ? ring->head : KERNEL_TRACE_EVENTS_PER_CPU;
+}
+
+uint32_t kernel_trace_export(Serial_t *serial)
+{
+    kernel_trace_disable();
+
+    const uint64_t timestamp_hz = trace_measure_timestamp_hz();
+    const uint32_t cycles_per_microsecond = (uint32_t) (timestamp_hz / 1000000u);
+    KernelTraceStatistics_t statistics;
+    uint64_t base = ~0ull;
+    uint32_t written = 0u;
+
+    kernel_trace_get_statistics(&statistics);
+
+    for (uint32_t slot = 0u; slot < TRACE_CPU_COUNT; ++slot)
+    {
+        const TraceRing_t *ring = &trace_rings[slot];
+        const uint32_t retained = ring->events ? trace_ring_retained(ring) : 0u;
+
+        for (uint32_t index = ring->head - retained; index != ring->head; ++index)
+        {
+            const uint64_t start = ring->events[index & TRACE_EVENT_MASK].start;
+            if (start < base)
+                base = start;
+        }
+    }
+
+    trace_export_serial = serial;
+    trace_export_length = 0u;
+
+    if (serial && !kernel_telemetry_stream_active())
+        serial_write_string(serial, "\n" KERNEL_TRACE_EXPORT_BEGIN_MARKER "\n");
+
+    trace_put_string("{\"displayTimeUnit\":\"ns\",\"otherData\":{\"tsc_hz\":");
+    trace_put_unsigned(timestamp_hz);
+    trace_put_string(",\"timestamp_unit\":\"");
+    trace_put_string(cycles_per_microsecond != 0u ? "us" : "kcycles");
+    trace_put_string("\",\"overwritten\":");
+    trace_put_unsigned(statistics.overwritten);
+    trace_put_string("},\"traceEvents\":[");
+
+    for (uint32_t slot = 0u; slot < TRACE_CPU_COUNT; ++slot)
+    {
+        const TraceRing_t *ring = &trace_rings[slot];
+
+        /* Rings are allocated from slot 0 up, so the first one is slot 0. */
+        if (!ring->events)
+            break;
+
+        trace_put_string(slot == 0u ? "\n" : ",\n");
+        trace_put_string("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":");
+        trace_put_unsigned(slot);
+        trace_put_string(",\"args\":{\"name\":\"cpu");
+        trace_put_unsigned(slot);
+        trace_put_string("\"}}");
+
+        const uint32_t retained = trace_ring_retained(ring);
+        for (uint32_t index = ring->head - retained; index != ring->head; ++index)
+        {
+            const KernelTraceEvent_t *event = &ring->events[index & TRACE_EVENT_MASK];
+            const uint32_t site = event->site;
+            const uint32_t sites = __atomic_load_n(&trace_site_count, __ATOMIC_ACQUIRE);
+
+            trace_put_string(",\n{\"name\":\"");
+            trace_put_escaped(site != 0u && site <= sites ? trace_site_names[site - 1u] : "trace.unknown");
+            trace_put_string("\",\"ph\":\"X\",\"pid\":0,\"tid\":");
+            trace_put_unsigned(slot);
+            trace_put_string(",\"ts\":");
+            trace_put_microseconds(event->start - base, cycles_per_microsecond);
+            trace_put_string(",\"dur\":");
+            trace_put_microseconds(event->duration, cycles_per_microsecond);
+            trace_put_string(",\"args\":{\"arg\":");
+            trace_put_unsigned(event->argument);
+            trace_put_string("}}");
+            ++written;
+        }
+    }
+
+    trace_put_string("\n]}\n");
+    trace_export_flush();
+
+    if (serial && !kernel_telemetry_stream_active())
+        serial_write_string(serial, KERNEL_TRACE_EXPORT_END_MARKER "\n");
+
+    trace_exported = written;
+    return written;
+}
+
+void kernel_trace_get_statistics(KernelTraceStatistics_t *out)
+{
+    if (!out)
+        return;
+
+    out->rings = trace_ring_count;
+    out->sites = __atomic_load_n(&trace_site_count, __ATOMIC_ACQUIRE);
+    out->events = 0u;
+    out->overwritten = 0u;
+    out->exported = trace_exported;
+
+    for (uint32_t slot = 0u; slot < TRACE_CPU_COUNT; ++slot)
+    {
+        const uint32_t head = trace_rings[slot].head;
+
+        out->events += head;
+        if (head > KERNEL_TRACE_EVENTS_PER_CPU)
+            out->overwritten += head - KERNEL_TRACE_EVENTS_PER_CPU;
+    }
+}
+
+uint32_t kernel_trace_copy_recent(KernelTraceEvent_t *out, uint32_t count)
+{
+    const uint32_t slot = cpu_topology_get_logical_slot();
+
+    if (!out || slot >= TRACE_CPU_COUNT || !trace_rings[slot].events)
+        return 0u;
+
+    const TraceRing_t *ring = &trace_rings[slot];
+    const uint32_t head = ring->head;
+    const uint32_t retained = trace_ring_retained(ring);
+
+    if (count > retained)
+        count = retained;
+
+    for (uint32_t index = 0u; index < count; ++index)
+        out[index] = ring->events[(head - count + index) & TRACE_EVENT_MASK];
+
+    return count;
+}
+
+uint32_t kernel_trace_measure_span_cycles(uint32_t iterations)
+{
+    static KernelTraceSite_t overhead_site = {"trace.overhead", 0u};
+    const bool was_recording = kernel_trace_recording;
+
+    if (iterations == 0u || trace_ring_count == 0u)
+        return 0u;
+
+    /* Same loop twice, recording off then on; only the difference is the tracer's. */
+    uint64_t baseline = 0u;
+    uint64_t traced = 0u;
+
+    for (uint32_t pass = 0u; pass < 2u; ++pass)
+    {
+        __atomic_store_n(&kernel_trace_recording, pass == 1u, __ATOMIC_RELEASE);
+
+        const uint64_t start = kernel_trace_read_timestamp();
+        for (uint32_t index = 0u; index < iterations; ++index)
+        {
+            const uint64_t span = kernel_trace_begin();
+            __asm__ volatile("" ::: "memory");
+            kernel_trace_end(&overhead_site, span, (uint16_t) index);
+        }
+        const uint64_t elapsed = kernel_trace_read_timestamp() - start;
+
+        if (pass == 0u)
+            baseline = elapsed;
+        else
+            traced = elapsed;
+    }
+
+    __atomic_store_n(&kernel_trace_recording, was_recording, __ATOMIC_RELEASE);
+
+    return traced > baseline ? (uint32_t) ((traced - baseline) / iterations) : 0u;
+}
+
+void kernel_trace_report(Serial_t *serial)
+{
+    KernelTraceStatistics_t statistics;
+
+    kernel_trace_get_statistics(&statistics);
+
+    kernel_telemetry_begin_record(serial, "trace");
+    kernel_telemetry_write_boolean("recording", kernel_trace_recording);
+    kernel_telemetry_write_unsigned("rings", statistics.rings);
+    kernel_telemetry_write_unsigned("sites", statistics.sites);
+    kernel_telemetry_write_unsigned("events", statistics.events);
+    kernel_telemetry_write_unsigned("overwritten", statistics.overwritten);
+    kernel_telemetry_write_unsigned("exported", statistics.exported);
+    kernel_telemetry_end_record();
+}
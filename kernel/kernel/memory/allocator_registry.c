@@ -0,0 +1,153 @@
+#include <stddef.h>
+
+#include <kernel/diag/telemetry.h>
+#include <kernel/memory/allocator_registry.h>
+
+static KernelAllocatorEntry_t allocator_registry_entries[KERNEL_ALLOCATOR_REGISTRY_MAX_ENTRIES];
+static uint32_t allocator_registry_count = 0u;
+
+bool kernel_allocator_registry_register(const char *name, KernelAllocatorKind_t kind, const void *instance,
+                                        KernelAllocatorUsageFunction_t usage)
+{
+    if (!name || !instance || !usage || kind >= KERNEL_ALLOCATOR_KIND_COUNT)
+        return false;
+
+    if (allocator_registry_count >= KERNEL_ALLOCATOR_REGISTRY_MAX_ENTRIES)
+        return false;
+
+    KernelAllocatorEntry_t *entry = &allocator_registry_entries[allocator_registry_count];
+
+    entry->name = name;
+    entry->kind = kind;
+    entry->instance = instance;
+    entry->usage = usage;
+
+    ++allocator_registry_count;
+    return true;
+}
+
+void kernel_allocator_registry_unregister(const void *instance)
+{
+    if (!instance)
+        return;
+
+    for (uint32_t index = 0u; index < allocator_registry_count; ++index)
+    {
+        if (allocator_registry_entries[index].instance != instance)
+            continue;
+
+        /* Keep registration order for the report: shift the tail down. */
+        for (uint32_t next = index + 1u; next < allocator_registry_count; ++next)
+            allocator_registry_entries[next - 1u] = allocator_registry_entries[next];
+        --allocator_registry_count;
+        return;
+    }
+}
+
+uint32_t kernel_allocator_registry_get_count(void) { return allocator_registry_count; }
+
+const KernelAllocatorEntry_t *kernel_allocator_registry_get(uint32_t index)
+{
+    if (index >= allocator_registry_count)
+        return NULL;
+
+    return &allocator_registry_entries[index];
+}
+
+void kernel_allocator_registry_get_usage(const KernelAllocatorEntry_t *entry, KernelAllocatorUsage_t *out)
+{
+    if (!out)
+        return;
+
+    *out = (KernelAllocatorUsage_t) {0};
+    if (entry)
+        entry->usage(entry->instance, out);
+}
+
+uint32_t kernel_allocator_registry_sum(KernelAllocatorKind_t kind, KernelAllocatorUsage_t *out)
+{
+    KernelAllocatorUsage_t total = {0};
+    uint32_t instances = 0u;
+
+    for (uint32_t index = 0u; index < allocator_registry_count; ++index)
+    {
+        const KernelAllocatorEntry_t *entry = &allocator_registry_entries[index];
+        KernelAllocatorUsage_t usage;
+
+        if (entry->kind != kind)
+            continue;
+
+        kernel_allocator_registry_get_usage(entry, &usage);
+        total.capacity += usage.capacity;
+        total.used += usage.used;
+        total.peak += usage.peak;
+        total.allocations += usage.allocations;
+        total.failures += usage.failures;
+        total.resets += usage.resets;
+        if (usage.wcet_alloc_cycles > total.wcet_alloc_cycles)
+            total.wcet_alloc_cycles = usage.wcet_alloc_cycles;
+        if (usage.wcet_release_cycles > total.wcet_release_cycles)
+            total.wcet_release_cycles = usage.wcet_release_cycles;
+        ++instances;
+    }
+
+    if (out)
+        *out = total;
+    return instances;
+}
+
+uint32_t kernel_allocator_registry_get_total_failures(void)
+{
+    uint32_t total = 0u;
+
+    for (uint32_t index = 0u; index < allocator_registry_count; ++index)
+    {
+        KernelAllocatorUsage_t usage;
+
+        kernel_allocator_registry_get_usage(&allocator_registry_entries[index], &usage);
+        total += usage.failures;
+    }
+
+    return total;
+}
+
+const char *kernel_allocator_kind_name(KernelAllocatorKind_t kind)
+{
+    switch (kind)
+    {
+    case KERNEL_ALLOCATOR_KIND_POOL: return "pool";
+    case KERNEL_ALLOCATOR_KIND_FRAME_ARENA: return "frame_arena";
+    case KERNEL_ALLOCATOR_KIND_STACK: return "stack";
+    case KERNEL_ALLOCATOR_KIND_TLSF: return "tlsf";
+    case KERNEL_ALLOCATOR_KIND_COUNT:
+    default: return "unknown";
+    }
+}
+
+void kernel_allocator_registry_report(Serial_t *serial)
+{
+    if (!serial)
+        return;
+
+    for (uint32_t index = 0u; index < allocator_registry_count; ++index)
+    {
+        const KernelAllocatorEntry_t *entry = &allocator_registry_entries[index];
+        KernelAllocatorUsage_t usage;
+
+        kernel_allocator_registry_get_usage(entry, &usage);
+
+        /* One record per instance, the name a field value, as for the queues. */
+        kernel_telemetry_begin_record(serial, "allocator");
+        kernel_telemetry_write_text("name", entry->name);
+        kernel_telemetry_write_text("kind", kernel_allocator_kind_name(entry->kind));
+        kernel_telemetry_write_unsigned("capacity", usage.capacity);
+        kernel_telemetry_write_unsigned("used", usage.used);
+        kernel_telemetry_write_unsigned("peak", usage.peak);
+        kernel_telemetry_write_unsigned("allocations", usage.allocations);
+        kernel_telemetry_write_unsigned("failures", usage.failures);
+        kernel_telemetry_write_unsigned("resets", usage.resets);
+        kernel_telemetry_write_unsigned("wcet_alloc_cycles", usage.wcet_alloc_cycles);
+        kernel_telemetry_write_unsigned("wcet_release_cycles", usage.wcet_release_cycles);
+        kernel_telemetry_end_record();
+    }
+}
@@ -33,11 +33,66 @@ bool kernel_backpressure_register(const char *name, KernelBackpressurePolicy_t p
     queue->policy = policy;
     queue->capacity_items = capacity_items;
     queue->drop_count = drop_count;
+    queue->instance_drop_count = NULL;
+    queue->instance = NULL;
 
     ++backpressure_queue_count;
     return true;
 }
 
+bool kernel_backpressure_register_instance(const char *name, KernelBackpressurePolicy_t policy,
+                                           uint32_t capacity_items,
+                                           KernelBackpressureInstanceDropCountFunction_t drop_count,
+                                           const void *instance)
+{
+    if (!name || !drop_count || !instance)
+        return false;
+
+    if (backpressure_queue_count >= KERNEL_BACKPRESSURE_MAX_QUEUES)
+        return false;
+
+    KernelBackpressureQueue_t *queue = &backpressure_queues[backpressure_queue_count];
+
+    queue->name = name;
+    queue->policy = policy;
+    queue->capacity_items = capacity_items;
+    queue->drop_count = NULL;
+    queue->instance_drop_count = drop_count;
+    queue->instance = instance;
+
+    ++backpressure_queue_count;
+    return true;
+}
+
+void kernel_backpressure_unregister_instance(const void *instance)
+{
+    if (!instance)
+        return;
+
+    for (uint32_t index = 0u; index < backpressure_queue_count; ++index)
+    {
+        if (backpressure_queues[index].instance != instance)
+            continue;
+
+        /* Keep registration order for the report: shift the tail down. */
+        for (uint32_t next = index + 1u; next < backpressure_queue_count; ++next)
+            backpressure_queues[next - 1u] = backpressure_queues[next];
+        --backpressure_queue_count;
+        return;
+    }
+}
+
+uint32_t kernel_backpressure_get_queue_drop_count(const KernelBackpressureQueue_t *queue)
+{
+    if (!queue)
+        return 0u;
+
+    if (queue->instance_drop_count)
+        return queue->instance_drop_count(queue->instance);
+
+    return queue->drop_count();
+}
+
 uint32_t kernel_backpressure_get_queue_count(void) { return backpressure_queue_count; }
 
 const KernelBackpressureQueue_t *kernel_backpressure_get_queue(uint32_t index)
@@ -53,7 +108,7 @@ uint32_t kernel_backpressure_get_total_drop_count(void)
     uint32_t total = 0u;
 
     for (uint32_t index = 0u; index < backpressure_queue_count; ++index)
-        total += backpressure_queues[index].drop_count();
+        total += kernel_backpressure_get_queue_drop_count(&backpressure_queues[index]);
 
     return total;
 }
@@ -67,7 +122,7 @@ uint32_t kernel_backpressure_get_intolerant_drop_count(void)
         if (backpressure_queues[index].policy != KERNEL_BACKPRESSURE_POLICY_DROP_CORRUPTS)
             continue;
 
-        total += backpressure_queues[index].drop_count();
+        total += kernel_backpressure_get_queue_drop_count(&backpressure_queues[index]);
     }
 
     return total;
@@ -90,7 +145,7 @@ void kernel_backpressure_report(Serial_t *serial)
         kernel_telemetry_write_text("queue", queue->name);
         kernel_telemetry_write_text("policy", backpressure_policy_name(queue->policy));
         kernel_telemetry_write_unsigned("capacity", queue->capacity_items);
-        kernel_telemetry_write_unsigned("dropped", queue->drop_count());
+        kernel_telemetry_write_unsigned("dropped", kernel_backpressure_get_queue_drop_count(queue));
         kernel_telemetry_end_record();
     }
 }
@@ -0,0 +1,351 @@
+/**
+ * @file dma.c
+ * @brief Physically contiguous DMA buffers carved from buddy blocks.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#include <kernel/memory/dma.h>
+
+#include <kernel/core/lock.h>
+#include <kernel/cpu/pmm.h>
+#include <kernel/cpu/tlb_shootdown.h>
+#include <kernel/diag/telemetry.h>
+#include <kernel/memory/vmm.h>
+
+#include <stddef.h>
+#include <string.h>
+
+/* The cache is filled by splitting one block of order + DMA_CACHE_DEPTH_SHIFT. */
+#define DMA_CACHE_DEPTH_SHIFT 2u
+_Static_assert((1u << DMA_CACHE_DEPTH_SHIFT) == KERNEL_DMA_CACHE_DEPTH, "cache depth must be 1 << shift");
+
+#define DMA_CACHE_ORDERS (KERNEL_DMA_CACHE_MAX_ORDER + 1u)
+
+typedef struct DmaRecord {
+    uint32_t virtual_address;
+    uint32_t physical_address;
+    uint32_t page_count; /* 0 marks a free slot */
+} DmaRecord_t;
+
+static DmaRecord_t dma_records[KERNEL_DMA_MAX_BUFFERS];
+static uint32_t dma_cache[DMA_CACHE_ORDERS][KERNEL_DMA_CACHE_DEPTH];
+static uint32_t dma_cache_count[DMA_CACHE_ORDERS];
+static KernelDmaStatistics_t dma_statistics;
+static KernelLockStatistics_t dma_lock_statistics;
+static KernelTicketLock_t dma_lock;
+static bool dma_initialized = false;
+
+static uint8_t dma_order_for_pages(uint32_t page_count)
+{
+    uint8_t order = 0u;
+    while ((1u << order) < page_count)
+        ++order;
+    return order;
+}
+
+/* Caller holds dma_lock. */
+static uint32_t dma_take_block(uint8_t order)
+{
+    if (order < DMA_CACHE_ORDERS && dma_cache_count[order] != 0u)
+    {
+        ++dma_statistics.cache_hits;
+        --dma_statistics.cached_blocks;
+        return dma_cache[order][--dma_cache_count[order]];
+    }
+
+    ++dma_statistics.cache_misses;
+    return physical_memory_manager_page_frame_allocate_order(order);
+}
+
+/* Caller holds dma_lock. */
+static void dma_give_block(uint32_t physical_address, uint8_t order)
+{
+    if (order < DMA_CACHE_ORDERS && dma_cache_count[order] < KERNEL_DMA_CACHE_DEPTH)
+    {
+        dma_cache[order][dma_cache_count[order]++] = physical_address;
+        ++dma_statistics.cached_blocks;
+        return;
+    }
+
+    physical_memory_manager_page_frame_free_order(physical_address, order);
+}
+
+/**
+ * @brief Give back pages [first_page, 1 << order) of a block, as the aligned
+ *        blocks the buddy would have split them into.
+ *
+ * Caller holds dma_lock.
+ */
+static void dma_trim_block(uint32_t physical_address, uint8_t order, uint32_t first_page)
+{
+    const uint32_t block_pages = 1u << order;
+    uint32_t page = first_page;
+
+    while (page < block_pages)
+    {
+        /* The largest block starting at `page` is its lowest set bit. */
+        const uint32_t piece_pages = page & (0u - page);
+        dma_give_block(physical_address + page * PAGE_SIZE, dma_order_for_pages(piece_pages));
+        page += piece_pages;
+    }
+}
+
+/**
+ * @brief Give back pages [0, page_count) of a buffer, largest pieces first.
+ *
+ * The base is aligned to at least the next power of two of @p page_count, so
+ * every piece starts on a multiple of its own size. Caller holds dma_lock.
+ */
+static void dma_release_pages(uint32_t physical_address, uint32_t page_count)
+{
+    uint32_t page = 0u;
+
+    for (int32_t bit = 31; bit >= 0; --bit)
+    {
+        const uint32_t piece_pages = 1u << (uint32_t) bit;
+        if ((page_count & piece_pages) == 0u)
+            continue;
+        dma_give_block(physical_address + page * PAGE_SIZE, (uint8_t) bit);
+        page += piece_pages;
+    }
+}
+
+static void dma_unmap(uint32_t virtual_address, uint32_t mapped_pages, uint32_t reserved_pages)
+{
+    tlb_shootdown_begin();
+    for (uint32_t page = 0u; page < mapped_pages; ++page)
+        (void) paging_unmap_page(virtual_address + page * PAGE_SIZE);
+    tlb_shootdown_end();
+
+    /* Nothing is mapped any more, so this only returns the reservation. */
+    kernel_vmm_free_pages((void *) virtual_address, reserved_pages);
+}
+
+static uint32_t dma_map(uint32_t physical_address, uint32_t page_count, PagingMemoryType_t type)
+{
+    void *reserved = kernel_vmm_reserve_pages(page_count);
+    if (reserved == NULL)
+        return 0u;
+
+    const uint32_t virtual_address = (uint32_t) (uintptr_t) reserved;
+    const PageDirectoryEntry_t pde_flags = {.present = 1u, .read_write = 1u};
+    PageTableEntry_t pte_flags = {.present = 1u, .read_write = 1u};
+    (void) paging_encode_memory_type(&pte_flags, type);
+
+    for (uint32_t page = 0u; page < page_count; ++page)
+    {
+        if (!paging_map_page(virtual_address + page * PAGE_SIZE, physical_address + page * PAGE_SIZE, pde_flags,
+                             pte_flags))
+        {
+            dma_unmap(virtual_address, page, page_count);
+            return 0u;
+        }
+    }
+
+    return virtual_address;
+}
+
+/* Caller holds dma_lock. */
+static DmaRecord_t *dma_claim_record(void)
+{
+    for (uint32_t index = 0u; index < KERNEL_DMA_MAX_BUFFERS; ++index)
+    {
+        if (dma_records[index].page_count == 0u)
+            return &dma_records[index];
+    }
+    return NULL;
+}
+
+/* Caller holds dma_lock. */
+static DmaRecord_t *dma_find_record(uint32_t virtual_address, bool exact)
+{
+    for (uint32_t index = 0u; index < KERNEL_DMA_MAX_BUFFERS; ++index)
+    {
+        DmaRecord_t *record = &dma_records[index];
+        if (record->page_count == 0u)
+            continue;
+        if (exact ? (virtual_address == record->virtual_address)
+                  : (virtual_address - record->virtual_address < record->page_count * PAGE_SIZE))
+            return record;
+    }
+    return NULL;
+}
+
+bool kernel_dma_initialize(void)
+{
+    if (dma_initialized)
+        return true;
+
+    memset(dma_records, 0, sizeof(dma_records));
+    memset(dma_cache_count, 0, sizeof(dma_cache_count));
+    memset(&dma_statistics, 0, sizeof(dma_statistics));
+    kernel_ticket_lock_initialize(&dma_lock, &dma_lock_statistics);
+    kernel_lock_statistics_register(&dma_lock_statistics, "dma");
+
+    for (uint8_t order = 0u; order < DMA_CACHE_ORDERS; ++order)
+    {
+        /* One larger block, split in place: the cached blocks of an order are
+           neighbours, so giving them back merges them again. */
+        const uint32_t block = physical_memory_manager_page_frame_allocate_order(order + DMA_CACHE_DEPTH_SHIFT);
+        for (uint32_t slot = 0u; slot < KERNEL_DMA_CACHE_DEPTH; ++slot)
+        {
+            const uint32_t physical_address = block ? block + ((slot << order) * PAGE_SIZE)
+                                                    : physical_memory_manager_page_frame_allocate_order(order);
+            if (physical_address == 0u)
+                break;
+            dma_cache[order][dma_cache_count[order]++] = physical_address;
+            ++dma_statistics.cached_blocks;
+        }
+    }
+
+    dma_initialized = true;
+    return true;
+}
+
+bool kernel_dma_alloc(uint32_t size, uint32_t alignment, uint32_t boundary, PagingMemoryType_t type,
+                      KernelDmaBuffer_t *out)
+{
+    if (out == NULL)
+        return false;
+    *out = (KernelDmaBuffer_t){0};
+
+    const uint32_t page_count = (size + PAGE_SIZE - 1u) / PAGE_SIZE;
+    const uint32_t alignment_pages = (alignment + PAGE_SIZE - 1u) / PAGE_SIZE;
+    const bool constraints_ok = dma_initialized && size != 0u && page_count != 0u &&
+                                (alignment & (alignment - 1u)) == 0u && (boundary & (boundary - 1u)) == 0u &&
+                                (boundary == 0u || page_count * PAGE_SIZE <= boundary);
+
+    /* A buddy block is aligned to its size. Taking one of at least the larger of
+       the request and the alignment meets the alignment; a request no larger
+       than the boundary then sits in one boundary-sized window. */
+    const uint8_t order = dma_order_for_pages(alignment_pages > page_count ? alignment_pages : page_count);
+
+    uint32_t flags = kernel_ticket_lock_acquire_irqsave(&dma_lock);
+    if (!constraints_ok)
+    {
+        ++dma_statistics.failures;
+        kernel_ticket_lock_release_irqrestore(&dma_lock, flags);
+        return false;
+    }
+
+    const uint32_t physical_address = dma_take_block(order);
+    if (physical_address == 0u)
+    {
+        ++dma_statistics.failures;
+        kernel_ticket_lock_release_irqrestore(&dma_lock, flags);
+        return false;
+    }
+
+    dma_trim_block(physical_address, order, page_count);
+    dma_statistics.trimmed_pages += (1u << order) - page_count;
+    kernel_ticket_lock_release_irqrestore(&dma_lock, flags);
+
+    const uint32_t virtual_address = dma_map(physical_address, page_count, type);
+
+    flags = kernel_ticket_lock_acquire_irqsave(&dma_lock);
+    DmaRecord_t *record = virtual_address ? dma_claim_record() : NULL;
+    if (record == NULL)
+    {
+        dma_release_pages(physical_address, page_count);
+        ++dma_statistics.failures;
+        kernel_ticket_lock_release_irqrestore(&dma_lock, flags);
+        if (virtual_address != 0u)
+            dma_unmap(virtual_address, page_count, page_count);
+        return false;
+    }
+
+    *record = (DmaRecord_t){virtual_address, physical_address, page_count};
+    ++dma_statistics.allocations;
+    ++dma_statistics.live_buffers;
+    dma_statistics.live_pages += page_count;
+    if (order > dma_statistics.largest_order)
+        dma_statistics.largest_order = order;
+    kernel_ticket_lock_release_irqrestore(&dma_lock, flags);
+
+    memset((void *) virtual_address, 0, page_count * PAGE_SIZE);
+
+    out->virtual_address = (void *) virtual_address;
+    out->physical_address = physical_address;
+    out->size = page_count * PAGE_SIZE;
+    return true;
+}
+
+bool kernel_dma_free(void *virtual_address)
+{
+    if (!dma_initialized || virtual_address == NULL)
+        return false;
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&dma_lock);
+    DmaRecord_t *record = dma_find_record((uint32_t) (uintptr_t) virtual_address, true);
+    if (record == NULL)
+    {
+        kernel_ticket_lock_release_irqrestore(&dma_lock, flags);
+        return false;
+    }
+
+    const DmaRecord_t released = *record;
+    record->page_count = 0u;
+    kernel_ticket_lock_release_irqrestore(&dma_lock, flags);
+
+    /* Unmapped before the frames go back, so no stale translation can reach a
+       page that has already been handed to someone else. */
+    dma_unmap(released.virtual_address, released.page_count, released.page_count);
+
+    const uint32_t relock = kernel_ticket_lock_acquire_irqsave(&dma_lock);
+    dma_release_pages(released.physical_address, released.page_count);
+    ++dma_statistics.frees;
+    --dma_statistics.live_buffers;
+    dma_statistics.live_pages -= released.page_count;
+    kernel_ticket_lock_release_irqrestore(&dma_lock, relock);
+    return true;
+}
+
+bool kernel_dma_find(const void *virtual_address, KernelDmaBuffer_t *out)
+{
+    if (!dma_initialized || virtual_address == NULL)
+        return false;
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&dma_lock);
+    const DmaRecord_t *record = dma_find_record((uint32_t) (uintptr_t) virtual_address, false);
+    if (record != NULL && out != NULL)
+    {
+        out->virtual_address = (void *) record->virtual_address;
+        out->physical_address = record->physical_address;
+        out->size = record->page_count * PAGE_SIZE;
+    }
+    kernel_ticket_lock_release_irqrestore(&dma_lock, flags);
+    return record != NULL;
+}
+
+void kernel_dma_get_statistics(KernelDmaStatistics_t *out)
+{
+    if (out == NULL)
+        return;
+
+    const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&dma_lock);
+    *out = dma_statistics;
+    kernel_ticket_lock_release_irqrestore(&dma_lock, flags);
+}
+
+void kernel_dma_report(Serial_t *serial_port)
+{
+    KernelDmaStatistics_t statistics;
+    kernel_dma_get_statistics(&statistics);
+
+    kernel_telemetry_begin_record(serial_port, "dma");
+    kernel_telemetry_write_unsigned("allocations", statistics.allocations);
+    kernel_telemetry_write_unsigned("frees", statistics.frees);
+    kernel_telemetry_write_unsigned("failures", statistics.failures);
+    kernel_telemetry_write_unsigned("live_buffers", statistics.live_buffers);
+    kernel_telemetry_write_unsigned("live_pages", statistics.live_pages);
+    kernel_telemetry_write_unsigned("cache_hits", statistics.cache_hits);
+    kernel_telemetry_write_unsigned("cache_misses", statistics.cache_misses);
+    kernel_telemetry_write_unsigned("cached_blocks", statistics.cached_blocks);
+    kernel_telemetry_write_unsigned("trimmed_pages", statistics.trimmed_pages);
+    kernel_telemetry_write_unsigned("largest_order", statistics.largest_order);
+    kernel_telemetry_write_unsigned("pmm_fragmentation", physical_memory_manager_get_fragmentation_ratio());
+    kernel_telemetry_end_record();
+}
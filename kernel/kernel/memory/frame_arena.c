@@ -1,20 +1,20 @@
 #define __LPL_KERNEL__
 #include <kernel/config.h>
+#include <kernel/cpu/cpu_topology.h>
 #include <kernel/memory/frame_arena.h>
 #include <kernel/memory/heap.h>
 
-static uint8_t *kernel_frame_arena_base = NULL;
-static uint32_t kernel_frame_arena_capacity = 0u;
-static uint32_t kernel_frame_arena_offset = 0u;
-static uint32_t kernel_frame_arena_peak = 0u;
-static uint32_t kernel_frame_arena_reset_count = 0u;
-static uint32_t kernel_frame_arena_failed_alloc_count = 0u;
-static uint32_t kernel_frame_arena_budget = 0u;
-static uint32_t kernel_frame_arena_budget_exceeded_count = 0u;
-static uint32_t kernel_frame_arena_wcet_alloc = 0u;
-static uint32_t kernel_frame_arena_wcet_reset = 0u;
+#define KERNEL_FRAME_ARENA_PER_CPU_NAME_LENGTH 20u
+
+static KernelFrameArena_t kernel_frame_arena_default;
 static bool kernel_frame_arena_initialized = false;
 
+static KernelFrameArena_t kernel_frame_arena_per_cpu[CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC];
+static char kernel_frame_arena_per_cpu_names[CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC]
+                                            [KERNEL_FRAME_ARENA_PER_CPU_NAME_LENGTH];
+static uint32_t kernel_frame_arena_per_cpu_count = 0u;
+static volatile uint32_t kernel_frame_arena_epoch = 0u;
+
 static inline uint32_t frame_arena_rdtsc_low(void)
 {
 #if defined(__i386__) || defined(__x86_64__)
@@ -26,6 +26,18 @@ static inline uint32_t frame_arena_rdtsc_low(void)
 #endif
 }
 
+static inline uint32_t frame_arena_irq_save(void)
+{
+    uint32_t eflags;
+    __asm__ volatile("pushf\n\tpop %0\n\tcli" : "=r"(eflags)::"memory");
+    return eflags;
+}
+
+static inline void frame_arena_irq_restore(uint32_t eflags)
+{
+    __asm__ volatile("push %0\n\tpopf" ::"r"(eflags) : "memory", "cc");
+}
+
 static uint32_t kernel_frame_arena_align_up(uint32_t value, uint32_t align)
 {
     if (align == 0u)
@@ -33,12 +45,14 @@ static uint32_t kernel_frame_arena_align_up(uint32_t value, uint32_t align)
     return (value + (align - 1u)) & ~(align - 1u);
 }
 
-bool kernel_frame_arena_initialize(uint32_t capacity_bytes)
+static void kernel_frame_arena_registry_usage(const void *instance, KernelAllocatorUsage_t *out)
 {
-    if (kernel_frame_arena_initialized)
-        return true;
+    kernel_frame_arena_get_usage((const KernelFrameArena_t *) instance, out);
+}
 
-    if (capacity_bytes == 0u)
+bool kernel_frame_arena_init(KernelFrameArena_t *arena, const char *name, uint32_t capacity_bytes)
+{
+    if (!arena || !name || capacity_bytes == 0u || capacity_bytes > 0xFFFFFFF0u)
         return false;
 
     uint32_t aligned_capacity = kernel_frame_arena_align_up(capacity_bytes, 16u);
@@ -47,39 +61,76 @@ bool kernel_frame_arena_initialize(uint32_t capacity_bytes)
     if (!backing)
         return false;
 
-    kernel_frame_arena_base = (uint8_t *) backing;
-    kernel_frame_arena_capacity = aligned_capacity;
-    kernel_frame_arena_offset = 0u;
-    kernel_frame_arena_peak = 0u;
-    kernel_frame_arena_reset_count = 0u;
-    kernel_frame_arena_failed_alloc_count = 0u;
-    kernel_frame_arena_budget = 0u;
-    kernel_frame_arena_budget_exceeded_count = 0u;
-    kernel_frame_arena_wcet_alloc = 0u;
-    kernel_frame_arena_wcet_reset = 0u;
-    kernel_frame_arena_initialized = true;
+    arena->base = (uint8_t *) backing;
+    arena->name = name;
+    arena->capacity = aligned_capacity;
+    arena->offset = 0u;
+    arena->peak = 0u;
+    arena->reset_count = 0u;
+    arena->allocations = 0u;
+    arena->failed_alloc_count = 0u;
+    arena->budget = 0u;
+    arena->budget_exceeded_count = 0u;
+    arena->wcet_alloc = 0u;
+    arena->wcet_reset = 0u;
+    arena->epoch = kernel_frame_arena_epoch;
+    arena->owns_arena = false;
 
 #ifdef LPL_KERNEL_DEBUG_POISON
-    for (uint32_t i = 0u; i < kernel_frame_arena_capacity; ++i)
-        kernel_frame_arena_base[i] = 0xAA;
+    for (uint32_t i = 0u; i < arena->capacity; ++i)
+        arena->base[i] = 0xAA;
 #endif
 
+    kernel_allocator_registry_register(name, KERNEL_ALLOCATOR_KIND_FRAME_ARENA, arena,
+                                       kernel_frame_arena_registry_usage);
     return true;
 }
 
-void *kernel_frame_arena_alloc(uint32_t size, uint32_t align)
+KernelFrameArena_t *kernel_frame_arena_create(const char *name, uint32_t capacity_bytes)
+{
+    KernelFrameArena_t *arena = (KernelFrameArena_t *) kmalloc(sizeof(KernelFrameArena_t));
+
+    if (!arena)
+        return NULL;
+
+    if (!kernel_frame_arena_init(arena, name, capacity_bytes))
+    {
+        kfree(arena);
+        return NULL;
+    }
+
+    arena->owns_arena = true;
+    return arena;
+}
+
+void kernel_frame_arena_destroy(KernelFrameArena_t *arena)
+{
+    if (!arena || !arena->base)
+        return;
+
+    kernel_allocator_registry_unregister(arena);
+    kfree(arena->base);
+    arena->base = NULL;
+    arena->capacity = 0u;
+    arena->offset = 0u;
+
+    if (arena->owns_arena)
+        kfree(arena);
+}
+
+void *kernel_frame_arena_allocate(KernelFrameArena_t *arena, uint32_t size, uint32_t align)
 {
     uint32_t t0 = frame_arena_rdtsc_low();
 
-    if (!kernel_frame_arena_initialized || size == 0u)
+    if (!arena || !arena->base || size == 0u)
         return NULL;
 
     uint32_t effective_align = (align == 0u) ? 8u : align;
-    uint32_t aligned_offset = kernel_frame_arena_align_up(kernel_frame_arena_offset, effective_align);
+    uint32_t aligned_offset = kernel_frame_arena_align_up(arena->offset, effective_align);
 
-    if (aligned_offset > kernel_frame_arena_capacity || size > (kernel_frame_arena_capacity - aligned_offset))
+    if (aligned_offset > arena->capacity || size > (arena->capacity - aligned_offset))
     {
-        ++kernel_frame_arena_failed_alloc_count;
+        ++arena->failed_alloc_count;
         return NULL;
     }
 
@@ -88,68 +139,208 @@ void *kernel_frame_arena_alloc(uint32_t size, uint32_t align)
     real_size += sizeof(uint32_t);
 #endif
 
-    if (kernel_frame_arena_budget > 0u && (aligned_offset + real_size) > kernel_frame_arena_budget)
+    if (arena->budget > 0u && (aligned_offset + real_size) > arena->budget)
     {
-        ++kernel_frame_arena_budget_exceeded_count;
-        ++kernel_frame_arena_failed_alloc_count;
+        ++arena->budget_exceeded_count;
+        ++arena->failed_alloc_count;
         return NULL;
     }
 
-    void *result = kernel_frame_arena_base + aligned_offset;
+    void *result = arena->base + aligned_offset;
 
 #ifdef LPL_KERNEL_DEBUG_POISON
     *((uint32_t *) ((uint8_t *) result + size)) = 0xFBADBEEFu;
 #endif
 
-    kernel_frame_arena_offset = aligned_offset + real_size;
-    if (kernel_frame_arena_offset > kernel_frame_arena_peak)
-        kernel_frame_arena_peak = kernel_frame_arena_offset;
+    arena->offset = aligned_offset + real_size;
+    if (arena->offset > arena->peak)
+        arena->peak = arena->offset;
+    ++arena->allocations;
 
     uint32_t t1 = frame_arena_rdtsc_low();
     uint32_t delta = t1 - t0;
-    if (delta > kernel_frame_arena_wcet_alloc)
-        kernel_frame_arena_wcet_alloc = delta;
+    if (delta > arena->wcet_alloc)
+        arena->wcet_alloc = delta;
 
     return result;
 }
 
-void kernel_frame_arena_reset(void)
+void kernel_frame_arena_clear(KernelFrameArena_t *arena)
 {
     uint32_t t0 = frame_arena_rdtsc_low();
 
-    if (!kernel_frame_arena_initialized)
+    if (!arena || !arena->base)
         return;
 
 #ifdef LPL_KERNEL_DEBUG_POISON
-    for (uint32_t i = 0u; i < kernel_frame_arena_offset; ++i)
-        kernel_frame_arena_base[i] = 0xAA;
+    for (uint32_t i = 0u; i < arena->offset; ++i)
+        arena->base[i] = 0xAA;
 #endif
 
-    kernel_frame_arena_offset = 0u;
-    ++kernel_frame_arena_reset_count;
+    arena->offset = 0u;
+    ++arena->reset_count;
 
     uint32_t t1 = frame_arena_rdtsc_low();
     uint32_t delta = t1 - t0;
-    if (delta > kernel_frame_arena_wcet_reset)
-        kernel_frame_arena_wcet_reset = delta;
+    if (delta > arena->wcet_reset)
+        arena->wcet_reset = delta;
+}
+
+void kernel_frame_arena_set_budget(KernelFrameArena_t *arena, uint32_t budget_bytes)
+{
+    if (arena)
+        arena->budget = budget_bytes;
+}
+
+void kernel_frame_arena_get_usage(const KernelFrameArena_t *arena, KernelAllocatorUsage_t *out)
+{
+    if (!out)
+        return;
+
+    *out = (KernelAllocatorUsage_t) {0};
+    if (!arena || !arena->base)
+        return;
+
+    out->capacity = arena->capacity;
+    out->used = arena->offset;
+    out->peak = arena->peak;
+    out->allocations = arena->allocations;
+    out->failures = arena->failed_alloc_count;
+    out->resets = arena->reset_count;
+    out->wcet_alloc_cycles = arena->wcet_alloc;
+    out->wcet_release_cycles = arena->wcet_reset;
+}
+
+static void kernel_frame_arena_format_cpu_name(char *out, uint32_t slot)
+{
+    static const char prefix[] = "frame_arena_cpu";
+    char digits[10];
+    uint32_t length = 0u;
+    uint32_t position = 0u;
+
+    do
+    {
+        digits[length++] = (char) ('0' + (slot % 10u));
+        slot /= 10u;
+    } while (slot != 0u && length < sizeof(digits));
+
+    for (uint32_t i = 0u; prefix[i] != '\0'; ++i)
+        out[position++] = prefix[i];
+    while (length > 0u && position + 1u < KERNEL_FRAME_ARENA_PER_CPU_NAME_LENGTH)
+        out[position++] = digits[--length];
+    out[position] = '\0';
+}
+
+bool kernel_frame_arena_per_cpu_initialize(uint32_t capacity_bytes)
+{
+    if (kernel_frame_arena_per_cpu_count != 0u)
+        return true;
+
+    uint32_t cpu_count = cpu_topology_get_discovered_cpu_count();
+    if (cpu_count == 0u)
+        cpu_count = 1u;
+    if (cpu_count > CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC)
+        cpu_count = CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC;
+
+    for (uint32_t slot = 0u; slot < cpu_count; ++slot)
+    {
+        kernel_frame_arena_format_cpu_name(kernel_frame_arena_per_cpu_names[slot], slot);
+        if (!kernel_frame_arena_init(&kernel_frame_arena_per_cpu[slot], kernel_frame_arena_per_cpu_names[slot],
+                                     capacity_bytes))
+        {
+            for (uint32_t undo = 0u; undo < slot; ++undo)
+                kernel_frame_arena_destroy(&kernel_frame_arena_per_cpu[undo]);
+            return false;
+        }
+    }
+
+    /* Published last: kernel_frame_arena_local() treats a slot below the count as ready. */
+    __atomic_store_n(&kernel_frame_arena_per_cpu_count, cpu_count, __ATOMIC_RELEASE);
+    return true;
+}
+
+void kernel_frame_arena_tick(void) { __atomic_add_fetch(&kernel_frame_arena_epoch, 1u, __ATOMIC_RELAXED); }
+
+KernelFrameArena_t *kernel_frame_arena_local(void)
+{
+    uint32_t count = __atomic_load_n(&kernel_frame_arena_per_cpu_count, __ATOMIC_ACQUIRE);
+    uint32_t slot = cpu_topology_get_logical_slot();
+
+    if (slot >= count)
+        return NULL;
+
+    KernelFrameArena_t *arena = &kernel_frame_arena_per_cpu[slot];
+    uint32_t epoch = __atomic_load_n(&kernel_frame_arena_epoch, __ATOMIC_RELAXED);
+
+    /* The tick only moves the epoch; the owner pays for the clear, on its own CPU. */
+    if (arena->epoch != epoch)
+    {
+        kernel_frame_arena_clear(arena);
+        arena->epoch = epoch;
+    }
+
+    return arena;
+}
+
+void *kernel_frame_arena_local_alloc(uint32_t size, uint32_t align)
+{
+    uint32_t eflags = frame_arena_irq_save();
+    KernelFrameArena_t *arena = kernel_frame_arena_local();
+    void *result = arena ? kernel_frame_arena_allocate(arena, size, align) : NULL;
+
+    frame_arena_irq_restore(eflags);
+    return result;
+}
+
+KernelFrameArena_t *kernel_frame_arena_get_default(void)
+{
+    return kernel_frame_arena_initialized ? &kernel_frame_arena_default : NULL;
+}
+
+bool kernel_frame_arena_initialize(uint32_t capacity_bytes)
+{
+    if (kernel_frame_arena_initialized)
+        return true;
+
+    if (!kernel_frame_arena_init(&kernel_frame_arena_default, "kernel_frame_arena", capacity_bytes))
+        return false;
+
+    kernel_frame_arena_initialized = true;
+    return true;
+}
+
+void *kernel_frame_arena_alloc(uint32_t size, uint32_t align)
+{
+    if (!kernel_frame_arena_initialized)
+        return NULL;
+    return kernel_frame_arena_allocate(&kernel_frame_arena_default, size, align);
+}
+
+void kernel_frame_arena_reset(void)
+{
+    if (kernel_frame_arena_initialized)
+        kernel_frame_arena_clear(&kernel_frame_arena_default);
 }
 
 bool kernel_frame_arena_is_initialized(void) { return kernel_frame_arena_initialized; }
 
-uint32_t kernel_frame_arena_get_capacity_bytes(void) { return kernel_frame_arena_capacity; }
+uint32_t kernel_frame_arena_get_capacity_bytes(void) { return kernel_frame_arena_default.capacity; }
 
-uint32_t kernel_frame_arena_get_used_bytes(void) { return kernel_frame_arena_offset; }
+uint32_t kernel_frame_arena_get_used_bytes(void) { return kernel_frame_arena_default.offset; }
 
-uint32_t kernel_frame_arena_get_peak_used_bytes(void) { return kernel_frame_arena_peak; }
+uint32_t kernel_frame_arena_get_peak_used_bytes(void) { return kernel_frame_arena_default.peak; }
 
-uint32_t kernel_frame_arena_get_reset_count(void) { return kernel_frame_arena_reset_count; }
+uint32_t kernel_frame_arena_get_reset_count(void) { return kernel_frame_arena_default.reset_count; }
 
-uint32_t kernel_frame_arena_get_failed_alloc_count(void) { return kernel_frame_arena_failed_alloc_count; }
+uint32_t kernel_frame_arena_get_failed_alloc_count(void) { return kernel_frame_arena_default.failed_alloc_count; }
 
-void kernel_frame_arena_set_frame_budget(uint32_t budget_bytes) { kernel_frame_arena_budget = budget_bytes; }
+void kernel_frame_arena_set_frame_budget(uint32_t budget_bytes)
+{
+    kernel_frame_arena_set_budget(&kernel_frame_arena_default, budget_bytes);
+}
 
-uint32_t kernel_frame_arena_get_budget_exceeded_count(void) { return kernel_frame_arena_budget_exceeded_count; }
+uint32_t kernel_frame_arena_get_budget_exceeded_count(void) { return kernel_frame_arena_default.budget_exceeded_count; }
 
-uint32_t kernel_frame_arena_get_wcet_alloc_cycles(void) { return kernel_frame_arena_wcet_alloc; }
+uint32_t kernel_frame_arena_get_wcet_alloc_cycles(void) { return kernel_frame_arena_default.wcet_alloc; }
 
-uint32_t kernel_frame_arena_get_wcet_reset_cycles(void) { return kernel_frame_arena_wcet_reset; }
+uint32_t kernel_frame_arena_get_wcet_reset_cycles(void) { return kernel_frame_arena_default.wcet_reset; }
@@ -1,11 +1,13 @@
 #define __LPL_KERNEL__
 
 #include <kernel/config.h>
+#include <kernel/core/lock.h>
 #include <kernel/cpu/cpu_topology.h>
-#include <kernel/cpu/numa_policy.h>
 #include <kernel/cpu/paging.h>
 #include <kernel/cpu/pmm.h>
+#include <kernel/diag/trace.h>
 #include <kernel/memory/heap.h>
+#include <kernel/memory/heap_trace.h>
 #include <kernel/memory/slab.h>
 #include <kernel/memory/tlsf.h>
 #include <kernel/memory/vmm.h>
@@ -25,14 +27,30 @@
 #define KERNEL_HEAP_HEADER_MAGIC    0x4C50u
 
 #ifdef LPL_KERNEL_REAL_TIME_MODE
-#    define KERNEL_HEAP_CLIENT_BOOT_POOL_PAGES 8u
-#    define KERNEL_HEAP_CLIENT_SLAB_PAGES      (KERNEL_SLAB_CACHE_MAX_PAGES * 3u)
+#    define KERNEL_HEAP_CLIENT_BOOT_POOL_PAGES 2u
 
 #    define KERNEL_HEAP_CLIENT_TLSF_POOL_SIZE (4u * 1024u * 1024u)
 static uint8_t kernel_heap_client_tlsf_pool[KERNEL_HEAP_CLIENT_TLSF_POOL_SIZE] __attribute__((aligned(8)));
+
+/* TLSF serves what the old 64 KiB mapping could; larger requests stay page-granular in the VMM. */
+#    define KERNEL_HEAP_CLIENT_TLSF_MAX_REQUEST (64u * 1024u)
+
+/* Pools are added as buddy blocks of this order (1 MiB) whenever an instance's
+   free bytes fall below the headroom, and never inside a hot loop. */
+#    define KERNEL_HEAP_CLIENT_TLSF_EXTENSION_ORDER 8u
+#    define KERNEL_HEAP_CLIENT_TLSF_HEADROOM_BYTES  (512u * 1024u)
+
+/* The engine's C++ heap: its own instance, so a burst of engine objects
+   fragments neither the kernel's pool nor the other way round. */
+static KernelTlsf_t kernel_heap_engine_tlsf;
+static uint32_t kernel_heap_tlsf_extension_count = 0u;
+static uint32_t kernel_heap_tlsf_extension_failure_count = 0u;
 #else
-#    define KERNEL_HEAP_SIZE_CLASSES   7u
-#    define KERNEL_HEAP_SERVER_DOMAINS 2u
+#    define KERNEL_HEAP_SIZE_CLASSES        7u
+#    define KERNEL_HEAP_SERVER_DOMAINS      CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC
+#    define KERNEL_HEAP_MAGAZINE_ROUNDS     14u
+#    define KERNEL_HEAP_MAGAZINE_POOL_COUNT 320u
+#    define KERNEL_HEAP_REFILL_BATCH        8u
 #endif
 
 static KernelHeapBlock_t *kernel_heap_free_list = NULL;
@@ -43,6 +61,11 @@ static uint32_t kernel_heap_rejected_free_count = 0u;
 static uint32_t kernel_heap_double_free_count = 0u;
 static bool kernel_heap_initialized = false;
 
+/* Guards the first-fit list and everything that walks it. The server size
+   classes only come here to refill or when they run out of magazines. */
+static KernelTicketLock_t kernel_heap_lock;
+static KernelLockStatistics_t kernel_heap_lock_statistics;
+
 #ifdef LPL_KERNEL_REAL_TIME_MODE
 static uint32_t kernel_heap_hot_loop_depth = 0u;
 static uint32_t kernel_heap_hot_loop_violation_count = 0u;
@@ -50,18 +73,53 @@ static uint32_t kernel_heap_hot_loop_bounded_count = 0u;
 #endif
 
 #ifndef LPL_KERNEL_REAL_TIME_MODE
+/*
+ * Server size classes: per-CPU magazines in front of a lock-free depot
+ * (Bonwick & Adams, "Magazines and Vmem", USENIX 2001).
+ *
+ * Every logical slot owns a loaded and a previous magazine per size class and
+ * is the only CPU that ever touches them, with IF clear so an interrupt
+ * handler calling kmalloc cannot interleave. When both are empty (alloc) or
+ * both are full (free), the slot trades one with the depot: a Treiber stack of
+ * full magazines per class plus one stack of empties shared by all classes.
+ * The stack heads carry a generation tag next to the pointer and are swapped
+ * with CMPXCHG8B, so a magazine popped and pushed back between another CPU's
+ * read and its CAS does not slip through (ABA). Magazines are never freed, so
+ * following a stale head's `next` only ever reads pool memory.
+ *
+ * A block remembers the slot that allocated it. Freeing it from another CPU
+ * pushes it onto that slot's remote-free list, one CAS; the owner takes the
+ * whole list with an exchange the next time its magazines run dry. Blocks
+ * therefore drift back to the CPU whose cache last held them instead of
+ * leaking into whichever CPU happened to free them.
+ */
+typedef struct KernelHeapMagazine {
+    struct KernelHeapMagazine *next;
+    uint32_t count;
+    KernelHeapBlock_t *rounds[KERNEL_HEAP_MAGAZINE_ROUNDS];
+} KernelHeapMagazine_t;
+
 typedef struct KernelHeapServerDomain {
-    KernelHeapBlock_t *size_class_lists[KERNEL_HEAP_SIZE_CLASSES];
-    uint32_t size_class_free_counts[KERNEL_HEAP_SIZE_CLASSES];
+    KernelHeapMagazine_t *loaded[KERNEL_HEAP_SIZE_CLASSES];
+    KernelHeapMagazine_t *previous[KERNEL_HEAP_SIZE_CLASSES];
+    KernelHeapBlock_t *volatile remote_free_lists[KERNEL_HEAP_SIZE_CLASSES];
+    volatile uint32_t remote_free_pending[KERNEL_HEAP_SIZE_CLASSES];
     uint32_t size_class_hit_counts[KERNEL_HEAP_SIZE_CLASSES];
     uint32_t size_class_refill_counts[KERNEL_HEAP_SIZE_CLASSES];
     uint32_t first_fit_fallback_count;
-    uint32_t remote_probe_count;
-    uint32_t remote_hit_count;
-} KernelHeapServerDomain_t;
+    uint32_t remote_probe_count; /**< Misses that went to the depot. */
+    uint32_t remote_hit_count;   /**< ...and came back with a full magazine. */
+    uint32_t remote_free_count;  /**< Blocks this slot handed to another owner. */
+    uint32_t remote_drain_count; /**< Remote-free lists this slot took back. */
+} __attribute__((aligned(64))) KernelHeapServerDomain_t;
 
 static uint32_t kernel_heap_size_class_sizes[KERNEL_HEAP_SIZE_CLASSES] = {8u, 16u, 32u, 64u, 128u, 256u, 512u};
 static KernelHeapServerDomain_t kernel_heap_server_domains[KERNEL_HEAP_SERVER_DOMAINS];
+static KernelHeapMagazine_t kernel_heap_magazine_pool[KERNEL_HEAP_MAGAZINE_POOL_COUNT];
+/* Depot heads: low word the top magazine, high word the generation tag. */
+static volatile uint64_t kernel_heap_depot_full[KERNEL_HEAP_SIZE_CLASSES];
+static volatile uint64_t kernel_heap_depot_empty;
+static volatile uint32_t kernel_heap_depot_full_counts[KERNEL_HEAP_SIZE_CLASSES];
 static uint32_t kernel_heap_server_active_domain = 0u;
 static uint8_t kernel_heap_server_slot_domain_override_enabled[CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC];
 static uint32_t kernel_heap_server_slot_domain_override[CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC];
@@ -70,7 +128,7 @@ static uint32_t kernel_heap_server_slot_domain_override[CPU_TOPOLOGY_MAX_LOGICAL
 #ifdef LPL_KERNEL_REAL_TIME_MODE
 static const char kernel_heap_strategy_name[] = "slab+tlsf-client";
 #else
-static const char kernel_heap_strategy_name[] = "sizeclass+first-fit-server";
+static const char kernel_heap_strategy_name[] = "magazine+first-fit-server";
 #endif
 
 static uint32_t kernel_heap_align_up(uint32_t value, uint32_t align) { return (value + (align - 1u)) & ~(align - 1u); }
@@ -104,56 +162,195 @@ static uint32_t kernel_heap_server_get_local_domain_index(void)
     return logical_slot;
 }
 
-static KernelHeapBlock_t *kernel_heap_server_try_pop_remote_bucket(uint32_t local_domain_index,
-                                                                   uint32_t size_class_index,
-                                                                   uint32_t *owner_domain_index)
+static uint32_t kernel_heap_server_size_class_index(uint32_t payload_size)
 {
-    if (!owner_domain_index || size_class_index >= KERNEL_HEAP_SIZE_CLASSES)
-        return NULL;
+    for (uint32_t sc = 0u; sc < KERNEL_HEAP_SIZE_CLASSES; ++sc)
+    {
+        if (payload_size <= kernel_heap_size_class_sizes[sc])
+            return sc;
+    }
 
-    uint32_t local_numa_node = numa_policy_get_node_for_slot(local_domain_index);
+    return KERNEL_HEAP_SIZE_CLASSES;
+}
 
-    for (uint32_t domain_index = 0u; domain_index < KERNEL_HEAP_SERVER_DOMAINS; ++domain_index)
+/* tools/heap-replay builds this file as a 64-bit user program, single-threaded:
+   there are no interrupts to mask and pushf/pop would not assemble. */
+#ifdef LPL_KERNEL_HOST_REPLAY
+static uint32_t kernel_heap_irq_save(void) { return 0u; }
+
+static void kernel_heap_irq_restore(uint32_t eflags) { (void) eflags; }
+#else
+static uint32_t kernel_heap_irq_save(void)
+{
+    uint32_t eflags;
+    __asm__ volatile("pushf\n\tpop %0\n\tcli" : "=r"(eflags)::"memory");
+    return eflags;
+}
+
+static void kernel_heap_irq_restore(uint32_t eflags) { __asm__ volatile("push %0\n\tpopf" ::"r"(eflags) : "memory", "cc"); }
+#endif
+
+static void kernel_heap_depot_push(volatile uint64_t *depot, KernelHeapMagazine_t *magazine)
+{
+    /* A torn read of the head is harmless: the CAS below rejects it. */
+    uint64_t head = *depot;
+    uint64_t desired;
+
+    do
     {
-        if (domain_index == local_domain_index)
-            continue;
+        magazine->next = (KernelHeapMagazine_t *) (uintptr_t) (uint32_t) head;
+        desired = (((head >> 32) + 1u) << 32) | (uint32_t) (uintptr_t) magazine;
+    } while (!__atomic_compare_exchange_n(depot, &head, desired, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
 
-        if (numa_policy_get_node_for_slot(domain_index) != local_numa_node)
-            continue;
+static KernelHeapMagazine_t *kernel_heap_depot_pop(volatile uint64_t *depot)
+{
+    uint64_t head = *depot;
+    uint64_t desired;
+    KernelHeapMagazine_t *top;
 
-        KernelHeapServerDomain_t *domain = kernel_heap_server_get_domain(domain_index);
+    do
+    {
+        top = (KernelHeapMagazine_t *) (uintptr_t) (uint32_t) head;
+        if (!top)
+            return NULL;
+        desired = (((head >> 32) + 1u) << 32) | (uint32_t) (uintptr_t) top->next;
+    } while (!__atomic_compare_exchange_n(depot, &head, desired, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
 
-        if (!domain || !domain->size_class_lists[size_class_index])
-            continue;
+    top->next = NULL;
+    return top;
+}
 
-        KernelHeapBlock_t *block = domain->size_class_lists[size_class_index];
-        domain->size_class_lists[size_class_index] = block->next;
-        --domain->size_class_free_counts[size_class_index];
-        *owner_domain_index = domain_index;
-        return block;
+/* Owner slot, IF clear. */
+static KernelHeapBlock_t *kernel_heap_magazine_pop(KernelHeapServerDomain_t *domain, uint32_t sc)
+{
+    KernelHeapMagazine_t *loaded = domain->loaded[sc];
+
+    if (loaded && loaded->count > 0u)
+        return loaded->rounds[--loaded->count];
+
+    KernelHeapMagazine_t *previous = domain->previous[sc];
+
+    if (previous && previous->count > 0u)
+    {
+        domain->previous[sc] = loaded;
+        domain->loaded[sc] = previous;
+        return previous->rounds[--previous->count];
     }
 
-    for (uint32_t domain_index = 0u; domain_index < KERNEL_HEAP_SERVER_DOMAINS; ++domain_index)
+    return NULL;
+}
+
+/*
+ * Owner slot, IF clear. Stores @p block in the slot's magazines, trading a
+ * full one to the depot when both are full. False when no empty magazine is
+ * left anywhere; the caller returns the block to the first-fit list instead.
+ */
+static bool kernel_heap_magazine_push(KernelHeapServerDomain_t *domain, uint32_t sc, KernelHeapBlock_t *block)
+{
+    KernelHeapMagazine_t *loaded = domain->loaded[sc];
+
+    if (!loaded || loaded->count == KERNEL_HEAP_MAGAZINE_ROUNDS)
     {
-        if (domain_index == local_domain_index)
-            continue;
+        KernelHeapMagazine_t *previous = domain->previous[sc];
 
-        if (numa_policy_get_node_for_slot(domain_index) == local_numa_node)
-            continue;
+        if (previous && previous->count < KERNEL_HEAP_MAGAZINE_ROUNDS)
+        {
+            domain->previous[sc] = loaded;
+            loaded = previous;
+        }
+        else
+        {
+            KernelHeapMagazine_t *empty = kernel_heap_depot_pop(&kernel_heap_depot_empty);
 
-        KernelHeapServerDomain_t *domain = kernel_heap_server_get_domain(domain_index);
+            if (!empty)
+                return false;
 
-        if (!domain || !domain->size_class_lists[size_class_index])
-            continue;
+            if (previous)
+            {
+                kernel_heap_depot_push(&kernel_heap_depot_full[sc], previous);
+                __atomic_fetch_add(&kernel_heap_depot_full_counts[sc], 1u, __ATOMIC_RELAXED);
+            }
+            domain->previous[sc] = loaded;
+            loaded = empty;
+        }
+        domain->loaded[sc] = loaded;
+    }
 
-        KernelHeapBlock_t *block = domain->size_class_lists[size_class_index];
-        domain->size_class_lists[size_class_index] = block->next;
-        --domain->size_class_free_counts[size_class_index];
-        *owner_domain_index = domain_index;
-        return block;
+    loaded->rounds[loaded->count++] = block;
+    return true;
+}
+
+/*
+ * Owner slot, IF clear. Both magazines are empty: take back what other CPUs
+ * freed, then try the depot. The empty previous magazine goes back to the
+ * depot so a full one can take its place.
+ */
+static KernelHeapBlock_t *kernel_heap_magazine_reload(KernelHeapServerDomain_t *domain, uint32_t sc,
+                                                      KernelHeapBlock_t **overflow)
+{
+    if (domain->remote_free_lists[sc])
+    {
+        KernelHeapBlock_t *chain = __atomic_exchange_n(&domain->remote_free_lists[sc], NULL, __ATOMIC_ACQUIRE);
+        ++domain->remote_drain_count;
+
+        while (chain)
+        {
+            KernelHeapBlock_t *next = chain->next;
+
+            __atomic_fetch_sub(&domain->remote_free_pending[sc], 1u, __ATOMIC_RELAXED);
+            if (!kernel_heap_magazine_push(domain, sc, chain))
+            {
+                chain->next = *overflow;
+                *overflow = chain;
+            }
+            chain = next;
+        }
+
+        KernelHeapBlock_t *block = kernel_heap_magazine_pop(domain, sc);
+        if (block)
+            return block;
     }
 
-    return NULL;
+    ++domain->remote_probe_count;
+
+    KernelHeapMagazine_t *full = kernel_heap_depot_pop(&kernel_heap_depot_full[sc]);
+
+    if (!full)
+        return NULL;
+
+    __atomic_fetch_sub(&kernel_heap_depot_full_counts[sc], 1u, __ATOMIC_RELAXED);
+    ++domain->remote_hit_count;
+
+    if (domain->previous[sc])
+        kernel_heap_depot_push(&kernel_heap_depot_empty, domain->previous[sc]);
+    domain->previous[sc] = domain->loaded[sc];
+    domain->loaded[sc] = full;
+    return full->rounds[--full->count];
+}
+
+static void kernel_heap_remote_free_push(KernelHeapServerDomain_t *owner, uint32_t sc, KernelHeapBlock_t *block)
+{
+    KernelHeapBlock_t *head = owner->remote_free_lists[sc];
+
+    do
+    {
+        block->next = head;
+    } while (!__atomic_compare_exchange_n(&owner->remote_free_lists[sc], &head, block, true, __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+
+    __atomic_fetch_add(&owner->remote_free_pending[sc], 1u, __ATOMIC_RELAXED);
+}
+
+static uint32_t kernel_heap_magazine_round_count(const KernelHeapServerDomain_t *domain, uint32_t sc)
+{
+    uint32_t count = domain->remote_free_pending[sc];
+
+    if (domain->loaded[sc])
+        count += domain->loaded[sc]->count;
+    if (domain->previous[sc])
+        count += domain->previous[sc]->count;
+    return count;
 }
 
 #endif
@@ -246,12 +443,26 @@ static bool kernel_heap_grow_small_pool(void)
 #endif
 }
 
+#ifndef LPL_KERNEL_REAL_TIME_MODE
+/* Blocks the magazines could not take, linked through next. */
+static void kernel_heap_server_release_overflow(KernelHeapBlock_t *overflow)
+{
+    uint32_t eflags = kernel_ticket_lock_acquire_irqsave(&kernel_heap_lock);
+
+    while (overflow)
+    {
+        KernelHeapBlock_t *next = overflow->next;
+        kernel_heap_add_free_block(overflow);
+        overflow = next;
+    }
+
+    kernel_ticket_lock_release_irqrestore(&kernel_heap_lock, eflags);
+}
+#endif
+
 #ifdef LPL_KERNEL_REAL_TIME_MODE
 static void kernel_heap_build_client_boot_pool(void)
 {
-    void *slab_backing[KERNEL_HEAP_CLIENT_SLAB_PAGES];
-    uint32_t slab_donated = 0u;
-
     for (uint32_t page_index = 0u; page_index < KERNEL_HEAP_CLIENT_BOOT_POOL_PAGES; ++page_index)
     {
         uint32_t page_phys = physical_memory_manager_page_frame_allocate();
@@ -259,27 +470,88 @@ static void kernel_heap_build_client_boot_pool(void)
         if (!page_phys)
             break;
 
-        void *page_virt = kernel_heap_phys_to_virt(page_phys);
+        KernelHeapBlock_t *block = (KernelHeapBlock_t *) kernel_heap_phys_to_virt(page_phys);
+        block->size = PAGE_SIZE;
+        block->magic = KERNEL_HEAP_HEADER_MAGIC;
+        block->next = NULL;
+        block->reserved = 0u;
+        kernel_heap_add_free_block(block);
+    }
+
+    kernel_tlsf_initialize(kernel_heap_client_tlsf_pool, KERNEL_HEAP_CLIENT_TLSF_POOL_SIZE);
+
+    uint32_t engine_phys = physical_memory_manager_page_frame_allocate_order(KERNEL_HEAP_CLIENT_TLSF_EXTENSION_ORDER);
+    if (engine_phys)
+        kernel_tlsf_init(&kernel_heap_engine_tlsf, "engine_tlsf", kernel_heap_phys_to_virt(engine_phys),
+                         (size_t) PAGE_SIZE << KERNEL_HEAP_CLIENT_TLSF_EXTENSION_ORDER);
+}
 
-        if (slab_donated < KERNEL_HEAP_CLIENT_SLAB_PAGES)
+/* Grow @p tlsf by buddy blocks until it is back above the headroom. Takes the
+   PMM, so it runs only where an unbounded path is allowed. */
+static void kernel_heap_client_tlsf_reserve_headroom(KernelTlsf_t *tlsf)
+{
+    if (!tlsf || !tlsf->initialized)
+        return;
+
+    while (tlsf->free_bytes < KERNEL_HEAP_CLIENT_TLSF_HEADROOM_BYTES && tlsf->pool_count < KERNEL_TLSF_MAX_POOLS)
+    {
+        uint32_t phys = physical_memory_manager_page_frame_allocate_order(KERNEL_HEAP_CLIENT_TLSF_EXTENSION_ORDER);
+
+        if (!phys)
         {
-            slab_backing[slab_donated++] = page_virt;
+            ++kernel_heap_tlsf_extension_failure_count;
+            return;
         }
-        else
+
+        if (!kernel_tlsf_add_pool(tlsf, kernel_heap_phys_to_virt(phys),
+                                  (size_t) PAGE_SIZE << KERNEL_HEAP_CLIENT_TLSF_EXTENSION_ORDER))
         {
-            KernelHeapBlock_t *block = (KernelHeapBlock_t *) page_virt;
-            block->size = PAGE_SIZE;
-            block->magic = KERNEL_HEAP_HEADER_MAGIC;
-            block->next = NULL;
-            block->reserved = 0u;
-            kernel_heap_add_free_block(block);
+            physical_memory_manager_page_frame_free_order(phys, KERNEL_HEAP_CLIENT_TLSF_EXTENSION_ORDER);
+            ++kernel_heap_tlsf_extension_failure_count;
+            return;
         }
+
+        ++kernel_heap_tlsf_extension_count;
     }
+}
 
-    if (slab_donated > 0u)
-        kernel_slab_initialize(slab_backing, slab_donated);
+static void kernel_heap_client_tlsf_reserve_all(void)
+{
+    kernel_heap_client_tlsf_reserve_headroom(kernel_tlsf_get_default());
+    kernel_heap_client_tlsf_reserve_headroom(&kernel_heap_engine_tlsf);
+}
 
-    kernel_tlsf_initialize(kernel_heap_client_tlsf_pool, KERNEL_HEAP_CLIENT_TLSF_POOL_SIZE);
+/* One TLSF block dressed as a heap block, or NULL. Outside a hot loop a miss
+   grows the instance once and retries. */
+static void *kernel_heap_client_tlsf_allocate(KernelTlsf_t *tlsf, uint32_t total_size, uint32_t payload_size,
+                                              bool in_hot_loop)
+{
+    if (total_size >= KERNEL_HEAP_CLIENT_TLSF_MAX_REQUEST)
+        return NULL;
+
+    void *tlsf_raw = kernel_tlsf_allocate(tlsf, total_size);
+    if (!tlsf_raw && !in_hot_loop && tlsf && tlsf->initialized)
+    {
+        kernel_heap_client_tlsf_reserve_headroom(tlsf);
+        tlsf_raw = kernel_tlsf_allocate(tlsf, total_size);
+    }
+    if (!tlsf_raw)
+        return NULL;
+
+    KernelHeapBlock_t *header = (KernelHeapBlock_t *) tlsf_raw;
+    header->size = total_size;
+    header->magic = KERNEL_HEAP_HEADER_MAGIC;
+    header->flags = KERNEL_HEAP_BLOCK_FLAG_TLSF;
+    header->canary = (uint16_t) ((0xCAFE ^ header->size) & 0xFFFF);
+#    ifdef LPL_KERNEL_DEBUG_POISON
+    for (uint32_t z = 0; z < payload_size; ++z)
+        ((uint8_t *) (header + 1))[z] = 0xCC;
+#    else
+    (void) payload_size;
+#    endif
+    if (in_hot_loop)
+        ++kernel_heap_hot_loop_bounded_count;
+    return (void *) (header + 1);
 }
 #else
 static void kernel_heap_server_size_class_initialize(void)
@@ -299,14 +571,33 @@ static void kernel_heap_server_size_class_initialize(void)
         domain->first_fit_fallback_count = 0u;
         domain->remote_probe_count = 0u;
         domain->remote_hit_count = 0u;
+        domain->remote_free_count = 0u;
+        domain->remote_drain_count = 0u;
         for (uint32_t i = 0u; i < KERNEL_HEAP_SIZE_CLASSES; ++i)
         {
-            domain->size_class_lists[i] = NULL;
-            domain->size_class_free_counts[i] = 0u;
+            domain->loaded[i] = NULL;
+            domain->previous[i] = NULL;
+            domain->remote_free_lists[i] = NULL;
+            domain->remote_free_pending[i] = 0u;
             domain->size_class_hit_counts[i] = 0u;
             domain->size_class_refill_counts[i] = 0u;
         }
     }
+
+    /* Magazines are handed out on first use, so a slot that never comes
+       online costs nothing but its domain record. */
+    kernel_heap_depot_empty = 0u;
+    for (uint32_t i = 0u; i < KERNEL_HEAP_SIZE_CLASSES; ++i)
+    {
+        kernel_heap_depot_full[i] = 0u;
+        kernel_heap_depot_full_counts[i] = 0u;
+    }
+
+    for (uint32_t i = 0u; i < KERNEL_HEAP_MAGAZINE_POOL_COUNT; ++i)
+    {
+        kernel_heap_magazine_pool[i].count = 0u;
+        kernel_heap_depot_push(&kernel_heap_depot_empty, &kernel_heap_magazine_pool[i]);
+    }
 }
 #endif
 
@@ -338,6 +629,8 @@ void kernel_heap_initialize(void)
     kernel_heap_large_allocation_count = 0u;
     kernel_heap_rejected_free_count = 0u;
     kernel_heap_double_free_count = 0u;
+    kernel_ticket_lock_initialize(&kernel_heap_lock, &kernel_heap_lock_statistics);
+    kernel_lock_statistics_register(&kernel_heap_lock_statistics, "heap_first_fit");
     kernel_heap_initialized = true;
 
 #ifdef LPL_KERNEL_REAL_TIME_MODE
@@ -346,6 +639,10 @@ void kernel_heap_initialize(void)
     kernel_heap_hot_loop_bounded_count = 0u;
 #endif
 
+    /* The slab reserves its pages itself, as one buddy block; on the server
+       profile kmalloc does not route through it, but named caches still work. */
+    kernel_slab_initialize();
+
 #ifdef LPL_KERNEL_REAL_TIME_MODE
     kernel_heap_build_client_boot_pool();
 #else
@@ -353,7 +650,7 @@ void kernel_heap_initialize(void)
 #endif
 }
 
-void *kmalloc(size_t size)
+static void *kernel_heap_allocate(size_t size)
 {
     if (!kernel_heap_initialized || size == 0u)
         return NULL;
@@ -386,22 +683,10 @@ void *kmalloc(size_t size)
         }
     }
 
-    void *tlsf_raw = kernel_tlsf_alloc(total_size);
-    if (tlsf_raw)
-    {
-        KernelHeapBlock_t *header = (KernelHeapBlock_t *) tlsf_raw;
-        header->size = total_size;
-        header->magic = KERNEL_HEAP_HEADER_MAGIC;
-        header->flags = KERNEL_HEAP_BLOCK_FLAG_TLSF;
-        header->canary = (uint16_t) ((0xCAFE ^ header->size) & 0xFFFF);
-#    ifdef LPL_KERNEL_DEBUG_POISON
-        for (uint32_t z = 0; z < payload_size; ++z)
-            ((uint8_t *) (header + 1))[z] = 0xCC;
-#    endif
-        if (in_hot_loop)
-            ++kernel_heap_hot_loop_bounded_count;
-        return (void *) (header + 1);
-    }
+    void *tlsf_block =
+        kernel_heap_client_tlsf_allocate(kernel_tlsf_get_default(), total_size, payload_size, in_hot_loop);
+    if (tlsf_block)
+        return tlsf_block;
 
     if (in_hot_loop)
     {
@@ -413,7 +698,10 @@ void *kmalloc(size_t size)
     if (total_size > PAGE_SIZE || (payload_size > 1024u))
     {
         uint32_t page_count = (total_size + PAGE_SIZE - 1u) / PAGE_SIZE;
+        KERNEL_TRACE_BEGIN(large_span, "heap.large");
         KernelHeapBlock_t *vmm_header = (KernelHeapBlock_t *) kernel_vmm_alloc_pages(page_count);
+        large_span.argument = (uint16_t) page_count;
+        KERNEL_TRACE_END(large_span);
 
         if (vmm_header)
         {
@@ -423,10 +711,10 @@ void *kmalloc(size_t size)
             vmm_header->order = 0u;
             vmm_header->reserved = (uint16_t) page_count;
             vmm_header->next = NULL;
+            vmm_header->canary = (uint16_t) ((0xCAFE ^ vmm_header->size) & 0xFFFF);
 
             ++kernel_heap_large_allocation_count;
 #ifdef LPL_KERNEL_DEBUG_POISON
-            vmm_header->canary = (uint16_t) ((0xCAFE ^ vmm_header->size) & 0xFFFF);
             for (uint32_t z = 0; z < (vmm_header->size - sizeof(KernelHeapBlock_t)); ++z)
                 ((uint8_t *) (vmm_header + 1))[z] = 0xCC;
 #endif
@@ -437,73 +725,60 @@ void *kmalloc(size_t size)
 #ifndef LPL_KERNEL_REAL_TIME_MODE
     uint32_t local_domain_index = kernel_heap_server_get_local_domain_index();
     KernelHeapServerDomain_t *local_domain = kernel_heap_server_get_domain(local_domain_index);
-    uint32_t matched_sc = 0xFFFFFFFFu;
+    uint32_t matched_sc = kernel_heap_server_size_class_index(payload_size);
     uint32_t batch_count = 1u;
 
-    if (payload_size <= kernel_heap_size_class_sizes[KERNEL_HEAP_SIZE_CLASSES - 1u])
+    if (matched_sc < KERNEL_HEAP_SIZE_CLASSES)
     {
-        for (uint32_t sc = 0u; sc < KERNEL_HEAP_SIZE_CLASSES; ++sc)
-        {
-            if (payload_size > kernel_heap_size_class_sizes[sc])
-                continue;
+        KernelHeapBlock_t *overflow = NULL;
+        uint32_t eflags = kernel_heap_irq_save();
 
-            matched_sc = sc;
-            KernelHeapBlock_t *block = NULL;
-            uint32_t owner_domain_index = local_domain_index;
-
-            uint32_t eflags;
-            __asm__ volatile("pushf\n\tpop %0\n\tcli" : "=r"(eflags)::"memory");
-
-            if (local_domain && local_domain->size_class_lists[sc])
-            {
-                block = local_domain->size_class_lists[sc];
-                local_domain->size_class_lists[sc] = block->next;
-                --local_domain->size_class_free_counts[sc];
-            }
+        KernelHeapBlock_t *block = kernel_heap_magazine_pop(local_domain, matched_sc);
+        if (block)
+            ++local_domain->size_class_hit_counts[matched_sc];
+        else
+        {
+            KERNEL_TRACE_BEGIN(reload_span, "heap.magazine_reload");
+            block = kernel_heap_magazine_reload(local_domain, matched_sc, &overflow);
+            reload_span.argument = (uint16_t) matched_sc;
+            KERNEL_TRACE_END(reload_span);
+        }
 
-            __asm__ volatile("push %0\n\tpopf" ::"r"(eflags) : "memory", "cc");
+        kernel_heap_irq_restore(eflags);
 
-            if (!block && local_domain)
-            {
-                ++local_domain->remote_probe_count;
-                __asm__ volatile("pushf\n\tpop %0\n\tcli" : "=r"(eflags)::"memory");
-                block = kernel_heap_server_try_pop_remote_bucket(local_domain_index, sc, &owner_domain_index);
-                __asm__ volatile("push %0\n\tpopf" ::"r"(eflags) : "memory", "cc");
-                if (block)
-                    ++local_domain->remote_hit_count;
-            }
+        if (overflow)
+            kernel_heap_server_release_overflow(overflow);
 
-            if (block)
-            {
-                if (local_domain)
-                    ++local_domain->size_class_hit_counts[sc];
-
-                block->flags = KERNEL_HEAP_BLOCK_FLAG_SC;
-                block->order = (uint8_t) sc;
-                block->size = kernel_heap_size_class_sizes[sc] + (uint32_t) sizeof(KernelHeapBlock_t);
-                block->reserved = (uint16_t) owner_domain_index;
-                block->next = NULL;
+        if (block)
+        {
+            block->flags = KERNEL_HEAP_BLOCK_FLAG_SC;
+            block->order = (uint8_t) matched_sc;
+            block->size = kernel_heap_size_class_sizes[matched_sc] + (uint32_t) sizeof(KernelHeapBlock_t);
+            block->reserved = (uint16_t) local_domain_index;
+            block->canary = (uint16_t) ((0xCAFE ^ block->size) & 0xFFFF);
+            block->next = NULL;
 #    ifdef LPL_KERNEL_DEBUG_POISON
-                block->canary = (uint16_t) ((0xCAFE ^ block->size) & 0xFFFF);
-                for (uint32_t z = 0; z < kernel_heap_size_class_sizes[sc]; ++z)
-                    ((uint8_t *) (block + 1))[z] = 0xCC;
+            for (uint32_t z = 0; z < kernel_heap_size_class_sizes[matched_sc]; ++z)
+                ((uint8_t *) (block + 1))[z] = 0xCC;
 #    endif
-                return (void *) (block + 1);
-            }
-
-            if (local_domain)
-                ++local_domain->first_fit_fallback_count;
-
-            batch_count = 4u;
-            total_size = kernel_heap_align_up(
-                kernel_heap_size_class_sizes[matched_sc] + (uint32_t) sizeof(KernelHeapBlock_t), KERNEL_HEAP_ALIGNMENT);
-            total_size *= batch_count;
-            if (local_domain)
-                ++local_domain->size_class_refill_counts[matched_sc];
-            break;
+            return (void *) (block + 1);
         }
+
+        ++local_domain->first_fit_fallback_count;
+        ++local_domain->size_class_refill_counts[matched_sc];
+
+        /* One first-fit walk fills most of a magazine. The batch has to fit a
+           single page, which is all kernel_heap_grow_small_pool() adds. */
+        total_size = kernel_heap_align_up(kernel_heap_size_class_sizes[matched_sc] + (uint32_t) sizeof(KernelHeapBlock_t),
+                                          KERNEL_HEAP_ALIGNMENT);
+        batch_count = PAGE_SIZE / total_size;
+        if (batch_count > KERNEL_HEAP_REFILL_BATCH)
+            batch_count = KERNEL_HEAP_REFILL_BATCH;
+        total_size *= batch_count;
     }
 #endif
+    KERNEL_TRACE_BEGIN(first_fit_span, "heap.first_fit");
+    uint32_t heap_eflags = kernel_ticket_lock_acquire_irqsave(&kernel_heap_lock);
     KernelHeapBlock_t *prev = NULL;
     KernelHeapBlock_t *current = kernel_heap_free_list;
 
@@ -521,7 +796,11 @@ void *kmalloc(size_t size)
             break;
 
         if (!kernel_heap_grow_small_pool())
+        {
+            kernel_ticket_lock_release_irqrestore(&kernel_heap_lock, heap_eflags);
+            KERNEL_TRACE_END(first_fit_span);
             return NULL;
+        }
 
         prev = NULL;
         current = kernel_heap_free_list;
@@ -549,63 +828,53 @@ void *kmalloc(size_t size)
         current->size = total_size;
     }
 
+    kernel_ticket_lock_release_irqrestore(&kernel_heap_lock, heap_eflags);
+    KERNEL_TRACE_END(first_fit_span);
+
     current->magic = KERNEL_HEAP_HEADER_MAGIC;
     current->flags = 0u;
     current->order = 0u;
     current->next = NULL;
 
 #ifndef LPL_KERNEL_REAL_TIME_MODE
-    if (matched_sc != 0xFFFFFFFFu && batch_count > 1u)
+    if (matched_sc < KERNEL_HEAP_SIZE_CLASSES)
     {
         uint32_t sc_full_size = kernel_heap_align_up(
             kernel_heap_size_class_sizes[matched_sc] + (uint32_t) sizeof(KernelHeapBlock_t), KERNEL_HEAP_ALIGNMENT);
+        KernelHeapBlock_t *overflow = NULL;
 
-        uint32_t eflags;
-        __asm__ volatile("pushf\n\tpop %0\n\tcli" : "=r"(eflags)::"memory");
+        uint32_t eflags = kernel_heap_irq_save();
 
         for (uint32_t i = 1u; i < batch_count; ++i)
         {
-            if (current->size < sc_full_size * (i + 1u))
-                break;
-
             KernelHeapBlock_t *piece = (KernelHeapBlock_t *) ((uint8_t *) current + (i * sc_full_size));
             piece->size = sc_full_size;
+            piece->magic = KERNEL_HEAP_HEADER_MAGIC;
             piece->flags = KERNEL_HEAP_BLOCK_FLAG_SC | KERNEL_HEAP_BLOCK_FLAG_FREE;
             piece->order = (uint8_t) matched_sc;
             piece->reserved = (uint16_t) local_domain_index;
-            piece->magic = KERNEL_HEAP_HEADER_MAGIC;
+            piece->canary = (uint16_t) ((0xCAFE ^ piece->size) & 0xFFFF);
 
-            if (local_domain)
+            if (!kernel_heap_magazine_push(local_domain, matched_sc, piece))
             {
-                piece->next = local_domain->size_class_lists[matched_sc];
-                local_domain->size_class_lists[matched_sc] = piece;
-                ++local_domain->size_class_free_counts[matched_sc];
+                piece->next = overflow;
+                overflow = piece;
             }
         }
-        __asm__ volatile("push %0\n\tpopf" ::"r"(eflags) : "memory", "cc");
+        kernel_heap_irq_restore(eflags);
+
+        if (overflow)
+            kernel_heap_server_release_overflow(overflow);
 
         current->size = sc_full_size;
         current->flags = KERNEL_HEAP_BLOCK_FLAG_SC;
         current->order = (uint8_t) matched_sc;
         current->reserved = (uint16_t) local_domain_index;
     }
-    else
-    {
-        for (uint32_t sc = 0u; sc < KERNEL_HEAP_SIZE_CLASSES; ++sc)
-        {
-            if (payload_size == kernel_heap_size_class_sizes[sc])
-            {
-                current->flags = KERNEL_HEAP_BLOCK_FLAG_SC;
-                current->order = (uint8_t) sc;
-                current->reserved = (uint16_t) local_domain_index;
-                break;
-            }
-        }
-    }
 #endif
 
-#ifdef LPL_KERNEL_DEBUG_POISON
     current->canary = (uint16_t) ((0xCAFE ^ current->size) & 0xFFFF);
+#ifdef LPL_KERNEL_DEBUG_POISON
     uint32_t poison_size = current->size - sizeof(KernelHeapBlock_t);
 #    ifndef LPL_KERNEL_REAL_TIME_MODE
     if (current->flags & KERNEL_HEAP_BLOCK_FLAG_SC)
@@ -617,11 +886,32 @@ void *kmalloc(size_t size)
     return (void *) (current + 1);
 }
 
+/* The block flags say which allocator served or holds a block; the trace keeps
+   them as the event's path. */
+static uint8_t kernel_heap_trace_path(const void *ptr)
+{
+    return ptr ? (((const KernelHeapBlock_t *) ptr) - 1)->flags : 0u;
+}
+
+void *kmalloc(size_t size)
+{
+    void *ptr = kernel_heap_allocate(size);
+
+    if (kernel_heap_trace_recording)
+        kernel_heap_trace_record(KERNEL_HEAP_TRACE_OPERATION_ALLOC, (uint32_t) size, ptr, kernel_heap_trace_path(ptr),
+                                 __builtin_return_address(0));
+    return ptr;
+}
+
 void kfree(void *ptr)
 {
     if (!ptr)
         return;
 
+    if (kernel_heap_trace_recording)
+        kernel_heap_trace_record(KERNEL_HEAP_TRACE_OPERATION_FREE, 0u, ptr, kernel_heap_trace_path(ptr),
+                                 __builtin_return_address(0));
+
     KernelHeapBlock_t *header = ((KernelHeapBlock_t *) ptr) - 1;
 
     if (header->magic != KERNEL_HEAP_HEADER_MAGIC || header->canary != (uint16_t) ((0xCAFE ^ header->size) & 0xFFFF))
@@ -659,7 +949,10 @@ void kfree(void *ptr)
             ((uint8_t *) (header + 1))[z] = 0xDD;
 #    endif
         header->flags |= KERNEL_HEAP_BLOCK_FLAG_FREE;
-        kernel_tlsf_free(header);
+        if (kernel_tlsf_contains(&kernel_heap_engine_tlsf, header))
+            kernel_tlsf_release(&kernel_heap_engine_tlsf, header);
+        else
+            kernel_tlsf_free(header);
         if (kernel_heap_hot_loop_depth > 0u)
             ++kernel_heap_hot_loop_bounded_count;
         return;
@@ -731,25 +1024,36 @@ void kfree(void *ptr)
 
         if (sc < KERNEL_HEAP_SIZE_CLASSES && owner_domain < KERNEL_HEAP_SERVER_DOMAINS)
         {
-            KernelHeapServerDomain_t *domain = &kernel_heap_server_domains[owner_domain];
-
-            uint32_t eflags;
-            __asm__ volatile("pushf\n\tpop %0\n\tcli" : "=r"(eflags)::"memory");
+            uint32_t local_domain_index = kernel_heap_server_get_local_domain_index();
+            KernelHeapServerDomain_t *local_domain = &kernel_heap_server_domains[local_domain_index];
 
             header->flags |= KERNEL_HEAP_BLOCK_FLAG_FREE;
-            header->next = domain->size_class_lists[sc];
-            domain->size_class_lists[sc] = header;
-            ++domain->size_class_free_counts[sc];
 
-            __asm__ volatile("push %0\n\tpopf" ::"r"(eflags) : "memory", "cc");
-            return;
+            /* An owner that is not running (a slot a smoke only simulates)
+               would never drain its list; keep the block here instead. */
+            if (owner_domain != local_domain_index && cpu_topology_is_logical_slot_online(owner_domain))
+            {
+                kernel_heap_remote_free_push(&kernel_heap_server_domains[owner_domain], sc, header);
+                __atomic_fetch_add(&local_domain->remote_free_count, 1u, __ATOMIC_RELAXED);
+                return;
+            }
+
+            uint32_t eflags = kernel_heap_irq_save();
+            bool stored = kernel_heap_magazine_push(local_domain, sc, header);
+            kernel_heap_irq_restore(eflags);
+
+            if (stored)
+                return;
         }
     }
 #endif
 
     header->next = NULL;
+
+    uint32_t heap_eflags = kernel_ticket_lock_acquire_irqsave(&kernel_heap_lock);
     kernel_heap_add_free_block(header);
     kernel_heap_coalesce_around(header);
+    kernel_ticket_lock_release_irqrestore(&kernel_heap_lock, heap_eflags);
 }
 
 const char *kernel_heap_get_strategy_name(void) { return kernel_heap_strategy_name; }
@@ -770,7 +1074,7 @@ uint32_t kernel_heap_get_size_class_free_count(uint32_t sc)
     KernelHeapServerDomain_t *domain = kernel_heap_server_get_domain(kernel_heap_server_get_local_domain_index());
 
     if (domain && sc < KERNEL_HEAP_SIZE_CLASSES)
-        return domain->size_class_free_counts[sc];
+        return kernel_heap_magazine_round_count(domain, sc);
 #else
     (void) sc;
 #endif
@@ -900,9 +1204,59 @@ uint32_t kernel_heap_get_server_per_cpu_hit_count(uint32_t slot)
 #endif
 }
 
+uint32_t kernel_heap_get_server_domain_remote_free_count(uint32_t domain_index)
+{
+#ifndef LPL_KERNEL_REAL_TIME_MODE
+    KernelHeapServerDomain_t *domain = kernel_heap_server_get_domain(domain_index);
+
+    if (domain)
+        return domain->remote_free_count;
+#else
+    (void) domain_index;
+#endif
+    return 0u;
+}
+
+uint32_t kernel_heap_get_server_domain_remote_drain_count(uint32_t domain_index)
+{
+#ifndef LPL_KERNEL_REAL_TIME_MODE
+    KernelHeapServerDomain_t *domain = kernel_heap_server_get_domain(domain_index);
+
+    if (domain)
+        return domain->remote_drain_count;
+#else
+    (void) domain_index;
+#endif
+    return 0u;
+}
+
+uint32_t kernel_heap_get_server_depot_full_count(uint32_t sc)
+{
+#ifndef LPL_KERNEL_REAL_TIME_MODE
+    if (sc < KERNEL_HEAP_SIZE_CLASSES)
+        return kernel_heap_depot_full_counts[sc];
+#else
+    (void) sc;
+#endif
+    return 0u;
+}
+
+uint32_t kernel_heap_get_server_magazine_rounds(void)
+{
+#ifndef LPL_KERNEL_REAL_TIME_MODE
+    return KERNEL_HEAP_MAGAZINE_ROUNDS;
+#else
+    return 0u;
+#endif
+}
+
 void kernel_heap_hot_loop_enter(void)
 {
 #ifdef LPL_KERNEL_REAL_TIME_MODE
+    /* Last chance to grow before the loop: inside it TLSF must already hold
+       the headroom, since adding a pool means calling the buddy. */
+    if (kernel_heap_hot_loop_depth == 0u)
+        kernel_heap_client_tlsf_reserve_all();
     ++kernel_heap_hot_loop_depth;
 #endif
 }
@@ -912,6 +1266,8 @@ void kernel_heap_hot_loop_leave(void)
 #ifdef LPL_KERNEL_REAL_TIME_MODE
     if (kernel_heap_hot_loop_depth > 0u)
         --kernel_heap_hot_loop_depth;
+    if (kernel_heap_hot_loop_depth == 0u)
+        kernel_heap_client_tlsf_reserve_all();
 #endif
 }
 
@@ -942,7 +1298,62 @@ uint32_t kernel_heap_get_hot_loop_violation_count(void)
 #endif
 }
 
-void *kmalloc_sensitive(size_t size)
+static void *kernel_heap_allocate_engine(size_t size)
+{
+#ifdef LPL_KERNEL_REAL_TIME_MODE
+    if (!kernel_heap_initialized || size == 0u || size > KERNEL_HEAP_CLIENT_TLSF_MAX_REQUEST)
+        return kernel_heap_allocate(size);
+
+    uint32_t payload_size = kernel_heap_align_up((uint32_t) size, KERNEL_HEAP_ALIGNMENT);
+    uint32_t total_size =
+        kernel_heap_align_up(payload_size + (uint32_t) sizeof(KernelHeapBlock_t), KERNEL_HEAP_ALIGNMENT);
+
+    void *block = kernel_heap_client_tlsf_allocate(&kernel_heap_engine_tlsf, total_size, payload_size,
+                                                   kernel_heap_hot_loop_depth > 0u);
+    if (block)
+        return block;
+#endif
+    return kernel_heap_allocate(size);
+}
+
+void *kmalloc_engine(size_t size)
+{
+    void *ptr = kernel_heap_allocate_engine(size);
+
+    if (kernel_heap_trace_recording)
+        kernel_heap_trace_record(KERNEL_HEAP_TRACE_OPERATION_ENGINE_ALLOC, (uint32_t) size, ptr,
+                                 kernel_heap_trace_path(ptr), __builtin_return_address(0));
+    return ptr;
+}
+
+KernelTlsf_t *kernel_heap_get_engine_tlsf(void)
+{
+#ifdef LPL_KERNEL_REAL_TIME_MODE
+    return kernel_heap_engine_tlsf.initialized ? &kernel_heap_engine_tlsf : NULL;
+#else
+    return NULL;
+#endif
+}
+
+uint32_t kernel_heap_get_tlsf_extension_count(void)
+{
+#ifdef LPL_KERNEL_REAL_TIME_MODE
+    return kernel_heap_tlsf_extension_count;
+#else
+    return 0u;
+#endif
+}
+
+uint32_t kernel_heap_get_tlsf_extension_failure_count(void)
+{
+#ifdef LPL_KERNEL_REAL_TIME_MODE
+    return kernel_heap_tlsf_extension_failure_count;
+#else
+    return 0u;
+#endif
+}
+
+static void *kernel_heap_allocate_sensitive(size_t size)
 {
     if (!kernel_heap_initialized || size == 0u)
         return NULL;
@@ -963,9 +1374,9 @@ void *kmalloc_sensitive(size_t size)
     header->order = 0u;
     header->reserved = (uint16_t) page_count;
     header->next = NULL;
+    header->canary = (uint16_t) ((0xCAFE ^ header->size) & 0xFFFF);
 
 #ifdef LPL_KERNEL_DEBUG_POISON
-    header->canary = (uint16_t) ((0xCAFE ^ header->size) & 0xFFFF);
     for (uint32_t z = 0; z < (header->size - sizeof(KernelHeapBlock_t)); ++z)
         ((uint8_t *) (header + 1))[z] = 0xCC;
 #endif
@@ -973,3 +1384,13 @@ void *kmalloc_sensitive(size_t size)
     ++kernel_heap_large_allocation_count;
     return (void *) (header + 1);
 }
+
+void *kmalloc_sensitive(size_t size)
+{
+    void *ptr = kernel_heap_allocate_sensitive(size);
+
+    if (kernel_heap_trace_recording)
+        kernel_heap_trace_record(KERNEL_HEAP_TRACE_OPERATION_SENSITIVE_ALLOC, (uint32_t) size, ptr,
+                                 kernel_heap_trace_path(ptr), __builtin_return_address(0));
+    return ptr;
+}
@@ -0,0 +1,227 @@
+/**
+ * @file heap_trace.c
+ * @brief Allocation capture for the kernel heap and its export.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#include <kernel/memory/heap_trace.h>
+
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/cpu/paging.h>
+#include <kernel/diag/telemetry.h>
+#include <kernel/diag/telemetry_stream.h>
+#include <kernel/diag/trace.h>
+#include <kernel/memory/vmm.h>
+
+#define HEAP_TRACE_BUFFER_PAGES                                                                                        \
+    ((KERNEL_HEAP_TRACE_MAX_EVENTS * (uint32_t) sizeof(KernelHeapTraceEvent_t) + (uint32_t) PAGE_SIZE - 1u) /          \
+     (uint32_t) PAGE_SIZE)
+
+/* Bytes per hex line in the text export: 64 characters, short of any terminal's width. */
+#define HEAP_TRACE_TEXT_LINE_BYTES 32u
+
+volatile bool kernel_heap_trace_recording = false;
+
+static KernelHeapTraceEvent_t *heap_trace_events = NULL;
+static volatile uint32_t heap_trace_claimed = 0u;
+static uint32_t heap_trace_exported = 0u;
+
+/* Recorders between their check of the flag and their last store. A slot is
+   claimed before it is filled, so the claimed count alone says nothing about
+   which events are whole: start and export wait for this to drain instead. */
+static volatile uint32_t heap_trace_writers = 0u;
+
+static inline uint32_t heap_trace_save_and_disable_interrupts(void)
+{
+    uint32_t flags;
+
+    __asm__ volatile("pushfl\n\tpopl %0\n\tcli" : "=r"(flags)::"memory");
+    return flags;
+}
+
+static inline void heap_trace_restore_interrupts(uint32_t flags)
+{
+    __asm__ volatile("pushl %0\n\tpopfl" ::"r"(flags) : "memory", "cc");
+}
+
+/**
+ * @brief Turn recording off and wait out every recorder that got past the flag.
+ *
+ * @details The flag store and each recorder's increment are both sequentially
+ *          consistent: a recorder either sees the flag down, or is counted here.
+ *          Recorders run with interrupts off, so none can be stuck under this
+ *          CPU, and the ones on other CPUs are a handful of stores from done.
+ */
+static void heap_trace_quiesce(void)
+{
+    __atomic_store_n(&kernel_heap_trace_recording, false, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&heap_trace_writers, __ATOMIC_SEQ_CST) != 0u)
+        __asm__ volatile("pause" ::: "memory");
+}
+
+/* Slots claimed past the capacity are the dropped calls. */
+static uint32_t heap_trace_recorded(void)
+{
+    const uint32_t claimed = __atomic_load_n(&heap_trace_claimed, __ATOMIC_ACQUIRE);
+
+    return claimed < KERNEL_HEAP_TRACE_MAX_EVENTS ? claimed : KERNEL_HEAP_TRACE_MAX_EVENTS;
+}
+
+bool kernel_heap_trace_initialize(void)
+{
+    if (heap_trace_events)
+        return true;
+
+    heap_trace_events = (KernelHeapTraceEvent_t *) kernel_vmm_alloc_pages(HEAP_TRACE_BUFFER_PAGES);
+    return heap_trace_events != NULL;
+}
+
+void kernel_heap_trace_start(void)
+{
+    if (!heap_trace_events)
+        return;
+
+    heap_trace_quiesce();
+    __atomic_store_n(&heap_trace_claimed, 0u, __ATOMIC_RELEASE);
+    __atomic_store_n(&kernel_heap_trace_recording, true, __ATOMIC_SEQ_CST);
+}
+
+void kernel_heap_trace_stop(void) { heap_trace_quiesce(); }
+
+void kernel_heap_trace_record(KernelHeapTraceOperation_t operation, uint32_t size, const void *pointer, uint8_t path,
+                              const void *caller)
+{
+    if (!kernel_heap_trace_recording)
+        return;
+
+    const uint32_t flags = heap_trace_save_and_disable_interrupts();
+    __atomic_add_fetch(&heap_trace_writers, 1u, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&kernel_heap_trace_recording, __ATOMIC_SEQ_CST))
+    {
+        __atomic_sub_fetch(&heap_trace_writers, 1u, __ATOMIC_RELEASE);
+        heap_trace_restore_interrupts(flags);
+        return;
+    }
+
+    /* One XADD orders every CPU's calls. */
+    const uint32_t slot = __atomic_fetch_add(&heap_trace_claimed, 1u, __ATOMIC_RELAXED);
+    if (slot >= KERNEL_HEAP_TRACE_MAX_EVENTS)
+    {
+        __atomic_sub_fetch(&heap_trace_writers, 1u, __ATOMIC_RELEASE);
+        heap_trace_restore_interrupts(flags);
+        return;
+    }
+
+    KernelHeapTraceEvent_t *event = &heap_trace_events[slot];
+    event->timestamp = kernel_trace_read_timestamp();
+    event->id = (uint32_t) (uintptr_t) pointer;
+    event->size = size;
+    event->caller = (uint32_t) (uintptr_t) caller;
+    event->operation = (uint8_t) operation;
+    event->cpu = (uint8_t) cpu_topology_get_logical_slot();
+    event->path = path;
+    event->reserved = 0u;
+
+    /* Release: whoever sees the count drop sees the event whole. */
+    __atomic_sub_fetch(&heap_trace_writers, 1u, __ATOMIC_RELEASE);
+    heap_trace_restore_interrupts(flags);
+}
+
+/* Binary when the stream takes it, hex lines otherwise. */
+static void heap_trace_export_bytes(Serial_t *serial, const uint8_t *bytes, uint32_t length)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    while (length > 0u)
+    {
+        uint32_t chunk = length < KERNEL_TELEMETRY_STREAM_TRACE_CHUNK_BYTES ? length
+                                                                           : KERNEL_TELEMETRY_STREAM_TRACE_CHUNK_BYTES;
+
+        if (!kernel_telemetry_stream_write_heap_trace(bytes, chunk))
+        {
+            char line[HEAP_TRACE_TEXT_LINE_BYTES * 2u + 2u];
+
+            chunk = length < HEAP_TRACE_TEXT_LINE_BYTES ? length : HEAP_TRACE_TEXT_LINE_BYTES;
+            for (uint32_t index = 0u; index < chunk; ++index)
+            {
+                line[index * 2u] = digits[bytes[index] >> 4];
+                line[index * 2u + 1u] = digits[bytes[index] & 0x0Fu];
+            }
+            line[chunk * 2u] = '\n';
+            line[chunk * 2u + 1u] = '\0';
+            if (serial)
+                serial_write_string(serial, line);
+        }
+
+        bytes += chunk;
+        length -= chunk;
+    }
+}
+
+uint32_t kernel_heap_trace_export(Serial_t *serial)
+{
+    /* Every slot claimed so far is filled once this returns. */
+    heap_trace_quiesce();
+
+    const uint32_t claimed = __atomic_load_n(&heap_trace_claimed, __ATOMIC_ACQUIRE);
+    const uint32_t events = heap_trace_recorded();
+    KernelHeapTraceHeader_t header = {
+        .magic = KERNEL_HEAP_TRACE_MAGIC,
+        .version = KERNEL_HEAP_TRACE_VERSION,
+        .event_size = (uint32_t) sizeof(KernelHeapTraceEvent_t),
+        .events = events,
+        .dropped = claimed - events,
+#ifdef LPL_KERNEL_REAL_TIME_MODE
+        .real_time = 1u,
+#else
+        .real_time = 0u,
+#endif
+        .reserved = 0u,
+    };
+
+    if (serial && !kernel_telemetry_stream_active())
+        serial_write_string(serial, "\n" KERNEL_HEAP_TRACE_EXPORT_BEGIN_MARKER "\n");
+
+    heap_trace_export_bytes(serial, (const uint8_t *) &header, (uint32_t) sizeof(header));
+    if (events > 0u)
+        heap_trace_export_bytes(serial, (const uint8_t *) heap_trace_events,
+                                events * (uint32_t) sizeof(KernelHeapTraceEvent_t));
+
+    if (serial && !kernel_telemetry_stream_active())
+        serial_write_string(serial, KERNEL_HEAP_TRACE_EXPORT_END_MARKER "\n");
+
+    heap_trace_exported = events;
+    return events;
+}
+
+void kernel_heap_trace_get_statistics(KernelHeapTraceStatistics_t *out)
+{
+    if (!out)
+        return;
+
+    const uint32_t claimed = __atomic_load_n(&heap_trace_claimed, __ATOMIC_ACQUIRE);
+
+    out->recording = kernel_heap_trace_recording;
+    out->capacity = heap_trace_events ? KERNEL_HEAP_TRACE_MAX_EVENTS : 0u;
+    out->events = heap_trace_recorded();
+    out->dropped = claimed - out->events;
+    out->exported = heap_trace_exported;
+}
+
+void kernel_heap_trace_report(Serial_t *serial)
+{
+    KernelHeapTraceStatistics_t statistics;
+
+    kernel_heap_trace_get_statistics(&statistics);
+
+    kernel_telemetry_begin_record(serial, "heap_trace");
+    kernel_telemetry_write_boolean("recording", statistics.recording);
+    kernel_telemetry_write_unsigned("capacity", statistics.capacity);
+    kernel_telemetry_write_unsigned("events", statistics.events);
+    kernel_telemetry_write_unsigned("dropped", statistics.dropped);
+    kernel_telemetry_write_unsigned("exported", statistics.exported);
+    kernel_telemetry_end_record();
+}
@@ -2,6 +2,7 @@
 
 #include <kernel/cpu/paging.h>
 #include <kernel/cpu/pmm.h>
+#include <kernel/cpu/tlb_shootdown.h>
 #include <kernel/memory/pinned_memory.h>
 #include <kernel/memory/vmm.h>
 #include <stddef.h>
@@ -79,19 +80,21 @@ void kernel_pinned_free(void *ptr, uint32_t size)
     uint32_t pages_to_free = (size + PAGE_SIZE - 1u) / PAGE_SIZE;
     uint32_t start_virt = (uint32_t) ptr;
 
+    tlb_shootdown_begin();
     for (uint32_t i = 0u; i < pages_to_free; ++i)
     {
         uint32_t virt = start_virt + (i * PAGE_SIZE);
         uint32_t phys = 0u;
+        bool mapped = paging_get_physical_address(virt, &phys);
 
-        if (paging_get_physical_address(virt, &phys))
+        paging_unmap_page(virt);
+        if (mapped)
         {
-            physical_memory_manager_page_frame_free(phys);
+            tlb_shootdown_defer_frame_free(phys, 0u);
         }
-
-        paging_unmap_page(virt);
         ++pinned_released_pages;
     }
+    tlb_shootdown_end();
     kernel_vmm_free_pages(ptr, pages_to_free);
 }
 
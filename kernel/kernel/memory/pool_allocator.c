@@ -4,16 +4,9 @@
 #include <kernel/memory/pool_allocator.h>
 #include <stddef.h>
 
-static uint8_t *kernel_pool_base = NULL;
-static void *kernel_pool_free_head = NULL;
-static uint32_t kernel_pool_slot_size = 0u;
-static uint32_t kernel_pool_object_size = 0u;
-static uint32_t kernel_pool_capacity = 0u;
-static uint32_t kernel_pool_free_count = 0u;
-static uint32_t kernel_pool_peak_used = 0u;
-static uint32_t kernel_pool_failed_alloc_count = 0u;
-static uint32_t kernel_pool_wcet_alloc = 0u;
-static uint32_t kernel_pool_wcet_free = 0u;
+#define KERNEL_POOL_FREE_COOKIE 0x504F4F4Cu
+
+static KernelPool_t kernel_pool_default;
 static bool kernel_pool_initialized = false;
 
 static inline uint32_t pool_allocator_rdtsc_low(void)
@@ -34,132 +27,223 @@ static uint32_t kernel_pool_align_up(uint32_t value, uint32_t align)
     return (value + (align - 1u)) & ~(align - 1u);
 }
 
-bool kernel_pool_allocator_initialize(uint32_t object_size, uint32_t object_count)
+static void kernel_pool_registry_usage(const void *instance, KernelAllocatorUsage_t *out)
 {
-    if (kernel_pool_initialized)
-        return true;
+    kernel_pool_get_usage((const KernelPool_t *) instance, out);
+}
 
-    if (object_size == 0u || object_count == 0u)
+bool kernel_pool_init(KernelPool_t *pool, const char *name, uint32_t object_size, uint32_t object_count)
+{
+    if (!pool || !name || object_size == 0u || object_count == 0u)
         return false;
 
-    kernel_pool_object_size = object_size;
     uint32_t min_slot = (uint32_t) sizeof(void *) + (uint32_t) sizeof(uint32_t);
-    kernel_pool_slot_size = kernel_pool_align_up(object_size, (uint32_t) sizeof(void *));
-    if (kernel_pool_slot_size < min_slot)
-        kernel_pool_slot_size = kernel_pool_align_up(min_slot, (uint32_t) sizeof(void *));
+    uint32_t slot_size = kernel_pool_align_up(object_size, (uint32_t) sizeof(void *));
+    if (slot_size < min_slot)
+        slot_size = kernel_pool_align_up(min_slot, (uint32_t) sizeof(void *));
 
-    uint32_t total_bytes = kernel_pool_slot_size * object_count;
-    void *backing = kmalloc((size_t) total_bytes);
+    if (object_count > 0xFFFFFFFFu / slot_size)
+        return false;
 
+    void *backing = kmalloc((size_t) slot_size * object_count);
     if (!backing)
         return false;
 
-    kernel_pool_base = (uint8_t *) backing;
-    kernel_pool_capacity = object_count;
-    kernel_pool_free_count = object_count;
-    kernel_pool_peak_used = 0u;
-    kernel_pool_failed_alloc_count = 0u;
-    kernel_pool_wcet_alloc = 0u;
-    kernel_pool_wcet_free = 0u;
-    kernel_pool_free_head = NULL;
+    pool->base = (uint8_t *) backing;
+    pool->name = name;
+    pool->slot_size = slot_size;
+    pool->object_size = object_size;
+    pool->capacity = object_count;
+    pool->free_count = object_count;
+    pool->peak_used = 0u;
+    pool->allocations = 0u;
+    pool->frees = 0u;
+    pool->failed_alloc_count = 0u;
+    pool->wcet_alloc = 0u;
+    pool->wcet_free = 0u;
+    pool->owns_pool = false;
+    pool->free_head = NULL;
 
     for (uint32_t index = 0u; index < object_count; ++index)
     {
-        uint8_t *slot = kernel_pool_base + (index * kernel_pool_slot_size);
-        *((void **) slot) = kernel_pool_free_head;
-        *((uint32_t *) (slot + sizeof(void *))) = 0x504F4F4Cu;
-        kernel_pool_free_head = slot;
+        uint8_t *slot = pool->base + (index * slot_size);
+        *((void **) slot) = pool->free_head;
+        *((uint32_t *) (slot + sizeof(void *))) = KERNEL_POOL_FREE_COOKIE;
+        pool->free_head = slot;
     }
 
-    kernel_pool_initialized = true;
+    /* A full registry leaves the pool usable, just unlisted. */
+    kernel_allocator_registry_register(name, KERNEL_ALLOCATOR_KIND_POOL, pool, kernel_pool_registry_usage);
     return true;
 }
 
-void *kernel_pool_alloc(void)
+KernelPool_t *kernel_pool_create(const char *name, uint32_t object_size, uint32_t object_count)
+{
+    KernelPool_t *pool = (KernelPool_t *) kmalloc(sizeof(KernelPool_t));
+
+    if (!pool)
+        return NULL;
+
+    if (!kernel_pool_init(pool, name, object_size, object_count))
+    {
+        kfree(pool);
+        return NULL;
+    }
+
+    pool->owns_pool = true;
+    return pool;
+}
+
+void kernel_pool_destroy(KernelPool_t *pool)
+{
+    if (!pool || !pool->base)
+        return;
+
+    kernel_allocator_registry_unregister(pool);
+    kfree(pool->base);
+    pool->base = NULL;
+    pool->free_head = NULL;
+    pool->capacity = 0u;
+    pool->free_count = 0u;
+
+    if (pool->owns_pool)
+        kfree(pool);
+}
+
+void *kernel_pool_allocate(KernelPool_t *pool)
 {
     uint32_t t0 = pool_allocator_rdtsc_low();
 
-    if (!kernel_pool_initialized || !kernel_pool_free_head)
+    if (!pool || !pool->base || !pool->free_head)
     {
-        if (kernel_pool_initialized)
-            ++kernel_pool_failed_alloc_count;
+        if (pool && pool->base)
+            ++pool->failed_alloc_count;
         return NULL;
     }
 
-    void *slot = kernel_pool_free_head;
-    kernel_pool_free_head = *((void **) slot);
+    void *slot = pool->free_head;
+    pool->free_head = *((void **) slot);
     *((uint32_t *) ((uint8_t *) slot + sizeof(void *))) = 0u;
-    --kernel_pool_free_count;
+    --pool->free_count;
+    ++pool->allocations;
 
-    uint32_t used_count = kernel_pool_capacity - kernel_pool_free_count;
-    if (used_count > kernel_pool_peak_used)
-        kernel_pool_peak_used = used_count;
+    uint32_t used_count = pool->capacity - pool->free_count;
+    if (used_count > pool->peak_used)
+        pool->peak_used = used_count;
 
     uint32_t t1 = pool_allocator_rdtsc_low();
     uint32_t delta = t1 - t0;
-    if (delta > kernel_pool_wcet_alloc)
-        kernel_pool_wcet_alloc = delta;
+    if (delta > pool->wcet_alloc)
+        pool->wcet_alloc = delta;
 
     return slot;
 }
 
-bool kernel_pool_free(void *ptr)
+bool kernel_pool_release(KernelPool_t *pool, void *ptr)
 {
     uint32_t t0 = pool_allocator_rdtsc_low();
 
-    if (!kernel_pool_initialized || !ptr)
+    if (!pool || !pool->base || !ptr)
         return false;
 
     uintptr_t ptr_addr = (uintptr_t) ptr;
-    uintptr_t base_addr = (uintptr_t) kernel_pool_base;
-    uintptr_t end_addr = base_addr + (kernel_pool_slot_size * kernel_pool_capacity);
+    uintptr_t base_addr = (uintptr_t) pool->base;
+    uintptr_t end_addr = base_addr + (pool->slot_size * pool->capacity);
 
     if (ptr_addr < base_addr || ptr_addr >= end_addr)
         return false;
 
-    if (((uint32_t) (ptr_addr - base_addr) % kernel_pool_slot_size) != 0u)
+    if (((uint32_t) (ptr_addr - base_addr) % pool->slot_size) != 0u)
         return false;
 
     uint32_t *cookie_word = (uint32_t *) ((uint8_t *) ptr + sizeof(void *));
-    if (*cookie_word == 0x504F4F4Cu)
+    if (*cookie_word == KERNEL_POOL_FREE_COOKIE)
         return false;
 
 #ifdef LPL_KERNEL_DEBUG_POISON
-    if (kernel_pool_object_size > sizeof(void *))
+    if (pool->object_size > sizeof(void *))
     {
         uint8_t *poison_start = (uint8_t *) ptr + sizeof(void *);
-        uint32_t poison_size = kernel_pool_object_size - (uint32_t) sizeof(void *);
+        uint32_t poison_size = pool->object_size - (uint32_t) sizeof(void *);
         for (uint32_t i = 0u; i < poison_size; ++i)
             poison_start[i] = 0xDF;
     }
 #endif
 
-    *((void **) ptr) = kernel_pool_free_head;
-    *cookie_word = 0x504F4F4Cu;
-    kernel_pool_free_head = ptr;
-    if (kernel_pool_free_count < kernel_pool_capacity)
-        ++kernel_pool_free_count;
+    *((void **) ptr) = pool->free_head;
+    *cookie_word = KERNEL_POOL_FREE_COOKIE;
+    pool->free_head = ptr;
+    if (pool->free_count < pool->capacity)
+        ++pool->free_count;
+    ++pool->frees;
 
     uint32_t t1 = pool_allocator_rdtsc_low();
     uint32_t delta = t1 - t0;
-    if (delta > kernel_pool_wcet_free)
-        kernel_pool_wcet_free = delta;
+    if (delta > pool->wcet_free)
+        pool->wcet_free = delta;
+
+    return true;
+}
+
+void kernel_pool_get_usage(const KernelPool_t *pool, KernelAllocatorUsage_t *out)
+{
+    if (!out)
+        return;
+
+    *out = (KernelAllocatorUsage_t) {0};
+    if (!pool || !pool->base)
+        return;
+
+    out->capacity = pool->capacity;
+    out->used = pool->capacity - pool->free_count;
+    out->peak = pool->peak_used;
+    out->allocations = pool->allocations;
+    out->failures = pool->failed_alloc_count;
+    out->resets = pool->frees;
+    out->wcet_alloc_cycles = pool->wcet_alloc;
+    out->wcet_release_cycles = pool->wcet_free;
+}
+
+KernelPool_t *kernel_pool_get_default(void) { return kernel_pool_initialized ? &kernel_pool_default : NULL; }
+
+bool kernel_pool_allocator_initialize(uint32_t object_size, uint32_t object_count)
+{
+    if (kernel_pool_initialized)
+        return true;
+
+    if (!kernel_pool_init(&kernel_pool_default, "kernel_pool", object_size, object_count))
+        return false;
 
+    kernel_pool_initialized = true;
     return true;
 }
 
+void *kernel_pool_alloc(void)
+{
+    if (!kernel_pool_initialized)
+        return NULL;
+    return kernel_pool_allocate(&kernel_pool_default);
+}
+
+bool kernel_pool_free(void *ptr)
+{
+    if (!kernel_pool_initialized)
+        return false;
+    return kernel_pool_release(&kernel_pool_default, ptr);
+}
+
 bool kernel_pool_allocator_is_initialized(void) { return kernel_pool_initialized; }
 
-uint32_t kernel_pool_get_object_size(void) { return kernel_pool_object_size; }
+uint32_t kernel_pool_get_object_size(void) { return kernel_pool_default.object_size; }
 
-uint32_t kernel_pool_get_capacity(void) { return kernel_pool_capacity; }
+uint32_t kernel_pool_get_capacity(void) { return kernel_pool_default.capacity; }
 
-uint32_t kernel_pool_get_free_count(void) { return kernel_pool_free_count; }
+uint32_t kernel_pool_get_free_count(void) { return kernel_pool_default.free_count; }
 
-uint32_t kernel_pool_get_peak_used_count(void) { return kernel_pool_peak_used; }
+uint32_t kernel_pool_get_peak_used_count(void) { return kernel_pool_default.peak_used; }
 
-uint32_t kernel_pool_get_failed_alloc_count(void) { return kernel_pool_failed_alloc_count; }
+uint32_t kernel_pool_get_failed_alloc_count(void) { return kernel_pool_default.failed_alloc_count; }
 
-uint32_t kernel_pool_get_wcet_alloc_cycles(void) { return kernel_pool_wcet_alloc; }
+uint32_t kernel_pool_get_wcet_alloc_cycles(void) { return kernel_pool_default.wcet_alloc; }
 
-uint32_t kernel_pool_get_wcet_free_cycles(void) { return kernel_pool_wcet_free; }
+uint32_t kernel_pool_get_wcet_free_cycles(void) { return kernel_pool_default.wcet_free; }
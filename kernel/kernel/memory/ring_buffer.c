@@ -4,18 +4,7 @@
 #include <kernel/memory/ring_buffer.h>
 #include <string.h>
 
-static uint8_t *kernel_ring_buffer_base = NULL;
-static uint32_t kernel_ring_buffer_slot_size = 0u;
-static uint32_t kernel_ring_buffer_capacity = 0u;
-static uint32_t kernel_ring_buffer_head = 0u;
-static uint32_t kernel_ring_buffer_tail = 0u;
-static uint32_t kernel_ring_buffer_count = 0u;
-static KernelRingBufferMode_t kernel_ring_buffer_mode = KERNEL_RING_BUFFER_MODE_LOCAL;
-static uint32_t kernel_ring_buffer_high_watermark = 0u;
-static uint32_t kernel_ring_buffer_enqueue_count = 0u;
-static uint32_t kernel_ring_buffer_dequeue_count = 0u;
-static uint32_t kernel_ring_buffer_failed_enqueue_count = 0u;
-static uint32_t kernel_ring_buffer_failed_dequeue_count = 0u;
+static KernelRing_t kernel_ring_buffer_default;
 static bool kernel_ring_buffer_initialized = false;
 
 static uint32_t kernel_ring_buffer_align_up(uint32_t value, uint32_t align)
@@ -25,112 +14,405 @@ static uint32_t kernel_ring_buffer_align_up(uint32_t value, uint32_t align)
     return (value + (align - 1u)) & ~(align - 1u);
 }
 
-bool kernel_ring_buffer_initialize(uint32_t slot_size, uint32_t slot_count)
+static uint32_t kernel_ring_round_up_power_of_two(uint32_t value)
 {
-    return kernel_ring_buffer_initialize_ex(slot_size, slot_count, KERNEL_RING_BUFFER_MODE_LOCAL);
+    uint32_t rounded = 2u;
+
+    while (rounded < value && rounded < 0x80000000u)
+        rounded <<= 1;
+    return rounded;
 }
 
-bool kernel_ring_buffer_initialize_ex(uint32_t slot_size, uint32_t slot_count, KernelRingBufferMode_t mode)
+static uint32_t kernel_ring_backpressure_drops(const void *instance)
 {
-    if (kernel_ring_buffer_initialized)
-        return true;
+    return ((const KernelRing_t *) instance)->failed_enqueue_count;
+}
+
+static bool kernel_ring_producers_shared(const KernelRing_t *ring)
+{
+    return ring->mode == KERNEL_RING_BUFFER_MODE_MPSC || ring->mode == KERNEL_RING_BUFFER_MODE_MPMC;
+}
+
+static bool kernel_ring_consumers_shared(const KernelRing_t *ring) { return ring->mode == KERNEL_RING_BUFFER_MODE_MPMC; }
+
+/*
+ * Claim up to @p want slots at @p cursor. A slot at position p is ready for
+ * this side when its sequence reads p + @p lag (0 for producers, 1 for
+ * consumers). The run of ready slots is measured with plain loads, then taken
+ * with one store (exclusive side) or one CAS (shared side); a CAS that loses
+ * the race re-measures from the winner's cursor.
+ */
+static uint32_t kernel_ring_claim(KernelRing_t *ring, volatile uint32_t *cursor, uint32_t want, uint32_t lag,
+                                  bool shared, uint32_t *position)
+{
+    uint32_t pos = __atomic_load_n(cursor, __ATOMIC_RELAXED);
+
+    for (;;)
+    {
+        uint32_t ready = 0u;
+
+        while (ready < want &&
+               __atomic_load_n(&ring->cells[(pos + ready) & ring->mask].sequence, __ATOMIC_ACQUIRE) ==
+                   pos + ready + lag)
+            ++ready;
+
+        if (ready == 0u)
+        {
+            const uint32_t sequence = __atomic_load_n(&ring->cells[pos & ring->mask].sequence, __ATOMIC_ACQUIRE);
+
+            /* Behind: the slot is still a lap old, so the ring is full (or empty). */
+            if (!shared || (int32_t) (sequence - (pos + lag)) < 0)
+                return 0u;
 
-    if (slot_size == 0u || slot_count == 0u)
+            /* Ahead: another claimant took this position already. */
+            pos = __atomic_load_n(cursor, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        if (!shared)
+        {
+            __atomic_store_n(cursor, pos + ready, __ATOMIC_RELAXED);
+            *position = pos;
+            return ready;
+        }
+
+        if (__atomic_compare_exchange_n(cursor, &pos, pos + ready, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+            *position = pos;
+            return ready;
+        }
+    }
+}
+
+static void kernel_ring_note_occupancy(KernelRing_t *ring, uint32_t end)
+{
+    const uint32_t occupancy = end - __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+    /* A racy maximum: a lost update only under-reports a peak by a slot or two. */
+    if (occupancy > ring->high_watermark && occupancy <= ring->mask + 1u)
+        ring->high_watermark = occupancy;
+}
+
+bool kernel_ring_initialize(KernelRing_t *ring, const char *name, uint32_t slot_size, uint32_t slot_count,
+                            KernelRingBufferMode_t mode, KernelBackpressurePolicy_t policy)
+{
+    if (!ring || !name || slot_size == 0u || slot_count == 0u || slot_count > 0x80000000u)
         return false;
 
-    kernel_ring_buffer_slot_size = kernel_ring_buffer_align_up(slot_size, 8u);
-    kernel_ring_buffer_capacity = slot_count;
+    const uint32_t capacity = kernel_ring_round_up_power_of_two(slot_count);
+    const uint32_t aligned_slot_size = kernel_ring_buffer_align_up(slot_size, 8u);
+    const uint32_t cells_size = capacity * (uint32_t) sizeof(KernelRingCell_t);
 
-    void *backing = kmalloc((size_t) (kernel_ring_buffer_slot_size * slot_count));
+    void *backing = kmalloc((size_t) cells_size + (size_t) aligned_slot_size * capacity);
     if (!backing)
         return false;
 
-    kernel_ring_buffer_base = (uint8_t *) backing;
-    kernel_ring_buffer_head = 0u;
-    kernel_ring_buffer_tail = 0u;
-    kernel_ring_buffer_count = 0u;
-    kernel_ring_buffer_mode = mode;
-    kernel_ring_buffer_high_watermark = 0u;
-    kernel_ring_buffer_enqueue_count = 0u;
-    kernel_ring_buffer_dequeue_count = 0u;
-    kernel_ring_buffer_failed_enqueue_count = 0u;
-    kernel_ring_buffer_failed_dequeue_count = 0u;
-    kernel_ring_buffer_initialized = true;
+    ring->cells = (KernelRingCell_t *) backing;
+    ring->slots = (uint8_t *) backing + cells_size;
+    ring->name = name;
+    ring->mask = capacity - 1u;
+    ring->slot_size = aligned_slot_size;
+    ring->mode = mode;
+    ring->high_watermark = 0u;
+    ring->failed_enqueue_count = 0u;
+    ring->failed_dequeue_count = 0u;
+    ring->owns_ring = false;
+    ring->head = 0u;
+    ring->tail = 0u;
+
+    for (uint32_t i = 0u; i < capacity; ++i)
+    {
+        ring->cells[i].sequence = i;
+        ring->cells[i].length = 0u;
+    }
+
+    /* A full registry leaves the ring usable, just unlisted. */
+    kernel_backpressure_register_instance(name, policy, capacity, kernel_ring_backpressure_drops, ring);
     return true;
 }
 
-bool kernel_ring_buffer_enqueue(const void *data, uint32_t size)
+KernelRing_t *kernel_ring_create(const char *name, uint32_t slot_size, uint32_t slot_count, KernelRingBufferMode_t mode,
+                                 KernelBackpressurePolicy_t policy)
 {
-    if (!kernel_ring_buffer_initialized || !data || size == 0u || size > kernel_ring_buffer_slot_size)
+    /* kmalloc aligns to 8 and the cursors want 64: over-allocate and align by hand. */
+    uint8_t *raw = (uint8_t *) kmalloc(sizeof(KernelRing_t) + 64u);
+
+    if (!raw)
+        return NULL;
+
+    KernelRing_t *ring = (KernelRing_t *) kernel_ring_buffer_align_up((uint32_t) (uintptr_t) (raw + 1), 64u);
+    ((void **) ring)[-1] = raw;
+
+    if (!kernel_ring_initialize(ring, name, slot_size, slot_count, mode, policy))
     {
-        if (kernel_ring_buffer_initialized)
-            ++kernel_ring_buffer_failed_enqueue_count;
-        return false;
+        kfree(raw);
+        return NULL;
     }
 
-    if (kernel_ring_buffer_count >= kernel_ring_buffer_capacity)
+    ring->owns_ring = true;
+    return ring;
+}
+
+void kernel_ring_destroy(KernelRing_t *ring)
+{
+    if (!ring || !ring->cells)
+        return;
+
+    kernel_backpressure_unregister_instance(ring);
+    kfree(ring->cells);
+    ring->cells = NULL;
+    ring->slots = NULL;
+
+    if (ring->owns_ring)
+        kfree(((void **) ring)[-1]);
+}
+
+void *kernel_ring_reserve(KernelRing_t *ring, uint32_t *position)
+{
+    KernelRingBatch_t batch;
+
+    if (!kernel_ring_reserve_batch(ring, 1u, &batch))
+        return NULL;
+
+    *position = batch.position;
+    return ring->slots + (batch.position & ring->mask) * ring->slot_size;
+}
+
+void kernel_ring_commit(KernelRing_t *ring, uint32_t position, uint32_t length)
+{
+    KernelRingCell_t *cell = &ring->cells[position & ring->mask];
+
+    cell->length = length;
+    __atomic_store_n(&cell->sequence, position + 1u, __ATOMIC_RELEASE);
+}
+
+const void *kernel_ring_acquire(KernelRing_t *ring, uint32_t *position, uint32_t *length)
+{
+    KernelRingBatch_t batch;
+
+    if (!kernel_ring_acquire_batch(ring, 1u, &batch))
+        return NULL;
+
+    *position = batch.position;
+    if (length)
+        *length = ring->cells[batch.position & ring->mask].length;
+    return ring->slots + (batch.position & ring->mask) * ring->slot_size;
+}
+
+void kernel_ring_release(KernelRing_t *ring, uint32_t position)
+{
+    __atomic_store_n(&ring->cells[position & ring->mask].sequence, position + ring->mask + 1u, __ATOMIC_RELEASE);
+}
+
+uint32_t kernel_ring_reserve_batch(KernelRing_t *ring, uint32_t count, KernelRingBatch_t *batch)
+{
+    batch->count = 0u;
+    if (count == 0u)
+        return 0u;
+
+    batch->count =
+        kernel_ring_claim(ring, &ring->tail, count, 0u, kernel_ring_producers_shared(ring), &batch->position);
+    if (batch->count == 0u)
     {
-        ++kernel_ring_buffer_failed_enqueue_count;
-        return false;
+        __atomic_fetch_add(&ring->failed_enqueue_count, 1u, __ATOMIC_RELAXED);
+        return 0u;
     }
 
-    uint8_t *slot = kernel_ring_buffer_base + (kernel_ring_buffer_tail * kernel_ring_buffer_slot_size);
-    memset(slot, 0, kernel_ring_buffer_slot_size);
-    memcpy(slot, data, size);
+    kernel_ring_note_occupancy(ring, batch->position + batch->count);
+    return batch->count;
+}
 
-    uint32_t current_tail = __atomic_load_n(&kernel_ring_buffer_tail, __ATOMIC_ACQUIRE);
-    uint32_t next_tail = (current_tail + 1u) % kernel_ring_buffer_capacity;
-    __atomic_store_n(&kernel_ring_buffer_tail, next_tail, __ATOMIC_RELEASE);
-    __atomic_add_fetch(&kernel_ring_buffer_count, 1u, __ATOMIC_ACQ_REL);
-    __atomic_add_fetch(&kernel_ring_buffer_enqueue_count, 1u, __ATOMIC_ACQ_REL);
-    if (kernel_ring_buffer_count > kernel_ring_buffer_high_watermark)
-        kernel_ring_buffer_high_watermark = kernel_ring_buffer_count;
+void kernel_ring_commit_batch(KernelRing_t *ring, const KernelRingBatch_t *batch, uint32_t length)
+{
+    for (uint32_t i = 0u; i < batch->count; ++i)
+        kernel_ring_commit(ring, batch->position + i, length);
+}
 
-    return true;
+uint32_t kernel_ring_acquire_batch(KernelRing_t *ring, uint32_t count, KernelRingBatch_t *batch)
+{
+    batch->count = 0u;
+    if (count == 0u)
+        return 0u;
+
+    batch->count =
+        kernel_ring_claim(ring, &ring->head, count, 1u, kernel_ring_consumers_shared(ring), &batch->position);
+    if (batch->count == 0u)
+        __atomic_fetch_add(&ring->failed_dequeue_count, 1u, __ATOMIC_RELAXED);
+    return batch->count;
 }
 
-bool kernel_ring_buffer_dequeue(void *out_data, uint32_t out_size)
+void kernel_ring_release_batch(KernelRing_t *ring, const KernelRingBatch_t *batch)
 {
-    if (!kernel_ring_buffer_initialized || !out_data || out_size == 0u || out_size > kernel_ring_buffer_slot_size)
+    for (uint32_t i = 0u; i < batch->count; ++i)
+        kernel_ring_release(ring, batch->position + i);
+}
+
+void *kernel_ring_batch_slot(const KernelRing_t *ring, const KernelRingBatch_t *batch, uint32_t index)
+{
+    if (index >= batch->count)
+        return NULL;
+
+    return ring->slots + ((batch->position + index) & ring->mask) * ring->slot_size;
+}
+
+bool kernel_ring_enqueue(KernelRing_t *ring, const void *data, uint32_t size)
+{
+    if (!ring || !ring->cells || !data || size == 0u || size > ring->slot_size)
     {
-        if (kernel_ring_buffer_initialized)
-            ++kernel_ring_buffer_failed_dequeue_count;
+        if (ring && ring->cells)
+            __atomic_fetch_add(&ring->failed_enqueue_count, 1u, __ATOMIC_RELAXED);
         return false;
     }
 
-    if (kernel_ring_buffer_count == 0u)
+    uint32_t position;
+    void *slot = kernel_ring_reserve(ring, &position);
+
+    if (!slot)
+        return false;
+
+    memcpy(slot, data, size);
+    kernel_ring_commit(ring, position, size);
+    return true;
+}
+
+bool kernel_ring_dequeue(KernelRing_t *ring, void *out_data, uint32_t out_size)
+{
+    if (!ring || !ring->cells || !out_data || out_size == 0u || out_size > ring->slot_size)
     {
-        ++kernel_ring_buffer_failed_dequeue_count;
+        if (ring && ring->cells)
+            __atomic_fetch_add(&ring->failed_dequeue_count, 1u, __ATOMIC_RELAXED);
         return false;
     }
 
-    uint8_t *slot = kernel_ring_buffer_base + (kernel_ring_buffer_head * kernel_ring_buffer_slot_size);
-    memcpy(out_data, slot, out_size);
+    uint32_t position;
+    uint32_t length;
+    const void *slot = kernel_ring_acquire(ring, &position, &length);
+
+    if (!slot)
+        return false;
+
+    /* Only the committed bytes are meaningful; the rest of the slot is
+       whatever an earlier lap left there. */
+    if (length > out_size)
+        length = out_size;
+    memcpy(out_data, slot, length);
+    if (length < out_size)
+        memset((uint8_t *) out_data + length, 0, out_size - length);
+
+    kernel_ring_release(ring, position);
+    return true;
+}
+
+uint32_t kernel_ring_enqueue_batch(KernelRing_t *ring, const void *items, uint32_t item_size, uint32_t count)
+{
+    KernelRingBatch_t batch;
+
+    if (!ring || !ring->cells || !items || item_size == 0u || item_size > ring->slot_size)
+        return 0u;
+
+    if (!kernel_ring_reserve_batch(ring, count, &batch))
+        return 0u;
+
+    for (uint32_t i = 0u; i < batch.count; ++i)
+        memcpy(kernel_ring_batch_slot(ring, &batch, i), (const uint8_t *) items + i * item_size, item_size);
+
+    kernel_ring_commit_batch(ring, &batch, item_size);
+    return batch.count;
+}
+
+uint32_t kernel_ring_dequeue_batch(KernelRing_t *ring, void *items, uint32_t item_size, uint32_t count)
+{
+    KernelRingBatch_t batch;
+
+    if (!ring || !ring->cells || !items || item_size == 0u || item_size > ring->slot_size)
+        return 0u;
+
+    if (!kernel_ring_acquire_batch(ring, count, &batch))
+        return 0u;
+
+    for (uint32_t i = 0u; i < batch.count; ++i)
+        memcpy((uint8_t *) items + i * item_size, kernel_ring_batch_slot(ring, &batch, i), item_size);
+
+    kernel_ring_release_batch(ring, &batch);
+    return batch.count;
+}
+
+uint32_t kernel_ring_get_capacity(const KernelRing_t *ring) { return ring->cells ? ring->mask + 1u : 0u; }
+
+uint32_t kernel_ring_get_count(const KernelRing_t *ring)
+{
+    const uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    const uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+    return tail - head;
+}
+
+uint32_t kernel_ring_get_enqueue_count(const KernelRing_t *ring) { return ring->tail; }
+
+uint32_t kernel_ring_get_dequeue_count(const KernelRing_t *ring) { return ring->head; }
+
+uint32_t kernel_ring_get_failed_enqueue_count(const KernelRing_t *ring) { return ring->failed_enqueue_count; }
+
+uint32_t kernel_ring_get_failed_dequeue_count(const KernelRing_t *ring) { return ring->failed_dequeue_count; }
+
+uint32_t kernel_ring_get_high_watermark(const KernelRing_t *ring) { return ring->high_watermark; }
+
+KernelRing_t *kernel_ring_buffer_get_default(void)
+{
+    return kernel_ring_buffer_initialized ? &kernel_ring_buffer_default : NULL;
+}
+
+bool kernel_ring_buffer_initialize(uint32_t slot_size, uint32_t slot_count)
+{
+    return kernel_ring_buffer_initialize_ex(slot_size, slot_count, KERNEL_RING_BUFFER_MODE_LOCAL);
+}
+
+bool kernel_ring_buffer_initialize_ex(uint32_t slot_size, uint32_t slot_count, KernelRingBufferMode_t mode)
+{
+    if (kernel_ring_buffer_initialized)
+        return true;
 
-    uint32_t current_head = __atomic_load_n(&kernel_ring_buffer_head, __ATOMIC_ACQUIRE);
-    uint32_t next_head = (current_head + 1u) % kernel_ring_buffer_capacity;
-    __atomic_store_n(&kernel_ring_buffer_head, next_head, __ATOMIC_RELEASE);
-    __atomic_sub_fetch(&kernel_ring_buffer_count, 1u, __ATOMIC_ACQ_REL);
-    __atomic_add_fetch(&kernel_ring_buffer_dequeue_count, 1u, __ATOMIC_ACQ_REL);
+    /* The general-purpose ring carries whole records, so a refused enqueue loses one
+       record and leaves the others intact. Its counter is also raised on purpose by
+       the ring smoke, which is exactly why it must not be counted as corrupting. */
+    if (!kernel_ring_initialize(&kernel_ring_buffer_default, "kernel_ring", slot_size, slot_count, mode,
+                                KERNEL_BACKPRESSURE_POLICY_DROP_TOLERATED))
+        return false;
+
+    kernel_ring_buffer_initialized = true;
     return true;
 }
 
+bool kernel_ring_buffer_enqueue(const void *data, uint32_t size)
+{
+    if (!kernel_ring_buffer_initialized)
+        return false;
+    return kernel_ring_enqueue(&kernel_ring_buffer_default, data, size);
+}
+
+bool kernel_ring_buffer_dequeue(void *out_data, uint32_t out_size)
+{
+    if (!kernel_ring_buffer_initialized)
+        return false;
+    return kernel_ring_dequeue(&kernel_ring_buffer_default, out_data, out_size);
+}
+
 bool kernel_ring_buffer_is_initialized(void) { return kernel_ring_buffer_initialized; }
 
-uint32_t kernel_ring_buffer_get_slot_size(void) { return kernel_ring_buffer_slot_size; }
+uint32_t kernel_ring_buffer_get_slot_size(void) { return kernel_ring_buffer_default.slot_size; }
 
-uint32_t kernel_ring_buffer_get_capacity(void) { return kernel_ring_buffer_capacity; }
+uint32_t kernel_ring_buffer_get_capacity(void) { return kernel_ring_get_capacity(&kernel_ring_buffer_default); }
 
-uint32_t kernel_ring_buffer_get_count(void) { return kernel_ring_buffer_count; }
+uint32_t kernel_ring_buffer_get_count(void) { return kernel_ring_get_count(&kernel_ring_buffer_default); }
 
-KernelRingBufferMode_t kernel_ring_buffer_get_mode(void) { return kernel_ring_buffer_mode; }
+KernelRingBufferMode_t kernel_ring_buffer_get_mode(void) { return kernel_ring_buffer_default.mode; }
 
-uint32_t kernel_ring_buffer_get_high_watermark(void) { return kernel_ring_buffer_high_watermark; }
+uint32_t kernel_ring_buffer_get_high_watermark(void) { return kernel_ring_buffer_default.high_watermark; }
 
-uint32_t kernel_ring_buffer_get_enqueue_count(void) { return kernel_ring_buffer_enqueue_count; }
+uint32_t kernel_ring_buffer_get_enqueue_count(void) { return kernel_ring_buffer_default.tail; }
 
-uint32_t kernel_ring_buffer_get_dequeue_count(void) { return kernel_ring_buffer_dequeue_count; }
+uint32_t kernel_ring_buffer_get_dequeue_count(void) { return kernel_ring_buffer_default.head; }
 
-uint32_t kernel_ring_buffer_get_failed_enqueue_count(void) { return kernel_ring_buffer_failed_enqueue_count; }
+uint32_t kernel_ring_buffer_get_failed_enqueue_count(void) { return kernel_ring_buffer_default.failed_enqueue_count; }
 
-uint32_t kernel_ring_buffer_get_failed_dequeue_count(void) { return kernel_ring_buffer_failed_dequeue_count; }
+uint32_t kernel_ring_buffer_get_failed_dequeue_count(void) { return kernel_ring_buffer_default.failed_dequeue_count; }
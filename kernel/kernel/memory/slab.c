@@ -1,221 +1,667 @@
 #define __LPL_KERNEL__
 
+#include <kernel/config.h>
+#include <kernel/core/lock.h>
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/cpu/paging.h>
+#include <kernel/cpu/pmm.h>
+#include <kernel/diag/telemetry.h>
 #include <kernel/memory/slab.h>
 #include <stddef.h>
 
 /*
  * Implementation layout
  * ─────────────────────
- * Each cache owns a singly-linked free-list of same-sized objects.
- * The free-list node is stored *inside* the object slot (the first
- * sizeof(void*) bytes of a free slot hold the next pointer).  This
- * means no extra header memory per object.
+ * The reserve is one buddy block, so the page an object lives in is an
+ * index into it and slab_page_owner[] names the cache that owns the page:
+ * finding an object's cache, or rejecting a foreign pointer, is O(1).
  *
- * SERVER profile: every exported function is a one-liner stub.  The
- * linker discards the slab data entirely on server builds.
+ * A free object on the shared list stores the next pointer, then
+ * SLAB_FREE_COOKIE, at link_offset. Without a constructor link_offset is 0
+ * and the words live inside the object, so small objects cost no extra
+ * memory. With one, they go in a trailer after the object, so the
+ * constructed state survives a free/alloc round trip untouched.
+ *
+ * Objects parked in a per-CPU stack carry the cookie but no link.
  */
 
-#ifdef LPL_KERNEL_REAL_TIME_MODE
-
-/* ------------------------------------------------------------------ */
-/* CLIENT implementation                                              */
-/* ------------------------------------------------------------------ */
-
 /*
  * Anti-double-free guard.
- * When a slot is placed on the free-list we write SLAB_FREE_COOKIE
- * into the word immediately after the next pointer.
- * kernel_slab_free() checks this: if the cookie is already present
- * the object is already free (double-free) -> reject, return false.
- * kernel_slab_alloc() clears the cookie on allocation.
+ * Freeing exchanges SLAB_FREE_COOKIE into the cookie word; finding it
+ * already there means the object was free (double-free) -> reject.
+ * Allocation clears the cookie.
  */
-#    define SLAB_FREE_COOKIE 0x534C4131u /* 'SLA1' */
-
-#    define SLAB_NUM_CACHES 3u
-
-typedef struct {
-    uint32_t object_size; /* bytes per object                        */
-    void *free_head;      /* head of the free-list (NULL == full)    */
-    uint32_t free_count;  /* objects currently on the free-list      */
-    uint32_t used_count;  /* objects currently live                  */
-    uintptr_t base;       /* virtual address of the first owned page */
-    uintptr_t end;        /* first byte past the owned pages         */
-} KernelSlabCache_t;
-
-static KernelSlabCache_t slab_caches[SLAB_NUM_CACHES] = {
-    {KERNEL_SLAB_SIZE_SMALL,  NULL, 0u, 0u, 0u, 0u},
-    {KERNEL_SLAB_SIZE_MEDIUM, NULL, 0u, 0u, 0u, 0u},
-    {KERNEL_SLAB_SIZE_LARGE,  NULL, 0u, 0u, 0u, 0u},
+#define SLAB_FREE_COOKIE 0x534C4131u /* 'SLA1' */
+
+#define SLAB_POISON_CANARY    0xC001CAFEu
+#define SLAB_PAGE_SIZE        ((uint32_t) PAGE_SIZE)
+#define SLAB_PAGE_SHIFT       12u
+#define SLAB_PAGE_UNOWNED     0xFFu
+#define SLAB_DEFAULT_ALIGN    8u
+#define SLAB_KMALLOC_CLASSES  13u
+#define SLAB_KMALLOC_GRANULE  8u
+#define SLAB_KMALLOC_MAX_SLOT (KERNEL_SLAB_KMALLOC_MAX_SIZE / SLAB_KMALLOC_GRANULE)
+
+typedef struct KernelSlabCpuCache {
+    uint32_t count;
+    void *objects[KERNEL_SLAB_CPU_CACHE_DEPTH];
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t allocations;
+    uint32_t frees;
+    uint32_t wcet_alloc;
+    uint32_t wcet_free;
+} __attribute__((aligned(64))) KernelSlabCpuCache_t;
+
+struct KernelSlabCache {
+    const char *name;
+    KernelSlabConstructor_t ctor;
+    uint32_t object_size;
+    uint32_t align;
+    uint32_t stride;
+    uint32_t link_offset;
+    bool in_use;
+
+    /* Shared free-list and growth, under lock. */
+    KernelTicketLock_t lock;
+    void *free_head;
+    uint32_t free_count;
+    uint32_t pages;
+    uint32_t objects;
+    uint32_t grows;
+    uint32_t alloc_failures;
+    volatile uint32_t rejected_frees;
+
+    KernelSlabCpuCache_t cpu[CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC];
 };
 
-/*
- * Carve all objects from a donated page into a cache's free-list.
- * page_virt must be a valid, mapped virtual address.
- */
-static void slab_cache_populate(KernelSlabCache_t *cache, void *page_virt, uint32_t page_size)
-{
-    uint32_t obj_size = cache->object_size;
-    uint8_t *cursor = (uint8_t *) page_virt;
-    uint8_t *page_end = cursor + page_size;
-    uint32_t stride = obj_size;
-#    ifdef LPL_KERNEL_DEBUG_POISON
-    stride += sizeof(uint32_t);
-    stride = (stride + 7u) & ~7u;
-#    endif
-
-    if (cache->base == 0u || (uintptr_t) page_virt < cache->base)
-        cache->base = (uintptr_t) page_virt;
-    if ((uintptr_t) page_end > cache->end)
-        cache->end = (uintptr_t) page_end;
-
-    while ((cursor + stride) <= page_end)
-    {
-        void **slot = (void **) cursor;
-        *slot = cache->free_head;
-        *((uint32_t *) (cursor + sizeof(void *))) = SLAB_FREE_COOKIE;
-#    ifdef LPL_KERNEL_DEBUG_POISON
-        *((uint32_t *) (cursor + obj_size)) = 0xC001CAFEu;
-#    endif
-        cache->free_head = cursor;
-        ++cache->free_count;
-        cursor += stride;
-    }
+static KernelSlabCache_t slab_caches[KERNEL_SLAB_MAX_CACHES];
+
+/* Guards the cache table and the reserve's free stack. */
+static KernelTicketLock_t slab_global_lock;
+
+static uintptr_t slab_reserve_base = 0u;
+static uintptr_t slab_reserve_end = 0u;
+static uint32_t slab_reserve_pages = 0u;
+static uint8_t slab_page_owner[KERNEL_SLAB_RESERVE_PAGES];
+static uint8_t slab_reserve_free_stack[KERNEL_SLAB_RESERVE_PAGES];
+static uint32_t slab_reserve_free_count = 0u;
+static bool slab_initialized = false;
+
+/* Roughly geometric: every step is x1.5 or x1.33, never more than a third wasted. */
+static const uint32_t slab_kmalloc_sizes[SLAB_KMALLOC_CLASSES] = {16u,  24u,  32u,  48u,  64u,  96u,  128u,
+                                                                  192u, 256u, 384u, 512u, 768u, 1024u};
+static const char *const slab_kmalloc_names[SLAB_KMALLOC_CLASSES] = {
+    "kmalloc-16",  "kmalloc-24",  "kmalloc-32",  "kmalloc-48",  "kmalloc-64",  "kmalloc-96",  "kmalloc-128",
+    "kmalloc-192", "kmalloc-256", "kmalloc-384", "kmalloc-512", "kmalloc-768", "kmalloc-1024"};
+static KernelSlabCache_t *slab_kmalloc_caches[SLAB_KMALLOC_CLASSES];
+/* Class of a request, by its size in granules rounded up. */
+static uint8_t slab_kmalloc_index[SLAB_KMALLOC_MAX_SLOT + 1u];
+
+static inline uint32_t slab_rdtsc_low(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t lo;
+    asm volatile("rdtsc" : "=a"(lo)::"edx");
+    return lo;
+#else
+    return 0u;
+#endif
+}
+
+/* No interrupts in the host replay build (tools/heap-replay). */
+#ifdef LPL_KERNEL_HOST_REPLAY
+static inline uint32_t slab_irq_save(void) { return 0u; }
+
+static inline void slab_irq_restore(uint32_t eflags) { (void) eflags; }
+#else
+static inline uint32_t slab_irq_save(void)
+{
+    uint32_t eflags;
+    __asm__ volatile("pushf\n\tpop %0\n\tcli" : "=r"(eflags)::"memory");
+    return eflags;
+}
+
+static inline void slab_irq_restore(uint32_t eflags)
+{
+    __asm__ volatile("push %0\n\tpopf" ::"r"(eflags) : "memory", "cc");
+}
+#endif
+
+static uint32_t slab_align_up(uint32_t value, uint32_t align) { return (value + (align - 1u)) & ~(align - 1u); }
+
+static inline void **slab_link(const KernelSlabCache_t *cache, void *object)
+{
+    return (void **) ((uint8_t *) object + cache->link_offset);
+}
+
+static inline uint32_t *slab_cookie(const KernelSlabCache_t *cache, void *object)
+{
+    return (uint32_t *) ((uint8_t *) object + cache->link_offset + sizeof(void *));
+}
+
+static inline uint32_t slab_cache_index(const KernelSlabCache_t *cache) { return (uint32_t) (cache - slab_caches); }
+
+static KernelSlabCpuCache_t *slab_local(KernelSlabCache_t *cache)
+{
+    uint32_t slot = cpu_topology_get_logical_slot();
+
+    if (slot >= CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC)
+        slot = 0u;
+    return &cache->cpu[slot];
 }
 
-void kernel_slab_initialize(void **backing_pages, uint32_t page_count)
+/* ------------------------------------------------------------------ */
+/* Reserve                                                            */
+/* ------------------------------------------------------------------ */
+
+static void slab_reserve_initialize(void)
 {
-#    ifndef PAGE_SIZE
-#        define PAGE_SIZE 4096u
-#    endif
+    uint32_t phys = 0u;
+    uint32_t order = KERNEL_SLAB_RESERVE_ORDER + 1u;
+
+    /* Settle for a smaller block rather than no slab at all. */
+    while (phys == 0u && order > 0u)
+        phys = physical_memory_manager_page_frame_allocate_order((uint8_t) --order);
+
+    for (uint32_t page = 0u; page < KERNEL_SLAB_RESERVE_PAGES; ++page)
+        slab_page_owner[page] = SLAB_PAGE_UNOWNED;
 
-    for (uint32_t i = 0u; i < page_count; ++i)
+    if (phys == 0u)
+        return;
+
+    slab_reserve_pages = 1u << order;
+    slab_reserve_base = (uintptr_t) (phys + KERNEL_VIRTUAL_BASE);
+    slab_reserve_end = slab_reserve_base + (uintptr_t) slab_reserve_pages * SLAB_PAGE_SIZE;
+
+    /* Lowest page on top, so caches fill the reserve from its base. */
+    for (uint32_t index = 0u; index < slab_reserve_pages; ++index)
+        slab_reserve_free_stack[index] = (uint8_t) (slab_reserve_pages - 1u - index);
+    slab_reserve_free_count = slab_reserve_pages;
+}
+
+static uint8_t *slab_reserve_take(uint32_t cache_index)
+{
+    uint8_t *page = NULL;
+
+    kernel_ticket_lock_acquire(&slab_global_lock);
+    if (slab_reserve_free_count > 0u)
     {
-        if (!backing_pages[i])
-            continue;
-        uint32_t cache_index = i % SLAB_NUM_CACHES;
-        slab_cache_populate(&slab_caches[cache_index], backing_pages[i], PAGE_SIZE);
+        uint32_t index = slab_reserve_free_stack[--slab_reserve_free_count];
+        slab_page_owner[index] = (uint8_t) cache_index;
+        page = (uint8_t *) (slab_reserve_base + (uintptr_t) index * SLAB_PAGE_SIZE);
     }
+    kernel_ticket_lock_release(&slab_global_lock);
+
+    return page;
 }
 
-void *kernel_slab_alloc(uint32_t size)
+/* Resolve an object to its cache, or NULL for anything the slab did not hand out. */
+static KernelSlabCache_t *slab_owner_of(const void *object)
+{
+    uintptr_t address = (uintptr_t) object;
+
+    if (address < slab_reserve_base || address >= slab_reserve_end)
+        return NULL;
+
+    uint32_t owner = slab_page_owner[(address - slab_reserve_base) >> SLAB_PAGE_SHIFT];
+    if (owner >= KERNEL_SLAB_MAX_CACHES)
+        return NULL;
+
+    KernelSlabCache_t *cache = &slab_caches[owner];
+    uint32_t offset = (uint32_t) (address & (SLAB_PAGE_SIZE - 1u));
+
+    if (!cache->in_use || (offset % cache->stride) != 0u || offset + cache->stride > SLAB_PAGE_SIZE)
+        return NULL;
+    return cache;
+}
+
+/* ------------------------------------------------------------------ */
+/* Shared free-list (cache lock held, interrupts off)                 */
+/* ------------------------------------------------------------------ */
+
+static bool slab_cache_grow(KernelSlabCache_t *cache)
 {
-    for (uint32_t i = 0u; i < SLAB_NUM_CACHES; ++i)
+    if (cache->pages >= KERNEL_SLAB_CACHE_MAX_PAGES)
+        return false;
+
+    uint8_t *page = slab_reserve_take(slab_cache_index(cache));
+    if (!page)
+        return false;
+
+    for (uint32_t offset = 0u; offset + cache->stride <= SLAB_PAGE_SIZE; offset += cache->stride)
     {
-        if (slab_caches[i].object_size != size)
-            continue;
+        void *object = page + offset;
+
+        if (cache->ctor)
+            cache->ctor(object);
+#ifdef LPL_KERNEL_DEBUG_POISON
+        *((uint32_t *) ((uint8_t *) object + cache->object_size)) = SLAB_POISON_CANARY;
+#endif
+        *slab_link(cache, object) = cache->free_head;
+        *slab_cookie(cache, object) = SLAB_FREE_COOKIE;
+        cache->free_head = object;
+        ++cache->free_count;
+        ++cache->objects;
+    }
 
-        KernelSlabCache_t *cache = &slab_caches[i];
+    ++cache->pages;
+    ++cache->grows;
+    return true;
+}
 
-        if (!cache->free_head)
-            return NULL;
+static void slab_cache_refill(KernelSlabCache_t *cache, KernelSlabCpuCache_t *cpu)
+{
+    kernel_ticket_lock_acquire(&cache->lock);
 
-        void *obj = cache->free_head;
-        cache->free_head = *((void **) obj);
-        *((uint32_t *) ((uint8_t *) obj + sizeof(void *))) = 0u;
+    while (cpu->count < KERNEL_SLAB_CPU_CACHE_BATCH)
+    {
+        if (!cache->free_head && !slab_cache_grow(cache))
+            break;
+
+        void *object = cache->free_head;
+        cache->free_head = *slab_link(cache, object);
         --cache->free_count;
-        ++cache->used_count;
-        return obj;
+        cpu->objects[cpu->count++] = object;
     }
-    return NULL;
+
+    if (cpu->count == 0u)
+        ++cache->alloc_failures;
+
+    kernel_ticket_lock_release(&cache->lock);
 }
 
-bool kernel_slab_free(void *ptr)
+static void slab_cache_flush(KernelSlabCache_t *cache, KernelSlabCpuCache_t *cpu, uint32_t count)
 {
-    if (!ptr)
-        return false;
+    kernel_ticket_lock_acquire(&cache->lock);
+
+    while (count-- > 0u && cpu->count > 0u)
+    {
+        void *object = cpu->objects[--cpu->count];
+        *slab_link(cache, object) = cache->free_head;
+        cache->free_head = object;
+        ++cache->free_count;
+    }
+
+    kernel_ticket_lock_release(&cache->lock);
+}
 
-    uintptr_t addr = (uintptr_t) ptr;
+/* ------------------------------------------------------------------ */
+/* Caches                                                             */
+/* ------------------------------------------------------------------ */
 
-    for (uint32_t i = 0u; i < SLAB_NUM_CACHES; ++i)
+KernelSlabCache_t *kernel_slab_cache_create(const char *name, uint32_t size, uint32_t align,
+                                            KernelSlabConstructor_t ctor)
+{
+    if (!slab_initialized || !name || size == 0u || size > SLAB_PAGE_SIZE)
+        return NULL;
+
+    if (align == 0u)
+        align = SLAB_DEFAULT_ALIGN;
+    if ((align & (align - 1u)) != 0u || align > SLAB_PAGE_SIZE)
+        return NULL;
+    if (align < sizeof(void *))
+        align = sizeof(void *);
+
+    uint32_t object_size = size;
+    uint32_t link_offset = 0u;
+    uint32_t tail = 0u;
+#ifdef LPL_KERNEL_DEBUG_POISON
+    tail = sizeof(uint32_t);
+#endif
+
+    uint32_t stride;
+    if (ctor)
+    {
+        link_offset = slab_align_up(object_size + tail, sizeof(void *));
+        stride = slab_align_up(link_offset + sizeof(void *) + sizeof(uint32_t), align);
+    }
+    else
     {
-        KernelSlabCache_t *cache = &slab_caches[i];
+        if (object_size < sizeof(void *) + sizeof(uint32_t))
+            object_size = sizeof(void *) + sizeof(uint32_t);
+        stride = slab_align_up(object_size + tail, align);
+    }
 
-        if (addr < cache->base || addr >= cache->end)
-            continue;
+    if (stride > SLAB_PAGE_SIZE)
+        return NULL;
+
+    KernelSlabCache_t *cache = NULL;
+    uint32_t eflags = kernel_ticket_lock_acquire_irqsave(&slab_global_lock);
 
-        uint32_t stride = cache->object_size;
-#    ifdef LPL_KERNEL_DEBUG_POISON
-        stride += sizeof(uint32_t);
-        stride = (stride + 7u) & ~7u;
-#    endif
-        if ((addr - cache->base) % stride != 0u)
+    for (uint32_t index = 0u; index < KERNEL_SLAB_MAX_CACHES; ++index)
+    {
+        if (slab_caches[index].in_use)
             continue;
 
-#    ifdef LPL_KERNEL_DEBUG_POISON
-        uint32_t *end_canary = (uint32_t *) ((uint8_t *) ptr + cache->object_size);
-        if (*end_canary != 0xC001CAFEu)
-            return false;
-#    endif
+        cache = &slab_caches[index];
+        cache->name = name;
+        cache->ctor = ctor;
+        cache->object_size = object_size;
+        cache->align = align;
+        cache->stride = stride;
+        cache->link_offset = link_offset;
+        cache->free_head = NULL;
+        cache->free_count = 0u;
+        cache->pages = 0u;
+        cache->objects = 0u;
+        cache->grows = 0u;
+        cache->alloc_failures = 0u;
+        cache->rejected_frees = 0u;
+        kernel_ticket_lock_initialize(&cache->lock, NULL);
+
+        for (uint32_t slot = 0u; slot < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++slot)
+        {
+            KernelSlabCpuCache_t *cpu = &cache->cpu[slot];
+
+            cpu->count = 0u;
+            cpu->hits = 0u;
+            cpu->misses = 0u;
+            cpu->allocations = 0u;
+            cpu->frees = 0u;
+            cpu->wcet_alloc = 0u;
+            cpu->wcet_free = 0u;
+        }
+
+        cache->in_use = true;
+        break;
+    }
 
-        uint32_t *cookie_word = (uint32_t *) ((uint8_t *) ptr + sizeof(void *));
-        if (*cookie_word == SLAB_FREE_COOKIE)
+    kernel_ticket_lock_release_irqrestore(&slab_global_lock, eflags);
+    return cache;
+}
+
+bool kernel_slab_cache_destroy(KernelSlabCache_t *cache)
+{
+    KernelSlabCacheStatistics_t statistics;
+
+    if (!cache || !cache->in_use)
+        return false;
+
+    for (uint32_t index = 0u; index < SLAB_KMALLOC_CLASSES; ++index)
+    {
+        if (slab_kmalloc_caches[index] == cache)
             return false;
+    }
 
-        *((void **) ptr) = cache->free_head;
-        *cookie_word = SLAB_FREE_COOKIE;
-        cache->free_head = ptr;
-        ++cache->free_count;
-        if (cache->used_count > 0u)
-            --cache->used_count;
-        return true;
+    kernel_slab_cache_get_statistics(cache, &statistics);
+    if (statistics.used != 0u)
+        return false;
+
+    const uint32_t cache_index = slab_cache_index(cache);
+    uint32_t eflags = kernel_ticket_lock_acquire_irqsave(&slab_global_lock);
+
+    cache->in_use = false;
+    for (uint32_t page = 0u; page < slab_reserve_pages; ++page)
+    {
+        if (slab_page_owner[page] != cache_index)
+            continue;
+        slab_page_owner[page] = SLAB_PAGE_UNOWNED;
+        slab_reserve_free_stack[slab_reserve_free_count++] = (uint8_t) page;
     }
-    return false;
+
+    kernel_ticket_lock_release_irqrestore(&slab_global_lock, eflags);
+    return true;
 }
 
-uint32_t kernel_slab_get_free_count(uint32_t object_size)
+bool kernel_slab_cache_prefill(KernelSlabCache_t *cache, uint32_t objects)
 {
-    for (uint32_t i = 0u; i < SLAB_NUM_CACHES; ++i)
+    if (!cache || !cache->in_use)
+        return false;
+
+    uint32_t eflags = kernel_ticket_lock_acquire_irqsave(&cache->lock);
+
+    while (cache->free_count < objects && slab_cache_grow(cache))
+        ;
+    const bool reached = cache->free_count >= objects;
+
+    kernel_ticket_lock_release_irqrestore(&cache->lock, eflags);
+    return reached;
+}
+
+void *kernel_slab_cache_alloc(KernelSlabCache_t *cache)
+{
+    uint32_t t0 = slab_rdtsc_low();
+
+    if (!cache || !cache->in_use)
+        return NULL;
+
+    uint32_t eflags = slab_irq_save();
+    KernelSlabCpuCache_t *cpu = slab_local(cache);
+    void *object = NULL;
+
+    if (cpu->count > 0u)
+        ++cpu->hits;
+    else
     {
-        if (slab_caches[i].object_size == object_size)
-            return slab_caches[i].free_count;
+        ++cpu->misses;
+        slab_cache_refill(cache, cpu);
     }
-    return 0u;
+
+    if (cpu->count > 0u)
+    {
+        object = cpu->objects[--cpu->count];
+        *slab_cookie(cache, object) = 0u;
+        ++cpu->allocations;
+    }
+
+    uint32_t delta = slab_rdtsc_low() - t0;
+    if (delta > cpu->wcet_alloc)
+        cpu->wcet_alloc = delta;
+
+    slab_irq_restore(eflags);
+    return object;
 }
 
-uint32_t kernel_slab_get_used_count(uint32_t object_size)
+bool kernel_slab_cache_free(KernelSlabCache_t *cache, void *object)
 {
-    for (uint32_t i = 0u; i < SLAB_NUM_CACHES; ++i)
+    uint32_t t0 = slab_rdtsc_low();
+
+    if (!cache || !object)
+        return false;
+
+    if (slab_owner_of(object) != cache)
     {
-        if (slab_caches[i].object_size == object_size)
-            return slab_caches[i].used_count;
+        __atomic_add_fetch(&cache->rejected_frees, 1u, __ATOMIC_RELAXED);
+        return false;
     }
-    return 0u;
+
+#ifdef LPL_KERNEL_DEBUG_POISON
+    if (*((uint32_t *) ((uint8_t *) object + cache->object_size)) != SLAB_POISON_CANARY)
+    {
+        __atomic_add_fetch(&cache->rejected_frees, 1u, __ATOMIC_RELAXED);
+        return false;
+    }
+#endif
+
+    /* One exchange, so two CPUs freeing the same object cannot both win. */
+    if (__atomic_exchange_n(slab_cookie(cache, object), SLAB_FREE_COOKIE, __ATOMIC_ACQ_REL) == SLAB_FREE_COOKIE)
+    {
+        __atomic_add_fetch(&cache->rejected_frees, 1u, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    uint32_t eflags = slab_irq_save();
+    KernelSlabCpuCache_t *cpu = slab_local(cache);
+
+    if (cpu->count == KERNEL_SLAB_CPU_CACHE_DEPTH)
+        slab_cache_flush(cache, cpu, KERNEL_SLAB_CPU_CACHE_BATCH);
+    cpu->objects[cpu->count++] = object;
+    ++cpu->frees;
+
+    uint32_t delta = slab_rdtsc_low() - t0;
+    if (delta > cpu->wcet_free)
+        cpu->wcet_free = delta;
+
+    slab_irq_restore(eflags);
+    return true;
 }
 
-#else /* SERVER profile stubs */
+const char *kernel_slab_cache_get_name(const KernelSlabCache_t *cache) { return cache ? cache->name : NULL; }
+
+void kernel_slab_cache_get_statistics(const KernelSlabCache_t *cache, KernelSlabCacheStatistics_t *out)
+{
+    if (!out)
+        return;
+
+    *out = (KernelSlabCacheStatistics_t) {0};
+    if (!cache || !cache->in_use)
+        return;
+
+    uint32_t allocations = 0u;
+    uint32_t frees = 0u;
+
+    /* Each CPU writes only its own counters; the sum is a snapshot, not a transaction. */
+    for (uint32_t slot = 0u; slot < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++slot)
+    {
+        const KernelSlabCpuCache_t *cpu = &cache->cpu[slot];
+
+        out->cached += cpu->count;
+        out->hits += cpu->hits;
+        out->misses += cpu->misses;
+        allocations += cpu->allocations;
+        frees += cpu->frees;
+        if (cpu->wcet_alloc > out->wcet_alloc_cycles)
+            out->wcet_alloc_cycles = cpu->wcet_alloc;
+        if (cpu->wcet_free > out->wcet_free_cycles)
+            out->wcet_free_cycles = cpu->wcet_free;
+    }
+
+    out->object_size = cache->object_size;
+    out->align = cache->align;
+    out->stride = cache->stride;
+    out->pages = cache->pages;
+    out->objects = cache->objects;
+    out->used = allocations - frees;
+    out->grows = cache->grows;
+    out->alloc_failures = cache->alloc_failures;
+    out->rejected_frees = cache->rejected_frees;
+}
 
 /* ------------------------------------------------------------------ */
-/* SERVER stubs — the slab is not used on server builds.              */
+/* kmalloc size classes                                               */
 /* ------------------------------------------------------------------ */
 
-void kernel_slab_initialize(void **backing_pages, uint32_t page_count)
+void kernel_slab_initialize(void)
 {
-    (void) backing_pages;
-    (void) page_count;
+    if (slab_initialized)
+        return;
+
+    kernel_ticket_lock_initialize(&slab_global_lock, NULL);
+    slab_reserve_initialize();
+    slab_initialized = true;
+
+    for (uint32_t index = 0u; index < SLAB_KMALLOC_CLASSES; ++index)
+    {
+        slab_kmalloc_caches[index] =
+            kernel_slab_cache_create(slab_kmalloc_names[index], slab_kmalloc_sizes[index], SLAB_DEFAULT_ALIGN, NULL);
+        /* A page each up front, so the first kmalloc of a class does not carve. */
+        (void) kernel_slab_cache_prefill(slab_kmalloc_caches[index], 1u);
+    }
+
+    uint32_t class_index = 0u;
+    for (uint32_t slot = 0u; slot <= SLAB_KMALLOC_MAX_SLOT; ++slot)
+    {
+        while (slab_kmalloc_sizes[class_index] < slot * SLAB_KMALLOC_GRANULE)
+            ++class_index;
+        slab_kmalloc_index[slot] = (uint8_t) class_index;
+    }
 }
 
 void *kernel_slab_alloc(uint32_t size)
 {
-    (void) size;
-    return NULL;
+    if (!slab_initialized || size == 0u || size > KERNEL_SLAB_KMALLOC_MAX_SIZE)
+        return NULL;
+
+    uint32_t slot = (size + SLAB_KMALLOC_GRANULE - 1u) / SLAB_KMALLOC_GRANULE;
+    return kernel_slab_cache_alloc(slab_kmalloc_caches[slab_kmalloc_index[slot]]);
 }
 
 bool kernel_slab_free(void *ptr)
 {
-    (void) ptr;
-    return false;
+    KernelSlabCache_t *cache = slab_owner_of(ptr);
+
+    if (!cache)
+        return false;
+    return kernel_slab_cache_free(cache, ptr);
+}
+
+static const KernelSlabCache_t *slab_kmalloc_cache_of_size(uint32_t object_size)
+{
+    for (uint32_t index = 0u; index < SLAB_KMALLOC_CLASSES; ++index)
+    {
+        if (slab_kmalloc_sizes[index] == object_size)
+            return slab_kmalloc_caches[index];
+    }
+    return NULL;
 }
 
 uint32_t kernel_slab_get_free_count(uint32_t object_size)
 {
-    (void) object_size;
-    return 0u;
+    KernelSlabCacheStatistics_t statistics;
+
+    kernel_slab_cache_get_statistics(slab_kmalloc_cache_of_size(object_size), &statistics);
+    return statistics.objects - statistics.used;
 }
 
 uint32_t kernel_slab_get_used_count(uint32_t object_size)
 {
-    (void) object_size;
-    return 0u;
+    KernelSlabCacheStatistics_t statistics;
+
+    kernel_slab_cache_get_statistics(slab_kmalloc_cache_of_size(object_size), &statistics);
+    return statistics.used;
+}
+
+uint32_t kernel_slab_get_cache_count(void)
+{
+    uint32_t count = 0u;
+
+    for (uint32_t index = 0u; index < KERNEL_SLAB_MAX_CACHES; ++index)
+    {
+        if (slab_caches[index].in_use)
+            ++count;
+    }
+    return count;
 }
 
-#endif /* LPL_KERNEL_REAL_TIME_MODE */
+uint32_t kernel_slab_get_reserve_free_pages(void) { return slab_reserve_free_count; }
+
+void kernel_slab_report(Serial_t *serial)
+{
+    if (!serial)
+        return;
+
+    kernel_telemetry_begin_record(serial, "slab");
+    kernel_telemetry_write_unsigned("reserve_pages", slab_reserve_pages);
+    kernel_telemetry_write_unsigned("reserve_free_pages", slab_reserve_free_count);
+    kernel_telemetry_write_unsigned("caches", kernel_slab_get_cache_count());
+    kernel_telemetry_write_unsigned("kmalloc_classes", SLAB_KMALLOC_CLASSES);
+    kernel_telemetry_end_record();
+
+    for (uint32_t index = 0u; index < KERNEL_SLAB_MAX_CACHES; ++index)
+    {
+        const KernelSlabCache_t *cache = &slab_caches[index];
+        KernelSlabCacheStatistics_t statistics;
+
+        if (!cache->in_use)
+            continue;
+
+        kernel_slab_cache_get_statistics(cache, &statistics);
+        kernel_telemetry_begin_record(serial, "slab_cache");
+        kernel_telemetry_write_text("name", cache->name);
+        kernel_telemetry_write_unsigned("object_size", statistics.object_size);
+        kernel_telemetry_write_unsigned("stride", statistics.stride);
+        kernel_telemetry_write_unsigned("pages", statistics.pages);
+        kernel_telemetry_write_unsigned("objects", statistics.objects);
+        kernel_telemetry_write_unsigned("used", statistics.used);
+        kernel_telemetry_write_unsigned("cached", statistics.cached);
+        kernel_telemetry_write_unsigned("hits", statistics.hits);
+        kernel_telemetry_write_unsigned("misses", statistics.misses);
+        kernel_telemetry_write_unsigned("grows", statistics.grows);
+        kernel_telemetry_write_unsigned("alloc_failures", statistics.alloc_failures);
+        kernel_telemetry_write_unsigned("rejected_frees", statistics.rejected_frees);
+        kernel_telemetry_write_unsigned("wcet_alloc_cycles", statistics.wcet_alloc_cycles);
+        kernel_telemetry_write_unsigned("wcet_free_cycles", statistics.wcet_free_cycles);
+        kernel_telemetry_end_record();
+    }
+}
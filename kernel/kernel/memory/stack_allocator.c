@@ -3,15 +3,20 @@
 #include <kernel/memory/heap.h>
 #include <kernel/memory/stack_allocator.h>
 
-static uint8_t *kernel_stack_allocator_base = NULL;
-static uint32_t kernel_stack_allocator_capacity = 0u;
-static uint32_t kernel_stack_allocator_offset = 0u;
-static uint32_t kernel_stack_allocator_peak = 0u;
-static uint32_t kernel_stack_allocator_alloc_count = 0u;
-static uint32_t kernel_stack_allocator_rollback_count = 0u;
-static uint32_t kernel_stack_allocator_failed_alloc_count = 0u;
+static KernelStackAllocator_t kernel_stack_allocator_default;
 static bool kernel_stack_allocator_initialized = false;
 
+static inline uint32_t stack_allocator_rdtsc_low(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t lo;
+    asm volatile("rdtsc" : "=a"(lo)::"edx");
+    return lo;
+#else
+    return 0u;
+#endif
+}
+
 static uint32_t kernel_stack_allocator_align_up(uint32_t value, uint32_t align)
 {
     if (align == 0u)
@@ -19,12 +24,14 @@ static uint32_t kernel_stack_allocator_align_up(uint32_t value, uint32_t align)
     return (value + (align - 1u)) & ~(align - 1u);
 }
 
-bool kernel_stack_allocator_initialize(uint32_t capacity_bytes)
+static void kernel_stack_allocator_registry_usage(const void *instance, KernelAllocatorUsage_t *out)
 {
-    if (kernel_stack_allocator_initialized)
-        return true;
+    kernel_stack_allocator_get_usage((const KernelStackAllocator_t *) instance, out);
+}
 
-    if (capacity_bytes == 0u)
+bool kernel_stack_allocator_init(KernelStackAllocator_t *stack, const char *name, uint32_t capacity_bytes)
+{
+    if (!stack || !name || capacity_bytes == 0u || capacity_bytes > 0xFFFFFFF0u)
         return false;
 
     uint32_t aligned_capacity = kernel_stack_allocator_align_up(capacity_bytes, 16u);
@@ -33,65 +40,170 @@ bool kernel_stack_allocator_initialize(uint32_t capacity_bytes)
     if (!backing)
         return false;
 
-    kernel_stack_allocator_base = (uint8_t *) backing;
-    kernel_stack_allocator_capacity = aligned_capacity;
-    kernel_stack_allocator_offset = 0u;
-    kernel_stack_allocator_peak = 0u;
-    kernel_stack_allocator_alloc_count = 0u;
-    kernel_stack_allocator_rollback_count = 0u;
-    kernel_stack_allocator_failed_alloc_count = 0u;
-    kernel_stack_allocator_initialized = true;
+    stack->base = (uint8_t *) backing;
+    stack->name = name;
+    stack->capacity = aligned_capacity;
+    stack->offset = 0u;
+    stack->peak = 0u;
+    stack->alloc_count = 0u;
+    stack->rollback_count = 0u;
+    stack->failed_alloc_count = 0u;
+    stack->wcet_push = 0u;
+    stack->wcet_rollback = 0u;
+    stack->owns_stack = false;
+
+    kernel_allocator_registry_register(name, KERNEL_ALLOCATOR_KIND_STACK, stack, kernel_stack_allocator_registry_usage);
     return true;
 }
 
-void *kernel_stack_alloc_push(uint32_t size, uint32_t align)
+KernelStackAllocator_t *kernel_stack_allocator_create(const char *name, uint32_t capacity_bytes)
+{
+    KernelStackAllocator_t *stack = (KernelStackAllocator_t *) kmalloc(sizeof(KernelStackAllocator_t));
+
+    if (!stack)
+        return NULL;
+
+    if (!kernel_stack_allocator_init(stack, name, capacity_bytes))
+    {
+        kfree(stack);
+        return NULL;
+    }
+
+    stack->owns_stack = true;
+    return stack;
+}
+
+void kernel_stack_allocator_destroy(KernelStackAllocator_t *stack)
+{
+    if (!stack || !stack->base)
+        return;
+
+    kernel_allocator_registry_unregister(stack);
+    kfree(stack->base);
+    stack->base = NULL;
+    stack->capacity = 0u;
+    stack->offset = 0u;
+
+    if (stack->owns_stack)
+        kfree(stack);
+}
+
+void *kernel_stack_allocator_push(KernelStackAllocator_t *stack, uint32_t size, uint32_t align)
 {
-    if (!kernel_stack_allocator_initialized || size == 0u)
+    uint32_t t0 = stack_allocator_rdtsc_low();
+
+    if (!stack || !stack->base || size == 0u)
         return NULL;
 
     uint32_t effective_align = (align == 0u) ? 8u : align;
-    uint32_t aligned_offset = kernel_stack_allocator_align_up(kernel_stack_allocator_offset, effective_align);
+    uint32_t aligned_offset = kernel_stack_allocator_align_up(stack->offset, effective_align);
 
-    if (aligned_offset > kernel_stack_allocator_capacity || size > (kernel_stack_allocator_capacity - aligned_offset))
+    if (aligned_offset > stack->capacity || size > (stack->capacity - aligned_offset))
     {
-        ++kernel_stack_allocator_failed_alloc_count;
+        ++stack->failed_alloc_count;
         return NULL;
     }
 
-    void *result = kernel_stack_allocator_base + aligned_offset;
-    kernel_stack_allocator_offset = aligned_offset + size;
-    ++kernel_stack_allocator_alloc_count;
+    void *result = stack->base + aligned_offset;
+    stack->offset = aligned_offset + size;
+    ++stack->alloc_count;
+
+    if (stack->offset > stack->peak)
+        stack->peak = stack->offset;
 
-    if (kernel_stack_allocator_offset > kernel_stack_allocator_peak)
-        kernel_stack_allocator_peak = kernel_stack_allocator_offset;
+    uint32_t t1 = stack_allocator_rdtsc_low();
+    uint32_t delta = t1 - t0;
+    if (delta > stack->wcet_push)
+        stack->wcet_push = delta;
 
     return result;
 }
 
-uint32_t kernel_stack_alloc_get_marker(void) { return kernel_stack_allocator_offset; }
+uint32_t kernel_stack_allocator_marker(const KernelStackAllocator_t *stack) { return stack ? stack->offset : 0u; }
 
-void kernel_stack_alloc_rollback(uint32_t marker)
+void kernel_stack_allocator_rollback_to(KernelStackAllocator_t *stack, uint32_t marker)
 {
-    if (!kernel_stack_allocator_initialized)
+    uint32_t t0 = stack_allocator_rdtsc_low();
+
+    if (!stack || !stack->base)
         return;
 
-    if (marker <= kernel_stack_allocator_offset)
+    if (marker <= stack->offset)
     {
-        kernel_stack_allocator_offset = marker;
-        ++kernel_stack_allocator_rollback_count;
+        stack->offset = marker;
+        ++stack->rollback_count;
     }
+
+    uint32_t t1 = stack_allocator_rdtsc_low();
+    uint32_t delta = t1 - t0;
+    if (delta > stack->wcet_rollback)
+        stack->wcet_rollback = delta;
+}
+
+void kernel_stack_allocator_get_usage(const KernelStackAllocator_t *stack, KernelAllocatorUsage_t *out)
+{
+    if (!out)
+        return;
+
+    *out = (KernelAllocatorUsage_t) {0};
+    if (!stack || !stack->base)
+        return;
+
+    out->capacity = stack->capacity;
+    out->used = stack->offset;
+    out->peak = stack->peak;
+    out->allocations = stack->alloc_count;
+    out->failures = stack->failed_alloc_count;
+    out->resets = stack->rollback_count;
+    out->wcet_alloc_cycles = stack->wcet_push;
+    out->wcet_release_cycles = stack->wcet_rollback;
+}
+
+KernelStackAllocator_t *kernel_stack_allocator_get_default(void)
+{
+    return kernel_stack_allocator_initialized ? &kernel_stack_allocator_default : NULL;
+}
+
+bool kernel_stack_allocator_initialize(uint32_t capacity_bytes)
+{
+    if (kernel_stack_allocator_initialized)
+        return true;
+
+    if (!kernel_stack_allocator_init(&kernel_stack_allocator_default, "kernel_stack", capacity_bytes))
+        return false;
+
+    kernel_stack_allocator_initialized = true;
+    return true;
+}
+
+void *kernel_stack_alloc_push(uint32_t size, uint32_t align)
+{
+    if (!kernel_stack_allocator_initialized)
+        return NULL;
+    return kernel_stack_allocator_push(&kernel_stack_allocator_default, size, align);
+}
+
+uint32_t kernel_stack_alloc_get_marker(void) { return kernel_stack_allocator_default.offset; }
+
+void kernel_stack_alloc_rollback(uint32_t marker)
+{
+    if (kernel_stack_allocator_initialized)
+        kernel_stack_allocator_rollback_to(&kernel_stack_allocator_default, marker);
 }
 
 bool kernel_stack_allocator_is_initialized(void) { return kernel_stack_allocator_initialized; }
 
-uint32_t kernel_stack_allocator_get_capacity(void) { return kernel_stack_allocator_capacity; }
+uint32_t kernel_stack_allocator_get_capacity(void) { return kernel_stack_allocator_default.capacity; }
 
-uint32_t kernel_stack_allocator_get_used(void) { return kernel_stack_allocator_offset; }
+uint32_t kernel_stack_allocator_get_used(void) { return kernel_stack_allocator_default.offset; }
 
-uint32_t kernel_stack_allocator_get_peak_used(void) { return kernel_stack_allocator_peak; }
+uint32_t kernel_stack_allocator_get_peak_used(void) { return kernel_stack_allocator_default.peak; }
 
-uint32_t kernel_stack_allocator_get_alloc_count(void) { return kernel_stack_allocator_alloc_count; }
+uint32_t kernel_stack_allocator_get_alloc_count(void) { return kernel_stack_allocator_default.alloc_count; }
 
-uint32_t kernel_stack_allocator_get_rollback_count(void) { return kernel_stack_allocator_rollback_count; }
+uint32_t kernel_stack_allocator_get_rollback_count(void) { return kernel_stack_allocator_default.rollback_count; }
 
-uint32_t kernel_stack_allocator_get_failed_alloc_count(void) { return kernel_stack_allocator_failed_alloc_count; }
+uint32_t kernel_stack_allocator_get_failed_alloc_count(void)
+{
+    return kernel_stack_allocator_default.failed_alloc_count;
+}
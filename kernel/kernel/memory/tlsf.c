@@ -5,113 +5,94 @@
 ** Two-Level Segregated Fit (TLSF) O(1) deterministic allocator.
 **
 ** This is a freestanding implementation for the client realtime kernel
-** profile.  It manages a single contiguous memory pool donated at boot
-** time.  Allocation and deallocation are O(1) (bounded by a constant
-** number of bit-scan + pointer dereferences).
+** profile. Each instance manages the pools its owner hands it; allocation
+** and deallocation are O(1) (bounded by a constant number of bit-scan +
+** pointer dereferences), whatever the number of pools.
 **
-** Design:
-**   - FLI (First-Level Index): log2(block_size), up to TLSF_FLI_COUNT.
-**   - SLI (Second-Level Index): TLSF_SLI_LOG2 bits => 4 sub-divisions.
-**   - Two bitmaps (fl_bitmap, sl_bitmap[]) for O(1) best-fit search.
+** Design (Masmano et al., "TLSF: a New Dynamic Memory Allocator for
+** Real-Time Systems", ECRTS 2004):
+**   - FLI (First-Level Index): log2(block_size), from 2^8 to 2^31.
+**   - SLI (Second-Level Index): KERNEL_TLSF_SL_INDEX_LOG2 bits => 32
+**     linear sub-divisions, one 32-bit bitmap word per class.
+**   - Two bitmaps (fl_bitmap, sl_bitmap[]) for O(1) good-fit search.
 **   - Each block has a header: { size | prev_phys_block | free_prev | free_next }.
-**   - Immediate coalescing on free (boundary-tag style).
+**   - Immediate coalescing on free (boundary-tag style), within a pool:
+**     every pool ends with a zero-sized sentinel block.
 */
 
+#include <kernel/diag/telemetry.h>
+#include <kernel/memory/heap.h>
 #include <kernel/memory/tlsf.h>
 
 /* ── Tuning ────────────────────────────────────────────── */
 
-/** Number of second-level index bits per first-level class. */
-#define TLSF_SLI_LOG2  2u
-#define TLSF_SLI_COUNT (1u << TLSF_SLI_LOG2) /* 4 */
-
-/** Maximum first-level classes (covers up to 2^(FLI-1) byte blocks). */
-#define TLSF_FLI_COUNT 16u
-
 /** Minimum block payload size (bytes).  Must be >= 2 * sizeof(void*). */
 #define TLSF_MIN_BLOCK_SIZE 16u
 
+/** Sizes below this all map to first-level class 0. */
+#define TLSF_SMALL_BLOCK_SIZE (1u << KERNEL_TLSF_FL_INDEX_SHIFT)
+
 /**
- * Largest size the two-level mapping can represent.
+ * Largest size a request may have.
  *
- * The first-level index is the floor-log2 of the size, so TLSF_FLI_COUNT classes
- * describe sizes strictly below 2^TLSF_FLI_COUNT. Above that, mapping_insert
- * clamps fl to the top class — correct when FILING a block (an oversized block
- * belongs in the largest bucket) but a trap when SEARCHING: the clamp makes an
- * unrepresentable request look like it maps to a real bucket, and the search
- * happily returns a block far smaller than asked for. Requests are bounded here
- * instead, so the clamp is only ever reached on the insert path.
+ * mapping_insert clamps fl to the top class — correct when FILING a block
+ * (an oversized block belongs in the largest bucket) but a trap when
+ * SEARCHING: the clamp makes an unrepresentable request look like it maps to
+ * a real bucket, and the search happily returns a block far smaller than
+ * asked for. Requests are bounded below the top class instead, so the clamp
+ * is only ever reached on the insert path.
  */
-#define TLSF_MAX_BLOCK_SIZE ((1u << TLSF_FLI_COUNT) - 1u)
+#define TLSF_MAX_BLOCK_SIZE KERNEL_TLSF_MAX_ALLOCATION
 
 /** Alignment of all returned pointers. */
 #define TLSF_ALIGN      8u
 #define TLSF_ALIGN_MASK (TLSF_ALIGN - 1u)
 
-/** Bit flags stored in the low bits of block_header_t::size. */
+/** Bit flags stored in the low bits of KernelTlsfBlock_t::size. */
 #define TLSF_BLOCK_FREE_BIT      (1u << 0)
 #define TLSF_BLOCK_PREV_FREE_BIT (1u << 1)
 #define TLSF_BLOCK_FLAG_MASK     (TLSF_BLOCK_FREE_BIT | TLSF_BLOCK_PREV_FREE_BIT)
 
 /* ── Block header ──────────────────────────────────────── */
 
-typedef struct block_header {
+struct KernelTlsfBlock {
     /**
      * Size of the usable payload in bytes, with the two LSBs used as flags:
      *   bit 0: 1 = this block is free
      *   bit 1: 1 = the physically previous block is free
+     * Pointer-sized, so the payload stays 8-byte aligned on a 64-bit host.
      */
-    uint32_t size;
+    size_t size;
 
     /**
-     * Pointer to the physically previous block.  NULL for the first block.
+     * Pointer to the physically previous block.  NULL for the first block
+     * of a pool.
      */
-    struct block_header *prev_phys;
+    struct KernelTlsfBlock *prev_phys;
 
     /**
      * When free, the block is part of a doubly-linked segregated free list.
      * These fields lie inside the payload area (only valid when free).
      */
-    struct block_header *free_prev;
-    struct block_header *free_next;
-} block_header_t;
+    struct KernelTlsfBlock *free_prev;
+    struct KernelTlsfBlock *free_next;
+};
 
-/* Compile-time check: header must fit in TLSF_MIN_BLOCK_SIZE + overhead. */
-_Static_assert(sizeof(block_header_t) <= TLSF_MIN_BLOCK_SIZE + 2 * sizeof(uint32_t),
-               "block_header_t too large for TLSF_MIN_BLOCK_SIZE");
+typedef KernelTlsfBlock_t block_header_t;
 
 /* Overhead = the non-payload part of the header (size + prev_phys). */
-#define TLSF_BLOCK_OVERHEAD (sizeof(uint32_t) + sizeof(block_header_t *))
-
-/* ── TLSF control structure ───────────────────────────── */
+#define TLSF_BLOCK_OVERHEAD KERNEL_TLSF_BLOCK_OVERHEAD
 
-typedef struct {
-    /** FL-level bitmap: bit i set => at least one free block in FL class i. */
-    uint32_t fl_bitmap;
+_Static_assert(TLSF_BLOCK_OVERHEAD == sizeof(size_t) + sizeof(block_header_t *), "KERNEL_TLSF_BLOCK_OVERHEAD is stale");
 
-    /** SL-level bitmaps: bit j in sl_bitmap[i] => free block in (i, j). */
-    uint32_t sl_bitmap[TLSF_FLI_COUNT];
-
-    /** Segregated free-list heads indexed by [fl][sl]. */
-    block_header_t *free_lists[TLSF_FLI_COUNT][TLSF_SLI_COUNT];
-
-    /** Pool boundaries for ownership checks. */
-    uint8_t *pool_start;
-    uint8_t *pool_end;
-
-    /** Telemetry. */
-    uint32_t pool_size;
-    uint32_t free_bytes;
-    uint32_t alloc_count;
-    uint32_t free_op_count;
-    uint32_t failed_alloc_count;
-    uint32_t wcet_alloc_cycles;
-    uint32_t wcet_free_cycles;
+/* Compile-time check: header must fit in TLSF_MIN_BLOCK_SIZE + overhead. */
+_Static_assert(sizeof(block_header_t) <= TLSF_MIN_BLOCK_SIZE + TLSF_BLOCK_OVERHEAD,
+               "block_header_t too large for TLSF_MIN_BLOCK_SIZE");
 
-    bool initialized;
-} tlsf_control_t;
+/* A pool holds at least one minimum block plus its sentinel. */
+#define TLSF_MIN_POOL_SIZE (TLSF_BLOCK_OVERHEAD + TLSF_MIN_BLOCK_SIZE + TLSF_BLOCK_OVERHEAD)
 
-static tlsf_control_t g_tlsf;
+static KernelTlsf_t g_tlsf;
 
 /* ── Compiler builtins (freestanding) ─────────────────── */
 
@@ -136,7 +117,7 @@ static inline uint32_t tlsf_rdtsc_low(void)
 
 /* ── Block helpers ─────────────────────────────────────── */
 
-static inline uint32_t block_get_size(const block_header_t *b) { return b->size & ~TLSF_BLOCK_FLAG_MASK; }
+static inline uint32_t block_get_size(const block_header_t *b) { return (uint32_t) (b->size & ~TLSF_BLOCK_FLAG_MASK); }
 
 static inline void block_set_size(block_header_t *b, uint32_t sz) { b->size = sz | (b->size & TLSF_BLOCK_FLAG_MASK); }
 
@@ -165,40 +146,36 @@ static inline block_header_t *block_next_phys(const block_header_t *b)
     return (block_header_t *) ((uint8_t *) block_to_ptr(b) + block_get_size(b));
 }
 
-/** Check if a block is the sentinel (last in pool). */
-static inline bool block_is_sentinel(const block_header_t *b) { return block_get_size(b) == 0u; }
-
 /* ── Mapping: size → (fl, sl) ─────────────────────────── */
 
 static void mapping_insert(uint32_t size, uint32_t *p_fl, uint32_t *p_sl)
 {
-    if (size < (1u << (TLSF_SLI_LOG2 + 1u)))
+    if (size < TLSF_SMALL_BLOCK_SIZE)
     {
         *p_fl = 0u;
-        *p_sl = size / (TLSF_MIN_BLOCK_SIZE / TLSF_SLI_COUNT);
-        if (*p_sl >= TLSF_SLI_COUNT)
-            *p_sl = TLSF_SLI_COUNT - 1u;
+        *p_sl = size / (TLSF_SMALL_BLOCK_SIZE / KERNEL_TLSF_SL_INDEX_COUNT);
     }
     else
     {
-        uint32_t fl = tlsf_log2_floor(size);
-        uint32_t sl = (size >> (fl - TLSF_SLI_LOG2)) ^ (1u << TLSF_SLI_LOG2);
-        if (fl >= TLSF_FLI_COUNT)
+        uint32_t fli = tlsf_log2_floor(size);
+        uint32_t sl = (size >> (fli - KERNEL_TLSF_SL_INDEX_LOG2)) ^ KERNEL_TLSF_SL_INDEX_COUNT;
+        uint32_t fl = fli - (KERNEL_TLSF_FL_INDEX_SHIFT - 1u);
+        if (fl >= KERNEL_TLSF_FL_INDEX_COUNT)
         {
-            fl = TLSF_FLI_COUNT - 1u;
-            sl = TLSF_SLI_COUNT - 1u;
+            fl = KERNEL_TLSF_FL_INDEX_COUNT - 1u;
+            sl = KERNEL_TLSF_SL_INDEX_COUNT - 1u;
         }
         *p_fl = fl;
         *p_sl = sl;
     }
 }
 
-/** Round-up mapping: find the smallest (fl, sl) that can satisfy size. */
+/** Round-up mapping: find the smallest (fl, sl) whose every block can satisfy size. */
 static void mapping_search(uint32_t size, uint32_t *p_fl, uint32_t *p_sl)
 {
-    if (size >= (1u << (TLSF_SLI_LOG2 + 1u)))
+    if (size >= TLSF_SMALL_BLOCK_SIZE)
     {
-        uint32_t round = (1u << (tlsf_log2_floor(size) - TLSF_SLI_LOG2)) - 1u;
+        uint32_t round = (1u << (tlsf_log2_floor(size) - KERNEL_TLSF_SL_INDEX_LOG2)) - 1u;
         size += round;
     }
     mapping_insert(size, p_fl, p_sl);
@@ -206,7 +183,7 @@ static void mapping_search(uint32_t size, uint32_t *p_fl, uint32_t *p_sl)
 
 /* ── Free-list manipulation ───────────────────────────── */
 
-static void free_list_remove(block_header_t *block)
+static void free_list_remove(KernelTlsf_t *tlsf, block_header_t *block)
 {
     block_header_t *prev = block->free_prev;
     block_header_t *next = block->free_next;
@@ -219,58 +196,61 @@ static void free_list_remove(block_header_t *block)
     uint32_t fl, sl;
     mapping_insert(block_get_size(block), &fl, &sl);
 
-    if (g_tlsf.free_lists[fl][sl] == block)
+    if (tlsf->free_lists[fl][sl] == block)
     {
-        g_tlsf.free_lists[fl][sl] = next;
+        tlsf->free_lists[fl][sl] = next;
         if (!next)
         {
-            g_tlsf.sl_bitmap[fl] &= ~(1u << sl);
-            if (g_tlsf.sl_bitmap[fl] == 0u)
-                g_tlsf.fl_bitmap &= ~(1u << fl);
+            tlsf->sl_bitmap[fl] &= ~(1u << sl);
+            if (tlsf->sl_bitmap[fl] == 0u)
+                tlsf->fl_bitmap &= ~(1u << fl);
         }
     }
 }
 
-static void free_list_insert(block_header_t *block)
+static void free_list_insert(KernelTlsf_t *tlsf, block_header_t *block)
 {
     uint32_t fl, sl;
     mapping_insert(block_get_size(block), &fl, &sl);
 
-    block_header_t *head = g_tlsf.free_lists[fl][sl];
+    block_header_t *head = tlsf->free_lists[fl][sl];
     block->free_prev = NULL;
     block->free_next = head;
     if (head)
         head->free_prev = block;
-    g_tlsf.free_lists[fl][sl] = block;
+    tlsf->free_lists[fl][sl] = block;
 
-    g_tlsf.fl_bitmap |= (1u << fl);
-    g_tlsf.sl_bitmap[fl] |= (1u << sl);
+    tlsf->fl_bitmap |= (1u << fl);
+    tlsf->sl_bitmap[fl] |= (1u << sl);
 }
 
 /* ── Find a suitable free block ───────────────────────── */
 
-static block_header_t *find_suitable_block(uint32_t *p_fl, uint32_t *p_sl)
+static block_header_t *find_suitable_block(KernelTlsf_t *tlsf, uint32_t *p_fl, uint32_t *p_sl)
 {
     uint32_t fl = *p_fl;
     uint32_t sl = *p_sl;
 
-    uint32_t sl_map = g_tlsf.sl_bitmap[fl] & (~0u << sl);
+    uint32_t sl_map = tlsf->sl_bitmap[fl] & (~0u << sl);
 
     if (sl_map == 0u)
     {
-        uint32_t fl_map = g_tlsf.fl_bitmap & (~0u << (fl + 1u));
+        if (fl + 1u >= KERNEL_TLSF_FL_INDEX_COUNT)
+            return NULL;
+
+        uint32_t fl_map = tlsf->fl_bitmap & (~0u << (fl + 1u));
         if (fl_map == 0u)
             return NULL;
 
         fl = tlsf_ffs(fl_map);
-        sl_map = g_tlsf.sl_bitmap[fl];
+        sl_map = tlsf->sl_bitmap[fl];
     }
 
     sl = tlsf_ffs(sl_map);
 
     *p_fl = fl;
     *p_sl = sl;
-    return g_tlsf.free_lists[fl][sl];
+    return tlsf->free_lists[fl][sl];
 }
 
 /* ── Split / absorb helpers ───────────────────────────── */
@@ -287,8 +267,7 @@ static block_header_t *block_split(block_header_t *block, uint32_t size)
     block_set_size(block, size);
 
     block_header_t *next = block_next_phys(rest);
-    if (!block_is_sentinel(next))
-        next->prev_phys = rest;
+    next->prev_phys = rest;
 
     return rest;
 }
@@ -299,37 +278,101 @@ static block_header_t *block_absorb_next(block_header_t *block, block_header_t *
     block_set_size(block, new_size);
 
     block_header_t *next_next = block_next_phys(block);
-    if (!block_is_sentinel(next_next))
-        next_next->prev_phys = block;
+    next_next->prev_phys = block;
 
     return block;
 }
 
-/* ── Public API ────────────────────────────────────────── */
+/* ── Instances ─────────────────────────────────────────── */
 
-bool kernel_tlsf_initialize(void *buffer, size_t size)
+static void kernel_tlsf_registry_usage(const void *instance, KernelAllocatorUsage_t *out)
 {
-    if (!buffer || size < (TLSF_BLOCK_OVERHEAD + TLSF_MIN_BLOCK_SIZE + TLSF_BLOCK_OVERHEAD))
+    kernel_tlsf_get_usage((const KernelTlsf_t *) instance, out);
+}
+
+bool kernel_tlsf_init(KernelTlsf_t *tlsf, const char *name, void *buffer, size_t size)
+{
+    if (!tlsf || !name || !buffer || size < TLSF_MIN_POOL_SIZE)
+        return false;
+
+    /* Re-initializing must not leave a stale registry entry behind. */
+    if (tlsf->initialized)
+        kernel_allocator_registry_unregister(tlsf);
+
+    for (uint32_t i = 0u; i < sizeof(*tlsf); ++i)
+        ((uint8_t *) tlsf)[i] = 0u;
+
+    tlsf->name = name;
+    tlsf->initialized = true;
+
+    if (!kernel_tlsf_add_pool(tlsf, buffer, size))
+    {
+        tlsf->initialized = false;
+        return false;
+    }
+
+    /* A full registry leaves the instance usable, just unlisted. */
+    kernel_allocator_registry_register(name, KERNEL_ALLOCATOR_KIND_TLSF, tlsf, kernel_tlsf_registry_usage);
+    return true;
+}
+
+KernelTlsf_t *kernel_tlsf_create(const char *name, void *buffer, size_t size)
+{
+    KernelTlsf_t *tlsf = (KernelTlsf_t *) kmalloc(sizeof(KernelTlsf_t));
+
+    if (!tlsf)
+        return NULL;
+
+    tlsf->initialized = false;
+    if (!kernel_tlsf_init(tlsf, name, buffer, size))
+    {
+        kfree(tlsf);
+        return NULL;
+    }
+
+    tlsf->owns_instance = true;
+    return tlsf;
+}
+
+void kernel_tlsf_destroy(KernelTlsf_t *tlsf)
+{
+    if (!tlsf || !tlsf->initialized)
+        return;
+
+    kernel_allocator_registry_unregister(tlsf);
+    tlsf->initialized = false;
+    tlsf->pool_count = 0u;
+    tlsf->fl_bitmap = 0u;
+
+    if (tlsf->owns_instance)
+        kfree(tlsf);
+}
+
+bool kernel_tlsf_add_pool(KernelTlsf_t *tlsf, void *buffer, size_t size)
+{
+    if (!tlsf || !tlsf->initialized || !buffer || tlsf->pool_count >= KERNEL_TLSF_MAX_POOLS)
         return false;
 
     uintptr_t buf_addr = (uintptr_t) buffer;
     if (buf_addr & TLSF_ALIGN_MASK)
     {
         uintptr_t aligned = (buf_addr + TLSF_ALIGN_MASK) & ~((uintptr_t) TLSF_ALIGN_MASK);
+        if (size < (size_t) (aligned - buf_addr))
+            return false;
         size -= (size_t) (aligned - buf_addr);
         buffer = (void *) aligned;
     }
+    size &= ~((size_t) TLSF_ALIGN_MASK);
 
-    for (uint32_t i = 0u; i < sizeof(g_tlsf); ++i)
-        ((uint8_t *) &g_tlsf)[i] = 0u;
+    if (size < TLSF_MIN_POOL_SIZE || size > (size_t) 0x80000000u)
+        return false;
 
-    g_tlsf.pool_start = (uint8_t *) buffer;
-    g_tlsf.pool_end = (uint8_t *) buffer + size;
-    g_tlsf.pool_size = (uint32_t) size;
+    KernelTlsfPool_t *pool = &tlsf->pools[tlsf->pool_count];
+    pool->start = (uint8_t *) buffer;
+    pool->end = (uint8_t *) buffer + size;
 
-    block_header_t *sentinel = (block_header_t *) (g_tlsf.pool_end - TLSF_BLOCK_OVERHEAD);
+    block_header_t *sentinel = (block_header_t *) (pool->end - TLSF_BLOCK_OVERHEAD);
     sentinel->size = 0u;
-    sentinel->prev_phys = NULL;
 
     block_header_t *first = (block_header_t *) buffer;
     uint32_t usable = (uint32_t) size - TLSF_BLOCK_OVERHEAD - TLSF_BLOCK_OVERHEAD;
@@ -341,23 +384,26 @@ bool kernel_tlsf_initialize(void *buffer, size_t size)
     first->free_next = NULL;
 
     sentinel->prev_phys = first;
+    block_set_prev_free(sentinel);
 
-    free_list_insert(first);
+    free_list_insert(tlsf, first);
 
-    g_tlsf.free_bytes = usable;
-    g_tlsf.initialized = true;
+    ++tlsf->pool_count;
+    tlsf->pool_size += (uint32_t) size;
+    tlsf->free_bytes += usable;
+    tlsf->min_free_bytes += usable;
     return true;
 }
 
-void *kernel_tlsf_alloc(size_t request_size)
+void *kernel_tlsf_allocate(KernelTlsf_t *tlsf, size_t request_size)
 {
-    if (!g_tlsf.initialized || request_size == 0u)
+    if (!tlsf || !tlsf->initialized || request_size == 0u)
         return NULL;
 
     uint32_t t0 = tlsf_rdtsc_low();
     if (request_size > (size_t) TLSF_MAX_BLOCK_SIZE)
     {
-        ++g_tlsf.failed_alloc_count;
+        ++tlsf->failed_alloc_count;
         return NULL;
     }
 
@@ -369,14 +415,14 @@ void *kernel_tlsf_alloc(size_t request_size)
     uint32_t fl, sl;
     mapping_search(size, &fl, &sl);
 
-    block_header_t *block = find_suitable_block(&fl, &sl);
+    block_header_t *block = find_suitable_block(tlsf, &fl, &sl);
     if (!block)
     {
-        ++g_tlsf.failed_alloc_count;
+        ++tlsf->failed_alloc_count;
         return NULL;
     }
 
-    free_list_remove(block);
+    free_list_remove(tlsf, block);
 
     uint32_t bsize = block_get_size(block);
     if (bsize >= size + TLSF_BLOCK_OVERHEAD + TLSF_MIN_BLOCK_SIZE)
@@ -384,33 +430,34 @@ void *kernel_tlsf_alloc(size_t request_size)
         block_header_t *rest = block_split(block, size);
         block_set_free(rest);
         block_set_prev_used(rest);
-        free_list_insert(rest);
-        g_tlsf.free_bytes -= (size + TLSF_BLOCK_OVERHEAD);
+        free_list_insert(tlsf, rest);
+        tlsf->free_bytes -= (size + TLSF_BLOCK_OVERHEAD);
     }
     else
     {
-        g_tlsf.free_bytes -= bsize;
+        tlsf->free_bytes -= bsize;
     }
 
     block_set_used(block);
 
     block_header_t *next = block_next_phys(block);
-    if (!block_is_sentinel(next))
-        block_set_prev_used(next);
+    block_set_prev_used(next);
 
-    ++g_tlsf.alloc_count;
+    ++tlsf->alloc_count;
+    if (tlsf->free_bytes < tlsf->min_free_bytes)
+        tlsf->min_free_bytes = tlsf->free_bytes;
 
     uint32_t t1 = tlsf_rdtsc_low();
     uint32_t cycles = t1 - t0;
-    if (cycles > g_tlsf.wcet_alloc_cycles)
-        g_tlsf.wcet_alloc_cycles = cycles;
+    if (cycles > tlsf->wcet_alloc_cycles)
+        tlsf->wcet_alloc_cycles = cycles;
 
     return block_to_ptr(block);
 }
 
-void kernel_tlsf_free(void *ptr)
+void kernel_tlsf_release(KernelTlsf_t *tlsf, void *ptr)
 {
-    if (!ptr || !g_tlsf.initialized)
+    if (!ptr || !tlsf || !tlsf->initialized)
         return;
 
     uint32_t t0 = tlsf_rdtsc_low();
@@ -418,10 +465,11 @@ void kernel_tlsf_free(void *ptr)
     block_header_t *block = ptr_to_block(ptr);
     uint32_t added_free_bytes = block_get_size(block);
 
+    /* The sentinel is never free, so neither merge crosses a pool boundary. */
     block_header_t *next = block_next_phys(block);
-    if (!block_is_sentinel(next) && block_is_free(next))
+    if (block_is_free(next))
     {
-        free_list_remove(next);
+        free_list_remove(tlsf, next);
         added_free_bytes += TLSF_BLOCK_OVERHEAD;
         block = block_absorb_next(block, next);
     }
@@ -431,7 +479,7 @@ void kernel_tlsf_free(void *ptr)
         block_header_t *prev = block->prev_phys;
         if (block_is_free(prev))
         {
-            free_list_remove(prev);
+            free_list_remove(tlsf, prev);
             added_free_bytes += TLSF_BLOCK_OVERHEAD;
             prev = block_absorb_next(prev, block);
             block = prev;
@@ -439,30 +487,135 @@ void kernel_tlsf_free(void *ptr)
     }
 
     block_set_free(block);
-    free_list_insert(block);
+    free_list_insert(tlsf, block);
 
-    g_tlsf.free_bytes += added_free_bytes;
+    tlsf->free_bytes += added_free_bytes;
 
     block_header_t *next_after = block_next_phys(block);
-    if (!block_is_sentinel(next_after))
-        block_set_prev_free(next_after);
+    block_set_prev_free(next_after);
 
-    ++g_tlsf.free_op_count;
+    ++tlsf->free_op_count;
 
     uint32_t t1 = tlsf_rdtsc_low();
     uint32_t cycles = t1 - t0;
-    if (cycles > g_tlsf.wcet_free_cycles)
-        g_tlsf.wcet_free_cycles = cycles;
+    if (cycles > tlsf->wcet_free_cycles)
+        tlsf->wcet_free_cycles = cycles;
 }
 
-bool kernel_tlsf_owns(const void *ptr)
+bool kernel_tlsf_contains(const KernelTlsf_t *tlsf, const void *ptr)
 {
-    if (!ptr || !g_tlsf.initialized)
+    if (!ptr || !tlsf || !tlsf->initialized)
         return false;
+
     const uint8_t *p = (const uint8_t *) ptr;
-    return p >= g_tlsf.pool_start && p < g_tlsf.pool_end;
+    for (uint32_t i = 0u; i < tlsf->pool_count; ++i)
+    {
+        if (p >= tlsf->pools[i].start && p < tlsf->pools[i].end)
+            return true;
+    }
+    return false;
+}
+
+void kernel_tlsf_get_statistics(const KernelTlsf_t *tlsf, KernelTlsfStatistics_t *out)
+{
+    if (!out)
+        return;
+
+    *out = (KernelTlsfStatistics_t) {0};
+    if (!tlsf || !tlsf->initialized)
+        return;
+
+    out->pools = tlsf->pool_count;
+    out->pool_size = tlsf->pool_size;
+    out->free_bytes = tlsf->free_bytes;
+    out->min_free_bytes = tlsf->min_free_bytes;
+    out->alloc_count = tlsf->alloc_count;
+    out->free_count = tlsf->free_op_count;
+    out->failed_alloc_count = tlsf->failed_alloc_count;
+    out->wcet_alloc_cycles = tlsf->wcet_alloc_cycles;
+    out->wcet_free_cycles = tlsf->wcet_free_cycles;
+
+    for (uint32_t fl = 0u; fl < KERNEL_TLSF_FL_INDEX_COUNT; ++fl)
+    {
+        for (uint32_t sl = 0u; sl < KERNEL_TLSF_SL_INDEX_COUNT; ++sl)
+        {
+            for (const block_header_t *b = tlsf->free_lists[fl][sl]; b; b = b->free_next)
+            {
+                uint32_t size = block_get_size(b);
+                ++out->free_blocks;
+                if (size > out->largest_free_block)
+                    out->largest_free_block = size;
+            }
+        }
+    }
+
+    if (out->free_bytes > 0u)
+    {
+        uint64_t largest = (uint64_t) out->largest_free_block * 1000u;
+        out->fragmentation_permille = 1000u - (uint32_t) (largest / out->free_bytes);
+    }
 }
 
+void kernel_tlsf_get_usage(const KernelTlsf_t *tlsf, KernelAllocatorUsage_t *out)
+{
+    if (!out)
+        return;
+
+    *out = (KernelAllocatorUsage_t) {0};
+    if (!tlsf || !tlsf->initialized)
+        return;
+
+    out->capacity = tlsf->pool_size;
+    out->used = tlsf->pool_size - tlsf->free_bytes;
+    out->peak = tlsf->pool_size - tlsf->min_free_bytes;
+    out->allocations = tlsf->alloc_count;
+    out->failures = tlsf->failed_alloc_count;
+    out->resets = tlsf->free_op_count;
+    out->wcet_alloc_cycles = tlsf->wcet_alloc_cycles;
+    out->wcet_release_cycles = tlsf->wcet_free_cycles;
+}
+
+void kernel_tlsf_report(Serial_t *serial, const KernelTlsf_t *tlsf)
+{
+    KernelTlsfStatistics_t stats;
+
+    if (!serial || !tlsf || !tlsf->initialized)
+        return;
+
+    kernel_tlsf_get_statistics(tlsf, &stats);
+
+    kernel_telemetry_begin_record(serial, "tlsf");
+    kernel_telemetry_write_text("name", tlsf->name);
+    kernel_telemetry_write_unsigned("pools", stats.pools);
+    kernel_telemetry_write_unsigned("pool_size", stats.pool_size);
+    kernel_telemetry_write_unsigned("free_bytes", stats.free_bytes);
+    kernel_telemetry_write_unsigned("min_free_bytes", stats.min_free_bytes);
+    kernel_telemetry_write_unsigned("largest_free_block", stats.largest_free_block);
+    kernel_telemetry_write_unsigned("free_blocks", stats.free_blocks);
+    kernel_telemetry_write_unsigned("fragmentation_permille", stats.fragmentation_permille);
+    kernel_telemetry_write_unsigned("allocations", stats.alloc_count);
+    kernel_telemetry_write_unsigned("frees", stats.free_count);
+    kernel_telemetry_write_unsigned("failures", stats.failed_alloc_count);
+    kernel_telemetry_write_unsigned("wcet_alloc_cycles", stats.wcet_alloc_cycles);
+    kernel_telemetry_write_unsigned("wcet_free_cycles", stats.wcet_free_cycles);
+    kernel_telemetry_end_record();
+}
+
+/* ── Default instance ──────────────────────────────────── */
+
+KernelTlsf_t *kernel_tlsf_get_default(void) { return g_tlsf.initialized ? &g_tlsf : NULL; }
+
+bool kernel_tlsf_initialize(void *buffer, size_t size)
+{
+    return kernel_tlsf_init(&g_tlsf, "kernel_tlsf", buffer, size);
+}
+
+void *kernel_tlsf_alloc(size_t request_size) { return kernel_tlsf_allocate(&g_tlsf, request_size); }
+
+void kernel_tlsf_free(void *ptr) { kernel_tlsf_release(&g_tlsf, ptr); }
+
+bool kernel_tlsf_owns(const void *ptr) { return kernel_tlsf_contains(&g_tlsf, ptr); }
+
 bool kernel_tlsf_is_initialized(void) { return g_tlsf.initialized; }
 uint32_t kernel_tlsf_get_pool_size(void) { return g_tlsf.pool_size; }
 uint32_t kernel_tlsf_get_free_bytes(void) { return g_tlsf.free_bytes; }
@@ -8,69 +8,616 @@
 #include <kernel/config.h>
 #include <kernel/cpu/paging.h>
 #include <kernel/cpu/pmm.h>
+#include <kernel/cpu/tlb_shootdown.h>
 #include <kernel/memory/vmm.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <string.h>
 
-#define VMM_PAGE_COUNT  (KERNEL_VMM_DYNAMIC_SIZE / PAGE_SIZE)
-#define VMM_BITMAP_SIZE (VMM_PAGE_COUNT / 8)
+#define VMM_PAGE_COUNT   (KERNEL_VMM_DYNAMIC_SIZE / PAGE_SIZE)
+#define VMM_BITMAP_WORDS (VMM_PAGE_COUNT / 32u)
 
-static uint8_t vmm_bitmap[VMM_BITMAP_SIZE];
-static uint32_t vmm_last_search_index = 0u;
+#define VMM_PAGES_PER_LARGE_PAGE (PAGING_LARGE_PAGE_SIZE / PAGE_SIZE)
+
+/*
+ * Free virtual space is kept as extents (start, count) in page indices. The
+ * bitmap stays the source of truth for what is reserved; the extents index the
+ * clear runs so a reservation never scans it.
+ *
+ * Sizes are indexed the way tlsf.c indexes blocks: a first level on log2 of the
+ * page count, split in VMM_SLI_COUNT linear second-level classes, each with a
+ * list and a bit in two summary bitmaps. Counts below VMM_SLI_COUNT get exact
+ * classes in first level 0. Addresses are indexed by two open-addressing hash
+ * tables, on the first page of an extent and on the page past its end, which is
+ * all coalescing needs: a freed range looks up its two neighbours directly.
+ */
+#define VMM_SLI_LOG2  2u
+#define VMM_SLI_COUNT (1u << VMM_SLI_LOG2)
+#define VMM_FLI_COUNT 18u
+
+/* Extents compared in a class before taking the best one seen. */
+#define VMM_BEST_FIT_SCAN 8u
+
+#define VMM_EXTENT_NONE 0xFFFFu
+
+#define VMM_HASH_BITS  11u
+#define VMM_HASH_SLOTS (1u << VMM_HASH_BITS)
+
+_Static_assert(VMM_PAGE_COUNT < (1u << VMM_FLI_COUNT), "VMM first level too small for the dynamic region");
+_Static_assert(KERNEL_VMM_EXTENT_CAPACITY < VMM_EXTENT_NONE, "VMM extent ids are 16-bit");
+_Static_assert(KERNEL_VMM_EXTENT_CAPACITY * 2u <= VMM_HASH_SLOTS, "VMM boundary tables over half full");
+
+typedef struct {
+    uint32_t start;
+    uint32_t count;
+    uint16_t prev;
+    uint16_t next;
+} VmmExtent_t;
+
+static uint32_t vmm_bitmap[VMM_BITMAP_WORDS];
 static bool vmm_initialized = false;
 
-static void vmm_bitmap_set(uint32_t index) { vmm_bitmap[index / 8] |= (1 << (index % 8)); }
+static VmmExtent_t vmm_extents[KERNEL_VMM_EXTENT_CAPACITY];
+static uint16_t vmm_extent_free_head = VMM_EXTENT_NONE;
 
-static void vmm_bitmap_clear(uint32_t index) { vmm_bitmap[index / 8] &= ~(1 << (index % 8)); }
+static uint32_t vmm_fl_bitmap = 0u;
+static uint32_t vmm_sl_bitmap[VMM_FLI_COUNT];
+static uint16_t vmm_class_heads[VMM_FLI_COUNT][VMM_SLI_COUNT];
 
-static bool vmm_bitmap_test(uint32_t index) { return (vmm_bitmap[index / 8] & (1 << (index % 8))) != 0; }
+static uint16_t vmm_by_start[VMM_HASH_SLOTS];
+static uint16_t vmm_by_end[VMM_HASH_SLOTS];
 
-bool kernel_vmm_initialize(void)
+/* Recently released 1..KERNEL_VMM_SIZE_CACHE_PAGES page ranges, by size. Their
+   bits stay set, so nothing else can take them while cached. */
+static uint32_t vmm_size_cache[KERNEL_VMM_SIZE_CACHE_PAGES][KERNEL_VMM_SIZE_CACHE_DEPTH];
+static uint32_t vmm_size_cache_count[KERNEL_VMM_SIZE_CACHE_PAGES];
+
+static KernelVmmStatistics_t vmm_statistics;
+
+/* ── Bitmap ───────────────────────────────────────────── */
+
+static inline uint32_t vmm_clz(uint32_t v) { return v ? (uint32_t) __builtin_clz(v) : 32u; }
+
+static inline uint32_t vmm_ffs(uint32_t v) { return v ? (uint32_t) __builtin_ctz(v) : 32u; }
+
+static inline uint32_t vmm_log2_floor(uint32_t v) { return 31u - vmm_clz(v); }
+
+static inline uint32_t vmm_rdtsc_low(void)
 {
-    memset(vmm_bitmap, 0, sizeof(vmm_bitmap));
-    vmm_last_search_index = 0u;
+    uint32_t lo;
+    asm volatile("rdtsc" : "=a"(lo)::"edx");
+    return lo;
+}
 
-    vmm_initialized = true;
+static bool vmm_bitmap_test(uint32_t index) { return (vmm_bitmap[index / 32u] & (1u << (index % 32u))) != 0u; }
+
+static void vmm_bitmap_fill(uint32_t index, uint32_t page_count, bool set)
+{
+    for (uint32_t i = index; i < index + page_count; ++i)
+    {
+        if (set)
+            vmm_bitmap[i / 32u] |= 1u << (i % 32u);
+        else
+            vmm_bitmap[i / 32u] &= ~(1u << (i % 32u));
+    }
+}
+
+static bool vmm_bitmap_range_clear(uint32_t index, uint32_t page_count)
+{
+    for (uint32_t i = index; i < index + page_count; ++i)
+    {
+        if (vmm_bitmap_test(i))
+            return false;
+    }
     return true;
 }
 
-void *kernel_vmm_reserve_pages(uint32_t page_count)
+/**
+ * @brief First page of the clear run holding @p index, which must be clear.
+ *
+ * Walks back a word at a time; extents are maximal clear runs, so this is the
+ * start of the extent holding @p index.
+ */
+static uint32_t vmm_bitmap_run_start(uint32_t index)
 {
-    if (!vmm_initialized || page_count == 0 || page_count > VMM_PAGE_COUNT)
-        return NULL;
+    uint32_t i = index;
+    while (i > 0u)
+    {
+        const uint32_t word = (i - 1u) / 32u;
+        const uint32_t below = vmm_bitmap[word] & (0xFFFFFFFFu >> (31u - ((i - 1u) % 32u)));
+        if (below != 0u)
+            return word * 32u + vmm_log2_floor(below) + 1u;
+        i = word * 32u;
+    }
+    return 0u;
+}
+
+/* ── Boundary tables ──────────────────────────────────── */
+
+static inline uint32_t vmm_extent_key(uint16_t id, bool by_end)
+{
+    return by_end ? vmm_extents[id].start + vmm_extents[id].count : vmm_extents[id].start;
+}
 
-    uint32_t found_index = 0xFFFFFFFFu;
+static inline uint32_t vmm_hash(uint32_t key) { return (key * 2654435761u) >> (32u - VMM_HASH_BITS); }
+
+static uint16_t vmm_boundary_find(uint32_t key, bool by_end)
+{
+    const uint16_t *table = by_end ? vmm_by_end : vmm_by_start;
 
-    uint32_t i = 0;
-    while (i <= VMM_PAGE_COUNT - page_count)
+    for (uint32_t slot = vmm_hash(key);; slot = (slot + 1u) & (VMM_HASH_SLOTS - 1u))
     {
-        bool match = true;
-        for (uint32_t j = 0u; j < page_count; ++j)
+        if (table[slot] == VMM_EXTENT_NONE)
+            return VMM_EXTENT_NONE;
+        if (vmm_extent_key(table[slot], by_end) == key)
+            return table[slot];
+    }
+}
+
+static void vmm_boundary_insert(uint16_t id, bool by_end)
+{
+    uint16_t *table = by_end ? vmm_by_end : vmm_by_start;
+    uint32_t slot = vmm_hash(vmm_extent_key(id, by_end));
+
+    while (table[slot] != VMM_EXTENT_NONE)
+        slot = (slot + 1u) & (VMM_HASH_SLOTS - 1u);
+    table[slot] = id;
+}
+
+static void vmm_boundary_remove(uint16_t id, bool by_end)
+{
+    uint16_t *table = by_end ? vmm_by_end : vmm_by_start;
+    uint32_t hole = vmm_hash(vmm_extent_key(id, by_end));
+
+    while (table[hole] != id)
+        hole = (hole + 1u) & (VMM_HASH_SLOTS - 1u);
+
+    /* Backward-shift deletion: pull up every later entry of the probe chain
+       whose home slot does not lie between the hole and itself. */
+    for (uint32_t slot = (hole + 1u) & (VMM_HASH_SLOTS - 1u); table[slot] != VMM_EXTENT_NONE;
+         slot = (slot + 1u) & (VMM_HASH_SLOTS - 1u))
+    {
+        const uint32_t home = vmm_hash(vmm_extent_key(table[slot], by_end));
+        const bool stays = (hole <= slot) ? (hole < home && home <= slot) : (hole < home || home <= slot);
+        if (!stays)
+        {
+            table[hole] = table[slot];
+            hole = slot;
+        }
+    }
+    table[hole] = VMM_EXTENT_NONE;
+}
+
+/* ── Size classes ─────────────────────────────────────── */
+
+static void vmm_mapping(uint32_t page_count, uint32_t *fl, uint32_t *sl)
+{
+    if (page_count < VMM_SLI_COUNT)
+    {
+        *fl = 0u;
+        *sl = page_count;
+        return;
+    }
+    *fl = vmm_log2_floor(page_count);
+    *sl = (page_count >> (*fl - VMM_SLI_LOG2)) & (VMM_SLI_COUNT - 1u);
+}
+
+static void vmm_index_insert(uint16_t id)
+{
+    uint32_t fl, sl;
+    vmm_mapping(vmm_extents[id].count, &fl, &sl);
+
+    const uint16_t head = vmm_class_heads[fl][sl];
+    vmm_extents[id].prev = VMM_EXTENT_NONE;
+    vmm_extents[id].next = head;
+    if (head != VMM_EXTENT_NONE)
+        vmm_extents[head].prev = id;
+    vmm_class_heads[fl][sl] = id;
+    vmm_fl_bitmap |= 1u << fl;
+    vmm_sl_bitmap[fl] |= 1u << sl;
+
+    vmm_boundary_insert(id, false);
+    vmm_boundary_insert(id, true);
+
+    ++vmm_statistics.extents;
+    vmm_statistics.free_pages += vmm_extents[id].count;
+}
+
+static void vmm_index_remove(uint16_t id)
+{
+    uint32_t fl, sl;
+    vmm_mapping(vmm_extents[id].count, &fl, &sl);
+
+    const uint16_t prev = vmm_extents[id].prev;
+    const uint16_t next = vmm_extents[id].next;
+    if (next != VMM_EXTENT_NONE)
+        vmm_extents[next].prev = prev;
+    if (prev != VMM_EXTENT_NONE)
+        vmm_extents[prev].next = next;
+    else
+    {
+        vmm_class_heads[fl][sl] = next;
+        if (next == VMM_EXTENT_NONE)
         {
-            if (vmm_bitmap_test(i + j))
+            vmm_sl_bitmap[fl] &= ~(1u << sl);
+            if (vmm_sl_bitmap[fl] == 0u)
+                vmm_fl_bitmap &= ~(1u << fl);
+        }
+    }
+
+    vmm_boundary_remove(id, false);
+    vmm_boundary_remove(id, true);
+
+    --vmm_statistics.extents;
+    vmm_statistics.free_pages -= vmm_extents[id].count;
+}
+
+static uint16_t vmm_extent_claim(void)
+{
+    const uint16_t id = vmm_extent_free_head;
+    if (id != VMM_EXTENT_NONE)
+        vmm_extent_free_head = vmm_extents[id].next;
+    return id;
+}
+
+static void vmm_extent_drop(uint16_t id)
+{
+    vmm_extents[id].next = vmm_extent_free_head;
+    vmm_extent_free_head = id;
+}
+
+/**
+ * @brief Smallest extent of at least @p page_count pages among the first
+ *        VMM_BEST_FIT_SCAN of class (fl, sl).
+ */
+static uint16_t vmm_class_best_fit(uint32_t fl, uint32_t sl, uint32_t page_count)
+{
+    uint16_t best = VMM_EXTENT_NONE;
+    uint32_t scanned = 0u;
+
+    for (uint16_t id = vmm_class_heads[fl][sl]; id != VMM_EXTENT_NONE && scanned < VMM_BEST_FIT_SCAN;
+         id = vmm_extents[id].next, ++scanned)
+    {
+        if (vmm_extents[id].count < page_count)
+            continue;
+        if (best == VMM_EXTENT_NONE || vmm_extents[id].count < vmm_extents[best].count)
+            best = id;
+        if (vmm_extents[id].count == page_count)
+            break;
+    }
+    return best;
+}
+
+/**
+ * @brief Best-fit extent of at least @p page_count pages.
+ *
+ * The home class may hold extents on both sides of @p page_count, so it is
+ * scanned; every class above it fits, and the bitmaps find the first non-empty
+ * one in two bit scans.
+ */
+static uint16_t vmm_find_extent(uint32_t page_count)
+{
+    uint32_t fl, sl;
+    vmm_mapping(page_count, &fl, &sl);
+
+    uint16_t id = vmm_class_best_fit(fl, sl, page_count);
+    if (id != VMM_EXTENT_NONE)
+        return id;
+
+    uint32_t sl_map = vmm_sl_bitmap[fl] & (~0u << (sl + 1u));
+    if (sl_map == 0u)
+    {
+        const uint32_t fl_map = vmm_fl_bitmap & (~0u << (fl + 1u));
+        if (fl_map == 0u)
+            return VMM_EXTENT_NONE;
+        fl = vmm_ffs(fl_map);
+        sl_map = vmm_sl_bitmap[fl];
+    }
+
+    return vmm_class_best_fit(fl, vmm_ffs(sl_map), page_count);
+}
+
+static uint32_t vmm_aligned_offset(uint16_t id, uint32_t alignment_pages)
+{
+    const uint32_t start = vmm_extents[id].start;
+    return ((start + alignment_pages - 1u) & ~(alignment_pages - 1u)) - start;
+}
+
+/**
+ * @brief Extent holding an @p alignment_pages aligned run of @p page_count.
+ *
+ * Any extent of page_count + alignment - 1 pages holds one; when none is that
+ * large, an exact fit may still sit at an aligned start, so every extent of at
+ * least @p page_count is checked. That walk only runs when the fast path fails.
+ */
+static uint16_t vmm_find_aligned_extent(uint32_t page_count, uint32_t alignment_pages, uint32_t *offset)
+{
+    if (alignment_pages == 1u)
+    {
+        *offset = 0u;
+        return vmm_find_extent(page_count);
+    }
+
+    if (page_count <= VMM_PAGE_COUNT - (alignment_pages - 1u))
+    {
+        const uint16_t id = vmm_find_extent(page_count + alignment_pages - 1u);
+        if (id != VMM_EXTENT_NONE)
+        {
+            *offset = vmm_aligned_offset(id, alignment_pages);
+            return id;
+        }
+    }
+
+    for (uint32_t fl = 0u; fl < VMM_FLI_COUNT; ++fl)
+    {
+        for (uint32_t sl = 0u; sl < VMM_SLI_COUNT; ++sl)
+        {
+            for (uint16_t id = vmm_class_heads[fl][sl]; id != VMM_EXTENT_NONE; id = vmm_extents[id].next)
             {
-                match = false;
-                i += j + 1;
-                break;
+                const uint32_t skip = vmm_aligned_offset(id, alignment_pages);
+                if (vmm_extents[id].count >= page_count && vmm_extents[id].count - page_count >= skip)
+                {
+                    *offset = skip;
+                    return id;
+                }
             }
         }
+    }
+    return VMM_EXTENT_NONE;
+}
 
-        if (match)
+/**
+ * @brief Reserve @p page_count pages at @p offset into extent @p id.
+ *
+ * What is left on each side goes back to the index; a carve from the middle
+ * needs one more extent, and fails without one.
+ */
+static bool vmm_carve(uint16_t id, uint32_t offset, uint32_t page_count)
+{
+    const uint32_t start = vmm_extents[id].start;
+    const uint32_t tail = vmm_extents[id].count - offset - page_count;
+
+    uint16_t spare = VMM_EXTENT_NONE;
+    if (offset != 0u && tail != 0u)
+    {
+        spare = vmm_extent_claim();
+        if (spare == VMM_EXTENT_NONE)
         {
-            found_index = i;
-            break;
+            ++vmm_statistics.extent_overflows;
+            return false;
+        }
+    }
+
+    vmm_index_remove(id);
+
+    if (offset != 0u)
+    {
+        vmm_extents[id].count = offset;
+        vmm_index_insert(id);
+        id = spare;
+    }
+    if (tail != 0u)
+    {
+        vmm_extents[id].start = start + offset + page_count;
+        vmm_extents[id].count = tail;
+        vmm_index_insert(id);
+        id = VMM_EXTENT_NONE;
+    }
+    if (id != VMM_EXTENT_NONE)
+        vmm_extent_drop(id);
+
+    vmm_bitmap_fill(start + offset, page_count, true);
+    return true;
+}
+
+/**
+ * @brief Give the clear run [start, start + page_count) to the index, merged
+ *        with the extents that end at @p start and begin past it.
+ * @return false when no extent is left to describe it.
+ */
+static bool vmm_extent_insert(uint32_t start, uint32_t page_count)
+{
+    const uint16_t left = vmm_boundary_find(start, true);
+    const uint16_t right = vmm_boundary_find(start + page_count, false);
+    uint16_t id = VMM_EXTENT_NONE;
+
+    if (left != VMM_EXTENT_NONE)
+    {
+        vmm_index_remove(left);
+        start = vmm_extents[left].start;
+        page_count += vmm_extents[left].count;
+        id = left;
+    }
+    if (right != VMM_EXTENT_NONE)
+    {
+        vmm_index_remove(right);
+        page_count += vmm_extents[right].count;
+        if (id == VMM_EXTENT_NONE)
+            id = right;
+        else
+            vmm_extent_drop(right);
+    }
+    if (id == VMM_EXTENT_NONE)
+        id = vmm_extent_claim();
+    if (id == VMM_EXTENT_NONE)
+        return false;
+
+    vmm_extents[id].start = start;
+    vmm_extents[id].count = page_count;
+    vmm_index_insert(id);
+    return true;
+}
+
+/* ── Size caches ──────────────────────────────────────── */
+
+/**
+ * @brief Release every cached range to the index.
+ *
+ * Runs when the index cannot serve a request, or a fixed reservation collides
+ * with a cached range, so caching never makes a reservation fail.
+ */
+static void vmm_drain_size_caches(void)
+{
+    for (uint32_t size = 1u; size <= KERNEL_VMM_SIZE_CACHE_PAGES; ++size)
+    {
+        while (vmm_size_cache_count[size - 1u] != 0u)
+        {
+            const uint32_t start = vmm_size_cache[size - 1u][--vmm_size_cache_count[size - 1u]];
+            --vmm_statistics.cached_ranges;
+            vmm_statistics.cached_pages -= size;
+            vmm_bitmap_fill(start, size, false);
+            if (!vmm_extent_insert(start, size))
+            {
+                vmm_bitmap_fill(start, size, true);
+                ++vmm_statistics.extent_overflows;
+            }
         }
     }
+    ++vmm_statistics.cache_drains;
+}
+
+/**
+ * @brief Whether [start, start + page_count) overlaps a cached range.
+ *
+ * Cached ranges look reserved in the bitmap; this is what tells a second
+ * release of one apart from a live range. Bounded by the cache size.
+ */
+static bool vmm_range_cached(uint32_t start, uint32_t page_count)
+{
+    if (vmm_statistics.cached_ranges == 0u)
+        return false;
 
-    if (found_index == 0xFFFFFFFFu)
+    for (uint32_t size = 1u; size <= KERNEL_VMM_SIZE_CACHE_PAGES; ++size)
+    {
+        for (uint32_t i = 0u; i < vmm_size_cache_count[size - 1u]; ++i)
+        {
+            const uint32_t cached = vmm_size_cache[size - 1u][i];
+            if (cached < start + page_count && start < cached + size)
+                return true;
+        }
+    }
+    return false;
+}
+
+static void vmm_release_range(uint32_t start_index, uint32_t page_count)
+{
+    if (page_count == 0u || vmm_range_cached(start_index, page_count))
+        return;
+
+    const uint32_t t0 = vmm_rdtsc_low();
+
+    if (page_count <= KERNEL_VMM_SIZE_CACHE_PAGES &&
+        vmm_size_cache_count[page_count - 1u] < KERNEL_VMM_SIZE_CACHE_DEPTH &&
+        vmm_bitmap_test(start_index) && vmm_bitmap_test(start_index + page_count - 1u))
+    {
+        bool whole = true;
+        for (uint32_t i = start_index + 1u; whole && i < start_index + page_count - 1u; ++i)
+            whole = vmm_bitmap_test(i);
+
+        if (whole)
+        {
+            vmm_size_cache[page_count - 1u][vmm_size_cache_count[page_count - 1u]++] = start_index;
+            ++vmm_statistics.cached_ranges;
+            vmm_statistics.cached_pages += page_count;
+            page_count = 0u;
+        }
+    }
+
+    /* Only reserved runs are released, so a double free cannot index a page
+       twice or hand back a range something else holds. */
+    uint32_t i = start_index;
+    while (i < start_index + page_count)
+    {
+        if (!vmm_bitmap_test(i))
+        {
+            ++i;
+            continue;
+        }
+
+        const uint32_t run = i;
+        while (i < start_index + page_count && vmm_bitmap_test(i))
+            ++i;
+
+        vmm_bitmap_fill(run, i - run, false);
+        if (!vmm_extent_insert(run, i - run))
+        {
+            vmm_bitmap_fill(run, i - run, true);
+            ++vmm_statistics.extent_overflows;
+        }
+    }
+
+    ++vmm_statistics.releases;
+    const uint32_t cycles = vmm_rdtsc_low() - t0;
+    if (cycles > vmm_statistics.release_cycles_max)
+        vmm_statistics.release_cycles_max = cycles;
+}
+
+/* ── Public API ───────────────────────────────────────── */
+
+bool kernel_vmm_initialize(void)
+{
+    memset(vmm_bitmap, 0, sizeof(vmm_bitmap));
+    memset(vmm_sl_bitmap, 0, sizeof(vmm_sl_bitmap));
+    memset(vmm_class_heads, 0xFF, sizeof(vmm_class_heads));
+    memset(vmm_by_start, 0xFF, sizeof(vmm_by_start));
+    memset(vmm_by_end, 0xFF, sizeof(vmm_by_end));
+    memset(vmm_size_cache_count, 0, sizeof(vmm_size_cache_count));
+    memset(&vmm_statistics, 0, sizeof(vmm_statistics));
+    vmm_fl_bitmap = 0u;
+
+    vmm_extent_free_head = VMM_EXTENT_NONE;
+    for (uint32_t id = KERNEL_VMM_EXTENT_CAPACITY; id-- > 0u;)
+        vmm_extent_drop((uint16_t) id);
+
+    (void) vmm_extent_insert(0u, VMM_PAGE_COUNT);
+
+    vmm_initialized = true;
+    return true;
+}
+
+void *kernel_vmm_reserve_pages(uint32_t page_count) { return kernel_vmm_reserve_pages_aligned(page_count, 1u); }
+
+void *kernel_vmm_reserve_pages_aligned(uint32_t page_count, uint32_t alignment_pages)
+{
+    if (!vmm_initialized || page_count == 0 || page_count > VMM_PAGE_COUNT)
+        return NULL;
+    if (alignment_pages == 0u || (alignment_pages & (alignment_pages - 1u)) != 0u)
         return NULL;
 
-    for (uint32_t i = 0u; i < page_count; ++i)
-        vmm_bitmap_set(found_index + i);
+    const uint32_t t0 = vmm_rdtsc_low();
+    uint32_t found_index;
 
-    vmm_last_search_index = found_index + page_count;
+    if (alignment_pages == 1u && page_count <= KERNEL_VMM_SIZE_CACHE_PAGES && vmm_size_cache_count[page_count - 1u])
+    {
+        found_index = vmm_size_cache[page_count - 1u][--vmm_size_cache_count[page_count - 1u]];
+        --vmm_statistics.cached_ranges;
+        vmm_statistics.cached_pages -= page_count;
+        ++vmm_statistics.cache_hits;
+    }
+    else
+    {
+        uint32_t offset = 0u;
+        uint16_t id = vmm_find_aligned_extent(page_count, alignment_pages, &offset);
+        if (id == VMM_EXTENT_NONE && vmm_statistics.cached_ranges != 0u)
+        {
+            vmm_drain_size_caches();
+            id = vmm_find_aligned_extent(page_count, alignment_pages, &offset);
+        }
+        found_index = (id != VMM_EXTENT_NONE) ? vmm_extents[id].start + offset : 0u;
+        if (id == VMM_EXTENT_NONE || !vmm_carve(id, offset, page_count))
+        {
+            ++vmm_statistics.failures;
+            return NULL;
+        }
+    }
+
+    ++vmm_statistics.reservations;
+    const uint32_t cycles = vmm_rdtsc_low() - t0;
+    if (cycles > vmm_statistics.reserve_cycles_max)
+        vmm_statistics.reserve_cycles_max = cycles;
 
+    /* KERNEL_VMM_DYNAMIC_START is 4 MiB aligned, so an aligned index is an
+       aligned address for every alignment up to a page directory entry. */
     return (void *) (uintptr_t) (KERNEL_VMM_DYNAMIC_START + (found_index * PAGE_SIZE));
 }
 
@@ -85,49 +632,152 @@ bool kernel_vmm_reserve_at(void *virt, uint32_t page_count)
 
     uint32_t start_index = (virt_addr - KERNEL_VMM_DYNAMIC_START) / PAGE_SIZE;
 
-    for (uint32_t i = 0u; i < page_count; ++i)
+    if (!vmm_bitmap_range_clear(start_index, page_count))
     {
-        if (vmm_bitmap_test(start_index + i))
+        if (vmm_statistics.cached_ranges == 0u)
+            return false;
+        vmm_drain_size_caches();
+        if (!vmm_bitmap_range_clear(start_index, page_count))
             return false;
     }
 
-    for (uint32_t i = 0u; i < page_count; ++i)
-        vmm_bitmap_set(start_index + i);
+    const uint32_t run_start = vmm_bitmap_run_start(start_index);
+    const uint16_t id = vmm_boundary_find(run_start, false);
+    if (id == VMM_EXTENT_NONE || !vmm_carve(id, start_index - run_start, page_count))
+        return false;
 
+    ++vmm_statistics.reservations;
     return true;
 }
 
-void *kernel_vmm_alloc_pages(uint32_t page_count)
+void kernel_vmm_get_statistics(KernelVmmStatistics_t *out)
 {
-    void *virt_base = kernel_vmm_reserve_pages(page_count);
-    if (!virt_base)
-        return NULL;
+    if (!out)
+        return;
 
-    uint32_t start_virt = (uint32_t) (uintptr_t) virt_base;
+    *out = vmm_statistics;
+    out->largest_free_pages = 0u;
+    if (vmm_fl_bitmap == 0u)
+        return;
+
+    /* Only the top non-empty class can hold the largest extent. */
+    const uint32_t fl = vmm_log2_floor(vmm_fl_bitmap);
+    const uint32_t sl = vmm_log2_floor(vmm_sl_bitmap[fl]);
+    for (uint16_t id = vmm_class_heads[fl][sl]; id != VMM_EXTENT_NONE; id = vmm_extents[id].next)
+    {
+        if (vmm_extents[id].count > out->largest_free_pages)
+            out->largest_free_pages = vmm_extents[id].count;
+    }
+}
+
+uint32_t kernel_vmm_get_fragmentation_ratio(void)
+{
+    KernelVmmStatistics_t statistics;
+    kernel_vmm_get_statistics(&statistics);
+
+    if (statistics.free_pages == 0u)
+        return 0u;
+    return 100u - (statistics.largest_free_pages * 100u) / statistics.free_pages;
+}
+
+/**
+ * @brief Back [virt, virt + page_count pages) with 4 KiB frames.
+ * @return Number of pages mapped; short of @p page_count on failure.
+ */
+static uint32_t vmm_map_small_pages(uint32_t virt, uint32_t page_count)
+{
+    PageDirectoryEntry_t pde = {0};
+    pde.present = 1;
+    pde.read_write = 1;
+    pde.user_supervisor = 0;
+
+    PageTableEntry_t pte = {0};
+    pte.present = 1;
+    pte.read_write = 1;
+    pte.user_supervisor = 0;
 
     for (uint32_t i = 0u; i < page_count; ++i)
     {
         uint32_t phys = physical_memory_manager_page_frame_allocate();
         if (phys == 0u)
+            return i;
+
+        if (!paging_map_page(virt + (i * PAGE_SIZE), phys, pde, pte))
         {
-            kernel_vmm_free_pages(virt_base, i);
-            return NULL;
+            physical_memory_manager_page_frame_free(phys);
+            return i;
         }
+    }
+
+    return page_count;
+}
+
+/**
+ * @brief Back one 4 MiB aligned chunk with a single PSE page.
+ * @return false when no order-10 block is free or the slot cannot take it.
+ */
+static bool vmm_map_large_page(uint32_t virt)
+{
+    uint32_t phys = physical_memory_manager_page_frame_allocate_order(PAGING_LARGE_PAGE_ORDER);
+    if (phys == 0u)
+        return false;
+
+    PageDirectoryEntry_t pde = {0};
+    pde.read_write = 1;
+    pde.user_supervisor = 0;
 
-        PageDirectoryEntry_t pde = {0};
-        pde.present = 1;
-        pde.read_write = 1;
-        pde.user_supervisor = 0;
+    if (!paging_map_large_page(virt, phys, pde, PAGING_MEMORY_TYPE_WRITE_BACK))
+    {
+        physical_memory_manager_page_frame_free_order(phys, PAGING_LARGE_PAGE_ORDER);
+        return false;
+    }
+
+    return true;
+}
+
+static void *vmm_alloc_pages(uint32_t page_count, bool allow_large_pages)
+{
+    /* Only a request spanning a whole PDE can use one; aligning the reservation
+       to 4 MiB costs at most the alignment gap in virtual space, never memory. */
+    allow_large_pages = allow_large_pages && paging_large_pages_available() && page_count >= VMM_PAGES_PER_LARGE_PAGE;
+
+    void *virt_base = allow_large_pages ? kernel_vmm_reserve_pages_aligned(page_count, VMM_PAGES_PER_LARGE_PAGE)
+                                        : kernel_vmm_reserve_pages(page_count);
+    if (!virt_base && allow_large_pages)
+    {
+        allow_large_pages = false;
+        virt_base = kernel_vmm_reserve_pages(page_count);
+    }
+    if (!virt_base)
+        return NULL;
+
+    uint32_t start_virt = (uint32_t) (uintptr_t) virt_base;
+    uint32_t mapped = 0u;
+
+    while (mapped < page_count)
+    {
+        uint32_t virt = start_virt + (mapped * PAGE_SIZE);
+
+        /* Each whole chunk tries a large page and falls back to 4 KiB frames on
+           its own, so a fragmented buddy still satisfies the request. */
+        if (allow_large_pages && page_count - mapped >= VMM_PAGES_PER_LARGE_PAGE && vmm_map_large_page(virt))
+        {
+            mapped += VMM_PAGES_PER_LARGE_PAGE;
+            continue;
+        }
 
-        PageTableEntry_t pte = {0};
-        pte.present = 1;
-        pte.read_write = 1;
-        pte.user_supervisor = 0;
+        uint32_t chunk = page_count - mapped;
+        if (chunk > VMM_PAGES_PER_LARGE_PAGE)
+            chunk = VMM_PAGES_PER_LARGE_PAGE;
 
-        if (!paging_map_page(start_virt + (i * PAGE_SIZE), phys, pde, pte))
+        uint32_t chunk_mapped = vmm_map_small_pages(virt, chunk);
+        mapped += chunk_mapped;
+        if (chunk_mapped != chunk)
         {
-            physical_memory_manager_page_frame_free(phys);
-            kernel_vmm_free_pages(virt_base, i);
+            kernel_vmm_free_pages(virt_base, mapped);
+            /* The pages past the mapped prefix are still reserved. */
+            vmm_release_range((uint32_t) ((start_virt - KERNEL_VMM_DYNAMIC_START) / PAGE_SIZE) + mapped,
+                              page_count - mapped);
             return NULL;
         }
     }
@@ -135,6 +785,10 @@ void *kernel_vmm_alloc_pages(uint32_t page_count)
     return virt_base;
 }
 
+void *kernel_vmm_alloc_pages(uint32_t page_count) { return vmm_alloc_pages(page_count, true); }
+
+void *kernel_vmm_alloc_small_pages(uint32_t page_count) { return vmm_alloc_pages(page_count, false); }
+
 void kernel_vmm_free_pages(void *ptr, uint32_t page_count)
 {
     if (!vmm_initialized || !ptr || page_count == 0)
@@ -145,16 +799,42 @@ void kernel_vmm_free_pages(void *ptr, uint32_t page_count)
         return;
 
     uint32_t start_index = (virt_start - KERNEL_VMM_DYNAMIC_START) / PAGE_SIZE;
+    if (page_count > VMM_PAGE_COUNT - start_index)
+        page_count = VMM_PAGE_COUNT - start_index;
 
-    for (uint32_t i = 0u; i < page_count; ++i)
+    /* One shootdown for the whole range; the frames go back once it is done. */
+    tlb_shootdown_begin();
+
+    uint32_t i = 0u;
+    while (i < page_count)
     {
         uint32_t virt = virt_start + (i * PAGE_SIZE);
         uint32_t phys = 0u;
 
-        if (paging_get_physical_address(virt, &phys))
-            physical_memory_manager_page_frame_free(phys);
+        if (paging_is_large_page(virt))
+        {
+            /* A large page is only ever released whole; a range ending inside
+               one leaves it, and its reservation, in place. */
+            if ((virt & ~PAGING_LARGE_PAGE_MASK) != 0u || page_count - i < VMM_PAGES_PER_LARGE_PAGE)
+                break;
 
+            const bool mapped = paging_get_physical_address(virt, &phys);
+            paging_unmap_large_page(virt);
+            if (mapped)
+                tlb_shootdown_defer_frame_free(phys, PAGING_LARGE_PAGE_ORDER);
+            i += VMM_PAGES_PER_LARGE_PAGE;
+            continue;
+        }
+
+        const bool mapped = paging_get_physical_address(virt, &phys);
         paging_unmap_page(virt);
-        vmm_bitmap_clear(start_index + i);
+        if (mapped)
+            tlb_shootdown_defer_frame_free(phys, 0u);
+        ++i;
     }
+
+    tlb_shootdown_end();
+
+    if (i != 0u)
+        vmm_release_range(start_index, i);
 }
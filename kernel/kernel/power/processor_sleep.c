@@ -9,6 +9,8 @@
 
 #include <kernel/power/processor_sleep.h>
 
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/cpu/tlb_shootdown.h>
 #include <kernel/lib/asmutils.h>
 
 /** CPUID leaf 1, ECX bit 3: the processor implements MONITOR and MWAIT. */
@@ -26,14 +28,32 @@
  */
 #define PROCESSOR_SLEEP_BREAK_ON_INTERRUPT 1u
 
+/**
+ * @struct ProcessorSleepAccount_t
+ * @brief One processor's sleep accounting.
+ *
+ * Per logical slot, because the APs idle here too: a single set of totals would
+ * blend a busy BSP with idle workers into a duty cycle that describes no core.
+ */
+typedef struct {
+    uint32_t sleeps;
+    uint32_t skipped;
+    uint32_t halts;
+    uint64_t asleep;
+    uint64_t awake;
+    uint64_t last_wake;
+} ProcessorSleepAccount_t;
+
 static bool processor_sleep_monitor_available = false;
 static uint32_t processor_sleep_monitor_line = 0u;
-static uint32_t processor_sleep_sleeps = 0u;
-static uint32_t processor_sleep_skipped = 0u;
-static uint32_t processor_sleep_halts = 0u;
-static uint64_t processor_sleep_asleep = 0u;
-static uint64_t processor_sleep_awake = 0u;
-static uint64_t processor_sleep_last_wake = 0u;
+static ProcessorSleepAccount_t processor_sleep_accounts[CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC];
+
+static ProcessorSleepAccount_t *processor_sleep_account(void)
+{
+    const uint32_t slot = cpu_topology_get_logical_slot();
+
+    return &processor_sleep_accounts[(slot < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC) ? slot : 0u];
+}
 
 void kernel_processor_sleep_initialize(void)
 {
@@ -44,12 +64,8 @@ void kernel_processor_sleep_initialize(void)
 
     processor_sleep_monitor_available = false;
     processor_sleep_monitor_line = 0u;
-    processor_sleep_sleeps = 0u;
-    processor_sleep_skipped = 0u;
-    processor_sleep_halts = 0u;
-    processor_sleep_asleep = 0u;
-    processor_sleep_awake = 0u;
-    processor_sleep_last_wake = 0u;
+    for (uint32_t slot = 0u; slot < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC; ++slot)
+        processor_sleep_accounts[slot] = (ProcessorSleepAccount_t) {0};
 
     asmutils_cpuid(1u, 0u, &eax, &ebx, &ecx, &edx);
     if ((ecx & PROCESSOR_SLEEP_CPUID_MONITOR_BIT) == 0u)
@@ -73,12 +89,13 @@ uint32_t kernel_processor_sleep_monitor_line_bytes(void) { return processor_slee
 
 /**
  * @brief Charges the time since the last wake-up to the awake total.
+ * @param account The calling processor's accounting.
  * @param now Current timestamp.
  */
-static void processor_sleep_charge_awake(uint64_t now)
+static void processor_sleep_charge_awake(ProcessorSleepAccount_t *account, uint64_t now)
 {
-    if (processor_sleep_last_wake != 0u && now > processor_sleep_last_wake)
-        processor_sleep_awake += now - processor_sleep_last_wake;
+    if (account->last_wake != 0u && now > account->last_wake)
+        account->awake += now - account->last_wake;
 }
 
 ProcessorSleepMode_t processor_sleep_until_write(const volatile uint32_t *watched, uint32_t expected)
@@ -89,23 +106,36 @@ ProcessorSleepMode_t processor_sleep_until_write(const volatile uint32_t *watche
         return PROCESSOR_SLEEP_HALT;
     }
 
+    ProcessorSleepAccount_t *account = processor_sleep_account();
     const uint64_t before = asmutils_read_timestamp_counter();
-    processor_sleep_charge_awake(before);
+    processor_sleep_charge_awake(account, before);
 
     if (!processor_sleep_monitor_available)
     {
+        /* The fallback has the same window the monitor closes: an interrupt that
+           makes the condition true between the check and the HLT would be taken
+           and the processor would then halt past it. Checking with interrupts off
+           and re-enabling them in the instruction right before HLT shuts it, since
+           STI only takes effect after the instruction that follows it. */
+        uint32_t eflags = 0u;
+        __asm__ volatile("pushf\n\tpop %0\n\tcli" : "=r"(eflags)::"memory");
+
         if (*watched != expected)
         {
-            ++processor_sleep_skipped;
-            processor_sleep_last_wake = before;
+            __asm__ volatile("push %0\n\tpopf" ::"r"(eflags) : "memory", "cc");
+            ++account->skipped;
+            account->last_wake = before;
             return PROCESSOR_SLEEP_NONE;
         }
-        ++processor_sleep_halts;
-        ++processor_sleep_sleeps;
-        asmutils_halt();
+        ++account->halts;
+        ++account->sleeps;
+        tlb_shootdown_enter_idle();
+        __asm__ volatile("sti\n\thlt" ::: "memory");
+        tlb_shootdown_exit_idle();
+        __asm__ volatile("push %0\n\tpopf" ::"r"(eflags) : "memory", "cc");
         const uint64_t after = asmutils_read_timestamp_counter();
-        processor_sleep_asleep += after - before;
-        processor_sleep_last_wake = after;
+        account->asleep += after - before;
+        account->last_wake = after;
         return PROCESSOR_SLEEP_HALT;
     }
 
@@ -116,48 +146,54 @@ ProcessorSleepMode_t processor_sleep_until_write(const volatile uint32_t *watche
        and MWAIT would sleep waiting for something that has already happened. */
     if (*watched != expected)
     {
-        ++processor_sleep_skipped;
-        processor_sleep_last_wake = before;
+        ++account->skipped;
+        account->last_wake = before;
         return PROCESSOR_SLEEP_NONE;
     }
 
-    ++processor_sleep_sleeps;
+    ++account->sleeps;
+    tlb_shootdown_enter_idle();
     asmutils_monitor_wait(0u, PROCESSOR_SLEEP_BREAK_ON_INTERRUPT);
+    tlb_shootdown_exit_idle();
 
     const uint64_t after = asmutils_read_timestamp_counter();
-    processor_sleep_asleep += after - before;
-    processor_sleep_last_wake = after;
+    account->asleep += after - before;
+    account->last_wake = after;
     return PROCESSOR_SLEEP_MONITOR;
 }
 
 void processor_sleep_until_interrupt(void)
 {
+    ProcessorSleepAccount_t *account = processor_sleep_account();
     const uint64_t before = asmutils_read_timestamp_counter();
-    processor_sleep_charge_awake(before);
+    processor_sleep_charge_awake(account, before);
 
-    ++processor_sleep_sleeps;
-    ++processor_sleep_halts;
+    ++account->sleeps;
+    ++account->halts;
+    tlb_shootdown_enter_idle();
     asmutils_halt();
+    tlb_shootdown_exit_idle();
 
     const uint64_t after = asmutils_read_timestamp_counter();
-    processor_sleep_asleep += after - before;
-    processor_sleep_last_wake = after;
+    account->asleep += after - before;
+    account->last_wake = after;
 }
 
-uint32_t kernel_processor_sleep_count(void) { return processor_sleep_sleeps; }
+uint32_t kernel_processor_sleep_count(void) { return processor_sleep_account()->sleeps; }
 
-uint32_t kernel_processor_sleep_skipped_count(void) { return processor_sleep_skipped; }
+uint32_t kernel_processor_sleep_skipped_count(void) { return processor_sleep_account()->skipped; }
 
-uint32_t kernel_processor_sleep_halt_count(void) { return processor_sleep_halts; }
+uint32_t kernel_processor_sleep_halt_count(void) { return processor_sleep_account()->halts; }
 
-uint64_t kernel_processor_sleep_asleep_cycles(void) { return processor_sleep_asleep; }
+uint64_t kernel_processor_sleep_asleep_cycles(void) { return processor_sleep_account()->asleep; }
 
-uint64_t kernel_processor_sleep_awake_cycles(void) { return processor_sleep_awake; }
+uint64_t kernel_processor_sleep_awake_cycles(void) { return processor_sleep_account()->awake; }
 
 uint32_t kernel_processor_sleep_duty_cycle_permille(void)
 {
-    const uint64_t accounted = processor_sleep_awake + processor_sleep_asleep;
+    const ProcessorSleepAccount_t *account = processor_sleep_account();
+    const uint64_t accounted = account->awake + account->asleep;
     if (accounted == 0u)
         return 1000u;
-    return (uint32_t) ((processor_sleep_awake * 1000u) / accounted);
+    return (uint32_t) ((account->awake * 1000u) / accounted);
 }
@@ -9,7 +9,10 @@
 
 #include <kernel/power/tickless.h>
 
+#include <kernel/core/timer.h>
 #include <kernel/cpu/apic_timer.h>
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/diag/telemetry_stream.h>
 #include <kernel/lib/asmutils.h>
 #include <kernel/power/processor_sleep.h>
 
@@ -34,7 +37,12 @@ bool kernel_tickless_enable(bool no_world_instantiated, uint32_t nominal_frequen
     if (nominal_frequency_hz != 0u)
         tickless_nominal_hz = nominal_frequency_hz;
 
-    advanced_pic_timer_backend_disable();
+    /* With the timer subsystem on the LAPIC only the tick goes; disabling the
+       local timer would take every other deadline with it. */
+    if (kernel_timer_is_active())
+        kernel_timer_system_tick_stop();
+    else
+        advanced_pic_timer_backend_disable();
     tickless_permitted = true;
     return true;
 }
@@ -45,34 +53,94 @@ void kernel_tickless_disable(uint32_t periodic_frequency_hz)
     if (periodic_frequency_hz == 0u)
         periodic_frequency_hz = tickless_nominal_hz;
     tickless_nominal_hz = periodic_frequency_hz;
-    (void) advanced_pic_timer_backend_enable_periodic_mode(periodic_frequency_hz);
+    if (!kernel_timer_system_tick_start(periodic_frequency_hz))
+        (void) advanced_pic_timer_backend_enable_periodic_mode(periodic_frequency_hz);
 }
 
 bool kernel_tickless_enabled(void) { return tickless_permitted; }
 
-uint32_t kernel_tickless_sleep(uint32_t microseconds)
+/** @brief A watched sleep when there is something to watch, a plain halt otherwise. */
+static void tickless_wait(const volatile uint32_t *watched, uint32_t expected)
+{
+    if (watched != NULL)
+        (void) processor_sleep_until_write(watched, expected);
+    else
+        processor_sleep_until_interrupt();
+}
+
+static void tickless_wake_callback(KernelTimer_t *timer, void *context)
+{
+    (void) timer;
+    (void) context;
+}
+
+/**
+ * @brief The sleep when the timer subsystem owns the local timer.
+ *
+ * The deadline is a precise one-shot kernel timer: its interrupt is what ends the
+ * sleep, and the callback has nothing to add. The TSC says how long was spent, and
+ * a timer still pending on waking means something else woke the core first.
+ */
+static uint32_t tickless_sleep_on_timer(const volatile uint32_t *watched, uint32_t expected, uint32_t microseconds)
+{
+    static KernelTimer_t wake[CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC];
+    const uint32_t cpu = cpu_topology_get_logical_slot() % CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC;
+    const uint64_t start = kernel_timer_now();
+
+    kernel_timer_setup(&wake[cpu], "tickless_wake", tickless_wake_callback, NULL, KERNEL_TIMER_FLAG_PRECISE);
+    if (!kernel_timer_arm(&wake[cpu], start + kernel_timer_microseconds_to_cycles(microseconds), 0u))
+    {
+        tickless_wait(watched, expected);
+        return 0u;
+    }
+
+    tickless_wait(watched, expected);
+    if (kernel_timer_cancel(&wake[cpu]))
+        ++tickless_early_wakes;
+
+    uint32_t elapsed = kernel_timer_cycles_to_microseconds(kernel_timer_now() - start);
+    if (elapsed > microseconds)
+        elapsed = microseconds;
+
+    tickless_slept_microseconds += elapsed;
+    tickless_ticks_avoided += (uint32_t) (((uint64_t) elapsed * (uint64_t) tickless_nominal_hz) / 1000000u);
+    return elapsed;
+}
+
+/**
+ * @brief Arms the deadline, sleeps through @p watched (or until any interrupt when
+ *        NULL), and accounts the time spent.
+ */
+static uint32_t tickless_sleep_on(const volatile uint32_t *watched, uint32_t expected, uint32_t microseconds)
 {
     if (microseconds > KERNEL_TICKLESS_MAX_SLEEP_MICROSECONDS)
         microseconds = KERNEL_TICKLESS_MAX_SLEEP_MICROSECONDS;
 
+    /* A core about to sleep has time to spare; spend one drain budget of it on
+       telemetry before the deadline is armed, so the sleep still measures itself. */
+    (void) kernel_telemetry_stream_drain(0u);
+
     if (!tickless_permitted)
     {
         /* Without permission the tick is still running, so waiting means taking the
            interrupts it delivers. Honest and unremarkable — and counted the same way,
            so a profile cannot claim a saving it did not make. */
-        processor_sleep_until_interrupt();
+        tickless_wait(watched, expected);
         return 0u;
     }
 
+    if (kernel_timer_is_active())
+        return tickless_sleep_on_timer(watched, expected, microseconds);
+
     const uint32_t timer_hz = advanced_pic_timer_backend_get_calibrated_timer_frequency_hz();
     if (timer_hz == 0u || !advanced_pic_timer_backend_arm_one_shot(microseconds))
     {
-        processor_sleep_until_interrupt();
+        tickless_wait(watched, expected);
         return 0u;
     }
 
     const uint32_t armed = advanced_pic_timer_backend_read_current_count();
-    processor_sleep_until_interrupt();
+    tickless_wait(watched, expected);
     const uint32_t remaining = advanced_pic_timer_backend_read_current_count();
 
     advanced_pic_timer_backend_disable();
@@ -93,6 +161,14 @@ uint32_t kernel_tickless_sleep(uint32_t microseconds)
     return elapsed;
 }
 
+uint32_t kernel_tickless_sleep(uint32_t microseconds) { return tickless_sleep_on(NULL, 0u, microseconds); }
+
+uint32_t kernel_tickless_sleep_until_write(const volatile uint32_t *watched, uint32_t expected,
+                                           uint32_t microseconds)
+{
+    return tickless_sleep_on(watched, expected, microseconds);
+}
+
 uint32_t kernel_tickless_ticks_avoided(void) { return tickless_ticks_avoided; }
 
 uint32_t kernel_tickless_early_wakes(void) { return tickless_early_wakes; }
@@ -9,6 +9,8 @@
 
 #include <kernel/satellite/satellite_app.h>
 
+#include <kernel/core/timer.h>
+#include <kernel/drivers/hda.h>
 #include <kernel/hal/hal_audio.h>
 #include <kernel/power/frequency_scaling.h>
 #include <kernel/power/processor_sleep.h>
@@ -20,28 +22,189 @@
 /** Microseconds of audio in one buffer, and therefore the longest useful sleep. */
 #define SATELLITE_FRAME_MICROSECONDS 40000u
 
+/**
+ * Deadline on a sleep that waits for the capture handler.
+ *
+ * A watchdog rather than a cadence: the handler's write is what is supposed to end
+ * the sleep, and with the tick stopped nothing else would if the codec went quiet.
+ */
+#define SATELLITE_WATCHDOG_MICROSECONDS (2u * SATELLITE_FRAME_MICROSECONDS)
+
+/** Wakes one frame may take before the loop stops waiting for it. A frame is five
+ *  periods, so five is the expected number and anything near this is a stalled codec. */
+#define SATELLITE_WAKES_PER_FRAME 16u
+
+/**
+ * @struct SatellitePhase_t
+ * @brief What one capture mode cost, before it is folded into the report.
+ */
+typedef struct {
+    uint32_t frames;
+    uint64_t latency_total;
+    uint32_t latency_max;
+    uint64_t asleep;
+    uint64_t awake;
+} SatellitePhase_t;
+
+/**
+ * The polled phase's frame cadence: a periodic kernel timer that only counts.
+ *
+ * Re-armed from its own deadline, so forty frames end forty periods after the
+ * first rather than forty periods plus however long each pump and drain took,
+ * which is what a sleep of one period after the work drifted by.
+ */
+static KernelTimer_t satellite_frame_timer;
+static volatile uint32_t satellite_frame_cadence = 0u;
+
+static void satellite_frame_due(KernelTimer_t *timer, void *context)
+{
+    (void) timer;
+    (void) context;
+    ++satellite_frame_cadence;
+}
+
+/**
+ * @brief Takes every buffer waiting and measures each one.
+ *
+ * @param report Receives the level of the last one.
+ * @param phase  Receives the count and the latencies.
+ * @return Buffers taken.
+ */
+static uint32_t satellite_drain(SatelliteReport_t *report, SatellitePhase_t *phase)
+{
+    /* Static rather than automatic: 640 samples is 1280 bytes, and a kernel stack is
+       not the place to put them. */
+    static int16_t frame[KERNEL_HAL_AUDIO_FRAME_SAMPLES];
+    uint32_t taken = 0u;
+
+    while (hardware_abstraction_layer_audio_capture_take(frame, KERNEL_HAL_AUDIO_FRAME_SAMPLES) != 0u)
+    {
+        ++taken;
+        const uint32_t latency = hardware_abstraction_layer_audio_capture_latency_microseconds();
+        phase->latency_total += latency;
+        if (latency > phase->latency_max)
+            phase->latency_max = latency;
+
+        report->capture_peak = 0u;
+        for (uint32_t s = 0u; s < KERNEL_HAL_AUDIO_FRAME_SAMPLES; ++s)
+        {
+            const int32_t magnitude = frame[s] < 0 ? -(int32_t) frame[s] : (int32_t) frame[s];
+            if ((uint32_t) magnitude > report->capture_peak)
+                report->capture_peak = (uint32_t) magnitude;
+        }
+    }
+    phase->frames += taken;
+    return taken;
+}
+
+/**
+ * @brief Runs the node for @p iterations frames in one capture mode.
+ *
+ * Both modes do the same work per frame — take everything waiting, measure it — and
+ * differ only in how they wait, which is the thing being measured. Polled, the loop is
+ * the producer, so it pumps and sleeps to the frame deadline: audio that finished just
+ * after the pump waits most of a frame to be noticed. Interrupt-driven, it sleeps on
+ * the ring's write cursor and the handler ends the sleep one period at a time.
+ *
+ * @param iterations       Frames to run.
+ * @param interrupt_driven Mode to run in.
+ * @param report           Receives the running totals.
+ * @param phase            Receives this mode's cost.
+ */
+static void satellite_run_phase(uint32_t iterations, bool interrupt_driven, SatelliteReport_t *report,
+                                SatellitePhase_t *phase)
+{
+    SatellitePhase_t discarded = {0};
+
+    (void) hardware_abstraction_layer_audio_set_capture_interrupt_driven(interrupt_driven);
+
+    /* Whatever queued up before this phase is stale by however long the previous one
+       took; counting it would charge that to this mode's latency. */
+    (void) hardware_abstraction_layer_audio_capture_pump();
+    (void) satellite_drain(report, &discarded);
+
+    const volatile uint32_t *const cursor = hardware_abstraction_layer_audio_capture_write_index();
+    const bool polled = !interrupt_driven || cursor == NULL;
+    bool cadence = false;
+
+    if (polled)
+    {
+        kernel_timer_setup(&satellite_frame_timer, "satellite_frame", satellite_frame_due, NULL, 0u);
+        cadence = kernel_timer_arm_microseconds(&satellite_frame_timer, SATELLITE_FRAME_MICROSECONDS,
+                                                SATELLITE_FRAME_MICROSECONDS);
+    }
+
+    const uint64_t asleep_before = kernel_processor_sleep_asleep_cycles();
+    const uint64_t awake_before = kernel_processor_sleep_awake_cycles();
+
+    for (uint32_t i = 0u; i < iterations; ++i)
+    {
+        ++report->idle_iterations;
+
+        if (polled)
+        {
+            const uint32_t seen = satellite_frame_cadence;
+
+            (void) hardware_abstraction_layer_audio_capture_pump();
+            (void) satellite_drain(report, phase);
+
+            /* Sleep to the frame deadline, the honest wait for a polled producer.
+               With the cadence timer the deadline is its next expiry, and a frame
+               that overran it has already bumped the count and does not sleep at
+               all; without it, a one-shot of one frame. Either way nothing but that
+               deadline wakes the core, which is what proves the periodic tick
+               really is stopped rather than merely quiet. */
+            if (cadence)
+                (void) kernel_tickless_sleep_until_write(&satellite_frame_cadence, seen,
+                                                         SATELLITE_WATCHDOG_MICROSECONDS);
+            else
+                (void) kernel_tickless_sleep(SATELLITE_FRAME_MICROSECONDS);
+            continue;
+        }
+
+        /* The cursor is read BEFORE the drain, so a period that lands between the
+           drain and the sleep changes it and the sleep returns at once rather than
+           waiting a period for nothing. */
+        for (uint32_t wakes = 0u; wakes < SATELLITE_WAKES_PER_FRAME; ++wakes)
+        {
+            const uint32_t seen = *cursor;
+            if (satellite_drain(report, phase) != 0u)
+                break;
+            (void) kernel_tickless_sleep_until_write(cursor, seen, SATELLITE_WATCHDOG_MICROSECONDS);
+        }
+    }
+
+    if (cadence)
+        (void) kernel_timer_cancel(&satellite_frame_timer);
+
+    phase->asleep = kernel_processor_sleep_asleep_cycles() - asleep_before;
+    phase->awake = kernel_processor_sleep_awake_cycles() - awake_before;
+    report->frames_captured += phase->frames;
+}
+
+/** @brief Awake share of a phase, in thousandths; 1000 when nothing was accounted. */
+static uint32_t satellite_phase_duty(const SatellitePhase_t *phase)
+{
+    const uint64_t accounted = phase->asleep + phase->awake;
+    if (accounted == 0u)
+        return 1000u;
+    return (uint32_t) ((phase->awake * 1000u) / accounted);
+}
+
+/** @brief Mean latency of a phase's buffers, in microseconds. */
+static uint32_t satellite_phase_latency(const SatellitePhase_t *phase)
+{
+    if (phase->frames == 0u)
+        return 0u;
+    return (uint32_t) (phase->latency_total / phase->frames);
+}
+
 bool kernel_satellite_app_run(uint32_t iterations, SatelliteReport_t *out)
 {
     if (out == NULL)
         return false;
 
-    SatelliteReport_t report;
-    report.idle_iterations = 0u;
-    report.sleeps = 0u;
-    report.sleeps_skipped = 0u;
-    report.halts = 0u;
-    report.duty_permille = 0u;
-    report.ticks_avoided = 0u;
-    report.monitor_available = 0u;
-    report.scaling_available = 0u;
-    report.scaling_refused = 0u;
-    report.governed_state = 0u;
-    report.audio_present = 0u;
-    report.output_ceiling = 0u;
-    report.limiter_clipped = 0u;
-    report.limiter_peak = 0u;
-    report.frames_captured = 0u;
-    report.capture_peak = 0u;
+    SatelliteReport_t report = {0};
 
     kernel_processor_sleep_initialize();
     kernel_frequency_scaling_initialize();
@@ -76,35 +239,51 @@ bool kernel_satellite_app_run(uint32_t iterations, SatelliteReport_t *out)
         }
     }
 
-    for (uint32_t i = 0u; i < iterations; ++i)
+    /* The same node twice: once polling, once woken by the handler. Half the frames
+       each when there is a handler to compare against, all of them polled when there
+       is not — the polled numbers are then the only ones, and the interrupt fields
+       stay zero rather than repeating them. */
     {
-        ++report.idle_iterations;
+        SatellitePhase_t polled = {0};
+        SatellitePhase_t interrupt = {0};
+
+        const bool has_interrupt = hardware_abstraction_layer_audio_set_capture_interrupt_driven(true);
+        const uint32_t polled_iterations = has_interrupt ? iterations / 2u : iterations;
 
-        /* Take whatever the controller has finished. This is the producer: the driver
-           polls its stream's link position, so nothing advances the ring unless it is
-           asked to. Sleeping on the write index — the shape this profile will use once
-           an interrupt handler pushes buffers — would here be a wait on an address only
-           this loop ever writes, which is a wait that cannot end. */
-        report.frames_captured += hardware_abstraction_layer_audio_capture_pump();
+        satellite_run_phase(polled_iterations, false, &report, &polled);
+        if (has_interrupt)
+            satellite_run_phase(iterations - polled_iterations, true, &report, &interrupt);
 
-        /* Drain one buffer and measure it. Static rather than automatic: 640 samples is
-           1280 bytes, and a kernel stack is not the place to put them. */
+        report.polled_duty_permille = satellite_phase_duty(&polled);
+        report.polled_latency_microseconds = satellite_phase_latency(&polled);
+        report.polled_latency_max_microseconds = polled.latency_max;
+        if (has_interrupt)
         {
-            static int16_t frame[KERNEL_HAL_AUDIO_FRAME_SAMPLES];
-            const uint32_t samples =
-                hardware_abstraction_layer_audio_capture_take(frame, KERNEL_HAL_AUDIO_FRAME_SAMPLES);
-            for (uint32_t s = 0u; s < samples; ++s)
-            {
-                const int32_t magnitude = frame[s] < 0 ? -(int32_t) frame[s] : (int32_t) frame[s];
-                if ((uint32_t) magnitude > report.capture_peak)
-                    report.capture_peak = (uint32_t) magnitude;
-            }
+            report.interrupt_driven = 1u;
+            report.interrupt_duty_permille = satellite_phase_duty(&interrupt);
+            report.interrupt_latency_microseconds = satellite_phase_latency(&interrupt);
+            report.interrupt_latency_max_microseconds = interrupt.latency_max;
         }
 
-        /* Sleep to the frame deadline. It is the honest wait for a polled producer, and
-           it still exercises the one-shot timer, which is what proves the periodic tick
-           really is stopped rather than merely quiet. */
-        (void) kernel_tickless_sleep(SATELLITE_FRAME_MICROSECONDS);
+        /* Leave the capture the way bring-up set it: the handler, wherever there is one. */
+        (void) hardware_abstraction_layer_audio_set_capture_interrupt_driven(true);
+        report.capture_interrupts = intel_high_definition_audio_state()->interrupts_taken;
+    }
+
+    /* The playback path end to end, up to the mute. A quiet square wave is limited,
+       queued and started, then flushed — the flush being the part a cut-off reply
+       depends on, so it is checked to have stopped the stream rather than assumed. */
+    if (report.audio_present != 0u)
+    {
+        static int16_t tone[KERNEL_HAL_AUDIO_FRAME_SAMPLES];
+        for (uint32_t i = 0u; i < KERNEL_HAL_AUDIO_FRAME_SAMPLES; ++i)
+            tone[i] = ((i / 20u) % 2u == 0u) ? 1024 : -1024;
+
+        if (hardware_abstraction_layer_audio_playback_submit(tone, KERNEL_HAL_AUDIO_FRAME_SAMPLES))
+            ++report.playback_frames;
+        report.playback_started = hardware_abstraction_layer_audio_playback_active() ? 1u : 0u;
+        hardware_abstraction_layer_audio_playback_flush();
+        report.playback_flushed = hardware_abstraction_layer_audio_playback_active() ? 0u : 1u;
     }
 
     report.sleeps = kernel_processor_sleep_count();
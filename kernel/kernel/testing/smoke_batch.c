@@ -121,6 +121,12 @@ void smoke_batch_run_initialization_tests(Serial_t *com1)
 
     if (KERNEL_SMOKE_TEST_ENABLE_IOAPIC_READINESS)
         smoke_test_run_ioapic_readiness(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_IRQ_FPU)
+        smoke_test_run_irq_fpu_lazy_save(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_MEMORY_BANDWIDTH)
+        smoke_test_run_memory_size_class_bandwidth(com1);
 }
 
 void smoke_batch_run_post_boot_tests(Serial_t *com1)
@@ -135,6 +141,64 @@ void smoke_batch_run_post_boot_tests(Serial_t *com1)
     if (KERNEL_SMOKE_TEST_ENABLE_RECONCILER)
         smoke_test_run_reconciler(com1);
 
+    /* Post-boot so every AP that is coming up has registered as a worker. */
+    if (KERNEL_SMOKE_TEST_ENABLE_JOB_SYSTEM)
+        smoke_test_run_job_system_parallel_fold(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_LOCK_CONTENTION)
+        smoke_test_run_lock_contention(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_HEAP_MAGAZINE)
+        smoke_test_run_heap_magazine_stress(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_RING_INSTANCES)
+        smoke_test_run_ring_instances(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_TRACE_OVERHEAD)
+        smoke_test_run_trace_overhead(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_LFB_FILL_RATE)
+        smoke_test_run_lfb_fill_rate(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_LARGE_PAGE_WALK)
+        smoke_test_run_large_page_walk(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_DMA_CONTIGUOUS)
+        smoke_test_run_dma_contiguous(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_VMM_RANGE)
+        smoke_test_run_vmm_range_allocator(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_PMM_PAGE_CHURN)
+        smoke_test_run_pmm_page_churn(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_TLB_SHOOTDOWN)
+        smoke_test_run_tlb_shootdown_batch(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_ALLOCATOR_INSTANCES)
+        smoke_test_run_allocator_instances(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_SLAB_CACHE)
+        smoke_test_run_slab_cache(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_TLSF_TRACE_REPLAY)
+        smoke_test_run_tlsf_trace_replay(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_TIMER_WHEEL)
+        smoke_test_run_timer_wheel(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_THREAD_SCHEDULER)
+        smoke_test_run_thread_scheduler(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_INPUT_EVENT_RING)
+        smoke_test_run_input_event_ring(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_MSI_VECTORS)
+        smoke_test_run_msi_vectors(com1);
+
+    if (KERNEL_SMOKE_TEST_ENABLE_INTERRUPT_AFFINITY)
+        smoke_test_run_interrupt_affinity(com1);
+
     if (KERNEL_SMOKE_TEST_ENABLE_DIVISION_ERROR)
         smoke_test_run_division_error();
     if (KERNEL_SMOKE_TEST_ENABLE_DEBUG_EXCEPTION)
@@ -794,6 +794,34 @@ void smoke_libengine_run_all(Serial_t *com1)
             serial_write_string(com1, kernel_satellite_app_audio_name());
             serial_write_string(com1, "\n");
 
+            /* What the capture handler is worth, as the two numbers it exists to move:
+               how stale a buffer is when the node gets it, and how much of its life the
+               processor spends awake to get it. Both modes ran on the same codec in the
+               same boot, so the difference is the handler and nothing else. */
+            const struct {
+                const char *label;
+                uint32_t value;
+            } capture_rows[] = {
+                {"irq=",             satellite.interrupt_driven                  },
+                {", polled_duty=",   satellite.polled_duty_permille              },
+                {", polled_lat_us=", satellite.polled_latency_microseconds       },
+                {", polled_max_us=", satellite.polled_latency_max_microseconds   },
+                {", irq_duty=",      satellite.interrupt_duty_permille           },
+                {", irq_lat_us=",    satellite.interrupt_latency_microseconds    },
+                {", irq_max_us=",    satellite.interrupt_latency_max_microseconds},
+                {", interrupts=",    satellite.capture_interrupts                },
+                {", played=",        satellite.playback_frames                   },
+                {", play_started=",  satellite.playback_started                  },
+                {", play_flushed=",  satellite.playback_flushed                  },
+            };
+            serial_write_string(com1, "[" KERNEL_SYSTEM_STRING "]: audio capture: ");
+            for (size_t i = 0u; i < sizeof(capture_rows) / sizeof(capture_rows[0]); ++i)
+            {
+                serial_write_string(com1, capture_rows[i].label);
+                serial_write_int(com1, (int32_t) capture_rows[i].value);
+            }
+            serial_write_string(com1, "\n");
+
             /* The controller, in its own words. Reported field by field because the
                interesting failures are partial: a controller that resets but whose
                codec never announces itself, and one whose codec answers, are
@@ -803,25 +831,34 @@ void smoke_libengine_run_all(Serial_t *com1)
                 const char *label;
                 uint32_t value;
             } hda_rows[] = {
-                {"present=",     (uint32_t) hda->controller_present},
-                {", running=",   (uint32_t) hda->controller_running},
-                {", rings=",     (uint32_t) hda->rings_running     },
-                {", version=",   (uint32_t) hda->major_version     },
-                {", in=",        (uint32_t) hda->input_streams     },
-                {", out=",       (uint32_t) hda->output_streams    },
-                {", codecs=",    (uint32_t) hda->codec_mask        },
-                {", vendor0=",   hda->codec_vendor[0]              },
-                {", verbs=",     hda->verbs_sent                   },
-                {", answers=",   hda->responses_read               },
-                {", timeouts=",  hda->verb_timeouts                },
-                {", widgets=",   (uint32_t) hda->widgets_walked    },
-                {", converter=", (uint32_t) hda->capture_converter },
-                {", pin=",       (uint32_t) hda->capture_pin       },
-                {", playpin=",   (uint32_t) hda->playback_pin      },
-                {", muted=",     (uint32_t) hda->outputs_muted     },
-                {", capturing=", (uint32_t) hda->capture_running   },
-                {", position=",  hda->capture_position             },
-                {", wraps=",     hda->capture_wraps                },
+                {"present=",     (uint32_t) hda->controller_present     },
+                {", running=",   (uint32_t) hda->controller_running     },
+                {", rings=",     (uint32_t) hda->rings_running          },
+                {", version=",   (uint32_t) hda->major_version          },
+                {", in=",        (uint32_t) hda->input_streams          },
+                {", out=",       (uint32_t) hda->output_streams         },
+                {", codecs=",    (uint32_t) hda->codec_mask             },
+                {", vendor0=",   hda->codec_vendor[0]                   },
+                {", verbs=",     hda->verbs_sent                        },
+                {", answers=",   hda->responses_read                    },
+                {", timeouts=",  hda->verb_timeouts                     },
+                {", widgets=",   (uint32_t) hda->widgets_walked         },
+                {", converter=", (uint32_t) hda->capture_converter      },
+                {", pin=",       (uint32_t) hda->capture_pin            },
+                {", playpin=",   (uint32_t) hda->playback_pin           },
+                {", muted=",     (uint32_t) hda->outputs_muted          },
+                {", capturing=", (uint32_t) hda->capture_running        },
+                {", position=",  hda->capture_position                  },
+                {", wraps=",     hda->capture_wraps                     },
+                {", periods=",   hda->capture_periods                   },
+                {", overruns=",  hda->capture_overruns                  },
+                {", line=",      (uint32_t) hda->interrupt_line         },
+                {", ioapic=",    (uint32_t) hda->interrupt_routed_ioapic},
+                {", vector=",    (uint32_t) hda->interrupt_vector       },
+                {", irqs=",      hda->interrupts_taken                  },
+                {", errors=",    hda->stream_errors                     },
+                {", playready=", (uint32_t) hda->playback_ready         },
+                {", playback=",  hda->playback_periods                  },
             };
             serial_write_string(com1, "[" KERNEL_SYSTEM_STRING "]: intel-hda: ");
             for (size_t i = 0u; i < sizeof(hda_rows) / sizeof(hda_rows[0]); ++i)
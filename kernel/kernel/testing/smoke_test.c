@@ -3,22 +3,39 @@
 #include <kernel/config.h>
 #include <kernel/memory/pool_allocator.h>
 
+#include <kernel/ai/tensor_arena.h>
+#include <kernel/core/job_system.h>
+#include <kernel/core/lock.h>
 #include <kernel/core/reconciler.h>
+#include <kernel/core/thread.h>
+#include <kernel/core/timer.h>
 #include <kernel/cpu/acpi.h>
+#include <kernel/cpu/apic_ipi.h>
 #include <kernel/cpu/apic_timer.h>
 #include <kernel/cpu/clock.h>
 #include <kernel/cpu/cpu_topology.h>
+#include <kernel/cpu/fpu.h>
 #include <kernel/cpu/gdt.h>
+#include <kernel/cpu/interrupt_affinity.h>
+#include <kernel/cpu/interrupt_vector.h>
 #include <kernel/cpu/ioapic.h>
 #include <kernel/cpu/irq.h>
 #include <kernel/cpu/isr.h>
+#include <kernel/cpu/msi.h>
 #include <kernel/cpu/paging.h>
 #include <kernel/cpu/pmm.h>
 #include <kernel/cpu/ring3.h>
+#include <kernel/cpu/tlb_shootdown.h>
 #include <kernel/diag/telemetry.h>
+#include <kernel/diag/telemetry_stream.h>
+#include <kernel/diag/trace.h>
 #include <kernel/drivers/framebuffer.h>
+#include <kernel/drivers/input_event.h>
+#include <kernel/hal/hal.h>
 #include <kernel/lib/asmutils.h>
+#include <kernel/memory/allocator_registry.h>
 #include <kernel/memory/backpressure.h>
+#include <kernel/memory/dma.h>
 #include <kernel/memory/frame_arena.h>
 #include <kernel/memory/heap.h>
 #include <kernel/memory/pool_allocator.h>
@@ -30,6 +47,9 @@
 #include <kernel/memory/vmm.h>
 #include <kernel/testing/smoke_test.h>
 
+#include <string.h>
+#include <sys/memory_dispatch.h>
+
 void smoke_test_run_physical_memory_manager_allocate_free(Serial_t *serial_port)
 {
     uint32_t page_address_1 = physical_memory_manager_page_frame_allocate();
@@ -693,21 +713,36 @@ void smoke_test_run_slab_alloc_free(Serial_t *serial_port)
     uint32_t domain_count = kernel_heap_get_server_domain_count();
     bool domain_meta_ok = (domain_count >= 1u) && (kernel_heap_get_server_active_domain() == 0u);
     uint32_t active_domain = kernel_heap_get_server_active_domain();
-    uint32_t remote_probe_before = kernel_heap_get_server_domain_remote_probe_count(active_domain);
-    uint32_t remote_hit_before = kernel_heap_get_server_domain_remote_hit_count(active_domain);
     bool remote_cross_domain_ok = true;
 
     if (domain_count > 1u)
     {
+        /* Slot 1 only reaches the depot once both of its magazines are dry,
+           and slot 0 only publishes a full magazine once both of its own are
+           full: empty the one, overfill the other, then ask slot 1 again. */
+        void *drained[32u];
+        void *seed[48u];
+        uint32_t drained_count = 0u;
+        uint32_t seed_count = kernel_heap_get_server_magazine_rounds() * 3u;
+
+        if (seed_count > 48u)
+            seed_count = 48u;
+
+        bool switch_to_one_first_ok = cpu_topology_debug_force_logical_slot(1u);
+        while (drained_count < 32u && kernel_heap_get_size_class_free_count(3u) > 0u)
+            drained[drained_count++] = kmalloc(64u);
+
         bool switch_to_zero_ok = cpu_topology_debug_force_logical_slot(0u);
         uint32_t remote_probe_domain1_before = kernel_heap_get_server_domain_remote_probe_count(1u);
         uint32_t remote_hit_domain1_before = kernel_heap_get_server_domain_remote_hit_count(1u);
 
-        void *seed = kmalloc(64u);
-        if (seed)
-            kfree(seed);
+        for (uint32_t i = 0u; i < seed_count; ++i)
+            seed[i] = kmalloc(64u);
+        for (uint32_t i = 0u; i < seed_count; ++i)
+            if (seed[i])
+                kfree(seed[i]);
 
-        bool switch_to_one_ok = cpu_topology_debug_force_logical_slot(1u);
+        bool switch_to_one_ok = cpu_topology_debug_force_logical_slot(1u) && switch_to_one_first_ok;
         void *remote_candidate = kmalloc(64u);
 
         uint32_t remote_probe_domain1_after = kernel_heap_get_server_domain_remote_probe_count(1u);
@@ -715,6 +750,9 @@ void smoke_test_run_slab_alloc_free(Serial_t *serial_port)
 
         if (remote_candidate)
             kfree(remote_candidate);
+        for (uint32_t i = 0u; i < drained_count; ++i)
+            if (drained[i])
+                kfree(drained[i]);
 
         cpu_topology_debug_clear_forced_logical_slot();
         void *restore = kmalloc(8u);
@@ -730,6 +768,9 @@ void smoke_test_run_slab_alloc_free(Serial_t *serial_port)
                                  (remote_hit_domain1_after > remote_hit_domain1_before) && (active_domain == 0u);
     }
 
+    uint32_t remote_probe_before = kernel_heap_get_server_domain_remote_probe_count(active_domain);
+    uint32_t remote_hit_before = kernel_heap_get_server_domain_remote_hit_count(active_domain);
+
     for (uint32_t ci = 0u; ci < 3u; ++ci)
     {
         uint32_t sz = sc_sizes[ci];
@@ -1651,9 +1692,14 @@ void smoke_test_run_apic_periodic_mode(Serial_t *serial_port)
     serial_write_int(serial_port, (int32_t) interrupt_request_is_timer_owner_apic());
     serial_write_string(serial_port, ", periodic=");
     serial_write_int(serial_port, (int32_t) advanced_pic_timer_backend_is_periodic_mode_enabled());
+    serial_write_string(serial_port, ", timer_tick=");
+    serial_write_int(serial_port, (int32_t) kernel_timer_system_tick_running());
     serial_write_string(serial_port, "\n");
 
-    if (!interrupt_request_is_timer_owner_apic() || !advanced_pic_timer_backend_is_periodic_mode_enabled())
+    /* The tick may run as periodic mode or as a periodic kernel timer on the same
+       LAPIC; either way it has to advance. */
+    if (!interrupt_request_is_timer_owner_apic() ||
+        (!advanced_pic_timer_backend_is_periodic_mode_enabled() && !kernel_timer_system_tick_running()))
     {
         serial_write_string(serial_port,
                             "[" KERNEL_SYSTEM_STRING "]: APIC periodic smoke: skipped (owner/path inactive)\n");
@@ -2072,6 +2118,7 @@ static void ring3_syscall_handler(const InterruptFrame_t *frame)
     (void) frame;
     ++ring3_syscall_count;
     serial_write_string(&com1, "[" KERNEL_SYSTEM_STRING "]: ring3 smoke: syscall int 0x80 received (pass)\n");
+    kernel_telemetry_stream_flush();
     asmutils_disable_interrupts();
     for (;;)
         asmutils_halt();
@@ -2251,3 +2298,2559 @@ void smoke_test_run_reconciler(Serial_t *serial_port)
     kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
     kernel_telemetry_end_record();
 }
+
+/** Entities the job system smoke integrates: the order of the engine's server
+    profile, large enough to split into more jobs than there are cores. */
+#define SMOKE_JOB_SYSTEM_ENTITY_COUNT 8192u
+#define SMOKE_JOB_SYSTEM_GRAIN        256u
+#define SMOKE_JOB_SYSTEM_STEP_COUNT   32u
+
+static uint32_t smoke_job_system_parallel_state[SMOKE_JOB_SYSTEM_ENTITY_COUNT];
+static uint32_t smoke_job_system_serial_state[SMOKE_JOB_SYSTEM_ENTITY_COUNT];
+
+/* A damped Q16.16 spring per entity, seeded from its index alone. Integer-only on
+   purpose: the comparison below is bit for bit, and it has to be the scheduling
+   that is under test, not the rounding mode of whichever core ran the job. */
+static void smoke_job_system_integrate(void *context, uint32_t begin, uint32_t end)
+{
+    uint32_t *state = (uint32_t *) context;
+
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        int32_t position = (int32_t) (i * 2654435761u) >> 8;
+        int32_t velocity = (int32_t) ((i * 40503u) & 0xFFFFu) - 0x8000;
+
+        for (uint32_t step = 0u; step < SMOKE_JOB_SYSTEM_STEP_COUNT; ++step)
+        {
+            velocity -= (position >> 10) + (velocity >> 6);
+            position += velocity >> 4;
+        }
+
+        state[i] = (uint32_t) position ^ (((uint32_t) velocity << 16) | ((uint32_t) velocity >> 16));
+    }
+}
+
+static uint32_t smoke_job_system_fold(const uint32_t *state)
+{
+    uint32_t hash = 2166136261u;
+
+    for (uint32_t i = 0u; i < SMOKE_JOB_SYSTEM_ENTITY_COUNT; ++i)
+        hash = (hash ^ state[i]) * 16777619u;
+    return hash;
+}
+
+void smoke_test_run_job_system_parallel_fold(Serial_t *serial_port)
+{
+    for (uint32_t i = 0u; i < SMOKE_JOB_SYSTEM_ENTITY_COUNT; ++i)
+    {
+        smoke_job_system_parallel_state[i] = 0u;
+        smoke_job_system_serial_state[i] = 0u;
+    }
+
+    const uint32_t executed_before = kernel_job_system_get_executed_count();
+    const uint32_t steals_before = kernel_job_system_get_steal_count();
+
+    KernelJobGroup_t group = {0};
+    const uint64_t parallel_start = asmutils_read_timestamp_counter();
+    const uint32_t jobs = kernel_job_system_submit_range(&group, smoke_job_system_integrate,
+                                                         smoke_job_system_parallel_state,
+                                                         SMOKE_JOB_SYSTEM_ENTITY_COUNT, SMOKE_JOB_SYSTEM_GRAIN);
+    kernel_job_system_wait(&group);
+    const uint64_t parallel_cycles = asmutils_read_timestamp_counter() - parallel_start;
+
+    const uint64_t serial_start = asmutils_read_timestamp_counter();
+    smoke_job_system_integrate(smoke_job_system_serial_state, 0u, SMOKE_JOB_SYSTEM_ENTITY_COUNT);
+    const uint64_t serial_cycles = asmutils_read_timestamp_counter() - serial_start;
+
+    const uint32_t parallel_fold = smoke_job_system_fold(smoke_job_system_parallel_state);
+    const uint32_t serial_fold = smoke_job_system_fold(smoke_job_system_serial_state);
+
+    /* The fold alone could hide two swapped entities that hash the same way; the
+       element scan cannot. */
+    bool identical = true;
+    for (uint32_t i = 0u; i < SMOKE_JOB_SYSTEM_ENTITY_COUNT; ++i)
+    {
+        if (smoke_job_system_parallel_state[i] != smoke_job_system_serial_state[i])
+        {
+            identical = false;
+            break;
+        }
+    }
+
+    const uint32_t expected_jobs =
+        (SMOKE_JOB_SYSTEM_ENTITY_COUNT + SMOKE_JOB_SYSTEM_GRAIN - 1u) / SMOKE_JOB_SYSTEM_GRAIN;
+    const uint32_t executed = kernel_job_system_get_executed_count() - executed_before;
+    const bool drained = (group.pending == 0u) && (jobs == expected_jobs) && (executed == jobs);
+    const bool pass = drained && identical && (parallel_fold == serial_fold);
+
+    kernel_telemetry_begin_record(serial_port, "job_system_smoke");
+    kernel_telemetry_write_unsigned("workers", kernel_job_system_get_worker_count());
+    kernel_telemetry_write_unsigned("jobs", jobs);
+    kernel_telemetry_write_unsigned("executed", executed);
+    kernel_telemetry_write_unsigned("stolen", kernel_job_system_get_steal_count() - steals_before);
+    kernel_telemetry_write_unsigned("inline", kernel_job_system_get_inline_count());
+    kernel_telemetry_write_unsigned("wakeup_ipis", kernel_job_system_get_wakeup_ipi_count());
+    kernel_telemetry_write_hexadecimal("parallel_fold", parallel_fold);
+    kernel_telemetry_write_hexadecimal("serial_fold", serial_fold);
+    kernel_telemetry_write_boolean("identical", identical);
+    kernel_telemetry_write_unsigned("parallel_cycles", (uint32_t) parallel_cycles);
+    kernel_telemetry_write_unsigned("serial_cycles", (uint32_t) serial_cycles);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+/** Software interrupts timed per mode by the IRQ FPU smoke. */
+#define SMOKE_IRQ_FPU_TIMED_INTERRUPTS 256u
+#define SMOKE_IRQ_FPU_VECTOR           0x80u
+
+static const uint32_t smoke_irq_fpu_pattern[4] __attribute__((aligned(16))) = {0x01234567u, 0x89ABCDEFu,
+                                                                              0x0F1E2D3Cu, 0x4B5A6978u};
+static const uint32_t smoke_irq_fpu_scramble[4] __attribute__((aligned(16))) = {0xDEADBEEFu, 0xDEADBEEFu,
+                                                                               0xDEADBEEFu, 0xDEADBEEFu};
+
+static void smoke_irq_fpu_integer_handler(const InterruptFrame_t *frame) { (void) frame; }
+
+/* Touches XMM0 from inside the handler, which is exactly what the lazy path has
+   to catch: the #NM must save the interrupted value before this overwrites it. */
+static void smoke_irq_fpu_clobbering_handler(const InterruptFrame_t *frame)
+{
+    (void) frame;
+    __asm__ volatile("movups (%0), %%xmm0" ::"r"(smoke_irq_fpu_scramble) : "memory");
+}
+
+/* XMM0 is loaded, an interrupt whose handler clobbers it is taken, and XMM0 is
+   read back. All in one asm block: the kernel itself is not compiled for SSE, so
+   nothing else touches the register in between. */
+static bool smoke_irq_fpu_round_trip(void)
+{
+    uint32_t observed[4] __attribute__((aligned(16))) = {0u, 0u, 0u, 0u};
+
+    __asm__ volatile("movups (%0), %%xmm0\n\t"
+                     "int $0x80\n\t"
+                     "movups %%xmm0, (%1)" ::"r"(smoke_irq_fpu_pattern),
+                     "r"(observed)
+                     : "memory");
+
+    for (uint32_t i = 0u; i < 4u; ++i)
+    {
+        if (observed[i] != smoke_irq_fpu_pattern[i])
+            return false;
+    }
+    return true;
+}
+
+static uint32_t smoke_irq_fpu_time_integer_interrupts(void)
+{
+    const uint64_t start = asmutils_read_timestamp_counter();
+
+    for (uint32_t i = 0u; i < SMOKE_IRQ_FPU_TIMED_INTERRUPTS; ++i)
+        __asm__ volatile("int $0x80" ::: "memory");
+
+    return (uint32_t) ((asmutils_read_timestamp_counter() - start) / SMOKE_IRQ_FPU_TIMED_INTERRUPTS);
+}
+
+void smoke_test_run_irq_fpu_lazy_save(Serial_t *serial_port)
+{
+    const isr_handler_t previous = interrupt_service_routine_get_handler(SMOKE_IRQ_FPU_VECTOR);
+    const bool lazy_before = interrupt_fpu_is_lazy();
+    InterruptFpuStatistics_t before;
+    InterruptFpuStatistics_t after;
+
+    interrupt_service_routine_register_handler(SMOKE_IRQ_FPU_VECTOR, smoke_irq_fpu_clobbering_handler);
+
+    interrupt_fpu_set_lazy(true);
+    interrupt_fpu_get_statistics(&before);
+    const bool lazy_preserved = smoke_irq_fpu_round_trip();
+    interrupt_fpu_get_statistics(&after);
+    const uint32_t lazy_saves = after.lazy_saves - before.lazy_saves;
+
+    interrupt_fpu_set_lazy(false);
+    interrupt_fpu_get_statistics(&before);
+    const bool eager_preserved = smoke_irq_fpu_round_trip();
+    interrupt_fpu_get_statistics(&after);
+    const uint32_t eager_saves = after.eager_saves - before.eager_saves;
+
+    /* The point of the lazy path, measured rather than asserted: the same
+       integer-only handler, entered through the same stub, once per mode. */
+    interrupt_service_routine_register_handler(SMOKE_IRQ_FPU_VECTOR, smoke_irq_fpu_integer_handler);
+    const uint32_t eager_cycles = smoke_irq_fpu_time_integer_interrupts();
+
+    interrupt_fpu_set_lazy(true);
+    interrupt_fpu_get_statistics(&before);
+    const uint32_t lazy_cycles = smoke_irq_fpu_time_integer_interrupts();
+    interrupt_fpu_get_statistics(&after);
+    const uint32_t lazy_skipped = after.lazy_skipped - before.lazy_skipped;
+    const uint32_t lazy_saves_integer = after.lazy_saves - before.lazy_saves;
+
+    interrupt_fpu_set_lazy(lazy_before);
+    interrupt_service_routine_register_handler(SMOKE_IRQ_FPU_VECTOR, previous);
+
+    /* lazy_saves is exactly one: the clobbering handler's first SSE instruction
+       traps once and the rest of it runs with TS clear. Timer ticks can only add
+       to lazy_skipped, hence the lower bound there. */
+    const bool pass = lazy_preserved && eager_preserved && (lazy_saves == 1u) && (eager_saves >= 1u) &&
+                      (lazy_skipped >= SMOKE_IRQ_FPU_TIMED_INTERRUPTS) && (lazy_saves_integer == 0u);
+
+    kernel_telemetry_begin_record(serial_port, "irq_fpu_smoke");
+    kernel_telemetry_write_text("save", interrupt_fpu_uses_xsaveopt() ? "xsaveopt" : "fxsave");
+    kernel_telemetry_write_boolean("lazy_preserved", lazy_preserved);
+    kernel_telemetry_write_boolean("eager_preserved", eager_preserved);
+    kernel_telemetry_write_unsigned("lazy_saves", lazy_saves);
+    kernel_telemetry_write_unsigned("eager_saves", eager_saves);
+    kernel_telemetry_write_unsigned("lazy_skipped", lazy_skipped);
+    kernel_telemetry_write_unsigned("lazy_cycles", lazy_cycles);
+    kernel_telemetry_write_unsigned("eager_cycles", eager_cycles);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+/* Every job bumps one counter under each kind of lock, from whatever CPU the
+   job system put it on; a lost update shows up as a short total. */
+#define SMOKE_LOCK_JOB_COUNT      64u
+#define SMOKE_LOCK_ROUNDS_PER_JOB 128u
+#define SMOKE_LOCK_WRITE_EVERY    8u
+
+typedef struct {
+    KernelTicketLock_t ticket;
+    KernelMcsLock_t mcs;
+    KernelRwLock_t rw;
+    volatile uint32_t ticket_count;
+    volatile uint32_t ticket_irq_count;
+    volatile uint32_t mcs_count;
+    volatile uint32_t rw_count;
+    volatile uint32_t torn_reads;
+} SmokeLockShared_t;
+
+static SmokeLockShared_t smoke_lock_shared;
+static KernelLockStatistics_t smoke_lock_ticket_statistics;
+static KernelLockStatistics_t smoke_lock_mcs_statistics;
+static KernelLockStatistics_t smoke_lock_rw_statistics;
+
+static void smoke_lock_job(void *context, uint32_t begin, uint32_t end)
+{
+    SmokeLockShared_t *shared = (SmokeLockShared_t *) context;
+
+    for (uint32_t job = begin; job < end; ++job)
+    {
+        for (uint32_t round = 0u; round < SMOKE_LOCK_ROUNDS_PER_JOB; ++round)
+        {
+            KernelMcsNode_t node;
+
+            kernel_ticket_lock_acquire(&shared->ticket);
+            shared->ticket_count = shared->ticket_count + 1u;
+            kernel_ticket_lock_release(&shared->ticket);
+
+            const uint32_t flags = kernel_ticket_lock_acquire_irqsave(&shared->ticket);
+            shared->ticket_irq_count = shared->ticket_irq_count + 1u;
+            kernel_ticket_lock_release_irqrestore(&shared->ticket, flags);
+
+            kernel_mcs_lock_acquire(&shared->mcs, &node);
+            shared->mcs_count = shared->mcs_count + 1u;
+            kernel_mcs_lock_release(&shared->mcs, &node);
+
+            if (((job + round) % SMOKE_LOCK_WRITE_EVERY) == 0u)
+            {
+                kernel_rw_lock_write_acquire(&shared->rw);
+                shared->rw_count = shared->rw_count + 1u;
+                kernel_rw_lock_write_release(&shared->rw);
+            }
+            else
+            {
+                kernel_rw_lock_read_acquire(&shared->rw);
+                const uint32_t first = shared->rw_count;
+                const uint32_t second = shared->rw_count;
+                kernel_rw_lock_read_release(&shared->rw);
+                if (first != second)
+                    __atomic_fetch_add(&shared->torn_reads, 1u, __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+void smoke_test_run_lock_contention(Serial_t *serial_port)
+{
+    SmokeLockShared_t *shared = &smoke_lock_shared;
+    KernelJobGroup_t group = {0u};
+    uint32_t expected_writes = 0u;
+
+    kernel_ticket_lock_initialize(&shared->ticket, &smoke_lock_ticket_statistics);
+    kernel_mcs_lock_initialize(&shared->mcs, &smoke_lock_mcs_statistics);
+    kernel_rw_lock_initialize(&shared->rw, &smoke_lock_rw_statistics);
+    kernel_lock_statistics_register(&smoke_lock_ticket_statistics, "smoke_ticket");
+    kernel_lock_statistics_register(&smoke_lock_mcs_statistics, "smoke_mcs");
+    kernel_lock_statistics_register(&smoke_lock_rw_statistics, "smoke_rw");
+    shared->ticket_count = 0u;
+    shared->ticket_irq_count = 0u;
+    shared->mcs_count = 0u;
+    shared->rw_count = 0u;
+    shared->torn_reads = 0u;
+
+    for (uint32_t job = 0u; job < SMOKE_LOCK_JOB_COUNT; ++job)
+        for (uint32_t round = 0u; round < SMOKE_LOCK_ROUNDS_PER_JOB; ++round)
+            if (((job + round) % SMOKE_LOCK_WRITE_EVERY) == 0u)
+                ++expected_writes;
+
+    const uint64_t start = asmutils_read_timestamp_counter();
+    kernel_job_system_submit_range(&group, smoke_lock_job, shared, SMOKE_LOCK_JOB_COUNT, 1u);
+    kernel_job_system_wait(&group);
+    const uint64_t cycles = asmutils_read_timestamp_counter() - start;
+
+    const uint32_t expected = SMOKE_LOCK_JOB_COUNT * SMOKE_LOCK_ROUNDS_PER_JOB;
+    const bool pass = (shared->ticket_count == expected) && (shared->ticket_irq_count == expected) &&
+                      (shared->mcs_count == expected) && (shared->rw_count == expected_writes) &&
+                      (shared->torn_reads == 0u) && !kernel_ticket_lock_is_locked(&shared->ticket);
+
+    kernel_telemetry_begin_record(serial_port, "lock_smoke");
+    kernel_telemetry_write_unsigned("workers", kernel_job_system_get_worker_count());
+    kernel_telemetry_write_unsigned("ticket_count", shared->ticket_count + shared->ticket_irq_count);
+    kernel_telemetry_write_unsigned("mcs_count", shared->mcs_count);
+    kernel_telemetry_write_unsigned("rw_writes", shared->rw_count);
+    kernel_telemetry_write_unsigned("torn_reads", shared->torn_reads);
+    kernel_telemetry_write_unsigned("ticket_contended", smoke_lock_ticket_statistics.contended);
+    kernel_telemetry_write_unsigned("mcs_contended", smoke_lock_mcs_statistics.contended);
+    kernel_telemetry_write_unsigned("rw_contended", smoke_lock_rw_statistics.contended);
+    kernel_telemetry_write_unsigned("cycles", (uint32_t) cycles);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+/* Size classes the mem* dispatch tells apart: the unrolled small path, two
+   string-instruction sizes and the non-temporal block path. */
+#define SMOKE_MEMORY_CLASS_COUNT        4u
+#define SMOKE_MEMORY_BUFFER_SIZE        LIBK_MEMORY_NON_TEMPORAL_THRESHOLD
+#define SMOKE_MEMORY_BYTES_PER_CLASS    (1024u * 1024u)
+#define SMOKE_MEMORY_MINIMUM_ITERATIONS 16u
+
+static const uint32_t smoke_memory_class_size[SMOKE_MEMORY_CLASS_COUNT] = {
+    8u, 256u, 4096u, SMOKE_MEMORY_BUFFER_SIZE};
+static const char *const smoke_memory_memcpy_key[SMOKE_MEMORY_CLASS_COUNT] = {
+    "memcpy_8_mbpc", "memcpy_256_mbpc", "memcpy_4k_mbpc", "memcpy_64k_mbpc"};
+static const char *const smoke_memory_memset_key[SMOKE_MEMORY_CLASS_COUNT] = {
+    "memset_8_mbpc", "memset_256_mbpc", "memset_4k_mbpc", "memset_64k_mbpc"};
+
+/* Bytes per cycle, in thousandths: telemetry only carries integers, and the
+   small classes sit well below one byte per cycle. */
+static uint32_t smoke_memory_milli_bytes_per_cycle(uint32_t bytes, uint32_t iterations, uint64_t cycles)
+{
+    if (cycles == 0u)
+        return 0u;
+    return (uint32_t) (((uint64_t) bytes * iterations * 1000u) / cycles);
+}
+
+static uint32_t smoke_memory_iterations(uint32_t size)
+{
+    uint32_t iterations = SMOKE_MEMORY_BYTES_PER_CLASS / size;
+
+    return (iterations < SMOKE_MEMORY_MINIMUM_ITERATIONS) ? SMOKE_MEMORY_MINIMUM_ITERATIONS : iterations;
+}
+
+static uint32_t smoke_memory_time_memcpy(void *dst, const void *src, uint32_t size)
+{
+    const uint32_t iterations = smoke_memory_iterations(size);
+    const uint64_t start = asmutils_read_timestamp_counter();
+
+    for (uint32_t i = 0u; i < iterations; ++i)
+    {
+        memcpy(dst, src, size);
+        __asm__ volatile("" ::: "memory");
+    }
+    return smoke_memory_milli_bytes_per_cycle(size, iterations, asmutils_read_timestamp_counter() - start);
+}
+
+static uint32_t smoke_memory_time_memset(void *dst, uint32_t size)
+{
+    const uint32_t iterations = smoke_memory_iterations(size);
+    const uint64_t start = asmutils_read_timestamp_counter();
+
+    for (uint32_t i = 0u; i < iterations; ++i)
+    {
+        memset(dst, (int) i, size);
+        __asm__ volatile("" ::: "memory");
+    }
+    return smoke_memory_milli_bytes_per_cycle(size, iterations, asmutils_read_timestamp_counter() - start);
+}
+
+void smoke_test_run_memory_size_class_bandwidth(Serial_t *serial_port)
+{
+    /* +3 so the copy can start off a word boundary and still fit. */
+    uint8_t *source = (uint8_t *) kmalloc(SMOKE_MEMORY_BUFFER_SIZE + 3u);
+    uint8_t *destination = (uint8_t *) kmalloc(SMOKE_MEMORY_BUFFER_SIZE + 3u);
+    uint32_t memcpy_rate[SMOKE_MEMORY_CLASS_COUNT] = {0u};
+    uint32_t memset_rate[SMOKE_MEMORY_CLASS_COUNT] = {0u};
+    uint32_t memcpy_string_rate = 0u;
+    bool content_ok = false;
+    bool overlap_ok = false;
+
+    if (source && destination)
+    {
+        for (uint32_t i = 0u; i < SMOKE_MEMORY_BUFFER_SIZE + 3u; ++i)
+            source[i] = (uint8_t) (i * 31u + 7u);
+
+        for (uint32_t c = 0u; c < SMOKE_MEMORY_CLASS_COUNT; ++c)
+        {
+            memcpy_rate[c] = smoke_memory_time_memcpy(destination, source, smoke_memory_class_size[c]);
+            memset_rate[c] = smoke_memory_time_memset(destination, smoke_memory_class_size[c]);
+        }
+
+        /* The same large copy with the vector path masked off, to show what the
+           non-temporal stores buy over REP MOVS on this machine. */
+        const uint32_t features = libk_memory_dispatch_set_features(
+            libk_memory_dispatch_get_features() & ~LIBK_MEMORY_FEATURE_SSE2);
+        memcpy_string_rate = smoke_memory_time_memcpy(destination, source, SMOKE_MEMORY_BUFFER_SIZE);
+        libk_memory_dispatch_set_features(features);
+
+        /* Misaligned source, both dispatch-relevant sizes, checked byte by byte. */
+        memcpy(destination, source + 3u, SMOKE_MEMORY_BUFFER_SIZE);
+        content_ok = (memcmp(destination, source + 3u, SMOKE_MEMORY_BUFFER_SIZE) == 0);
+        for (uint32_t i = 0u; content_ok && i < SMOKE_MEMORY_BUFFER_SIZE; i += 4093u)
+            content_ok = (destination[i] == (uint8_t) ((i + 3u) * 31u + 7u));
+
+        /* Overlapping move upwards takes the backward path. */
+        memcpy(destination, source, 4096u);
+        memmove(destination + 3u, destination, 4000u);
+        overlap_ok = (memcmp(destination + 3u, source, 4000u) == 0) && (destination[2] == source[2]);
+    }
+
+    if (destination)
+        kfree(destination);
+    if (source)
+        kfree(source);
+
+    const uint32_t supported = libk_memory_dispatch_get_supported();
+    const bool pass = content_ok && overlap_ok && (memcpy_rate[0] != 0u);
+
+    kernel_telemetry_begin_record(serial_port, "memory_smoke");
+    kernel_telemetry_write_boolean("sse2", (supported & LIBK_MEMORY_FEATURE_SSE2) != 0u);
+    kernel_telemetry_write_boolean("erms", (supported & LIBK_MEMORY_FEATURE_ERMS) != 0u);
+    for (uint32_t c = 0u; c < SMOKE_MEMORY_CLASS_COUNT; ++c)
+    {
+        kernel_telemetry_write_unsigned(smoke_memory_memcpy_key[c], memcpy_rate[c]);
+        kernel_telemetry_write_unsigned(smoke_memory_memset_key[c], memset_rate[c]);
+    }
+    kernel_telemetry_write_unsigned("memcpy_64k_string_mbpc", memcpy_string_rate);
+    kernel_telemetry_write_boolean("content_ok", content_ok);
+    kernel_telemetry_write_boolean("overlap_ok", overlap_ok);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+#ifndef LPL_KERNEL_REAL_TIME_MODE
+/* Every job allocates a spread of size classes and frees half of it at once;
+   a second wave frees the other half on behalf of a neighbouring job, which
+   the job system has usually placed on a different CPU, so those frees travel
+   back to their owner's remote list. */
+#define SMOKE_MAGAZINE_JOB_COUNT      64u
+#define SMOKE_MAGAZINE_BLOCKS_PER_JOB 64u
+#define SMOKE_MAGAZINE_KEPT_PER_JOB   (SMOKE_MAGAZINE_BLOCKS_PER_JOB / 2u)
+#define SMOKE_MAGAZINE_ROUNDS         8u
+
+typedef struct {
+    uint8_t *kept[SMOKE_MAGAZINE_JOB_COUNT][SMOKE_MAGAZINE_KEPT_PER_JOB];
+    volatile uint32_t allocations;
+    volatile uint32_t failures;
+    volatile uint32_t corruptions;
+} SmokeMagazineShared_t;
+
+static SmokeMagazineShared_t smoke_magazine_shared;
+static const uint32_t smoke_magazine_sizes[8u] = {8u, 24u, 40u, 64u, 100u, 200u, 384u, 512u};
+
+static uint8_t smoke_magazine_tag(uint32_t job, uint32_t index) { return (uint8_t) (job * 13u + index * 7u + 1u); }
+
+static void smoke_magazine_allocate_job(void *context, uint32_t begin, uint32_t end)
+{
+    SmokeMagazineShared_t *shared = (SmokeMagazineShared_t *) context;
+
+    for (uint32_t job = begin; job < end; ++job)
+    {
+        uint32_t allocations = 0u;
+
+        for (uint32_t i = 0u; i < SMOKE_MAGAZINE_BLOCKS_PER_JOB; ++i)
+        {
+            const uint32_t size = smoke_magazine_sizes[(job + i) & 7u];
+            uint8_t *block = (uint8_t *) kmalloc(size);
+
+            if (!block)
+            {
+                __atomic_fetch_add(&shared->failures, 1u, __ATOMIC_RELAXED);
+                continue;
+            }
+            ++allocations;
+            block[0] = smoke_magazine_tag(job, i);
+            block[size - 1u] = smoke_magazine_tag(job, i);
+
+            if (i & 1u)
+                shared->kept[job][i >> 1] = block;
+            else
+                kfree(block);
+        }
+        __atomic_fetch_add(&shared->allocations, allocations, __ATOMIC_RELAXED);
+    }
+}
+
+static void smoke_magazine_free_job(void *context, uint32_t begin, uint32_t end)
+{
+    SmokeMagazineShared_t *shared = (SmokeMagazineShared_t *) context;
+
+    for (uint32_t job = begin; job < end; ++job)
+    {
+        const uint32_t victim = (job + 1u) % SMOKE_MAGAZINE_JOB_COUNT;
+
+        for (uint32_t k = 0u; k < SMOKE_MAGAZINE_KEPT_PER_JOB; ++k)
+        {
+            const uint32_t i = (k << 1) | 1u;
+            const uint32_t size = smoke_magazine_sizes[(victim + i) & 7u];
+            uint8_t *block = shared->kept[victim][k];
+
+            if (!block)
+                continue;
+            if (block[0] != smoke_magazine_tag(victim, i) || block[size - 1u] != smoke_magazine_tag(victim, i))
+                __atomic_fetch_add(&shared->corruptions, 1u, __ATOMIC_RELAXED);
+            shared->kept[victim][k] = NULL;
+            kfree(block);
+        }
+    }
+}
+#endif
+
+void smoke_test_run_heap_magazine_stress(Serial_t *serial_port)
+{
+#ifdef LPL_KERNEL_REAL_TIME_MODE
+    serial_write_string(serial_port, "[" KERNEL_SYSTEM_STRING "]: heap magazine smoke: skipped (client)\n");
+#else
+    SmokeMagazineShared_t *shared = &smoke_magazine_shared;
+    const uint32_t domain_count = kernel_heap_get_server_domain_count();
+    const uint32_t rejected_before = kernel_heap_debug_get_rejected_free_count();
+    uint32_t remote_free_before = 0u;
+    uint32_t remote_drain_before = 0u;
+    uint32_t depot_hit_before = 0u;
+    uint64_t cycles = 0u;
+
+    for (uint32_t slot = 0u; slot < domain_count; ++slot)
+    {
+        remote_free_before += kernel_heap_get_server_domain_remote_free_count(slot);
+        remote_drain_before += kernel_heap_get_server_domain_remote_drain_count(slot);
+        depot_hit_before += kernel_heap_get_server_domain_remote_hit_count(slot);
+    }
+
+    shared->allocations = 0u;
+    shared->failures = 0u;
+    shared->corruptions = 0u;
+
+    for (uint32_t round = 0u; round < SMOKE_MAGAZINE_ROUNDS; ++round)
+    {
+        KernelJobGroup_t group = {0u};
+        const uint64_t start = asmutils_read_timestamp_counter();
+
+        kernel_job_system_submit_range(&group, smoke_magazine_allocate_job, shared, SMOKE_MAGAZINE_JOB_COUNT, 1u);
+        kernel_job_system_wait(&group);
+        kernel_job_system_submit_range(&group, smoke_magazine_free_job, shared, SMOKE_MAGAZINE_JOB_COUNT, 1u);
+        kernel_job_system_wait(&group);
+        cycles += asmutils_read_timestamp_counter() - start;
+    }
+
+    uint32_t remote_free = 0u;
+    uint32_t remote_drain = 0u;
+    uint32_t depot_hit = 0u;
+
+    for (uint32_t slot = 0u; slot < domain_count; ++slot)
+    {
+        remote_free += kernel_heap_get_server_domain_remote_free_count(slot);
+        remote_drain += kernel_heap_get_server_domain_remote_drain_count(slot);
+        depot_hit += kernel_heap_get_server_domain_remote_hit_count(slot);
+    }
+
+    /* One kmalloc and one kfree per allocation. */
+    const uint32_t operations = shared->allocations * 2u;
+    const uint32_t ops_per_kcycle = cycles ? (uint32_t) (((uint64_t) operations * 1000u) / cycles) : 0u;
+    const uint32_t rejected = kernel_heap_debug_get_rejected_free_count() - rejected_before;
+    const bool pass = (shared->failures == 0u) && (shared->corruptions == 0u) && (rejected == 0u) &&
+                      (shared->allocations == SMOKE_MAGAZINE_ROUNDS * SMOKE_MAGAZINE_JOB_COUNT *
+                                                  SMOKE_MAGAZINE_BLOCKS_PER_JOB);
+
+    kernel_telemetry_begin_record(serial_port, "heap_magazine_smoke");
+    kernel_telemetry_write_unsigned("workers", kernel_job_system_get_worker_count());
+    kernel_telemetry_write_unsigned("operations", operations);
+    kernel_telemetry_write_unsigned("cycles", (uint32_t) cycles);
+    kernel_telemetry_write_unsigned("ops_per_kcycle", ops_per_kcycle);
+    kernel_telemetry_write_unsigned("remote_frees", remote_free - remote_free_before);
+    kernel_telemetry_write_unsigned("remote_drains", remote_drain - remote_drain_before);
+    kernel_telemetry_write_unsigned("depot_hits", depot_hit - depot_hit_before);
+    kernel_telemetry_write_unsigned("failures", shared->failures);
+    kernel_telemetry_write_unsigned("corruptions", shared->corruptions);
+    kernel_telemetry_write_unsigned("rejected_frees", rejected);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+#endif
+}
+
+/* Every job pushes its own range of values through one shared MPMC ring in
+   batches and pulls whatever batches come out, so each claim races the other
+   CPUs' claims on both cursors. The sum of everything dequeued, jobs plus the
+   final drain, must equal the sum of everything enqueued. */
+#define SMOKE_RING_JOB_COUNT      32u
+#define SMOKE_RING_VALUES_PER_JOB 512u
+#define SMOKE_RING_BATCH          8u
+#define SMOKE_RING_CAPACITY       64u
+
+typedef struct {
+    KernelRing_t *ring;
+    volatile uint32_t dequeued;
+    volatile uint32_t sum_low;
+    volatile uint32_t sum_high;
+} SmokeRingShared_t;
+
+static SmokeRingShared_t smoke_ring_shared;
+
+static void smoke_ring_account(SmokeRingShared_t *shared, const uint32_t *values, uint32_t count)
+{
+    uint64_t sum = 0u;
+
+    for (uint32_t i = 0u; i < count; ++i)
+        sum += values[i];
+
+    const uint32_t low = (uint32_t) sum;
+    const uint32_t carry = (__atomic_add_fetch(&shared->sum_low, low, __ATOMIC_RELAXED) < low) ? 1u : 0u;
+    __atomic_fetch_add(&shared->sum_high, (uint32_t) (sum >> 32) + carry, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shared->dequeued, count, __ATOMIC_RELAXED);
+}
+
+static void smoke_ring_job(void *context, uint32_t begin, uint32_t end)
+{
+    SmokeRingShared_t *shared = (SmokeRingShared_t *) context;
+
+    for (uint32_t job = begin; job < end; ++job)
+    {
+        uint32_t next = job * SMOKE_RING_VALUES_PER_JOB;
+        const uint32_t last = next + SMOKE_RING_VALUES_PER_JOB;
+
+        while (next < last)
+        {
+            uint32_t values[SMOKE_RING_BATCH];
+            uint32_t count = (last - next < SMOKE_RING_BATCH) ? last - next : SMOKE_RING_BATCH;
+
+            for (uint32_t i = 0u; i < count; ++i)
+                values[i] = next + i + 1u;
+            next += kernel_ring_enqueue_batch(shared->ring, values, sizeof(uint32_t), count);
+
+            /* Always take something back out, so a full ring cannot stall
+               every job on its enqueue at once. */
+            count = kernel_ring_dequeue_batch(shared->ring, values, sizeof(uint32_t), SMOKE_RING_BATCH);
+            smoke_ring_account(shared, values, count);
+        }
+    }
+}
+
+void smoke_test_run_ring_instances(Serial_t *serial_port)
+{
+    SmokeRingShared_t *shared = &smoke_ring_shared;
+    const uint32_t queues_before = kernel_backpressure_get_queue_count();
+    KernelRing_t *ring = kernel_ring_create("smoke_ring", sizeof(uint32_t), SMOKE_RING_CAPACITY,
+                                            KERNEL_RING_BUFFER_MODE_MPMC, KERNEL_BACKPRESSURE_POLICY_DROP_TOLERATED);
+    KernelRing_t *spsc = kernel_ring_create("smoke_ring_spsc", 64u, 3u, KERNEL_RING_BUFFER_MODE_SPSC,
+                                            KERNEL_BACKPRESSURE_POLICY_DROP_TOLERATED);
+    const bool registered = (kernel_backpressure_get_queue_count() == queues_before + 2u);
+    bool zero_copy_ok = false;
+    bool sum_ok = false;
+    uint64_t cycles = 0u;
+
+    /* Reserve/commit in place on a second instance: rounded up to 4 slots, and
+       independent of the first. */
+    if (spsc)
+    {
+        uint32_t position = 0u;
+        uint32_t length = 0u;
+        uint8_t *slot = (uint8_t *) kernel_ring_reserve(spsc, &position);
+
+        if (slot)
+        {
+            memset(slot, 0x5A, 40u);
+            kernel_ring_commit(spsc, position, 40u);
+        }
+
+        const uint8_t *seen = (const uint8_t *) kernel_ring_acquire(spsc, &position, &length);
+        zero_copy_ok = (slot != NULL) && (seen == slot) && (length == 40u) && (seen[39] == 0x5Au) &&
+                       (kernel_ring_get_capacity(spsc) == 4u);
+        if (seen)
+            kernel_ring_release(spsc, position);
+        zero_copy_ok = zero_copy_ok && (kernel_ring_get_count(spsc) == 0u);
+    }
+
+    if (ring)
+    {
+        KernelJobGroup_t group = {0u};
+        uint32_t values[SMOKE_RING_BATCH];
+        uint32_t count;
+
+        shared->ring = ring;
+        shared->dequeued = 0u;
+        shared->sum_low = 0u;
+        shared->sum_high = 0u;
+
+        const uint64_t start = asmutils_read_timestamp_counter();
+        kernel_job_system_submit_range(&group, smoke_ring_job, shared, SMOKE_RING_JOB_COUNT, 1u);
+        kernel_job_system_wait(&group);
+        while ((count = kernel_ring_dequeue_batch(ring, values, sizeof(uint32_t), SMOKE_RING_BATCH)) != 0u)
+            smoke_ring_account(shared, values, count);
+        cycles = asmutils_read_timestamp_counter() - start;
+
+        const uint64_t n = (uint64_t) SMOKE_RING_JOB_COUNT * SMOKE_RING_VALUES_PER_JOB;
+        const uint64_t expected = n * (n + 1u) / 2u;
+        const uint64_t sum = ((uint64_t) shared->sum_high << 32) | shared->sum_low;
+        sum_ok = (sum == expected) && (shared->dequeued == (uint32_t) n) && (kernel_ring_get_count(ring) == 0u);
+    }
+
+    const uint32_t high_watermark = ring ? kernel_ring_get_high_watermark(ring) : 0u;
+    const uint32_t failed_enqueues = ring ? kernel_ring_get_failed_enqueue_count(ring) : 0u;
+
+    kernel_ring_destroy(spsc);
+    kernel_ring_destroy(ring);
+    const bool unregistered = (kernel_backpressure_get_queue_count() == queues_before);
+    const bool pass = (ring != NULL) && (spsc != NULL) && registered && unregistered && zero_copy_ok && sum_ok;
+    const uint32_t items = SMOKE_RING_JOB_COUNT * SMOKE_RING_VALUES_PER_JOB * 2u;
+
+    kernel_telemetry_begin_record(serial_port, "ring_smoke");
+    kernel_telemetry_write_unsigned("workers", kernel_job_system_get_worker_count());
+    kernel_telemetry_write_boolean("registered", registered && unregistered);
+    kernel_telemetry_write_boolean("zero_copy_ok", zero_copy_ok);
+    kernel_telemetry_write_boolean("sum_ok", sum_ok);
+    kernel_telemetry_write_unsigned("high_watermark", high_watermark);
+    kernel_telemetry_write_unsigned("full_retries", failed_enqueues);
+    kernel_telemetry_write_unsigned("cycles", (uint32_t) cycles);
+    kernel_telemetry_write_unsigned("ops_per_kcycle", cycles ? (uint32_t) (((uint64_t) items * 1000u) / cycles) : 0u);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+#define SMOKE_TRACE_ITERATIONS 4096u
+#define SMOKE_TRACE_RECENT     8u
+
+static const KernelTraceEvent_t *smoke_trace_find(const KernelTraceEvent_t *events, uint32_t count, uint16_t site)
+{
+    while (count != 0u)
+    {
+        --count;
+        if (events[count].site == site)
+            return &events[count];
+    }
+
+    return NULL;
+}
+
+void smoke_test_run_trace_overhead(Serial_t *serial_port)
+{
+    KernelTraceStatistics_t before;
+    KernelTraceStatistics_t after;
+    KernelTraceEvent_t recent[SMOKE_TRACE_RECENT];
+    const bool was_recording = kernel_trace_recording;
+    bool nested_ok = false;
+
+    kernel_trace_get_statistics(&before);
+    const uint32_t span_cycles = kernel_trace_measure_span_cycles(SMOKE_TRACE_ITERATIONS);
+    kernel_trace_get_statistics(&after);
+
+    /* Interrupts may add spans of their own while the loop runs, never remove any. */
+    const bool recorded_ok = (after.events - before.events) >= SMOKE_TRACE_ITERATIONS;
+    const bool restored_ok = (kernel_trace_recording == was_recording);
+
+    if (after.rings != 0u)
+    {
+        if (!was_recording)
+            kernel_trace_enable();
+
+        KERNEL_TRACE_BEGIN(outer_span, "smoke.trace.outer");
+        {
+            KERNEL_TRACE_SCOPE("smoke.trace.inner");
+            for (volatile uint32_t spin = 0u; spin < 256u; ++spin)
+            {
+            }
+        }
+        outer_span.argument = 7u;
+        KERNEL_TRACE_END(outer_span);
+
+        const uint32_t copied = kernel_trace_copy_recent(recent, SMOKE_TRACE_RECENT);
+        const KernelTraceEvent_t *outer = smoke_trace_find(recent, copied, outer_span_trace_site.id);
+        const KernelTraceEvent_t *inner = NULL;
+
+        for (uint32_t index = 0u; outer && index < copied; ++index)
+        {
+            if (&recent[index] != outer && recent[index].site != outer->site && recent[index].start >= outer->start &&
+                recent[index].start + recent[index].duration <= outer->start + outer->duration)
+                inner = &recent[index];
+        }
+
+        nested_ok = outer && inner && (outer->argument == 7u) && (inner->duration != 0u);
+
+        if (!was_recording)
+            kernel_trace_disable();
+    }
+
+    const bool pass = (after.rings != 0u) && recorded_ok && restored_ok && nested_ok;
+
+    kernel_telemetry_begin_record(serial_port, "trace_smoke");
+    kernel_telemetry_write_unsigned("rings", after.rings);
+    kernel_telemetry_write_unsigned("sites", after.sites);
+    kernel_telemetry_write_unsigned("iterations", SMOKE_TRACE_ITERATIONS);
+    kernel_telemetry_write_unsigned("span_cycles", span_cycles);
+    kernel_telemetry_write_boolean("recorded_ok", recorded_ok);
+    kernel_telemetry_write_boolean("nested_ok", nested_ok);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+#define SMOKE_LFB_PASSES             8u
+#define SMOKE_LFB_CALIBRATION_TICKS  10u
+#define SMOKE_LFB_TICK_WAIT_SPINS    100000000u
+
+/* TSC rate over a whole number of ticks, edge to edge; 0 when the tick does not
+   advance (interrupts off, or stopped by the tickless idle). */
+static uint64_t smoke_lfb_timestamp_hz(void)
+{
+    const uint32_t tick_hz = clock_get_tick_hz();
+    uint32_t spins = 0u;
+    uint32_t tick = clock_get_tick_count();
+
+    while (clock_get_tick_count() == tick && ++spins < SMOKE_LFB_TICK_WAIT_SPINS)
+        __asm__ volatile("pause");
+
+    tick = clock_get_tick_count();
+    const uint64_t start = asmutils_read_timestamp_counter();
+
+    while (clock_get_tick_count() - tick < SMOKE_LFB_CALIBRATION_TICKS && ++spins < SMOKE_LFB_TICK_WAIT_SPINS)
+        __asm__ volatile("pause");
+
+    const uint32_t ticks = clock_get_tick_count() - tick;
+    if (ticks < SMOKE_LFB_CALIBRATION_TICKS || tick_hz == 0u)
+        return 0u;
+
+    return ((asmutils_read_timestamp_counter() - start) * tick_hz) / ticks;
+}
+
+static uint32_t smoke_lfb_megabytes_per_second(uint64_t bytes, uint64_t cycles, uint64_t timestamp_hz)
+{
+    if (cycles == 0u || timestamp_hz == 0u)
+        return 0u;
+    return (uint32_t) ((bytes * (timestamp_hz / 1000u)) / cycles / 1000u);
+}
+
+static uint64_t smoke_lfb_time_fill_rect(const framebuffer_info_t *info)
+{
+    const uint64_t start = asmutils_read_timestamp_counter();
+
+    for (uint32_t pass = 0u; pass < SMOKE_LFB_PASSES; ++pass)
+        framebuffer_fill_rect(0u, 0u, info->width, info->height, framebuffer_rgb((uint8_t) (pass * 32u), 0u, 64u));
+
+    return asmutils_read_timestamp_counter() - start;
+}
+
+static uint64_t smoke_lfb_time_display_clear(void)
+{
+    const uint64_t start = asmutils_read_timestamp_counter();
+
+    for (uint32_t pass = 0u; pass < SMOKE_LFB_PASSES; ++pass)
+        hardware_abstraction_layer_display_clear(0x00004000u | (pass * 0x20u));
+
+    return asmutils_read_timestamp_counter() - start;
+}
+
+void smoke_test_run_lfb_fill_rate(Serial_t *serial_port)
+{
+    if (!framebuffer_available())
+    {
+        serial_write_string(serial_port, "[" KERNEL_SYSTEM_STRING "]: LFB fill-rate smoke: skipped (no framebuffer)\n");
+        return;
+    }
+
+    const framebuffer_info_t *info = framebuffer_get_info();
+    const PagingMemoryType_t initial = framebuffer_get_memory_type();
+    const uint64_t bytes = (uint64_t) info->width * info->height * 4u * SMOKE_LFB_PASSES;
+    const uint64_t timestamp_hz = smoke_lfb_timestamp_hz();
+
+    /* With virtio-gpu scanning out, the HAL clears the GPU's resource in RAM and
+       the LFB type does not enter into it; only fill_rect measures the LFB then. */
+    const bool clear_hits_lfb = !hardware_abstraction_layer_virtio_gpu_display_active();
+
+    /* Every page of pitch * height has to be mapped to the physical LFB, the last
+       one included: that is what a one-table mapping got wrong past 4 MiB. */
+    const uint32_t base = (uint32_t) (uintptr_t) info->buffer;
+    const uint32_t last = base + info->pitch * info->height - 1u;
+    uint32_t last_physical = 0u;
+    const bool mapped_ok = paging_get_physical_address(last, &last_physical) &&
+                           (last_physical == info->physical_addr + info->pitch * info->height - 1u);
+
+    const PagingMemoryType_t write_through = framebuffer_set_memory_type(PAGING_MEMORY_TYPE_WRITE_THROUGH);
+    const uint64_t fill_wt = smoke_lfb_time_fill_rect(info);
+    const uint64_t clear_wt = clear_hits_lfb ? smoke_lfb_time_display_clear() : 0u;
+
+    const PagingMemoryType_t write_combining = framebuffer_set_memory_type(PAGING_MEMORY_TYPE_WRITE_COMBINING);
+    const uint64_t fill_wc = smoke_lfb_time_fill_rect(info);
+    const uint64_t clear_wc = clear_hits_lfb ? smoke_lfb_time_display_clear() : 0u;
+
+    (void) framebuffer_set_memory_type(initial);
+    framebuffer_clear(COLOR_BLACK);
+
+    const bool pat = paging_page_attribute_table_available();
+    const bool type_ok = (write_through == PAGING_MEMORY_TYPE_WRITE_THROUGH) &&
+                         (write_combining == (pat ? PAGING_MEMORY_TYPE_WRITE_COMBINING
+                                                  : PAGING_MEMORY_TYPE_WRITE_THROUGH)) &&
+                         (framebuffer_get_memory_type() == initial);
+    const bool pass = mapped_ok && type_ok && (fill_wt != 0u) && (fill_wc != 0u);
+
+    kernel_telemetry_begin_record(serial_port, "lfb_smoke");
+    kernel_telemetry_write_unsigned("width", info->width);
+    kernel_telemetry_write_unsigned("height", info->height);
+    kernel_telemetry_write_unsigned("pages", framebuffer_get_mapped_page_count());
+    kernel_telemetry_write_boolean("pat", pat);
+    kernel_telemetry_write_boolean("mapped_ok", mapped_ok);
+    kernel_telemetry_write_unsigned("tsc_mhz", (uint32_t) (timestamp_hz / 1000000u));
+    kernel_telemetry_write_unsigned("fill_rect_wt_mbps", smoke_lfb_megabytes_per_second(bytes, fill_wt, timestamp_hz));
+    kernel_telemetry_write_unsigned("fill_rect_wc_mbps", smoke_lfb_megabytes_per_second(bytes, fill_wc, timestamp_hz));
+    kernel_telemetry_write_unsigned("clear_wt_mbps", smoke_lfb_megabytes_per_second(bytes, clear_wt, timestamp_hz));
+    kernel_telemetry_write_unsigned("clear_wc_mbps", smoke_lfb_megabytes_per_second(bytes, clear_wc, timestamp_hz));
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+#define SMOKE_LARGE_PAGE_DEFAULT_PAGES 2048u  /* 8 MiB: two large pages */
+#define SMOKE_LARGE_PAGE_MAXIMUM_PAGES 4096u  /* 16 MiB */
+#define SMOKE_LARGE_PAGE_STRIDE_BYTES  (PAGE_SIZE + 64u)
+#define SMOKE_LARGE_PAGE_SWEEPS        8u
+
+/* One load per page, offset by a cache line each time so the walk spreads over
+   the sets instead of hammering one: what is left to measure is the TLB. */
+static uint64_t smoke_large_page_time_walk(volatile uint32_t *region, uint32_t bytes, uint32_t *out_sum)
+{
+    uint32_t sum = 0u;
+
+    paging_flush_tlb();
+    const uint64_t start = asmutils_read_timestamp_counter();
+
+    for (uint32_t sweep = 0u; sweep < SMOKE_LARGE_PAGE_SWEEPS; ++sweep)
+    {
+        for (uint32_t offset = 0u; offset + sizeof(uint32_t) <= bytes; offset += SMOKE_LARGE_PAGE_STRIDE_BYTES)
+            sum += region[offset / sizeof(uint32_t)];
+    }
+
+    const uint64_t cycles = asmutils_read_timestamp_counter() - start;
+    *out_sum = sum;
+    return cycles;
+}
+
+static void smoke_large_page_fill(volatile uint32_t *region, uint32_t bytes)
+{
+    for (uint32_t offset = 0u; offset + sizeof(uint32_t) <= bytes; offset += SMOKE_LARGE_PAGE_STRIDE_BYTES)
+        region[offset / sizeof(uint32_t)] = offset;
+}
+
+/* Whether the live tensor arena has at least one 4 MiB page under it. */
+static bool smoke_large_page_arena_is_large(void)
+{
+    if (!kernel_tensor_arena_ready())
+        return false;
+
+    const uint32_t base = (uint32_t) (uintptr_t) kernel_tensor_arena_base();
+    const uint32_t end = base + (uint32_t) kernel_tensor_arena_size();
+    const uint32_t first = (base + PAGING_LARGE_PAGE_SIZE - 1u) & PAGING_LARGE_PAGE_MASK;
+
+    return first >= base && first < end && paging_is_large_page(first);
+}
+
+void smoke_test_run_large_page_walk(Serial_t *serial_port)
+{
+    /* Sized on the arena when it exists, so the walk covers what inference would. */
+    uint32_t page_count = SMOKE_LARGE_PAGE_DEFAULT_PAGES;
+    if (kernel_tensor_arena_ready())
+    {
+        page_count = (uint32_t) ((kernel_tensor_arena_size() + PAGING_LARGE_PAGE_SIZE - 1u) / PAGING_LARGE_PAGE_SIZE) *
+                     (PAGING_LARGE_PAGE_SIZE / PAGE_SIZE);
+        if (page_count < SMOKE_LARGE_PAGE_DEFAULT_PAGES)
+            page_count = SMOKE_LARGE_PAGE_DEFAULT_PAGES;
+        if (page_count > SMOKE_LARGE_PAGE_MAXIMUM_PAGES)
+            page_count = SMOKE_LARGE_PAGE_MAXIMUM_PAGES;
+    }
+
+    const uint32_t bytes = page_count * PAGE_SIZE;
+    volatile uint32_t *small = (volatile uint32_t *) kernel_vmm_alloc_small_pages(page_count);
+    volatile uint32_t *large = (volatile uint32_t *) kernel_vmm_alloc_pages(page_count);
+
+    if (small == NULL || large == NULL)
+    {
+        if (small != NULL)
+            kernel_vmm_free_pages((void *) small, page_count);
+        if (large != NULL)
+            kernel_vmm_free_pages((void *) large, page_count);
+        serial_write_string(serial_port,
+                            "[" KERNEL_SYSTEM_STRING "]: large-page walk smoke: skipped (out of memory)\n");
+        return;
+    }
+
+    const uint32_t large_base = (uint32_t) (uintptr_t) large;
+    uint32_t large_pages = 0u;
+    bool translation_ok = true;
+
+    for (uint32_t offset = 0u; offset < bytes; offset += PAGING_LARGE_PAGE_SIZE)
+    {
+        if (!paging_is_large_page(large_base + offset))
+            continue;
+
+        /* The last byte of each large page must sit 4 MiB - 1 past its first. */
+        uint32_t first_physical = 0u;
+        uint32_t last_physical = 0u;
+        const uint32_t virt = large_base + offset;
+        translation_ok = translation_ok && paging_get_physical_address(virt, &first_physical) &&
+                         paging_get_physical_address(virt + PAGING_LARGE_PAGE_SIZE - 1u, &last_physical) &&
+                         (last_physical == first_physical + PAGING_LARGE_PAGE_SIZE - 1u);
+        ++large_pages;
+    }
+
+    smoke_large_page_fill(small, bytes);
+    smoke_large_page_fill(large, bytes);
+
+    uint32_t small_sum = 0u;
+    uint32_t large_sum = 0u;
+    const uint64_t small_cycles = smoke_large_page_time_walk(small, bytes, &small_sum);
+    const uint64_t large_cycles = smoke_large_page_time_walk(large, bytes, &large_sum);
+    const uint32_t accesses = ((bytes - 1u) / SMOKE_LARGE_PAGE_STRIDE_BYTES + 1u) * SMOKE_LARGE_PAGE_SWEEPS;
+
+    const uint32_t large_pages_before_free = paging_get_large_page_count();
+    kernel_vmm_free_pages((void *) small, page_count);
+    kernel_vmm_free_pages((void *) large, page_count);
+    const bool released_ok = (paging_get_large_page_count() + large_pages == large_pages_before_free);
+
+    /* Without PSE, or on a profile whose PMM has no order-10 blocks, the auto path
+       degrades to 4 KiB pages; that is a correct outcome, not a failure. */
+    const bool pse = paging_large_pages_available();
+    const bool pass = translation_ok && released_ok && (small_sum == large_sum) && (small_cycles != 0u) &&
+                      (large_cycles != 0u);
+
+    kernel_telemetry_begin_record(serial_port, "large_page_smoke");
+    kernel_telemetry_write_boolean("pse", pse);
+    kernel_telemetry_write_boolean("pge", paging_global_pages_available());
+    kernel_telemetry_write_unsigned("pages", page_count);
+    kernel_telemetry_write_unsigned("large_pages", large_pages);
+    kernel_telemetry_write_boolean("arena_large", smoke_large_page_arena_is_large());
+    kernel_telemetry_write_unsigned("walk_4k_cycles", (uint32_t) (small_cycles / accesses));
+    kernel_telemetry_write_unsigned("walk_4m_cycles", (uint32_t) (large_cycles / accesses));
+    kernel_telemetry_write_boolean("translation_ok", translation_ok);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+typedef struct SmokeDmaRequest {
+    uint32_t size;
+    uint32_t alignment;
+    uint32_t boundary;
+    PagingMemoryType_t type;
+} SmokeDmaRequest_t;
+
+/* What a ring, a descriptor list, a NIC buffer and a scanout surface would ask. */
+static const SmokeDmaRequest_t smoke_dma_requests[] = {
+    {PAGE_SIZE, 128u, 0u, PAGING_MEMORY_TYPE_UNCACHED},
+    {3u * PAGE_SIZE, 0u, 0x10000u, PAGING_MEMORY_TYPE_UNCACHED},
+    {PAGE_SIZE, 0x10000u, 0x10000u, PAGING_MEMORY_TYPE_WRITE_BACK},
+    {24u * 1024u, 0u, 0x10000u, PAGING_MEMORY_TYPE_WRITE_BACK},
+    {1024u * 1024u, 0u, 0u, PAGING_MEMORY_TYPE_WRITE_BACK},
+};
+
+#define SMOKE_DMA_REQUEST_COUNT  (sizeof(smoke_dma_requests) / sizeof(smoke_dma_requests[0]))
+#define SMOKE_DMA_CHURN_ROUNDS   16u
+
+/* Every page maps where the buffer says, and the constraints hold physically. */
+static bool smoke_dma_buffer_is_sound(const KernelDmaBuffer_t *buffer, const SmokeDmaRequest_t *request)
+{
+    const uint32_t base = buffer->physical_address;
+    const uint32_t last = base + buffer->size - 1u;
+
+    if (request->alignment != 0u && (base & (request->alignment - 1u)) != 0u)
+        return false;
+    if (request->boundary != 0u && (base & ~(request->boundary - 1u)) != (last & ~(request->boundary - 1u)))
+        return false;
+
+    for (uint32_t offset = 0u; offset < buffer->size; offset += PAGE_SIZE)
+    {
+        uint32_t physical = 0u;
+        if (!paging_get_physical_address((uint32_t) (uintptr_t) buffer->virtual_address + offset, &physical) ||
+            physical != base + offset)
+            return false;
+    }
+
+    KernelDmaBuffer_t found;
+    return kernel_dma_find((const uint8_t *) buffer->virtual_address + buffer->size - 1u, &found) &&
+           found.physical_address == base;
+}
+
+void smoke_test_run_dma_contiguous(Serial_t *serial_port)
+{
+    KernelDmaBuffer_t buffers[SMOKE_DMA_REQUEST_COUNT];
+    KernelDmaStatistics_t before;
+    KernelDmaStatistics_t after;
+    uint32_t served = 0u;
+    uint32_t refused = 0u;
+    bool sound = true;
+
+    kernel_dma_get_statistics(&before);
+    const uint32_t fragmentation_before = physical_memory_manager_get_fragmentation_ratio();
+
+    for (uint32_t index = 0u; index < SMOKE_DMA_REQUEST_COUNT; ++index)
+    {
+        const SmokeDmaRequest_t *request = &smoke_dma_requests[index];
+        if (!kernel_dma_alloc(request->size, request->alignment, request->boundary, request->type, &buffers[index]))
+        {
+            ++refused;
+            continue;
+        }
+        ++served;
+        sound = sound && smoke_dma_buffer_is_sound(&buffers[index], request);
+    }
+
+    const uint32_t fragmentation_held = physical_memory_manager_get_fragmentation_ratio();
+
+    for (uint32_t index = 0u; index < SMOKE_DMA_REQUEST_COUNT; ++index)
+    {
+        if (buffers[index].virtual_address != NULL)
+            sound = sound && kernel_dma_free(buffers[index].virtual_address);
+    }
+
+    /* A boundary smaller than the request cannot be met and must be refused. */
+    KernelDmaBuffer_t impossible;
+    const bool refuses_impossible = !kernel_dma_alloc(2u * 0x10000u, 0u, 0x10000u, PAGING_MEMORY_TYPE_WRITE_BACK,
+                                                      &impossible);
+
+    /* Descriptor-page churn: every claim after the first should be a cache hit. */
+    KernelDmaStatistics_t churn_start;
+    kernel_dma_get_statistics(&churn_start);
+    for (uint32_t round = 0u; round < SMOKE_DMA_CHURN_ROUNDS; ++round)
+    {
+        KernelDmaBuffer_t page;
+        if (kernel_dma_alloc(PAGE_SIZE, 0u, 0u, PAGING_MEMORY_TYPE_UNCACHED, &page))
+            (void) kernel_dma_free(page.virtual_address);
+    }
+
+    kernel_dma_get_statistics(&after);
+    const uint32_t fragmentation_after = physical_memory_manager_get_fragmentation_ratio();
+
+    /* The first request is a single page, which every profile can serve. */
+    const bool pass = sound && refuses_impossible && (buffers[0].virtual_address != NULL) &&
+                      (after.live_buffers == before.live_buffers) && (after.live_pages == before.live_pages);
+
+    kernel_telemetry_begin_record(serial_port, "dma_smoke");
+    kernel_telemetry_write_unsigned("served", served);
+    kernel_telemetry_write_unsigned("refused", refused);
+    kernel_telemetry_write_boolean("sound", sound);
+    kernel_telemetry_write_boolean("refuses_impossible", refuses_impossible);
+    kernel_telemetry_write_unsigned("churn_cache_hits", after.cache_hits - churn_start.cache_hits);
+    kernel_telemetry_write_unsigned("trimmed_pages", after.trimmed_pages - before.trimmed_pages);
+    kernel_telemetry_write_unsigned("fragmentation_before", fragmentation_before);
+    kernel_telemetry_write_unsigned("fragmentation_held", fragmentation_held);
+    kernel_telemetry_write_unsigned("fragmentation_after", fragmentation_after);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+#define SMOKE_VMM_RANGE_COUNT 256u
+
+/* Mostly the 1..16 page ranges stacks, rings and small buffers take, with a
+   64..128 page range every 32nd request. */
+static uint32_t smoke_vmm_range_pages(uint32_t index)
+{
+    if ((index % 32u) == 31u)
+        return 64u + (index & 64u);
+    return 1u + ((index * 7u) % 16u);
+}
+
+typedef struct SmokeVmmLatency {
+    uint32_t total;
+    uint32_t max;
+    uint32_t samples;
+} SmokeVmmLatency_t;
+
+static void *smoke_vmm_timed_reserve(uint32_t page_count, SmokeVmmLatency_t *latency)
+{
+    const uint64_t start = asmutils_read_timestamp_counter();
+    void *range = kernel_vmm_reserve_pages(page_count);
+    const uint32_t cycles = (uint32_t) (asmutils_read_timestamp_counter() - start);
+
+    latency->total += cycles;
+    if (cycles > latency->max)
+        latency->max = cycles;
+    ++latency->samples;
+    return range;
+}
+
+static uint32_t smoke_vmm_latency_average(const SmokeVmmLatency_t *latency)
+{
+    return latency->samples ? latency->total / latency->samples : 0u;
+}
+
+/* No two live ranges share a page. */
+static bool smoke_vmm_ranges_disjoint(void *const *ranges)
+{
+    for (uint32_t i = 0u; i < SMOKE_VMM_RANGE_COUNT; ++i)
+    {
+        const uint32_t a = (uint32_t) (uintptr_t) ranges[i];
+        const uint32_t a_end = a + smoke_vmm_range_pages(i) * PAGE_SIZE;
+        for (uint32_t j = i + 1u; j < SMOKE_VMM_RANGE_COUNT; ++j)
+        {
+            const uint32_t b = (uint32_t) (uintptr_t) ranges[j];
+            if (a < b + smoke_vmm_range_pages(j) * PAGE_SIZE && b < a_end)
+                return false;
+        }
+    }
+    return true;
+}
+
+void smoke_test_run_vmm_range_allocator(Serial_t *serial_port)
+{
+    void *ranges[SMOKE_VMM_RANGE_COUNT];
+    SmokeVmmLatency_t fresh = {0u, 0u, 0u};
+    SmokeVmmLatency_t refill = {0u, 0u, 0u};
+    KernelVmmStatistics_t before;
+    KernelVmmStatistics_t after;
+    bool served = true;
+
+    kernel_vmm_get_statistics(&before);
+    const uint32_t fragmentation_before = kernel_vmm_get_fragmentation_ratio();
+
+    for (uint32_t index = 0u; index < SMOKE_VMM_RANGE_COUNT; ++index)
+    {
+        ranges[index] = smoke_vmm_timed_reserve(smoke_vmm_range_pages(index), &fresh);
+        served = served && ranges[index] != NULL;
+    }
+
+    /* Punch a hole every other range, then fill them again: the refill should
+       come from the size caches and best-fit holes, not from fresh space. */
+    for (uint32_t index = 1u; index < SMOKE_VMM_RANGE_COUNT; index += 2u)
+        kernel_vmm_free_pages(ranges[index], smoke_vmm_range_pages(index));
+
+    const uint32_t fragmentation_holes = kernel_vmm_get_fragmentation_ratio();
+    KernelVmmStatistics_t holes;
+    kernel_vmm_get_statistics(&holes);
+
+    for (uint32_t index = 1u; index < SMOKE_VMM_RANGE_COUNT; index += 2u)
+    {
+        ranges[index] = smoke_vmm_timed_reserve(smoke_vmm_range_pages(index), &refill);
+        served = served && ranges[index] != NULL;
+    }
+
+    const bool disjoint = served && smoke_vmm_ranges_disjoint(ranges);
+    const uint32_t fragmentation_held = kernel_vmm_get_fragmentation_ratio();
+
+    for (uint32_t index = 0u; index < SMOKE_VMM_RANGE_COUNT; ++index)
+    {
+        if (ranges[index] != NULL)
+            kernel_vmm_free_pages(ranges[index], smoke_vmm_range_pages(index));
+    }
+
+    kernel_vmm_get_statistics(&after);
+    const uint32_t fragmentation_after = kernel_vmm_get_fragmentation_ratio();
+
+    /* Every page is back, and coalescing left no more extents than the cached
+       ranges sitting in the middle of free space can split off. */
+    const bool pages_returned = after.free_pages + after.cached_pages == before.free_pages + before.cached_pages;
+    const bool coalesced = after.extents <= before.extents + after.cached_ranges;
+    const bool pass = served && disjoint && pages_returned && coalesced &&
+                      after.extent_overflows == before.extent_overflows;
+
+    kernel_telemetry_begin_record(serial_port, "vmm_range_smoke");
+    kernel_telemetry_write_unsigned("ranges", SMOKE_VMM_RANGE_COUNT);
+    kernel_telemetry_write_boolean("disjoint", disjoint);
+    kernel_telemetry_write_unsigned("reserve_avg_cycles", smoke_vmm_latency_average(&fresh));
+    kernel_telemetry_write_unsigned("reserve_max_cycles", fresh.max);
+    kernel_telemetry_write_unsigned("refill_avg_cycles", smoke_vmm_latency_average(&refill));
+    kernel_telemetry_write_unsigned("refill_max_cycles", refill.max);
+    kernel_telemetry_write_unsigned("refill_cache_hits", after.cache_hits - holes.cache_hits);
+    kernel_telemetry_write_unsigned("holes_extents", holes.extents);
+    kernel_telemetry_write_unsigned("extents_after", after.extents);
+    kernel_telemetry_write_unsigned("fragmentation_before", fragmentation_before);
+    kernel_telemetry_write_unsigned("fragmentation_holes", fragmentation_holes);
+    kernel_telemetry_write_unsigned("fragmentation_held", fragmentation_held);
+    kernel_telemetry_write_unsigned("fragmentation_after", fragmentation_after);
+    kernel_telemetry_write_unsigned("release_max_cycles", after.release_cycles_max);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+/* Each job takes a burst of single pages and gives it back, from whatever CPU
+   the job system put it on. Every eighth burst overshoots the cache high
+   watermark so the drain path runs as well as the refill path. */
+#define SMOKE_PMM_CHURN_JOB_COUNT      32u
+#define SMOKE_PMM_CHURN_ROUNDS_PER_JOB 32u
+#define SMOKE_PMM_CHURN_BURST          24u
+#define SMOKE_PMM_CHURN_LARGE_BURST    (PHYSICAL_MEMORY_MANAGER_CACHE_HIGH_WATERMARK + 32u)
+
+typedef struct {
+    volatile uint32_t pages;
+    volatile uint32_t failures;
+    volatile uint32_t corrupted;
+} SmokePmmChurnShared_t;
+
+static SmokePmmChurnShared_t smoke_pmm_churn_shared;
+
+static void smoke_pmm_churn_job(void *context, uint32_t begin, uint32_t end)
+{
+    SmokePmmChurnShared_t *shared = (SmokePmmChurnShared_t *) context;
+    uint32_t pages[SMOKE_PMM_CHURN_LARGE_BURST];
+
+    for (uint32_t job = begin; job < end; ++job)
+    {
+        for (uint32_t round = 0u; round < SMOKE_PMM_CHURN_ROUNDS_PER_JOB; ++round)
+        {
+            const uint32_t burst = ((job + round) % 8u) == 7u ? SMOKE_PMM_CHURN_LARGE_BURST : SMOKE_PMM_CHURN_BURST;
+            uint32_t taken = 0u;
+
+            /* Tag each page with its own address: a page handed to two CPUs
+               at once comes back with the other one's tag. */
+            for (; taken < burst; ++taken)
+            {
+                pages[taken] = physical_memory_manager_page_frame_allocate();
+                if (!pages[taken])
+                {
+                    __atomic_fetch_add(&shared->failures, 1u, __ATOMIC_RELAXED);
+                    break;
+                }
+                *(volatile uint32_t *) (pages[taken] + KERNEL_VIRTUAL_BASE + sizeof(uint32_t)) = pages[taken];
+            }
+
+            for (uint32_t i = 0u; i < taken; ++i)
+            {
+                if (*(volatile uint32_t *) (pages[i] + KERNEL_VIRTUAL_BASE + sizeof(uint32_t)) != pages[i])
+                    __atomic_fetch_add(&shared->corrupted, 1u, __ATOMIC_RELAXED);
+                physical_memory_manager_page_frame_free(pages[i]);
+            }
+            __atomic_fetch_add(&shared->pages, taken, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void smoke_test_run_pmm_page_churn(Serial_t *serial_port)
+{
+    SmokePmmChurnShared_t *shared = &smoke_pmm_churn_shared;
+    KernelJobGroup_t group = {0u};
+    PhysicalMemoryManagerCacheStatistics_t before;
+    PhysicalMemoryManagerCacheStatistics_t after;
+
+    shared->pages = 0u;
+    shared->failures = 0u;
+    shared->corrupted = 0u;
+
+    const uint64_t timestamp_hz = smoke_lfb_timestamp_hz();
+    const uint32_t free_before = physical_memory_manager_get_free_page_count();
+    const uint32_t double_free_before = physical_memory_manager_debug_get_double_free_count();
+    physical_memory_manager_get_cache_statistics(&before);
+
+    const uint64_t start = asmutils_read_timestamp_counter();
+    kernel_job_system_submit_range(&group, smoke_pmm_churn_job, shared, SMOKE_PMM_CHURN_JOB_COUNT, 1u);
+    kernel_job_system_wait(&group);
+    const uint64_t cycles = asmutils_read_timestamp_counter() - start;
+
+    physical_memory_manager_get_cache_statistics(&after);
+    const uint32_t free_after = physical_memory_manager_get_free_page_count();
+
+    const uint32_t pages_per_second =
+        (cycles != 0u && timestamp_hz != 0u) ? (uint32_t) (((uint64_t) shared->pages * timestamp_hz) / cycles) : 0u;
+    const bool pass = (shared->failures == 0u) && (shared->corrupted == 0u) && (free_after == free_before) &&
+                      (physical_memory_manager_debug_get_double_free_count() == double_free_before);
+
+    kernel_telemetry_begin_record(serial_port, "pmm_churn_smoke");
+    kernel_telemetry_write_unsigned("workers", kernel_job_system_get_worker_count());
+    kernel_telemetry_write_unsigned("pages", shared->pages);
+    kernel_telemetry_write_unsigned("cycles", (uint32_t) cycles);
+    kernel_telemetry_write_unsigned("pages_per_second", pages_per_second);
+    kernel_telemetry_write_unsigned("cache_allocations", after.allocations - before.allocations);
+    kernel_telemetry_write_unsigned("refills", after.refills - before.refills);
+    kernel_telemetry_write_unsigned("drains", after.drains - before.drains);
+    kernel_telemetry_write_unsigned("cached_pages", after.cached_pages);
+    kernel_telemetry_write_unsigned("local_pages", after.local_pages - before.local_pages);
+    kernel_telemetry_write_unsigned("remote_pages", after.remote_pages - before.remote_pages);
+    kernel_telemetry_write_unsigned("fallbacks", after.fallbacks - before.fallbacks);
+    kernel_telemetry_write_unsigned("failures", shared->failures);
+    kernel_telemetry_write_unsigned("corrupted", shared->corrupted);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+/* Remaps a window under the other CPUs' feet and has them read it back: a
+   target that missed a shootdown still sees the frame the page used to map.
+   The same window is switched once page by page and twice as a batch, below
+   and above the full-flush threshold, to show what batching saves. */
+#define SMOKE_TLB_PAGE_COUNT    48u
+#define SMOKE_TLB_LIST_PAGES    16u
+#define SMOKE_TLB_READERS       32u
+
+_Static_assert(SMOKE_TLB_LIST_PAGES <= TLB_SHOOTDOWN_FULL_FLUSH_THRESHOLD, "list round must stay under the threshold");
+_Static_assert(SMOKE_TLB_PAGE_COUNT > TLB_SHOOTDOWN_FULL_FLUSH_THRESHOLD, "full round must cross the threshold");
+
+typedef struct {
+    uint32_t window;
+    uint32_t expected[SMOKE_TLB_PAGE_COUNT];
+    volatile uint32_t stale_reads;
+} SmokeTlbShared_t;
+
+typedef struct {
+    uint32_t ipis_sent;
+    uint32_t ipis_saved;
+    uint32_t lazy_skips;
+    uint32_t full_flushes;
+    uint32_t cycles;
+} SmokeTlbRound_t;
+
+static SmokeTlbShared_t smoke_tlb_shared;
+
+static void smoke_tlb_read_job(void *context, uint32_t begin, uint32_t end)
+{
+    SmokeTlbShared_t *shared = (SmokeTlbShared_t *) context;
+
+    for (uint32_t job = begin; job < end; ++job)
+    {
+        for (uint32_t page = 0u; page < SMOKE_TLB_PAGE_COUNT; ++page)
+        {
+            if (*(volatile uint32_t *) (shared->window + page * PAGE_SIZE) != shared->expected[page])
+                __atomic_fetch_add(&shared->stale_reads, 1u, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void smoke_tlb_read_everywhere(SmokeTlbShared_t *shared)
+{
+    KernelJobGroup_t group = {0u};
+
+    kernel_job_system_submit_range(&group, smoke_tlb_read_job, shared, SMOKE_TLB_READERS, 1u);
+    kernel_job_system_wait(&group);
+}
+
+static bool smoke_tlb_map(uint32_t virt, uint32_t phys)
+{
+    PageDirectoryEntry_t pde = {0};
+    pde.present = 1;
+    pde.read_write = 1;
+
+    PageTableEntry_t pte = {0};
+    pte.present = 1;
+    pte.read_write = 1;
+
+    return paging_map_page(virt, phys, pde, pte);
+}
+
+/* Points the first @p page_count pages of the window at @p frames. */
+static bool smoke_tlb_switch(SmokeTlbShared_t *shared, const uint32_t *frames, uint32_t page_count, bool batched,
+                             SmokeTlbRound_t *round)
+{
+    TlbShootdownStatistics_t before;
+    TlbShootdownStatistics_t after;
+    bool mapped = true;
+
+    tlb_shootdown_get_statistics(&before);
+    const uint64_t start = asmutils_read_timestamp_counter();
+
+    if (batched)
+        tlb_shootdown_begin();
+    for (uint32_t page = 0u; page < page_count; ++page)
+        (void) paging_unmap_page(shared->window + page * PAGE_SIZE);
+    if (batched)
+        tlb_shootdown_end();
+
+    for (uint32_t page = 0u; page < page_count; ++page)
+    {
+        mapped = smoke_tlb_map(shared->window + page * PAGE_SIZE, frames[page]) && mapped;
+        shared->expected[page] = frames[page];
+    }
+
+    round->cycles = (uint32_t) (asmutils_read_timestamp_counter() - start);
+    tlb_shootdown_get_statistics(&after);
+    round->ipis_sent = after.ipis_sent - before.ipis_sent;
+    round->ipis_saved = after.ipis_saved - before.ipis_saved;
+    round->lazy_skips = after.lazy_skips - before.lazy_skips;
+    round->full_flushes = after.full_flushes - before.full_flushes;
+    return mapped;
+}
+
+void smoke_test_run_tlb_shootdown_batch(Serial_t *serial_port)
+{
+    SmokeTlbShared_t *shared = &smoke_tlb_shared;
+    uint32_t frames_a[SMOKE_TLB_PAGE_COUNT];
+    uint32_t frames_b[SMOKE_TLB_PAGE_COUNT];
+    SmokeTlbRound_t single = {0u, 0u, 0u, 0u, 0u};
+    SmokeTlbRound_t list = {0u, 0u, 0u, 0u, 0u};
+    SmokeTlbRound_t full = {0u, 0u, 0u, 0u, 0u};
+    TlbShootdownStatistics_t before;
+    TlbShootdownStatistics_t after;
+    bool ready = true;
+
+    tlb_shootdown_get_statistics(&before);
+    shared->stale_reads = 0u;
+    shared->window = (uint32_t) (uintptr_t) kernel_vmm_reserve_pages(SMOKE_TLB_PAGE_COUNT);
+    ready = shared->window != 0u;
+
+    /* Each frame carries its own address, so a read names the frame it hit. */
+    uint32_t allocated = 0u;
+    for (; ready && allocated < SMOKE_TLB_PAGE_COUNT; ++allocated)
+    {
+        frames_a[allocated] = physical_memory_manager_page_frame_allocate();
+        frames_b[allocated] = physical_memory_manager_page_frame_allocate();
+        if (frames_a[allocated] == 0u || frames_b[allocated] == 0u)
+        {
+            if (frames_a[allocated] != 0u)
+                physical_memory_manager_page_frame_free(frames_a[allocated]);
+            if (frames_b[allocated] != 0u)
+                physical_memory_manager_page_frame_free(frames_b[allocated]);
+            ready = false;
+            break;
+        }
+        *(volatile uint32_t *) (frames_a[allocated] + KERNEL_VIRTUAL_BASE) = frames_a[allocated];
+        *(volatile uint32_t *) (frames_b[allocated] + KERNEL_VIRTUAL_BASE) = frames_b[allocated];
+    }
+
+    for (uint32_t page = 0u; ready && page < SMOKE_TLB_PAGE_COUNT; ++page)
+    {
+        ready = smoke_tlb_map(shared->window + page * PAGE_SIZE, frames_a[page]);
+        shared->expected[page] = frames_a[page];
+    }
+
+    if (ready)
+    {
+        smoke_tlb_read_everywhere(shared);
+        ready = smoke_tlb_switch(shared, frames_b, SMOKE_TLB_PAGE_COUNT, false, &single);
+        smoke_tlb_read_everywhere(shared);
+        ready = smoke_tlb_switch(shared, frames_a, SMOKE_TLB_LIST_PAGES, true, &list) && ready;
+        smoke_tlb_read_everywhere(shared);
+        ready = smoke_tlb_switch(shared, frames_b, SMOKE_TLB_PAGE_COUNT, true, &full) && ready;
+        smoke_tlb_read_everywhere(shared);
+    }
+
+    if (shared->window != 0u)
+    {
+        tlb_shootdown_begin();
+        for (uint32_t page = 0u; page < SMOKE_TLB_PAGE_COUNT; ++page)
+            (void) paging_unmap_page(shared->window + page * PAGE_SIZE);
+        tlb_shootdown_end();
+        kernel_vmm_free_pages((void *) (uintptr_t) shared->window, SMOKE_TLB_PAGE_COUNT);
+    }
+    for (uint32_t page = 0u; page < allocated; ++page)
+    {
+        physical_memory_manager_page_frame_free(frames_a[page]);
+        physical_memory_manager_page_frame_free(frames_b[page]);
+    }
+
+    tlb_shootdown_get_statistics(&after);
+
+    /* With other CPUs awake, a batch costs at most one IPI each, where the page
+       by page round paid one per page. */
+    const bool batched_cheaper = single.ipis_sent == 0u || full.ipis_sent < single.ipis_sent;
+    const bool pass = ready && shared->stale_reads == 0u && full.full_flushes == 1u && list.full_flushes == 0u &&
+                      batched_cheaper && after.timeouts == before.timeouts;
+
+    kernel_telemetry_begin_record(serial_port, "tlb_shootdown_smoke");
+    kernel_telemetry_write_unsigned("workers", kernel_job_system_get_worker_count());
+    kernel_telemetry_write_unsigned("pages", SMOKE_TLB_PAGE_COUNT);
+    kernel_telemetry_write_unsigned("single_ipis", single.ipis_sent);
+    kernel_telemetry_write_unsigned("single_cycles", single.cycles);
+    kernel_telemetry_write_unsigned("list_ipis", list.ipis_sent);
+    kernel_telemetry_write_unsigned("list_cycles", list.cycles);
+    kernel_telemetry_write_unsigned("full_ipis", full.ipis_sent);
+    kernel_telemetry_write_unsigned("full_cycles", full.cycles);
+    kernel_telemetry_write_unsigned("ipis_saved", list.ipis_saved + full.ipis_saved);
+    kernel_telemetry_write_unsigned("lazy_skips", single.lazy_skips + list.lazy_skips + full.lazy_skips);
+    kernel_telemetry_write_unsigned("stale_reads", shared->stale_reads);
+    kernel_telemetry_write_unsigned("max_cycles", after.max_cycles);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+#define SMOKE_ALLOCATOR_POOL_OBJECTS 8u
+#define SMOKE_ALLOCATOR_ARENA_BYTES  256u
+#define SMOKE_ALLOCATOR_TICK_SPIN    50000000u
+
+static volatile uint32_t smoke_allocator_local_hits = 0u;
+
+static void smoke_allocator_local_job(void *context, uint32_t begin, uint32_t end)
+{
+    (void) context;
+
+    for (uint32_t job = begin; job < end; ++job)
+    {
+        /* Whichever CPU runs the job must get memory from its own arena. */
+        uint8_t *memory = (uint8_t *) kernel_frame_arena_local_alloc(16u, 8u);
+        const KernelFrameArena_t *local = kernel_frame_arena_local();
+
+        if (memory && local && memory >= local->base && memory < local->base + local->capacity)
+            __atomic_add_fetch(&smoke_allocator_local_hits, 1u, __ATOMIC_RELAXED);
+    }
+}
+
+void smoke_test_run_allocator_instances(Serial_t *serial_port)
+{
+    const uint32_t registered_before = kernel_allocator_registry_get_count();
+    KernelPool_t *pool_a = kernel_pool_create("smoke_pool_a", 24u, SMOKE_ALLOCATOR_POOL_OBJECTS);
+    KernelPool_t *pool_b = kernel_pool_create("smoke_pool_b", 100u, 4u);
+    KernelFrameArena_t *arena = kernel_frame_arena_create("smoke_arena", SMOKE_ALLOCATOR_ARENA_BYTES);
+    KernelStackAllocator_t *stack = kernel_stack_allocator_create("smoke_stack", 256u);
+    const bool registered = kernel_allocator_registry_get_count() == registered_before + 4u;
+    void *objects[SMOKE_ALLOCATOR_POOL_OBJECTS];
+    bool pool_ok = pool_a && pool_b;
+    bool arena_ok = arena != NULL;
+    bool stack_ok = stack != NULL;
+
+    /* Two pools side by side: exhausting one leaves the other alone, and neither
+       accepts the other's objects. */
+    if (pool_ok)
+    {
+        void *other = kernel_pool_allocate(pool_b);
+
+        for (uint32_t index = 0u; index < SMOKE_ALLOCATOR_POOL_OBJECTS; ++index)
+        {
+            objects[index] = kernel_pool_allocate(pool_a);
+            pool_ok = pool_ok && objects[index] != NULL;
+        }
+        pool_ok = pool_ok && other && kernel_pool_allocate(pool_a) == NULL && pool_a->failed_alloc_count == 1u &&
+                  pool_b->failed_alloc_count == 0u && !kernel_pool_release(pool_b, objects[0]);
+
+        for (uint32_t index = 0u; index < SMOKE_ALLOCATOR_POOL_OBJECTS; ++index)
+            pool_ok = kernel_pool_release(pool_a, objects[index]) && pool_ok;
+        pool_ok = pool_ok && !kernel_pool_release(pool_a, objects[0]) && kernel_pool_release(pool_b, other) &&
+                  pool_a->free_count == SMOKE_ALLOCATOR_POOL_OBJECTS &&
+                  pool_a->peak_used == SMOKE_ALLOCATOR_POOL_OBJECTS;
+    }
+
+    if (arena_ok)
+    {
+        void *first = kernel_frame_arena_allocate(arena, 100u, 16u);
+        void *second = kernel_frame_arena_allocate(arena, 100u, 16u);
+        void *third = kernel_frame_arena_allocate(arena, 100u, 16u);
+
+        kernel_frame_arena_clear(arena);
+        arena_ok = first && second && !third && arena->offset == 0u && arena->reset_count == 1u &&
+                   kernel_frame_arena_allocate(arena, 100u, 16u) == first;
+    }
+
+    if (stack_ok)
+    {
+        const uint32_t marker = kernel_stack_allocator_marker(stack);
+        void *bottom = kernel_stack_allocator_push(stack, 64u, 16u);
+
+        stack_ok = bottom && kernel_stack_allocator_push(stack, 64u, 16u) && stack->offset == 128u;
+        kernel_stack_allocator_rollback_to(stack, marker);
+        stack_ok = stack_ok && stack->offset == marker && kernel_stack_allocator_push(stack, 8u, 16u) == bottom;
+    }
+
+    KernelAllocatorUsage_t pools;
+    const uint32_t pool_instances = kernel_allocator_registry_sum(KERNEL_ALLOCATOR_KIND_POOL, &pools);
+
+    kernel_pool_destroy(pool_a);
+    kernel_pool_destroy(pool_b);
+    kernel_frame_arena_destroy(arena);
+    kernel_stack_allocator_destroy(stack);
+    const bool unregistered = kernel_allocator_registry_get_count() == registered_before;
+
+    /* The per-CPU arena starts over once a tick has passed: the first local
+       allocation after it lands back at the base. Skipped when no tick comes. */
+    bool local_ok = false;
+    bool tick_seen = false;
+    uint32_t local_resets = 0u;
+    const KernelFrameArena_t *local = kernel_frame_arena_local();
+
+    if (local)
+    {
+        const uint32_t resets_before = local->reset_count;
+        const uint32_t tick = clock_get_tick_count();
+        void *early = kernel_frame_arena_local_alloc(32u, 16u);
+        uint32_t spin = 0u;
+
+        while (clock_get_tick_count() == tick && spin < SMOKE_ALLOCATOR_TICK_SPIN)
+        {
+            asmutils_no_operation();
+            ++spin;
+        }
+        tick_seen = clock_get_tick_count() != tick;
+
+        void *late = kernel_frame_arena_local_alloc(32u, 16u);
+        local = kernel_frame_arena_local();
+        local_resets = local->reset_count - resets_before;
+        local_ok = early && (!tick_seen || (late == local->base && local_resets >= 1u));
+    }
+
+    const uint32_t workers = kernel_job_system_get_worker_count();
+    const uint32_t jobs = workers ? workers * 4u : 1u;
+    KernelJobGroup_t group = {0u};
+
+    smoke_allocator_local_hits = 0u;
+    kernel_job_system_submit_range(&group, smoke_allocator_local_job, NULL, jobs, 1u);
+    kernel_job_system_wait(&group);
+
+    const bool pass = registered && unregistered && pool_ok && arena_ok && stack_ok && pool_instances >= 2u &&
+                      local_ok && smoke_allocator_local_hits == jobs;
+
+    kernel_telemetry_begin_record(serial_port, "allocator_instances_smoke");
+    kernel_telemetry_write_unsigned("registered", kernel_allocator_registry_get_count());
+    kernel_telemetry_write_unsigned("pool_instances", pool_instances);
+    kernel_telemetry_write_unsigned("pool_capacity", pools.capacity);
+    kernel_telemetry_write_boolean("pool_ok", pool_ok);
+    kernel_telemetry_write_boolean("arena_ok", arena_ok);
+    kernel_telemetry_write_boolean("stack_ok", stack_ok);
+    kernel_telemetry_write_boolean("unregistered", unregistered);
+    kernel_telemetry_write_boolean("tick_seen", tick_seen);
+    kernel_telemetry_write_unsigned("local_resets", local_resets);
+    kernel_telemetry_write_unsigned("local_jobs", jobs);
+    kernel_telemetry_write_unsigned("local_hits", smoke_allocator_local_hits);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+#define SMOKE_SLAB_OBJECT_SIZE   40u
+#define SMOKE_SLAB_OBJECT_ALIGN  32u
+#define SMOKE_SLAB_OBJECT_MAGIC  0x51AB0B1Eu
+#define SMOKE_SLAB_JOB_ROUNDS    64u
+#define SMOKE_SLAB_MAX_OBJECTS   (KERNEL_SLAB_CACHE_MAX_PAGES * (PAGE_SIZE / SMOKE_SLAB_OBJECT_ALIGN))
+
+static void *smoke_slab_objects[SMOKE_SLAB_MAX_OBJECTS];
+static KernelSlabCache_t *smoke_slab_job_cache = NULL;
+static volatile uint32_t smoke_slab_job_failures = 0u;
+
+static void smoke_slab_constructor(void *object) { *(uint32_t *) object = SMOKE_SLAB_OBJECT_MAGIC; }
+
+static void smoke_slab_job(void *context, uint32_t begin, uint32_t end)
+{
+    (void) context;
+
+    for (uint32_t job = begin; job < end; ++job)
+    {
+        void *held[KERNEL_SLAB_CPU_CACHE_DEPTH];
+
+        /* Alternate a burst with a round trip: bursts cross the per-CPU stack's
+           bounds, round trips should never leave it. */
+        for (uint32_t round = 0u; round < SMOKE_SLAB_JOB_ROUNDS; ++round)
+        {
+            uint32_t count = (round & 1u) ? KERNEL_SLAB_CPU_CACHE_DEPTH : 1u;
+
+            for (uint32_t index = 0u; index < count; ++index)
+            {
+                held[index] = kernel_slab_cache_alloc(smoke_slab_job_cache);
+                if (!held[index] || *(uint32_t *) held[index] != SMOKE_SLAB_OBJECT_MAGIC)
+                    __atomic_add_fetch(&smoke_slab_job_failures, 1u, __ATOMIC_RELAXED);
+            }
+            for (uint32_t index = 0u; index < count; ++index)
+            {
+                if (held[index] && !kernel_slab_cache_free(smoke_slab_job_cache, held[index]))
+                    __atomic_add_fetch(&smoke_slab_job_failures, 1u, __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+void smoke_test_run_slab_cache(Serial_t *serial_port)
+{
+    const uint32_t reserve_before = kernel_slab_get_reserve_free_pages();
+    KernelSlabCache_t *cache = kernel_slab_cache_create("smoke_slab", SMOKE_SLAB_OBJECT_SIZE, SMOKE_SLAB_OBJECT_ALIGN,
+                                                        smoke_slab_constructor);
+    KernelSlabCacheStatistics_t grown = {0};
+    KernelSlabCacheStatistics_t after = {0};
+    uint32_t allocated = 0u;
+    bool objects_ok = cache != NULL;
+    bool guard_ok = false;
+    bool destroyed = false;
+
+    /* Fill the cache to its bound: every object constructed, aligned and distinct
+       from its neighbour, then one refusal once the bound is reached. */
+    while (cache && allocated < SMOKE_SLAB_MAX_OBJECTS)
+    {
+        uint8_t *object = (uint8_t *) kernel_slab_cache_alloc(cache);
+
+        if (!object)
+            break;
+        objects_ok = objects_ok && *(uint32_t *) object == SMOKE_SLAB_OBJECT_MAGIC &&
+                     ((uintptr_t) object & (SMOKE_SLAB_OBJECT_ALIGN - 1u)) == 0u &&
+                     (allocated == 0u || object != smoke_slab_objects[allocated - 1u]);
+        smoke_slab_objects[allocated++] = object;
+    }
+
+    if (cache)
+    {
+        volatile uint32_t stack_object = 0u;
+
+        kernel_slab_cache_get_statistics(cache, &grown);
+        guard_ok = !kernel_slab_cache_free(cache, (void *) &stack_object) && allocated > 0u &&
+                   kernel_slab_cache_free(cache, smoke_slab_objects[0]) &&
+                   !kernel_slab_cache_free(cache, smoke_slab_objects[0]) &&
+                   !kernel_slab_cache_destroy(cache);
+        for (uint32_t index = 1u; index < allocated; ++index)
+            objects_ok = kernel_slab_cache_free(cache, smoke_slab_objects[index]) && objects_ok;
+
+        /* The constructor ran once per object; freed objects come back intact. */
+        void *again = kernel_slab_cache_alloc(cache);
+        objects_ok = objects_ok && again && *(uint32_t *) again == SMOKE_SLAB_OBJECT_MAGIC;
+        if (again)
+            (void) kernel_slab_cache_free(cache, again);
+
+        KernelJobGroup_t group = {0u};
+        const uint32_t workers = kernel_job_system_get_worker_count();
+
+        smoke_slab_job_cache = cache;
+        smoke_slab_job_failures = 0u;
+        kernel_job_system_submit_range(&group, smoke_slab_job, NULL, workers ? workers * 2u : 1u, 1u);
+        kernel_job_system_wait(&group);
+
+        kernel_slab_cache_get_statistics(cache, &after);
+        destroyed = kernel_slab_cache_destroy(cache);
+    }
+
+    /* kmalloc of a size the old exact-match table never served now lands in a class. */
+    const uint32_t class_used_before = kernel_slab_get_used_count(48u);
+    void *client = kmalloc(24u);
+    const uint32_t class_used_during = kernel_slab_get_used_count(48u);
+    kfree(client);
+#ifdef LPL_KERNEL_REAL_TIME_MODE
+    const bool kmalloc_ok = client && class_used_during == class_used_before + 1u;
+#else
+    const bool kmalloc_ok = client && class_used_during == class_used_before;
+#endif
+
+    const bool bounded = grown.pages == KERNEL_SLAB_CACHE_MAX_PAGES ? grown.alloc_failures >= 1u
+                                                                     : kernel_slab_get_reserve_free_pages() == 0u;
+    const bool pass = objects_ok && guard_ok && bounded && destroyed && smoke_slab_job_failures == 0u &&
+                      after.used == 0u && after.hits > after.misses && kmalloc_ok &&
+                      kernel_slab_get_reserve_free_pages() == reserve_before;
+
+    kernel_telemetry_begin_record(serial_port, "slab_cache_smoke");
+    kernel_telemetry_write_unsigned("stride", grown.stride);
+    kernel_telemetry_write_unsigned("objects", allocated);
+    kernel_telemetry_write_unsigned("pages", grown.pages);
+    kernel_telemetry_write_unsigned("alloc_failures", grown.alloc_failures);
+    kernel_telemetry_write_unsigned("hits", after.hits);
+    kernel_telemetry_write_unsigned("misses", after.misses);
+    kernel_telemetry_write_unsigned("rejected_frees", after.rejected_frees);
+    kernel_telemetry_write_unsigned("job_failures", smoke_slab_job_failures);
+    kernel_telemetry_write_unsigned("wcet_alloc_cycles", after.wcet_alloc_cycles);
+    kernel_telemetry_write_unsigned("wcet_free_cycles", after.wcet_free_cycles);
+    kernel_telemetry_write_boolean("kmalloc_class", kmalloc_ok);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+/*
+ * TLSF instances: the engine's boot, replayed.
+ *
+ * The trace has the shape of the engine coming up: component vectors regrowing
+ * by doubling, world partitions, short-lived procgen scratch, names and job
+ * records freed as soon as they are used. It runs against an instance of its own
+ * that starts with a pool too small for the live set, so the second pool is added
+ * the way the heap adds one, on the first miss. Each pass frees everything again;
+ * fragmentation is sampled at the live peak, the end of the trace.
+ */
+#define SMOKE_TLSF_TRACE_FIRST_POOL_BYTES (16u * 1024u)
+#define SMOKE_TLSF_TRACE_POOL_PAGES       32u
+#define SMOKE_TLSF_TRACE_SLOTS            24u
+#define SMOKE_TLSF_TRACE_PASSES           8u
+
+#define SMOKE_TLSF_ALLOC(slot, bytes) {1u, (slot), (bytes)}
+#define SMOKE_TLSF_FREE(slot)         {0u, (slot), 0u}
+
+typedef struct SmokeTlsfTraceEvent {
+    uint8_t allocate;
+    uint8_t slot;
+    uint16_t size;
+} SmokeTlsfTraceEvent_t;
+
+static const SmokeTlsfTraceEvent_t smoke_tlsf_engine_boot_trace[] = {
+    SMOKE_TLSF_ALLOC(0u, 4096u),  SMOKE_TLSF_ALLOC(1u, 2048u),  SMOKE_TLSF_ALLOC(2u, 2048u),
+    SMOKE_TLSF_ALLOC(3u, 64u),    SMOKE_TLSF_ALLOC(4u, 32u),    SMOKE_TLSF_ALLOC(5u, 40u),
+    SMOKE_TLSF_FREE(3u),          SMOKE_TLSF_ALLOC(3u, 128u),   SMOKE_TLSF_ALLOC(6u, 8192u),
+    SMOKE_TLSF_ALLOC(7u, 48u),    SMOKE_TLSF_FREE(3u),          SMOKE_TLSF_ALLOC(3u, 256u),
+    SMOKE_TLSF_ALLOC(8u, 1024u),  SMOKE_TLSF_ALLOC(9u, 24u),    SMOKE_TLSF_FREE(3u),
+    SMOKE_TLSF_ALLOC(3u, 512u),   SMOKE_TLSF_ALLOC(10u, 2048u), SMOKE_TLSF_ALLOC(11u, 96u),
+    SMOKE_TLSF_FREE(11u),         SMOKE_TLSF_ALLOC(11u, 96u),   SMOKE_TLSF_FREE(3u),
+    SMOKE_TLSF_ALLOC(3u, 1024u),  SMOKE_TLSF_ALLOC(12u, 512u),  SMOKE_TLSF_FREE(6u),
+    SMOKE_TLSF_ALLOC(13u, 3072u), SMOKE_TLSF_FREE(12u),         SMOKE_TLSF_ALLOC(12u, 1024u),
+    SMOKE_TLSF_ALLOC(14u, 56u),   SMOKE_TLSF_ALLOC(15u, 2048u), SMOKE_TLSF_FREE(3u),
+    SMOKE_TLSF_ALLOC(3u, 2048u),  SMOKE_TLSF_ALLOC(16u, 160u),  SMOKE_TLSF_FREE(16u),
+    SMOKE_TLSF_ALLOC(17u, 4096u), SMOKE_TLSF_ALLOC(16u, 200u),  SMOKE_TLSF_FREE(12u),
+    SMOKE_TLSF_ALLOC(12u, 2048u), SMOKE_TLSF_ALLOC(18u, 40u),   SMOKE_TLSF_ALLOC(19u, 6144u),
+    SMOKE_TLSF_FREE(9u),          SMOKE_TLSF_FREE(5u),          SMOKE_TLSF_ALLOC(20u, 384u),
+    SMOKE_TLSF_FREE(19u),         SMOKE_TLSF_ALLOC(21u, 1536u), SMOKE_TLSF_FREE(3u),
+    SMOKE_TLSF_ALLOC(3u, 4096u),  SMOKE_TLSF_ALLOC(22u, 72u),   SMOKE_TLSF_FREE(12u),
+    SMOKE_TLSF_ALLOC(12u, 4096u), SMOKE_TLSF_ALLOC(23u, 128u),
+};
+
+#define SMOKE_TLSF_TRACE_EVENTS (sizeof(smoke_tlsf_engine_boot_trace) / sizeof(smoke_tlsf_engine_boot_trace[0]))
+
+static KernelTlsf_t smoke_tlsf_trace_instance;
+static void *smoke_tlsf_trace_slots[SMOKE_TLSF_TRACE_SLOTS];
+
+void smoke_test_run_tlsf_trace_replay(Serial_t *serial_port)
+{
+    const uint32_t pool_bytes = SMOKE_TLSF_TRACE_POOL_PAGES * (uint32_t) PAGE_SIZE;
+    uint8_t *pool = (uint8_t *) kernel_vmm_alloc_pages(SMOKE_TLSF_TRACE_POOL_PAGES);
+    KernelTlsf_t *tlsf = &smoke_tlsf_trace_instance;
+    KernelTlsfStatistics_t peak = {0};
+    KernelTlsfStatistics_t drained = {0};
+    uint32_t worst_fragmentation = 0u;
+    uint32_t failures = 0u;
+    uint32_t first_pool_free = 0u;
+    bool ready = false;
+
+    if (pool)
+        ready = kernel_tlsf_init(tlsf, "smoke_tlsf", pool, SMOKE_TLSF_TRACE_FIRST_POOL_BYTES);
+    if (ready)
+        first_pool_free = tlsf->free_bytes;
+
+    for (uint32_t pass = 0u; ready && pass < SMOKE_TLSF_TRACE_PASSES; ++pass)
+    {
+        for (uint32_t index = 0u; index < SMOKE_TLSF_TRACE_EVENTS; ++index)
+        {
+            const SmokeTlsfTraceEvent_t *event = &smoke_tlsf_engine_boot_trace[index];
+
+            if (!event->allocate)
+            {
+                kernel_tlsf_release(tlsf, smoke_tlsf_trace_slots[event->slot]);
+                smoke_tlsf_trace_slots[event->slot] = NULL;
+                continue;
+            }
+
+            void *block = kernel_tlsf_allocate(tlsf, event->size);
+            if (!block && tlsf->pool_count == 1u &&
+                kernel_tlsf_add_pool(tlsf, pool + SMOKE_TLSF_TRACE_FIRST_POOL_BYTES,
+                                     pool_bytes - SMOKE_TLSF_TRACE_FIRST_POOL_BYTES))
+                block = kernel_tlsf_allocate(tlsf, event->size);
+            if (!block)
+                ++failures;
+            smoke_tlsf_trace_slots[event->slot] = block;
+        }
+
+        KernelTlsfStatistics_t sample;
+        kernel_tlsf_get_statistics(tlsf, &sample);
+        if (pass == 0u || sample.fragmentation_permille > worst_fragmentation)
+        {
+            worst_fragmentation = sample.fragmentation_permille;
+            peak = sample;
+        }
+
+        for (uint32_t slot = 0u; slot < SMOKE_TLSF_TRACE_SLOTS; ++slot)
+        {
+            kernel_tlsf_release(tlsf, smoke_tlsf_trace_slots[slot]);
+            smoke_tlsf_trace_slots[slot] = NULL;
+        }
+    }
+
+    if (ready)
+    {
+        kernel_tlsf_get_statistics(tlsf, &drained);
+        kernel_tlsf_destroy(tlsf);
+    }
+    if (pool)
+        kernel_vmm_free_pages(pool, SMOKE_TLSF_TRACE_POOL_PAGES);
+
+    /* The engine's own objects come from its instance, and go back to it. */
+    uint8_t *engine_object = (uint8_t *) kmalloc_engine(96u);
+#ifdef LPL_KERNEL_REAL_TIME_MODE
+    const bool engine_ok =
+        engine_object && kernel_tlsf_contains(kernel_heap_get_engine_tlsf(), engine_object - sizeof(KernelHeapBlock_t));
+#else
+    const bool engine_ok = engine_object != NULL;
+#endif
+    kfree(engine_object);
+
+    /* Drained, every pool is one free block again: nothing was lost to splinters. */
+    const bool extended = drained.pools == 2u;
+    const bool coalesced = drained.free_blocks == drained.pools &&
+                           drained.free_bytes == first_pool_free + (pool_bytes - SMOKE_TLSF_TRACE_FIRST_POOL_BYTES) -
+                                                     2u * (uint32_t) KERNEL_TLSF_BLOCK_OVERHEAD;
+    const bool bounded = drained.wcet_alloc_cycles < 5000000u && drained.wcet_free_cycles < 5000000u;
+    const bool pass = ready && failures == 0u && extended && coalesced && bounded && engine_ok;
+
+    kernel_telemetry_begin_record(serial_port, "tlsf_trace_replay_smoke");
+    kernel_telemetry_write_unsigned("events", (uint32_t) SMOKE_TLSF_TRACE_EVENTS);
+    kernel_telemetry_write_unsigned("passes", SMOKE_TLSF_TRACE_PASSES);
+    kernel_telemetry_write_unsigned("pools", drained.pools);
+    kernel_telemetry_write_unsigned("peak_used", drained.pool_size - drained.min_free_bytes);
+    kernel_telemetry_write_unsigned("fragmentation_permille", worst_fragmentation);
+    kernel_telemetry_write_unsigned("largest_free_block", peak.largest_free_block);
+    kernel_telemetry_write_unsigned("free_blocks_at_peak", peak.free_blocks);
+    kernel_telemetry_write_unsigned("failures", failures);
+    kernel_telemetry_write_unsigned("wcet_alloc_cycles", drained.wcet_alloc_cycles);
+    kernel_telemetry_write_unsigned("wcet_free_cycles", drained.wcet_free_cycles);
+    kernel_telemetry_write_boolean("coalesced", coalesced);
+    kernel_telemetry_write_boolean("engine_instance", engine_ok);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+/* Coarse deadlines, in milliseconds, armed out of order: the last two are past
+   one turn of the first level, so they reach level 0 by cascading. */
+static const uint32_t smoke_timer_wheel_delays_ms[] = {20u, 3u, 70u, 7u, 12u, 90u};
+
+#define SMOKE_TIMER_WHEEL_COUNT       (sizeof(smoke_timer_wheel_delays_ms) / sizeof(smoke_timer_wheel_delays_ms[0]))
+#define SMOKE_TIMER_PERIOD_US         500u
+#define SMOKE_TIMER_PERIODIC_FIRES    20u
+#define SMOKE_TIMER_TIMEOUT_US        250000u
+
+typedef struct SmokeTimerProbe {
+    volatile uint32_t order; /* 1-based position among the wheel expiries; 0 until fired */
+    volatile bool early;
+} SmokeTimerProbe_t;
+
+static KernelTimer_t smoke_timer_wheel[SMOKE_TIMER_WHEEL_COUNT];
+static SmokeTimerProbe_t smoke_timer_probes[SMOKE_TIMER_WHEEL_COUNT];
+static KernelTimer_t smoke_timer_periodic;
+static KernelTimer_t smoke_timer_cancelled;
+static volatile uint32_t smoke_timer_wheel_fired = 0u;
+static volatile uint32_t smoke_timer_periodic_fired = 0u;
+static volatile uint32_t smoke_timer_cancelled_fired = 0u;
+
+static void smoke_timer_wheel_callback(KernelTimer_t *timer, void *context)
+{
+    SmokeTimerProbe_t *probe = (SmokeTimerProbe_t *) context;
+
+    probe->early = kernel_timer_now() < timer->expires;
+    probe->order = ++smoke_timer_wheel_fired;
+}
+
+static void smoke_timer_periodic_callback(KernelTimer_t *timer, void *context)
+{
+    (void) context;
+    if (++smoke_timer_periodic_fired == SMOKE_TIMER_PERIODIC_FIRES)
+        (void) kernel_timer_cancel(timer);
+}
+
+static void smoke_timer_cancelled_callback(KernelTimer_t *timer, void *context)
+{
+    (void) timer;
+    (void) context;
+    ++smoke_timer_cancelled_fired;
+}
+
+void smoke_test_run_timer_wheel(Serial_t *serial_port)
+{
+    KernelTimerStatistics_t before;
+    KernelTimerStatistics_t after;
+
+    kernel_timer_get_statistics(&before);
+    if (!before.active)
+    {
+        kernel_telemetry_begin_record(serial_port, "timer_wheel_smoke");
+        kernel_telemetry_write_boolean("active", false);
+        kernel_telemetry_write_text("result", "(skip)");
+        kernel_telemetry_end_record();
+        return;
+    }
+
+    const uint64_t start = kernel_timer_now();
+    for (uint32_t index = 0u; index < SMOKE_TIMER_WHEEL_COUNT; ++index)
+    {
+        kernel_timer_setup(&smoke_timer_wheel[index], "smoke_wheel", smoke_timer_wheel_callback,
+                           &smoke_timer_probes[index], 0u);
+        (void) kernel_timer_arm(&smoke_timer_wheel[index],
+                                start + kernel_timer_microseconds_to_cycles(smoke_timer_wheel_delays_ms[index] * 1000u),
+                                0u);
+    }
+
+    kernel_timer_setup(&smoke_timer_periodic, "smoke_periodic", smoke_timer_periodic_callback, NULL,
+                       KERNEL_TIMER_FLAG_PRECISE);
+    (void) kernel_timer_arm_microseconds(&smoke_timer_periodic, SMOKE_TIMER_PERIOD_US, SMOKE_TIMER_PERIOD_US);
+
+    kernel_timer_setup(&smoke_timer_cancelled, "smoke_cancelled", smoke_timer_cancelled_callback, NULL,
+                       KERNEL_TIMER_FLAG_PRECISE);
+    (void) kernel_timer_arm_microseconds(&smoke_timer_cancelled, 5000u, 0u);
+    const bool cancelled = kernel_timer_cancel(&smoke_timer_cancelled);
+
+    const uint64_t timeout = start + kernel_timer_microseconds_to_cycles(SMOKE_TIMER_TIMEOUT_US);
+    while ((smoke_timer_wheel_fired < SMOKE_TIMER_WHEEL_COUNT ||
+            smoke_timer_periodic_fired < SMOKE_TIMER_PERIODIC_FIRES) &&
+           kernel_timer_now() < timeout)
+        asmutils_no_operation();
+    const uint32_t elapsed_us = kernel_timer_cycles_to_microseconds(kernel_timer_now() - start);
+
+    /* Nothing stays queued past the test, fired or not. */
+    for (uint32_t index = 0u; index < SMOKE_TIMER_WHEEL_COUNT; ++index)
+        (void) kernel_timer_cancel(&smoke_timer_wheel[index]);
+    (void) kernel_timer_cancel(&smoke_timer_periodic);
+
+    kernel_timer_get_statistics(&after);
+
+    /* Expiry order must follow the deadlines, not the arming order. */
+    bool ordered = true;
+    bool early = false;
+    for (uint32_t index = 0u; index < SMOKE_TIMER_WHEEL_COUNT; ++index)
+    {
+        early = early || smoke_timer_probes[index].early;
+        for (uint32_t other = 0u; other < SMOKE_TIMER_WHEEL_COUNT; ++other)
+        {
+            if (smoke_timer_wheel_delays_ms[other] < smoke_timer_wheel_delays_ms[index] &&
+                smoke_timer_probes[other].order > smoke_timer_probes[index].order)
+                ordered = false;
+        }
+    }
+
+    const bool all_fired = smoke_timer_wheel_fired == SMOKE_TIMER_WHEEL_COUNT;
+    const bool periodic_ok = smoke_timer_periodic_fired == SMOKE_TIMER_PERIODIC_FIRES;
+    const bool cascaded = after.cascaded > before.cascaded;
+    const bool pass = all_fired && ordered && !early && periodic_ok && cancelled && smoke_timer_cancelled_fired == 0u &&
+                      cascaded;
+
+    kernel_telemetry_begin_record(serial_port, "timer_wheel_smoke");
+    kernel_telemetry_write_boolean("active", true);
+    kernel_telemetry_write_boolean("tsc_deadline", after.tsc_deadline);
+    kernel_telemetry_write_unsigned("wheel_fired", smoke_timer_wheel_fired);
+    kernel_telemetry_write_unsigned("periodic_fired", smoke_timer_periodic_fired);
+    kernel_telemetry_write_unsigned("cascaded", after.cascaded - before.cascaded);
+    kernel_telemetry_write_unsigned("interrupts", after.interrupts - before.interrupts);
+    kernel_telemetry_write_unsigned("elapsed_us", elapsed_us);
+    kernel_telemetry_write_unsigned("max_jitter_heap_us", after.max_jitter_heap_us);
+    kernel_telemetry_write_unsigned("max_jitter_wheel_us", after.max_jitter_wheel_us);
+    kernel_telemetry_write_boolean("ordered", ordered);
+    kernel_telemetry_write_boolean("early", early);
+    kernel_telemetry_write_boolean("cancel_held", cancelled && smoke_timer_cancelled_fired == 0u);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+#define SMOKE_THREAD_PING_PONG_ROUNDS   500u
+#define SMOKE_THREAD_PING_PONG_PRIORITY 20u
+#define SMOKE_THREAD_LOAD_PRIORITY      24u
+#define SMOKE_THREAD_LOAD_THREADS       3u
+#define SMOKE_THREAD_TICK_JOBS          30u
+#define SMOKE_THREAD_AUDIO_JOBS         60u
+#define SMOKE_THREAD_LATENCY_LIMIT_US   50u
+
+/* Shaped after the engine's: the authoritative tick at 100 Hz and an audio pump
+   at 200 Hz, each with twice its work as budget. */
+typedef struct SmokeThreadDeadline {
+    uint32_t period_us;
+    uint32_t runtime_us;
+    uint32_t work_us;
+    uint32_t jobs;
+    volatile uint32_t completed;
+    volatile uint32_t missed;
+} SmokeThreadDeadline_t;
+
+static SmokeThreadDeadline_t smoke_thread_tick = {10000u, 2000u, 1000u, SMOKE_THREAD_TICK_JOBS, 0u, 0u};
+static SmokeThreadDeadline_t smoke_thread_audio = {5000u, 1000u, 500u, SMOKE_THREAD_AUDIO_JOBS, 0u, 0u};
+static volatile uint64_t smoke_thread_yield_at = 0u;
+static volatile uint32_t smoke_thread_last_runner = 0u;
+static volatile uint64_t smoke_thread_switch_cycles = 0u;
+static volatile uint32_t smoke_thread_switch_samples = 0u;
+static volatile bool smoke_thread_stop = false;
+static volatile uint32_t smoke_thread_load_spins[SMOKE_THREAD_LOAD_THREADS];
+
+static inline uint32_t smoke_thread_save_and_disable_interrupts(void)
+{
+    uint32_t flags;
+
+    __asm__ volatile("pushfl\n\tpopl %0\n\tcli" : "=r"(flags)::"memory");
+    return flags;
+}
+
+static inline void smoke_thread_restore_interrupts(uint32_t flags)
+{
+    __asm__ volatile("pushl %0\n\tpopfl" ::"r"(flags) : "memory", "cc");
+}
+
+static void smoke_thread_ping_pong(void *argument)
+{
+    const uint32_t self = (uint32_t) (uintptr_t) argument;
+
+    for (uint32_t round = 0u; round < SMOKE_THREAD_PING_PONG_ROUNDS; ++round)
+    {
+        smoke_thread_last_runner = self;
+        smoke_thread_yield_at = kernel_timer_now();
+        kernel_thread_yield();
+
+        /* Only a turn the peer actually took is a switch: a yield with nobody
+           else ready comes straight back, and timing that would time nothing. */
+        const uint64_t yielded_at = smoke_thread_yield_at;
+        if (smoke_thread_last_runner != self && yielded_at)
+        {
+            smoke_thread_switch_cycles += kernel_timer_now() - yielded_at;
+            ++smoke_thread_switch_samples;
+        }
+    }
+    smoke_thread_yield_at = 0u;
+}
+
+static void smoke_thread_spin_microseconds(uint32_t microseconds)
+{
+    const uint64_t until = kernel_timer_now() + kernel_timer_microseconds_to_cycles(microseconds);
+
+    while (kernel_timer_now() < until)
+        asmutils_no_operation();
+}
+
+static void smoke_thread_deadline_body(void *argument)
+{
+    SmokeThreadDeadline_t *task = (SmokeThreadDeadline_t *) argument;
+
+    while (task->completed < task->jobs)
+    {
+        smoke_thread_spin_microseconds(task->work_us);
+        ++task->completed;
+        if (!kernel_thread_wait_next_period())
+            ++task->missed;
+    }
+    if (task == &smoke_thread_tick)
+        smoke_thread_stop = true;
+}
+
+static void smoke_thread_load_body(void *argument)
+{
+    volatile uint32_t *spins = (volatile uint32_t *) argument;
+
+    while (!smoke_thread_stop)
+    {
+        smoke_thread_spin_microseconds(50u);
+        ++*spins;
+    }
+}
+
+void smoke_test_run_thread_scheduler(Serial_t *serial_port)
+{
+    if (!kernel_thread_is_active())
+    {
+        kernel_telemetry_begin_record(serial_port, "thread_scheduler_smoke");
+        kernel_telemetry_write_boolean("active", false);
+        kernel_telemetry_write_text("result", "(skip)");
+        kernel_telemetry_end_record();
+        return;
+    }
+
+    const uint32_t cpu = cpu_topology_get_logical_slot();
+    KernelThreadStatistics_t before;
+    KernelThreadStatistics_t after;
+
+    kernel_thread_get_statistics(&before);
+
+    /* Switch latency: two equal threads handing the CPU to each other. Both
+       outrank this one, which runs again once both are done. Each creation kicks
+       the scheduler, so with interrupts on the first would run all its rounds
+       before the second existed: both are made ready first, then let go. */
+    uint32_t flags = smoke_thread_save_and_disable_interrupts();
+    KernelThread_t *ping = kernel_thread_create("smoke_ping", smoke_thread_ping_pong, (void *) 1u,
+                                                SMOKE_THREAD_PING_PONG_PRIORITY, cpu);
+    KernelThread_t *pong = kernel_thread_create("smoke_pong", smoke_thread_ping_pong, (void *) 2u,
+                                                SMOKE_THREAD_PING_PONG_PRIORITY, cpu);
+    smoke_thread_restore_interrupts(flags);
+    bool ping_pong_joined = kernel_thread_join(ping);
+    ping_pong_joined = kernel_thread_join(pong) && ping_pong_joined;
+    const uint32_t switch_us = smoke_thread_switch_samples
+                                   ? kernel_timer_cycles_to_microseconds(smoke_thread_switch_cycles /
+                                                                         smoke_thread_switch_samples)
+                                   : 0u;
+
+    /* Deadlines under load: fixed-priority threads above everything but the
+       deadline class keep the CPU saturated while the tick and audio run. The
+       same hold as above: the first load thread would otherwise starve this one
+       until the tick had finished, and the others would never spin. */
+    flags = smoke_thread_save_and_disable_interrupts();
+    KernelThread_t *load[SMOKE_THREAD_LOAD_THREADS];
+    KernelThread_t *tick = kernel_thread_create_deadline("smoke_tick", smoke_thread_deadline_body, &smoke_thread_tick,
+                                                         smoke_thread_tick.period_us, smoke_thread_tick.runtime_us, 0u,
+                                                         cpu);
+    KernelThread_t *audio = kernel_thread_create_deadline("smoke_audio", smoke_thread_deadline_body,
+                                                          &smoke_thread_audio, smoke_thread_audio.period_us,
+                                                          smoke_thread_audio.runtime_us, 0u, cpu);
+    if (!tick)
+        smoke_thread_stop = true;
+    for (uint32_t index = 0u; index < SMOKE_THREAD_LOAD_THREADS; ++index)
+        load[index] = kernel_thread_create("smoke_load", smoke_thread_load_body,
+                                           (void *) &smoke_thread_load_spins[index], SMOKE_THREAD_LOAD_PRIORITY, cpu);
+    smoke_thread_restore_interrupts(flags);
+
+    bool joined = kernel_thread_join(tick);
+    joined = kernel_thread_join(audio) && joined;
+    for (uint32_t index = 0u; index < SMOKE_THREAD_LOAD_THREADS; ++index)
+        joined = kernel_thread_join(load[index]) && joined;
+
+    bool loaded = true;
+    for (uint32_t index = 0u; index < SMOKE_THREAD_LOAD_THREADS; ++index)
+        loaded = loaded && smoke_thread_load_spins[index] > 0u;
+
+    kernel_thread_get_statistics(&after);
+
+    const uint32_t misses = smoke_thread_tick.missed + smoke_thread_audio.missed;
+    const bool deadlines_ok = smoke_thread_tick.completed == SMOKE_THREAD_TICK_JOBS &&
+                              smoke_thread_audio.completed == SMOKE_THREAD_AUDIO_JOBS && misses == 0u &&
+                              after.deadline_misses == before.deadline_misses;
+    const bool latency_ok = smoke_thread_switch_samples > 0u && switch_us < SMOKE_THREAD_LATENCY_LIMIT_US;
+    const bool pass = ping_pong_joined && joined && latency_ok && deadlines_ok && loaded &&
+                      after.stack_overflows == before.stack_overflows;
+
+    kernel_telemetry_begin_record(serial_port, "thread_scheduler_smoke");
+    kernel_telemetry_write_boolean("active", true);
+    kernel_telemetry_write_unsigned("cpu", cpu);
+    kernel_telemetry_write_unsigned("switch_samples", smoke_thread_switch_samples);
+    kernel_telemetry_write_unsigned("switch_us", switch_us);
+    kernel_telemetry_write_unsigned("switch_max_cycles", after.switch_max_cycles);
+    kernel_telemetry_write_unsigned("tick_jobs", smoke_thread_tick.completed);
+    kernel_telemetry_write_unsigned("audio_jobs", smoke_thread_audio.completed);
+    kernel_telemetry_write_unsigned("deadline_misses", misses);
+    kernel_telemetry_write_unsigned("budget_overruns", after.budget_overruns - before.budget_overruns);
+    kernel_telemetry_write_unsigned("preemptions", after.preemptions - before.preemptions);
+    kernel_telemetry_write_unsigned("max_wake_latency_us", after.max_wake_latency_us);
+    kernel_telemetry_write_boolean("load_progressed", loaded);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+/* What the handlers would see for: A down, A up, extended up-arrow down and up,
+   the pause key, and a controller ack. Pause and the ack produce no event. */
+static const uint8_t smoke_input_event_bytes[] = {0x1Eu, 0x9Eu, 0xE0u, 0x48u, 0xE0u, 0xC8u, 0xE1u,
+                                                  0x1Du, 0x45u, 0xE1u, 0x9Du, 0xC5u, 0xFAu};
+
+#define SMOKE_INPUT_EVENT_BYTES    (sizeof(smoke_input_event_bytes) / sizeof(smoke_input_event_bytes[0]))
+#define SMOKE_INPUT_EVENT_EXPECTED 5u /* four keys and one pointer report */
+#define SMOKE_INPUT_EVENT_OVERFLOW 4u
+
+static KernelInputEvent_t smoke_input_events[KERNEL_INPUT_EVENT_RING_CAPACITY];
+
+static inline uint32_t smoke_input_event_save_and_disable_interrupts(void)
+{
+    uint32_t flags;
+
+    __asm__ volatile("pushfl\n\tpopl %0\n\tcli" : "=r"(flags)::"memory");
+    return flags;
+}
+
+static inline void smoke_input_event_restore_interrupts(uint32_t flags)
+{
+    __asm__ volatile("pushl %0\n\tpopfl" ::"r"(flags) : "memory", "cc");
+}
+
+static uint32_t smoke_input_event_drain_all(void)
+{
+    uint32_t total = 0u;
+    uint32_t got;
+
+    while ((got = kernel_input_event_drain(smoke_input_events, KERNEL_INPUT_EVENT_RING_CAPACITY)) != 0u)
+        total += got;
+    return total;
+}
+
+void smoke_test_run_input_event_ring(Serial_t *serial_port)
+{
+    KernelInputEventStatistics_t before;
+    KernelInputEventStatistics_t after;
+
+    kernel_input_event_get_statistics(&before);
+    if (!before.ready)
+    {
+        kernel_telemetry_begin_record(serial_port, "input_event_smoke");
+        kernel_telemetry_write_boolean("ready", false);
+        kernel_telemetry_write_text("result", "(skip)");
+        kernel_telemetry_end_record();
+        return;
+    }
+
+    /* The bytes go through the same entry points the handlers use, with this
+       CPU's handlers held off so no real keystroke interleaves. */
+    const uint32_t flags = smoke_input_event_save_and_disable_interrupts();
+    kernel_input_event_set_capture(true);
+    (void) smoke_input_event_drain_all();
+
+    const uint64_t stamp = asmutils_read_timestamp_counter();
+    for (uint32_t index = 0u; index < SMOKE_INPUT_EVENT_BYTES; ++index)
+        kernel_input_event_publish_scancode(smoke_input_event_bytes[index], stamp + index);
+    kernel_input_event_publish_pointer(3, -2, 0x01u, stamp + SMOKE_INPUT_EVENT_BYTES);
+
+    const uint32_t count = kernel_input_event_drain(smoke_input_events, KERNEL_INPUT_EVENT_RING_CAPACITY);
+    const KernelInputEvent_t *events = smoke_input_events;
+    bool decoded = count == SMOKE_INPUT_EVENT_EXPECTED;
+    if (decoded)
+    {
+        decoded = events[0].type == KERNEL_INPUT_EVENT_KEY_DOWN && events[0].code == 0x1Eu && events[0].flags == 0u &&
+                  events[1].type == KERNEL_INPUT_EVENT_KEY_UP && events[1].code == 0x1Eu &&
+                  events[2].type == KERNEL_INPUT_EVENT_KEY_DOWN && events[2].code == 0x48u &&
+                  events[2].flags == KERNEL_INPUT_EVENT_FLAG_EXTENDED && events[3].type == KERNEL_INPUT_EVENT_KEY_UP &&
+                  events[3].code == 0x48u && events[3].flags == KERNEL_INPUT_EVENT_FLAG_EXTENDED &&
+                  events[4].type == KERNEL_INPUT_EVENT_POINTER && events[4].delta_x == 3 && events[4].delta_y == -2 &&
+                  events[4].buttons == 0x01u;
+    }
+
+    bool ordered = count != 0u;
+    for (uint32_t index = 1u; index < count; ++index)
+        ordered = ordered && events[index].sequence == events[index - 1u].sequence + 1u &&
+                  events[index].timestamp > events[index - 1u].timestamp;
+
+    /* Past capacity the ring refuses the newcomers; their sequence numbers stay
+       spent, so the consumer can see the gap. */
+    for (uint32_t index = 0u; index < KERNEL_INPUT_EVENT_RING_CAPACITY + SMOKE_INPUT_EVENT_OVERFLOW; ++index)
+        kernel_input_event_publish_pointer(1, 0, 0u, stamp + SMOKE_INPUT_EVENT_BYTES + 1u + index);
+    const uint32_t overflow_drained = smoke_input_event_drain_all();
+
+    /* The drains above left a newest event: the next present is tagged with it. */
+    const uint32_t newest = smoke_input_events[KERNEL_INPUT_EVENT_RING_CAPACITY - 1u].sequence;
+    kernel_input_event_note_present();
+
+    kernel_input_event_set_capture(before.capturing);
+    smoke_input_event_restore_interrupts(flags);
+
+    kernel_input_event_get_statistics(&after);
+
+    const uint32_t dropped = after.dropped - before.dropped;
+    const bool bounded = overflow_drained == KERNEL_INPUT_EVENT_RING_CAPACITY && dropped == SMOKE_INPUT_EVENT_OVERFLOW;
+    const bool tagged = after.tagged_presents == before.tagged_presents + 1u && after.last_sequence == newest;
+    const bool pass = decoded && ordered && bounded && tagged;
+
+    kernel_telemetry_begin_record(serial_port, "input_event_smoke");
+    kernel_telemetry_write_boolean("ready", true);
+    kernel_telemetry_write_unsigned("events", count);
+    kernel_telemetry_write_unsigned("overflow_drained", overflow_drained);
+    kernel_telemetry_write_unsigned("dropped", dropped);
+    kernel_telemetry_write_unsigned("latency_last_us", after.latency_last_us);
+    kernel_telemetry_write_boolean("decoded", decoded);
+    kernel_telemetry_write_boolean("ordered", ordered);
+    kernel_telemetry_write_boolean("tagged", tagged);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
+
+/* ── Device vectors (MSI / MSI-X) ── */
+
+#define SMOKE_MSI_VECTOR_MAX_BLOCKS (INTERRUPT_VECTOR_DEVICE_COUNT / INTERRUPT_VECTOR_MAX_BLOCK)
+#define SMOKE_MSI_VECTOR_SPIN_LIMIT 1000000u
+
+static volatile uint32_t smoke_msi_vector_handled = 0u;
+static volatile uint64_t smoke_msi_vector_sent_at = 0u;
+
+static void smoke_msi_vector_handler(uint8_t vector, void *context)
+{
+    (void) context;
+
+    const uint64_t elapsed = asmutils_read_timestamp_counter() - smoke_msi_vector_sent_at;
+    interrupt_vector_record_latency(vector, kernel_timer_cycles_to_microseconds(elapsed));
+    ++smoke_msi_vector_handled;
+}
+
+static bool smoke_msi_vector_interrupts_enabled(void)
+{
+    uint32_t flags;
+
+    __asm__ volatile("pushfl\n\tpopl %0" : "=r"(flags)::"memory");
+    return (flags & 0x200u) != 0u;
+}
+
+void smoke_test_run_msi_vectors(Serial_t *serial_port)
+{
+    const uint32_t held_before = interrupt_vector_get_allocated_count();
+
+    /* Blocks are aligned to their size, and a size that is not a power of two is refused. */
+    const uint8_t block4 = interrupt_vector_allocate(4u, "smoke", smoke_msi_vector_handler, NULL);
+    const uint8_t single = interrupt_vector_allocate(1u, "smoke", smoke_msi_vector_handler, NULL);
+    const bool odd_refused = interrupt_vector_allocate(3u, "smoke", smoke_msi_vector_handler, NULL) ==
+                             INTERRUPT_VECTOR_NONE;
+    const bool aligned = block4 != INTERRUPT_VECTOR_NONE && (block4 % 4u) == 0u && single != INTERRUPT_VECTOR_NONE &&
+                         (single < block4 || single >= block4 + 4u) && interrupt_vector_is_allocated(block4 + 3u);
+
+    /* Whatever full blocks are left, taken until the allocator says no. */
+    uint8_t blocks[SMOKE_MSI_VECTOR_MAX_BLOCKS];
+    uint32_t block_count = 0u;
+    uint8_t vector;
+    while (block_count < SMOKE_MSI_VECTOR_MAX_BLOCKS &&
+           (vector = interrupt_vector_allocate(INTERRUPT_VECTOR_MAX_BLOCK, "smoke", smoke_msi_vector_handler, NULL)) !=
+               INTERRUPT_VECTOR_NONE)
+        blocks[block_count++] = vector;
+    bool exhausted =
+        interrupt_vector_allocate(INTERRUPT_VECTOR_MAX_BLOCK, "smoke", smoke_msi_vector_handler, NULL) ==
+        INTERRUPT_VECTOR_NONE;
+    for (uint32_t index = 0u; index < block_count; ++index)
+        exhausted = exhausted && (blocks[index] % INTERRUPT_VECTOR_MAX_BLOCK) == 0u;
+
+    for (uint32_t index = 0u; index < block_count; ++index)
+        interrupt_vector_free(blocks[index], INTERRUPT_VECTOR_MAX_BLOCK);
+    interrupt_vector_free(block4, 4u);
+    const bool released = interrupt_vector_get_allocated_count() == held_before + (single != INTERRUPT_VECTOR_NONE);
+
+    /* A self-IPI on the remaining vector reaches the local APIC exactly as a
+       device's message would, so it goes through the same dispatcher. */
+    bool delivered = false;
+    bool skipped = true;
+    InterruptVectorStatistics_t statistics = {0};
+    if (single != INTERRUPT_VECTOR_NONE && advanced_pic_ipi_is_ready() && smoke_msi_vector_interrupts_enabled())
+    {
+        const uint32_t cpu = cpu_topology_get_logical_slot();
+
+        skipped = false;
+        smoke_msi_vector_handled = 0u;
+        smoke_msi_vector_sent_at = asmutils_read_timestamp_counter();
+        (void) advanced_pic_ipi_send_fixed(0u, single, ADVANCED_PIC_IPI_SHORT_SELF);
+        for (uint32_t spin = 0u; spin < SMOKE_MSI_VECTOR_SPIN_LIMIT && smoke_msi_vector_handled == 0u; ++spin)
+            __asm__ volatile("pause" ::: "memory");
+
+        delivered = interrupt_vector_get_statistics(single, &statistics) && smoke_msi_vector_handled == 1u &&
+                    statistics.deliveries == 1u && statistics.unclaimed == 0u && statistics.latency_samples == 1u &&
+                    (cpu >= CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC || statistics.deliveries_per_cpu[cpu] == 1u);
+    }
+    if (single != INTERRUPT_VECTOR_NONE)
+        interrupt_vector_free(single, 1u);
+
+    const bool pass = odd_refused && aligned && exhausted && released && (skipped || delivered);
+
+    kernel_telemetry_begin_record(serial_port, "msi_vector_smoke");
+    kernel_telemetry_write_unsigned("held_before", held_before);
+    kernel_telemetry_write_unsigned("block4", block4);
+    kernel_telemetry_write_unsigned("single", single);
+    kernel_telemetry_write_unsigned("full_blocks", block_count);
+    kernel_telemetry_write_boolean("aligned", aligned);
+    kernel_telemetry_write_boolean("exhausted", exhausted);
+    kernel_telemetry_write_boolean("released", released);
+    kernel_telemetry_write_boolean("self_ipi", !skipped);
+    kernel_telemetry_write_boolean("delivered", delivered);
+    kernel_telemetry_write_unsigned("latency_us", statistics.latency_last_us);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : (skipped ? "(skip)" : "(fail)"));
+    kernel_telemetry_end_record();
+
+    message_signaled_interrupt_report(serial_port);
+}
+
+/* ── IRQ affinity balancing ── */
+
+void smoke_test_run_interrupt_affinity(Serial_t *serial_port)
+{
+    InterruptAffinityStatistics_t statistics;
+
+    (void) interrupt_affinity_balance();
+    interrupt_affinity_get_statistics(&statistics);
+
+    kernel_telemetry_begin_record(serial_port, "irq_affinity_smoke");
+    kernel_telemetry_write_unsigned("tick_cpu", statistics.tick_cpu);
+    kernel_telemetry_write_unsigned("spare_cpus", statistics.spare_cpus);
+    kernel_telemetry_write_unsigned("sources", statistics.sources);
+
+    /* One CPU, or no IOAPIC line or message yet: nothing can be steered. */
+    if (statistics.spare_cpus == 0u || statistics.sources == 0u)
+    {
+        kernel_telemetry_write_text("result", "(skip)");
+        kernel_telemetry_end_record();
+        return;
+    }
+
+    /* Off the tick CPU after one pass, unless something asked to be there. */
+    const bool steered = statistics.on_tick_cpu == 0u;
+
+    InterruptAffinitySource_t source = {0};
+    uint32_t index = 0u;
+    while (index < INTERRUPT_AFFINITY_MAX_SOURCES &&
+           (!interrupt_affinity_get_source(index, &source) || !source.present ||
+            source.policy != INTERRUPT_AFFINITY_POLICY_BALANCED))
+        ++index;
+
+    /* A pin wins over the load, and the source goes back off the tick CPU once unpinned. */
+    bool pinned = true;
+    bool released = true;
+    if (index < INTERRUPT_AFFINITY_MAX_SOURCES)
+    {
+        InterruptAffinitySource_t after;
+
+        pinned = interrupt_affinity_pin(source.vector, statistics.tick_cpu) &&
+                 interrupt_affinity_get_source(index, &after) && after.cpu == statistics.tick_cpu &&
+                 after.policy == INTERRUPT_AFFINITY_POLICY_PINNED;
+
+        interrupt_affinity_unpin(source.vector);
+        (void) interrupt_affinity_balance();
+        released = interrupt_affinity_get_source(index, &after) && after.cpu != statistics.tick_cpu &&
+                   after.policy == INTERRUPT_AFFINITY_POLICY_BALANCED;
+    }
+
+    const bool pass = steered && pinned && released;
+
+    kernel_telemetry_write_unsigned("vector", index < INTERRUPT_AFFINITY_MAX_SOURCES ? source.vector : 0u);
+    kernel_telemetry_write_boolean("steered", steered);
+    kernel_telemetry_write_boolean("pinned", pinned);
+    kernel_telemetry_write_boolean("released", released);
+    kernel_telemetry_write_text("result", pass ? "(pass)" : "(fail)");
+    kernel_telemetry_end_record();
+}
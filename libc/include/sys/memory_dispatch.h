@@ -0,0 +1,87 @@
+/**************************************************************************
+ * LplKernel v0.0.0
+ *
+ * LplKernel is a C kernel iso for Laplace-Project. It is a simple kernel that
+ * provides a basic set of features to run a C program.
+ *
+ * This file is part of the LplKernel project that is under Anti-NN License.
+ * https://github.com/MasterLaplace/Anti-NN_LICENSE
+ * Copyright © 2024 by @MasterLaplace, All rights reserved.
+ *
+ * LplKernel is a free software: you can redistribute it and/or modify
+ * it under the terms of the Anti-NN License as published by the
+ * Open Source Initiative. See the Anti-NN License for more details.
+ *
+ * @file memory_dispatch.h
+ * @brief CPU feature dispatch for memcpy/memset/memmove/memcmp.
+ *
+ * The mem* routines split every call by size class: below
+ * LIBK_MEMORY_SMALL_LIMIT a few overlapping word moves, up to
+ * LIBK_MEMORY_NON_TEMPORAL_THRESHOLD the string instructions, and above it
+ * 16-byte SSE2 non-temporal stores that do not drag a frame's worth of
+ * destination lines through the cache. Which of these paths may run is decided
+ * once, by libk_memory_dispatch_initialize(); until it is called only the
+ * integer paths are used, so early boot code is safe whatever the CPU.
+ *
+ * @author @MasterLaplace
+ * @version 0.0.0
+ * @date 2026-10-17
+ **************************************************************************/
+
+#ifndef _SYS_MEMORY_DISPATCH_H
+#define _SYS_MEMORY_DISPATCH_H
+
+#include <sys/cdefs.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** SSE2 is present and enabled: 16-byte vector and non-temporal paths. */
+#define LIBK_MEMORY_FEATURE_SSE2 (1u << 0)
+/** Enhanced REP MOVSB/STOSB: byte string ops are the fastest medium path. */
+#define LIBK_MEMORY_FEATURE_ERMS (1u << 1)
+
+/** Sizes below this never reach a string instruction. */
+#define LIBK_MEMORY_SMALL_LIMIT 16u
+
+/**
+ * Copies and fills at least this large use non-temporal stores when SSE2 is
+ * enabled. The big blocks in this kernel are framebuffer blits and cartridge
+ * images, neither of which is read back soon after the copy.
+ */
+#define LIBK_MEMORY_NON_TEMPORAL_THRESHOLD (64u * 1024u)
+
+/** memcmp switches to 16-byte compares from this size on. */
+#define LIBK_MEMORY_VECTOR_COMPARE_THRESHOLD 64u
+
+/**
+ * @brief Probe CPUID and enable every path the CPU supports.
+ *
+ * Must run after CR4.OSFXSR is set (boot.S does it on the BSP) and, for the
+ * vector paths to be interrupt-safe, after the interrupt FPU save path is up.
+ */
+void libk_memory_dispatch_initialize(void);
+
+/** Features CPUID reported at initialisation, LIBK_MEMORY_FEATURE_* bits. */
+uint32_t libk_memory_dispatch_get_supported(void);
+
+/** Features the mem* routines currently use. */
+uint32_t libk_memory_dispatch_get_features(void);
+
+/**
+ * @brief Restrict the paths in use, e.g. to benchmark one against another.
+ *
+ * @param features Requested LIBK_MEMORY_FEATURE_* bits; unsupported ones are dropped.
+ * @return The previous feature set, to hand back when done.
+ */
+uint32_t libk_memory_dispatch_set_features(uint32_t features);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !_SYS_MEMORY_DISPATCH_H */
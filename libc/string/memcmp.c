@@ -1,11 +1,32 @@
 #include <string.h>
 
+#include "memory_internal.h"
+
 int memcmp(const void *aptr, const void *bptr, size_t size)
 {
     const unsigned char *a = (const unsigned char *) aptr;
     const unsigned char *b = (const unsigned char *) bptr;
+    size_t i = 0u;
+
+    /* Skips the equal 16-byte blocks; the word loop below pins down the byte. */
+    if (size >= LIBK_MEMORY_VECTOR_COMPARE_THRESHOLD && (libk_memory_features & LIBK_MEMORY_FEATURE_SSE2))
+        i = __libk_memcmp_sse2_mismatch(a, b, size);
+
+    for (; i + 4u <= size; i += 4u)
+    {
+        uint32_t wa = libk_memory_load(a + i);
+        uint32_t wb = libk_memory_load(b + i);
+
+        if (wa != wb)
+        {
+            /* Big-endian order makes the first differing byte the most significant. */
+            wa = __builtin_bswap32(wa);
+            wb = __builtin_bswap32(wb);
+            return (wa < wb) ? -1 : 1;
+        }
+    }
 
-    for (size_t i = 0u; i < size; ++i)
+    for (; i < size; ++i)
     {
         if (a[i] < b[i])
             return -1;
@@ -1,11 +1,17 @@
 #include <string.h>
 
+#include "memory_internal.h"
+
 void *memcpy(void *restrict dstptr, const void *restrict srcptr, size_t size)
 {
     unsigned char *dst = (unsigned char *) dstptr;
     const unsigned char *src = (const unsigned char *) srcptr;
 
-    for (size_t i = 0u; i < size; ++i)
-        dst[i] = src[i];
+    if (size < LIBK_MEMORY_SMALL_LIMIT)
+        libk_memory_copy_small(dst, src, size);
+    else if (size >= LIBK_MEMORY_NON_TEMPORAL_THRESHOLD && (libk_memory_features & LIBK_MEMORY_FEATURE_SSE2))
+        __libk_memcpy_sse2_nt(dst, src, size);
+    else
+        libk_memory_copy_forward(dst, src, size);
     return dstptr;
 }
@@ -1,19 +1,44 @@
 #include <string.h>
 
+#include "memory_internal.h"
+
 void *memmove(void *dstptr, const void *srcptr, size_t size)
 {
     unsigned char *dst = (unsigned char *) dstptr;
     const unsigned char *src = (const unsigned char *) srcptr;
 
-    if (dst < src)
+    if (size < LIBK_MEMORY_SMALL_LIMIT)
     {
-        for (size_t i = 0u; i < size; ++i)
-            dst[i] = src[i];
+        libk_memory_copy_small(dst, src, size);
+        return dstptr;
     }
-    else
+
+    /* Unsigned wrap: true when dst is below src, or past the end of it. */
+    if ((uintptr_t) dst - (uintptr_t) src >= size)
     {
-        for (size_t i = size; i != 0u; --i)
-            dst[i - 1u] = src[i - 1u];
+        if ((uintptr_t) src - (uintptr_t) dst >= size)
+            return memcpy(dstptr, srcptr, size);
+        libk_memory_copy_forward(dst, src, size);
+        return dstptr;
     }
+
+    /* dst overlaps the tail of src: copy downwards. The odd bytes go first,
+       from the top, then whole words. An interrupt taken with DF set is safe:
+       isr_common_stub clears it and IRET brings it back. */
+    unsigned char *dst_last = dst + size - 1u;
+    const unsigned char *src_last = src + size - 1u;
+    size_t tail = size & 3u;
+    size_t words = size >> 2;
+
+    asm volatile("std\n\t"
+                 "rep movsb\n\t"
+                 "subl $3, %%esi\n\t"
+                 "subl $3, %%edi\n\t"
+                 "movl %[words], %%ecx\n\t"
+                 "rep movsl\n\t"
+                 "cld"
+                 : "+D"(dst_last), "+S"(src_last), "+c"(tail)
+                 : [words] "rm"(words)
+                 : "memory", "cc");
     return dstptr;
 }
@@ -0,0 +1,49 @@
+#include <sys/memory_dispatch.h>
+
+#include "memory_internal.h"
+
+uint32_t libk_memory_features = 0u;
+static uint32_t libk_memory_supported = 0u;
+
+static uint32_t libk_memory_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t *ebx, uint32_t *edx)
+{
+    uint32_t eax = leaf;
+    uint32_t ecx = subleaf;
+
+    asm volatile("cpuid" : "+a"(eax), "=b"(*ebx), "+c"(ecx), "=d"(*edx));
+    return eax;
+}
+
+void libk_memory_dispatch_initialize(void)
+{
+    uint32_t ebx;
+    uint32_t edx;
+    uint32_t supported = 0u;
+    const uint32_t max_leaf = libk_memory_cpuid(0u, 0u, &ebx, &edx);
+
+    libk_memory_cpuid(1u, 0u, &ebx, &edx);
+    if (edx & (1u << 26))
+        supported |= LIBK_MEMORY_FEATURE_SSE2;
+
+    if (max_leaf >= 7u)
+    {
+        libk_memory_cpuid(7u, 0u, &ebx, &edx);
+        if (ebx & (1u << 9))
+            supported |= LIBK_MEMORY_FEATURE_ERMS;
+    }
+
+    libk_memory_supported = supported;
+    libk_memory_features = supported;
+}
+
+uint32_t libk_memory_dispatch_get_supported(void) { return libk_memory_supported; }
+
+uint32_t libk_memory_dispatch_get_features(void) { return libk_memory_features; }
+
+uint32_t libk_memory_dispatch_set_features(uint32_t features)
+{
+    uint32_t previous = libk_memory_features;
+
+    libk_memory_features = features & libk_memory_supported;
+    return previous;
+}
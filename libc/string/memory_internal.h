@@ -0,0 +1,89 @@
+#ifndef LIBC_STRING_MEMORY_INTERNAL_H_
+#define LIBC_STRING_MEMORY_INTERNAL_H_
+
+#include <sys/memory_dispatch.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Read on every call, written once at init: a plain word, not an indirect call. */
+extern uint32_t libk_memory_features;
+
+/* arch/i386/string/memory_sse2.S. Both stores paths need size >= 64. */
+void __libk_memcpy_sse2_nt(void *dst, const void *src, size_t size);
+void __libk_memset_sse2_nt(void *dst, int value, size_t size);
+size_t __libk_memcmp_sse2_mismatch(const void *a, const void *b, size_t size);
+
+/* Unaligned, aliasing-safe 32-bit access. Plain byte loops are not an option in
+   here: GCC recognises them and turns them back into calls to memcpy/memset. */
+typedef uint32_t __attribute__((may_alias, aligned(1))) libk_memory_word_t;
+
+static inline uint32_t libk_memory_load(const unsigned char *p)
+{
+    return *(const libk_memory_word_t *) p;
+}
+
+static inline void libk_memory_store(unsigned char *p, uint32_t value)
+{
+    *(libk_memory_word_t *) p = value;
+}
+
+/* size < LIBK_MEMORY_SMALL_LIMIT. Every load happens before the first store,
+   so memmove can use it on overlapping ranges in either direction. */
+static inline void libk_memory_copy_small(unsigned char *dst, const unsigned char *src, size_t size)
+{
+    if (size >= 8u)
+    {
+        uint32_t head0 = libk_memory_load(src);
+        uint32_t head1 = libk_memory_load(src + 4u);
+        uint32_t tail0 = libk_memory_load(src + size - 8u);
+        uint32_t tail1 = libk_memory_load(src + size - 4u);
+        libk_memory_store(dst, head0);
+        libk_memory_store(dst + 4u, head1);
+        libk_memory_store(dst + size - 8u, tail0);
+        libk_memory_store(dst + size - 4u, tail1);
+    }
+    else if (size >= 4u)
+    {
+        uint32_t head = libk_memory_load(src);
+        uint32_t tail = libk_memory_load(src + size - 4u);
+        libk_memory_store(dst, head);
+        libk_memory_store(dst + size - 4u, tail);
+    }
+    else if (size != 0u)
+    {
+        unsigned char first = src[0];
+        unsigned char middle = src[size >> 1];
+        unsigned char last = src[size - 1u];
+        dst[0] = first;
+        dst[size >> 1] = middle;
+        dst[size - 1u] = last;
+    }
+}
+
+/* Ascending copy through the string instructions. Safe when dst < src even if
+   the ranges overlap, since REP MOVS is architecturally sequential. */
+static inline void libk_memory_copy_forward(unsigned char *dst, const unsigned char *src, size_t size)
+{
+    if (libk_memory_features & LIBK_MEMORY_FEATURE_ERMS)
+    {
+        asm volatile("rep movsb" : "+D"(dst), "+S"(src), "+c"(size) : : "memory");
+        return;
+    }
+
+    /* Without ERMS, REP MOVSD is only fast once the destination is aligned. */
+    size_t head = (size_t) (-(uintptr_t) dst & 3u);
+    size_t words = (size - head) >> 2;
+    size_t tail = (size - head) & 3u;
+
+    asm volatile("rep movsb\n\t"
+                 "movl %[words], %%ecx\n\t"
+                 "rep movsl\n\t"
+                 "movl %[tail], %%ecx\n\t"
+                 "rep movsb"
+                 : "+D"(dst), "+S"(src), "+c"(head)
+                 : [words] "rm"(words), [tail] "rm"(tail)
+                 : "memory");
+}
+
+#endif /* !LIBC_STRING_MEMORY_INTERNAL_H_ */
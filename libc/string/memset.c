@@ -1,10 +1,58 @@
 #include <string.h>
 
+#include "memory_internal.h"
+
 void *memset(void *bufptr, int value, size_t size)
 {
     unsigned char *buf = (unsigned char *) bufptr;
+    const uint32_t word = (uint32_t) (unsigned char) value * 0x01010101u;
+
+    if (size < LIBK_MEMORY_SMALL_LIMIT)
+    {
+        if (size >= 8u)
+        {
+            libk_memory_store(buf, word);
+            libk_memory_store(buf + 4u, word);
+            libk_memory_store(buf + size - 8u, word);
+            libk_memory_store(buf + size - 4u, word);
+        }
+        else if (size >= 4u)
+        {
+            libk_memory_store(buf, word);
+            libk_memory_store(buf + size - 4u, word);
+        }
+        else if (size != 0u)
+        {
+            buf[0] = (unsigned char) word;
+            buf[size >> 1] = (unsigned char) word;
+            buf[size - 1u] = (unsigned char) word;
+        }
+        return bufptr;
+    }
+
+    if (size >= LIBK_MEMORY_NON_TEMPORAL_THRESHOLD && (libk_memory_features & LIBK_MEMORY_FEATURE_SSE2))
+    {
+        __libk_memset_sse2_nt(buf, value, size);
+        return bufptr;
+    }
+
+    if (libk_memory_features & LIBK_MEMORY_FEATURE_ERMS)
+    {
+        asm volatile("rep stosb" : "+D"(buf), "+c"(size) : "a"(word) : "memory");
+        return bufptr;
+    }
+
+    size_t head = (size_t) (-(uintptr_t) buf & 3u);
+    size_t words = (size - head) >> 2;
+    size_t tail = (size - head) & 3u;
 
-    for (size_t i = 0u; i < size; ++i)
-        buf[i] = (unsigned char) value;
+    asm volatile("rep stosb\n\t"
+                 "movl %[words], %%ecx\n\t"
+                 "rep stosl\n\t"
+                 "movl %[tail], %%ecx\n\t"
+                 "rep stosb"
+                 : "+D"(buf), "+c"(head)
+                 : "a"(word), [words] "rm"(words), [tail] "rm"(tail)
+                 : "memory");
     return bufptr;
 }
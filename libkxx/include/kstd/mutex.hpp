@@ -2,11 +2,16 @@
 ** LplKernel
 ** libkxx/include/kstd/mutex.hpp
 **
-** Single-threaded kernel mutex facade. The kernel is single-threaded first (per
-** the convergence plan: a job_system interface with an inline executor), so a
-** lock is a no-op that preserves the std::mutex / std::lock_guard call sites in
-** the engine without pulling in <thread>. When a real kernel scheduler lands,
-** these route to a kernel spinlock behind the same interface.
+** Kernel mutex facade behind the std::mutex / std::lock_guard call sites in the
+** engine. It started as a no-op for a single-threaded kernel; now that the job
+** system runs engine code on the APs, a mutex is a real kernel ticket spinlock
+** (kernel/core/lock.h). Uncontended, that is one locked XADD to lock and a plain
+** store to unlock, so the BSP-only boot path pays next to nothing for it.
+**
+** The kernel dependency is out of line, in libkxx/src/mutex.cpp, so this header
+** stays self-contained: the storage below mirrors KernelTicketLock_t and
+** mutex.cpp checks that it does. All-zero is an unlocked lock, which keeps the
+** constructors constexpr and every namespace-scope mutex constant-initialised.
 */
 
 #ifndef KSTD_MUTEX_HPP_
@@ -14,27 +19,48 @@
 
 namespace kstd {
 
+namespace detail {
+
+// Layout of KernelTicketLock_t. Never touched from C++ except through mutex.cpp.
+struct ticket_lock_storage {
+    volatile unsigned short serving = 0;
+    volatile unsigned short next = 0;
+    unsigned int acquired_at = 0;
+    void *statistics = nullptr;
+};
+
+} // namespace detail
+
 class mutex {
 public:
     constexpr mutex() noexcept = default;
     mutex(const mutex &) = delete;
     mutex &operator=(const mutex &) = delete;
 
-    void lock() noexcept {}
-    bool try_lock() noexcept { return true; }
-    void unlock() noexcept {}
+    void lock() noexcept;
+    bool try_lock() noexcept;
+    void unlock() noexcept;
+
+private:
+    detail::ticket_lock_storage _lock{};
 };
 
-// Recursive variant: identical no-op semantics under single-threaded execution.
+// Re-entrant on the CPU that holds it. There are no kernel threads yet, so the
+// owner is the CPU, as reported by kernel_lock_current_owner().
 class recursive_mutex {
 public:
     constexpr recursive_mutex() noexcept = default;
     recursive_mutex(const recursive_mutex &) = delete;
     recursive_mutex &operator=(const recursive_mutex &) = delete;
 
-    void lock() noexcept {}
-    bool try_lock() noexcept { return true; }
-    void unlock() noexcept {}
+    void lock() noexcept;
+    bool try_lock() noexcept;
+    void unlock() noexcept;
+
+private:
+    detail::ticket_lock_storage _lock{};
+    volatile unsigned int _owner = 0;
+    unsigned int _depth = 0;
 };
 
 template <typename Mutex>
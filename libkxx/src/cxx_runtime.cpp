@@ -6,8 +6,9 @@
 **
 ** This translation unit provides the minimal C++ runtime the freestanding
 ** engine module (libengine) needs to link into the kernel image. There is no
-** hosted C++ runtime: heap operators route to the kernel allocator (kmalloc /
-** kfree) and the ABI personality hooks are reduced to kernel-appropriate
+** hosted C++ runtime: heap operators route to the kernel allocator
+** (kmalloc_engine / kfree; on the client profile the engine has its own TLSF
+** instance) and the ABI personality hooks are reduced to kernel-appropriate
 ** behaviour.
 **
 ** Build contract (enforced by the libengine / kernel build):
@@ -21,7 +22,7 @@
 */
 
 extern "C" {
-void *kmalloc(__SIZE_TYPE__ size);
+void *kmalloc_engine(__SIZE_TYPE__ size);
 void kfree(void *pointer);
 void asmutils_disable_interrupts(void);
 void asmutils_halt(void);
@@ -32,7 +33,7 @@ namespace {
 using kernel_size_t = __SIZE_TYPE__;
 
 /* Marker stored immediately before an over-aligned block so the matching
-   aligned operator delete can recover the original kmalloc pointer. */
+   aligned operator delete can recover the original allocation. */
 struct AlignedAllocationHeader {
     void *base_pointer;
 };
@@ -56,7 +57,7 @@ void *allocate_aligned(kernel_size_t size, kernel_size_t alignment)
         alignment = sizeof(void *);
 
     const kernel_size_t overhead = sizeof(AlignedAllocationHeader) + alignment - 1u;
-    void *const base = kmalloc(size + overhead);
+    void *const base = kmalloc_engine(size + overhead);
 
     if (base == nullptr)
         kernel_cxx_fatal();
@@ -97,7 +98,7 @@ struct nothrow_t {
 
 void *operator new(kernel_size_t size)
 {
-    void *const pointer = kmalloc(size == 0u ? 1u : size);
+    void *const pointer = kmalloc_engine(size == 0u ? 1u : size);
     if (pointer == nullptr)
         kernel_cxx_fatal();
     return pointer;
@@ -134,12 +135,12 @@ void operator delete[](void *pointer, kernel_size_t) noexcept
 
 void *operator new(kernel_size_t size, const std::nothrow_t &) noexcept
 {
-    return kmalloc(size == 0u ? 1u : size);
+    return kmalloc_engine(size == 0u ? 1u : size);
 }
 
 void *operator new[](kernel_size_t size, const std::nothrow_t &) noexcept
 {
-    return kmalloc(size == 0u ? 1u : size);
+    return kmalloc_engine(size == 0u ? 1u : size);
 }
 
 void operator delete(void *pointer, const std::nothrow_t &) noexcept
@@ -0,0 +1,81 @@
+/*
+** LplKernel
+** libkxx/src/mutex.cpp
+**
+** kstd::mutex and kstd::recursive_mutex over the kernel ticket lock. The only
+** translation unit of libkxx that sees a kernel lock header; the symbols are
+** resolved from the kernel image at link time, like the halt primitives of
+** support.cpp.
+*/
+
+#include <kstd/mutex.hpp>
+
+#include <kernel/core/lock.h>
+
+#include <cstddef>
+
+namespace kstd {
+
+static_assert(sizeof(detail::ticket_lock_storage) == sizeof(KernelTicketLock_t), "kstd mutex storage out of sync");
+static_assert(offsetof(detail::ticket_lock_storage, serving) == offsetof(KernelTicketLock_t, serving),
+              "kstd mutex storage out of sync");
+static_assert(offsetof(detail::ticket_lock_storage, next) == offsetof(KernelTicketLock_t, next),
+              "kstd mutex storage out of sync");
+static_assert(offsetof(detail::ticket_lock_storage, statistics) == offsetof(KernelTicketLock_t, statistics),
+              "kstd mutex storage out of sync");
+
+static KernelTicketLock_t *as_kernel_lock(detail::ticket_lock_storage &storage) noexcept
+{
+    return reinterpret_cast<KernelTicketLock_t *>(&storage);
+}
+
+void mutex::lock() noexcept { kernel_ticket_lock_acquire(as_kernel_lock(_lock)); }
+
+bool mutex::try_lock() noexcept { return kernel_ticket_lock_try_acquire(as_kernel_lock(_lock)); }
+
+void mutex::unlock() noexcept { kernel_ticket_lock_release(as_kernel_lock(_lock)); }
+
+void recursive_mutex::lock() noexcept
+{
+    const unsigned int self = kernel_lock_current_owner();
+
+    // Only this CPU can have stored its own id, so a stale read of another
+    // owner's id is harmless: it just means we take the slow path and wait.
+    if (_owner == self)
+    {
+        ++_depth;
+        return;
+    }
+
+    kernel_ticket_lock_acquire(as_kernel_lock(_lock));
+    _owner = self;
+    _depth = 1;
+}
+
+bool recursive_mutex::try_lock() noexcept
+{
+    const unsigned int self = kernel_lock_current_owner();
+
+    if (_owner == self)
+    {
+        ++_depth;
+        return true;
+    }
+
+    if (!kernel_ticket_lock_try_acquire(as_kernel_lock(_lock)))
+        return false;
+    _owner = self;
+    _depth = 1;
+    return true;
+}
+
+void recursive_mutex::unlock() noexcept
+{
+    if (--_depth != 0)
+        return;
+
+    _owner = 0;
+    kernel_ticket_lock_release(as_kernel_lock(_lock));
+}
+
+} // namespace kstd
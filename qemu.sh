@@ -72,6 +72,19 @@ if [ "$GRAPHICS_MODE" = "1" ]; then
     fi
 fi
 
+# Binary telemetry, opt-in. With a debug console on port 0xE9 the kernel stops
+# printing [LPLTLM] records on COM1 at 9600 baud and writes them as compact frames
+# from idle time instead, so a record no longer costs its caller a millisecond per
+# character. The serial log keeps the prose; the records land in the file, and
+# ./telemetry-decode.py turns them back into the same [LPLTLM] lines.
+#
+#   LPL_TELEMETRY_DEBUGCON=telemetry.bin ./qemu.sh && ./telemetry-decode.py telemetry.bin
+QEMU_DEBUGCON_OPT=""
+if [ -n "$LPL_TELEMETRY_DEBUGCON" ]; then
+    QEMU_DEBUGCON_OPT="-debugcon file:$LPL_TELEMETRY_DEBUGCON"
+    echo "[qemu] binary telemetry to $LPL_TELEMETRY_DEBUGCON — decode with ./telemetry-decode.py"
+fi
+
 # Clear out any sandbox/snap environment that might pollute the loader search path.
 # this mirrors what `sudo` does and prevents qemu from trying to load
 # libc from /snap/core20/current.
@@ -80,4 +93,4 @@ unset LD_LIBRARY_PATH LD_PRELOAD GTK_PATH XDG_DATA_DIRS
 unset SNAP SNAP_VERSION SNAP_ARCH SNAP_REVISION
 # execute with a minimal PATH as well
 PATH="/usr/bin:/bin" \
-    "$QEMU_CMD" -cdrom lpl.iso -m 256M -serial stdio $QEMU_VGA_OPT $QEMU_DISPLAY_OPT $QEMU_ACCEL_OPT
+    "$QEMU_CMD" -cdrom lpl.iso -m 256M -serial stdio $QEMU_VGA_OPT $QEMU_DISPLAY_OPT $QEMU_ACCEL_OPT $QEMU_DEBUGCON_OPT
@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+"""Turn the kernel's binary telemetry stream back into [LPLTLM] text records.
+
+When the kernel finds a debug console (QEMU: -debugcon file:telemetry.bin) or a
+second UART, it stops printing telemetry records on COM1 and writes them as binary
+frames instead; see kernel/include/kernel/diag/telemetry_stream.h for the format.
+This prints each record exactly as the text path would have, so anything that read
+`[LPLTLM] <domain> key=value ...` lines from the serial log reads this output
+unchanged:
+
+    ./telemetry-decode.py telemetry.bin
+    ./telemetry-decode.py < telemetry.bin | grep '^\\[LPLTLM\\] telemetry '
+
+Frames that fail their checksum are skipped and the reader resynchronises on the
+next sync byte; every such skip, and every gap in a CPU's record sequence, is
+reported on stderr so a damaged capture cannot pass for a complete one.
+
+A span trace exported while the stream is binary (kernel/include/kernel/diag/trace.h)
+travels as TRACE frames in the same capture; --trace writes it out as the JSON
+file Perfetto and chrome://tracing open:
+
+    ./telemetry-decode.py --trace trace.json telemetry.bin > /dev/null
+
+A heap allocation capture (kernel/include/kernel/memory/heap_trace.h) travels as
+HEAP_TRACE frames; --heap-trace writes out the binary document tools/heap-replay
+replays:
+
+    ./telemetry-decode.py --heap-trace heap.trace telemetry.bin > /dev/null
+"""
+
+import argparse
+import sys
+
+SYNC = 0xA5
+FRAME_HELLO = 0x01
+FRAME_DEFINE = 0x02
+FRAME_RECORD = 0x03
+FRAME_TRACE = 0x04
+FRAME_HEAP_TRACE = 0x05
+STREAM_VERSION = 1
+
+FIELD_UNSIGNED = 0
+FIELD_HEXADECIMAL = 1
+FIELD_BOOLEAN = 2
+FIELD_TEXT = 3
+
+PREFIX = "[LPLTLM]"
+
+
+class DecodeError(Exception):
+    pass
+
+
+def read_varint(data, offset):
+    value = 0
+    shift = 0
+    while True:
+        if offset >= len(data) or shift > 28:
+            raise DecodeError("truncated varint")
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, offset
+
+
+def read_bytes(data, offset):
+    length, offset = read_varint(data, offset)
+    if offset + length > len(data):
+        raise DecodeError("truncated text")
+    return data[offset:offset + length].decode("latin-1"), offset + length
+
+
+def render_unsigned(value):
+    # serial_write_int((int32_t) value): values past INT32_MAX print negative, and
+    # INT32_MIN prints a lone '-' because its negation overflows back to itself.
+    if value < 0x80000000:
+        return str(value)
+    if value == 0x80000000:
+        return "-"
+    return "-" + str(0x100000000 - value)
+
+
+def render_hexadecimal(value):
+    return "0x%08X" % value
+
+
+class Decoder:
+    def __init__(self):
+        self.names = {}
+        self.sequences = {}
+        self.errors = 0
+        self.trace = bytearray()
+        self.heap_trace = bytearray()
+
+    def warn(self, message):
+        self.errors += 1
+        sys.stderr.write("telemetry-decode: %s\n" % message)
+
+    def name(self, data, offset):
+        identifier, offset = read_varint(data, offset)
+        if identifier == 0:
+            return read_bytes(data, offset)
+        if identifier not in self.names:
+            raise DecodeError("name id %d used before its definition" % identifier)
+        return self.names[identifier], offset
+
+    def hello(self, payload):
+        if payload[:6] != b"LPLTLM":
+            raise DecodeError("bad hello")
+        if len(payload) > 6 and payload[6] != STREAM_VERSION:
+            self.warn("stream version %d, decoder knows %d" % (payload[6], STREAM_VERSION))
+        # A new boot in the same capture: ids and sequences start over.
+        self.names = {}
+        self.sequences = {}
+
+    def define(self, payload):
+        identifier, offset = read_varint(payload, 0)
+        self.names[identifier] = payload[offset:].decode("latin-1")
+
+    def record(self, payload):
+        cpu, offset = read_varint(payload, 0)
+        sequence, offset = read_varint(payload, offset)
+        expected = self.sequences.get(cpu)
+        if expected is not None and sequence != expected:
+            self.warn("cpu %d: record %d follows %d" % (cpu, sequence, expected - 1))
+        self.sequences[cpu] = sequence + 1
+
+        domain, offset = self.name(payload, offset)
+        line = [PREFIX + " " + domain]
+        while offset < len(payload):
+            key, offset = self.name(payload, offset)
+            if offset >= len(payload):
+                raise DecodeError("field %s has no kind" % key)
+            kind = payload[offset]
+            offset += 1
+            if kind == FIELD_TEXT:
+                value, offset = read_bytes(payload, offset)
+            else:
+                number, offset = read_varint(payload, offset)
+                if kind == FIELD_UNSIGNED:
+                    value = render_unsigned(number)
+                elif kind == FIELD_HEXADECIMAL:
+                    value = render_hexadecimal(number)
+                elif kind == FIELD_BOOLEAN:
+                    value = "1" if number else "0"
+                else:
+                    raise DecodeError("unknown field kind %d" % kind)
+            line.append("%s=%s" % (key, value))
+        return " ".join(line)
+
+    def frames(self, data):
+        offset = 0
+        while offset < len(data):
+            if data[offset] != SYNC:
+                start = offset
+                while offset < len(data) and data[offset] != SYNC:
+                    offset += 1
+                self.warn("skipped %d bytes looking for a frame" % (offset - start))
+                continue
+            try:
+                if offset + 2 > len(data):
+                    raise DecodeError("truncated header")
+                frame_type = data[offset + 1]
+                length, payload_start = read_varint(data, offset + 2)
+                end = payload_start + length
+                if end >= len(data):
+                    raise DecodeError("truncated frame")
+                checksum = sum(data[offset + 1:end]) & 0xFF
+                if checksum != data[end]:
+                    raise DecodeError("checksum mismatch")
+            except DecodeError as error:
+                self.warn("frame at byte %d: %s" % (offset, error))
+                offset += 1
+                continue
+            yield frame_type, data[payload_start:end]
+            offset = end + 1
+
+    def decode(self, data, out):
+        for frame_type, payload in self.frames(data):
+            try:
+                if frame_type == FRAME_HELLO:
+                    self.hello(payload)
+                elif frame_type == FRAME_DEFINE:
+                    self.define(payload)
+                elif frame_type == FRAME_RECORD:
+                    out.write(self.record(payload) + "\n")
+                elif frame_type == FRAME_TRACE:
+                    self.trace += payload
+                elif frame_type == FRAME_HEAP_TRACE:
+                    self.heap_trace += payload
+                else:
+                    self.warn("unknown frame type %d" % frame_type)
+            except DecodeError as error:
+                self.warn(str(error))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode LplKernel binary telemetry into [LPLTLM] lines.")
+    parser.add_argument("input", nargs="?", help="capture file (default: standard input)")
+    parser.add_argument("--trace", metavar="FILE", help="write the span trace carried in TRACE frames to FILE")
+    parser.add_argument("--heap-trace", metavar="FILE",
+                        help="write the heap capture carried in HEAP_TRACE frames to FILE")
+    arguments = parser.parse_args()
+
+    if arguments.input:
+        with open(arguments.input, "rb") as capture:
+            data = capture.read()
+    else:
+        data = sys.stdin.buffer.read()
+
+    decoder = Decoder()
+    decoder.decode(data, sys.stdout)
+
+    if arguments.trace:
+        with open(arguments.trace, "wb") as trace:
+            trace.write(decoder.trace)
+    elif decoder.trace:
+        sys.stderr.write("telemetry-decode: %d trace bytes not written; pass --trace FILE\n" % len(decoder.trace))
+
+    if arguments.heap_trace:
+        with open(arguments.heap_trace, "wb") as heap_trace:
+            heap_trace.write(decoder.heap_trace)
+    elif decoder.heap_trace:
+        sys.stderr.write(
+            "telemetry-decode: %d heap trace bytes not written; pass --heap-trace FILE\n" % len(decoder.heap_trace))
+    return 1 if decoder.errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
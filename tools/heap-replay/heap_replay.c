@@ -0,0 +1,548 @@
+/**
+ * @file heap_replay.c
+ * @brief Replay a kernel heap capture through the kernel's own allocator code.
+ *
+ * Reads the document kernel_heap_trace_export() writes — the binary form
+ * `telemetry-decode.py --heap-trace` produces, or a serial log holding the hex
+ * form between its markers — and issues every kmalloc, kmalloc_engine,
+ * kmalloc_sensitive and kfree again, in order, on the CPU slot the kernel ran it
+ * on. Each call is timed with the TSC and filed by operation and by the path that
+ * served it; the result is printed as [LPLTLM] records, percentiles first, then a
+ * log2 histogram, then the allocators' own reports.
+ *
+ * The same capture replayed by the client build (slab + TLSF) and the server build
+ * (size classes + first fit) is the comparison `make compare` prints.
+ *
+ * Only the order of calls is replayed, not their timing or their concurrency, and
+ * the heap's headers are 8 bytes wider on the 64-bit host than on i386.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#define _GNU_SOURCE /* memmem */
+
+#include "host_shim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/diag/telemetry.h>
+#include <kernel/memory/allocator_registry.h>
+#include <kernel/memory/heap.h>
+#include <kernel/memory/heap_trace.h>
+#include <kernel/memory/slab.h>
+#include <kernel/memory/tlsf.h>
+
+/* Block flags, as kernel/memory/heap.c defines them. */
+#define HEAP_REPLAY_FLAG_BIG  0x02u
+#define HEAP_REPLAY_FLAG_SC   0x04u
+#define HEAP_REPLAY_FLAG_VMM  0x08u
+#define HEAP_REPLAY_FLAG_SENS 0x10u
+#define HEAP_REPLAY_FLAG_SLAB 0x20u
+#define HEAP_REPLAY_FLAG_TLSF 0x40u
+
+#define HEAP_REPLAY_HISTOGRAM_BUCKETS 32u
+
+typedef enum HeapReplayPath {
+    HEAP_REPLAY_PATH_SLAB,
+    HEAP_REPLAY_PATH_TLSF,
+    HEAP_REPLAY_PATH_SIZE_CLASS,
+    HEAP_REPLAY_PATH_FIRST_FIT,
+    HEAP_REPLAY_PATH_BIG,
+    HEAP_REPLAY_PATH_VMM,
+    HEAP_REPLAY_PATH_SENSITIVE,
+    HEAP_REPLAY_PATH_COUNT,
+} HeapReplayPath_t;
+
+static const char *const heap_replay_path_names[HEAP_REPLAY_PATH_COUNT] = {
+    "slab", "tlsf", "size_class", "first_fit", "big", "vmm", "sensitive",
+};
+
+/* Operations 1..4 as the capture numbers them; 0 is unused. */
+#define HEAP_REPLAY_OPERATION_COUNT 5u
+
+static const char *const heap_replay_operation_names[HEAP_REPLAY_OPERATION_COUNT] = {
+    "none", "alloc", "free", "engine_alloc", "sensitive_alloc",
+};
+
+typedef struct HeapReplaySamples {
+    uint32_t *cycles;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t histogram[HEAP_REPLAY_HISTOGRAM_BUCKETS];
+} HeapReplaySamples_t;
+
+typedef struct HeapReplaySlot {
+    uint32_t id;
+    uint32_t size;
+    void *pointer;
+} HeapReplaySlot_t;
+
+typedef struct HeapReplayDocument {
+    KernelHeapTraceHeader_t header;
+    const KernelHeapTraceEvent_t *events;
+} HeapReplayDocument_t;
+
+/* The reports want a port; the shim's telemetry prints to stdout and ignores it. */
+static Serial_t heap_replay_serial;
+
+static HeapReplaySamples_t heap_replay_by_operation[HEAP_REPLAY_OPERATION_COUNT];
+static HeapReplaySamples_t heap_replay_by_path[HEAP_REPLAY_PATH_COUNT];
+
+/* Live blocks by capture id: linear probing with backward-shift deletion. */
+static HeapReplaySlot_t *heap_replay_live;
+static uint32_t heap_replay_live_mask;
+
+static inline uint64_t heap_replay_read_timestamp(void)
+{
+    __builtin_ia32_lfence();
+    const uint64_t timestamp = __builtin_ia32_rdtsc();
+    __builtin_ia32_lfence();
+    return timestamp;
+}
+
+static HeapReplayPath_t heap_replay_path(uint8_t flags)
+{
+    if (flags & HEAP_REPLAY_FLAG_SENS)
+        return HEAP_REPLAY_PATH_SENSITIVE;
+    if (flags & HEAP_REPLAY_FLAG_VMM)
+        return HEAP_REPLAY_PATH_VMM;
+    if (flags & HEAP_REPLAY_FLAG_SLAB)
+        return HEAP_REPLAY_PATH_SLAB;
+    if (flags & HEAP_REPLAY_FLAG_TLSF)
+        return HEAP_REPLAY_PATH_TLSF;
+    if (flags & HEAP_REPLAY_FLAG_SC)
+        return HEAP_REPLAY_PATH_SIZE_CLASS;
+    if (flags & HEAP_REPLAY_FLAG_BIG)
+        return HEAP_REPLAY_PATH_BIG;
+    return HEAP_REPLAY_PATH_FIRST_FIT;
+}
+
+static uint8_t heap_replay_block_flags(const void *pointer)
+{
+    return pointer ? (((const KernelHeapBlock_t *) pointer) - 1)->flags : 0u;
+}
+
+static void heap_replay_sample(HeapReplaySamples_t *samples, uint64_t cycles)
+{
+    const uint32_t value = cycles > UINT32_MAX ? UINT32_MAX : (uint32_t) cycles;
+
+    if (samples->count == samples->capacity)
+    {
+        samples->capacity = samples->capacity ? samples->capacity * 2u : 1024u;
+        samples->cycles = realloc(samples->cycles, samples->capacity * sizeof(uint32_t));
+        if (!samples->cycles)
+        {
+            fprintf(stderr, "heap-replay: out of memory\n");
+            exit(1);
+        }
+    }
+    samples->cycles[samples->count++] = value;
+
+    uint32_t bucket = value ? 31u - (uint32_t) __builtin_clz(value) : 0u;
+    ++samples->histogram[bucket];
+}
+
+/* ── Live block table ────────────────────────────────────────────────────── */
+
+static uint32_t heap_replay_hash(uint32_t id) { return (id * 2654435761u) & heap_replay_live_mask; }
+
+static HeapReplaySlot_t *heap_replay_find(uint32_t id)
+{
+    for (uint32_t index = heap_replay_hash(id);; index = (index + 1u) & heap_replay_live_mask)
+    {
+        if (heap_replay_live[index].id == id)
+            return &heap_replay_live[index];
+        if (heap_replay_live[index].id == 0u)
+            return NULL;
+    }
+}
+
+static void heap_replay_insert(uint32_t id, uint32_t size, void *pointer)
+{
+    uint32_t index = heap_replay_hash(id);
+
+    while (heap_replay_live[index].id != 0u && heap_replay_live[index].id != id)
+        index = (index + 1u) & heap_replay_live_mask;
+
+    heap_replay_live[index] = (HeapReplaySlot_t) {.id = id, .size = size, .pointer = pointer};
+}
+
+static void heap_replay_remove(HeapReplaySlot_t *slot)
+{
+    uint32_t hole = (uint32_t) (slot - heap_replay_live);
+    uint32_t index = hole;
+
+    for (;;)
+    {
+        index = (index + 1u) & heap_replay_live_mask;
+        if (heap_replay_live[index].id == 0u)
+            break;
+
+        /* An entry may move back into the hole only if its home is not between
+           the hole and where it sits now. */
+        const uint32_t home = heap_replay_hash(heap_replay_live[index].id);
+        if (((index - home) & heap_replay_live_mask) >= ((index - hole) & heap_replay_live_mask))
+        {
+            heap_replay_live[hole] = heap_replay_live[index];
+            hole = index;
+        }
+    }
+    heap_replay_live[hole].id = 0u;
+}
+
+/* ── Input ───────────────────────────────────────────────────────────────── */
+
+static uint8_t *heap_replay_read_file(const char *path, size_t *length)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+
+    size_t capacity = 1u << 20;
+    size_t used = 0u;
+    uint8_t *bytes = malloc(capacity);
+
+    while (bytes)
+    {
+        used += fread(bytes + used, 1u, capacity - used, file);
+        if (used < capacity)
+            break;
+        capacity *= 2u;
+        bytes = realloc(bytes, capacity);
+    }
+    fclose(file);
+
+    *length = used;
+    return bytes;
+}
+
+static int heap_replay_hex_digit(char character)
+{
+    if (character >= '0' && character <= '9')
+        return character - '0';
+    if (character >= 'a' && character <= 'f')
+        return character - 'a' + 10;
+    if (character >= 'A' && character <= 'F')
+        return character - 'A' + 10;
+    return -1;
+}
+
+/*
+ * Decode the hex lines between the markers in place. A line that is not all hex
+ * digits — another CPU's output landing mid-dump — is skipped and counted; the
+ * event count in the header then shows whether anything was lost.
+ */
+static size_t heap_replay_decode_text(uint8_t *text, size_t length, uint32_t *skipped_lines)
+{
+    const char *begin = memmem(text, length, KERNEL_HEAP_TRACE_EXPORT_BEGIN_MARKER,
+                               sizeof(KERNEL_HEAP_TRACE_EXPORT_BEGIN_MARKER) - 1u);
+    if (!begin)
+        return 0u;
+
+    const char *cursor = begin + sizeof(KERNEL_HEAP_TRACE_EXPORT_BEGIN_MARKER) - 1u;
+    const char *end = (const char *) text + length;
+    size_t written = 0u;
+
+    while (cursor < end)
+    {
+        const char *line_end = memchr(cursor, '\n', (size_t) (end - cursor));
+        if (!line_end)
+            line_end = end;
+
+        size_t line_length = (size_t) (line_end - cursor);
+        while (line_length > 0u && (cursor[line_length - 1u] == '\r' || cursor[line_length - 1u] == ' '))
+            --line_length;
+
+        if (line_length >= sizeof(KERNEL_HEAP_TRACE_EXPORT_END_MARKER) - 1u &&
+            memcmp(cursor, KERNEL_HEAP_TRACE_EXPORT_END_MARKER, sizeof(KERNEL_HEAP_TRACE_EXPORT_END_MARKER) - 1u) == 0)
+            break;
+
+        bool valid = line_length > 0u && (line_length % 2u) == 0u;
+        for (size_t index = 0u; valid && index < line_length; ++index)
+            valid = heap_replay_hex_digit(cursor[index]) >= 0;
+
+        if (valid)
+        {
+            for (size_t index = 0u; index < line_length; index += 2u)
+                text[written++] = (uint8_t) (heap_replay_hex_digit(cursor[index]) << 4 |
+                                             heap_replay_hex_digit(cursor[index + 1u]));
+        }
+        else if (line_length > 0u)
+            ++*skipped_lines;
+
+        cursor = line_end + 1;
+    }
+    return written;
+}
+
+static bool heap_replay_parse(uint8_t *bytes, size_t length, HeapReplayDocument_t *document, uint32_t *skipped_lines)
+{
+    if (length < sizeof(KERNEL_HEAP_TRACE_MAGIC) ||
+        memcmp(bytes, KERNEL_HEAP_TRACE_MAGIC, sizeof(KERNEL_HEAP_TRACE_MAGIC)) != 0)
+        length = heap_replay_decode_text(bytes, length, skipped_lines);
+
+    if (length < sizeof(KernelHeapTraceHeader_t))
+        return false;
+
+    memcpy(&document->header, bytes, sizeof(document->header));
+    if (memcmp(document->header.magic, KERNEL_HEAP_TRACE_MAGIC, sizeof(KERNEL_HEAP_TRACE_MAGIC)) ||
+        document->header.version != KERNEL_HEAP_TRACE_VERSION ||
+        document->header.event_size != sizeof(KernelHeapTraceEvent_t))
+        return false;
+
+    const size_t available = (length - sizeof(KernelHeapTraceHeader_t)) / sizeof(KernelHeapTraceEvent_t);
+    if (available < document->header.events)
+    {
+        fprintf(stderr, "heap-replay: header announces %u events, document holds %zu\n", document->header.events,
+                available);
+        document->header.events = (uint32_t) available;
+    }
+
+    document->events = (const KernelHeapTraceEvent_t *) (bytes + sizeof(KernelHeapTraceHeader_t));
+    return true;
+}
+
+/* ── Report ──────────────────────────────────────────────────────────────── */
+
+static int heap_replay_compare_cycles(const void *lhs, const void *rhs)
+{
+    const uint32_t a = *(const uint32_t *) lhs;
+    const uint32_t b = *(const uint32_t *) rhs;
+
+    return (a > b) - (a < b);
+}
+
+static uint32_t heap_replay_percentile(const HeapReplaySamples_t *samples, uint32_t permille_tenths)
+{
+    uint64_t rank = ((uint64_t) samples->count * permille_tenths + 9999u) / 10000u;
+
+    return samples->cycles[rank ? rank - 1u : 0u];
+}
+
+static void heap_replay_report_samples(const char *key, const char *name, HeapReplaySamples_t *samples)
+{
+    if (samples->count == 0u)
+        return;
+
+    qsort(samples->cycles, samples->count, sizeof(uint32_t), heap_replay_compare_cycles);
+
+    uint64_t total = 0u;
+    for (uint32_t index = 0u; index < samples->count; ++index)
+        total += samples->cycles[index];
+
+    kernel_telemetry_begin_record(&heap_replay_serial, "heap_replay_latency");
+    kernel_telemetry_write_text(key, name);
+    kernel_telemetry_write_unsigned("count", samples->count);
+    kernel_telemetry_write_unsigned("mean_cycles", (uint32_t) (total / samples->count));
+    kernel_telemetry_write_unsigned("p50_cycles", heap_replay_percentile(samples, 5000u));
+    kernel_telemetry_write_unsigned("p90_cycles", heap_replay_percentile(samples, 9000u));
+    kernel_telemetry_write_unsigned("p99_cycles", heap_replay_percentile(samples, 9900u));
+    kernel_telemetry_write_unsigned("p999_cycles", heap_replay_percentile(samples, 9990u));
+    kernel_telemetry_write_unsigned("max_cycles", samples->cycles[samples->count - 1u]);
+    kernel_telemetry_end_record();
+
+    /* Bucket b counts calls of 2^b up to 2^(b+1) - 1 cycles. */
+    kernel_telemetry_begin_record(&heap_replay_serial, "heap_replay_histogram");
+    kernel_telemetry_write_text(key, name);
+    for (uint32_t bucket = 0u; bucket < HEAP_REPLAY_HISTOGRAM_BUCKETS; ++bucket)
+    {
+        if (samples->histogram[bucket] == 0u)
+            continue;
+
+        char bucket_key[16];
+        snprintf(bucket_key, sizeof(bucket_key), "lt_2e%u", bucket + 1u);
+        kernel_telemetry_write_unsigned(bucket_key, samples->histogram[bucket]);
+    }
+    kernel_telemetry_end_record();
+}
+
+/* ── Replay ──────────────────────────────────────────────────────────────── */
+
+typedef struct HeapReplayCounters {
+    uint32_t replayed;
+    uint32_t failed_allocations;  /* the replay could not allocate */
+    uint32_t captured_failures;   /* the kernel could not allocate */
+    uint32_t unmatched_frees;     /* freed a block the capture never saw allocated */
+    uint32_t path_mismatches;     /* served by another path than in the kernel */
+    uint64_t live_bytes;
+    uint64_t peak_live_bytes;
+} HeapReplayCounters_t;
+
+static void *heap_replay_allocate(uint8_t operation, uint32_t size)
+{
+    switch (operation)
+    {
+    case KERNEL_HEAP_TRACE_OPERATION_ENGINE_ALLOC:
+        return kmalloc_engine(size);
+    case KERNEL_HEAP_TRACE_OPERATION_SENSITIVE_ALLOC:
+        return kmalloc_sensitive(size);
+    default:
+        return kmalloc(size);
+    }
+}
+
+static void heap_replay_event(const KernelHeapTraceEvent_t *event, uint32_t cpu_count, HeapReplayCounters_t *counters)
+{
+    host_shim_set_cpu(event->cpu, cpu_count);
+
+    if (event->operation == KERNEL_HEAP_TRACE_OPERATION_FREE)
+    {
+        HeapReplaySlot_t *slot = heap_replay_find(event->id);
+        if (!slot)
+        {
+            ++counters->unmatched_frees;
+            return;
+        }
+
+        void *pointer = slot->pointer;
+        const uint8_t flags = heap_replay_block_flags(pointer);
+        counters->live_bytes -= slot->size;
+        heap_replay_remove(slot);
+
+        const uint64_t start = heap_replay_read_timestamp();
+        kfree(pointer);
+        const uint64_t cycles = heap_replay_read_timestamp() - start;
+
+        heap_replay_sample(&heap_replay_by_operation[event->operation], cycles);
+        heap_replay_sample(&heap_replay_by_path[heap_replay_path(flags)], cycles);
+        counters->path_mismatches += heap_replay_path(flags) != heap_replay_path(event->path);
+        ++counters->replayed;
+        return;
+    }
+
+    if (event->operation == 0u || event->operation >= HEAP_REPLAY_OPERATION_COUNT)
+        return;
+
+    const uint64_t start = heap_replay_read_timestamp();
+    void *pointer = heap_replay_allocate(event->operation, event->size);
+    const uint64_t cycles = heap_replay_read_timestamp() - start;
+
+    ++counters->replayed;
+    heap_replay_sample(&heap_replay_by_operation[event->operation], cycles);
+    if (!pointer)
+    {
+        ++counters->failed_allocations;
+        return;
+    }
+
+    const uint8_t flags = heap_replay_block_flags(pointer);
+    heap_replay_sample(&heap_replay_by_path[heap_replay_path(flags)], cycles);
+
+    /* Nothing can free a block the kernel never had; keep the heap as it was. */
+    if (event->id == 0u)
+    {
+        ++counters->captured_failures;
+        kfree(pointer);
+        return;
+    }
+    counters->path_mismatches += heap_replay_path(flags) != heap_replay_path(event->path);
+
+    /* The same id live twice means the free between them was dropped. */
+    HeapReplaySlot_t *stale = heap_replay_find(event->id);
+    if (stale)
+    {
+        counters->live_bytes -= stale->size;
+        kfree(stale->pointer);
+        heap_replay_remove(stale);
+    }
+
+    heap_replay_insert(event->id, event->size, pointer);
+    counters->live_bytes += event->size;
+    if (counters->live_bytes > counters->peak_live_bytes)
+        counters->peak_live_bytes = counters->live_bytes;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s TRACE\n"
+                        "  TRACE: telemetry-decode.py --heap-trace output, or a serial log holding\n"
+                        "         " KERNEL_HEAP_TRACE_EXPORT_BEGIN_MARKER " ... " KERNEL_HEAP_TRACE_EXPORT_END_MARKER
+                        "\n",
+                argv[0]);
+        return 2;
+    }
+
+    size_t length = 0u;
+    uint8_t *bytes = heap_replay_read_file(argv[1], &length);
+    if (!bytes)
+    {
+        fprintf(stderr, "heap-replay: cannot read %s\n", argv[1]);
+        return 1;
+    }
+
+    HeapReplayDocument_t document;
+    uint32_t skipped_lines = 0u;
+    if (!heap_replay_parse(bytes, length, &document, &skipped_lines))
+    {
+        fprintf(stderr, "heap-replay: %s holds no heap trace document\n", argv[1]);
+        return 1;
+    }
+
+    uint32_t cpu_count = 1u;
+    for (uint32_t index = 0u; index < document.header.events; ++index)
+        if (document.events[index].cpu + 1u > cpu_count)
+            cpu_count = document.events[index].cpu + 1u;
+
+    uint32_t live_capacity = 1024u;
+    while (live_capacity < document.header.events * 2u)
+        live_capacity *= 2u;
+    heap_replay_live = calloc(live_capacity, sizeof(HeapReplaySlot_t));
+    heap_replay_live_mask = live_capacity - 1u;
+
+    if (!heap_replay_live || !host_shim_initialize())
+        return 1;
+
+    kernel_heap_initialize();
+    for (uint32_t cpu = 1u; cpu < cpu_count; ++cpu)
+    {
+        host_shim_set_cpu(cpu, cpu_count);
+        kernel_heap_initialize_ap_domain(cpu);
+    }
+
+    HeapReplayCounters_t counters = {0};
+    for (uint32_t index = 0u; index < document.header.events; ++index)
+        heap_replay_event(&document.events[index], cpu_count, &counters);
+
+    kernel_telemetry_begin_record(&heap_replay_serial, "heap_replay");
+    kernel_telemetry_write_text("strategy", kernel_heap_get_strategy_name());
+#ifdef LPL_KERNEL_REAL_TIME_MODE
+    kernel_telemetry_write_text("replay_profile", "client");
+#else
+    kernel_telemetry_write_text("replay_profile", "server");
+#endif
+    kernel_telemetry_write_text("captured_profile", document.header.real_time ? "client" : "server");
+    kernel_telemetry_write_unsigned("events", document.header.events);
+    kernel_telemetry_write_unsigned("dropped_at_capture", document.header.dropped);
+    kernel_telemetry_write_unsigned("skipped_lines", skipped_lines);
+    kernel_telemetry_write_unsigned("cpus", cpu_count);
+    kernel_telemetry_write_unsigned("replayed", counters.replayed);
+    kernel_telemetry_write_unsigned("failed_allocations", counters.failed_allocations);
+    kernel_telemetry_write_unsigned("captured_failures", counters.captured_failures);
+    kernel_telemetry_write_unsigned("unmatched_frees", counters.unmatched_frees);
+    kernel_telemetry_write_unsigned("path_mismatches", counters.path_mismatches);
+    kernel_telemetry_write_unsigned("peak_live_bytes", (uint32_t) counters.peak_live_bytes);
+    kernel_telemetry_write_unsigned("live_bytes_at_end", (uint32_t) counters.live_bytes);
+    kernel_telemetry_write_unsigned("rejected_frees", kernel_heap_debug_get_rejected_free_count());
+    kernel_telemetry_write_unsigned("tlsf_extensions", kernel_heap_get_tlsf_extension_count());
+    kernel_telemetry_end_record();
+
+    for (uint32_t operation = 1u; operation < HEAP_REPLAY_OPERATION_COUNT; ++operation)
+        heap_replay_report_samples("op", heap_replay_operation_names[operation], &heap_replay_by_operation[operation]);
+    for (uint32_t path = 0u; path < HEAP_REPLAY_PATH_COUNT; ++path)
+        heap_replay_report_samples("path", heap_replay_path_names[path], &heap_replay_by_path[path]);
+
+    kernel_allocator_registry_report(&heap_replay_serial);
+    kernel_slab_report(&heap_replay_serial);
+    kernel_tlsf_report(&heap_replay_serial, kernel_tlsf_get_default());
+    kernel_tlsf_report(&heap_replay_serial, kernel_heap_get_engine_tlsf());
+
+    free(bytes);
+    return counters.failed_allocations ? 1 : 0;
+}
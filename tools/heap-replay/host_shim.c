@@ -0,0 +1,259 @@
+/**
+ * @file host_shim.c
+ * @brief The kernel services heap.c, slab.c and tlsf.c call, for a host process.
+ *
+ * The allocators keep addresses in uint32_t and reach physical memory through the
+ * direct map at KERNEL_VIRTUAL_BASE, so the shim recreates that layout in the low
+ * 4 GiB of a non-PIE process: a fixed mapping at 0xC0000000 stands for physical
+ * memory, and a second one above it for the VMM's window. The linker places
+ * global_kernel_start at 0xC0000000 (see the Makefile).
+ *
+ * Neither page allocator is timed by the kernel as the replay times it, so both
+ * are O(1): a free list per order (PMM) or per page count (VMM) in front of a
+ * bump pointer. They never merge, which a replay of a boot does not notice.
+ * Both mappings are populated up front so no replayed call pays a page fault.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#include "host_shim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <kernel/core/lock.h>
+#include <kernel/cpu/cpu_topology.h>
+#include <kernel/cpu/pmm.h>
+#include <kernel/diag/telemetry.h>
+#include <kernel/diag/trace.h>
+#include <kernel/memory/heap_trace.h>
+#include <kernel/memory/vmm.h>
+
+#define HOST_SHIM_DIRECT_MAP_BASE  0xC0000000u
+#define HOST_SHIM_DIRECT_MAP_BYTES 0x10000000u /* 256 MiB of "physical" memory */
+#define HOST_SHIM_VMM_BASE         0xD0000000u
+#define HOST_SHIM_VMM_BYTES        0x08000000u
+#define HOST_SHIM_PAGE_BYTES       4096u
+
+/* Physical page 0 is never handed out: the PMM returns 0 for failure. */
+#define HOST_SHIM_FIRST_PHYSICAL 0x00100000u
+
+#define HOST_SHIM_MAX_ORDER      16u
+#define HOST_SHIM_VMM_LIST_COUNT 64u /* exact page counts 1..63; the last list holds the rest */
+
+typedef struct HostShimFreeRange {
+    struct HostShimFreeRange *next;
+    uint32_t pages;
+} HostShimFreeRange_t;
+
+static uint32_t host_shim_physical_next = HOST_SHIM_FIRST_PHYSICAL;
+static uint32_t host_shim_physical_free[HOST_SHIM_MAX_ORDER + 1u];
+static uintptr_t host_shim_vmm_next = HOST_SHIM_VMM_BASE;
+static HostShimFreeRange_t *host_shim_vmm_free[HOST_SHIM_VMM_LIST_COUNT];
+static uint32_t host_shim_cpu = 0u;
+static uint32_t host_shim_cpu_count = 1u;
+
+volatile bool kernel_trace_recording = false;
+volatile bool kernel_heap_trace_recording = false;
+
+static void *host_shim_map(uintptr_t base, size_t bytes)
+{
+    void *mapping = mmap((void *) base, bytes, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | MAP_POPULATE, -1, 0);
+
+    return mapping == (void *) base ? mapping : NULL;
+}
+
+bool host_shim_initialize(void)
+{
+    if (!host_shim_map(HOST_SHIM_DIRECT_MAP_BASE, HOST_SHIM_DIRECT_MAP_BYTES) ||
+        !host_shim_map(HOST_SHIM_VMM_BASE, HOST_SHIM_VMM_BYTES))
+    {
+        fprintf(stderr, "heap-replay: cannot map the kernel's address layout below 4 GiB\n");
+        return false;
+    }
+    return true;
+}
+
+void host_shim_set_cpu(uint32_t cpu, uint32_t cpu_count)
+{
+    host_shim_cpu = cpu < CPU_TOPOLOGY_MAX_LOGICAL_CPUS_PUBLIC ? cpu : 0u;
+    host_shim_cpu_count = cpu_count;
+}
+
+/* ── PMM ─────────────────────────────────────────────────────────────────── */
+
+static uint32_t *host_shim_physical_link(uint32_t phys)
+{
+    return (uint32_t *) (uintptr_t) (phys + HOST_SHIM_DIRECT_MAP_BASE);
+}
+
+uint32_t physical_memory_manager_page_frame_allocate_order(uint8_t order)
+{
+    if (order > HOST_SHIM_MAX_ORDER)
+        return 0u;
+
+    uint32_t phys = host_shim_physical_free[order];
+    if (phys)
+    {
+        host_shim_physical_free[order] = *host_shim_physical_link(phys);
+        return phys;
+    }
+
+    const uint32_t bytes = HOST_SHIM_PAGE_BYTES << order;
+    phys = (host_shim_physical_next + bytes - 1u) & ~(bytes - 1u);
+    if (phys + bytes > HOST_SHIM_DIRECT_MAP_BYTES)
+        return 0u;
+
+    host_shim_physical_next = phys + bytes;
+    return phys;
+}
+
+uint32_t physical_memory_manager_page_frame_allocate(void)
+{
+    return physical_memory_manager_page_frame_allocate_order(0u);
+}
+
+void physical_memory_manager_page_frame_free_order(uint32_t phys_addr, uint8_t order)
+{
+    if (!phys_addr || order > HOST_SHIM_MAX_ORDER)
+        return;
+
+    *host_shim_physical_link(phys_addr) = host_shim_physical_free[order];
+    host_shim_physical_free[order] = phys_addr;
+}
+
+void physical_memory_manager_page_frame_free(uint32_t phys_addr)
+{
+    physical_memory_manager_page_frame_free_order(phys_addr, 0u);
+}
+
+/* ── VMM ─────────────────────────────────────────────────────────────────── */
+
+static uint32_t host_shim_vmm_list(uint32_t pages)
+{
+    return pages < HOST_SHIM_VMM_LIST_COUNT ? pages : HOST_SHIM_VMM_LIST_COUNT - 1u;
+}
+
+void *kernel_vmm_alloc_pages(uint32_t page_count)
+{
+    if (page_count == 0u)
+        return NULL;
+
+    HostShimFreeRange_t **link = &host_shim_vmm_free[host_shim_vmm_list(page_count)];
+    for (; *link; link = &(*link)->next)
+    {
+        if ((*link)->pages == page_count)
+        {
+            HostShimFreeRange_t *range = *link;
+
+            *link = range->next;
+            return range;
+        }
+    }
+
+    const uintptr_t bytes = (uintptr_t) page_count * HOST_SHIM_PAGE_BYTES;
+    if (host_shim_vmm_next + bytes > HOST_SHIM_VMM_BASE + HOST_SHIM_VMM_BYTES)
+        return NULL;
+
+    void *pages = (void *) host_shim_vmm_next;
+    host_shim_vmm_next += bytes;
+    return pages;
+}
+
+void *kernel_vmm_alloc_small_pages(uint32_t page_count) { return kernel_vmm_alloc_pages(page_count); }
+
+void kernel_vmm_free_pages(void *ptr, uint32_t page_count)
+{
+    if (!ptr || page_count == 0u)
+        return;
+
+    HostShimFreeRange_t *range = (HostShimFreeRange_t *) ptr;
+    range->pages = page_count;
+    range->next = host_shim_vmm_free[host_shim_vmm_list(page_count)];
+    host_shim_vmm_free[host_shim_vmm_list(page_count)] = range;
+}
+
+/* ── CPU topology ────────────────────────────────────────────────────────── */
+
+uint32_t cpu_topology_get_logical_slot(void) { return host_shim_cpu; }
+
+bool cpu_topology_is_logical_slot_online(uint32_t slot) { return slot < host_shim_cpu_count; }
+
+/* ── Locks: one thread, so every lock is free ────────────────────────────── */
+
+void kernel_lock_statistics_register(KernelLockStatistics_t *statistics, const char *name)
+{
+    (void) statistics;
+    (void) name;
+}
+
+void kernel_ticket_lock_initialize(KernelTicketLock_t *lock, KernelLockStatistics_t *statistics)
+{
+    lock->serving = 0u;
+    lock->next = 0u;
+    lock->acquired_at = 0u;
+    lock->statistics = statistics;
+}
+
+void kernel_ticket_lock_acquire(KernelTicketLock_t *lock) { (void) lock; }
+
+bool kernel_ticket_lock_try_acquire(KernelTicketLock_t *lock)
+{
+    (void) lock;
+    return true;
+}
+
+void kernel_ticket_lock_release(KernelTicketLock_t *lock) { (void) lock; }
+
+uint32_t kernel_ticket_lock_acquire_irqsave(KernelTicketLock_t *lock)
+{
+    (void) lock;
+    return 0u;
+}
+
+void kernel_ticket_lock_release_irqrestore(KernelTicketLock_t *lock, uint32_t flags)
+{
+    (void) lock;
+    (void) flags;
+}
+
+/* ── Tracing: the replay is not itself captured ──────────────────────────── */
+
+void kernel_trace_end(KernelTraceSite_t *site, uint64_t start, uint16_t argument)
+{
+    (void) site;
+    (void) start;
+    (void) argument;
+}
+
+void kernel_heap_trace_record(KernelHeapTraceOperation_t operation, uint32_t size, const void *pointer, uint8_t path,
+                              const void *caller)
+{
+    (void) operation;
+    (void) size;
+    (void) pointer;
+    (void) path;
+    (void) caller;
+}
+
+/* ── Telemetry: the same [LPLTLM] lines the kernel prints, on stdout ─────── */
+
+void kernel_telemetry_begin_record(Serial_t *serial, const char *domain)
+{
+    (void) serial;
+    printf("[LPLTLM] %s", domain);
+}
+
+void kernel_telemetry_write_unsigned(const char *key, uint32_t value) { printf(" %s=%u", key, value); }
+
+void kernel_telemetry_write_hexadecimal(const char *key, uint32_t value) { printf(" %s=0x%08x", key, value); }
+
+void kernel_telemetry_write_boolean(const char *key, bool value) { printf(" %s=%u", key, value ? 1u : 0u); }
+
+void kernel_telemetry_write_text(const char *key, const char *value) { printf(" %s=%s", key, value ? value : "none"); }
+
+void kernel_telemetry_end_record(void) { printf("\n"); }
@@ -0,0 +1,27 @@
+/**
+ * @file host_shim.h
+ * @brief Set-up of the host stand-ins for the kernel services the heap calls.
+ *
+ * @author MasterLaplace
+ * @version 0.1.0
+ * @copyright MIT License
+ */
+
+#ifndef HEAP_REPLAY_HOST_SHIM_H
+#define HEAP_REPLAY_HOST_SHIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Map the direct map and the VMM window at the kernel's addresses.
+ *
+ * @return false when the fixed mappings are unavailable (a PIE build, or another
+ *         mapping already there).
+ */
+bool host_shim_initialize(void);
+
+/** @brief The CPU the next heap call runs on, and how many the trace used. */
+void host_shim_set_cpu(uint32_t cpu, uint32_t cpu_count);
+
+#endif /* HEAP_REPLAY_HOST_SHIM_H */
@@ -142,6 +142,12 @@ option("console")
     set_description("Compile the interactive kernel console (commands over keyboard/serial) into the image")
 option_end()
 
+option("heap_trace")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Capture every kmalloc/kfree from boot and export it for tools/heap-replay")
+option_end()
+
 local GRAPHICS_MODE = has_config("graphics") and 1 or 0
 -- The smoke battery is built when explicitly requested, never in release mode (a
 -- production image), and only when the engine is actually linked in (it calls
@@ -176,9 +182,11 @@ target("libk")
         "libc/stdlib/abort.c",
         "libc/string/memcmp.c",
         "libc/string/memcpy.c",
+        "libc/string/memory_dispatch.c",
         "libc/string/memmove.c",
         "libc/string/memset.c",
-        "libc/string/strlen.c"
+        "libc/string/strlen.c",
+        "libc/arch/i386/string/memory_sse2.S"
     )
 target_end()
 
@@ -207,7 +215,7 @@ target("libkxx")
     set_languages("gnuxx17")
     add_defines("__is_libkxx")
     add_includedirs("libkxx/include")
-    add_sysincludedirs("libc/include")
+    add_sysincludedirs("libc/include", "kernel/include")
     add_files("libkxx/src/*.cpp")
 target_end()
 end -- if LPLPLUGIN_AVAILABLE
@@ -562,6 +570,9 @@ target("lpl-kernel")
     if has_config("apic_smoke") then
         add_defines("KERNEL_SMOKE_TEST_ENABLE_APIC_PERIODIC_MODE=1u")
     end
+    if has_config("heap_trace") then
+        add_defines("LPL_KERNEL_HEAP_TRACE")
+    end
     if get_config("keyboard") == "fr" then
         add_defines("LPL_KERNEL_KEYBOARD_LAYOUT_AZERTY")
     end